@@ -223,6 +223,7 @@ int32 LTE_fdd_dl_fg_samp_buf::work(int32                      noutput_items,
                     pdcch.dl_alloc[pdcch.N_dl_alloc].N_codewords    = 1;
                     pdcch.dl_alloc[pdcch.N_dl_alloc].rnti           = LIBLTE_MAC_SI_RNTI;
                     pdcch.dl_alloc[pdcch.N_dl_alloc].tx_mode        = sib_tx_mode;
+                    pdcch.dl_alloc[pdcch.N_dl_alloc].N_cce_agg      = 0;
                     pdcch.N_dl_alloc++;
                 }
                 if(subframe.num             >=  (0 * si_win_len)%10 &&
@@ -283,6 +284,7 @@ int32 LTE_fdd_dl_fg_samp_buf::work(int32                      noutput_items,
                         pdcch.dl_alloc[pdcch.N_dl_alloc].N_codewords    = 1;
                         pdcch.dl_alloc[pdcch.N_dl_alloc].rnti           = LIBLTE_MAC_SI_RNTI;
                         pdcch.dl_alloc[pdcch.N_dl_alloc].tx_mode        = sib_tx_mode;
+                        pdcch.dl_alloc[pdcch.N_dl_alloc].N_cce_agg      = 0;
                         pdcch.N_dl_alloc++;
                     }
                 }
@@ -341,6 +343,7 @@ int32 LTE_fdd_dl_fg_samp_buf::work(int32                      noutput_items,
                             pdcch.dl_alloc[pdcch.N_dl_alloc].N_codewords    = 1;
                             pdcch.dl_alloc[pdcch.N_dl_alloc].rnti           = LIBLTE_MAC_SI_RNTI;
                             pdcch.dl_alloc[pdcch.N_dl_alloc].tx_mode        = sib_tx_mode;
+                            pdcch.dl_alloc[pdcch.N_dl_alloc].N_cce_agg      = 0;
                             pdcch.N_dl_alloc++;
                         }
                     }
@@ -378,6 +381,7 @@ int32 LTE_fdd_dl_fg_samp_buf::work(int32                      noutput_items,
                         pdcch.dl_alloc[0].N_codewords    = 1;
                         pdcch.dl_alloc[0].rnti           = LIBLTE_MAC_P_RNTI;
                         pdcch.dl_alloc[0].tx_mode        = sib_tx_mode;
+                        pdcch.dl_alloc[0].N_cce_agg      = 0;
                         pdcch.N_dl_alloc++;
                     }
                 }
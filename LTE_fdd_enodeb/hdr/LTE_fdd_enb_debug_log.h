@@ -0,0 +1,163 @@
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_debug_log.h
+
+    Description: Contains all the definitions for the LTE FDD eNodeB
+                 deferred debug log.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+#ifndef __LTE_FDD_ENB_DEBUG_LOG_H__
+#define __LTE_FDD_ENB_DEBUG_LOG_H__
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "LTE_fdd_enb_interface.h"
+#include "LTE_fdd_enb_msgq.h"
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <stdarg.h>
+#include <sys/time.h>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+#define LTE_FDD_ENB_DEBUG_LOG_RING_SIZE        (1 << 18) // Bytes per thread, power of 2
+#define LTE_FDD_ENB_DEBUG_LOG_MAX_ARGS_SIZE    4096      // Bytes of captured arguments
+#define LTE_FDD_ENB_DEBUG_LOG_MAX_STRING_SIZE  1024      // Longest %s argument kept for the formatter
+#define LTE_FDD_ENB_DEBUG_LOG_MAX_TEXT_SIZE    16384     // Bytes kept of a call formatted when logged
+#define LTE_FDD_ENB_DEBUG_LOG_MAX_PAYLOAD_SIZE 16384     // Bytes kept of a message
+#define LTE_FDD_ENB_DEBUG_LOG_FLUSH_US         1000
+
+/*******************************************************************************
+                              FORWARD DECLARATIONS
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+typedef enum{
+    LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_NONE = 0,
+    LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_BITS,  // Packed, printed as hex digits
+    LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_BYTES, // Printed with its size
+    LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_SIZE,  // Only the size is printed
+}LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_ENUM;
+
+// Followed in the ring by the captured arguments and then the payload
+typedef struct{
+    struct timeval                      time;
+    const char                         *file_name;
+    const char                         *fmt; // NULL pads out the end of the ring
+    uint32                              size;
+    int32                               line;
+    uint32                              N_args_bytes;
+    uint32                              payload_size; // As logged, bits or bytes
+    uint32                              N_payload_bytes;
+    LTE_FDD_ENB_DEBUG_TYPE_ENUM         type;
+    LTE_FDD_ENB_DEBUG_LEVEL_ENUM        level;
+    LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_ENUM  payload_type;
+}LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT;
+
+// One per logging thread, only that thread writes and only the
+// formatter reads
+typedef struct{
+    uint8               *buf;
+    uint8                pad_0[LTE_FDD_ENB_MSGQ_CACHE_LINE];
+    std::atomic<uint64>  wr;
+    std::atomic<uint64>  N_msgs;
+    std::atomic<uint64>  N_dropped;
+    uint8                pad_1[LTE_FDD_ENB_MSGQ_CACHE_LINE];
+    std::atomic<uint64>  rd;
+    std::atomic<bool>    closed;
+}LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT;
+
+typedef struct{
+    uint64 N_msgs;
+    uint64 N_dropped;
+    uint32 N_threads;
+}LTE_FDD_ENB_DEBUG_LOG_STATS_STRUCT;
+
+/*******************************************************************************
+                              CLASS DECLARATIONS
+*******************************************************************************/
+
+// Logging only copies the format string pointer, the arguments and the
+// message into a ring owned by the calling thread.  A background thread
+// does the formatting and writes to the debug port, so the format string
+// and file name must be literals.  Calls with a string argument too long
+// to keep are formatted by the caller instead.  When a ring is full the
+// message is dropped and counted, and the count is written to the debug
+// port.  There is one of these per process.
+class LTE_fdd_enb_debug_log
+{
+public:
+    // Constructor/Destructor
+    LTE_fdd_enb_debug_log(LTE_fdd_enb_interface *iface);
+    ~LTE_fdd_enb_debug_log();
+
+    // Start/Stop
+    void start();
+    void stop();
+
+    // Logging
+    void log(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, const char *file_name, int32 line, const char *fmt, va_list args);
+    void log_bits(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, const char *file_name, int32 line, const uint8 *bits, uint32 N_bits, const char *fmt, va_list args);
+    void log_bits(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, const char *file_name, int32 line, std::vector<bool> &bits, const char *fmt, va_list args);
+    void log_bytes(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, const char *file_name, int32 line, const uint8 *bytes, uint32 N_bytes, const char *fmt, va_list args);
+    void log_size(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, const char *file_name, int32 line, uint32 N_bytes, const char *fmt, va_list args);
+
+    // Statistics
+    void get_stats(LTE_FDD_ENB_DEBUG_LOG_STATS_STRUCT *stats);
+
+private:
+    // Logging
+    LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT* get_thread_ring();
+    LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT* start_record(LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT **ring, LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, const char *file_name, int32 line, const char *fmt, va_list args, LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_ENUM payload_type, uint32 payload_size, uint32 N_payload_bytes);
+    void finish_record(LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT *ring, LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *rec);
+
+    // Formatter
+    static void* formatter_thread(void *inputs);
+    uint32 flush();
+    void format_record(LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *rec, std::string &out);
+    void format_args(const char *fmt, uint8 *args, uint32 N_args_bytes, std::string &out);
+    LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT* next_record(LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT *ring);
+
+    // Variables
+    LTE_fdd_enb_interface                            *interface;
+    std::mutex                                        rings_mutex;
+    std::vector<LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT *>  rings;
+    pthread_t                                         thread;
+    bool                                              started;
+    std::atomic<bool>                                 running;
+    uint64                                            N_closed_msgs;
+    uint64                                            N_closed_dropped;
+    uint64                                            N_reported_dropped;
+};
+
+#endif /* __LTE_FDD_ENB_DEBUG_LOG_H__ */
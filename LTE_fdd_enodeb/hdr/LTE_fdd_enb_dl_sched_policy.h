@@ -0,0 +1,135 @@
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_dl_sched_policy.h
+
+    Description: Contains all the definitions for the LTE FDD eNodeB
+                 downlink scheduling policies.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+#ifndef __LTE_FDD_ENB_DL_SCHED_POLICY_H__
+#define __LTE_FDD_ENB_DL_SCHED_POLICY_H__
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "LTE_fdd_enb_interface.h"
+#include <vector>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              FORWARD DECLARATIONS
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+// Everything a policy may use to rank a UE in the current TTI.  The UL
+// scheduler fills in the same fields for its own direction: the reported
+// buffer less the grants in flight, the UE's position in the UL queue,
+// its averaged UL throughput and the one PRB TBS at the UE's UL MCS.
+typedef struct{
+    uint32 backlog_bytes;  // Bytes waiting in the DL scheduling queue
+    uint32 N_ttis_waiting; // TTIs since the UE was last served
+    uint32 arrival_idx;    // Position of the UE's oldest PDU in the queue
+    float  avg_thru;       // Averaged served bits per TTI
+    float  inst_rate;      // Achievable bits per PRB, the one PRB TBS at the CQI's MCS
+    float  metric;         // Filled in by rank()
+    void  *entry;          // Scheduler queue entry the candidate was built from
+    uint16 rnti;
+}LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT;
+
+/*******************************************************************************
+                              CLASS DECLARATIONS
+*******************************************************************************/
+
+class LTE_fdd_enb_dl_sched_policy
+{
+public:
+    // Constructor/Destructor
+    static LTE_fdd_enb_dl_sched_policy* create(LTE_FDD_ENB_DL_SCHED_POLICY_ENUM type);
+    virtual ~LTE_fdd_enb_dl_sched_policy();
+
+    // External interface
+    void rank(std::vector<LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT> &candidates);
+    LTE_FDD_ENB_DL_SCHED_POLICY_ENUM get_type();
+
+    // A UE that does not fit keeps its place for the next TTI instead of
+    // blocking everyone behind it
+    virtual bool skip_on_no_headroom();
+
+protected:
+    LTE_fdd_enb_dl_sched_policy(LTE_FDD_ENB_DL_SCHED_POLICY_ENUM _type);
+
+    // Larger metrics are served first
+    virtual float get_metric(const LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT &cand) = 0;
+
+private:
+    LTE_FDD_ENB_DL_SCHED_POLICY_ENUM type;
+};
+
+// Serves the queue in arrival order, stopping at the first PDU that does not fit
+class LTE_fdd_enb_dl_sched_policy_fifo : public LTE_fdd_enb_dl_sched_policy
+{
+public:
+    LTE_fdd_enb_dl_sched_policy_fifo();
+    bool skip_on_no_headroom();
+protected:
+    float get_metric(const LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT &cand);
+};
+
+// Serves the UE that has waited longest since its last allocation
+class LTE_fdd_enb_dl_sched_policy_rr : public LTE_fdd_enb_dl_sched_policy
+{
+public:
+    LTE_fdd_enb_dl_sched_policy_rr();
+protected:
+    float get_metric(const LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT &cand);
+};
+
+// Serves the UE with the best instantaneous rate relative to its average throughput
+class LTE_fdd_enb_dl_sched_policy_pf : public LTE_fdd_enb_dl_sched_policy
+{
+public:
+    LTE_fdd_enb_dl_sched_policy_pf();
+protected:
+    float get_metric(const LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT &cand);
+};
+
+// Serves the UE with the best instantaneous rate
+class LTE_fdd_enb_dl_sched_policy_max_ci : public LTE_fdd_enb_dl_sched_policy
+{
+public:
+    LTE_fdd_enb_dl_sched_policy_max_ci();
+protected:
+    float get_metric(const LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT &cand);
+};
+
+#endif /* __LTE_FDD_ENB_DL_SCHED_POLICY_H__ */
@@ -0,0 +1,122 @@
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_event_loop.h
+
+    Description: Contains all the definitions for the LTE FDD eNodeB
+                 upper layer event loop.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+#ifndef __LTE_FDD_ENB_EVENT_LOOP_H__
+#define __LTE_FDD_ENB_EVENT_LOOP_H__
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "LTE_fdd_enb_interface.h"
+#include "LTE_fdd_enb_msgq.h"
+#include <atomic>
+#include <vector>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              FORWARD DECLARATIONS
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+typedef struct{
+    LTE_fdd_enb_msgq           *msgq;
+    LTE_FDD_ENB_MESSAGE_STRUCT *msg;
+}LTE_FDD_ENB_EVENT_LOOP_ITEM_STRUCT;
+
+typedef struct{
+    uint64 N_ring_msgs;   // Taken from the queue rings
+    uint64 N_direct_msgs; // Sent and handled on the loop thread
+    uint64 N_wakeups;
+    uint32 max_run_queue;
+}LTE_FDD_ENB_EVENT_LOOP_STATS_STRUCT;
+
+/*******************************************************************************
+                              CLASS DECLARATIONS
+*******************************************************************************/
+
+// Services the receive side of several message queues from one thread.
+// A message sent on the loop thread to a queue of the same loop skips
+// the ring and goes on the run queue, which is drained after each batch
+// taken from a queue, so a handler always runs to completion before the
+// messages it sent are handled.  The run queue is a fixed ring sized in
+// start() to every message the loop's queues can have in flight.
+class LTE_fdd_enb_event_loop
+{
+public:
+    // Constructor/Destructor
+    LTE_fdd_enb_event_loop(LTE_fdd_enb_interface *iface, uint32 _idx);
+    ~LTE_fdd_enb_event_loop();
+
+    // Setup, queues are added before start()
+    void add_msgq(LTE_fdd_enb_msgq *msgq);
+    void start();
+    void stop();
+
+    // Message queue interface
+    bool is_current();
+    void run_later(LTE_fdd_enb_msgq *msgq, LTE_FDD_ENB_MESSAGE_STRUCT *msg);
+    void wake();
+
+    // Statistics
+    void get_stats(LTE_FDD_ENB_EVENT_LOOP_STATS_STRUCT *stats);
+
+private:
+    // Loop
+    static void* loop_thread(void *inputs);
+    void run_pending();
+    bool is_msg_pending();
+
+    // Variables
+    LTE_fdd_enb_interface                          *interface;
+    std::vector<LTE_fdd_enb_msgq *>                 msgqs;
+    LTE_FDD_ENB_EVENT_LOOP_ITEM_STRUCT             *run_queue;
+    uint32                                          run_queue_mask;
+    uint32                                          run_queue_head;
+    uint32                                          run_queue_tail;
+    pthread_t                                       thread;
+    uint32                                          idx;
+    bool                                            started;
+    std::atomic<bool>                               running;
+    std::atomic<uint32>                             sleeping;
+    std::atomic<uint64>                             N_ring_msgs;
+    std::atomic<uint64>                             N_direct_msgs;
+    std::atomic<uint64>                             N_wakeups;
+    std::atomic<uint32>                             max_run_queue;
+};
+
+#endif /* __LTE_FDD_ENB_EVENT_LOOP_H__ */
@@ -66,8 +66,13 @@
 #include "LTE_fdd_enb_msgq.h"
 #include "liblte_common.h"
 #include "libtools_server_socket.h"
+#include <sys/types.h>
+#include <sched.h>
+#include <time.h>
 #include <string>
 #include <mutex>
+#include <atomic>
+#include <map>
 
 /*******************************************************************************
                               DEFINES
@@ -75,6 +80,10 @@
 
 #define LTE_FDD_ENB_CTRL_PORT     30000
 #define LTE_FDD_ENB_MAX_LINE_SIZE 512
+#define LTE_FDD_ENB_MAX_N_CELLS   4
+
+// Upper layer event loops, 0 keeps one receive thread per queue
+#define LTE_FDD_ENB_MAX_N_EVENT_LOOPS 4
 
 /*******************************************************************************
                               FORWARD DECLARATIONS
@@ -91,6 +100,10 @@ class LTE_fdd_enb_rlc;
 class LTE_fdd_enb_mac;
 class LTE_fdd_enb_phy;
 class LTE_fdd_enb_radio;
+class LTE_fdd_enb_event_loop;
+class LTE_fdd_enb_debug_log;
+class LTE_fdd_enb_pcap;
+class LTE_fdd_enb_metrics;
 
 /*******************************************************************************
                               TYPEDEFS
@@ -146,6 +159,114 @@ typedef enum{
 static const char LTE_fdd_enb_pcap_direction_text[LTE_FDD_ENB_PCAP_DIRECTION_N_ITEMS][20] = {"UL",
                                                                                              "DL"};
 
+// Counters and histograms kept per cell by the metrics, the names are
+// what gets exported
+typedef enum{
+    LTE_FDD_ENB_METRIC_PHY_LATE_DL_TTIS = 0,
+    LTE_FDD_ENB_METRIC_PHY_LATE_UL_TTIS,
+    LTE_FDD_ENB_METRIC_PUSCH_DECODES,
+    LTE_FDD_ENB_METRIC_PUSCH_CRC_FAILS,
+    LTE_FDD_ENB_METRIC_TURBO_ITERATIONS,
+    LTE_FDD_ENB_METRIC_DL_HARQ_ACKS,
+    LTE_FDD_ENB_METRIC_DL_HARQ_NACKS,
+    LTE_FDD_ENB_METRIC_MAC_DL_BYTES,
+    LTE_FDD_ENB_METRIC_MAC_UL_BYTES,
+    LTE_FDD_ENB_METRIC_COUNTER_N_ITEMS,
+}LTE_FDD_ENB_METRIC_COUNTER_ENUM;
+static const char LTE_fdd_enb_metric_counter_text[LTE_FDD_ENB_METRIC_COUNTER_N_ITEMS][40] = {"phy_late_dl_ttis",
+                                                                                             "phy_late_ul_ttis",
+                                                                                             "pusch_decodes",
+                                                                                             "pusch_crc_fails",
+                                                                                             "turbo_iterations",
+                                                                                             "dl_harq_acks",
+                                                                                             "dl_harq_nacks",
+                                                                                             "mac_dl_bytes",
+                                                                                             "mac_ul_bytes"};
+
+typedef enum{
+    LTE_FDD_ENB_METRIC_HIST_PHY_DL_US = 0,
+    LTE_FDD_ENB_METRIC_HIST_PHY_UL_US,
+    LTE_FDD_ENB_METRIC_HIST_MAC_TTI_US,
+    LTE_FDD_ENB_METRIC_HIST_N_ITEMS,
+}LTE_FDD_ENB_METRIC_HIST_ENUM;
+static const char LTE_fdd_enb_metric_hist_text[LTE_FDD_ENB_METRIC_HIST_N_ITEMS][40] = {"phy_dl_us",
+                                                                                       "phy_ul_us",
+                                                                                       "mac_tti_us"};
+
+// The UL scheduler ranks its UEs with the same policies, see
+// LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT for what each input means there
+typedef enum{
+    LTE_FDD_ENB_DL_SCHED_POLICY_FIFO = 0,
+    LTE_FDD_ENB_DL_SCHED_POLICY_ROUND_ROBIN,
+    LTE_FDD_ENB_DL_SCHED_POLICY_PROPORTIONAL_FAIR,
+    LTE_FDD_ENB_DL_SCHED_POLICY_MAX_CI,
+    LTE_FDD_ENB_DL_SCHED_POLICY_N_ITEMS,
+}LTE_FDD_ENB_DL_SCHED_POLICY_ENUM;
+static const char LTE_fdd_enb_dl_sched_policy_text[LTE_FDD_ENB_DL_SCHED_POLICY_N_ITEMS][20] = {"fifo",
+                                                                                               "rr",
+                                                                                               "pf",
+                                                                                               "max_ci"};
+
+// Thread classes whose placement can be configured, each thread names
+// itself and applies its class configuration when it starts
+typedef enum{
+    LTE_FDD_ENB_THREAD_RADIO = 0,
+    LTE_FDD_ENB_THREAD_PHY,
+    LTE_FDD_ENB_THREAD_MAC,
+    LTE_FDD_ENB_THREAD_STACK,
+    LTE_FDD_ENB_THREAD_GW,
+    LTE_FDD_ENB_THREAD_N_ITEMS,
+}LTE_FDD_ENB_THREAD_ENUM;
+static const char LTE_fdd_enb_thread_text[LTE_FDD_ENB_THREAD_N_ITEMS][20] = {"radio",
+                                                                            "phy",
+                                                                            "mac",
+                                                                            "stack",
+                                                                            "gw"};
+
+typedef enum{
+    LTE_FDD_ENB_SCHED_POLICY_OTHER = 0,
+    LTE_FDD_ENB_SCHED_POLICY_FIFO,
+    LTE_FDD_ENB_SCHED_POLICY_RR,
+    LTE_FDD_ENB_SCHED_POLICY_N_ITEMS,
+}LTE_FDD_ENB_SCHED_POLICY_ENUM;
+static const char LTE_fdd_enb_sched_policy_text[LTE_FDD_ENB_SCHED_POLICY_N_ITEMS][20] = {"other",
+                                                                                        "fifo",
+                                                                                        "rr"};
+
+typedef struct{
+    std::string                   cores; // "auto" or a CPU list, e.g. "2-3,6"
+    LTE_FDD_ENB_SCHED_POLICY_ENUM sched_policy;
+    int32                         sched_prio;
+    bool                          busy_poll;
+}LTE_FDD_ENB_THREAD_CNFG_STRUCT;
+
+// Layout a thread actually got, read back from the kernel once applied
+typedef struct{
+    std::string                   cores;
+    LTE_FDD_ENB_THREAD_ENUM       thread_class;
+    LTE_FDD_ENB_SCHED_POLICY_ENUM sched_policy;
+    pid_t                         tid;
+    int32                         sched_prio;
+    int32                         affinity_err;
+    int32                         sched_err;
+    bool                          busy_poll;
+}LTE_FDD_ENB_THREAD_LAYOUT_STRUCT;
+
+// Semi-persistent scheduling intervals in subframes, 0 disables SPS
+#define LTE_FDD_ENB_N_SPS_INTERVALS 11
+static const uint32 LTE_fdd_enb_sps_interval[LTE_FDD_ENB_N_SPS_INTERVALS] = {0, 10, 20, 32, 40, 64, 80, 128, 160, 320, 640};
+
+// DRX cycles and timers in subframes, in RRC enumeration order.  A cycle
+// of 0 disables DRX (long) or the short cycle (short).
+#define LTE_FDD_ENB_N_DRX_LONG_CYCLES 17
+static const uint32 LTE_fdd_enb_drx_long_cycle[LTE_FDD_ENB_N_DRX_LONG_CYCLES] = {0, 10, 20, 32, 40, 64, 80, 128, 160, 256, 320, 512, 640, 1024, 1280, 2048, 2560};
+#define LTE_FDD_ENB_N_DRX_SHORT_CYCLES 17
+static const uint32 LTE_fdd_enb_drx_short_cycle[LTE_FDD_ENB_N_DRX_SHORT_CYCLES] = {0, 2, 5, 8, 10, 16, 20, 32, 40, 64, 80, 128, 160, 256, 320, 512, 640};
+#define LTE_FDD_ENB_N_DRX_ON_DURATIONS 16
+static const uint32 LTE_fdd_enb_drx_on_duration[LTE_FDD_ENB_N_DRX_ON_DURATIONS] = {1, 2, 3, 4, 5, 6, 8, 10, 20, 30, 40, 50, 60, 80, 100, 200};
+#define LTE_FDD_ENB_N_DRX_INACTIVITY_TIMERS 22
+static const uint32 LTE_fdd_enb_drx_inactivity_timer[LTE_FDD_ENB_N_DRX_INACTIVITY_TIMERS] = {1, 2, 3, 4, 5, 6, 8, 10, 20, 30, 40, 50, 60, 80, 100, 200, 300, 500, 750, 1280, 1920, 2560};
+
 typedef struct{
     MasterInformationBlock                    mib;
     SystemInformationBlockType1               sib1;
@@ -159,6 +280,28 @@ typedef struct{
     std::vector<LIBLTE_PHY_ALLOCATION_STRUCT> sib_alloc;
 }LTE_FDD_ENB_SYS_INFO_STRUCT;
 
+typedef struct{
+    LTE_FDD_ENB_SYS_INFO_STRUCT  sys_info;
+    LTE_fdd_enb_rrc             *rrc;
+    LTE_fdd_enb_mac             *mac;
+    LTE_fdd_enb_phy             *phy;
+    LTE_fdd_enb_radio           *radio;
+    LTE_fdd_enb_msgq            *phy_to_mac_comm;
+    LTE_fdd_enb_msgq            *mac_to_phy_comm;
+    LTE_fdd_enb_msgq            *rlc_to_mac_comm;
+    LTE_fdd_enb_msgq            *pdcp_to_rrc_comm;
+    LTE_fdd_enb_msgq            *mme_to_rrc_comm;
+    uint32                       dl_center_freq;
+    uint32                       ul_center_freq;
+    uint32                       cell_id;
+    uint16                       N_id_cell;
+    uint16                       dl_earfcn;
+    uint16                       ul_earfcn;
+    uint8                        band;
+    uint8                        N_id_1;
+    uint8                        N_id_2;
+}LTE_FDD_ENB_CELL_STRUCT;
+
 /*******************************************************************************
                               CLASS DECLARATIONS
 *******************************************************************************/
@@ -174,15 +317,18 @@ public:
     void stop_ports();
     void send_ctrl_msg(std::string msg);
     void send_ctrl_info_msg(std::string msg, ...);
-    void send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, std::string file_name, int32 line, std::string msg, ...);
-    void send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, std::string file_name, int32 line, LIBLTE_BIT_MSG_STRUCT *lte_msg, std::string msg, ...);
-    void send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, std::string file_name, int32 line, std::vector<bool> &lte_msg, std::string msg, ...);
-    void send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, std::string file_name, int32 line, LIBLTE_BYTE_MSG_STRUCT *lte_msg, std::string msg, ...);
-    void send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, std::string file_name, int32 line, const std::vector<uint8_t> &lte_msg, std::string msg, ...);
-    void open_lte_pcap_fd();
-    void open_ip_pcap_fd();
+
+    // Debug messages are queued on the calling thread and formatted and
+    // sent later by the debug log thread, see LTE_fdd_enb_debug_log
+    void send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, const char *file_name, int32 line, const char *msg, ...);
+    void send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, const char *file_name, int32 line, LIBLTE_BIT_MSG_STRUCT *lte_msg, const char *msg, ...);
+    void send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, const char *file_name, int32 line, std::vector<bool> &lte_msg, const char *msg, ...);
+    void send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, const char *file_name, int32 line, LIBLTE_BYTE_MSG_STRUCT *lte_msg, const char *msg, ...);
+    void send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, const char *file_name, int32 line, LIBLTE_BYTE_BUF_STRUCT *lte_msg, const char *msg, ...);
+    void send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM type, LTE_FDD_ENB_DEBUG_LEVEL_ENUM level, const char *file_name, int32 line, const std::vector<uint8_t> &lte_msg, const char *msg, ...);
+    void send_debug_output(const std::string &msg);
     void send_lte_pcap_msg(LTE_FDD_ENB_PCAP_DIRECTION_ENUM dir, uint32 rnti, uint32 current_tti, uint8 *msg, uint32 N_bits);
-    void send_ip_pcap_msg(uint8 *msg, uint32 N_bytes);
+    void send_ip_pcap_msg(uint32 rnti, uint8 *msg, uint32 N_bytes);
     void handle_ctrl_msg(const std::string msg, const int32 sock_fd);
     void handle_ctrl_connect(const int32 sock_fd);
     void handle_ctrl_disconnect(const int32 sock_fd);
@@ -192,24 +338,31 @@ public:
     void handle_debug_disconnect(const int32 sock_fd);
     void handle_debug_error(const LIBTOOLS_SERVER_SOCKET_ERROR_ENUM err);
 
+    // Metrics
+    void count_metric(uint8 cell, LTE_FDD_ENB_METRIC_COUNTER_ENUM counter, uint64 N);
+    void sample_metric(uint8 cell, LTE_FDD_ENB_METRIC_HIST_ENUM hist, struct timespec *start);
+    void add_metrics_msgq(LTE_fdd_enb_msgq *msgq);
+    void remove_metrics_msgq(LTE_fdd_enb_msgq *msgq);
+
     // Handlers
     MasterInformationBlock::dl_Bandwidth_Enum get_bandwidth();
-    uint32 get_band();
-    uint16 get_dl_earfcn();
-    uint16 get_ul_earfcn();
+    uint32 get_band(uint8 cell);
+    uint8 get_n_cells();
+    uint16 get_dl_earfcn(uint8 cell);
+    uint16 get_ul_earfcn(uint8 cell);
     uint32 get_n_rb_dl();
     uint32 get_n_rb_ul();
-    uint32 get_dl_center_freq();
-    uint32 get_ul_center_freq();
+    uint32 get_dl_center_freq(uint8 cell);
+    uint32 get_ul_center_freq(uint8 cell);
     uint32 get_n_sc_rb_dl();
     uint32 get_n_sc_rb_ul();
     uint8 get_n_ant();
-    uint16 get_n_id_cell();
-    uint8 get_n_id_1();
-    uint8 get_n_id_2();
+    uint16 get_n_id_cell(uint8 cell);
+    uint8 get_n_id_1(uint8 cell);
+    uint8 get_n_id_2(uint8 cell);
     const MCC& get_mcc();
     const MNC& get_mnc();
-    uint32 get_cell_id();
+    uint32 get_cell_id(uint8 cell);
     uint16 get_tracking_area_code();
     int16 get_q_rx_lev_min();
     uint16 get_si_periodicity();
@@ -228,6 +381,13 @@ public:
     bool get_phy_direct_to_ue();
     uint32 get_debug_type();
     uint32 get_debug_level();
+    LTE_FDD_ENB_DL_SCHED_POLICY_ENUM get_dl_sched_policy();
+    LTE_FDD_ENB_DL_SCHED_POLICY_ENUM get_ul_sched_policy();
+    uint32 get_sps_interval();
+    uint32 get_drx_long_cycle();
+    uint32 get_drx_short_cycle();
+    uint32 get_drx_on_duration();
+    uint32 get_drx_inactivity_timer();
     bool get_enable_pcap();
     uint32 get_ip_addr_start();
     uint32 get_dns_addr();
@@ -240,6 +400,13 @@ public:
     bool app_is_started();
     void construct_sys_info();
     void get_sys_info(LTE_FDD_ENB_SYS_INFO_STRUCT &_sys_info);
+    void get_sys_info(uint8 cell, LTE_FDD_ENB_SYS_INFO_STRUCT &_sys_info);
+    uint32 get_radio_core(uint8 cell);
+    uint32 get_mac_core();
+    uint32 get_stack_core();
+    void setup_thread(LTE_FDD_ENB_THREAD_ENUM thread_class, uint32 idx, std::string name);
+    bool get_thread_busy_poll(LTE_FDD_ENB_THREAD_ENUM thread_class);
+    void get_thread_layout(std::map<std::string, LTE_FDD_ENB_THREAD_LAYOUT_STRUCT> &layout);
     void get_rrc_phy_cnfg_ded(PhysicalConfigDedicated *pcd, uint32 i_cqi_pmi, uint32 i_ri, uint32 i_sr, uint32 n_1_p_pucch);
 
 private:
@@ -250,20 +417,22 @@ private:
     void stop_debug_port();
     std::mutex              ctrl_mutex;
     std::mutex              debug_mutex;
-    FILE                   *lte_pcap_fd;
-    FILE                   *ip_pcap_fd;
     libtools_server_socket *ctrl_socket;
     libtools_server_socket *debug_socket;
     int32                   ctrl_sock_fd;
     int32                   debug_sock_fd;
     bool                    ctrl_connected;
-    bool                    debug_connected;
+    std::atomic<bool>       debug_connected;
+    LTE_fdd_enb_debug_log  *debug_log;
+    LTE_fdd_enb_pcap       *pcap;
 
     // Handlers
     void handle_read(std::string msg);
     void handle_write(std::string msg);
     std::string get_bandwidth_string();
     int set_bandwidth(std::string bandwidth);
+    int set_n_cells(std::string _N_cells);
+    int set_selected_cell(std::string _selected_cell);
     int set_band(std::string band);
     int set_dl_earfcn(std::string _dl_earfcn);
     int set_n_ant(std::string _N_ant);
@@ -303,8 +472,24 @@ private:
     int set_debug_type(std::string _debug_type);
     std::string get_debug_level_string();
     int set_debug_level(std::string _debug_level);
+    std::string get_dl_sched_policy_string();
+    int set_dl_sched_policy(std::string _dl_sched_policy);
+    std::string get_ul_sched_policy_string();
+    int set_ul_sched_policy(std::string _ul_sched_policy);
+    int set_sps_interval(std::string _sps_interval);
+    int set_drx_long_cycle(std::string _drx_long_cycle);
+    int set_drx_short_cycle(std::string _drx_short_cycle);
+    int set_drx_on_duration(std::string _drx_on_duration);
+    int set_drx_inactivity_timer(std::string _drx_inactivity_timer);
     std::string get_enable_pcap_string();
     int set_enable_pcap(std::string _enable_pcap);
+    int set_pcap_dir(std::string _pcap_dir);
+    int set_pcap_max_size(std::string _pcap_max_size);
+    int set_pcap_period(std::string _pcap_period);
+    int set_pcap_rnti(std::string _pcap_rnti);
+    int set_metrics_file(std::string _metrics_file);
+    int set_metrics_period(std::string _metrics_period);
+    int set_metrics_format(std::string _metrics_format);
     std::string get_ip_addr_start_string();
     int set_ip_addr_start(std::string _ip_addr_start);
     std::string get_dns_addr_string();
@@ -312,16 +497,31 @@ private:
     std::string get_use_cnfg_file_string();
     int set_use_cnfg_file(std::string _use_cnfg_file);
     std::string get_use_user_file_string();
+    int set_stack_event_loops(std::string _stack_event_loops);
+    bool handle_read_thread_cnfg(std::string param);
+    bool handle_write_thread_cnfg(std::string param);
+    int set_thread_cores(LTE_FDD_ENB_THREAD_ENUM thread_class, std::string cores);
+    int set_thread_sched_policy(LTE_FDD_ENB_THREAD_ENUM thread_class, std::string policy);
+    int set_thread_sched_prio(LTE_FDD_ENB_THREAD_ENUM thread_class, std::string prio);
+    int set_thread_busy_poll(LTE_FDD_ENB_THREAD_ENUM thread_class, std::string busy_poll);
+    int cpu_list_to_set(std::string cpu_list, cpu_set_t *cpu_set);
+    std::string cpu_set_to_list(cpu_set_t *cpu_set);
     std::string bool_to_enable_string(bool value);
     bool enable_string_to_bool(std::string enable);
     void handle_start();
     void handle_stop();
+    void delete_stack_comms();
+    void stop_stack_event_loops();
     void handle_help();
     void handle_delete_user(std::string msg);
     void handle_print_users();
     void handle_print_registered_users();
+    void handle_print_threads();
+    void handle_metrics(std::string msg);
     void write_cnfg_file();
     void delete_cnfg_file();
+    void pack_sys_info(LTE_FDD_ENB_SYS_INFO_STRUCT &cell_sys_info, std::vector<SchedulingInfo> &sched_info_list);
+    uint32 get_core_from_end(uint32 offset);
 
     // Variables
     const std::string            shutdown_token;
@@ -332,11 +532,15 @@ private:
     const std::string            delete_user_token;
     const std::string            print_users_token;
     const std::string            print_registered_users_token;
+    const std::string            print_threads_token;
+    const std::string            metrics_token;
     const std::string            read_token;
     const std::string            write_token;
     const std::string            help_token;
     const std::string            bandwidth_token;
     const std::string            band_token;
+    const std::string            n_cells_token;
+    const std::string            selected_cell_token;
     const std::string            dl_earfcn_token;
     const std::string            n_ant_token;
     const std::string            n_id_cell_token;
@@ -360,11 +564,26 @@ private:
     const std::string            phy_direct_to_ue_token;
     const std::string            debug_type_token;
     const std::string            debug_level_token;
+    const std::string            dl_sched_policy_token;
+    const std::string            ul_sched_policy_token;
+    const std::string            sps_interval_token;
+    const std::string            drx_long_cycle_token;
+    const std::string            drx_short_cycle_token;
+    const std::string            drx_on_duration_token;
+    const std::string            drx_inactivity_timer_token;
     const std::string            enable_pcap_token;
+    const std::string            pcap_dir_token;
+    const std::string            pcap_max_size_token;
+    const std::string            pcap_period_token;
+    const std::string            pcap_rnti_token;
+    const std::string            metrics_file_token;
+    const std::string            metrics_period_token;
+    const std::string            metrics_format_token;
     const std::string            ip_addr_start_token;
     const std::string            dns_addr_token;
     const std::string            use_cnfg_file_token;
     const std::string            use_user_file_token;
+    const std::string            stack_event_loops_token;
     const std::string            available_radios_token;
     const std::string            selected_radio_name_token;
     const std::string            selected_radio_idx_token;
@@ -374,35 +593,32 @@ private:
     const std::string            imsi_token;
     const std::string            imei_token;
     const std::string            k_token;
+    std::string                  thread_cores_token[LTE_FDD_ENB_THREAD_N_ITEMS];
+    std::string                  thread_sched_policy_token[LTE_FDD_ENB_THREAD_N_ITEMS];
+    std::string                  thread_sched_prio_token[LTE_FDD_ENB_THREAD_N_ITEMS];
+    std::string                  thread_busy_poll_token[LTE_FDD_ENB_THREAD_N_ITEMS];
     LTE_fdd_enb_timer_mgr       *timer_mgr;
     LTE_fdd_enb_user_mgr        *user_mgr;
     LTE_fdd_enb_hss             *hss;
     LTE_fdd_enb_gw              *gw;
     LTE_fdd_enb_mme             *mme;
-    LTE_fdd_enb_rrc             *rrc;
     LTE_fdd_enb_pdcp            *pdcp;
     LTE_fdd_enb_rlc             *rlc;
-    LTE_fdd_enb_mac             *mac;
-    LTE_fdd_enb_phy             *phy;
-    LTE_fdd_enb_radio           *radio;
+    LTE_fdd_enb_metrics         *metrics;
+    LTE_FDD_ENB_CELL_STRUCT      cells[LTE_FDD_ENB_MAX_N_CELLS];
     LTE_FDD_ENB_SYS_INFO_STRUCT  sys_info;
     std::mutex                   start_mutex;
     uint32                       N_rb_dl;
     uint32                       N_rb_ul;
-    uint32                       dl_center_freq;
-    uint32                       ul_center_freq;
     const uint32                 N_sc_rb_dl;
     const uint32                 N_sc_rb_ul;
     uint32                       debug_type;
     uint32                       debug_level;
     uint32                       ip_addr_start;
     uint32                       dns_addr;
-    uint16                       N_id_cell;
-    uint16                       dl_earfcn;
-    uint16                       ul_earfcn;
     uint8                        N_ant;
-    uint8                        N_id_1;
-    uint8                        N_id_2;
+    uint8                        N_cells;
+    uint8                        selected_cell;
     bool                         shutdown;
     bool                         started;
     bool                         sib3_present;
@@ -417,19 +633,40 @@ private:
     bool                         use_cnfg_file;
     bool                         use_user_file;
 
+    // MAC
+    LTE_FDD_ENB_DL_SCHED_POLICY_ENUM dl_sched_policy;
+    LTE_FDD_ENB_DL_SCHED_POLICY_ENUM ul_sched_policy;
+    uint32                           sps_interval;
+    uint32                           drx_long_cycle;
+    uint32                           drx_short_cycle;
+    uint32                           drx_on_duration;
+    uint32                           drx_inactivity_timer;
+
+    // PCAP
+    std::string pcap_dir;
+    uint32      pcap_max_size;
+    uint32      pcap_period;
+    uint32      pcap_rnti;
+
+    // Metrics
+    std::string metrics_file;
+    uint32      metrics_period;
+    uint32      metrics_format;
+
+    // Threads
+    LTE_FDD_ENB_THREAD_CNFG_STRUCT                          thread_cnfg[LTE_FDD_ENB_THREAD_N_ITEMS];
+    std::map<std::string, LTE_FDD_ENB_THREAD_LAYOUT_STRUCT> thread_layout;
+    std::mutex                                              thread_mutex;
+    LTE_fdd_enb_event_loop                                 *stack_event_loop[LTE_FDD_ENB_MAX_N_EVENT_LOOPS];
+    uint32                                                  N_stack_event_loops;
 
-    // Inter-stack communication
-    LTE_fdd_enb_msgq *phy_to_mac_comm;
-    LTE_fdd_enb_msgq *mac_to_phy_comm;
+    // Inter-stack communication (per-cell queues are in cells)
     LTE_fdd_enb_msgq *mac_to_rlc_comm;
     LTE_fdd_enb_msgq *mac_to_timer_comm;
-    LTE_fdd_enb_msgq *rlc_to_mac_comm;
     LTE_fdd_enb_msgq *rlc_to_pdcp_comm;
     LTE_fdd_enb_msgq *pdcp_to_rlc_comm;
-    LTE_fdd_enb_msgq *pdcp_to_rrc_comm;
     LTE_fdd_enb_msgq *rrc_to_pdcp_comm;
     LTE_fdd_enb_msgq *rrc_to_mme_comm;
-    LTE_fdd_enb_msgq *mme_to_rrc_comm;
     LTE_fdd_enb_msgq *pdcp_to_gw_comm;
     LTE_fdd_enb_msgq *gw_to_pdcp_comm;
 };
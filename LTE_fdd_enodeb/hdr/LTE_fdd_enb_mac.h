@@ -53,6 +53,8 @@
 #include "LTE_fdd_enb_interface.h"
 #include "LTE_fdd_enb_msgq.h"
 #include "LTE_fdd_enb_user.h"
+#include "LTE_fdd_enb_sched_pool.h"
+#include "LTE_fdd_enb_dl_sched_policy.h"
 #include "liblte_mac.h"
 #include "libtools_ipc_msgq.h"
 #include <list>
@@ -63,6 +65,25 @@
 *******************************************************************************/
 
 #define LTE_FDD_ENB_MAX_HARQ_RETX 5
+#define LTE_FDD_ENB_MAX_UL_HARQ_TX 4 // Matches maxHARQ-Tx sent in MAC-MainConfig
+
+// Timing advance
+#define LTE_FDD_ENB_TA_STEP_TS        16 // 36.213 section 4.2.3
+#define LTE_FDD_ENB_TA_THRESHOLD_TS   12
+#define LTE_FDD_ENB_TA_HOLDOFF_N_TTIS 16
+
+// Semi-persistent scheduling
+#define LTE_FDD_ENB_SPS_MAX_SDU_BYTES      128 // Largest backlog a configured assignment or grant is sized for
+#define LTE_FDD_ENB_SPS_DL_RELEASE_N_EMPTY 8   // Unused DL occasions before the assignment is released
+#define LTE_FDD_ENB_SPS_UL_RELEASE_N_EMPTY 2   // Matches implicitReleaseAfter sent in SPS-ConfigUL
+
+// Scheduler entry pools, allocated when the MAC is created
+#define LTE_FDD_ENB_N_RAR_SCHED_ENTRIES 16
+#define LTE_FDD_ENB_N_DL_SCHED_ENTRIES  128
+#define LTE_FDD_ENB_N_UL_SCHED_ENTRIES  64
+#define LTE_FDD_ENB_N_UL_HARQ_ENTRIES   128
+#define LTE_FDD_ENB_N_UL_SR_ENTRIES     64
+#define LTE_FDD_ENB_N_RNTIS             65536
 
 /*******************************************************************************
                               FORWARD DECLARATIONS
@@ -74,27 +95,40 @@
 *******************************************************************************/
 
 typedef struct{
-    LIBLTE_PHY_ALLOCATION_STRUCT dl_alloc;
-    LIBLTE_PHY_ALLOCATION_STRUCT ul_alloc;
-    LIBLTE_MAC_RAR_STRUCT        rar;
-    uint32                       current_tti;
+    LIBLTE_PHY_ALLOCATION_STRUCT  dl_alloc;
+    LIBLTE_PHY_ALLOCATION_STRUCT  ul_alloc;
+    LIBLTE_MAC_RAR_STRUCT         rar;
+    uint32                        current_tti;
+    LTE_FDD_ENB_SCHED_LINK_STRUCT link[LTE_FDD_ENB_SCHED_N_LINKS];
 }LTE_FDD_ENB_RAR_SCHED_QUEUE_STRUCT;
 
 typedef struct{
-    LIBLTE_PHY_ALLOCATION_STRUCT alloc;
-    LIBLTE_MAC_PDU_STRUCT        mac_pdu;
-    uint32                       current_tti;
+    LIBLTE_PHY_ALLOCATION_STRUCT  alloc;
+    LIBLTE_MAC_PDU_STRUCT         mac_pdu;
+    uint32                        current_tti;
+    bool                          mux; // mac_pdu is built from the UE's RB queues when scheduled
+    LTE_FDD_ENB_SCHED_LINK_STRUCT link[LTE_FDD_ENB_SCHED_N_LINKS];
 }LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT;
 
 typedef struct{
-    LIBLTE_PHY_ALLOCATION_STRUCT alloc;
-    uint32                       current_tti;
+    LIBLTE_PHY_ALLOCATION_STRUCT  alloc;
+    uint32                        current_tti; // First TTI the UE may be granted in
+    LTE_FDD_ENB_SCHED_LINK_STRUCT link[LTE_FDD_ENB_SCHED_N_LINKS];
 }LTE_FDD_ENB_UL_SCHED_QUEUE_STRUCT;
 
 typedef struct{
-    uint32 i_sr;
-    uint32 n_1_p_pucch;
-    uint16 rnti;
+    LIBLTE_PHY_ALLOCATION_STRUCT  alloc;
+    uint32                        current_tti; // Last PUSCH (re)transmission
+    uint32                        N_tx;
+    bool                          retx_reserved; // Decode set up for current_tti+8
+    LTE_FDD_ENB_SCHED_LINK_STRUCT link[LTE_FDD_ENB_SCHED_N_LINKS];
+}LTE_FDD_ENB_UL_HARQ_STRUCT;
+
+typedef struct{
+    uint32                        i_sr;
+    uint32                        n_1_p_pucch;
+    uint16                        rnti;
+    LTE_FDD_ENB_SCHED_LINK_STRUCT link[LTE_FDD_ENB_SCHED_N_LINKS];
 }LTE_FDD_ENB_UL_SR_SCHED_QUEUE_STRUCT;
 
 typedef struct{
@@ -104,6 +138,35 @@ typedef struct{
     uint32                       timer_id;
 }LTE_FDD_ENB_PERSISTENT_DL_STRUCT;
 
+typedef enum{
+    LTE_FDD_ENB_SPS_STATE_IDLE = 0, // Configured by RRC, waiting for traffic
+    LTE_FDD_ENB_SPS_STATE_ACTIVE,   // Activated on the PDCCH, occasions every interval
+    LTE_FDD_ENB_SPS_STATE_RELEASE,  // Release PDCCH pending
+}LTE_FDD_ENB_SPS_STATE_ENUM;
+
+typedef struct{
+    LIBLTE_PHY_ALLOCATION_STRUCT dl_alloc; // Configured assignment, addressed to the SPS C-RNTI
+    LIBLTE_PHY_ALLOCATION_STRUCT ul_alloc; // Configured grant, addressed to the SPS C-RNTI
+    LTE_FDD_ENB_RB_ENUM          rb_id;
+    LTE_FDD_ENB_SPS_STATE_ENUM   dl_state;
+    LTE_FDD_ENB_SPS_STATE_ENUM   ul_state;
+    uint32                       interval;
+    uint32                       n_1_p_pucch_an;
+    uint32                       dl_tti; // Activation TTI, occasions follow every interval
+    uint32                       ul_tti;
+    uint32                       N_dl_empty;
+    uint32                       N_ul_empty;
+    uint16                       c_rnti;
+    uint16                       sps_c_rnti;
+    bool                         dl_reserved; // PRBs of an occasion are held in the current subframe
+}LTE_FDD_ENB_SPS_STRUCT;
+
+typedef LTE_fdd_enb_sched_pool<LTE_FDD_ENB_RAR_SCHED_QUEUE_STRUCT, LTE_FDD_ENB_N_RAR_SCHED_ENTRIES> LTE_fdd_enb_rar_sched_pool;
+typedef LTE_fdd_enb_sched_pool<LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT, LTE_FDD_ENB_N_DL_SCHED_ENTRIES> LTE_fdd_enb_dl_sched_pool;
+typedef LTE_fdd_enb_sched_pool<LTE_FDD_ENB_UL_SCHED_QUEUE_STRUCT, LTE_FDD_ENB_N_UL_SCHED_ENTRIES> LTE_fdd_enb_ul_sched_pool;
+typedef LTE_fdd_enb_sched_pool<LTE_FDD_ENB_UL_HARQ_STRUCT, LTE_FDD_ENB_N_UL_HARQ_ENTRIES> LTE_fdd_enb_ul_harq_pool;
+typedef LTE_fdd_enb_sched_pool<LTE_FDD_ENB_UL_SR_SCHED_QUEUE_STRUCT, LTE_FDD_ENB_N_UL_SR_ENTRIES> LTE_fdd_enb_ul_sr_sched_pool;
+
 /*******************************************************************************
                               CLASS DECLARATIONS
 *******************************************************************************/
@@ -111,7 +174,7 @@ typedef struct{
 class LTE_fdd_enb_mac
 {
 public:
-    LTE_fdd_enb_mac(LTE_fdd_enb_interface *iface, LTE_fdd_enb_timer_mgr *tm, LTE_fdd_enb_user_mgr *um, LTE_fdd_enb_rlc *_rlc);
+    LTE_fdd_enb_mac(LTE_fdd_enb_interface *iface, uint8 _cell, LTE_fdd_enb_timer_mgr *tm, LTE_fdd_enb_user_mgr *um, LTE_fdd_enb_rlc *_rlc);
     ~LTE_fdd_enb_mac();
     void set_phy_and_rrc(LTE_fdd_enb_phy *_phy, LTE_fdd_enb_rrc *_rrc);
 
@@ -124,6 +187,8 @@ public:
     void update_sys_info();
     void add_periodic_sr_pucch(uint16 rnti, uint32 i_sr, uint32 n_1_p_pucch);
     void remove_periodic_sr_pucch(uint16 rnti);
+    void add_sps(uint16 c_rnti, uint16 sps_c_rnti, LTE_FDD_ENB_RB_ENUM rb_id, uint32 interval, uint32 n_1_p_pucch_an);
+    void remove_sps(uint16 c_rnti);
 
     void send_dl_traffic(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb, uint32 num_frames, uint32 size);
 
@@ -132,6 +197,7 @@ private:
     std::mutex             start_mutex;
     LTE_fdd_enb_interface *interface;
     bool                   started;
+    uint8                  cell;
 
     // Communication
     void handle_phy_msg(LTE_FDD_ENB_MESSAGE_STRUCT &msg);
@@ -153,6 +219,7 @@ private:
     void handle_pucch_ack_nack(LTE_fdd_enb_user *user, uint32 current_tti, LIBLTE_BIT_MSG_STRUCT *msg);
     void handle_pucch_sr(LTE_fdd_enb_user *user, uint32 current_tti, LIBLTE_BIT_MSG_STRUCT *msg);
     void handle_pusch_decode(LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT *pusch_decode);
+    void handle_timing_offset(LTE_fdd_enb_user *user, uint32 current_tti, float timing_offset);
 
     // RLC Message Handlers
     void handle_sdu_ready(LTE_FDD_ENB_MAC_SDU_READY_MSG_STRUCT *sdu_ready);
@@ -169,32 +236,82 @@ private:
 
     // Data Constructors
     void construct_random_access_response(uint8 preamble, uint16 timing_adv, uint32 current_tti);
+    void construct_ta_command(LTE_fdd_enb_user *user, uint8 ta);
 
     // Scheduler
-    void sched_ul(LTE_fdd_enb_user *user, uint32 requested_tbs);
+    void sched_ul(LTE_fdd_enb_user *user);
     void persistent_dl(LTE_FDD_ENB_PERSISTENT_DL_STRUCT *persistent_dl);
     void handle_persistent_dl_timer_expiry(uint32 timer_id);
     void rar_scheduler();
     void dl_scheduler();
+    void ul_harq_scheduler();
     void ul_scheduler();
     void ul_sr_scheduler();
+    void sps_scheduler();
+    void sps_dl_scheduler();
     LTE_FDD_ENB_ERROR_ENUM add_to_rar_sched_queue(uint32 current_tti, LIBLTE_PHY_ALLOCATION_STRUCT *dl_alloc, LIBLTE_PHY_ALLOCATION_STRUCT *ul_alloc, LIBLTE_MAC_RAR_STRUCT *rar);
     LTE_FDD_ENB_ERROR_ENUM add_to_dl_sched_queue(uint32 current_tti, LIBLTE_MAC_PDU_STRUCT *mac_pdu, LIBLTE_PHY_ALLOCATION_STRUCT *alloc);
+    LTE_FDD_ENB_ERROR_ENUM add_to_dl_mux_queue(uint32 current_tti, LIBLTE_PHY_ALLOCATION_STRUCT *alloc);
     LTE_FDD_ENB_ERROR_ENUM add_to_ul_sched_queue(uint32 current_tti, LIBLTE_PHY_ALLOCATION_STRUCT *alloc);
-    std::mutex                                       rar_sched_queue_mutex;
-    std::mutex                                       dl_sched_queue_mutex;
-    std::mutex                                       persistent_dl_queue_mutex;
-    std::mutex                                       ul_sched_queue_mutex;
-    std::mutex                                       ul_sr_sched_queue_mutex;
-    std::list<LTE_FDD_ENB_RAR_SCHED_QUEUE_STRUCT*>   rar_sched_queue;
-    std::list<LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT*>    dl_sched_queue;
-    std::list<LTE_FDD_ENB_PERSISTENT_DL_STRUCT*>     persistent_dl_queue;
-    std::list<LTE_FDD_ENB_UL_SCHED_QUEUE_STRUCT*>    ul_sched_queue;
-    std::list<LTE_FDD_ENB_UL_SR_SCHED_QUEUE_STRUCT*> ul_sr_sched_queue;
-    LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT               sched_dl_subfr[10];
-    LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT               sched_ul_subfr[10];
-    uint8                                            sched_cur_dl_subfn;
-    uint8                                            sched_cur_ul_subfn;
+    void add_to_ul_harq_queue(LIBLTE_PHY_ALLOCATION_STRUCT *alloc, uint32 current_tti);
+    void clear_ul_harq(uint16 rnti, uint32 current_tti);
+    uint32 get_ul_bytes_in_flight(uint16 rnti);
+    bool size_ul_grant(LTE_fdd_enb_user *user, uint32 N_bytes, uint32 N_prb_max, LIBLTE_PHY_ALLOCATION_STRUCT *alloc);
+    bool alloc_ul_prbs(LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr, LIBLTE_PHY_ALLOCATION_STRUCT *alloc);
+    void insert_into_dl_sched_queue(LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched);
+    bool schedule_dl_mux(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr, LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched, LTE_fdd_enb_user *user);
+    uint32 get_dl_mux_rbs(LTE_fdd_enb_user *user, LTE_fdd_enb_rb **rb);
+    uint32 get_dl_mux_backlog(LTE_fdd_enb_user *user);
+    bool schedule_dl_alloc(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr, LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched);
+    bool alloc_dl_prbs(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr, LIBLTE_PHY_ALLOCATION_STRUCT *alloc, bool non_contiguous);
+    float get_dl_inst_rate(LTE_fdd_enb_user *user, uint8 mcs);
+    void pad_dl_mac_pdu(LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched);
+    void send_dl_alloc(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr, LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched, uint32 n_1_p_pucch);
+    bool build_sps_dl_pdu(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb, LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched);
+    bool alloc_sps_prbs(bool *prb_used, uint32 N_rb, LIBLTE_PHY_ALLOCATION_STRUCT *alloc);
+    bool reserve_sps_prbs(bool *prb_used, LIBLTE_PHY_ALLOCATION_STRUCT *alloc);
+    bool sps_holds_rb(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb);
+    bool sps_dl_occasion(uint16 rnti);
+    bool sps_covers_ul(LTE_fdd_enb_user *user, uint32 N_bytes);
+    void sps_ul_decoded(uint16 c_rnti, bool has_sdu);
+    void drain_sched_intake();
+    void free_dl_sched(LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched);
+    void free_ul_sched(LTE_FDD_ENB_UL_SCHED_QUEUE_STRUCT *ul_sched);
+    void free_ul_harq(LTE_FDD_ENB_UL_HARQ_STRUCT *harq);
+    std::mutex                                         sched_intake_mutex;
+    std::mutex                                         persistent_dl_queue_mutex;
+    std::mutex                                         ul_harq_mutex;
+    std::mutex                                         ul_sr_sched_queue_mutex;
+    std::mutex                                         sps_mutex;
+    LTE_fdd_enb_rar_sched_pool                         rar_sched_pool;
+    LTE_fdd_enb_dl_sched_pool                          dl_sched_pool;
+    LTE_fdd_enb_ul_sched_pool                          ul_sched_pool;
+    LTE_fdd_enb_ul_harq_pool                           ul_harq_pool;
+    LTE_fdd_enb_ul_sr_sched_pool                       ul_sr_sched_pool;
+    LTE_FDD_ENB_SCHED_LIST_STRUCT                      rar_intake; // Posted from any thread
+    LTE_FDD_ENB_SCHED_LIST_STRUCT                      dl_intake;  // Posted from any thread
+    LTE_FDD_ENB_SCHED_LIST_STRUCT                      ul_intake;  // Posted from any thread
+    bool                                               dl_mux_pending[LTE_FDD_ENB_N_RNTIS];
+    bool                                               ul_sched_pending[LTE_FDD_ENB_N_RNTIS];
+    LTE_FDD_ENB_SCHED_LIST_STRUCT                      rar_sched_queue;
+    LTE_FDD_ENB_SCHED_LIST_STRUCT                      dl_tti_ring[LIBLTE_PHY_TTI_MAX + 1];
+    LTE_FDD_ENB_SCHED_LIST_STRUCT                      dl_sched_queue; // Due DL schedules, oldest first
+    uint32                                             dl_ring_tti;    // Next TTI ring slot to move to dl_sched_queue
+    uint32                                             dl_cand_idx[LTE_FDD_ENB_N_RNTIS];
+    std::vector<LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT> dl_candidates;
+    LTE_FDD_ENB_SCHED_LIST_STRUCT                      ul_sched_queue;
+    std::vector<LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT> ul_candidates;
+    LTE_FDD_ENB_SCHED_LIST_STRUCT                      ul_harq_queue;
+    LTE_FDD_ENB_SCHED_LIST_STRUCT                      ul_harq_ue_queue[LTE_FDD_ENB_N_RNTIS];
+    LTE_FDD_ENB_SCHED_LIST_STRUCT                      ul_sr_sched_queue;
+    std::list<LTE_FDD_ENB_PERSISTENT_DL_STRUCT*>       persistent_dl_queue;
+    std::list<LTE_FDD_ENB_SPS_STRUCT*>                 sps_list;
+    LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT                 sched_dl_subfr[10];
+    LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT                 sched_ul_subfr[10];
+    uint8                                              sched_cur_dl_subfn;
+    uint8                                              sched_cur_ul_subfn;
+    LTE_fdd_enb_dl_sched_policy                       *dl_sched_policy;
+    LTE_fdd_enb_dl_sched_policy                       *ul_sched_policy;
 
     // Parameters
     LTE_fdd_enb_timer_mgr       *timer_mgr;
@@ -208,7 +325,14 @@ private:
     // Helpers
     void advance_tti_and_clear_subframe();
     uint32 get_n_reserved_prbs(uint32 current_tti);
-    bool scheduling_headroom(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr, LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr, uint32 N_dl_prbs, uint32 N_ul_prbs);
+    bool scheduling_headroom(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr, LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr, uint32 N_dl_prbs, uint32 N_ul_prbs, LIBLTE_PHY_ALLOCATION_STRUCT *dci_alloc);
+    void clear_pdcch_map(LTE_FDD_ENB_PDCCH_MAP_STRUCT *map);
+    bool alloc_pdcch(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr, LIBLTE_PHY_ALLOCATION_STRUCT *alloc, bool commit);
+    bool place_dci(LTE_FDD_ENB_PDCCH_MAP_STRUCT *map, uint32 subfr_num, LTE_FDD_ENB_DCI_PLACEMENT_STRUCT *dci);
+    bool move_dcis_off_cces(LTE_FDD_ENB_PDCCH_MAP_STRUCT *map, uint32 subfr_num, uint32 cce_idx, uint32 N_cce_agg);
+    uint32 get_dci_candidates(LTE_FDD_ENB_PDCCH_MAP_STRUCT *map, uint32 subfr_num, LTE_FDD_ENB_DCI_PLACEMENT_STRUCT *dci, uint32 N_cce_agg, uint32 *cce_idx);
+    bool cces_free(LTE_FDD_ENB_PDCCH_MAP_STRUCT *map, uint32 cce_idx, uint32 N_cce_agg);
+    void mark_cces(LTE_FDD_ENB_PDCCH_MAP_STRUCT *map, uint32 cce_idx, uint32 N_cce_agg, bool used);
     LIBLTE_PHY_MODULATION_TYPE_ENUM get_modulation_type(uint8 mcs);
 };
 
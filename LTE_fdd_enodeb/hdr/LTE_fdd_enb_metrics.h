@@ -0,0 +1,162 @@
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_metrics.h
+
+    Description: Contains all the definitions for the LTE FDD eNodeB runtime
+                 metrics.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+#ifndef __LTE_FDD_ENB_METRICS_H__
+#define __LTE_FDD_ENB_METRICS_H__
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "LTE_fdd_enb_interface.h"
+#include "LTE_fdd_enb_msgq.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+// Histogram bucket i counts samples up to 2^i, the last one is unbounded
+#define LTE_FDD_ENB_METRICS_N_BUCKETS    16
+#define LTE_FDD_ENB_METRICS_POLL_US      100000
+#define LTE_FDD_ENB_METRICS_DEFAULT_FILE "/tmp/LTE_fdd_enodeb.metrics"
+
+/*******************************************************************************
+                              FORWARD DECLARATIONS
+*******************************************************************************/
+
+class LTE_fdd_enb_user_mgr;
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+typedef enum{
+    LTE_FDD_ENB_METRICS_FORMAT_PROMETHEUS = 0,
+    LTE_FDD_ENB_METRICS_FORMAT_LINE,
+    LTE_FDD_ENB_METRICS_FORMAT_N_ITEMS,
+}LTE_FDD_ENB_METRICS_FORMAT_ENUM;
+static const char LTE_fdd_enb_metrics_format_text[LTE_FDD_ENB_METRICS_FORMAT_N_ITEMS][20] = {"prometheus",
+                                                                                             "line"};
+
+// One per recording thread, only that thread writes
+typedef struct{
+    std::atomic<uint64> counter[LTE_FDD_ENB_MAX_N_CELLS][LTE_FDD_ENB_METRIC_COUNTER_N_ITEMS];
+    std::atomic<uint64> bucket[LTE_FDD_ENB_MAX_N_CELLS][LTE_FDD_ENB_METRIC_HIST_N_ITEMS][LTE_FDD_ENB_METRICS_N_BUCKETS];
+    std::atomic<uint64> sum[LTE_FDD_ENB_MAX_N_CELLS][LTE_FDD_ENB_METRIC_HIST_N_ITEMS];
+    std::atomic<uint64> max[LTE_FDD_ENB_MAX_N_CELLS][LTE_FDD_ENB_METRIC_HIST_N_ITEMS];
+    std::atomic<bool>   closed;
+}LTE_FDD_ENB_METRICS_BLOCK_STRUCT;
+
+typedef struct{
+    uint64 counter[LTE_FDD_ENB_MAX_N_CELLS][LTE_FDD_ENB_METRIC_COUNTER_N_ITEMS];
+    uint64 bucket[LTE_FDD_ENB_MAX_N_CELLS][LTE_FDD_ENB_METRIC_HIST_N_ITEMS][LTE_FDD_ENB_METRICS_N_BUCKETS];
+    uint64 sum[LTE_FDD_ENB_MAX_N_CELLS][LTE_FDD_ENB_METRIC_HIST_N_ITEMS];
+    uint64 max[LTE_FDD_ENB_MAX_N_CELLS][LTE_FDD_ENB_METRIC_HIST_N_ITEMS];
+}LTE_FDD_ENB_METRICS_TOTALS_STRUCT;
+
+typedef struct{
+    std::string                     out;
+    std::string                     timestamp; // Line protocol only
+    LTE_FDD_ENB_METRICS_FORMAT_ENUM format;
+}LTE_FDD_ENB_METRICS_REPORT_STRUCT;
+
+/*******************************************************************************
+                              CLASS DECLARATIONS
+*******************************************************************************/
+
+// Counters and histograms are kept in a block owned by the recording
+// thread, so recording is a couple of uncontended stores.  Reading sums
+// the blocks of all threads and adds what can be read directly: message
+// queues, buffer pools, users, and thread CPU time.  The report is in
+// Prometheus text format or line protocol, and a background thread can
+// write it to a file periodically.  There is one of these per process.
+class LTE_fdd_enb_metrics
+{
+public:
+    // Constructor/Destructor
+    LTE_fdd_enb_metrics(LTE_fdd_enb_interface *iface, LTE_fdd_enb_user_mgr *um);
+    ~LTE_fdd_enb_metrics();
+
+    // Start/Stop
+    void start();
+    void stop();
+
+    // Recording
+    void count(uint8 cell, LTE_FDD_ENB_METRIC_COUNTER_ENUM counter, uint64 N);
+    void sample(uint8 cell, LTE_FDD_ENB_METRIC_HIST_ENUM hist, uint64 value);
+
+    // Message queues
+    void add_msgq(LTE_fdd_enb_msgq *msgq);
+    void remove_msgq(LTE_fdd_enb_msgq *msgq);
+
+    // Reporting
+    std::string report(LTE_FDD_ENB_METRICS_FORMAT_ENUM format);
+
+    // Configuration
+    void set_dump(std::string file, uint32 period_s, LTE_FDD_ENB_METRICS_FORMAT_ENUM format);
+
+private:
+    // Recording
+    LTE_FDD_ENB_METRICS_BLOCK_STRUCT* get_thread_block();
+    void collect(LTE_FDD_ENB_METRICS_TOTALS_STRUCT *totals);
+
+    // Reporting
+    void report_layers(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep);
+    void report_msgqs(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep);
+    void report_msg_pool(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep);
+    void report_users(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep);
+    void report_threads(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep);
+
+    // Dump
+    static void* dump_thread(void *inputs);
+    void dump(std::string file, LTE_FDD_ENB_METRICS_FORMAT_ENUM format);
+
+    // Variables
+    LTE_fdd_enb_interface                           *interface;
+    LTE_fdd_enb_user_mgr                            *user_mgr;
+    std::mutex                                       blocks_mutex;
+    std::vector<LTE_FDD_ENB_METRICS_BLOCK_STRUCT *>  blocks;
+    LTE_FDD_ENB_METRICS_TOTALS_STRUCT                closed_totals;
+    std::mutex                                       msgqs_mutex;
+    std::vector<LTE_fdd_enb_msgq *>                  msgqs;
+    std::mutex                                       cnfg_mutex;
+    std::string                                      dump_file;
+    uint32                                           dump_period;
+    LTE_FDD_ENB_METRICS_FORMAT_ENUM                  dump_format;
+    bool                                             dump_failed;
+    pthread_t                                        thread;
+    bool                                             started;
+    std::atomic<bool>                                running;
+};
+
+#endif /* __LTE_FDD_ENB_METRICS_H__ */
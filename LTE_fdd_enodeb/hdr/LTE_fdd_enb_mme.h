@@ -85,7 +85,7 @@ public:
     ~LTE_fdd_enb_mme();
 
     // Start/Stop
-    void start(LTE_fdd_enb_msgq *from_rrc, LTE_fdd_enb_msgq *to_rrc);
+    void start(LTE_fdd_enb_msgq *from_rrc, LTE_fdd_enb_msgq **to_rrc);
     void stop();
 
     // External interface
@@ -102,7 +102,7 @@ private:
     void send_rrc_cmd_ready(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb, LTE_FDD_ENB_RRC_CMD_ENUM cmd, LIBLTE_BYTE_MSG_STRUCT *msg);
     void send_rrc_nas_msg_ready(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb, LIBLTE_BYTE_MSG_STRUCT *msg);
     LTE_fdd_enb_msgq *msgq_from_rrc;
-    LTE_fdd_enb_msgq *msgq_to_rrc;
+    LTE_fdd_enb_msgq *msgq_to_rrc[LTE_FDD_ENB_MAX_N_CELLS];
 
     // RRC Message Handlers
     void handle_nas_msg(LTE_FDD_ENB_MME_NAS_MSG_READY_MSG_STRUCT *nas_msg);
@@ -0,0 +1,123 @@
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_msg_pool.h
+
+    Description: Contains all the definitions for the LTE FDD eNodeB
+                 message buffer pools.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+#ifndef __LTE_FDD_ENB_MSG_POOL_H__
+#define __LTE_FDD_ENB_MSG_POOL_H__
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "liblte_common.h"
+#include "liblte_rlc.h"
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+// Payload bytes per class, a BIT message needs one byte per bit
+#define LTE_FDD_ENB_MSG_POOL_SMALL_BYTES  64
+#define LTE_FDD_ENB_MSG_POOL_MEDIUM_BYTES 1536
+#define LTE_FDD_ENB_MSG_POOL_LARGE_BYTES  9216
+
+// Room for the fields in front of the payload, e.g. N_bytes or an RLC header
+#define LTE_FDD_ENB_MSG_POOL_HDR_BYTES 32
+
+// Buffers per class, all allocated on first use
+#define LTE_FDD_ENB_MSG_POOL_N_SMALL  4096
+#define LTE_FDD_ENB_MSG_POOL_N_MEDIUM 2048
+#define LTE_FDD_ENB_MSG_POOL_N_LARGE  512
+
+// Buffers each thread keeps per class before going to the shared pool
+#define LTE_FDD_ENB_MSG_POOL_CACHE_SIZE 32
+
+/*******************************************************************************
+                              FORWARD DECLARATIONS
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+typedef enum{
+    LTE_FDD_ENB_MSG_POOL_SMALL = 0,
+    LTE_FDD_ENB_MSG_POOL_MEDIUM,
+    LTE_FDD_ENB_MSG_POOL_LARGE,
+    LTE_FDD_ENB_MSG_POOL_N_ITEMS,
+}LTE_FDD_ENB_MSG_POOL_ENUM;
+static const char LTE_fdd_enb_msg_pool_text[LTE_FDD_ENB_MSG_POOL_N_ITEMS][20] = {"small",
+                                                                                 "medium",
+                                                                                 "large"};
+
+typedef struct{
+    uint64 N_allocs[LTE_FDD_ENB_MSG_POOL_N_ITEMS];
+    uint64 N_exhausted[LTE_FDD_ENB_MSG_POOL_N_ITEMS]; // Served from the heap instead
+    uint32 N_bufs[LTE_FDD_ENB_MSG_POOL_N_ITEMS];
+    uint32 N_in_use[LTE_FDD_ENB_MSG_POOL_N_ITEMS];
+    uint32 max_in_use[LTE_FDD_ENB_MSG_POOL_N_ITEMS];
+    uint64 N_oversize;                                // Larger than any class, served from the heap
+    uint32 N_heap_in_use;
+}LTE_FDD_ENB_MSG_POOL_STATS_STRUCT;
+
+/*******************************************************************************
+                              CLASS DECLARATIONS
+*******************************************************************************/
+
+// Process wide pools for the messages the radio bearers hold on to.  A
+// buffer only backs the header and the payload class it was allocated
+// for, so pooled messages must be copied by length, never by sizeof.
+// alloc() and free() may be called from any thread and only take the
+// heap when a class is exhausted.
+class LTE_fdd_enb_msg_pool
+{
+public:
+    // Buffers
+    static void* alloc(uint32 size);
+    static void free(void *obj);
+
+    // Messages
+    static LIBLTE_BYTE_MSG_STRUCT* copy_byte_msg(LIBLTE_BYTE_MSG_STRUCT *msg);
+    static LIBLTE_BIT_MSG_STRUCT* copy_bit_msg(LIBLTE_BIT_MSG_STRUCT *msg);
+    static LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT* copy_amd_pdu(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *amd_pdu);
+    static LIBLTE_RLC_UMD_PDU_STRUCT* copy_umd_pdu(LIBLTE_RLC_UMD_PDU_STRUCT *umd_pdu, uint32 idx);
+
+    // Byte buffers, backed for the payload plus head and tail room so
+    // headers can be added in place
+    static LIBLTE_BYTE_BUF_STRUCT* alloc_byte_buf(uint32 N_bytes);
+    static LIBLTE_BYTE_BUF_STRUCT* copy_byte_buf(uint8 *data, uint32 N_bytes);
+
+    // Statistics
+    static void get_stats(LTE_FDD_ENB_MSG_POOL_STATS_STRUCT *stats);
+
+private:
+    LTE_fdd_enb_msg_pool();
+};
+
+#endif /* __LTE_FDD_ENB_MSG_POOL_H__ */
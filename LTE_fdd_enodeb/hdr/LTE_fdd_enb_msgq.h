@@ -58,9 +58,8 @@
 
 #include "LTE_fdd_enb_user.h"
 #include "liblte_phy.h"
-#include <boost/circular_buffer.hpp>
+#include <atomic>
 #include <string>
-#include "semaphore.h"
 
 /*******************************************************************************
                               DEFINES
@@ -69,11 +68,17 @@
 #define LTE_FDD_ENB_N_SIB_ALLOCS      7
 #define LTE_FDD_ENB_N_PUCCH_PER_SUBFR 12
 
+// Ring capacities are rounded up to a power of two
+#define LTE_FDD_ENB_MSGQ_DEFAULT_CAPACITY 128
+#define LTE_FDD_ENB_MSGQ_RX_BATCH         16
+#define LTE_FDD_ENB_MSGQ_CACHE_LINE       64
+
 /*******************************************************************************
                               FORWARD DECLARATIONS
 *******************************************************************************/
 
 class LTE_fdd_enb_interface;
+class LTE_fdd_enb_event_loop;
 
 /*******************************************************************************
                               TYPEDEFS
@@ -175,11 +180,27 @@ static const char LTE_fdd_enb_dest_layer_text[LTE_FDD_ENB_DEST_LAYER_N_ITEMS][10
 
 // MAC -> PHY Messages
 typedef struct{
-    LIBLTE_PHY_PDCCH_STRUCT allocations;
-    uint32                  N_avail_prbs;
-    uint32                  N_sched_prbs;
-    uint32                  current_tti;
-    uint8                   next_prb;
+    uint32 cce_idx;
+    uint32 N_cce_agg;
+    uint32 alloc_idx; // Index into allocations.dl_alloc or allocations.ul_alloc
+    uint16 c_rnti;    // Hashes the UE specific search space, 0 for common only
+    bool   common;    // May fall back to the common search space
+    bool   ul;
+}LTE_FDD_ENB_DCI_PLACEMENT_STRUCT;
+typedef struct{
+    LTE_FDD_ENB_DCI_PLACEMENT_STRUCT dci[2*LIBLTE_PHY_PDCCH_MAX_ALLOC];
+    uint32                           N_dci;
+    uint32                           N_cce;
+    bool                             cce_used[LIBLTE_PHY_PDCCH_N_CCE_MAX];
+}LTE_FDD_ENB_PDCCH_MAP_STRUCT;
+typedef struct{
+    LIBLTE_PHY_PDCCH_STRUCT      allocations;
+    LTE_FDD_ENB_PDCCH_MAP_STRUCT pdcch_map;
+    uint32                       N_avail_prbs;
+    uint32                       N_sched_prbs;
+    uint32                       N_sps_dl_alloc; // Trailing DL allocations sent without a DCI
+    uint32                       current_tti;
+    bool                         prb_used[LIBLTE_PHY_N_RB_DL_MAX];
 }LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT;
 typedef enum{
     LTE_FDD_ENB_PUCCH_TYPE_ACK_NACK = 0,
@@ -201,7 +222,7 @@ typedef struct{
     uint32                   N_sched_prbs;
     uint32                   current_tti;
     uint32                   N_pucch;
-    uint8                    next_prb;
+    bool                     prb_used[LIBLTE_PHY_N_RB_UL_MAX];
 }LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT;
 typedef struct{
     LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT dl_sched;
@@ -224,11 +245,13 @@ typedef struct{
     LIBLTE_BIT_MSG_STRUCT       msg;
     LTE_FDD_ENB_PUCCH_TYPE_ENUM type;
     uint32                      current_tti;
+    float                       timing_offset; // In Ts
     uint16                      rnti;
 }LTE_FDD_ENB_PUCCH_DECODE_MSG_STRUCT;
 typedef struct{
     LIBLTE_BIT_MSG_STRUCT msg;
     uint32                current_tti;
+    float                 timing_offset; // In Ts
     uint16                rnti;
 }LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT;
 
@@ -377,6 +400,102 @@ typedef struct{
     LTE_FDD_ENB_MESSAGE_UNION     msg;
 }LTE_FDD_ENB_MESSAGE_STRUCT;
 
+// User a message is for, NULL for messages that are not per user
+static inline LTE_fdd_enb_user* get_msg_user(LTE_FDD_ENB_MESSAGE_STRUCT &msg)
+{
+    switch(msg.type)
+    {
+    case LTE_FDD_ENB_MESSAGE_TYPE_MAC_SDU_READY:
+        return msg.msg.mac_sdu_ready.user;
+    case LTE_FDD_ENB_MESSAGE_TYPE_RLC_PDU_READY:
+        return msg.msg.rlc_pdu_ready.user;
+    case LTE_FDD_ENB_MESSAGE_TYPE_RLC_SDU_READY:
+        return msg.msg.rlc_sdu_ready.user;
+    case LTE_FDD_ENB_MESSAGE_TYPE_PDCP_PDU_READY:
+        return msg.msg.pdcp_pdu_ready.user;
+    case LTE_FDD_ENB_MESSAGE_TYPE_PDCP_SDU_READY:
+        return msg.msg.pdcp_sdu_ready.user;
+    case LTE_FDD_ENB_MESSAGE_TYPE_RRC_PDU_READY:
+        return msg.msg.rrc_pdu_ready.user;
+    case LTE_FDD_ENB_MESSAGE_TYPE_RRC_NAS_MSG_READY:
+        return msg.msg.rrc_nas_msg_ready.user;
+    case LTE_FDD_ENB_MESSAGE_TYPE_RRC_CMD_READY:
+        return msg.msg.rrc_cmd_ready.user;
+    case LTE_FDD_ENB_MESSAGE_TYPE_MME_NAS_MSG_READY:
+        return msg.msg.mme_nas_msg_ready.user;
+    case LTE_FDD_ENB_MESSAGE_TYPE_MME_RRC_CMD_RESP:
+        return msg.msg.mme_rrc_cmd_resp.user;
+    case LTE_FDD_ENB_MESSAGE_TYPE_PDCP_DATA_SDU_READY:
+        return msg.msg.pdcp_data_sdu_ready.user;
+    case LTE_FDD_ENB_MESSAGE_TYPE_GW_DATA_READY:
+        return msg.msg.gw_data_ready.user;
+    default:
+        return NULL;
+    }
+}
+
+// What send() does when the ring is full
+typedef enum{
+    LTE_FDD_ENB_MSGQ_FULL_BLOCK = 0, // Wait for the receiver to free a slot
+    LTE_FDD_ENB_MSGQ_FULL_DROP,      // Drop the new message and count it
+}LTE_FDD_ENB_MSGQ_FULL_ENUM;
+
+// How the receive thread waits for an empty ring to fill
+typedef enum{
+    LTE_FDD_ENB_MSGQ_WAKE_FUTEX = 0, // Sleep, senders only enter the kernel to wake a sleeping receiver
+    LTE_FDD_ENB_MSGQ_WAKE_BUSY_POLL, // Spin on the ring, burning the receive core
+}LTE_FDD_ENB_MSGQ_WAKE_ENUM;
+
+// Message buffers come in three sizes so that a timer tick does not
+// cost as much as a PHY schedule
+typedef enum{
+    LTE_FDD_ENB_MSGQ_POOL_SMALL = 0, // Everything that is not below
+    LTE_FDD_ENB_MSGQ_POOL_DECODE,    // PUCCH and PUSCH decodes
+    LTE_FDD_ENB_MSGQ_POOL_SCHEDULE,  // PHY schedules
+    LTE_FDD_ENB_MSGQ_POOL_N_ITEMS,
+}LTE_FDD_ENB_MSGQ_POOL_ENUM;
+static const char LTE_fdd_enb_msgq_pool_text[LTE_FDD_ENB_MSGQ_POOL_N_ITEMS][20] = {"small",
+                                                                                   "decode",
+                                                                                   "schedule"};
+
+typedef struct{
+    uint64 N_sent;
+    uint64 N_received;
+    uint64 N_dropped;
+    uint64 N_full_waits;
+    uint64 N_pool_empty[LTE_FDD_ENB_MSGQ_POOL_N_ITEMS];
+    uint32 N_bufs[LTE_FDD_ENB_MSGQ_POOL_N_ITEMS];
+    uint32 max_depth;
+    uint32 capacity;
+}LTE_FDD_ENB_MSGQ_STATS_STRUCT;
+
+// Only the header and the member of msg that matches the type are backed
+// by memory, so a buffer must never be copied as a whole
+typedef struct{
+    std::atomic<uint32>        next; // Free list link
+    uint32                     idx;
+    LTE_FDD_ENB_MSGQ_POOL_ENUM pool;
+    LTE_FDD_ENB_MESSAGE_STRUCT msg;
+}LTE_FDD_ENB_MSGQ_BUF_STRUCT;
+
+// Buffers are allocated on first use, up to the ring capacity, and then
+// recycled through a lock-free stack.  free_head holds an ABA tag in the
+// upper 32 bits and the index of the top buffer in the lower 32 bits.
+typedef struct{
+    LTE_FDD_ENB_MSGQ_BUF_STRUCT **bufs;
+    std::atomic<uint64>           free_head;
+    std::atomic<uint64>           N_empty;
+    std::atomic<uint32>           N_bufs;
+    uint32                        buf_size;
+}LTE_FDD_ENB_MSGQ_POOL_STRUCT;
+
+// A slot is free for the sender at position pos when seq == pos, and
+// holds a message for the receiver when seq == pos + 1
+typedef struct{
+    std::atomic<uint32>         seq;
+    LTE_FDD_ENB_MESSAGE_STRUCT *msg;
+}LTE_FDD_ENB_MSGQ_SLOT_STRUCT;
+
 /*******************************************************************************
                               CLASS DECLARATIONS
 *******************************************************************************/
@@ -399,17 +518,25 @@ template<class class_type, void (class_type::*Func)(LTE_FDD_ENB_MESSAGE_STRUCT&)
     return (static_cast<class_type*>(o)->*Func)(msg);
 }
 
+// Bounded lock-free ring with a single receive thread.  Any number of
+// threads may send unless the queue was created as single producer.
 class LTE_fdd_enb_msgq
 {
 public:
     LTE_fdd_enb_msgq(LTE_fdd_enb_interface *iface, std::string _msgq_name);
+    LTE_fdd_enb_msgq(LTE_fdd_enb_interface      *iface,
+                     std::string                 _msgq_name,
+                     uint32                      _capacity,
+                     LTE_FDD_ENB_MSGQ_FULL_ENUM  _full_policy,
+                     bool                        _single_producer);
     ~LTE_fdd_enb_msgq();
 
     // Setup
     void attach_rx(LTE_fdd_enb_msgq_cb cb);
     void attach_rx(LTE_fdd_enb_msgq_cb cb, uint32 _prio);
+    void attach_rx(LTE_fdd_enb_msgq_cb cb, uint32 _prio, LTE_FDD_ENB_MSGQ_WAKE_ENUM _wake_mode);
 
-    // Send/Receive
+    // Send/Receive, copying the message content
     void send(LTE_FDD_ENB_MESSAGE_TYPE_ENUM  type,
               LTE_FDD_ENB_DEST_LAYER_ENUM    dest_layer,
               LTE_FDD_ENB_MESSAGE_UNION     *msg_content,
@@ -419,20 +546,72 @@ public:
               LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_sched);
     void send(LTE_FDD_ENB_MESSAGE_STRUCT &msg);
 
+    // Zero copy, the message is built in a pooled buffer and handed over
+    // by send_msg().  The receive thread returns it to the pool once the
+    // callback is done, a sender that changes its mind uses free_msg().
+    LTE_FDD_ENB_MESSAGE_STRUCT* alloc_msg(LTE_FDD_ENB_MESSAGE_TYPE_ENUM type, LTE_FDD_ENB_DEST_LAYER_ENUM dest_layer);
+    void send_msg(LTE_FDD_ENB_MESSAGE_STRUCT *msg);
+    void free_msg(LTE_FDD_ENB_MESSAGE_STRUCT *msg);
+
+    // Statistics
+    void get_stats(LTE_FDD_ENB_MSGQ_STATS_STRUCT *stats);
+    std::string get_name();
+
+    // Event loop, set_event_loop() replaces the receive thread and must
+    // come before attach_rx().  The rest is called from the loop thread.
+    void set_event_loop(LTE_fdd_enb_event_loop *loop);
+    uint32 receive_msgs(bool *kill);
+    uint32 get_max_msgs();
+    void dispatch_msg(LTE_FDD_ENB_MESSAGE_STRUCT *msg);
+    bool is_msg_pending();
+
 private:
+    // Buffers
+    LTE_FDD_ENB_MSGQ_BUF_STRUCT* pop_buf(LTE_FDD_ENB_MSGQ_POOL_STRUCT *pool, LTE_FDD_ENB_MSGQ_POOL_ENUM pool_idx);
+    void push_buf(LTE_FDD_ENB_MSGQ_BUF_STRUCT *buf);
+    LTE_FDD_ENB_MSGQ_POOL_STRUCT pools[LTE_FDD_ENB_MSGQ_POOL_N_ITEMS];
+
     // Send/Receive
+    bool wait_for_space(LTE_FDD_ENB_MESSAGE_TYPE_ENUM type, uint32 space, uint64 *deadline);
+    LTE_FDD_ENB_MSGQ_SLOT_STRUCT* claim_slot(LTE_FDD_ENB_MESSAGE_TYPE_ENUM type, uint32 *pos);
+    LTE_FDD_ENB_MSGQ_SLOT_STRUCT* try_claim_slot(uint32 *pos);
+    void publish_slot(LTE_FDD_ENB_MSGQ_SLOT_STRUCT *slot, uint32 pos, LTE_FDD_ENB_MESSAGE_STRUCT *msg);
+    bool is_msg_ready(uint32 pos);
+    void wait_for_msg();
+    void release_space();
     static void* receive_thread(void *inputs);
 
     // Variables
-    LTE_fdd_enb_interface                              *interface;
-    LTE_fdd_enb_msgq_cb                                 callback;
-    sem_t                                               sync_sem;
-    sem_t                                               msg_sem;
-    boost::circular_buffer<LTE_FDD_ENB_MESSAGE_STRUCT> *circ_buf;
-    const std::string                                   msgq_name;
-    pthread_t                                           rx_thread;
-    uint32                                              prio;
-    bool                                                rx_setup;
+    LTE_fdd_enb_interface         *interface;
+    LTE_fdd_enb_msgq_cb            callback;
+    LTE_fdd_enb_event_loop        *event_loop;
+    LTE_FDD_ENB_MSGQ_SLOT_STRUCT  *ring;
+    const std::string              msgq_name;
+    pthread_t                      rx_thread;
+    uint32                         prio;
+    uint32                         capacity;
+    uint32                         mask;
+    LTE_FDD_ENB_MSGQ_FULL_ENUM     full_policy;
+    LTE_FDD_ENB_MSGQ_WAKE_ENUM     wake_mode;
+    bool                           single_producer;
+    bool                           rx_setup;
+
+    // Senders and the receiver touch these from different cores, the
+    // padding keeps each group on its own cache line
+    uint8                          pad_0[LTE_FDD_ENB_MSGQ_CACHE_LINE];
+    std::atomic<uint32>            tail;
+    uint8                          pad_1[LTE_FDD_ENB_MSGQ_CACHE_LINE];
+    std::atomic<uint32>            head;
+    std::atomic<uint32>            rx_sleeping;
+    uint8                          pad_2[LTE_FDD_ENB_MSGQ_CACHE_LINE];
+    std::atomic<uint32>            space_seq;
+    std::atomic<uint32>            N_space_waiters;
+    uint8                          pad_3[LTE_FDD_ENB_MSGQ_CACHE_LINE];
+    std::atomic<uint64>            N_sent;
+    std::atomic<uint64>            N_received;
+    std::atomic<uint64>            N_dropped;
+    std::atomic<uint64>            N_full_waits;
+    std::atomic<uint32>            max_depth;
 };
 
 #endif /* __LTE_FDD_ENB_MSGQ_H__ */
@@ -0,0 +1,174 @@
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_pcap.h
+
+    Description: Contains all the definitions for the LTE FDD eNodeB pcap
+                 writer.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+#ifndef __LTE_FDD_ENB_PCAP_H__
+#define __LTE_FDD_ENB_PCAP_H__
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "LTE_fdd_enb_interface.h"
+#include "LTE_fdd_enb_msgq.h"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <sys/time.h>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+#define LTE_FDD_ENB_PCAP_N_SLOTS     512 // Power of 2
+#define LTE_FDD_ENB_PCAP_FLUSH_US    5000
+#define LTE_FDD_ENB_PCAP_ALL_RNTIS   0
+#define LTE_FDD_ENB_PCAP_DEFAULT_DIR "/tmp"
+
+/*******************************************************************************
+                              FORWARD DECLARATIONS
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+typedef enum{
+    LTE_FDD_ENB_PCAP_LINK_LTE = 0,
+    LTE_FDD_ENB_PCAP_LINK_IP,
+    LTE_FDD_ENB_PCAP_LINK_N_ITEMS,
+}LTE_FDD_ENB_PCAP_LINK_ENUM;
+static const char LTE_fdd_enb_pcap_link_text[LTE_FDD_ENB_PCAP_LINK_N_ITEMS][20] = {"LTE_fdd_enodeb",
+                                                                                    "LTE_fdd_enodeb_ip"};
+
+// LTE payloads are packed before they are queued, so a slot holds the
+// largest message either way
+typedef struct{
+    std::atomic<uint32>              seq;
+    struct timeval                   time;
+    LTE_FDD_ENB_PCAP_LINK_ENUM       link;
+    LTE_FDD_ENB_PCAP_DIRECTION_ENUM  dir;
+    uint32                           rnti;
+    uint32                           current_tti;
+    uint32                           N_bytes;
+    uint8                            data[LIBLTE_MAX_MSG_SIZE];
+}LTE_FDD_ENB_PCAP_SLOT_STRUCT;
+
+// Only the writer thread uses these
+typedef struct{
+    std::vector<uint8> buf;
+    uint64             N_bytes; // Written and buffered since opening
+    time_t             open_time;
+    uint32             cnfg_gen;
+    uint32             idx;
+    int32              fd;
+    bool               failed;
+}LTE_FDD_ENB_PCAP_FILE_STRUCT;
+
+typedef struct{
+    uint64 N_msgs;
+    uint64 N_dropped;
+    uint64 N_bytes;
+    uint32 N_files;
+}LTE_FDD_ENB_PCAP_STATS_STRUCT;
+
+/*******************************************************************************
+                              CLASS DECLARATIONS
+*******************************************************************************/
+
+// The sending threads only pack the message into a slot of a ring shared
+// by all of them.  A background thread takes whatever is queued every few
+// milliseconds and writes it with one write per file.  When the ring is
+// full the message is dropped and counted.  Files are opened on the first
+// message, and a new one is started when the size or age limit is hit or
+// the directory changes.
+class LTE_fdd_enb_pcap
+{
+public:
+    // Constructor/Destructor
+    LTE_fdd_enb_pcap(LTE_fdd_enb_interface *iface);
+    ~LTE_fdd_enb_pcap();
+
+    // Start/Stop
+    void start();
+    void stop();
+
+    // Capture
+    void send_lte(LTE_FDD_ENB_PCAP_DIRECTION_ENUM dir, uint32 rnti, uint32 current_tti, uint8 *msg, uint32 N_bits);
+    void send_ip(uint32 rnti, uint8 *msg, uint32 N_bytes);
+
+    // Configuration
+    void set_dir(std::string _dir);
+    void set_rotation(uint32 max_size_mb, uint32 period_s);
+    void set_rnti(uint32 _rnti);
+
+    // Statistics
+    void get_stats(LTE_FDD_ENB_PCAP_STATS_STRUCT *stats);
+
+private:
+    // Capture
+    LTE_FDD_ENB_PCAP_SLOT_STRUCT* claim_slot(uint32 rnti, uint32 *pos);
+    void publish_slot(LTE_FDD_ENB_PCAP_SLOT_STRUCT *slot, uint32 pos);
+
+    // Writer
+    static void* writer_thread(void *inputs);
+    uint32 flush();
+    void append_lte(LTE_FDD_ENB_PCAP_SLOT_STRUCT *slot);
+    void append_ip(LTE_FDD_ENB_PCAP_SLOT_STRUCT *slot);
+    void append_record(LTE_FDD_ENB_PCAP_LINK_ENUM link, struct timeval *time, uint8 *hdr, uint32 N_hdr_bytes, uint8 *data, uint32 N_data_bytes);
+    void open_file(LTE_FDD_ENB_PCAP_LINK_ENUM link, time_t now);
+    void close_file(LTE_FDD_ENB_PCAP_LINK_ENUM link);
+    void write_file(LTE_FDD_ENB_PCAP_LINK_ENUM link);
+
+    // Variables
+    LTE_fdd_enb_interface         *interface;
+    LTE_FDD_ENB_PCAP_SLOT_STRUCT  *ring;
+    std::atomic<uint32>            filter_rnti;
+    uint8                          pad_0[LTE_FDD_ENB_MSGQ_CACHE_LINE];
+    std::atomic<uint32>            tail;
+    std::atomic<uint64>            N_msgs;
+    std::atomic<uint64>            N_dropped;
+    uint8                          pad_1[LTE_FDD_ENB_MSGQ_CACHE_LINE];
+    uint32                         head;
+    LTE_FDD_ENB_PCAP_FILE_STRUCT   files[LTE_FDD_ENB_PCAP_LINK_N_ITEMS];
+    std::mutex                     cnfg_mutex;
+    std::string                    file_dir;
+    uint64                         max_size;
+    uint32                         period;
+    std::atomic<uint32>            cnfg_gen;
+    std::atomic<uint64>            N_bytes;
+    std::atomic<uint32>            N_files;
+    uint64                         N_reported_dropped;
+    pthread_t                      thread;
+    bool                           started;
+    std::atomic<bool>              running;
+};
+
+#endif /* __LTE_FDD_ENB_PCAP_H__ */
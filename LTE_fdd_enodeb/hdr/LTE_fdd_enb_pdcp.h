@@ -74,7 +74,7 @@ public:
     ~LTE_fdd_enb_pdcp();
 
     // Start/Stop
-    void start(LTE_fdd_enb_msgq *from_rlc, LTE_fdd_enb_msgq *from_rrc, LTE_fdd_enb_msgq *from_gw, LTE_fdd_enb_msgq *to_rlc, LTE_fdd_enb_msgq *to_rrc, LTE_fdd_enb_msgq *to_gw);
+    void start(LTE_fdd_enb_msgq *from_rlc, LTE_fdd_enb_msgq *from_rrc, LTE_fdd_enb_msgq *from_gw, LTE_fdd_enb_msgq *to_rlc, LTE_fdd_enb_msgq **to_rrc, LTE_fdd_enb_msgq *to_gw);
     void stop();
 
     // External interface
@@ -91,12 +91,13 @@ private:
     void handle_rrc_msg(LTE_FDD_ENB_MESSAGE_STRUCT &msg);
     void handle_gw_msg(LTE_FDD_ENB_MESSAGE_STRUCT &msg);
     void send_rlc_sdu_ready(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb, LIBLTE_BYTE_MSG_STRUCT *sdu);
+    void send_rlc_sdu_ready(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb, LIBLTE_BYTE_BUF_STRUCT *sdu);
     void send_rrc_pdu_ready(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb, LIBLTE_BIT_MSG_STRUCT *pdu);
     LTE_fdd_enb_msgq *msgq_from_rlc;
     LTE_fdd_enb_msgq *msgq_from_rrc;
     LTE_fdd_enb_msgq *msgq_from_gw;
     LTE_fdd_enb_msgq *msgq_to_rlc;
-    LTE_fdd_enb_msgq *msgq_to_rrc;
+    LTE_fdd_enb_msgq *msgq_to_rrc[LTE_FDD_ENB_MAX_N_CELLS];
     LTE_fdd_enb_msgq *msgq_to_gw;
 
     // RLC Message Handlers
@@ -53,12 +53,27 @@
 #include "LTE_fdd_enb_radio.h"
 #include "LTE_fdd_enb_mac.h"
 #include "liblte_phy.h"
+#include "libtools_ipc_iq_ring.h"
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <time.h>
 
 /*******************************************************************************
                               DEFINES
 *******************************************************************************/
 
+// Pipeline
+#define LTE_FDD_ENB_PHY_N_SUBFR_CTX      8 // Must divide LIBLTE_PHY_TTI_MAX+1
+#define LTE_FDD_ENB_PHY_DL_LEAD_N_SUBFRS 4 // DL N+4 carries the PHICH for UL N
+#define LTE_FDD_ENB_PHY_UL_BUDGET_US     1000
+#define LTE_FDD_ENB_PHY_DL_BUDGET_US     2000
+
+// PUSCH decode pool, the UL worker also decodes so there are N+1 decoders
+#define LTE_FDD_ENB_PHY_N_PUSCH_WORKERS 3
+
+// Direct to UE subframes in flight
+#define LTE_FDD_ENB_PHY_N_UE_IQ_SLOTS 16
 
 /*******************************************************************************
                               FORWARD DECLARATIONS
@@ -69,6 +84,28 @@
                               TYPEDEFS
 *******************************************************************************/
 
+typedef enum{
+    LTE_FDD_ENB_PHY_SUBFR_STATE_IDLE = 0,
+    LTE_FDD_ENB_PHY_SUBFR_STATE_QUEUED,
+}LTE_FDD_ENB_PHY_SUBFR_STATE_ENUM;
+
+// One context per radio TTI: UL decode of N and DL encode of N+4
+typedef struct{
+    LTE_FDD_ENB_RADIO_RX_BUF_STRUCT  rx_buf;
+    struct timespec                  ul_deadline;
+    struct timespec                  dl_deadline;
+    uint32                           ul_tti;
+    uint32                           dl_tti;
+    LTE_FDD_ENB_PHY_SUBFR_STATE_ENUM ul_state;
+    LTE_FDD_ENB_PHY_SUBFR_STATE_ENUM dl_state;
+}LTE_FDD_ENB_PHY_SUBFR_CTX_STRUCT;
+
+class LTE_fdd_enb_phy;
+typedef struct{
+    LTE_fdd_enb_phy   *phy;
+    LIBLTE_PHY_STRUCT *phy_struct;
+    pthread_t          thread;
+}LTE_FDD_ENB_PHY_PUSCH_WORKER_STRUCT;
 
 /*******************************************************************************
                               CLASS DECLARATIONS
@@ -77,7 +114,7 @@
 class LTE_fdd_enb_phy
 {
 public:
-    LTE_fdd_enb_phy(LTE_fdd_enb_interface *iface, LTE_fdd_enb_mac *_mac);
+    LTE_fdd_enb_phy(LTE_fdd_enb_interface *iface, uint8 _cell, LTE_fdd_enb_mac *_mac);
     ~LTE_fdd_enb_phy();
 
     // Start/Stop
@@ -87,6 +124,7 @@ public:
     // External interface
     void update_sys_info(void);
     uint32 get_n_cce(void);
+    void get_late_ttis(uint32 *N_late_ul, uint32 *N_late_dl);
 
     // Radio interface
     void radio_interface(LTE_FDD_ENB_RADIO_TX_BUF_STRUCT *tx_buf, LTE_FDD_ENB_RADIO_RX_BUF_STRUCT *rx_buf);
@@ -96,46 +134,86 @@ private:
     // Start/Stop
     LTE_fdd_enb_interface *interface;
     bool                   started;
+    uint8                  cell;
 
     // Communication
     void handle_mac_msg(LTE_FDD_ENB_MESSAGE_STRUCT &msg);
     void handle_ue_msg(LIBTOOLS_IPC_MSGQ_MESSAGE_STRUCT *msg);
-    LTE_fdd_enb_msgq  *msgq_from_mac;
-    LTE_fdd_enb_msgq  *msgq_to_mac;
-    libtools_ipc_msgq *msgq_to_ue;
+    LTE_fdd_enb_msgq     *msgq_from_mac;
+    LTE_fdd_enb_msgq     *msgq_to_mac;
+    libtools_ipc_msgq    *msgq_to_ue;
+    libtools_ipc_iq_ring *iq_ring_to_ue;
 
     // Generic
     void align_ttis_with_radio(uint32 radio_ul_tti);
-    LIBLTE_PHY_STRUCT *phy_struct;
+
+    // Pipeline
+    static void* ul_thread_func(void *inputs);
+    static void* dl_thread_func(void *inputs);
+    void start_pipeline();
+    void stop_pipeline();
+    bool wait_for_ul(uint32 ul_tti);
+    void set_deadline(struct timespec *now, uint32 budget_us, struct timespec *deadline);
+    bool is_deadline_missed(struct timespec *deadline);
+    std::mutex                        pipe_mutex;
+    std::condition_variable           ul_cond;
+    std::condition_variable           dl_cond;
+    std::condition_variable           ul_done_cond;
+    pthread_t                         ul_thread;
+    pthread_t                         dl_thread;
+    LTE_FDD_ENB_PHY_SUBFR_CTX_STRUCT *subfr_ctx;
+    uint32                            ctx_wr_idx;
+    uint32                            ul_next_tti;
+    std::atomic<uint32>               N_late_ul_ttis;
+    std::atomic<uint32>               N_late_dl_ttis;
+    bool                              pipe_running;
 
     // Downlink
     void handle_phy_schedule(LTE_FDD_ENB_PHY_SCHEDULE_MSG_STRUCT *phy_sched);
     void process_pss_sss();
     void process_pbch(uint32 sfn);
-    void process_pdcch_and_pdsch();
-    void process_dl(LTE_FDD_ENB_RADIO_TX_BUF_STRUCT *tx_buf);
+    void process_pdcch_and_pdsch(uint32 current_tti);
+    void process_dl(uint32 current_tti, LTE_FDD_ENB_PHY_SUBFR_CTX_STRUCT *ctx);
+    void send_dl(uint32 current_tti, bool late);
+    LIBLTE_PHY_STRUCT                  *dl_phy_struct;
     LTE_fdd_enb_radio                  *radio;
     LTE_fdd_enb_mac                    *mac;
     std::mutex                          sys_info_mutex;
     std::mutex                          dl_sched_mutex;
     std::mutex                          ul_sched_mutex;
+    std::mutex                          phich_mutex;
     LTE_FDD_ENB_SYS_INFO_STRUCT         sys_info;
     LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT  dl_schedule[10];
     LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT  ul_schedule[10];
     LIBLTE_PHY_PCFICH_STRUCT            pcfich;
     LIBLTE_PHY_PHICH_STRUCT             phich[10];
+    LIBLTE_PHY_PHICH_STRUCT             dl_phich;
     LIBLTE_PHY_SUBFRAME_STRUCT          dl_subframe;
+    LTE_FDD_ENB_RADIO_TX_BUF_STRUCT    *dl_tx_buf;
     LIBLTE_BIT_MSG_STRUCT               dl_rrc_msg;
     uint32                              dl_current_tti;
 
     // Uplink
-    void process_prach(LTE_FDD_ENB_RADIO_RX_BUF_STRUCT *rx_buf, uint32 sfn);
-    void process_pucch();
-    void process_pusch();
-    void process_ul(LTE_FDD_ENB_RADIO_RX_BUF_STRUCT *rx_buf);
+    void process_prach(LTE_FDD_ENB_RADIO_RX_BUF_STRUCT *rx_buf, uint32 current_tti);
+    void process_pucch(uint32 current_tti);
+    void process_pusch(uint32 current_tti);
+    void process_ul(LTE_FDD_ENB_PHY_SUBFR_CTX_STRUCT *ctx);
+    LIBLTE_PHY_STRUCT                  *ul_phy_struct;
+
+    // PUSCH decode pool
+    static void* pusch_thread_func(void *inputs);
+    void decode_pusch_allocs(LIBLTE_PHY_STRUCT *phy_struct);
+    void decode_pusch_alloc(LIBLTE_PHY_STRUCT *phy_struct, uint32 current_tti, uint32 alloc_idx);
+    std::mutex                          pusch_mutex;
+    std::condition_variable             pusch_cond;
+    std::condition_variable             pusch_done_cond;
+    LTE_FDD_ENB_PHY_PUSCH_WORKER_STRUCT pusch_worker[LTE_FDD_ENB_PHY_N_PUSCH_WORKERS];
+    uint32                              pusch_job_tti;
+    uint32                              pusch_job_N_alloc;
+    uint32                              pusch_job_next;
+    uint32                              pusch_job_N_done;
+    bool                                pusch_running;
     LTE_FDD_ENB_PRACH_DECODE_MSG_STRUCT prach_decode;
-    LTE_FDD_ENB_PUCCH_DECODE_MSG_STRUCT pucch_decode;
-    LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT pusch_decode;
     LIBLTE_PHY_SUBFRAME_STRUCT          ul_subframe;
     uint32                              ul_current_tti;
     uint32                              prach_sfn_mod;
@@ -196,7 +196,7 @@ private:
 class LTE_fdd_enb_radio
 {
 public:
-    LTE_fdd_enb_radio(LTE_fdd_enb_interface *iface, LTE_fdd_enb_phy *_phy);
+    LTE_fdd_enb_radio(LTE_fdd_enb_interface *iface, uint8 _cell, LTE_fdd_enb_phy *_phy);
     ~LTE_fdd_enb_radio();
 
     // Start/Stop
@@ -242,6 +242,7 @@ private:
     uint32                               selected_radio_idx;
     uint32                               tx_gain;
     uint32                               rx_gain;
+    uint8                                cell;
 
     // Specific radios
     LTE_fdd_enb_radio_no_rf     no_rf;
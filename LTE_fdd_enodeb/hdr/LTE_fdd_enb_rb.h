@@ -73,6 +73,8 @@
                               DEFINES
 *******************************************************************************/
 
+// Logical channel prioritization, 36.321 section 5.4.3.1
+#define LTE_FDD_ENB_RB_PBR_INFINITY 0xFFFFFFFF // kbps
 
 /*******************************************************************************
                               FORWARD DECLARATIONS
@@ -214,8 +216,8 @@ public:
     void reset_user(LTE_fdd_enb_user *_user);
 
     // GW
-    void queue_gw_data_msg(LIBLTE_BYTE_MSG_STRUCT *gw_data);
-    LTE_FDD_ENB_ERROR_ENUM get_next_gw_data_msg(LIBLTE_BYTE_MSG_STRUCT **gw_data);
+    void queue_gw_data_msg(LIBLTE_BYTE_BUF_STRUCT *gw_data);
+    LTE_FDD_ENB_ERROR_ENUM get_next_gw_data_msg(LIBLTE_BYTE_BUF_STRUCT **gw_data);
     LTE_FDD_ENB_ERROR_ENUM delete_next_gw_data_msg();
 
     // MME
@@ -248,8 +250,9 @@ public:
     void queue_pdcp_sdu(std::vector<uint8_t> &sdu);
     LTE_FDD_ENB_ERROR_ENUM get_next_pdcp_sdu(LIBLTE_BIT_MSG_STRUCT **sdu);
     LTE_FDD_ENB_ERROR_ENUM delete_next_pdcp_sdu();
-    void queue_pdcp_data_sdu(LIBLTE_BYTE_MSG_STRUCT *sdu);
-    LTE_FDD_ENB_ERROR_ENUM get_next_pdcp_data_sdu(LIBLTE_BYTE_MSG_STRUCT **sdu);
+    void queue_pdcp_data_sdu(LIBLTE_BYTE_BUF_STRUCT *sdu);
+    LTE_FDD_ENB_ERROR_ENUM get_next_pdcp_data_sdu(LIBLTE_BYTE_BUF_STRUCT **sdu);
+    LTE_FDD_ENB_ERROR_ENUM take_next_pdcp_data_sdu(LIBLTE_BYTE_BUF_STRUCT **sdu);
     LTE_FDD_ENB_ERROR_ENUM delete_next_pdcp_data_sdu();
     void set_pdcp_config(LTE_FDD_ENB_PDCP_CONFIG_ENUM config);
     LTE_FDD_ENB_PDCP_CONFIG_ENUM get_pdcp_config();
@@ -262,9 +265,15 @@ public:
     void queue_rlc_pdu(LIBLTE_BYTE_MSG_STRUCT *pdu);
     LTE_FDD_ENB_ERROR_ENUM get_next_rlc_pdu(LIBLTE_BYTE_MSG_STRUCT **pdu);
     LTE_FDD_ENB_ERROR_ENUM delete_next_rlc_pdu();
-    void queue_rlc_sdu(LIBLTE_BYTE_MSG_STRUCT *sdu);
-    LTE_FDD_ENB_ERROR_ENUM get_next_rlc_sdu(LIBLTE_BYTE_MSG_STRUCT **sdu);
+    void queue_rlc_sdu(LIBLTE_BYTE_BUF_STRUCT *sdu);
+    LTE_FDD_ENB_ERROR_ENUM get_next_rlc_sdu(LIBLTE_BYTE_BUF_STRUCT **sdu);
+    LTE_FDD_ENB_ERROR_ENUM take_next_rlc_sdu(LIBLTE_BYTE_BUF_STRUCT **sdu);
     LTE_FDD_ENB_ERROR_ENUM delete_next_rlc_sdu();
+    void rlc_queue_tx_sdu(LIBLTE_BYTE_BUF_STRUCT *sdu);
+    LTE_FDD_ENB_ERROR_ENUM rlc_peek_tx_sdu(uint32 idx, LIBLTE_BYTE_BUF_STRUCT **sdu);
+    uint32 rlc_get_tx_sdu_offset();
+    void rlc_consume_tx_sdu_bytes(uint32 N_bytes);
+    uint32 rlc_get_tx_sdu_queue_bytes();
     LTE_FDD_ENB_RLC_CONFIG_ENUM get_rlc_config();
     uint16 get_rlc_vrr();
     void set_rlc_vrr(uint16 vrr);
@@ -280,11 +289,12 @@ public:
     uint16 get_rlc_vtms();
     uint16 get_rlc_vts();
     void set_rlc_vts(uint16 vts);
-    void rlc_add_to_transmission_buffer(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *amd_pdu);
+    void rlc_add_to_transmission_buffer(uint16 sn, LIBLTE_BYTE_MSG_STRUCT *pdu);
     void rlc_update_transmission_buffer(LIBLTE_RLC_STATUS_PDU_STRUCT *status);
     void rlc_start_t_poll_retransmit();
     void rlc_stop_t_poll_retransmit();
     void handle_t_poll_retransmit_timer_expiry(uint32 timer_id);
+    LTE_FDD_ENB_ERROR_ENUM rlc_t_poll_retransmit_expired(LIBLTE_BYTE_MSG_STRUCT **pdu);
     void set_rlc_vruh(uint16 vruh);
     uint16 get_rlc_vruh();
     void set_rlc_vrur(uint16 vrur);
@@ -304,6 +314,12 @@ public:
     uint64 get_con_res_id();
     void set_send_con_res_id(bool send_con_res_id);
     bool get_send_con_res_id();
+    uint32 get_mac_sdu_queue_bytes();
+    LTE_FDD_ENB_ERROR_ENUM peek_mac_sdu(uint32 idx, LIBLTE_BYTE_MSG_STRUCT **sdu);
+    void set_mac_lcp_config(uint8 priority, uint32 pbr, uint32 bucket_size_duration);
+    uint8 get_mac_lcp_priority();
+    int64 get_mac_lcp_bucket(uint32 current_tti);
+    void consume_mac_lcp_bucket(uint32 N_bytes);
 
     // DRB
     void set_eps_bearer_id(uint32 ebi);
@@ -325,7 +341,7 @@ private:
 
     // GW
     std::mutex                          gw_data_msg_queue_mutex;
-    std::list<LIBLTE_BYTE_MSG_STRUCT *> gw_data_msg_queue;
+    std::list<LIBLTE_BYTE_BUF_STRUCT *> gw_data_msg_queue;
 
     // MME
     std::mutex                          mme_nas_msg_queue_mutex;
@@ -348,7 +364,7 @@ private:
     std::mutex                          pdcp_data_sdu_queue_mutex;
     std::list<LIBLTE_BYTE_MSG_STRUCT *> pdcp_pdu_queue;
     std::list<LIBLTE_BIT_MSG_STRUCT *>  pdcp_sdu_queue;
-    std::list<LIBLTE_BYTE_MSG_STRUCT *> pdcp_data_sdu_queue;
+    std::list<LIBLTE_BYTE_BUF_STRUCT *> pdcp_data_sdu_queue;
     LTE_FDD_ENB_PDCP_CONFIG_ENUM        pdcp_config;
     uint32                              pdcp_rx_count;
     uint32                              pdcp_tx_count;
@@ -357,9 +373,13 @@ private:
     std::mutex                                           rlc_pdu_queue_mutex;
     std::mutex                                           rlc_sdu_queue_mutex;
     std::list<LIBLTE_BYTE_MSG_STRUCT *>                  rlc_pdu_queue;
-    std::list<LIBLTE_BYTE_MSG_STRUCT *>                  rlc_sdu_queue;
+    std::list<LIBLTE_BYTE_BUF_STRUCT *>                  rlc_sdu_queue;
+    std::mutex                                           rlc_tx_sdu_queue_mutex;
+    std::list<LIBLTE_BYTE_BUF_STRUCT *>                  rlc_tx_sdu_queue;
+    uint32                                               rlc_tx_sdu_offset;
+    uint32                                               rlc_tx_sdu_queue_bytes;
     std::map<uint16, LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *> rlc_am_rx_buffer;
-    std::map<uint16, LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *> rlc_am_tx_buffer;
+    std::map<uint16, LIBLTE_BYTE_MSG_STRUCT *>           rlc_am_tx_buffer;
     std::map<uint16, LIBLTE_RLC_UMD_PDU_STRUCT *>        rlc_um_rx_buffer;
     LTE_FDD_ENB_RLC_CONFIG_ENUM                          rlc_config;
     uint32                                               t_poll_retransmit_timer_id;
@@ -382,6 +402,11 @@ private:
     LTE_FDD_ENB_MAC_CONFIG_ENUM         mac_config;
     uint64                              mac_con_res_id;
     bool                                mac_send_con_res_id;
+    uint8                               mac_lcp_priority;
+    uint32                              mac_lcp_pbr;
+    uint32                              mac_lcp_bsd;
+    int64                               mac_lcp_bucket;
+    uint32                              mac_lcp_bucket_tti;
 
     // DRB
     uint32 eps_bearer_id;
@@ -392,10 +417,14 @@ private:
     // Generic
     void queue_msg(LIBLTE_BIT_MSG_STRUCT *msg, std::mutex &mutex, std::list<LIBLTE_BIT_MSG_STRUCT *> *queue);
     void queue_msg(LIBLTE_BYTE_MSG_STRUCT *msg, std::mutex &mutex, std::list<LIBLTE_BYTE_MSG_STRUCT *> *queue);
+    void queue_msg(LIBLTE_BYTE_BUF_STRUCT *msg, std::mutex &mutex, std::list<LIBLTE_BYTE_BUF_STRUCT *> *queue);
     LTE_FDD_ENB_ERROR_ENUM get_next_msg(std::mutex &mutex, std::list<LIBLTE_BIT_MSG_STRUCT *> *queue, LIBLTE_BIT_MSG_STRUCT **msg);
     LTE_FDD_ENB_ERROR_ENUM get_next_msg(std::mutex &mutex, std::list<LIBLTE_BYTE_MSG_STRUCT *> *queue, LIBLTE_BYTE_MSG_STRUCT **msg);
+    LTE_FDD_ENB_ERROR_ENUM get_next_msg(std::mutex &mutex, std::list<LIBLTE_BYTE_BUF_STRUCT *> *queue, LIBLTE_BYTE_BUF_STRUCT **msg);
+    LTE_FDD_ENB_ERROR_ENUM take_next_msg(std::mutex &mutex, std::list<LIBLTE_BYTE_BUF_STRUCT *> *queue, LIBLTE_BYTE_BUF_STRUCT **msg);
     LTE_FDD_ENB_ERROR_ENUM delete_next_msg(std::mutex &mutex, std::list<LIBLTE_BIT_MSG_STRUCT *> *queue);
     LTE_FDD_ENB_ERROR_ENUM delete_next_msg(std::mutex &mutex, std::list<LIBLTE_BYTE_MSG_STRUCT *> *queue);
+    LTE_FDD_ENB_ERROR_ENUM delete_next_msg(std::mutex &mutex, std::list<LIBLTE_BYTE_BUF_STRUCT *> *queue);
 };
 
 #endif /* __LTE_FDD_ENB_RB_H__ */
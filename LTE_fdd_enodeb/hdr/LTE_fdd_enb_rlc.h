@@ -53,6 +53,9 @@
                               DEFINES
 *******************************************************************************/
 
+// Header bytes of a data PDU without length indicators
+#define LTE_FDD_ENB_RLC_UMD_FIXED_HDR_BYTES 2 // 10 bit SN
+#define LTE_FDD_ENB_RLC_AMD_FIXED_HDR_BYTES 2
 
 /*******************************************************************************
                               FORWARD DECLARATIONS
@@ -75,12 +78,13 @@ public:
     ~LTE_fdd_enb_rlc();
 
     // Start/Stop
-    void start(LTE_fdd_enb_msgq *from_mac, LTE_fdd_enb_msgq *from_pdcp, LTE_fdd_enb_msgq *to_mac, LTE_fdd_enb_msgq *to_pdcp);
+    void start(LTE_fdd_enb_msgq *from_mac, LTE_fdd_enb_msgq *from_pdcp, LTE_fdd_enb_msgq **to_mac, LTE_fdd_enb_msgq *to_pdcp);
     void stop();
 
     // External interface
     void update_sys_info();
-    void handle_retransmit(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *amd, LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb);
+    void handle_retransmit(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb);
+    bool build_mac_sdu(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb, uint32 N_bytes, LIBLTE_BYTE_MSG_STRUCT *sdu);
 
 private:
     // Start/Stop
@@ -92,10 +96,11 @@ private:
     void handle_mac_msg(LTE_FDD_ENB_MESSAGE_STRUCT &msg);
     void handle_pdcp_msg(LTE_FDD_ENB_MESSAGE_STRUCT &msg);
     void send_mac_sdu_ready(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb, LIBLTE_BYTE_MSG_STRUCT *sdu);
+    void send_mac_data_ready(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb);
     void send_pdcp_pdu_ready(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb, LIBLTE_BYTE_MSG_STRUCT *pdu);
     LTE_fdd_enb_msgq *msgq_from_mac;
     LTE_fdd_enb_msgq *msgq_from_pdcp;
-    LTE_fdd_enb_msgq *msgq_to_mac;
+    LTE_fdd_enb_msgq *msgq_to_mac[LTE_FDD_ENB_MAX_N_CELLS];
     LTE_fdd_enb_msgq *msgq_to_pdcp;
 
     // MAC Message Handlers
@@ -107,13 +112,19 @@ private:
 
     // PDCP Message Handlers
     void handle_sdu_ready(LTE_FDD_ENB_RLC_SDU_READY_MSG_STRUCT *sdu_ready);
-    void handle_tm_sdu(LIBLTE_BYTE_MSG_STRUCT *sdu, LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb);
-    void handle_um_sdu(LIBLTE_BYTE_MSG_STRUCT *sdu, LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb);
-    void handle_am_sdu(LIBLTE_BYTE_MSG_STRUCT *sdu, LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb);
+    void handle_tm_sdu(LIBLTE_BYTE_BUF_STRUCT *sdu, LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb);
+    void handle_um_sdu(LIBLTE_BYTE_BUF_STRUCT *sdu, LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb);
+    void handle_am_sdu(LIBLTE_BYTE_BUF_STRUCT *sdu, LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb);
 
     // Message Constructors
     void send_status_pdu(LIBLTE_RLC_STATUS_PDU_STRUCT *status_pdu, LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb);
-    void send_amd_pdu(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *amd, LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb);
+    bool build_umd_pdu(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb, uint32 N_bytes, LIBLTE_BYTE_MSG_STRUCT *pdu);
+    bool build_amd_pdu(LTE_fdd_enb_user *user, LTE_fdd_enb_rb *rb, uint32 N_bytes, LIBLTE_BYTE_MSG_STRUCT *pdu);
+    uint32 read_tx_sdus(LTE_fdd_enb_rb *rb, uint32 N_fixed_hdr_bytes, uint32 N_bytes, uint32 N_max_data, LIBLTE_BYTE_MSG_STRUCT **data, LIBLTE_RLC_FI_FIELD_ENUM *fi);
+
+    // Transmit side state is shared by the MAC (PDU requests), the RLC
+    // (STATUS PDUs) and the timer (t-PollRetransmit) threads
+    std::mutex tx_mutex;
 
     // Parameters
     std::mutex                  sys_info_mutex;
@@ -82,7 +82,7 @@
 class LTE_fdd_enb_rrc
 {
 public:
-    LTE_fdd_enb_rrc(LTE_fdd_enb_interface *iface, LTE_fdd_enb_user_mgr *um, LTE_fdd_enb_mac *_mac);
+    LTE_fdd_enb_rrc(LTE_fdd_enb_interface *iface, uint8 _cell, LTE_fdd_enb_user_mgr *um, LTE_fdd_enb_mac *_mac);
     ~LTE_fdd_enb_rrc();
 
     // Start/Stop
@@ -98,6 +98,7 @@ private:
     LTE_fdd_enb_interface *interface;
     std::mutex             start_mutex;
     bool                   started;
+    uint8                  cell;
 
     // Communication
     void handle_pdcp_msg(LTE_FDD_ENB_MESSAGE_STRUCT &msg);
@@ -135,6 +136,8 @@ private:
 
     // Helpers
     void increment_i_sr();
+    void increment_n_1_p_pucch_an();
+    void fill_drx_config(LTE_fdd_enb_user *user, MAC_MainConfig *mac_cnfg);
 
     // Parameters
     LTE_fdd_enb_user_mgr        *user_mgr;
@@ -142,6 +145,7 @@ private:
     std::mutex                   sys_info_mutex;
     LTE_FDD_ENB_SYS_INFO_STRUCT  sys_info;
     uint32                       i_sr;
+    uint32                       n_1_p_pucch_an;
 };
 
 #endif /* __LTE_FDD_ENB_RRC_H__ */
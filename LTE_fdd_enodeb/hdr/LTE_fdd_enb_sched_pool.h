@@ -0,0 +1,225 @@
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_sched_pool.h
+
+    Description: Contains all the definitions for the LTE FDD eNodeB
+                 scheduler entry pools and their intrusive lists.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+#ifndef __LTE_FDD_ENB_SCHED_POOL_H__
+#define __LTE_FDD_ENB_SCHED_POOL_H__
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "typedefs.h"
+#include <mutex>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+#define LTE_FDD_ENB_SCHED_NULL_IDX 0xFFFFFFFF
+
+/*******************************************************************************
+                              FORWARD DECLARATIONS
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+// An entry can be on one list per link at the same time
+typedef enum{
+    LTE_FDD_ENB_SCHED_LINK_QUEUE = 0, // Intake, TTI ring slot, or scheduler queue
+    LTE_FDD_ENB_SCHED_LINK_UE,        // Per-UE queue
+    LTE_FDD_ENB_SCHED_N_LINKS,
+}LTE_FDD_ENB_SCHED_LINK_ENUM;
+
+typedef struct{
+    uint32 prev;
+    uint32 next;
+}LTE_FDD_ENB_SCHED_LINK_STRUCT;
+
+typedef struct{
+    uint32                      head;
+    uint32                      tail;
+    uint32                      size;
+    LTE_FDD_ENB_SCHED_LINK_ENUM link;
+}LTE_FDD_ENB_SCHED_LIST_STRUCT;
+
+/*******************************************************************************
+                              CLASS DECLARATIONS
+*******************************************************************************/
+
+// Fixed number of entries allocated up front, entry_type needs a
+// LTE_FDD_ENB_SCHED_LINK_STRUCT link[LTE_FDD_ENB_SCHED_N_LINKS] member.
+// alloc() and free() may be called from any thread, a list belongs to
+// whoever holds the lock that guards it.
+template<class entry_type, uint32 N_entries>
+class LTE_fdd_enb_sched_pool
+{
+public:
+    // Constructor/Destructor
+    LTE_fdd_enb_sched_pool()
+    {
+        entries = new entry_type[N_entries];
+        for(uint32 i=0; i<N_entries; i++)
+            free_stack[i] = N_entries - 1 - i;
+        N_free = N_entries;
+    }
+    ~LTE_fdd_enb_sched_pool()
+    {
+        delete [] entries;
+    }
+
+    // Entries
+    entry_type* alloc()
+    {
+        std::lock_guard<std::mutex> lock(free_mutex);
+        if(0 == N_free)
+            return NULL;
+        entry_type *entry = &entries[free_stack[--N_free]];
+        for(uint32 i=0; i<LTE_FDD_ENB_SCHED_N_LINKS; i++)
+        {
+            entry->link[i].prev = LTE_FDD_ENB_SCHED_NULL_IDX;
+            entry->link[i].next = LTE_FDD_ENB_SCHED_NULL_IDX;
+        }
+        return entry;
+    }
+    void free(entry_type *entry)
+    {
+        std::lock_guard<std::mutex> lock(free_mutex);
+        free_stack[N_free++] = entry - entries;
+    }
+    uint32 get_n_used()
+    {
+        std::lock_guard<std::mutex> lock(free_mutex);
+        return N_entries - N_free;
+    }
+
+    // Lists
+    static void init_list(LTE_FDD_ENB_SCHED_LIST_STRUCT *list,
+                          LTE_FDD_ENB_SCHED_LINK_ENUM    link)
+    {
+        list->head = LTE_FDD_ENB_SCHED_NULL_IDX;
+        list->tail = LTE_FDD_ENB_SCHED_NULL_IDX;
+        list->size = 0;
+        list->link = link;
+    }
+    entry_type* front(LTE_FDD_ENB_SCHED_LIST_STRUCT *list)
+    {
+        return get_entry(list->head);
+    }
+    entry_type* back(LTE_FDD_ENB_SCHED_LIST_STRUCT *list)
+    {
+        return get_entry(list->tail);
+    }
+    entry_type* next(LTE_FDD_ENB_SCHED_LIST_STRUCT *list,
+                     entry_type                    *entry)
+    {
+        return get_entry(entry->link[list->link].next);
+    }
+    entry_type* prev(LTE_FDD_ENB_SCHED_LIST_STRUCT *list,
+                     entry_type                    *entry)
+    {
+        return get_entry(entry->link[list->link].prev);
+    }
+    void push_back(LTE_FDD_ENB_SCHED_LIST_STRUCT *list,
+                   entry_type                    *entry)
+    {
+        insert_before(list, NULL, entry);
+    }
+    // A NULL pos appends to the list
+    void insert_before(LTE_FDD_ENB_SCHED_LIST_STRUCT *list,
+                       entry_type                    *pos,
+                       entry_type                    *entry)
+    {
+        LTE_FDD_ENB_SCHED_LINK_STRUCT *link = &entry->link[list->link];
+        uint32                         idx  = entry - entries;
+
+        link->next = (NULL == pos) ? LTE_FDD_ENB_SCHED_NULL_IDX : (uint32)(pos - entries);
+        link->prev = (NULL == pos) ? list->tail : pos->link[list->link].prev;
+        if(LTE_FDD_ENB_SCHED_NULL_IDX == link->prev)
+            list->head = idx;
+        else
+            entries[link->prev].link[list->link].next = idx;
+        if(LTE_FDD_ENB_SCHED_NULL_IDX == link->next)
+            list->tail = idx;
+        else
+            entries[link->next].link[list->link].prev = idx;
+        list->size++;
+    }
+    void remove(LTE_FDD_ENB_SCHED_LIST_STRUCT *list,
+                entry_type                    *entry)
+    {
+        LTE_FDD_ENB_SCHED_LINK_STRUCT *link = &entry->link[list->link];
+
+        if(LTE_FDD_ENB_SCHED_NULL_IDX == link->prev)
+            list->head = link->next;
+        else
+            entries[link->prev].link[list->link].next = link->next;
+        if(LTE_FDD_ENB_SCHED_NULL_IDX == link->next)
+            list->tail = link->prev;
+        else
+            entries[link->next].link[list->link].prev = link->prev;
+        link->prev = LTE_FDD_ENB_SCHED_NULL_IDX;
+        link->next = LTE_FDD_ENB_SCHED_NULL_IDX;
+        list->size--;
+    }
+    // Moves all of src to the end of dst, both must use the same link
+    void splice_back(LTE_FDD_ENB_SCHED_LIST_STRUCT *dst,
+                     LTE_FDD_ENB_SCHED_LIST_STRUCT *src)
+    {
+        if(0 == src->size)
+            return;
+        if(0 == dst->size)
+        {
+            dst->head = src->head;
+        }else{
+            entries[dst->tail].link[dst->link].next = src->head;
+            entries[src->head].link[dst->link].prev = dst->tail;
+        }
+        dst->tail  = src->tail;
+        dst->size += src->size;
+        init_list(src, src->link);
+    }
+
+private:
+    entry_type* get_entry(uint32 idx)
+    {
+        if(LTE_FDD_ENB_SCHED_NULL_IDX == idx)
+            return NULL;
+        return &entries[idx];
+    }
+
+    std::mutex  free_mutex;
+    entry_type *entries;
+    uint32      free_stack[N_entries];
+    uint32      N_free;
+};
+
+#endif /* __LTE_FDD_ENB_SCHED_POOL_H__ */
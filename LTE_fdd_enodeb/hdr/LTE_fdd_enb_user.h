@@ -61,12 +61,18 @@
 #include "typedefs.h"
 #include <string>
 #include <mutex>
+#include <atomic>
 
 /*******************************************************************************
                               DEFINES
 *******************************************************************************/
 
 #define LTE_FDD_ENB_USER_INACTIVITY_TIMER_VALUE_MS 10000
+#define LTE_FDD_ENB_USER_TA_FILTER_COEFF           0.25
+#define LTE_FDD_ENB_USER_DL_THRU_WINDOW_N_TTIS     100
+#define LTE_FDD_ENB_USER_UL_THRU_WINDOW_N_TTIS     100
+#define LTE_FDD_ENB_USER_N_LCG                     4 // 36.321 section 6.1.3.1
+#define LTE_FDD_ENB_USER_N_UL_HARQ_PROC            8 // 36.321 section 5.4.2.1
 
 /*******************************************************************************
                               FORWARD DECLARATIONS
@@ -104,6 +110,18 @@ typedef struct{
     LIBLTE_PHY_ALLOCATION_STRUCT alloc;
 }LTE_FDD_ENB_HARQ_INFO_STRUCT;
 
+// DRX parameters as sent in MAC-MainConfig, cycles in subframes and
+// timers in PDCCH subframes (every subframe for FDD)
+typedef struct{
+    uint32 long_cycle;
+    uint32 short_cycle;       // 0 when only the long cycle is used
+    uint32 short_cycle_timer; // Short cycles before falling back to the long cycle
+    uint32 start_offset;
+    uint32 on_duration;
+    uint32 inactivity_timer;
+    uint32 retx_timer;
+}LTE_FDD_ENB_DRX_CNFG_STRUCT;
+
 /*******************************************************************************
                               CLASS DECLARATIONS
 *******************************************************************************/
@@ -112,7 +130,7 @@ class LTE_fdd_enb_user
 {
 public:
     // Constructor/Destructor
-    LTE_fdd_enb_user(LTE_fdd_enb_interface *iface, LTE_fdd_enb_timer_mgr *tm, LTE_fdd_enb_rrc *_rrc, LTE_fdd_enb_rlc *_rlc);
+    LTE_fdd_enb_user(LTE_fdd_enb_interface *iface, LTE_fdd_enb_timer_mgr *tm, uint8 _cell, LTE_fdd_enb_rrc *_rrc, LTE_fdd_enb_rlc *_rlc);
     ~LTE_fdd_enb_user();
 
     // Initialize
@@ -134,6 +152,13 @@ public:
     void set_c_rnti(uint16 _c_rnti);
     uint16 get_c_rnti();
     bool is_c_rnti_set();
+    void set_sps_c_rnti(uint16 _sps_c_rnti);
+    uint16 get_sps_c_rnti();
+    bool is_sps_c_rnti_set();
+    void clear_sps_c_rnti();
+    void set_cell(uint8 _cell, LTE_fdd_enb_rrc *_rrc);
+    uint8 get_cell();
+    LTE_fdd_enb_rrc* get_rrc();
     void set_ip_addr(uint32 addr);
     uint32 get_ip_addr();
     bool is_ip_addr_set();
@@ -197,16 +222,41 @@ public:
     void store_harq_info(uint32 pucch_tti, LIBLTE_MAC_PDU_STRUCT *mac_pdu, LIBLTE_PHY_ALLOCATION_STRUCT *alloc);
     void clear_harq_info(uint32 pucch_tti);
     LTE_FDD_ENB_ERROR_ENUM get_harq_info(uint32 pucch_tti, LIBLTE_MAC_PDU_STRUCT *mac_pdu, LIBLTE_PHY_ALLOCATION_STRUCT *alloc);
-    void set_ul_buffer_size(uint32 N_bytes_in_buffer);
-    void update_ul_buffer_size(uint32 N_bytes_received);
+    void set_ul_buffer_size(uint8 lcg, uint32 N_bytes_in_buffer);
+    void update_ul_buffer_size(uint8 lcg, uint32 N_bytes_received);
     uint32 get_ul_buffer_size();
+    void set_ul_sr_pending(bool pending);
+    bool get_ul_sr_pending();
+    uint8 toggle_ul_ndi(uint32 current_tti);
     uint8 get_mcs();
+    void update_timing_offset(float offset_ts, uint32 current_tti);
+    float get_timing_offset();
+    void reset_timing_offset(uint32 holdoff_tti);
+    void set_dl_cqi(uint8 cqi);
+    uint8 get_dl_cqi();
+    bool is_dl_cqi_set();
+    void update_dl_thru(uint32 current_tti, uint32 N_bits);
+    float get_dl_avg_thru(uint32 current_tti);
+    uint32 get_dl_n_ttis_waiting(uint32 current_tti);
+    void update_ul_thru(uint32 current_tti, uint32 N_bits);
+    float get_ul_avg_thru(uint32 current_tti);
+    uint32 get_ul_n_ttis_waiting(uint32 current_tti);
+    void count_dl_bytes(uint32 N_bytes);
+    void count_ul_bytes(uint32 N_bytes);
+    uint64 get_dl_bytes();
+    uint64 get_ul_bytes();
+    void set_drx_cnfg(LTE_FDD_ENB_DRX_CNFG_STRUCT *cnfg);
+    void clear_drx_cnfg();
+    void start_drx();
+    void stop_drx();
+    bool is_drx_active(uint32 current_tti);
+    uint32 get_drx_cycle();
+    void restart_drx_inactivity_timer(uint32 current_tti);
+    void start_drx_retx_timer(uint32 current_tti);
 
     // Generic
     void set_N_del_ticks(uint32 N_ticks);
     uint32 get_N_del_ticks();
-    uint32 get_max_ul_bytes_per_subfn();
-    uint32 get_max_dl_bytes_per_subfn();
     void start_inactivity_timer(uint32 m_seconds);
     void reset_inactivity_timer(uint32 m_seconds);
     void stop_inactivity_timer();
@@ -218,9 +268,11 @@ private:
     uint64                               temp_id;
     uint32                               c_rnti;
     uint32                               ip_addr;
+    uint16                               sps_c_rnti;
     bool                                 id_set;
     bool                                 guti_set;
     bool                                 c_rnti_set;
+    bool                                 sps_c_rnti_set;
     bool                                 ip_addr_set;
 
     // Security
@@ -255,9 +307,31 @@ private:
     // MAC
     std::mutex                                      harq_buffer_mutex;
     std::map<uint32, LTE_FDD_ENB_HARQ_INFO_STRUCT*> harq_buffer;
-    uint32                                          ul_buffer_size;
+    uint32                                          ul_buffer_size[LTE_FDD_ENB_USER_N_LCG];
+    float                                           ta_offset;
+    uint32                                          ta_holdoff_tti;
+    float                                           dl_avg_thru;
+    uint32                                          dl_thru_tti;
+    float                                           ul_avg_thru;
+    uint32                                          ul_thru_tti;
+    std::atomic<uint64>                             N_dl_bytes; // Only the MAC writes, the metrics read
+    std::atomic<uint64>                             N_ul_bytes;
     uint8                                           harq_process;
     uint8                                           mcs;
+    uint8                                           dl_cqi;
+    bool                                            ta_holdoff;
+    bool                                            dl_cqi_set;
+    bool                                            dl_served;
+    bool                                            ul_served;
+    bool                                            ul_sr_pending;
+    uint8                                           ul_ndi[LTE_FDD_ENB_USER_N_UL_HARQ_PROC];
+    LTE_FDD_ENB_DRX_CNFG_STRUCT                     drx_cnfg;
+    uint32                                          drx_inactivity_tti;
+    uint32                                          drx_retx_tti;
+    bool                                            drx_cnfg_set;
+    bool                                            drx_on; // UE has applied drx_cnfg
+    bool                                            drx_inactivity_running;
+    bool                                            drx_retx_running;
 
     // Generic
     void handle_timer_expiry(uint32 timer_id);
@@ -265,6 +339,7 @@ private:
     LTE_fdd_enb_timer_mgr *timer_mgr;
     LTE_fdd_enb_rrc       *rrc;
     LTE_fdd_enb_rlc       *rlc;
+    uint8                  cell;
     uint32                 N_del_ticks;
     uint32                 inactivity_timer_id;
 };
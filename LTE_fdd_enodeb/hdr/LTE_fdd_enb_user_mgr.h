@@ -51,6 +51,7 @@
 #include "LTE_fdd_enb_user.h"
 #include <string>
 #include <mutex>
+#include <vector>
 
 /*******************************************************************************
                               DEFINES
@@ -66,6 +67,12 @@
                               TYPEDEFS
 *******************************************************************************/
 
+typedef struct{
+    std::string imsi; // Empty until the identity is known
+    uint64      N_dl_bytes;
+    uint64      N_ul_bytes;
+    uint16      c_rnti;
+}LTE_FDD_ENB_USER_TRAFFIC_STRUCT;
 
 /*******************************************************************************
                               CLASS DECLARATIONS
@@ -82,8 +89,10 @@ public:
     LTE_FDD_ENB_ERROR_ENUM release_c_rnti(uint16 c_rnti);
     LTE_FDD_ENB_ERROR_ENUM transfer_c_rnti(LTE_fdd_enb_user *old_user, LTE_fdd_enb_user *new_user);
     LTE_FDD_ENB_ERROR_ENUM reset_c_rnti_timer(uint16 c_rnti);
+    LTE_FDD_ENB_ERROR_ENUM assign_sps_c_rnti(LTE_fdd_enb_user *user, uint16 *sps_c_rnti);
+    void release_sps_c_rnti(LTE_fdd_enb_user *user);
     uint32 get_next_m_tmsi();
-    LTE_FDD_ENB_ERROR_ENUM add_user(LTE_fdd_enb_user **user, LTE_fdd_enb_rrc *rrc, LTE_fdd_enb_rlc *rlc);
+    LTE_FDD_ENB_ERROR_ENUM add_user(LTE_fdd_enb_user **user, uint8 cell, LTE_fdd_enb_rrc *rrc, LTE_fdd_enb_rlc *rlc);
     LTE_FDD_ENB_ERROR_ENUM find_user(std::string imsi, LTE_fdd_enb_user **user);
     LTE_FDD_ENB_ERROR_ENUM find_user(uint16 c_rnti, LTE_fdd_enb_user **user);
     LTE_FDD_ENB_ERROR_ENUM find_user(LIBLTE_MME_EPS_MOBILE_ID_GUTI_STRUCT *guti, LTE_fdd_enb_user **user);
@@ -94,11 +103,15 @@ public:
     LTE_FDD_ENB_ERROR_ENUM del_user(uint16 c_rnti);
     LTE_FDD_ENB_ERROR_ENUM del_user(LIBLTE_MME_EPS_MOBILE_ID_GUTI_STRUCT *guti);
     std::string print_all_users();
+    void get_user_traffic(std::vector<LTE_FDD_ENB_USER_TRAFFIC_STRUCT> &traffic);
 
 private:
     // C-RNTI Timer
     void handle_c_rnti_timer_expiry(uint32 timer_id);
 
+    // SPS C-RNTI, c_rnti_mutex must be held
+    void erase_sps_c_rnti(LTE_fdd_enb_user *user);
+
     // User storage
     LTE_fdd_enb_interface               *interface;
     LTE_fdd_enb_timer_mgr               *timer_mgr;
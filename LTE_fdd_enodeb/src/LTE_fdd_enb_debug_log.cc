@@ -0,0 +1,981 @@
+#line 2 "LTE_fdd_enb_debug_log.cc" // Make __FILE__ omit the path
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_debug_log.cc
+
+    Description: Contains all the implementations for the LTE FDD eNodeB
+                 deferred debug log.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "LTE_fdd_enb_debug_log.h"
+#include "libtools_helpers.h"
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+#define LTE_FDD_ENB_DEBUG_LOG_ALIGN(x)    (((x) + 7) & ~7)
+#define LTE_FDD_ENB_DEBUG_LOG_MAX_FLUSH   1024 // Records per write to the port
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+typedef enum{
+    LTE_FDD_ENB_DEBUG_LOG_LENGTH_NONE = 0,
+    LTE_FDD_ENB_DEBUG_LOG_LENGTH_HH,
+    LTE_FDD_ENB_DEBUG_LOG_LENGTH_H,
+    LTE_FDD_ENB_DEBUG_LOG_LENGTH_L,
+    LTE_FDD_ENB_DEBUG_LOG_LENGTH_LL,
+    LTE_FDD_ENB_DEBUG_LOG_LENGTH_J,
+    LTE_FDD_ENB_DEBUG_LOG_LENGTH_Z,
+    LTE_FDD_ENB_DEBUG_LOG_LENGTH_T,
+    LTE_FDD_ENB_DEBUG_LOG_LENGTH_BIG_L,
+}LTE_FDD_ENB_DEBUG_LOG_LENGTH_ENUM;
+
+// One printf conversion, from the % up to and including the conversion
+typedef struct{
+    const char                        *flags;
+    const char                        *width;
+    const char                        *prec;
+    const char                        *end;
+    uint32                             N_flags;
+    uint32                             N_width;
+    uint32                             N_prec;
+    LTE_FDD_ENB_DEBUG_LOG_LENGTH_ENUM  length;
+    char                               conv;
+    bool                               width_arg;
+    bool                               has_prec;
+    bool                               prec_arg;
+}LTE_FDD_ENB_DEBUG_LOG_SPEC_STRUCT;
+
+// Marks the ring of a thread for cleanup when the thread exits.  If the
+// debug log was destroyed first it already let go of the ring, so the
+// thread frees it.
+struct LTE_fdd_enb_debug_log_thread_ring
+{
+    ~LTE_fdd_enb_debug_log_thread_ring()
+    {
+        if(NULL != ring &&
+           ring->closed.exchange(true))
+        {
+            delete [] ring->buf;
+            delete ring;
+        }
+    }
+    LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT *ring;
+};
+
+/*******************************************************************************
+                              GLOBAL VARIABLES
+*******************************************************************************/
+
+static thread_local LTE_fdd_enb_debug_log_thread_ring thread_ring;
+
+/*******************************************************************************
+                              LOCAL FUNCTIONS
+*******************************************************************************/
+
+static const char* parse_spec(const char                        *c,
+                              LTE_FDD_ENB_DEBUG_LOG_SPEC_STRUCT *spec)
+{
+    memset(spec, 0, sizeof(LTE_FDD_ENB_DEBUG_LOG_SPEC_STRUCT));
+
+    spec->flags = c;
+    while('-' == *c || '+' == *c || ' ' == *c || '#' == *c || '0' == *c)
+        c++;
+    spec->N_flags = c - spec->flags;
+
+    spec->width = c;
+    if('*' == *c)
+    {
+        spec->width_arg = true;
+        c++;
+    }else{
+        while('0' <= *c && '9' >= *c)
+            c++;
+    }
+    spec->N_width = c - spec->width;
+
+    if('.' == *c)
+    {
+        spec->has_prec = true;
+        spec->prec     = ++c;
+        if('*' == *c)
+        {
+            spec->prec_arg = true;
+            c++;
+        }else{
+            while('0' <= *c && '9' >= *c)
+                c++;
+        }
+        spec->N_prec = c - spec->prec;
+    }
+
+    switch(*c)
+    {
+    case 'h':
+        spec->length = ('h' == c[1]) ? LTE_FDD_ENB_DEBUG_LOG_LENGTH_HH : LTE_FDD_ENB_DEBUG_LOG_LENGTH_H;
+        c           += ('h' == c[1]) ? 2 : 1;
+        break;
+    case 'l':
+        spec->length = ('l' == c[1]) ? LTE_FDD_ENB_DEBUG_LOG_LENGTH_LL : LTE_FDD_ENB_DEBUG_LOG_LENGTH_L;
+        c           += ('l' == c[1]) ? 2 : 1;
+        break;
+    case 'j':
+        spec->length = LTE_FDD_ENB_DEBUG_LOG_LENGTH_J;
+        c++;
+        break;
+    case 'z':
+        spec->length = LTE_FDD_ENB_DEBUG_LOG_LENGTH_Z;
+        c++;
+        break;
+    case 't':
+        spec->length = LTE_FDD_ENB_DEBUG_LOG_LENGTH_T;
+        c++;
+        break;
+    case 'L':
+        spec->length = LTE_FDD_ENB_DEBUG_LOG_LENGTH_BIG_L;
+        c++;
+        break;
+    default:
+        break;
+    }
+
+    spec->conv = *c;
+    if('\0' != *c)
+        c++;
+    spec->end = c;
+    return c;
+}
+static int64 capture_signed(LTE_FDD_ENB_DEBUG_LOG_LENGTH_ENUM length,
+                            va_list                          *args)
+{
+    switch(length)
+    {
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_HH:
+        return (signed char)va_arg(*args, int);
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_H:
+        return (short)va_arg(*args, int);
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_L:
+        return va_arg(*args, long);
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_LL:
+        return va_arg(*args, long long);
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_J:
+        return va_arg(*args, intmax_t);
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_Z:
+        return (int64)va_arg(*args, size_t);
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_T:
+        return va_arg(*args, ptrdiff_t);
+    default:
+        return va_arg(*args, int);
+    }
+}
+static uint64 capture_unsigned(LTE_FDD_ENB_DEBUG_LOG_LENGTH_ENUM length,
+                               va_list                          *args)
+{
+    switch(length)
+    {
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_HH:
+        return (unsigned char)va_arg(*args, unsigned int);
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_H:
+        return (unsigned short)va_arg(*args, unsigned int);
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_L:
+        return va_arg(*args, unsigned long);
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_LL:
+        return va_arg(*args, unsigned long long);
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_J:
+        return va_arg(*args, uintmax_t);
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_Z:
+        return va_arg(*args, size_t);
+    case LTE_FDD_ENB_DEBUG_LOG_LENGTH_T:
+        return (uint64)va_arg(*args, ptrdiff_t);
+    default:
+        return va_arg(*args, unsigned int);
+    }
+}
+
+// Copies the arguments named by the format string into 8 byte slots,
+// strings are a length slot followed by the characters.  Clears complete
+// and stops at a string longer than a slot, at a conversion it doesn't
+// know or when out of space, the caller formats those calls itself.
+static uint32 capture_args(const char *fmt,
+                           va_list     args,
+                           uint8      *buf,
+                           bool       *complete)
+{
+    LTE_FDD_ENB_DEBUG_LOG_SPEC_STRUCT  spec;
+    const char                        *c = fmt;
+    const char                        *str;
+    va_list                            ap;
+    uint64                             slot;
+    double                             dbl;
+    uint32                             N = 0;
+    uint32                             len;
+
+    *complete = true;
+    va_copy(ap, args);
+    while('\0' != *c)
+    {
+        if('%' != *c++)
+            continue;
+        if('%' == *c)
+        {
+            c++;
+            continue;
+        }
+        c = parse_spec(c, &spec);
+
+        // Widest case is both stars and a string
+        if(N + 3*sizeof(uint64) + LTE_FDD_ENB_DEBUG_LOG_MAX_STRING_SIZE > LTE_FDD_ENB_DEBUG_LOG_MAX_ARGS_SIZE)
+        {
+            *complete = false;
+            break;
+        }
+        if(spec.width_arg)
+        {
+            slot = (int64)va_arg(ap, int);
+            memcpy(&buf[N], &slot, sizeof(slot));
+            N += sizeof(slot);
+        }
+        if(spec.prec_arg)
+        {
+            slot = (int64)va_arg(ap, int);
+            memcpy(&buf[N], &slot, sizeof(slot));
+            N += sizeof(slot);
+        }
+
+        switch(spec.conv)
+        {
+        case 'd':
+        case 'i':
+            slot = capture_signed(spec.length, &ap);
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            slot = capture_unsigned(spec.length, &ap);
+            break;
+        case 'c':
+            slot = (int64)va_arg(ap, int);
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            if(LTE_FDD_ENB_DEBUG_LOG_LENGTH_BIG_L == spec.length)
+                dbl = (double)va_arg(ap, long double);
+            else
+                dbl = va_arg(ap, double);
+            memcpy(&slot, &dbl, sizeof(slot));
+            break;
+        case 'p':
+            slot = (uint64)(uintptr_t)va_arg(ap, void *);
+            break;
+        case 's':
+            str = va_arg(ap, const char *);
+            if(NULL == str)
+                str = "(null)";
+            len = strnlen(str, LTE_FDD_ENB_DEBUG_LOG_MAX_STRING_SIZE + 1);
+            if(LTE_FDD_ENB_DEBUG_LOG_MAX_STRING_SIZE < len)
+            {
+                *complete = false;
+                va_end(ap);
+                return N;
+            }
+            slot = len;
+            memcpy(&buf[N], &slot, sizeof(slot));
+            memcpy(&buf[N + sizeof(slot)], str, len);
+            N += sizeof(slot) + LTE_FDD_ENB_DEBUG_LOG_ALIGN(len);
+            continue;
+        case 'n':
+            va_arg(ap, void *);
+            continue;
+        default:
+            *complete = false;
+            va_end(ap);
+            return N;
+        }
+        memcpy(&buf[N], &slot, sizeof(slot));
+        N += sizeof(slot);
+    }
+    va_end(ap);
+
+    return N;
+}
+static void append_formatted(std::string &out,
+                             const char  *spec,
+                             ...)
+{
+    va_list args;
+    char    tmp[256];
+    int32   N;
+
+    va_start(args, spec);
+    N = vsnprintf(tmp, sizeof(tmp), spec, args);
+    va_end(args);
+    if(0 > N)
+        return;
+    if((uint32)N < sizeof(tmp))
+    {
+        out.append(tmp, N);
+        return;
+    }
+
+    std::vector<char> big(N + 1);
+    va_start(args, spec);
+    vsnprintf(big.data(), big.size(), spec, args);
+    va_end(args);
+    out.append(big.data(), N);
+}
+static void append_hex(std::string &out,
+                       const uint8 *bytes,
+                       uint32       N_nibbles)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    uint32            i;
+
+    for(i=0; i<N_nibbles; i++)
+        out += hex[(bytes[i/2] >> ((i % 2) ? 0 : 4)) & 0xF];
+}
+
+// Formats on the calling thread, the text is cut to what a record can
+// hold and the cut is marked
+static void format_now(const char  *fmt,
+                       va_list      args,
+                       std::string &out)
+{
+    static const char truncated[] = "...<truncated>";
+    va_list           ap;
+    int32             N;
+
+    va_copy(ap, args);
+    N = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if(0 > N)
+        return;
+
+    out.resize(N + 1);
+    va_copy(ap, args);
+    vsnprintf(&out[0], out.size(), fmt, ap);
+    va_end(ap);
+    out.resize(N);
+    if(LTE_FDD_ENB_DEBUG_LOG_MAX_TEXT_SIZE < out.length())
+    {
+        out.resize(LTE_FDD_ENB_DEBUG_LOG_MAX_TEXT_SIZE - (sizeof(truncated) - 1));
+        out += truncated;
+    }
+}
+
+/*******************************************************************************
+                              CLASS IMPLEMENTATIONS
+*******************************************************************************/
+
+/********************************/
+/*    Constructor/Destructor    */
+/********************************/
+LTE_fdd_enb_debug_log::LTE_fdd_enb_debug_log(LTE_fdd_enb_interface *iface) :
+    interface{iface}, started{false}, N_closed_msgs{0}, N_closed_dropped{0},
+    N_reported_dropped{0}
+{
+    running.store(false);
+}
+LTE_fdd_enb_debug_log::~LTE_fdd_enb_debug_log()
+{
+    stop();
+
+    // Threads still running keep logging into their rings, so only the
+    // rings of exited threads go now.  The others are closed here and
+    // freed by their thread when it exits.
+    for(auto ring : rings)
+    {
+        if(ring->closed.exchange(true))
+        {
+            delete [] ring->buf;
+            delete ring;
+        }
+    }
+}
+
+/********************/
+/*    Start/Stop    */
+/********************/
+void LTE_fdd_enb_debug_log::start()
+{
+    if(started)
+        return;
+    running.store(true);
+    pthread_create(&thread, NULL, &formatter_thread, this);
+    started = true;
+}
+void LTE_fdd_enb_debug_log::stop()
+{
+    if(!started)
+        return;
+    running.store(false);
+    pthread_join(thread, NULL);
+    started = false;
+}
+
+/*****************/
+/*    Logging    */
+/*****************/
+void LTE_fdd_enb_debug_log::log(LTE_FDD_ENB_DEBUG_TYPE_ENUM   type,
+                                LTE_FDD_ENB_DEBUG_LEVEL_ENUM  level,
+                                const char                   *file_name,
+                                int32                         line,
+                                const char                   *fmt,
+                                va_list                       args)
+{
+    LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT   *ring;
+    LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *rec;
+
+    rec = start_record(&ring, type, level, file_name, line, fmt, args,
+                       LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_NONE, 0, 0);
+    if(NULL != rec)
+        finish_record(ring, rec);
+}
+void LTE_fdd_enb_debug_log::log_bits(LTE_FDD_ENB_DEBUG_TYPE_ENUM   type,
+                                     LTE_FDD_ENB_DEBUG_LEVEL_ENUM  level,
+                                     const char                   *file_name,
+                                     int32                         line,
+                                     const uint8                  *bits,
+                                     uint32                        N_bits,
+                                     const char                   *fmt,
+                                     va_list                       args)
+{
+    LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT   *ring;
+    LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *rec;
+    uint8                               *payload;
+    uint32                               N_bytes = (N_bits + 7) / 8;
+    uint32                               i;
+
+    if(LTE_FDD_ENB_DEBUG_LOG_MAX_PAYLOAD_SIZE < N_bytes)
+        N_bytes = LTE_FDD_ENB_DEBUG_LOG_MAX_PAYLOAD_SIZE;
+    rec = start_record(&ring, type, level, file_name, line, fmt, args,
+                       LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_BITS, N_bits, N_bytes);
+    if(NULL == rec)
+        return;
+
+    // One bit per byte on the way in, packed on the way out
+    payload = (uint8 *)(rec + 1) + rec->N_args_bytes;
+    memset(payload, 0, N_bytes);
+    for(i=0; i<N_bits && i<N_bytes*8; i++)
+        payload[i/8] |= (bits[i] & 1) << (7 - (i % 8));
+    finish_record(ring, rec);
+}
+void LTE_fdd_enb_debug_log::log_bits(LTE_FDD_ENB_DEBUG_TYPE_ENUM   type,
+                                     LTE_FDD_ENB_DEBUG_LEVEL_ENUM  level,
+                                     const char                   *file_name,
+                                     int32                         line,
+                                     std::vector<bool>            &bits,
+                                     const char                   *fmt,
+                                     va_list                       args)
+{
+    LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT   *ring;
+    LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *rec;
+    uint8                               *payload;
+    uint32                               N_bits  = bits.size();
+    uint32                               N_bytes = (N_bits + 7) / 8;
+    uint32                               i;
+
+    if(LTE_FDD_ENB_DEBUG_LOG_MAX_PAYLOAD_SIZE < N_bytes)
+        N_bytes = LTE_FDD_ENB_DEBUG_LOG_MAX_PAYLOAD_SIZE;
+    rec = start_record(&ring, type, level, file_name, line, fmt, args,
+                       LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_BITS, N_bits, N_bytes);
+    if(NULL == rec)
+        return;
+
+    payload = (uint8 *)(rec + 1) + rec->N_args_bytes;
+    memset(payload, 0, N_bytes);
+    for(i=0; i<N_bits && i<N_bytes*8; i++)
+        payload[i/8] |= bits[i] << (7 - (i % 8));
+    finish_record(ring, rec);
+}
+void LTE_fdd_enb_debug_log::log_bytes(LTE_FDD_ENB_DEBUG_TYPE_ENUM   type,
+                                      LTE_FDD_ENB_DEBUG_LEVEL_ENUM  level,
+                                      const char                   *file_name,
+                                      int32                         line,
+                                      const uint8                  *bytes,
+                                      uint32                        N_bytes,
+                                      const char                   *fmt,
+                                      va_list                       args)
+{
+    LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT   *ring;
+    LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *rec;
+    uint32                               N_kept = N_bytes;
+
+    if(LTE_FDD_ENB_DEBUG_LOG_MAX_PAYLOAD_SIZE < N_kept)
+        N_kept = LTE_FDD_ENB_DEBUG_LOG_MAX_PAYLOAD_SIZE;
+    rec = start_record(&ring, type, level, file_name, line, fmt, args,
+                       LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_BYTES, N_bytes, N_kept);
+    if(NULL == rec)
+        return;
+
+    memcpy((uint8 *)(rec + 1) + rec->N_args_bytes, bytes, N_kept);
+    finish_record(ring, rec);
+}
+void LTE_fdd_enb_debug_log::log_size(LTE_FDD_ENB_DEBUG_TYPE_ENUM   type,
+                                     LTE_FDD_ENB_DEBUG_LEVEL_ENUM  level,
+                                     const char                   *file_name,
+                                     int32                         line,
+                                     uint32                        N_bytes,
+                                     const char                   *fmt,
+                                     va_list                       args)
+{
+    LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT   *ring;
+    LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *rec;
+
+    rec = start_record(&ring, type, level, file_name, line, fmt, args,
+                       LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_SIZE, N_bytes, 0);
+    if(NULL != rec)
+        finish_record(ring, rec);
+}
+LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT* LTE_fdd_enb_debug_log::get_thread_ring()
+{
+    if(NULL == thread_ring.ring)
+    {
+        LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT *ring = new LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT;
+        ring->buf = new uint8[LTE_FDD_ENB_DEBUG_LOG_RING_SIZE];
+        ring->wr.store(0);
+        ring->rd.store(0);
+        ring->N_msgs.store(0);
+        ring->N_dropped.store(0);
+        ring->closed.store(false);
+
+        std::lock_guard<std::mutex> lock(rings_mutex);
+        rings.push_back(ring);
+        thread_ring.ring = ring;
+    }
+    return thread_ring.ring;
+}
+LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT* LTE_fdd_enb_debug_log::start_record(LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT  **ring,
+                                                                         LTE_FDD_ENB_DEBUG_TYPE_ENUM          type,
+                                                                         LTE_FDD_ENB_DEBUG_LEVEL_ENUM         level,
+                                                                         const char                          *file_name,
+                                                                         int32                                line,
+                                                                         const char                          *fmt,
+                                                                         va_list                              args,
+                                                                         LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_ENUM   payload_type,
+                                                                         uint32                               payload_size,
+                                                                         uint32                               N_payload_bytes)
+{
+    LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *rec;
+    LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *pad;
+    uint8                                args_buf[LTE_FDD_ENB_DEBUG_LOG_MAX_ARGS_SIZE];
+    std::string                          text;
+    uint64                               wr;
+    uint64                               slot;
+    uint32                               N_args_bytes;
+    uint32                               size;
+    uint32                               to_end;
+    uint32                               skip = 0;
+    bool                                 complete;
+
+    *ring        = get_thread_ring();
+    N_args_bytes = capture_args(fmt, args, args_buf, &complete);
+
+    // Calls the arguments can't be kept for are formatted here instead and
+    // logged as a single string, so long strings are not cut short
+    if(!complete)
+    {
+        format_now(fmt, args, text);
+        fmt          = "%s";
+        N_args_bytes = sizeof(slot) + LTE_FDD_ENB_DEBUG_LOG_ALIGN(text.length());
+    }
+    size = sizeof(LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT) + N_args_bytes + LTE_FDD_ENB_DEBUG_LOG_ALIGN(N_payload_bytes);
+
+    // Records never wrap, the end of the ring is padded out instead
+    wr     = (*ring)->wr.load(std::memory_order_relaxed);
+    to_end = LTE_FDD_ENB_DEBUG_LOG_RING_SIZE - (wr % LTE_FDD_ENB_DEBUG_LOG_RING_SIZE);
+    if(to_end < size)
+        skip = to_end;
+    if(wr + skip + size - (*ring)->rd.load(std::memory_order_acquire) > LTE_FDD_ENB_DEBUG_LOG_RING_SIZE)
+    {
+        (*ring)->N_dropped.fetch_add(1, std::memory_order_relaxed);
+        return NULL;
+    }
+    if(0 != skip)
+    {
+        // Too little room for a header means the reader skips it anyway
+        if(sizeof(LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT) <= skip)
+        {
+            pad       = (LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *)&(*ring)->buf[wr % LTE_FDD_ENB_DEBUG_LOG_RING_SIZE];
+            pad->fmt  = NULL;
+            pad->size = skip;
+        }
+        wr += skip;
+    }
+
+    rec                  = (LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *)&(*ring)->buf[wr % LTE_FDD_ENB_DEBUG_LOG_RING_SIZE];
+    gettimeofday(&rec->time, NULL);
+    rec->file_name       = file_name;
+    rec->fmt             = fmt;
+    rec->size            = size;
+    rec->line            = line;
+    rec->N_args_bytes    = N_args_bytes;
+    rec->payload_size    = payload_size;
+    rec->N_payload_bytes = N_payload_bytes;
+    rec->type            = type;
+    rec->level           = level;
+    rec->payload_type    = payload_type;
+    if(complete)
+    {
+        memcpy(rec + 1, args_buf, N_args_bytes);
+    }else{
+        slot = text.length();
+        memcpy(rec + 1, &slot, sizeof(slot));
+        memcpy((uint8 *)(rec + 1) + sizeof(slot), text.data(), text.length());
+    }
+
+    return rec;
+}
+void LTE_fdd_enb_debug_log::finish_record(LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT   *ring,
+                                          LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *rec)
+{
+    uint64 wr  = ring->wr.load(std::memory_order_relaxed);
+    uint64 pos = (uint8 *)rec - ring->buf;
+
+    // Takes in any padding at the end of the ring before the record
+    wr += (pos + LTE_FDD_ENB_DEBUG_LOG_RING_SIZE - (wr % LTE_FDD_ENB_DEBUG_LOG_RING_SIZE)) % LTE_FDD_ENB_DEBUG_LOG_RING_SIZE;
+    ring->wr.store(wr + rec->size, std::memory_order_release);
+    ring->N_msgs.fetch_add(1, std::memory_order_relaxed);
+}
+
+/********************/
+/*    Statistics    */
+/********************/
+void LTE_fdd_enb_debug_log::get_stats(LTE_FDD_ENB_DEBUG_LOG_STATS_STRUCT *stats)
+{
+    std::lock_guard<std::mutex> lock(rings_mutex);
+
+    stats->N_msgs    = N_closed_msgs;
+    stats->N_dropped = N_closed_dropped;
+    stats->N_threads = 0;
+    for(auto ring : rings)
+    {
+        stats->N_msgs    += ring->N_msgs.load(std::memory_order_relaxed);
+        stats->N_dropped += ring->N_dropped.load(std::memory_order_relaxed);
+        if(!ring->closed.load())
+            stats->N_threads++;
+    }
+}
+
+/*******************/
+/*    Formatter    */
+/*******************/
+void* LTE_fdd_enb_debug_log::formatter_thread(void *inputs)
+{
+    LTE_fdd_enb_debug_log *debug_log = (LTE_fdd_enb_debug_log *)inputs;
+
+    debug_log->interface->setup_thread(LTE_FDD_ENB_THREAD_STACK, 0, "debug_log");
+
+    while(debug_log->running.load())
+    {
+        if(0 == debug_log->flush())
+            usleep(LTE_FDD_ENB_DEBUG_LOG_FLUSH_US);
+    }
+
+    // Whatever was logged before the stop still goes out
+    while(0 != debug_log->flush());
+
+    return NULL;
+}
+uint32 LTE_fdd_enb_debug_log::flush()
+{
+    std::vector<LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT *>  snapshot;
+    LTE_FDD_ENB_DEBUG_LOG_STATS_STRUCT                stats;
+    LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT              *rec;
+    LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT              *oldest;
+    LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT                *oldest_ring;
+    std::string                                       out;
+    uint32                                            N_recs = 0;
+
+    rings_mutex.lock();
+    snapshot = rings;
+    rings_mutex.unlock();
+
+    // Merge the rings in time order
+    while(N_recs < LTE_FDD_ENB_DEBUG_LOG_MAX_FLUSH)
+    {
+        oldest      = NULL;
+        oldest_ring = NULL;
+        for(auto ring : snapshot)
+        {
+            rec = next_record(ring);
+            if(NULL != rec &&
+               (NULL == oldest ||
+                timercmp(&rec->time, &oldest->time, <)))
+            {
+                oldest      = rec;
+                oldest_ring = ring;
+            }
+        }
+        if(NULL == oldest)
+            break;
+
+        format_record(oldest, out);
+        oldest_ring->rd.store(oldest_ring->rd.load(std::memory_order_relaxed) + oldest->size, std::memory_order_release);
+        N_recs++;
+    }
+
+    // Rings of exited threads go once they are empty, closed is read
+    // first so the last record of the thread is seen
+    rings_mutex.lock();
+    for(auto it = rings.begin(); it != rings.end();)
+    {
+        LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT *ring = *it;
+        if(ring->closed.load() &&
+           ring->rd.load() == ring->wr.load())
+        {
+            N_closed_msgs    += ring->N_msgs.load();
+            N_closed_dropped += ring->N_dropped.load();
+            delete [] ring->buf;
+            delete ring;
+            it = rings.erase(it);
+        }else{
+            it++;
+        }
+    }
+    rings_mutex.unlock();
+
+    get_stats(&stats);
+    if(stats.N_dropped != N_reported_dropped)
+    {
+        get_formatted_time(out);
+        append_formatted(out,
+                         " %s %s %s %d Dropped %llu debug messages\n",
+                         LTE_fdd_enb_debug_type_text[LTE_FDD_ENB_DEBUG_TYPE_WARNING],
+                         LTE_fdd_enb_debug_level_text[LTE_FDD_ENB_DEBUG_LEVEL_IFACE],
+                         __FILE__,
+                         __LINE__,
+                         stats.N_dropped - N_reported_dropped);
+        N_reported_dropped = stats.N_dropped;
+    }
+
+    if(0 != out.size())
+        interface->send_debug_output(out);
+
+    return N_recs;
+}
+void LTE_fdd_enb_debug_log::format_record(LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *rec,
+                                          std::string                         &out)
+{
+    uint8 *payload = (uint8 *)(rec + 1) + rec->N_args_bytes;
+    bool   cut     = false;
+
+    get_formatted_time(&rec->time, out);
+    out += " ";
+    out += LTE_fdd_enb_debug_type_text[rec->type];
+    out += " ";
+    out += LTE_fdd_enb_debug_level_text[rec->level];
+    out += " ";
+    out += rec->file_name;
+    out += " ";
+    out += std::to_string(rec->line);
+    out += " ";
+    format_args(rec->fmt, (uint8 *)(rec + 1), rec->N_args_bytes, out);
+
+    switch(rec->payload_type)
+    {
+    case LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_BITS:
+        cut  = rec->N_payload_bytes*8 < rec->payload_size;
+        out += " ";
+        append_hex(out, payload, cut ? rec->N_payload_bytes*2 : (rec->payload_size + 3) / 4);
+        break;
+    case LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_BYTES:
+        cut  = rec->N_payload_bytes < rec->payload_size;
+        out += " msg_size=" + std::to_string(rec->payload_size);
+        if(0 < rec->payload_size)
+        {
+            out += " ";
+            append_hex(out, payload, rec->N_payload_bytes*2);
+        }
+        break;
+    case LTE_FDD_ENB_DEBUG_LOG_PAYLOAD_SIZE:
+        out += " msg_size=" + std::to_string(rec->payload_size);
+        break;
+    default:
+        break;
+    }
+    if(cut)
+        out += "...";
+    out += "\n";
+}
+void LTE_fdd_enb_debug_log::format_args(const char  *fmt,
+                                        uint8       *args,
+                                        uint32       N_args_bytes,
+                                        std::string &out)
+{
+    LTE_FDD_ENB_DEBUG_LOG_SPEC_STRUCT  spec;
+    const char                        *c = fmt;
+    const char                        *start;
+    std::string                        spec_str;
+    uint64                             slot;
+    int64                              prec;
+    double                             dbl;
+    uint32                             N = 0;
+
+    while('\0' != *c)
+    {
+        if('%' != *c)
+        {
+            out += *c++;
+            continue;
+        }
+        start = c++;
+        if('%' == *c)
+        {
+            out += *c++;
+            continue;
+        }
+        c = parse_spec(c, &spec);
+        if('n' == spec.conv)
+            continue;
+
+        // Out of arguments, the rest goes out as it is
+        if(N + (spec.width_arg + spec.prec_arg + 1)*sizeof(slot) > N_args_bytes)
+        {
+            out += start;
+            return;
+        }
+
+        spec_str = "%";
+        spec_str.append(spec.flags, spec.N_flags);
+        if(spec.width_arg)
+        {
+            memcpy(&slot, &args[N], sizeof(slot));
+            N        += sizeof(slot);
+            spec_str += std::to_string((int64)slot);
+        }else{
+            spec_str.append(spec.width, spec.N_width);
+        }
+        prec = -1;
+        if(spec.prec_arg)
+        {
+            memcpy(&slot, &args[N], sizeof(slot));
+            N    += sizeof(slot);
+            prec  = (int64)slot;
+        }else if(spec.has_prec){
+            prec = atoi(std::string(spec.prec, spec.N_prec).c_str());
+        }
+        memcpy(&slot, &args[N], sizeof(slot));
+        N += sizeof(slot);
+
+        if('s' == spec.conv)
+        {
+            // The kept characters are not terminated, so the length is
+            // the precision unless a shorter one was asked for
+            if(N + LTE_FDD_ENB_DEBUG_LOG_ALIGN(slot) > N_args_bytes)
+            {
+                out += start;
+                return;
+            }
+            if(0 > prec || (uint64)prec > slot)
+                prec = slot;
+            spec_str += ".*s";
+            append_formatted(out, spec_str.c_str(), (int)prec, (const char *)&args[N]);
+            N += LTE_FDD_ENB_DEBUG_LOG_ALIGN(slot);
+            continue;
+        }
+        if(0 <= prec)
+            spec_str += "." + std::to_string(prec);
+
+        switch(spec.conv)
+        {
+        case 'd':
+        case 'i':
+            spec_str += "ll";
+            spec_str += spec.conv;
+            append_formatted(out, spec_str.c_str(), (long long)slot);
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            spec_str += "ll";
+            spec_str += spec.conv;
+            append_formatted(out, spec_str.c_str(), (unsigned long long)slot);
+            break;
+        case 'c':
+            spec_str += spec.conv;
+            append_formatted(out, spec_str.c_str(), (int)slot);
+            break;
+        case 'e':
+        case 'E':
+        case 'f':
+        case 'F':
+        case 'g':
+        case 'G':
+        case 'a':
+        case 'A':
+            memcpy(&dbl, &slot, sizeof(dbl));
+            spec_str += spec.conv;
+            append_formatted(out, spec_str.c_str(), dbl);
+            break;
+        case 'p':
+            spec_str += spec.conv;
+            append_formatted(out, spec_str.c_str(), (void *)(uintptr_t)slot);
+            break;
+        default:
+            out += start;
+            return;
+        }
+    }
+}
+LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT* LTE_fdd_enb_debug_log::next_record(LTE_FDD_ENB_DEBUG_LOG_RING_STRUCT *ring)
+{
+    LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *rec;
+    uint64                               rd = ring->rd.load(std::memory_order_relaxed);
+    uint64                               wr = ring->wr.load(std::memory_order_acquire);
+    uint32                               to_end;
+
+    while(rd != wr)
+    {
+        to_end = LTE_FDD_ENB_DEBUG_LOG_RING_SIZE - (rd % LTE_FDD_ENB_DEBUG_LOG_RING_SIZE);
+        rec    = (LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT *)&ring->buf[rd % LTE_FDD_ENB_DEBUG_LOG_RING_SIZE];
+        if(sizeof(LTE_FDD_ENB_DEBUG_LOG_RECORD_STRUCT) > to_end)
+        {
+            rd += to_end;
+        }else if(NULL == rec->fmt){
+            rd += rec->size;
+        }else{
+            return rec;
+        }
+        ring->rd.store(rd, std::memory_order_release);
+    }
+    return NULL;
+}
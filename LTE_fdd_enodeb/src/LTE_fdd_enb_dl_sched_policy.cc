@@ -0,0 +1,153 @@
+#line 2 "LTE_fdd_enb_dl_sched_policy.cc" // Make __FILE__ omit the path
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_dl_sched_policy.cc
+
+    Description: Contains all the implementations for the LTE FDD eNodeB
+                 downlink scheduling policies.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "LTE_fdd_enb_dl_sched_policy.h"
+#include <algorithm>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+// Keeps PF finite for UEs that have not been served yet (bits per TTI)
+#define LTE_FDD_ENB_DL_SCHED_PF_MIN_AVG_THRU 1.0
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              GLOBAL VARIABLES
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              CLASS IMPLEMENTATIONS
+*******************************************************************************/
+
+/********************************/
+/*    Constructor/Destructor    */
+/********************************/
+LTE_fdd_enb_dl_sched_policy* LTE_fdd_enb_dl_sched_policy::create(LTE_FDD_ENB_DL_SCHED_POLICY_ENUM type)
+{
+    switch(type)
+    {
+    case LTE_FDD_ENB_DL_SCHED_POLICY_ROUND_ROBIN:
+        return new LTE_fdd_enb_dl_sched_policy_rr();
+    case LTE_FDD_ENB_DL_SCHED_POLICY_PROPORTIONAL_FAIR:
+        return new LTE_fdd_enb_dl_sched_policy_pf();
+    case LTE_FDD_ENB_DL_SCHED_POLICY_MAX_CI:
+        return new LTE_fdd_enb_dl_sched_policy_max_ci();
+    case LTE_FDD_ENB_DL_SCHED_POLICY_FIFO:
+    default:
+        return new LTE_fdd_enb_dl_sched_policy_fifo();
+    }
+}
+LTE_fdd_enb_dl_sched_policy::LTE_fdd_enb_dl_sched_policy(LTE_FDD_ENB_DL_SCHED_POLICY_ENUM _type) :
+    type{_type}
+{
+}
+LTE_fdd_enb_dl_sched_policy::~LTE_fdd_enb_dl_sched_policy()
+{
+}
+LTE_fdd_enb_dl_sched_policy_fifo::LTE_fdd_enb_dl_sched_policy_fifo() :
+    LTE_fdd_enb_dl_sched_policy(LTE_FDD_ENB_DL_SCHED_POLICY_FIFO)
+{
+}
+LTE_fdd_enb_dl_sched_policy_rr::LTE_fdd_enb_dl_sched_policy_rr() :
+    LTE_fdd_enb_dl_sched_policy(LTE_FDD_ENB_DL_SCHED_POLICY_ROUND_ROBIN)
+{
+}
+LTE_fdd_enb_dl_sched_policy_pf::LTE_fdd_enb_dl_sched_policy_pf() :
+    LTE_fdd_enb_dl_sched_policy(LTE_FDD_ENB_DL_SCHED_POLICY_PROPORTIONAL_FAIR)
+{
+}
+LTE_fdd_enb_dl_sched_policy_max_ci::LTE_fdd_enb_dl_sched_policy_max_ci() :
+    LTE_fdd_enb_dl_sched_policy(LTE_FDD_ENB_DL_SCHED_POLICY_MAX_CI)
+{
+}
+
+/****************************/
+/*    External Interface    */
+/****************************/
+void LTE_fdd_enb_dl_sched_policy::rank(std::vector<LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT> &candidates)
+{
+    for(auto &cand : candidates)
+        cand.metric = get_metric(cand);
+
+    // Ties go to the larger backlog, then to the oldest PDU.  Arrival
+    // indices are unique, so sorting in place keeps the order stable
+    // without a scratch buffer.
+    std::sort(candidates.begin(), candidates.end(),
+              [](const LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT &a, const LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT &b)
+              {
+                  if(a.metric != b.metric)
+                      return a.metric > b.metric;
+                  if(a.backlog_bytes != b.backlog_bytes)
+                      return a.backlog_bytes > b.backlog_bytes;
+                  return a.arrival_idx < b.arrival_idx;
+              });
+}
+LTE_FDD_ENB_DL_SCHED_POLICY_ENUM LTE_fdd_enb_dl_sched_policy::get_type()
+{
+    return type;
+}
+bool LTE_fdd_enb_dl_sched_policy::skip_on_no_headroom()
+{
+    return true;
+}
+
+/******************/
+/*    Policies    */
+/******************/
+bool LTE_fdd_enb_dl_sched_policy_fifo::skip_on_no_headroom()
+{
+    return false;
+}
+float LTE_fdd_enb_dl_sched_policy_fifo::get_metric(const LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT &cand)
+{
+    return -(float)cand.arrival_idx;
+}
+float LTE_fdd_enb_dl_sched_policy_rr::get_metric(const LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT &cand)
+{
+    return cand.N_ttis_waiting;
+}
+float LTE_fdd_enb_dl_sched_policy_pf::get_metric(const LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT &cand)
+{
+    return cand.inst_rate / std::max(cand.avg_thru, (float)LTE_FDD_ENB_DL_SCHED_PF_MIN_AVG_THRU);
+}
+float LTE_fdd_enb_dl_sched_policy_max_ci::get_metric(const LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT &cand)
+{
+    return cand.inst_rate;
+}
@@ -0,0 +1,258 @@
+#line 2 "LTE_fdd_enb_event_loop.cc" // Make __FILE__ omit the path
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_event_loop.cc
+
+    Description: Contains all the implementations for the LTE FDD eNodeB
+                 upper layer event loop.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "LTE_fdd_enb_event_loop.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+// Upper bound on a sleep, so a stop is seen even without a wake
+#define LTE_FDD_ENB_EVENT_LOOP_MAX_SLEEP_NS 10000000
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              GLOBAL VARIABLES
+*******************************************************************************/
+
+// Loop running on the calling thread, if any
+static thread_local LTE_fdd_enb_event_loop *current_loop = NULL;
+
+/*******************************************************************************
+                              LOCAL FUNCTIONS
+*******************************************************************************/
+
+static void futex_wait(std::atomic<uint32> *word,
+                       uint32               val,
+                       struct timespec     *timeout)
+{
+    syscall(SYS_futex, (uint32 *)word, FUTEX_WAIT_PRIVATE, val, timeout, NULL, 0);
+}
+static void futex_wake(std::atomic<uint32> *word,
+                       int32                N_waiters)
+{
+    syscall(SYS_futex, (uint32 *)word, FUTEX_WAKE_PRIVATE, N_waiters, NULL, NULL, 0);
+}
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+/*******************************************************************************
+                              CLASS IMPLEMENTATIONS
+*******************************************************************************/
+
+/********************************/
+/*    Constructor/Destructor    */
+/********************************/
+LTE_fdd_enb_event_loop::LTE_fdd_enb_event_loop(LTE_fdd_enb_interface *iface,
+                                               uint32                 _idx) :
+    interface{iface}, run_queue{NULL}, run_queue_mask{0}, run_queue_head{0},
+    run_queue_tail{0}, idx{_idx}, started{false}
+{
+    running.store(false);
+    sleeping.store(0);
+    N_ring_msgs.store(0);
+    N_direct_msgs.store(0);
+    N_wakeups.store(0);
+    max_run_queue.store(0);
+}
+LTE_fdd_enb_event_loop::~LTE_fdd_enb_event_loop()
+{
+    stop();
+    delete [] run_queue;
+}
+
+/***************/
+/*    Setup    */
+/***************/
+void LTE_fdd_enb_event_loop::add_msgq(LTE_fdd_enb_msgq *msgq)
+{
+    msgqs.push_back(msgq);
+}
+void LTE_fdd_enb_event_loop::start()
+{
+    uint32 size   = 1;
+    uint32 N_msgs = 0;
+
+    if(started)
+        return;
+
+    // Every run queue entry holds a buffer of one of the loop's queues,
+    // so the ring can never overflow
+    if(NULL == run_queue)
+    {
+        for(auto msgq : msgqs)
+            N_msgs += msgq->get_max_msgs();
+        while(size < N_msgs)
+            size <<= 1;
+        run_queue      = new LTE_FDD_ENB_EVENT_LOOP_ITEM_STRUCT[size];
+        run_queue_mask = size - 1;
+    }
+    running.store(true);
+    pthread_create(&thread, NULL, &loop_thread, this);
+    started = true;
+}
+void LTE_fdd_enb_event_loop::stop()
+{
+    if(!started)
+        return;
+    running.store(false);
+    wake();
+    pthread_join(thread, NULL);
+    started = false;
+
+    // Anything left on the run queue was never handled
+    while(run_queue_head != run_queue_tail)
+    {
+        LTE_FDD_ENB_EVENT_LOOP_ITEM_STRUCT *item = &run_queue[run_queue_head++ & run_queue_mask];
+        item->msgq->free_msg(item->msg);
+    }
+}
+
+/*********************************/
+/*    Message queue interface    */
+/*********************************/
+bool LTE_fdd_enb_event_loop::is_current()
+{
+    return (this == current_loop);
+}
+void LTE_fdd_enb_event_loop::run_later(LTE_fdd_enb_msgq           *msgq,
+                                       LTE_FDD_ENB_MESSAGE_STRUCT *msg)
+{
+    LTE_FDD_ENB_EVENT_LOOP_ITEM_STRUCT *item  = &run_queue[run_queue_tail++ & run_queue_mask];
+    uint32                              depth = run_queue_tail - run_queue_head;
+
+    // Only ever called on the loop thread, so the run queue needs no lock
+    item->msgq = msgq;
+    item->msg  = msg;
+    if(depth > max_run_queue.load(std::memory_order_relaxed))
+        max_run_queue.store(depth, std::memory_order_relaxed);
+}
+void LTE_fdd_enb_event_loop::wake()
+{
+    // Pairs with the sequentially consistent ring publish, see loop_thread()
+    if(0 != sleeping.load() &&
+       0 != sleeping.exchange(0))
+        futex_wake(&sleeping, 1);
+}
+
+/********************/
+/*    Statistics    */
+/********************/
+void LTE_fdd_enb_event_loop::get_stats(LTE_FDD_ENB_EVENT_LOOP_STATS_STRUCT *stats)
+{
+    stats->N_ring_msgs   = N_ring_msgs.load(std::memory_order_relaxed);
+    stats->N_direct_msgs = N_direct_msgs.load(std::memory_order_relaxed);
+    stats->N_wakeups     = N_wakeups.load(std::memory_order_relaxed);
+    stats->max_run_queue = max_run_queue.load(std::memory_order_relaxed);
+}
+
+/**************/
+/*    Loop    */
+/**************/
+void* LTE_fdd_enb_event_loop::loop_thread(void *inputs)
+{
+    LTE_fdd_enb_event_loop *loop    = (LTE_fdd_enb_event_loop *)inputs;
+    struct timespec         timeout = {0, LTE_FDD_ENB_EVENT_LOOP_MAX_SLEEP_NS};
+    bool                    kill;
+
+    current_loop = loop;
+    loop->interface->setup_thread(LTE_FDD_ENB_THREAD_STACK, loop->idx, "stack_loop_" + std::to_string(loop->idx));
+    bool busy_poll = loop->interface->get_thread_busy_poll(LTE_FDD_ENB_THREAD_STACK);
+
+    while(loop->running.load(std::memory_order_relaxed))
+    {
+        // One batch from each queue in turn, running everything the
+        // handlers send to this loop before moving on
+        uint32 N_msgs = 0;
+        for(auto msgq : loop->msgqs)
+        {
+            N_msgs += msgq->receive_msgs(&kill);
+            loop->run_pending();
+        }
+        loop->N_ring_msgs.fetch_add(N_msgs, std::memory_order_relaxed);
+        if(0 != N_msgs)
+            continue;
+
+        if(busy_poll)
+        {
+            cpu_relax();
+            continue;
+        }
+
+        // Announce the sleep before the final check so a sender either
+        // sees the flag or its message is seen here
+        loop->sleeping.store(1);
+        if(loop->is_msg_pending() ||
+           !loop->running.load())
+        {
+            loop->sleeping.store(0);
+            continue;
+        }
+        futex_wait(&loop->sleeping, 1, &timeout);
+        loop->sleeping.store(0);
+        loop->N_wakeups.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    current_loop = NULL;
+    return NULL;
+}
+void LTE_fdd_enb_event_loop::run_pending()
+{
+    while(run_queue_head != run_queue_tail)
+    {
+        LTE_FDD_ENB_EVENT_LOOP_ITEM_STRUCT item = run_queue[run_queue_head++ & run_queue_mask];
+        item.msgq->dispatch_msg(item.msg);
+        N_direct_msgs.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+bool LTE_fdd_enb_event_loop::is_msg_pending()
+{
+    for(auto msgq : msgqs)
+        if(msgq->is_msg_pending())
+            return true;
+    return false;
+}
@@ -46,7 +46,9 @@
 
 #include "LTE_fdd_enb_gw.h"
 #include "LTE_fdd_enb_user_mgr.h"
+#include "LTE_fdd_enb_msg_pool.h"
 #include <fcntl.h>
+#include <unistd.h>
 #include <arpa/inet.h>
 #include <linux/ip.h>
 #include <netinet/ip6.h>
@@ -214,7 +216,7 @@ void LTE_fdd_enb_gw::handle_pdcp_msg(LTE_FDD_ENB_MESSAGE_STRUCT &msg)
 /*******************************/
 void LTE_fdd_enb_gw::handle_gw_data(LTE_FDD_ENB_GW_DATA_READY_MSG_STRUCT *gw_data)
 {
-    LIBLTE_BYTE_MSG_STRUCT *msg;
+    LIBLTE_BYTE_BUF_STRUCT *msg;
 
     if(LTE_FDD_ENB_ERROR_NONE != gw_data->rb->get_next_gw_data_msg(&msg))
         return;
@@ -227,9 +229,9 @@ void LTE_fdd_enb_gw::handle_gw_data(LTE_FDD_ENB_GW_DATA_READY_MSG_STRUCT *gw_dat
                               "Received GW data message for RNTI=%u and RB=%s",
                               gw_data->user->get_c_rnti(),
                               LTE_fdd_enb_rb_text[gw_data->rb->get_rb_id()]);
-    interface->send_ip_pcap_msg(msg->msg, msg->N_bytes);
+    interface->send_ip_pcap_msg(gw_data->user->get_c_rnti(), liblte_byte_buf_data(msg), msg->N_bytes);
 
-    if(msg->N_bytes != write(tun_fd, msg->msg, msg->N_bytes))
+    if(msg->N_bytes != write(tun_fd, liblte_byte_buf_data(msg), msg->N_bytes))
         interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
                                   LTE_FDD_ENB_DEBUG_LEVEL_GW,
                                   __FILE__,
@@ -247,30 +249,32 @@ void* LTE_fdd_enb_gw::receive_thread(void *inputs)
 {
     LTE_fdd_enb_gw                             *gw = (LTE_fdd_enb_gw *)inputs;
     LTE_FDD_ENB_PDCP_DATA_SDU_READY_MSG_STRUCT  pdcp_data_sdu;
-    LIBLTE_BYTE_MSG_STRUCT                      msg;
+    LIBLTE_BYTE_BUF_STRUCT                     *msg;
     struct iphdr                                ipv4_pkt;
-    cpu_set_t                                   af_mask;
+    uint8                                      *pkt;
     uint32                                      idx      = 0;
-    uint32                                      num_cpus = std::thread::hardware_concurrency();
     int32                                       N_bytes;
 
-    // Set affinity to the third to the last core (last is for PHY/Radio, second to last is for MAC)
-    CPU_ZERO(&af_mask);
-    CPU_SET(num_cpus-3, &af_mask);
-    pthread_setaffinity_np(gw->rx_thread, sizeof(af_mask), &af_mask);
+    gw->interface->setup_thread(LTE_FDD_ENB_THREAD_GW, 0, "gw_rx");
+
+    // Packets are read straight into the buffer that is handed to PDCP,
+    // leaving headroom for the PDCP and RLC headers.  The packet size is
+    // not known before the read, so the buffer is backed for a full message.
+    msg = LTE_fdd_enb_msg_pool::alloc_byte_buf(LIBLTE_MAX_MSG_SIZE);
+    pkt = liblte_byte_buf_data(msg);
 
     while(gw->is_started())
     {
-        N_bytes = read(gw->tun_fd, &msg.msg[idx], LIBLTE_MAX_MSG_SIZE);
+        N_bytes = read(gw->tun_fd, &pkt[idx], LIBLTE_MAX_MSG_SIZE - idx);
 
         if(N_bytes <= 0)
             break; // Something bad has happened
 
-        msg.N_bytes = idx + N_bytes;
-        if(0x60 == (msg.msg[0] & 0xF0))
+        msg->N_bytes = idx + N_bytes;
+        if(0x60 == (pkt[0] & 0xF0))
         {
             // Discard IPv6 packet
-            if(msg.N_bytes == ((msg.msg[4]<<8) + msg.msg[5]) + sizeof(ip6_hdr))
+            if(msg->N_bytes == ((pkt[4]<<8) + pkt[5]) + sizeof(ip6_hdr))
             {
                 idx = 0;
             }else{
@@ -278,10 +282,10 @@ void* LTE_fdd_enb_gw::receive_thread(void *inputs)
             }
             continue;
         }
-        memcpy(&ipv4_pkt, msg.msg, sizeof(iphdr));
+        memcpy(&ipv4_pkt, pkt, sizeof(iphdr));
 
         // Check if entire packet was received
-        if(ntohs(ipv4_pkt.tot_len) != msg.N_bytes)
+        if(ntohs(ipv4_pkt.tot_len) != msg->N_bytes)
         {
             idx = N_bytes;
             continue;
@@ -295,22 +299,26 @@ void* LTE_fdd_enb_gw::receive_thread(void *inputs)
                                           LTE_FDD_ENB_DEBUG_LEVEL_GW,
                                           __FILE__,
                                           __LINE__,
-                                          &msg,
+                                          msg,
                                           "Received IP packet for RNTI=%u and RB=%s",
                                           pdcp_data_sdu.user->get_c_rnti(),
                                           LTE_fdd_enb_rb_text[pdcp_data_sdu.rb->get_rb_id()]);
-            gw->interface->send_ip_pcap_msg(msg.msg, msg.N_bytes);
+            gw->interface->send_ip_pcap_msg(pdcp_data_sdu.user->get_c_rnti(), pkt, msg->N_bytes);
 
-            // Send message to PDCP
-            pdcp_data_sdu.rb->queue_pdcp_data_sdu(&msg);
+            // Send message to PDCP, which owns the buffer from here
+            pdcp_data_sdu.rb->queue_pdcp_data_sdu(msg);
             gw->msgq_to_pdcp->send(LTE_FDD_ENB_MESSAGE_TYPE_PDCP_DATA_SDU_READY,
                                    LTE_FDD_ENB_DEST_LAYER_PDCP,
                                    (LTE_FDD_ENB_MESSAGE_UNION *)&pdcp_data_sdu,
                                    sizeof(LTE_FDD_ENB_PDCP_DATA_SDU_READY_MSG_STRUCT));
+            msg = LTE_fdd_enb_msg_pool::alloc_byte_buf(LIBLTE_MAX_MSG_SIZE);
+            pkt = liblte_byte_buf_data(msg);
         }
             
         idx = 0;
     }
 
+    LTE_fdd_enb_msg_pool::free(msg);
+
     return NULL;
 }
@@ -73,17 +73,27 @@
 #include "LTE_fdd_enb_phy.h"
 #include "LTE_fdd_enb_radio.h"
 #include "LTE_fdd_enb_timer_mgr.h"
+#include "LTE_fdd_enb_event_loop.h"
+#include "LTE_fdd_enb_debug_log.h"
+#include "LTE_fdd_enb_pcap.h"
+#include "LTE_fdd_enb_metrics.h"
 #include "liblte_interface.h"
 #include "libtools_helpers.h"
 #include <boost/lexical_cast.hpp>
 #include <arpa/inet.h>
 #include <sys/time.h>
+#include <sys/syscall.h>
 #include <stdarg.h>
+#include <string.h>
+#include <unistd.h>
+#include <thread>
 
 /*******************************************************************************
                               DEFINES
 *******************************************************************************/
 
+// One PHY schedule per TTI, a PHY this far behind has lost the subframes anyway
+#define LTE_FDD_ENB_MAC_TO_PHY_CAPACITY 32
 
 /*******************************************************************************
                               TYPEDEFS
@@ -104,12 +114,15 @@
 /********************************/
 LTE_fdd_enb_interface::LTE_fdd_enb_interface() :
     ctrl_socket{NULL}, debug_socket{NULL}, ctrl_connected{false}, debug_connected{false},
+    debug_log{new LTE_fdd_enb_debug_log(this)}, pcap{new LTE_fdd_enb_pcap(this)},
     shutdown_token{"shutdown"}, start_token{"start"}, stop_token{"stop"},
     construct_si_token{"construct_si"}, add_user_token{"add_user"},
     delete_user_token{"delete_user"}, print_users_token{"print_users"},
     print_registered_users_token{"print_registered_users"},
+    print_threads_token{"print_threads"}, metrics_token{"metrics"},
     read_token{"read"}, write_token{"write"}, help_token{"help"}, bandwidth_token{"bandwidth"},
-    band_token{"band"}, dl_earfcn_token{"dl_earfcn"}, n_ant_token{"n_ant"},
+    band_token{"band"}, n_cells_token{"n_cells"}, selected_cell_token{"selected_cell"},
+    dl_earfcn_token{"dl_earfcn"}, n_ant_token{"n_ant"},
     n_id_cell_token{"n_id_cell"}, mcc_token{"mcc"}, mnc_token{"mnc"},
     cell_id_token{"cell_id"}, tracking_area_code_token{"tracking_area_code"},
     q_rx_lev_min_token{"q_rx_lev_min"}, si_periodicity_token{"si_periodicity"},
@@ -120,9 +133,19 @@ LTE_fdd_enb_interface::LTE_fdd_enb_interface() :
     sib7_present_token{"sib7_present"}, sib8_present_token{"sib8_present"},
     mac_direct_to_ue_token{"mac_direct_to_ue"}, phy_direct_to_ue_token{"phy_direct_to_ue"},
     debug_type_token{"debug_type"}, debug_level_token{"debug_level"},
-    enable_pcap_token{"enable_pcap"}, ip_addr_start_token{"ip_addr_start"},
+    dl_sched_policy_token{"dl_sched_policy"},
+    ul_sched_policy_token{"ul_sched_policy"}, sps_interval_token{"sps_interval"},
+    drx_long_cycle_token{"drx_long_cycle"}, drx_short_cycle_token{"drx_short_cycle"},
+    drx_on_duration_token{"drx_on_duration"},
+    drx_inactivity_timer_token{"drx_inactivity_timer"},
+    enable_pcap_token{"enable_pcap"}, pcap_dir_token{"pcap_dir"},
+    pcap_max_size_token{"pcap_max_size"}, pcap_period_token{"pcap_period"},
+    pcap_rnti_token{"pcap_rnti"}, metrics_file_token{"metrics_file"},
+    metrics_period_token{"metrics_period"}, metrics_format_token{"metrics_format"},
+    ip_addr_start_token{"ip_addr_start"},
     dns_addr_token{"dns_addr"}, use_cnfg_file_token{"use_cnfg_file"},
-    use_user_file_token{"use_user_file"}, available_radios_token{"available_radios"},
+    use_user_file_token{"use_user_file"}, stack_event_loops_token{"stack_event_loops"},
+    available_radios_token{"available_radios"},
     selected_radio_name_token{"selected_radio_name"},
     selected_radio_idx_token{"selected_radio_idx"}, clock_source_token{"clock_source"},
     tx_gain_token{"tx_gain"}, rx_gain_token{"rx_gain"}, imsi_token{"imsi"}, imei_token{"imei"},
@@ -130,22 +153,65 @@ LTE_fdd_enb_interface::LTE_fdd_enb_interface() :
     user_mgr{new LTE_fdd_enb_user_mgr(this, timer_mgr)}, hss{new LTE_fdd_enb_hss()},
     gw{new LTE_fdd_enb_gw(this, user_mgr)}, mme{new LTE_fdd_enb_mme(this, user_mgr, hss)},
     pdcp{new LTE_fdd_enb_pdcp(this)}, rlc{new LTE_fdd_enb_rlc(this)},
-    mac{new LTE_fdd_enb_mac(this, timer_mgr, user_mgr, rlc)},
-    phy{new LTE_fdd_enb_phy(this, mac)}, radio{new LTE_fdd_enb_radio(this, phy)},
+    metrics{new LTE_fdd_enb_metrics(this, user_mgr)},
     N_rb_dl{LIBLTE_PHY_N_RB_DL_10MHZ}, N_rb_ul{LIBLTE_PHY_N_RB_UL_10MHZ},
-    dl_center_freq{liblte_interface_dl_earfcn_to_frequency(liblte_interface_first_dl_earfcn[0])},
-    ul_center_freq{liblte_interface_dl_earfcn_to_frequency(liblte_interface_get_corresponding_ul_earfcn(liblte_interface_first_dl_earfcn[0]))},
     N_sc_rb_dl{LIBLTE_PHY_N_SC_RB_DL_NORMAL_CP}, N_sc_rb_ul{LIBLTE_PHY_N_SC_RB_UL},
     debug_type{0xFFFFFFFF}, debug_level{0xFFFFFFFF}, ip_addr_start{0xC0A80102},
-    dns_addr{0xC0A80101}, N_id_cell{0}, dl_earfcn{liblte_interface_first_dl_earfcn[0]},
-    ul_earfcn{liblte_interface_get_corresponding_ul_earfcn(dl_earfcn)}, N_ant{1},
-    N_id_1{0}, N_id_2{0}, shutdown{false}, started{false}, sib3_present{false},
+    dns_addr{0xC0A80101}, N_ant{1}, N_cells{1}, selected_cell{0}, shutdown{false},
+    started{false}, sib3_present{false},
     sib4_present{false}, sib5_present{false}, sib6_present{false}, sib7_present{false},
     sib8_present{false}, mac_direct_to_ue{false}, phy_direct_to_ue{false},
-    enable_pcap{false}, use_cnfg_file{false}, use_user_file{false}
-{
-    rrc = new LTE_fdd_enb_rrc(this, user_mgr, mac);
-    mac->set_phy_and_rrc(phy, rrc);
+    enable_pcap{false}, use_cnfg_file{false}, use_user_file{false},
+    dl_sched_policy{LTE_FDD_ENB_DL_SCHED_POLICY_PROPORTIONAL_FAIR},
+    ul_sched_policy{LTE_FDD_ENB_DL_SCHED_POLICY_PROPORTIONAL_FAIR}, sps_interval{0},
+    drx_long_cycle{0}, drx_short_cycle{0}, drx_on_duration{10}, drx_inactivity_timer{100},
+    pcap_dir{LTE_FDD_ENB_PCAP_DEFAULT_DIR}, pcap_max_size{0}, pcap_period{0},
+    pcap_rnti{LTE_FDD_ENB_PCAP_ALL_RNTIS}, metrics_file{LTE_FDD_ENB_METRICS_DEFAULT_FILE},
+    metrics_period{0}, metrics_format{LTE_FDD_ENB_METRICS_FORMAT_PROMETHEUS}
+{
+    // Cells, each with its own RRC, MAC, PHY, and radio
+    for(uint32 i=0; i<LTE_FDD_ENB_MAX_N_CELLS; i++)
+    {
+        cells[i].mac            = new LTE_fdd_enb_mac(this, i, timer_mgr, user_mgr, rlc);
+        cells[i].phy            = new LTE_fdd_enb_phy(this, i, cells[i].mac);
+        cells[i].radio          = new LTE_fdd_enb_radio(this, i, cells[i].phy);
+        cells[i].rrc            = new LTE_fdd_enb_rrc(this, i, user_mgr, cells[i].mac);
+        cells[i].cell_id        = i;
+        cells[i].N_id_cell      = i;
+        cells[i].N_id_2         = cells[i].N_id_cell % 3;
+        cells[i].N_id_1         = (cells[i].N_id_cell - cells[i].N_id_2) / 3;
+        cells[i].band           = liblte_interface_band_num[0];
+        cells[i].dl_earfcn      = liblte_interface_first_dl_earfcn[0];
+        cells[i].ul_earfcn      = liblte_interface_get_corresponding_ul_earfcn(cells[i].dl_earfcn);
+        cells[i].dl_center_freq = liblte_interface_dl_earfcn_to_frequency(cells[i].dl_earfcn);
+        cells[i].ul_center_freq = liblte_interface_ul_earfcn_to_frequency(cells[i].ul_earfcn);
+        cells[i].mac->set_phy_and_rrc(cells[i].phy, cells[i].rrc);
+    }
+
+    // Threads, the defaults reproduce the fixed layout: radio and MAC
+    // pinned at the highest real-time priority, PHY workers just below
+    // and unpinned, and the rest of the stack sharing one core
+    for(uint32 i=0; i<LTE_FDD_ENB_THREAD_N_ITEMS; i++)
+    {
+        std::string thread_class     = LTE_fdd_enb_thread_text[i];
+        thread_cores_token[i]        = thread_class + "_cores";
+        thread_sched_policy_token[i] = thread_class + "_sched_policy";
+        thread_sched_prio_token[i]   = thread_class + "_sched_prio";
+        thread_busy_poll_token[i]    = thread_class + "_busy_poll";
+        thread_cnfg[i].cores         = "auto";
+        thread_cnfg[i].sched_policy  = LTE_FDD_ENB_SCHED_POLICY_OTHER;
+        thread_cnfg[i].sched_prio    = 0;
+        thread_cnfg[i].busy_poll     = false;
+    }
+    thread_cnfg[LTE_FDD_ENB_THREAD_RADIO].sched_policy = LTE_FDD_ENB_SCHED_POLICY_FIFO;
+    thread_cnfg[LTE_FDD_ENB_THREAD_RADIO].sched_prio   = 99;
+    thread_cnfg[LTE_FDD_ENB_THREAD_PHY].sched_policy   = LTE_FDD_ENB_SCHED_POLICY_FIFO;
+    thread_cnfg[LTE_FDD_ENB_THREAD_PHY].sched_prio     = 98;
+    thread_cnfg[LTE_FDD_ENB_THREAD_MAC].sched_policy   = LTE_FDD_ENB_SCHED_POLICY_FIFO;
+    thread_cnfg[LTE_FDD_ENB_THREAD_MAC].sched_prio     = 99;
+    for(uint32 i=0; i<LTE_FDD_ENB_MAX_N_EVENT_LOOPS; i++)
+        stack_event_loop[i] = NULL;
+    N_stack_event_loops = 0;
 
     // MIB
     sys_info.mib.dl_Bandwidth_SetValue(MasterInformationBlock::k_dl_Bandwidth_n50);
@@ -271,16 +337,13 @@ LTE_fdd_enb_interface::LTE_fdd_enb_interface() :
     sys_info.sib8.searchWindowSize_SetValue(0);
     sys_info.sib8.parametersHRPD_value.Clear();
     sys_info.sib8.parameters1XRTT_value.Clear();
-
-    open_lte_pcap_fd();
-    open_ip_pcap_fd();
 }
 LTE_fdd_enb_interface::~LTE_fdd_enb_interface()
 {
     stop_ports();
-
-    fclose(lte_pcap_fd);
-    fclose(ip_pcap_fd);
+    delete debug_log;
+    delete pcap;
+    delete metrics;
 }
 
 /***********************/
@@ -290,6 +353,8 @@ void LTE_fdd_enb_interface::start_ports()
 {
     start_ctrl_port();
     start_debug_port();
+    pcap->start();
+    metrics->start();
 }
 void LTE_fdd_enb_interface::start_ctrl_port()
 {
@@ -354,12 +419,17 @@ void LTE_fdd_enb_interface::start_debug_port()
                                               error_cb,
                                               error);
     if(LIBTOOLS_SERVER_SOCKET_ERROR_NONE == error)
+    {
+        debug_log->start();
         return;
+    }
     printf("Couldn't open debug_socket %s\n", libtools_server_socket_error_text[error]);
     debug_socket = NULL;
 }
 void LTE_fdd_enb_interface::stop_ports()
 {
+    metrics->stop();
+    pcap->stop();
     stop_ctrl_port();
     stop_debug_port();
 }
@@ -375,13 +445,17 @@ void LTE_fdd_enb_interface::stop_ctrl_port()
 }
 void LTE_fdd_enb_interface::stop_debug_port()
 {
+    // The debug log thread sends under the debug mutex
+    debug_log->stop();
+
     std::lock_guard<std::mutex> lock(debug_mutex);
 
     if(NULL == debug_socket)
         return;
 
     delete debug_socket;
-    debug_socket = NULL;
+    debug_socket    = NULL;
+    debug_connected = false;
 }
 void LTE_fdd_enb_interface::send_ctrl_msg(std::string msg)
 {
@@ -407,326 +481,125 @@ void LTE_fdd_enb_interface::send_ctrl_info_msg(std::string msg, ...)
 }
 void LTE_fdd_enb_interface::send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM  type,
                                            LTE_FDD_ENB_DEBUG_LEVEL_ENUM level,
-                                           std::string                  file_name,
+                                           const char                  *file_name,
                                            int32                        line,
-                                           std::string                  msg,
+                                           const char                  *msg,
                                            ...)
 {
-    std::lock_guard<std::mutex>  lock(debug_mutex);
-    std::string                  tmp_msg;
-    va_list                      args;
-    char                        *args_msg;
+    va_list args;
 
-    if(!debug_connected             ||
-       !(debug_type  & (1 << type)) ||
+    if(!debug_connected.load(std::memory_order_relaxed) ||
+       !(debug_type  & (1 << type))                     ||
        !(debug_level & (1 << level)))
         return;
 
-    // Format the output string
-    get_formatted_time(tmp_msg);
-    tmp_msg += " ";
-    tmp_msg += LTE_fdd_enb_debug_type_text[type];
-    tmp_msg += " ";
-    tmp_msg += LTE_fdd_enb_debug_level_text[level];
-    tmp_msg += " ";
-    tmp_msg += file_name.c_str();
-    tmp_msg += " ";
-    tmp_msg += std::to_string(line);
-    tmp_msg += " ";
     va_start(args, msg);
-    if(-1 != vasprintf(&args_msg, msg.c_str(), args))
-        tmp_msg += args_msg;
-    tmp_msg += "\n";
-
-    // Cleanup the variable argument string
-    free(args_msg);
-
-    debug_socket->send(tmp_msg, debug_sock_fd);
+    debug_log->log(type, level, file_name, line, msg, args);
+    va_end(args);
 }
 void LTE_fdd_enb_interface::send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM   type,
                                            LTE_FDD_ENB_DEBUG_LEVEL_ENUM  level,
-                                           std::string                   file_name,
+                                           const char                   *file_name,
                                            int32                         line,
                                            LIBLTE_BIT_MSG_STRUCT        *lte_msg,
-                                           std::string                   msg,
+                                           const char                   *msg,
                                            ...)
 {
-    std::lock_guard<std::mutex>  lock(debug_mutex);
-    std::string                  tmp_msg;
-    va_list                      args;
-    uint32                       i;
-    uint32                       hex_val;
-    char                        *args_msg;
+    va_list args;
 
-    if(!debug_connected             ||
-       !(debug_type  & (1 << type)) ||
+    if(!debug_connected.load(std::memory_order_relaxed) ||
+       !(debug_type  & (1 << type))                     ||
        !(debug_level & (1 << level)))
         return;
 
-    // Format the output string
-    get_formatted_time(tmp_msg);
-    tmp_msg += " ";
-    tmp_msg += LTE_fdd_enb_debug_type_text[type];
-    tmp_msg += " ";
-    tmp_msg += LTE_fdd_enb_debug_level_text[level];
-    tmp_msg += " ";
-    tmp_msg += file_name.c_str();
-    tmp_msg += " ";
-    tmp_msg += std::to_string(line);
-    tmp_msg += " ";
     va_start(args, msg);
-    if(-1 != vasprintf(&args_msg, msg.c_str(), args))
-        tmp_msg += args_msg;
-    tmp_msg += " ";
-    hex_val  = 0;
-    for(i=0; i<lte_msg->N_bits; i++)
-    {
-        hex_val <<= 1;
-        hex_val  |= lte_msg->msg[i];
-        if((i % 4) == 3)
-        {
-            if(hex_val < 0xA)
-            {
-                tmp_msg += (char)(hex_val + '0');
-            }else{
-                tmp_msg += (char)((hex_val-0xA) + 'A');
-            }
-            hex_val = 0;
-        }
-    }
-    if((lte_msg->N_bits % 4) != 0)
-    {
-        for(i=0; i<4-(lte_msg->N_bits % 4); i++)
-        {
-            hex_val <<= 1;
-        }
-        if(hex_val < 0xA)
-        {
-            tmp_msg += (char)(hex_val + '0');
-        }else{
-            tmp_msg += (char)((hex_val-0xA) + 'A');
-        }
-    }
-    tmp_msg += "\n";
-
-    // Cleanup the variable argument string
-    free(args_msg);
-
-    debug_socket->send(tmp_msg, debug_sock_fd);
+    debug_log->log_bits(type, level, file_name, line, lte_msg->msg, lte_msg->N_bits, msg, args);
+    va_end(args);
 }
 void LTE_fdd_enb_interface::send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM   type,
                                            LTE_FDD_ENB_DEBUG_LEVEL_ENUM  level,
-                                           std::string                   file_name,
+                                           const char                   *file_name,
                                            int32                         line,
                                            std::vector<bool>            &lte_msg,
-                                           std::string                   msg,
+                                           const char                   *msg,
                                            ...)
 {
-    std::lock_guard<std::mutex>  lock(debug_mutex);
-    std::string                  tmp_msg;
-    va_list                      args;
-    uint32                       i;
-    uint32                       hex_val;
-    char                        *args_msg;
+    va_list args;
 
-    if(!debug_connected             ||
-       !(debug_type  & (1 << type)) ||
+    if(!debug_connected.load(std::memory_order_relaxed) ||
+       !(debug_type  & (1 << type))                     ||
        !(debug_level & (1 << level)))
         return;
 
-    // Format the output string
-    get_formatted_time(tmp_msg);
-    tmp_msg += " ";
-    tmp_msg += LTE_fdd_enb_debug_type_text[type];
-    tmp_msg += " ";
-    tmp_msg += LTE_fdd_enb_debug_level_text[level];
-    tmp_msg += " ";
-    tmp_msg += file_name.c_str();
-    tmp_msg += " ";
-    tmp_msg += std::to_string(line);
-    tmp_msg += " ";
     va_start(args, msg);
-    if(-1 != vasprintf(&args_msg, msg.c_str(), args))
-        tmp_msg += args_msg;
-    tmp_msg += " ";
-    hex_val  = 0;
-    for(i=0; i<lte_msg.size(); i++)
-    {
-        hex_val <<= 1;
-        hex_val  |= lte_msg[i];
-        if((i % 4) == 3)
-        {
-            if(hex_val < 0xA)
-            {
-                tmp_msg += (char)(hex_val + '0');
-            }else{
-                tmp_msg += (char)((hex_val-0xA) + 'A');
-            }
-            hex_val = 0;
-        }
-    }
-    if((lte_msg.size() % 4) != 0)
-    {
-        for(i=0; i<4-(lte_msg.size() % 4); i++)
-        {
-            hex_val <<= 1;
-        }
-        if(hex_val < 0xA)
-        {
-            tmp_msg += (char)(hex_val + '0');
-        }else{
-            tmp_msg += (char)((hex_val-0xA) + 'A');
-        }
-    }
-    tmp_msg += "\n";
-
-    // Cleanup the variable argument string
-    free(args_msg);
-
-    debug_socket->send(tmp_msg, debug_sock_fd);
+    debug_log->log_bits(type, level, file_name, line, lte_msg, msg, args);
+    va_end(args);
 }
 void LTE_fdd_enb_interface::send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM   type,
                                            LTE_FDD_ENB_DEBUG_LEVEL_ENUM  level,
-                                           std::string                   file_name,
+                                           const char                   *file_name,
                                            int32                         line,
                                            LIBLTE_BYTE_MSG_STRUCT       *lte_msg,
-                                           std::string                   msg,
+                                           const char                   *msg,
                                            ...)
 {
-    std::lock_guard<std::mutex>  lock(debug_mutex);
-    std::string                  tmp_msg;
-    va_list                      args;
-    char                        *args_msg;
+    va_list args;
 
-    if(!debug_connected             ||
-       !(debug_type  & (1 << type)) ||
+    if(!debug_connected.load(std::memory_order_relaxed) ||
+       !(debug_type  & (1 << type))                     ||
        !(debug_level & (1 << level)))
         return;
 
-    // Format the output string
-    get_formatted_time(tmp_msg);
-    tmp_msg += " ";
-    tmp_msg += LTE_fdd_enb_debug_type_text[type];
-    tmp_msg += " ";
-    tmp_msg += LTE_fdd_enb_debug_level_text[level];
-    tmp_msg += " ";
-    tmp_msg += file_name.c_str();
-    tmp_msg += " ";
-    tmp_msg += std::to_string(line);
-    tmp_msg += " ";
     va_start(args, msg);
-    if(-1 != vasprintf(&args_msg, msg.c_str(), args))
-        tmp_msg += args_msg;
-    tmp_msg += " msg_size=" + std::to_string(lte_msg->N_bytes);
-    if(lte_msg->N_bytes > 0)
-    {
-        tmp_msg += " " + to_string(lte_msg->msg, lte_msg->N_bytes) + "\n";
-    }else{
-        tmp_msg += "\n";
-    }
+    debug_log->log_bytes(type, level, file_name, line, lte_msg->msg, lte_msg->N_bytes, msg, args);
+    va_end(args);
+}
+void LTE_fdd_enb_interface::send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM   type,
+                                           LTE_FDD_ENB_DEBUG_LEVEL_ENUM  level,
+                                           const char                   *file_name,
+                                           int32                         line,
+                                           LIBLTE_BYTE_BUF_STRUCT       *lte_msg,
+                                           const char                   *msg,
+                                           ...)
+{
+    va_list args;
 
-    // Cleanup the variable argument string
-    free(args_msg);
+    if(!debug_connected.load(std::memory_order_relaxed) ||
+       !(debug_type  & (1 << type))                     ||
+       !(debug_level & (1 << level)))
+        return;
 
-    debug_socket->send(tmp_msg, debug_sock_fd);
+    va_start(args, msg);
+    debug_log->log_bytes(type, level, file_name, line, liblte_byte_buf_data(lte_msg), lte_msg->N_bytes, msg, args);
+    va_end(args);
 }
 void LTE_fdd_enb_interface::send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM   type,
                                            LTE_FDD_ENB_DEBUG_LEVEL_ENUM  level,
-                                           std::string                   file_name,
+                                           const char                   *file_name,
                                            int32                         line,
                                            const std::vector<uint8_t>   &lte_msg,
-                                           std::string                   msg,
+                                           const char                   *msg,
                                            ...)
 {
-    std::lock_guard<std::mutex>  lock(debug_mutex);
-    std::string                  tmp_msg;
-    va_list                      args;
-    char                        *args_msg;
+    va_list args;
 
-    if(!debug_connected             ||
-       !(debug_type  & (1 << type)) ||
+    if(!debug_connected.load(std::memory_order_relaxed) ||
+       !(debug_type  & (1 << type))                     ||
        !(debug_level & (1 << level)))
         return;
 
-    // Format the output string
-    get_formatted_time(tmp_msg);
-    tmp_msg += " ";
-    tmp_msg += LTE_fdd_enb_debug_type_text[type];
-    tmp_msg += " ";
-    tmp_msg += LTE_fdd_enb_debug_level_text[level];
-    tmp_msg += " ";
-    tmp_msg += file_name.c_str();
-    tmp_msg += " ";
-    tmp_msg += std::to_string(line);
-    tmp_msg += " ";
     va_start(args, msg);
-    if(-1 != vasprintf(&args_msg, msg.c_str(), args))
-        tmp_msg += args_msg;
-    tmp_msg += " msg_size=" + std::to_string(lte_msg.size());
-    tmp_msg += "\n";
+    debug_log->log_size(type, level, file_name, line, lte_msg.size(), msg, args);
+    va_end(args);
+}
+void LTE_fdd_enb_interface::send_debug_output(const std::string &msg)
+{
+    std::lock_guard<std::mutex> lock(debug_mutex);
 
-    // Cleanup the variable argument string
-    free(args_msg);
+    if(!debug_connected)
+        return;
 
-    debug_socket->send(tmp_msg, debug_sock_fd);
-}
-void LTE_fdd_enb_interface::open_lte_pcap_fd()
-{
-    uint32 magic_number = 0xa1b2c3d4;
-    uint32 timezone     = 0;
-    uint32 sigfigs      = 0;
-    uint32 snap_len     = 0xFFFF;
-    uint32 dlt          = 147;
-    uint32 tmp_u32;
-    uint16 major_version = 2;
-    uint16 minor_version = 4;
-    uint16 tmp_u16;
-
-    lte_pcap_fd = fopen("/tmp/LTE_fdd_enodeb.pcap", "w");
-
-    tmp_u32 = htonl(magic_number);
-    fwrite(&tmp_u32, sizeof(tmp_u32), 1, lte_pcap_fd);
-    tmp_u16 = htons(major_version);
-    fwrite(&tmp_u16, sizeof(tmp_u16), 1, lte_pcap_fd);
-    tmp_u16 = htons(minor_version);
-    fwrite(&tmp_u16, sizeof(tmp_u16), 1, lte_pcap_fd);
-    tmp_u32 = htonl(timezone);
-    fwrite(&tmp_u32, sizeof(tmp_u32), 1, lte_pcap_fd);
-    tmp_u32 = htonl(sigfigs);
-    fwrite(&tmp_u32, sizeof(tmp_u32), 1, lte_pcap_fd);
-    tmp_u32 = htonl(snap_len);
-    fwrite(&tmp_u32, sizeof(tmp_u32), 1, lte_pcap_fd);
-    tmp_u32 = htonl(dlt);
-    fwrite(&tmp_u32, sizeof(tmp_u32), 1, lte_pcap_fd);
-}
-void LTE_fdd_enb_interface::open_ip_pcap_fd()
-{
-    uint32 magic_number = 0xa1b2c3d4;
-    uint32 timezone     = 0;
-    uint32 sigfigs      = 0;
-    uint32 snap_len     = 0xFFFF;
-    uint32 dlt          = 228;
-    uint32 tmp_u32;
-    uint16 major_version = 2;
-    uint16 minor_version = 4;
-    uint16 tmp_u16;
-
-    ip_pcap_fd = fopen("/tmp/LTE_fdd_enodeb_ip.pcap", "w");
-
-    tmp_u32 = htonl(magic_number);
-    fwrite(&tmp_u32, sizeof(tmp_u32), 1, ip_pcap_fd);
-    tmp_u16 = htons(major_version);
-    fwrite(&tmp_u16, sizeof(tmp_u16), 1, ip_pcap_fd);
-    tmp_u16 = htons(minor_version);
-    fwrite(&tmp_u16, sizeof(tmp_u16), 1, ip_pcap_fd);
-    tmp_u32 = htonl(timezone);
-    fwrite(&tmp_u32, sizeof(tmp_u32), 1, ip_pcap_fd);
-    tmp_u32 = htonl(sigfigs);
-    fwrite(&tmp_u32, sizeof(tmp_u32), 1, ip_pcap_fd);
-    tmp_u32 = htonl(snap_len);
-    fwrite(&tmp_u32, sizeof(tmp_u32), 1, ip_pcap_fd);
-    tmp_u32 = htonl(dlt);
-    fwrite(&tmp_u32, sizeof(tmp_u32), 1, ip_pcap_fd);
+    debug_socket->send(msg, debug_sock_fd);
 }
 void LTE_fdd_enb_interface::send_lte_pcap_msg(LTE_FDD_ENB_PCAP_DIRECTION_ENUM  dir,
                                               uint32                           rnti,
@@ -734,116 +607,43 @@ void LTE_fdd_enb_interface::send_lte_pcap_msg(LTE_FDD_ENB_PCAP_DIRECTION_ENUM  d
                                               uint8                           *msg,
                                               uint32                           N_bits)
 {
-    struct timeval  time;
-    struct timezone time_zone;
-    uint32          i;
-    uint32          idx;
-    uint32          length;
-    uint32          tmp_u32;
-    uint16          tmp_u16;
-    uint8           pcap_c_hdr[15];
-    uint8           pcap_msg[LIBLTE_MAX_MSG_SIZE*2];
-
     if(!enable_pcap)
         return;
 
-    // Get approximate time stamp
-    gettimeofday(&time, &time_zone);
-
-    // Radio Type
-    pcap_c_hdr[0] = 1;
-
-    // Direction
-    pcap_c_hdr[1] = dir;
-
-    // RNTI Type
-    if(0xFFFFFFFF == rnti)
-    {
-        pcap_c_hdr[2] = 0;
-    }else if(LIBLTE_MAC_P_RNTI == rnti){
-        pcap_c_hdr[2] = 1;
-    }else if(LIBLTE_MAC_RA_RNTI_START <= rnti &&
-             LIBLTE_MAC_RA_RNTI_END   >= rnti){
-        pcap_c_hdr[2] = 2;
-    }else if(LIBLTE_MAC_SI_RNTI == rnti){
-        pcap_c_hdr[2] = 4;
-    }else if(LIBLTE_MAC_M_RNTI == rnti){
-        pcap_c_hdr[2] = 6;
-    }else{
-        pcap_c_hdr[2] = 3;
-    }
-
-    // RNTI Tag and RNTI
-    pcap_c_hdr[3] = 2;
-    tmp_u16       = htons((uint16)rnti);
-    memcpy(&pcap_c_hdr[4], &tmp_u16, sizeof(uint16));
-
-    // UEID Tag and UEID
-    pcap_c_hdr[6] = 3;
-    tmp_u16       = htons((uint16)rnti);
-    memcpy(&pcap_c_hdr[7], &tmp_u16, sizeof(uint16));
-
-    // SUBFN Tag and SUBFN
-    pcap_c_hdr[9] = 4;
-    tmp_u16       = htons((uint16)(((current_tti/10) << 4) | current_tti%10));
-    memcpy(&pcap_c_hdr[10], &tmp_u16, sizeof(uint16));
-
-    // CRC Status Tag and CRC Status
-    pcap_c_hdr[12] = 7;
-    pcap_c_hdr[13] = 1;
-
-    // Payload Tag
-    pcap_c_hdr[14] = 1;
-
-    // Payload
-    idx           = 0;
-    pcap_msg[idx] = 0;
-    for(i=0; i<N_bits; i++)
-    {
-        pcap_msg[idx] <<= 1;
-        pcap_msg[idx]  |= msg[i];
-        if((i % 8) == 7)
-        {
-            idx++;
-            pcap_msg[idx] = 0;
-        }
-    }
-
-    // Total Length
-    length = 15 + idx;
-
-    // Write Data
-    tmp_u32 = htonl(time.tv_sec);
-    fwrite(&tmp_u32, sizeof(uint32), 1, lte_pcap_fd);
-    tmp_u32 = htonl(time.tv_usec);
-    fwrite(&tmp_u32, sizeof(uint32), 1, lte_pcap_fd);
-    tmp_u32 = htonl(length);
-    fwrite(&tmp_u32,   sizeof(uint32), 1,   lte_pcap_fd);
-    fwrite(&tmp_u32,   sizeof(uint32), 1,   lte_pcap_fd);
-    fwrite(pcap_c_hdr, sizeof(uint8),  15,  lte_pcap_fd);
-    fwrite(pcap_msg,   sizeof(uint8),  idx, lte_pcap_fd);
+    pcap->send_lte(dir, rnti, current_tti, msg, N_bits);
 }
-void LTE_fdd_enb_interface::send_ip_pcap_msg(uint8 *msg, uint32 N_bytes)
+void LTE_fdd_enb_interface::send_ip_pcap_msg(uint32  rnti,
+                                             uint8  *msg,
+                                             uint32  N_bytes)
 {
-    struct timeval  time;
-    struct timezone time_zone;
-    uint32          tmp;
-
     if(!enable_pcap)
         return;
 
-    // Get approximate time stamp
-    gettimeofday(&time, &time_zone);
+    pcap->send_ip(rnti, msg, N_bytes);
+}
+void LTE_fdd_enb_interface::count_metric(uint8                           cell,
+                                         LTE_FDD_ENB_METRIC_COUNTER_ENUM counter,
+                                         uint64                          N)
+{
+    metrics->count(cell, counter, N);
+}
+void LTE_fdd_enb_interface::sample_metric(uint8                         cell,
+                                          LTE_FDD_ENB_METRIC_HIST_ENUM  hist,
+                                          struct timespec              *start)
+{
+    struct timespec now;
 
-    // Write Data
-    tmp = htonl(time.tv_sec);
-    fwrite(&tmp, sizeof(uint32), 1, ip_pcap_fd);
-    tmp = htonl(time.tv_usec);
-    fwrite(&tmp, sizeof(uint32), 1, ip_pcap_fd);
-    tmp = htonl(N_bytes);
-    fwrite(&tmp, sizeof(uint32), 1,       ip_pcap_fd);
-    fwrite(&tmp, sizeof(uint32), 1,       ip_pcap_fd);
-    fwrite(msg,  sizeof(uint8),  N_bytes, ip_pcap_fd);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    metrics->sample(cell, hist, ((int64)(now.tv_sec - start->tv_sec)*1000000 +
+                                 (now.tv_nsec - start->tv_nsec)/1000));
+}
+void LTE_fdd_enb_interface::add_metrics_msgq(LTE_fdd_enb_msgq *msgq)
+{
+    metrics->add_msgq(msgq);
+}
+void LTE_fdd_enb_interface::remove_metrics_msgq(LTE_fdd_enb_msgq *msgq)
+{
+    metrics->remove_msgq(msgq);
 }
 void LTE_fdd_enb_interface::handle_ctrl_msg(const std::string msg, const int32 sock_fd)
 {
@@ -851,7 +651,7 @@ void LTE_fdd_enb_interface::handle_ctrl_msg(const std::string msg, const int32 s
     {
         send_ctrl_msg("ok");
         shutdown = true;
-        if(radio->is_started())
+        if(cells[0].radio->is_started())
             return handle_stop();
         return;
     }
@@ -874,6 +674,10 @@ void LTE_fdd_enb_interface::handle_ctrl_msg(const std::string msg, const int32 s
         return handle_print_users();
     if(0 == msg.find(print_registered_users_token))
         return handle_print_registered_users();
+    if(0 == msg.find(print_threads_token))
+        return handle_print_threads();
+    if(0 == msg.find(metrics_token))
+        return handle_metrics(msg);
     if(0 == msg.find(read_token))
         return handle_read(msg);
     if(0 == msg.find(write_token))
@@ -952,19 +756,23 @@ void LTE_fdd_enb_interface::handle_read(std::string msg)
     if(0 == param.find(bandwidth_token))
         return send_ctrl_msg("ok " + get_bandwidth_string());
     if(0 == param.find(band_token))
-        return send_ctrl_msg("ok " + std::to_string(get_band()));
+        return send_ctrl_msg("ok " + std::to_string(get_band(selected_cell)));
+    if(0 == param.find(n_cells_token))
+        return send_ctrl_msg("ok " + std::to_string(N_cells));
+    if(0 == param.find(selected_cell_token))
+        return send_ctrl_msg("ok " + std::to_string(selected_cell));
     if(0 == param.find(dl_earfcn_token))
-        return send_ctrl_msg("ok " + std::to_string(dl_earfcn));
+        return send_ctrl_msg("ok " + std::to_string(cells[selected_cell].dl_earfcn));
     if(0 == param.find(n_ant_token))
         return send_ctrl_msg("ok " + std::to_string(N_ant));
     if(0 == param.find(n_id_cell_token))
-        return send_ctrl_msg("ok " + std::to_string(N_id_cell));
+        return send_ctrl_msg("ok " + std::to_string(cells[selected_cell].N_id_cell));
     if(0 == param.find(mcc_token))
         return send_ctrl_msg("ok " + get_mcc_string());
     if(0 == param.find(mnc_token))
         return send_ctrl_msg("ok " + get_mnc_string());
     if(0 == param.find(cell_id_token))
-        return send_ctrl_msg("ok " + std::to_string(get_cell_id()));
+        return send_ctrl_msg("ok " + std::to_string(cells[selected_cell].cell_id));
     if(0 == param.find(tracking_area_code_token))
         return send_ctrl_msg("ok " + std::to_string(get_tracking_area_code()));
     if(0 == param.find(q_rx_lev_min_token))
@@ -999,8 +807,36 @@ void LTE_fdd_enb_interface::handle_read(std::string msg)
         return send_ctrl_msg("ok " + get_debug_type_string());
     if(0 == param.find(debug_level_token))
         return send_ctrl_msg("ok " + get_debug_level_string());
+    if(0 == param.find(dl_sched_policy_token))
+        return send_ctrl_msg("ok " + get_dl_sched_policy_string());
+    if(0 == param.find(ul_sched_policy_token))
+        return send_ctrl_msg("ok " + get_ul_sched_policy_string());
+    if(0 == param.find(sps_interval_token))
+        return send_ctrl_msg("ok " + std::to_string(get_sps_interval()));
+    if(0 == param.find(drx_long_cycle_token))
+        return send_ctrl_msg("ok " + std::to_string(get_drx_long_cycle()));
+    if(0 == param.find(drx_short_cycle_token))
+        return send_ctrl_msg("ok " + std::to_string(get_drx_short_cycle()));
+    if(0 == param.find(drx_on_duration_token))
+        return send_ctrl_msg("ok " + std::to_string(get_drx_on_duration()));
+    if(0 == param.find(drx_inactivity_timer_token))
+        return send_ctrl_msg("ok " + std::to_string(get_drx_inactivity_timer()));
     if(0 == param.find(enable_pcap_token))
         return send_ctrl_msg("ok " + get_enable_pcap_string());
+    if(0 == param.find(pcap_dir_token))
+        return send_ctrl_msg("ok " + pcap_dir);
+    if(0 == param.find(pcap_max_size_token))
+        return send_ctrl_msg("ok " + std::to_string(pcap_max_size));
+    if(0 == param.find(pcap_period_token))
+        return send_ctrl_msg("ok " + std::to_string(pcap_period));
+    if(0 == param.find(pcap_rnti_token))
+        return send_ctrl_msg("ok " + std::to_string(pcap_rnti));
+    if(0 == param.find(metrics_file_token))
+        return send_ctrl_msg("ok " + metrics_file);
+    if(0 == param.find(metrics_period_token))
+        return send_ctrl_msg("ok " + std::to_string(metrics_period));
+    if(0 == param.find(metrics_format_token))
+        return send_ctrl_msg("ok " + std::string(LTE_fdd_enb_metrics_format_text[metrics_format]));
     if(0 == param.find(ip_addr_start_token))
         return send_ctrl_msg("ok " + get_ip_addr_start_string());
     if(0 == param.find(dns_addr_token))
@@ -1009,23 +845,27 @@ void LTE_fdd_enb_interface::handle_read(std::string msg)
         return send_ctrl_msg("ok " + get_use_cnfg_file_string());
     if(0 == param.find(use_user_file_token))
         return send_ctrl_msg("ok " + get_use_user_file_string());
+    if(0 == param.find(stack_event_loops_token))
+        return send_ctrl_msg("ok " + std::to_string(N_stack_event_loops));
     if(0 == param.find(available_radios_token))
         return send_ctrl_msg(
-            "ok " + radio->get_available_radios_string());
+            "ok " + cells[selected_cell].radio->get_available_radios_string());
     if(0 == param.find(selected_radio_name_token))
         return send_ctrl_msg(
-            "ok " + radio->get_selected_radio().name);
+            "ok " + cells[selected_cell].radio->get_selected_radio().name);
     if(0 == param.find(selected_radio_idx_token))
         return send_ctrl_msg(
-            "ok " + std::to_string(radio->get_selected_radio_idx()));
+            "ok " + std::to_string(cells[selected_cell].radio->get_selected_radio_idx()));
     if(0 == param.find(clock_source_token))
-        return send_ctrl_msg("ok " + radio->get_clock_source());
+        return send_ctrl_msg("ok " + cells[selected_cell].radio->get_clock_source());
     if(0 == param.find(tx_gain_token))
         return send_ctrl_msg(
-            "ok " + std::to_string(radio->get_tx_gain()));
+            "ok " + std::to_string(cells[selected_cell].radio->get_tx_gain()));
     if(0 == param.find(rx_gain_token))
         return send_ctrl_msg(
-            "ok " + std::to_string(radio->get_rx_gain()));
+            "ok " + std::to_string(cells[selected_cell].radio->get_rx_gain()));
+    if(handle_read_thread_cnfg(param))
+        return;
     send_ctrl_msg("fail invalid " + read_token + " parameter");
 }
 void LTE_fdd_enb_interface::handle_write(std::string msg)
@@ -1033,6 +873,12 @@ void LTE_fdd_enb_interface::handle_write(std::string msg)
     if(0 != msg.find(write_token + " "))
         return send_ctrl_msg("fail invalid " + write_token + " command");
     std::string param = msg.substr(write_token.length() + 1);
+    if(0 == param.find(selected_cell_token + " "))
+    {
+        if(set_selected_cell(param.substr(selected_cell_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + selected_cell_token + " value");
+        return send_ctrl_msg("ok");
+    }
     if(0 == param.find(mcc_token + " "))
     {
         if(set_mcc(param.substr(mcc_token.length()+1)))
@@ -1129,6 +975,48 @@ void LTE_fdd_enb_interface::handle_write(std::string msg)
             return send_ctrl_msg("fail invalid " + debug_level_token + " value");
         return send_ctrl_msg("ok");
     }
+    if(0 == param.find(dl_sched_policy_token + " "))
+    {
+        if(set_dl_sched_policy(param.substr(dl_sched_policy_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + dl_sched_policy_token + " value");
+        return send_ctrl_msg("ok");
+    }
+    if(0 == param.find(ul_sched_policy_token + " "))
+    {
+        if(set_ul_sched_policy(param.substr(ul_sched_policy_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + ul_sched_policy_token + " value");
+        return send_ctrl_msg("ok");
+    }
+    if(0 == param.find(sps_interval_token + " "))
+    {
+        if(set_sps_interval(param.substr(sps_interval_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + sps_interval_token + " value");
+        return send_ctrl_msg("ok");
+    }
+    if(0 == param.find(drx_long_cycle_token + " "))
+    {
+        if(set_drx_long_cycle(param.substr(drx_long_cycle_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + drx_long_cycle_token + " value");
+        return send_ctrl_msg("ok");
+    }
+    if(0 == param.find(drx_short_cycle_token + " "))
+    {
+        if(set_drx_short_cycle(param.substr(drx_short_cycle_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + drx_short_cycle_token + " value");
+        return send_ctrl_msg("ok");
+    }
+    if(0 == param.find(drx_on_duration_token + " "))
+    {
+        if(set_drx_on_duration(param.substr(drx_on_duration_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + drx_on_duration_token + " value");
+        return send_ctrl_msg("ok");
+    }
+    if(0 == param.find(drx_inactivity_timer_token + " "))
+    {
+        if(set_drx_inactivity_timer(param.substr(drx_inactivity_timer_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + drx_inactivity_timer_token + " value");
+        return send_ctrl_msg("ok");
+    }
     if(0 == param.find(use_cnfg_file_token + " "))
     {
         if(set_use_cnfg_file(param.substr(use_cnfg_file_token.length()+1)))
@@ -1143,6 +1031,48 @@ void LTE_fdd_enb_interface::handle_write(std::string msg)
             return send_ctrl_msg("fail invalid " + use_user_file_token + " value");
         return send_ctrl_msg("ok");
     }
+    if(0 == param.find(pcap_dir_token + " "))
+    {
+        if(set_pcap_dir(param.substr(pcap_dir_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + pcap_dir_token + " value");
+        return send_ctrl_msg("ok");
+    }
+    if(0 == param.find(pcap_max_size_token + " "))
+    {
+        if(set_pcap_max_size(param.substr(pcap_max_size_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + pcap_max_size_token + " value");
+        return send_ctrl_msg("ok");
+    }
+    if(0 == param.find(pcap_period_token + " "))
+    {
+        if(set_pcap_period(param.substr(pcap_period_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + pcap_period_token + " value");
+        return send_ctrl_msg("ok");
+    }
+    if(0 == param.find(pcap_rnti_token + " "))
+    {
+        if(set_pcap_rnti(param.substr(pcap_rnti_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + pcap_rnti_token + " value");
+        return send_ctrl_msg("ok");
+    }
+    if(0 == param.find(metrics_file_token + " "))
+    {
+        if(set_metrics_file(param.substr(metrics_file_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + metrics_file_token + " value");
+        return send_ctrl_msg("ok");
+    }
+    if(0 == param.find(metrics_period_token + " "))
+    {
+        if(set_metrics_period(param.substr(metrics_period_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + metrics_period_token + " value");
+        return send_ctrl_msg("ok");
+    }
+    if(0 == param.find(metrics_format_token + " "))
+    {
+        if(set_metrics_format(param.substr(metrics_format_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + metrics_format_token + " value");
+        return send_ctrl_msg("ok");
+    }
     {
         std::lock_guard<std::mutex> lock(start_mutex);
         if(started)
@@ -1160,6 +1090,12 @@ void LTE_fdd_enb_interface::handle_write(std::string msg)
             return send_ctrl_msg("fail invalid " + band_token + " value");
         return send_ctrl_msg("ok");
     }
+    if(0 == param.find(n_cells_token + " "))
+    {
+        if(set_n_cells(param.substr(n_cells_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + n_cells_token + " value");
+        return send_ctrl_msg("ok");
+    }
     if(0 == param.find(dl_earfcn_token + " "))
     {
         if(set_dl_earfcn(param.substr(dl_earfcn_token.length()+1)))
@@ -1220,32 +1156,109 @@ void LTE_fdd_enb_interface::handle_write(std::string msg)
             return send_ctrl_msg("fail invalid " + dns_addr_token + " value");
         return send_ctrl_msg("ok");
     }
+    if(0 == param.find(stack_event_loops_token + " "))
+    {
+        if(set_stack_event_loops(param.substr(stack_event_loops_token.length()+1)))
+            return send_ctrl_msg("fail invalid " + stack_event_loops_token + " value");
+        return send_ctrl_msg("ok");
+    }
     if(0 == param.find(selected_radio_idx_token + " "))
     {
-        if(radio->set_selected_radio_idx(param.substr(selected_radio_idx_token.length()+1)))
+        if(cells[selected_cell].radio->set_selected_radio_idx(param.substr(selected_radio_idx_token.length()+1)))
             return send_ctrl_msg("fail invalid " + selected_radio_idx_token + " value");
         return send_ctrl_msg("ok");
     }
     if(0 == param.find(clock_source_token + " "))
     {
-        if(radio->set_clock_source(param.substr(clock_source_token.length()+1)))
+        if(cells[selected_cell].radio->set_clock_source(param.substr(clock_source_token.length()+1)))
             return send_ctrl_msg("fail invalid " + clock_source_token + " value");
         return send_ctrl_msg("ok");
     }
     if(0 == param.find(tx_gain_token + " "))
     {
-        if(radio->set_tx_gain(param.substr(tx_gain_token.length()+1)))
+        if(cells[selected_cell].radio->set_tx_gain(param.substr(tx_gain_token.length()+1)))
             return send_ctrl_msg("fail invalid " + tx_gain_token + " value");
         return send_ctrl_msg("ok");
     }
     if(0 == param.find(rx_gain_token + " "))
     {
-        if(radio->set_rx_gain(param.substr(rx_gain_token.length()+1)))
+        if(cells[selected_cell].radio->set_rx_gain(param.substr(rx_gain_token.length()+1)))
             return send_ctrl_msg("fail invalid " + rx_gain_token + " value");
         return send_ctrl_msg("ok");
     }
+    if(handle_write_thread_cnfg(param))
+        return;
     send_ctrl_msg("fail invalid " + write_token + " parameter");
 }
+bool LTE_fdd_enb_interface::handle_read_thread_cnfg(std::string param)
+{
+    std::lock_guard<std::mutex> lock(thread_mutex);
+
+    for(uint32 i=0; i<LTE_FDD_ENB_THREAD_N_ITEMS; i++)
+    {
+        if(0 == param.find(thread_cores_token[i]))
+        {
+            send_ctrl_msg("ok " + thread_cnfg[i].cores);
+            return true;
+        }
+        if(0 == param.find(thread_sched_policy_token[i]))
+        {
+            send_ctrl_msg("ok " + std::string(LTE_fdd_enb_sched_policy_text[thread_cnfg[i].sched_policy]));
+            return true;
+        }
+        if(0 == param.find(thread_sched_prio_token[i]))
+        {
+            send_ctrl_msg("ok " + std::to_string(thread_cnfg[i].sched_prio));
+            return true;
+        }
+        if(0 == param.find(thread_busy_poll_token[i]))
+        {
+            send_ctrl_msg("ok " + bool_to_enable_string(thread_cnfg[i].busy_poll));
+            return true;
+        }
+    }
+    return false;
+}
+bool LTE_fdd_enb_interface::handle_write_thread_cnfg(std::string param)
+{
+    for(uint32 i=0; i<LTE_FDD_ENB_THREAD_N_ITEMS; i++)
+    {
+        LTE_FDD_ENB_THREAD_ENUM thread_class = (LTE_FDD_ENB_THREAD_ENUM)i;
+        if(0 == param.find(thread_cores_token[i] + " "))
+        {
+            if(set_thread_cores(thread_class, param.substr(thread_cores_token[i].length()+1)))
+                send_ctrl_msg("fail invalid " + thread_cores_token[i] + " value");
+            else
+                send_ctrl_msg("ok");
+            return true;
+        }
+        if(0 == param.find(thread_sched_policy_token[i] + " "))
+        {
+            if(set_thread_sched_policy(thread_class, param.substr(thread_sched_policy_token[i].length()+1)))
+                send_ctrl_msg("fail invalid " + thread_sched_policy_token[i] + " value");
+            else
+                send_ctrl_msg("ok");
+            return true;
+        }
+        if(0 == param.find(thread_sched_prio_token[i] + " "))
+        {
+            if(set_thread_sched_prio(thread_class, param.substr(thread_sched_prio_token[i].length()+1)))
+                send_ctrl_msg("fail invalid " + thread_sched_prio_token[i] + " value");
+            else
+                send_ctrl_msg("ok");
+            return true;
+        }
+        if(0 == param.find(thread_busy_poll_token[i] + " "))
+        {
+            if(set_thread_busy_poll(thread_class, param.substr(thread_busy_poll_token[i].length()+1)))
+                send_ctrl_msg("fail invalid " + thread_busy_poll_token[i] + " value");
+            else
+                send_ctrl_msg("ok");
+            return true;
+        }
+    }
+    return false;
+}
 std::string LTE_fdd_enb_interface::get_bandwidth_string()
 {
     return sys_info.mib.dl_Bandwidth_ValueToString(sys_info.mib.dl_Bandwidth_Value());
@@ -1287,31 +1300,55 @@ int LTE_fdd_enb_interface::set_bandwidth(std::string bandwidth)
     }
     return 0;
 }
-uint32 LTE_fdd_enb_interface::get_band()
+uint32 LTE_fdd_enb_interface::get_band(uint8 cell)
 {
-    return sys_info.sib1.freqBandIndicator_Value();
+    return cells[cell].band;
 }
 int LTE_fdd_enb_interface::set_band(std::string band)
 {
     int64 value;
     if(to_number(band, value, 1, 25) || sys_info.sib1.freqBandIndicator_SetValue(value))
         return -1;
-    dl_earfcn      = liblte_interface_first_dl_earfcn[value];
-    ul_earfcn      = liblte_interface_get_corresponding_ul_earfcn(dl_earfcn);
-    dl_center_freq = liblte_interface_dl_earfcn_to_frequency(dl_earfcn);
-    ul_center_freq = liblte_interface_ul_earfcn_to_frequency(ul_earfcn);
+    LTE_FDD_ENB_CELL_STRUCT *sel = &cells[selected_cell];
+    sel->band           = value;
+    sel->dl_earfcn      = liblte_interface_first_dl_earfcn[value];
+    sel->ul_earfcn      = liblte_interface_get_corresponding_ul_earfcn(sel->dl_earfcn);
+    sel->dl_center_freq = liblte_interface_dl_earfcn_to_frequency(sel->dl_earfcn);
+    sel->ul_center_freq = liblte_interface_ul_earfcn_to_frequency(sel->ul_earfcn);
+    return 0;
+}
+uint8 LTE_fdd_enb_interface::get_n_cells()
+{
+    return N_cells;
+}
+int LTE_fdd_enb_interface::set_n_cells(std::string _N_cells)
+{
+    int64 value;
+    if(to_number(_N_cells, value, 1, LTE_FDD_ENB_MAX_N_CELLS))
+        return -1;
+    N_cells = value;
+    if(selected_cell >= N_cells)
+        selected_cell = 0;
+    return 0;
+}
+int LTE_fdd_enb_interface::set_selected_cell(std::string _selected_cell)
+{
+    int64 value;
+    if(to_number(_selected_cell, value, 0, N_cells-1))
+        return -1;
+    selected_cell = value;
     return 0;
 }
-uint16 LTE_fdd_enb_interface::get_dl_earfcn()
+uint16 LTE_fdd_enb_interface::get_dl_earfcn(uint8 cell)
 {
-    return dl_earfcn;
+    return cells[cell].dl_earfcn;
 }
 int LTE_fdd_enb_interface::set_dl_earfcn(std::string _dl_earfcn)
 {
     int64 value;
     if(to_number(_dl_earfcn, value, 0, 65535))
         return -1;
-    int64_t band_num = sys_info.sib1.freqBandIndicator_Value();
+    int64_t band_num = cells[selected_cell].band;
     int64_t band = -1;
     for(uint32 i=0; i<LIBLTE_INTERFACE_BAND_N_ITEMS; i++)
     {
@@ -1326,15 +1363,16 @@ int LTE_fdd_enb_interface::set_dl_earfcn(std::string _dl_earfcn)
     if(!(value >= liblte_interface_first_dl_earfcn[band] &&
          value <= liblte_interface_last_dl_earfcn[band]))
         return -1;
-    dl_earfcn      = value;
-    ul_earfcn      = liblte_interface_get_corresponding_ul_earfcn(dl_earfcn);
-    dl_center_freq = liblte_interface_dl_earfcn_to_frequency(dl_earfcn);
-    ul_center_freq = liblte_interface_ul_earfcn_to_frequency(ul_earfcn);
+    LTE_FDD_ENB_CELL_STRUCT *sel = &cells[selected_cell];
+    sel->dl_earfcn      = value;
+    sel->ul_earfcn      = liblte_interface_get_corresponding_ul_earfcn(sel->dl_earfcn);
+    sel->dl_center_freq = liblte_interface_dl_earfcn_to_frequency(sel->dl_earfcn);
+    sel->ul_center_freq = liblte_interface_ul_earfcn_to_frequency(sel->ul_earfcn);
     return 0;
 }
-uint16 LTE_fdd_enb_interface::get_ul_earfcn()
+uint16 LTE_fdd_enb_interface::get_ul_earfcn(uint8 cell)
 {
-    return ul_earfcn;
+    return cells[cell].ul_earfcn;
 }
 uint32 LTE_fdd_enb_interface::get_n_rb_dl()
 {
@@ -1344,13 +1382,13 @@ uint32 LTE_fdd_enb_interface::get_n_rb_ul()
 {
     return N_rb_ul;
 }
-uint32 LTE_fdd_enb_interface::get_dl_center_freq()
+uint32 LTE_fdd_enb_interface::get_dl_center_freq(uint8 cell)
 {
-    return dl_center_freq;
+    return cells[cell].dl_center_freq;
 }
-uint32 LTE_fdd_enb_interface::get_ul_center_freq()
+uint32 LTE_fdd_enb_interface::get_ul_center_freq(uint8 cell)
 {
-    return ul_center_freq;
+    return cells[cell].ul_center_freq;
 }
 uint32 LTE_fdd_enb_interface::get_n_sc_rb_dl()
 {
@@ -1372,27 +1410,28 @@ int LTE_fdd_enb_interface::set_n_ant(std::string _N_ant)
     N_ant = value;
     return 0;
 }
-uint16 LTE_fdd_enb_interface::get_n_id_cell()
+uint16 LTE_fdd_enb_interface::get_n_id_cell(uint8 cell)
 {
-    return N_id_cell;
+    return cells[cell].N_id_cell;
 }
 int LTE_fdd_enb_interface::set_n_id_cell(std::string _N_id_cell)
 {
     int64 value;
     if(to_number(_N_id_cell, value, 0, 503))
         return -1;
-    N_id_cell = value;
-    N_id_2    = N_id_cell % 3;
-    N_id_1    = (N_id_cell - N_id_2) / 3;
+    LTE_FDD_ENB_CELL_STRUCT *sel = &cells[selected_cell];
+    sel->N_id_cell = value;
+    sel->N_id_2    = sel->N_id_cell % 3;
+    sel->N_id_1    = (sel->N_id_cell - sel->N_id_2) / 3;
     return 0;
 }
-uint8 LTE_fdd_enb_interface::get_n_id_1()
+uint8 LTE_fdd_enb_interface::get_n_id_1(uint8 cell)
 {
-    return N_id_1;
+    return cells[cell].N_id_1;
 }
-uint8 LTE_fdd_enb_interface::get_n_id_2()
+uint8 LTE_fdd_enb_interface::get_n_id_2(uint8 cell)
 {
-    return N_id_2;
+    return cells[cell].N_id_2;
 }
 std::string LTE_fdd_enb_interface::get_mcc_string()
 {
@@ -1443,16 +1482,18 @@ int LTE_fdd_enb_interface::set_mnc(std::string mnc)
     sys_info.sib1.cellAccessRelatedInfo_value.plmn_IdentityList_Set()->SetValue(plmn_ids);
     return 0;
 }
-uint32 LTE_fdd_enb_interface::get_cell_id()
+uint32 LTE_fdd_enb_interface::get_cell_id(uint8 cell)
 {
-    return sys_info.sib1.cellAccessRelatedInfo_value.cellIdentity_Get().Value();
+    return cells[cell].cell_id;
 }
 int LTE_fdd_enb_interface::set_cell_id(std::string cell_id)
 {
     int64 value;
+    // The cell's own SIB1 takes the identity when the cell starts
     if(to_number(cell_id, value, 0, 268435455))
         return -1;
-    return sys_info.sib1.cellAccessRelatedInfo_value.cellIdentity_Set()->SetValue(value);
+    cells[selected_cell].cell_id = value;
+    return 0;
 }
 uint16 LTE_fdd_enb_interface::get_tracking_area_code()
 {
@@ -1746,6 +1787,141 @@ int LTE_fdd_enb_interface::set_debug_level(std::string _debug_level)
     debug_level = value;
     return 0;
 }
+std::string LTE_fdd_enb_interface::get_dl_sched_policy_string()
+{
+    return LTE_fdd_enb_dl_sched_policy_text[dl_sched_policy];
+}
+LTE_FDD_ENB_DL_SCHED_POLICY_ENUM LTE_fdd_enb_interface::get_dl_sched_policy()
+{
+    return dl_sched_policy;
+}
+int LTE_fdd_enb_interface::set_dl_sched_policy(std::string _dl_sched_policy)
+{
+    for(uint32 i=0; i<LTE_FDD_ENB_DL_SCHED_POLICY_N_ITEMS; i++)
+    {
+        if(_dl_sched_policy == LTE_fdd_enb_dl_sched_policy_text[i])
+        {
+            dl_sched_policy = (LTE_FDD_ENB_DL_SCHED_POLICY_ENUM)i;
+            return 0;
+        }
+    }
+    return 1;
+}
+std::string LTE_fdd_enb_interface::get_ul_sched_policy_string()
+{
+    return LTE_fdd_enb_dl_sched_policy_text[ul_sched_policy];
+}
+LTE_FDD_ENB_DL_SCHED_POLICY_ENUM LTE_fdd_enb_interface::get_ul_sched_policy()
+{
+    return ul_sched_policy;
+}
+int LTE_fdd_enb_interface::set_ul_sched_policy(std::string _ul_sched_policy)
+{
+    for(uint32 i=0; i<LTE_FDD_ENB_DL_SCHED_POLICY_N_ITEMS; i++)
+    {
+        if(_ul_sched_policy == LTE_fdd_enb_dl_sched_policy_text[i])
+        {
+            ul_sched_policy = (LTE_FDD_ENB_DL_SCHED_POLICY_ENUM)i;
+            return 0;
+        }
+    }
+    return 1;
+}
+uint32 LTE_fdd_enb_interface::get_sps_interval()
+{
+    return sps_interval;
+}
+int LTE_fdd_enb_interface::set_sps_interval(std::string _sps_interval)
+{
+    int64 value;
+    if(to_number(_sps_interval, value, 0, 640))
+        return -1;
+    for(uint32 i=0; i<LTE_FDD_ENB_N_SPS_INTERVALS; i++)
+    {
+        if(value == LTE_fdd_enb_sps_interval[i])
+        {
+            sps_interval = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+uint32 LTE_fdd_enb_interface::get_drx_long_cycle()
+{
+    return drx_long_cycle;
+}
+int LTE_fdd_enb_interface::set_drx_long_cycle(std::string _drx_long_cycle)
+{
+    int64 value;
+    if(to_number(_drx_long_cycle, value, 0, 2560))
+        return -1;
+    for(uint32 i=0; i<LTE_FDD_ENB_N_DRX_LONG_CYCLES; i++)
+    {
+        if(value == LTE_fdd_enb_drx_long_cycle[i])
+        {
+            drx_long_cycle = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+uint32 LTE_fdd_enb_interface::get_drx_short_cycle()
+{
+    return drx_short_cycle;
+}
+int LTE_fdd_enb_interface::set_drx_short_cycle(std::string _drx_short_cycle)
+{
+    int64 value;
+    if(to_number(_drx_short_cycle, value, 0, 640))
+        return -1;
+    for(uint32 i=0; i<LTE_FDD_ENB_N_DRX_SHORT_CYCLES; i++)
+    {
+        if(value == LTE_fdd_enb_drx_short_cycle[i])
+        {
+            drx_short_cycle = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+uint32 LTE_fdd_enb_interface::get_drx_on_duration()
+{
+    return drx_on_duration;
+}
+int LTE_fdd_enb_interface::set_drx_on_duration(std::string _drx_on_duration)
+{
+    int64 value;
+    if(to_number(_drx_on_duration, value, 1, 200))
+        return -1;
+    for(uint32 i=0; i<LTE_FDD_ENB_N_DRX_ON_DURATIONS; i++)
+    {
+        if(value == LTE_fdd_enb_drx_on_duration[i])
+        {
+            drx_on_duration = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+uint32 LTE_fdd_enb_interface::get_drx_inactivity_timer()
+{
+    return drx_inactivity_timer;
+}
+int LTE_fdd_enb_interface::set_drx_inactivity_timer(std::string _drx_inactivity_timer)
+{
+    int64 value;
+    if(to_number(_drx_inactivity_timer, value, 1, 2560))
+        return -1;
+    for(uint32 i=0; i<LTE_FDD_ENB_N_DRX_INACTIVITY_TIMERS; i++)
+    {
+        if(value == LTE_fdd_enb_drx_inactivity_timer[i])
+        {
+            drx_inactivity_timer = value;
+            return 0;
+        }
+    }
+    return -1;
+}
 std::string LTE_fdd_enb_interface::get_enable_pcap_string()
 {
     return bool_to_enable_string(enable_pcap);
@@ -1759,6 +1935,76 @@ int LTE_fdd_enb_interface::set_enable_pcap(std::string _enable_pcap)
     enable_pcap = enable_string_to_bool(_enable_pcap);
     return 0;
 }
+int LTE_fdd_enb_interface::set_pcap_dir(std::string _pcap_dir)
+{
+    // Takes effect with the next file
+    if(0 != access(_pcap_dir.c_str(), W_OK | X_OK))
+        return -1;
+    pcap_dir = _pcap_dir;
+    pcap->set_dir(pcap_dir);
+    return 0;
+}
+int LTE_fdd_enb_interface::set_pcap_max_size(std::string _pcap_max_size)
+{
+    int64 value;
+    if(to_number(_pcap_max_size, value, 0, 4096))
+        return -1;
+    pcap_max_size = value;
+    pcap->set_rotation(pcap_max_size, pcap_period);
+    return 0;
+}
+int LTE_fdd_enb_interface::set_pcap_period(std::string _pcap_period)
+{
+    int64 value;
+    if(to_number(_pcap_period, value, 0, 86400))
+        return -1;
+    pcap_period = value;
+    pcap->set_rotation(pcap_max_size, pcap_period);
+    return 0;
+}
+int LTE_fdd_enb_interface::set_pcap_rnti(std::string _pcap_rnti)
+{
+    int64 value;
+    if(to_number(_pcap_rnti, value, 0, 65535))
+        return -1;
+    pcap_rnti = value;
+    pcap->set_rnti(pcap_rnti);
+    return 0;
+}
+int LTE_fdd_enb_interface::set_metrics_file(std::string _metrics_file)
+{
+    // The report is written next to the file and renamed over it
+    std::string dir = _metrics_file.substr(0, _metrics_file.find_last_of('/') + 1);
+    if(_metrics_file.empty()        ||
+       '/' == _metrics_file.back() ||
+       0 != access(dir.empty() ? "." : dir.c_str(), W_OK | X_OK))
+        return -1;
+    metrics_file = _metrics_file;
+    metrics->set_dump(metrics_file, metrics_period, (LTE_FDD_ENB_METRICS_FORMAT_ENUM)metrics_format);
+    return 0;
+}
+int LTE_fdd_enb_interface::set_metrics_period(std::string _metrics_period)
+{
+    int64 value;
+    if(to_number(_metrics_period, value, 0, 86400))
+        return -1;
+    metrics_period = value;
+    metrics->set_dump(metrics_file, metrics_period, (LTE_FDD_ENB_METRICS_FORMAT_ENUM)metrics_format);
+    return 0;
+}
+int LTE_fdd_enb_interface::set_metrics_format(std::string _metrics_format)
+{
+    for(uint32 i=0; i<LTE_FDD_ENB_METRICS_FORMAT_N_ITEMS; i++)
+    {
+        if(_metrics_format == LTE_fdd_enb_metrics_format_text[i])
+        {
+            metrics_format = i;
+            metrics->set_dump(metrics_file, metrics_period, (LTE_FDD_ENB_METRICS_FORMAT_ENUM)metrics_format);
+            return 0;
+        }
+    }
+    return 1;
+}
 std::string LTE_fdd_enb_interface::get_ip_addr_start_string()
 {
     std::string str;
@@ -1847,6 +2093,129 @@ int LTE_fdd_enb_interface::set_use_user_file(std::string _use_user_file)
     use_user_file = enable_string_to_bool(_use_user_file);
     return 0;
 }
+int LTE_fdd_enb_interface::set_stack_event_loops(std::string _stack_event_loops)
+{
+    int64 value;
+    if(to_number(_stack_event_loops, value, 0, LTE_FDD_ENB_MAX_N_EVENT_LOOPS))
+        return -1;
+    N_stack_event_loops = value;
+    return 0;
+}
+int LTE_fdd_enb_interface::set_thread_cores(LTE_FDD_ENB_THREAD_ENUM thread_class,
+                                            std::string             cores)
+{
+    std::lock_guard<std::mutex> lock(thread_mutex);
+    cpu_set_t                   cpu_set;
+
+    if("auto" != cores &&
+       cpu_list_to_set(cores, &cpu_set))
+        return -1;
+    thread_cnfg[thread_class].cores = cores;
+    return 0;
+}
+int LTE_fdd_enb_interface::set_thread_sched_policy(LTE_FDD_ENB_THREAD_ENUM thread_class,
+                                                   std::string             policy)
+{
+    std::lock_guard<std::mutex> lock(thread_mutex);
+
+    for(uint32 i=0; i<LTE_FDD_ENB_SCHED_POLICY_N_ITEMS; i++)
+    {
+        if(policy == LTE_fdd_enb_sched_policy_text[i])
+        {
+            thread_cnfg[thread_class].sched_policy = (LTE_FDD_ENB_SCHED_POLICY_ENUM)i;
+            return 0;
+        }
+    }
+    return -1;
+}
+int LTE_fdd_enb_interface::set_thread_sched_prio(LTE_FDD_ENB_THREAD_ENUM thread_class,
+                                                 std::string             prio)
+{
+    std::lock_guard<std::mutex> lock(thread_mutex);
+    int64                       value;
+
+    // Clamped to the range of the policy when the thread applies it
+    if(to_number(prio, value, 0, 99))
+        return -1;
+    thread_cnfg[thread_class].sched_prio = value;
+    return 0;
+}
+int LTE_fdd_enb_interface::set_thread_busy_poll(LTE_FDD_ENB_THREAD_ENUM thread_class,
+                                                std::string             busy_poll)
+{
+    std::lock_guard<std::mutex> lock(thread_mutex);
+
+    if("on" != busy_poll && "off" != busy_poll)
+        return -1;
+
+    // The radio and GW threads block in the driver and on the TUN device,
+    // there is nothing for them to poll
+    if("on" == busy_poll &&
+       (LTE_FDD_ENB_THREAD_RADIO == thread_class ||
+        LTE_FDD_ENB_THREAD_GW    == thread_class))
+        return -1;
+    thread_cnfg[thread_class].busy_poll = enable_string_to_bool(busy_poll);
+    return 0;
+}
+int LTE_fdd_enb_interface::cpu_list_to_set(std::string  cpu_list,
+                                           cpu_set_t   *cpu_set)
+{
+    int64  num_cpus = std::thread::hardware_concurrency();
+    int64  first;
+    int64  last;
+    size_t start = 0;
+    size_t end;
+    size_t dash;
+
+    CPU_ZERO(cpu_set);
+    while(start <= cpu_list.length())
+    {
+        end = cpu_list.find(",", start);
+        if(std::string::npos == end)
+            end = cpu_list.length();
+        std::string range = cpu_list.substr(start, end - start);
+        dash              = range.find("-");
+        if(std::string::npos == dash)
+        {
+            if(to_number(range, first, 0, num_cpus - 1))
+                return -1;
+            last = first;
+        }else{
+            if(to_number(range.substr(0, dash), first, 0, num_cpus - 1) ||
+               to_number(range.substr(dash + 1), last, first, num_cpus - 1))
+                return -1;
+        }
+        for(int64 cpu=first; cpu<=last; cpu++)
+            CPU_SET(cpu, cpu_set);
+        start = end + 1;
+    }
+    return 0;
+}
+std::string LTE_fdd_enb_interface::cpu_set_to_list(cpu_set_t *cpu_set)
+{
+    std::string cpu_list;
+    int32       first;
+    int32       cpu = 0;
+
+    while(cpu < CPU_SETSIZE)
+    {
+        if(!CPU_ISSET(cpu, cpu_set))
+        {
+            cpu++;
+            continue;
+        }
+        first = cpu;
+        while(cpu + 1 < CPU_SETSIZE && CPU_ISSET(cpu + 1, cpu_set))
+            cpu++;
+        if(0 != cpu_list.length())
+            cpu_list += ",";
+        cpu_list += std::to_string(first);
+        if(cpu != first)
+            cpu_list += "-" + std::to_string(cpu);
+        cpu++;
+    }
+    return cpu_list;
+}
 std::string LTE_fdd_enb_interface::bool_to_enable_string(bool value)
 {
     if(value)
@@ -1869,51 +2238,127 @@ void LTE_fdd_enb_interface::handle_start()
     }
 
     // Initialize inter-stack communication
-    phy_to_mac_comm   = new LTE_fdd_enb_msgq(this, "phy_to_mac");
-    mac_to_phy_comm   = new LTE_fdd_enb_msgq(this, "mac_to_phy");
+    LTE_fdd_enb_msgq *rlc_to_mac_comms[LTE_FDD_ENB_MAX_N_CELLS]  = {NULL};
+    LTE_fdd_enb_msgq *pdcp_to_rrc_comms[LTE_FDD_ENB_MAX_N_CELLS] = {NULL};
+    LTE_fdd_enb_msgq *mme_to_rrc_comms[LTE_FDD_ENB_MAX_N_CELLS]  = {NULL};
+    for(uint32 i=0; i<N_cells; i++)
+    {
+        std::string cell_str = "_" + std::to_string(i);
+        // The radio and MAC threads must never stall on each other, a
+        // message that does not fit is dropped and counted instead
+        cells[i].phy_to_mac_comm  = new LTE_fdd_enb_msgq(this,
+                                                         "phy_to_mac" + cell_str,
+                                                         LTE_FDD_ENB_MSGQ_DEFAULT_CAPACITY,
+                                                         LTE_FDD_ENB_MSGQ_FULL_DROP,
+                                                         false);
+        cells[i].mac_to_phy_comm  = new LTE_fdd_enb_msgq(this,
+                                                         "mac_to_phy" + cell_str,
+                                                         LTE_FDD_ENB_MAC_TO_PHY_CAPACITY,
+                                                         LTE_FDD_ENB_MSGQ_FULL_DROP,
+                                                         false);
+        cells[i].rlc_to_mac_comm  = new LTE_fdd_enb_msgq(this, "rlc_to_mac" + cell_str);
+        cells[i].pdcp_to_rrc_comm = new LTE_fdd_enb_msgq(this, "pdcp_to_rrc" + cell_str);
+        cells[i].mme_to_rrc_comm  = new LTE_fdd_enb_msgq(this, "mme_to_rrc" + cell_str);
+        rlc_to_mac_comms[i]       = cells[i].rlc_to_mac_comm;
+        pdcp_to_rrc_comms[i]      = cells[i].pdcp_to_rrc_comm;
+        mme_to_rrc_comms[i]       = cells[i].mme_to_rrc_comm;
+    }
     mac_to_rlc_comm   = new LTE_fdd_enb_msgq(this, "mac_to_rlc");
-    mac_to_timer_comm = new LTE_fdd_enb_msgq(this, "mac_to_timer");
-    rlc_to_mac_comm   = new LTE_fdd_enb_msgq(this, "rlc_to_mac");
+    mac_to_timer_comm = new LTE_fdd_enb_msgq(this,
+                                             "mac_to_timer",
+                                             LTE_FDD_ENB_MSGQ_DEFAULT_CAPACITY,
+                                             LTE_FDD_ENB_MSGQ_FULL_BLOCK,
+                                             true); // Only cell 0's MAC ticks the timers
     rlc_to_pdcp_comm  = new LTE_fdd_enb_msgq(this, "rlc_to_pdcp");
     pdcp_to_rlc_comm  = new LTE_fdd_enb_msgq(this, "pdcp_to_rlc");
-    pdcp_to_rrc_comm  = new LTE_fdd_enb_msgq(this, "pdcp_to_rrc");
     rrc_to_pdcp_comm  = new LTE_fdd_enb_msgq(this, "rrc_to_pdcp");
     rrc_to_mme_comm   = new LTE_fdd_enb_msgq(this, "rrc_to_mme");
-    mme_to_rrc_comm   = new LTE_fdd_enb_msgq(this, "mme_to_rrc");
     pdcp_to_gw_comm   = new LTE_fdd_enb_msgq(this, "pdcp_to_gw");
     gw_to_pdcp_comm   = new LTE_fdd_enb_msgq(this, "gw_to_pdcp");
 
+    // Optionally run the upper layers on event loops instead of one thread
+    // per queue, each receiving layer is kept on a single loop
+    for(uint32 i=0; i<N_stack_event_loops; i++)
+        stack_event_loop[i] = new LTE_fdd_enb_event_loop(this, i);
+    if(0 != N_stack_event_loops)
+    {
+        for(uint32 i=0; i<N_cells; i++)
+        {
+            cells[i].pdcp_to_rrc_comm->set_event_loop(stack_event_loop[2 % N_stack_event_loops]);
+            cells[i].mme_to_rrc_comm->set_event_loop(stack_event_loop[2 % N_stack_event_loops]);
+        }
+        mac_to_rlc_comm->set_event_loop(stack_event_loop[0]);
+        pdcp_to_rlc_comm->set_event_loop(stack_event_loop[0]);
+        rlc_to_pdcp_comm->set_event_loop(stack_event_loop[1 % N_stack_event_loops]);
+        rrc_to_pdcp_comm->set_event_loop(stack_event_loop[1 % N_stack_event_loops]);
+        gw_to_pdcp_comm->set_event_loop(stack_event_loop[1 % N_stack_event_loops]);
+        rrc_to_mme_comm->set_event_loop(stack_event_loop[3 % N_stack_event_loops]);
+        pdcp_to_gw_comm->set_event_loop(stack_event_loop[4 % N_stack_event_loops]);
+    }
+
     // Construct the system information
     construct_sys_info();
 
-    // Start layers
+    // Start layers (cell 0 drives the timers and the direct UE links)
     char err_str[LTE_FDD_ENB_MAX_LINE_SIZE];
     if(LTE_FDD_ENB_ERROR_NONE != gw->start(pdcp_to_gw_comm, gw_to_pdcp_comm, err_str))
+    {
+        delete_stack_comms();
+        start_mutex.lock();
+        started = false;
+        start_mutex.unlock();
         return send_ctrl_msg("fail GW start issue " + (std::string)err_str);
+    }
 
-    phy->start(mac_to_phy_comm, phy_to_mac_comm, phy_direct_to_ue, radio);
-    mac->start(phy_to_mac_comm, rlc_to_mac_comm, mac_to_phy_comm, mac_to_rlc_comm, mac_to_timer_comm, mac_direct_to_ue);
+    for(uint32 i=0; i<N_cells; i++)
+    {
+        cells[i].phy->start(cells[i].mac_to_phy_comm,
+                            cells[i].phy_to_mac_comm,
+                            phy_direct_to_ue && 0 == i,
+                            cells[i].radio);
+        cells[i].mac->start(cells[i].phy_to_mac_comm,
+                            cells[i].rlc_to_mac_comm,
+                            cells[i].mac_to_phy_comm,
+                            mac_to_rlc_comm,
+                            (0 == i) ? mac_to_timer_comm : NULL,
+                            mac_direct_to_ue && 0 == i);
+        cells[i].rrc->start(cells[i].pdcp_to_rrc_comm, cells[i].mme_to_rrc_comm, rrc_to_pdcp_comm, rrc_to_mme_comm);
+    }
     timer_mgr->start(mac_to_timer_comm);
-    rlc->start(mac_to_rlc_comm, pdcp_to_rlc_comm, rlc_to_mac_comm, rlc_to_pdcp_comm);
-    pdcp->start(rlc_to_pdcp_comm, rrc_to_pdcp_comm, gw_to_pdcp_comm, pdcp_to_rlc_comm, pdcp_to_rrc_comm, pdcp_to_gw_comm);
-    rrc->start(pdcp_to_rrc_comm, mme_to_rrc_comm, rrc_to_pdcp_comm, rrc_to_mme_comm);
-    mme->start(rrc_to_mme_comm, mme_to_rrc_comm);
-    if(LTE_FDD_ENB_ERROR_NONE == radio->start())
+    rlc->start(mac_to_rlc_comm, pdcp_to_rlc_comm, rlc_to_mac_comms, rlc_to_pdcp_comm);
+    pdcp->start(rlc_to_pdcp_comm, rrc_to_pdcp_comm, gw_to_pdcp_comm, pdcp_to_rlc_comm, pdcp_to_rrc_comms, pdcp_to_gw_comm);
+    mme->start(rrc_to_mme_comm, mme_to_rrc_comms);
+    for(uint32 i=0; i<N_stack_event_loops; i++)
+        stack_event_loop[i]->start();
+    uint32 N_radios_started = 0;
+    while(N_radios_started < N_cells &&
+          LTE_FDD_ENB_ERROR_NONE == cells[N_radios_started].radio->start())
+        N_radios_started++;
+    if(N_radios_started == N_cells)
         return send_ctrl_msg("ok");
 
-    start_mutex.lock();
-    started = false;
-    start_mutex.unlock();
-
-    phy->stop();
-    mac->stop();
+    // Undo everything above so the next start begins from scratch, the
+    // event loops are joined before their queues go away
+    for(uint32 i=0; i<N_radios_started; i++)
+        cells[i].radio->stop();
+    for(uint32 i=0; i<N_cells; i++)
+    {
+        cells[i].phy->stop();
+        cells[i].mac->stop();
+        cells[i].rrc->stop();
+    }
     timer_mgr->stop();
     rlc->stop();
     pdcp->stop();
-    rrc->stop();
     mme->stop();
+    gw->stop();
+    delete_stack_comms();
 
-    send_ctrl_msg("fail radio start issue");
+    start_mutex.lock();
+    started = false;
+    start_mutex.unlock();
+
+    send_ctrl_msg("fail radio start issue for cell " + std::to_string(N_radios_started));
 }
 void LTE_fdd_enb_interface::handle_stop()
 {
@@ -1925,39 +2370,50 @@ void LTE_fdd_enb_interface::handle_stop()
     }
 
     // Stop all layers
-    if(LTE_FDD_ENB_ERROR_NONE != radio->stop())
-        return send_ctrl_msg("fail radio stop issue");
+    for(uint32 i=0; i<N_cells; i++)
+        if(LTE_FDD_ENB_ERROR_NONE != cells[i].radio->stop())
+            return send_ctrl_msg("fail radio stop issue for cell " + std::to_string(i));
 
-    phy->stop();
-    mac->stop();
+    for(uint32 i=0; i<N_cells; i++)
+    {
+        cells[i].phy->stop();
+        cells[i].mac->stop();
+        cells[i].rrc->stop();
+    }
     timer_mgr->stop();
     rlc->stop();
     pdcp->stop();
-    rrc->stop();
     mme->stop();
     gw->stop();
 
     // Send a message to all inter-stack communication message queues and cleanup
-    phy_to_mac_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
-                          LTE_FDD_ENB_DEST_LAYER_ANY,
-                          NULL,
-                          0);
-    mac_to_phy_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
-                          LTE_FDD_ENB_DEST_LAYER_ANY,
-                          NULL,
-                          0);
+    for(uint32 i=0; i<N_cells; i++)
+    {
+        cells[i].phy_to_mac_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
+                                       LTE_FDD_ENB_DEST_LAYER_ANY,
+                                       NULL,
+                                       0);
+        cells[i].mac_to_phy_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
+                                       LTE_FDD_ENB_DEST_LAYER_ANY,
+                                       NULL,
+                                       0);
+        cells[i].rlc_to_mac_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
+                                       LTE_FDD_ENB_DEST_LAYER_ANY,
+                                       NULL,
+                                       0);
+        cells[i].pdcp_to_rrc_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
+                                        LTE_FDD_ENB_DEST_LAYER_ANY,
+                                        NULL,
+                                        0);
+        cells[i].mme_to_rrc_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
+                                       LTE_FDD_ENB_DEST_LAYER_ANY,
+                                       NULL,
+                                       0);
+    }
     mac_to_rlc_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
                           LTE_FDD_ENB_DEST_LAYER_ANY,
                           NULL,
                           0);
-    mac_to_timer_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
-                            LTE_FDD_ENB_DEST_LAYER_ANY,
-                            NULL,
-                            0);
-    rlc_to_mac_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
-                          LTE_FDD_ENB_DEST_LAYER_ANY,
-                          NULL,
-                          0);
     rlc_to_pdcp_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
                            LTE_FDD_ENB_DEST_LAYER_ANY,
                            NULL,
@@ -1966,10 +2422,6 @@ void LTE_fdd_enb_interface::handle_stop()
                            LTE_FDD_ENB_DEST_LAYER_ANY,
                            NULL,
                            0);
-    pdcp_to_rrc_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
-                           LTE_FDD_ENB_DEST_LAYER_ANY,
-                           NULL,
-                           0);
     rrc_to_pdcp_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
                            LTE_FDD_ENB_DEST_LAYER_ANY,
                            NULL,
@@ -1978,10 +2430,6 @@ void LTE_fdd_enb_interface::handle_stop()
                           LTE_FDD_ENB_DEST_LAYER_ANY,
                           NULL,
                           0);
-    mme_to_rrc_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
-                          LTE_FDD_ENB_DEST_LAYER_ANY,
-                          NULL,
-                          0);
     pdcp_to_gw_comm->send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
                           LTE_FDD_ENB_DEST_LAYER_ANY,
                           NULL,
@@ -1990,26 +2438,50 @@ void LTE_fdd_enb_interface::handle_stop()
                           LTE_FDD_ENB_DEST_LAYER_ANY,
                           NULL,
                           0);
-    delete phy_to_mac_comm;
-    delete mac_to_phy_comm;
+    delete_stack_comms();
+
+    // Delete layers
+    delete pdcp;
+    delete mme;
+    delete gw;
+
+    send_ctrl_msg("ok");
+}
+void LTE_fdd_enb_interface::delete_stack_comms()
+{
+    stop_stack_event_loops();
+    for(uint32 i=0; i<N_cells; i++)
+    {
+        delete cells[i].phy_to_mac_comm;
+        delete cells[i].mac_to_phy_comm;
+        delete cells[i].rlc_to_mac_comm;
+        delete cells[i].pdcp_to_rrc_comm;
+        delete cells[i].mme_to_rrc_comm;
+    }
     delete mac_to_rlc_comm;
+
+    // The timer queue is single producer, so it is only killed once the
+    // MAC threads that tick it have been joined
     delete mac_to_timer_comm;
-    delete rlc_to_mac_comm;
     delete rlc_to_pdcp_comm;
     delete pdcp_to_rlc_comm;
-    delete pdcp_to_rrc_comm;
     delete rrc_to_pdcp_comm;
     delete rrc_to_mme_comm;
-    delete mme_to_rrc_comm;
     delete pdcp_to_gw_comm;
     delete gw_to_pdcp_comm;
-
-    // Delete layers
-    delete pdcp;
-    delete mme;
-    delete gw;
-
-    send_ctrl_msg("ok");
+}
+void LTE_fdd_enb_interface::stop_stack_event_loops()
+{
+    // The loops must be joined before the queues they service are deleted
+    for(uint32 i=0; i<LTE_FDD_ENB_MAX_N_EVENT_LOOPS; i++)
+    {
+        if(NULL != stack_event_loop[i])
+        {
+            stack_event_loop[i]->stop();
+            delete stack_event_loop[i];
+            stack_event_loop[i] = NULL;
+        }
+    }
 }
 void LTE_fdd_enb_interface::handle_help()
 {
@@ -2024,19 +2496,23 @@ void LTE_fdd_enb_interface::handle_help()
     send_ctrl_msg("\t\t" + delete_user_token + " " + imsi_token + "=<" + imsi_token + "> - Deletes a user from the HSS");
     send_ctrl_msg("\t\t" + print_users_token + " - Prints all the users in the HSS");
     send_ctrl_msg("\t\t" + print_registered_users_token + " - Prints all the users currently registered");
+    send_ctrl_msg("\t\t" + print_threads_token + " - Prints the cores and scheduling each thread actually got");
+    send_ctrl_msg("\t\t" + metrics_token + " [<format>] - Prints the runtime metrics (<format> is " + LTE_fdd_enb_metrics_format_text[0] + " or " + LTE_fdd_enb_metrics_format_text[1] + ", default " + metrics_format_token + ")");
     send_ctrl_msg("\t\t" + read_token + " - Reads the specified parameter (" + read_token + " <param>)");
     send_ctrl_msg("\t\t" + write_token + " - Writes the specified parameter (" + write_token + " <param> <value>)");
 
     // System Parameters
     send_ctrl_msg("\tSystem Parameters:");
     send_ctrl_msg("\t\t" + bandwidth_token + " = " + get_bandwidth_string());
-    send_ctrl_msg("\t\t" + band_token + " = " + std::to_string(get_band()));
-    send_ctrl_msg("\t\t" + dl_earfcn_token + " = " + std::to_string(dl_earfcn));
+    send_ctrl_msg("\t\t" + band_token + " = " + std::to_string(get_band(selected_cell)));
+    send_ctrl_msg("\t\t" + n_cells_token + " = " + std::to_string(N_cells));
+    send_ctrl_msg("\t\t" + selected_cell_token + " = " + std::to_string(selected_cell));
+    send_ctrl_msg("\t\t" + dl_earfcn_token + " = " + std::to_string(cells[selected_cell].dl_earfcn));
     send_ctrl_msg("\t\t" + n_ant_token + " = " + std::to_string(N_ant));
-    send_ctrl_msg("\t\t" + n_id_cell_token + " = " + std::to_string(N_id_cell));
+    send_ctrl_msg("\t\t" + n_id_cell_token + " = " + std::to_string(cells[selected_cell].N_id_cell));
     send_ctrl_msg("\t\t" + mcc_token + " = " + get_mcc_string());
     send_ctrl_msg("\t\t" + mnc_token + " = " + get_mnc_string());
-    send_ctrl_msg("\t\t" + cell_id_token + " = " + std::to_string(get_cell_id()));
+    send_ctrl_msg("\t\t" + cell_id_token + " = " + std::to_string(cells[selected_cell].cell_id));
     send_ctrl_msg("\t\t" + tracking_area_code_token + " = " + std::to_string(get_tracking_area_code()));
     send_ctrl_msg("\t\t" + q_rx_lev_min_token + " = " + std::to_string(get_q_rx_lev_min()));
     send_ctrl_msg("\t\t" + si_periodicity_token + " = " + get_si_periodicity_string());
@@ -2054,11 +2530,37 @@ void LTE_fdd_enb_interface::handle_help()
     send_ctrl_msg("\t\t" + phy_direct_to_ue_token + " = " + get_phy_direct_to_ue_string());
     send_ctrl_msg("\t\t" + debug_type_token + " = " + get_debug_type_string());
     send_ctrl_msg("\t\t" + debug_level_token + " = " + get_debug_level_string());
+    send_ctrl_msg("\t\t" + dl_sched_policy_token + " = " + get_dl_sched_policy_string());
+    send_ctrl_msg("\t\t" + ul_sched_policy_token + " = " + get_ul_sched_policy_string());
+    send_ctrl_msg("\t\t" + sps_interval_token + " = " + std::to_string(get_sps_interval()));
+    send_ctrl_msg("\t\t" + drx_long_cycle_token + " = " + std::to_string(get_drx_long_cycle()));
+    send_ctrl_msg("\t\t" + drx_short_cycle_token + " = " + std::to_string(get_drx_short_cycle()));
+    send_ctrl_msg("\t\t" + drx_on_duration_token + " = " + std::to_string(get_drx_on_duration()));
+    send_ctrl_msg("\t\t" + drx_inactivity_timer_token + " = " + std::to_string(get_drx_inactivity_timer()));
     send_ctrl_msg("\t\t" + enable_pcap_token + " = " + get_enable_pcap_string());
+    send_ctrl_msg("\t\t" + pcap_dir_token + " = " + pcap_dir);
+    send_ctrl_msg("\t\t" + pcap_max_size_token + " = " + std::to_string(pcap_max_size) + " (MB per file, 0 for no limit)");
+    send_ctrl_msg("\t\t" + pcap_period_token + " = " + std::to_string(pcap_period) + " (seconds per file, 0 for no limit)");
+    send_ctrl_msg("\t\t" + pcap_rnti_token + " = " + std::to_string(pcap_rnti) + " (0 captures all RNTIs)");
+    send_ctrl_msg("\t\t" + metrics_file_token + " = " + metrics_file);
+    send_ctrl_msg("\t\t" + metrics_period_token + " = " + std::to_string(metrics_period) + " (seconds between dumps to " + metrics_file_token + ", 0 for none)");
+    send_ctrl_msg("\t\t" + metrics_format_token + " = " + LTE_fdd_enb_metrics_format_text[metrics_format]);
     send_ctrl_msg("\t\t" + ip_addr_start_token + " = " + get_ip_addr_start_string());
     send_ctrl_msg("\t\t" + dns_addr_token + " = " + get_dns_addr_string());
     send_ctrl_msg("\t\t" + use_cnfg_file_token + " = " + get_use_cnfg_file_string());
     send_ctrl_msg("\t\t" + use_user_file_token + " = " + get_use_user_file_string());
+    send_ctrl_msg("\t\t" + stack_event_loops_token + " = " + std::to_string(N_stack_event_loops) + " (0 runs each RLC/PDCP/RRC/MME/GW queue on its own thread)");
+
+    // Thread Parameters
+    std::lock_guard<std::mutex> lock(thread_mutex);
+    send_ctrl_msg("\tThread Parameters (<cores> is auto or a CPU list, e.g. 2-3,6):");
+    for(uint32 i=0; i<LTE_FDD_ENB_THREAD_N_ITEMS; i++)
+    {
+        send_ctrl_msg("\t\t" + thread_cores_token[i] + " = " + thread_cnfg[i].cores);
+        send_ctrl_msg("\t\t" + thread_sched_policy_token[i] + " = " + LTE_fdd_enb_sched_policy_text[thread_cnfg[i].sched_policy]);
+        send_ctrl_msg("\t\t" + thread_sched_prio_token[i] + " = " + std::to_string(thread_cnfg[i].sched_prio));
+        send_ctrl_msg("\t\t" + thread_busy_poll_token[i] + " = " + bool_to_enable_string(thread_cnfg[i].busy_poll));
+    }
 }
 void LTE_fdd_enb_interface::handle_add_user(std::string msg)
 {
@@ -2110,6 +2612,49 @@ void LTE_fdd_enb_interface::handle_print_registered_users()
 {
     send_ctrl_msg("ok " + user_mgr->print_all_users());
 }
+void LTE_fdd_enb_interface::handle_print_threads()
+{
+    std::lock_guard<std::mutex> lock(thread_mutex);
+    std::string                 output;
+
+    output = std::to_string((uint32)thread_layout.size());
+    for(auto &thread : thread_layout)
+    {
+        LTE_FDD_ENB_THREAD_LAYOUT_STRUCT *layout = &thread.second;
+        output += "\n" + thread.first;
+        output += " class=" + std::string(LTE_fdd_enb_thread_text[layout->thread_class]);
+        output += " tid=" + std::to_string(layout->tid);
+        output += " cores=" + layout->cores;
+        output += " sched_policy=" + std::string(LTE_fdd_enb_sched_policy_text[layout->sched_policy]);
+        output += " sched_prio=" + std::to_string(layout->sched_prio);
+        output += " busy_poll=" + bool_to_enable_string(layout->busy_poll);
+        if(0 != layout->affinity_err)
+            output += " affinity_err=\"" + std::string(strerror(layout->affinity_err)) + "\"";
+        if(0 != layout->sched_err)
+            output += " sched_err=\"" + std::string(strerror(layout->sched_err)) + "\"";
+    }
+    send_ctrl_msg("ok " + output);
+}
+void LTE_fdd_enb_interface::handle_metrics(std::string msg)
+{
+    uint32 format = metrics_format;
+
+    // An explicit format overrides metrics_format for this report only
+    if(msg.length() > metrics_token.length())
+    {
+        std::string format_str = msg.substr(metrics_token.length()+1);
+        for(format=0; format<LTE_FDD_ENB_METRICS_FORMAT_N_ITEMS; format++)
+        {
+            if(format_str == LTE_fdd_enb_metrics_format_text[format])
+                break;
+        }
+        if(LTE_FDD_ENB_METRICS_FORMAT_N_ITEMS == format)
+            return send_ctrl_msg("fail invalid " + metrics_token + " command");
+    }
+    std::string output = metrics->report((LTE_FDD_ENB_METRICS_FORMAT_ENUM)format);
+    output.pop_back(); // send_ctrl_msg adds the last newline
+    send_ctrl_msg("ok\n" + output);
+}
 void LTE_fdd_enb_interface::read_cnfg_file()
 {
     hss->read_user_file(this);
@@ -2133,13 +2678,19 @@ void LTE_fdd_enb_interface::write_cnfg_file()
     if(NULL == cnfg_file)
         return;
     fprintf(cnfg_file, "%s %s\n", bandwidth_token.c_str(), get_bandwidth_string().c_str());
-    fprintf(cnfg_file, "%s %s\n", band_token.c_str(), std::to_string(get_band()).c_str());
-    fprintf(cnfg_file, "%s %s\n", dl_earfcn_token.c_str(), std::to_string(dl_earfcn).c_str());
+    fprintf(cnfg_file, "%s %s\n", n_cells_token.c_str(), std::to_string(N_cells).c_str());
+    for(uint32 i=0; i<N_cells; i++)
+    {
+        fprintf(cnfg_file, "%s %s\n", selected_cell_token.c_str(), std::to_string(i).c_str());
+        fprintf(cnfg_file, "%s %s\n", band_token.c_str(), std::to_string(get_band(i)).c_str());
+        fprintf(cnfg_file, "%s %s\n", dl_earfcn_token.c_str(), std::to_string(cells[i].dl_earfcn).c_str());
+        fprintf(cnfg_file, "%s %s\n", n_id_cell_token.c_str(), std::to_string(cells[i].N_id_cell).c_str());
+        fprintf(cnfg_file, "%s %s\n", cell_id_token.c_str(), std::to_string(cells[i].cell_id).c_str());
+    }
+    fprintf(cnfg_file, "%s %s\n", selected_cell_token.c_str(), std::to_string(selected_cell).c_str());
     fprintf(cnfg_file, "%s %s\n", n_ant_token.c_str(), std::to_string(N_ant).c_str());
-    fprintf(cnfg_file, "%s %s\n", n_id_cell_token.c_str(), std::to_string(N_id_cell).c_str());
     fprintf(cnfg_file, "%s %s\n", mcc_token.c_str(), get_mcc_string().c_str());
     fprintf(cnfg_file, "%s %s\n", mnc_token.c_str(), get_mnc_string().c_str());
-    fprintf(cnfg_file, "%s %s\n", cell_id_token.c_str(), std::to_string(get_cell_id()).c_str());
     fprintf(cnfg_file, "%s %s\n", tracking_area_code_token.c_str(), std::to_string(get_tracking_area_code()).c_str());
     fprintf(cnfg_file, "%s %s\n", q_rx_lev_min_token.c_str(), std::to_string(get_q_rx_lev_min()).c_str());
     fprintf(cnfg_file, "%s %s\n", si_periodicity_token.c_str(), get_si_periodicity_string().c_str());
@@ -2157,10 +2708,34 @@ void LTE_fdd_enb_interface::write_cnfg_file()
     fprintf(cnfg_file, "%s %s\n", phy_direct_to_ue_token.c_str(), get_phy_direct_to_ue_string().c_str());
     fprintf(cnfg_file, "%s %s\n", debug_type_token.c_str(), get_debug_type_string().c_str());
     fprintf(cnfg_file, "%s %s\n", debug_level_token.c_str(), get_debug_level_string().c_str());
+    fprintf(cnfg_file, "%s %s\n", dl_sched_policy_token.c_str(), get_dl_sched_policy_string().c_str());
+    fprintf(cnfg_file, "%s %s\n", ul_sched_policy_token.c_str(), get_ul_sched_policy_string().c_str());
+    fprintf(cnfg_file, "%s %s\n", sps_interval_token.c_str(), std::to_string(get_sps_interval()).c_str());
+    fprintf(cnfg_file, "%s %s\n", drx_long_cycle_token.c_str(), std::to_string(get_drx_long_cycle()).c_str());
+    fprintf(cnfg_file, "%s %s\n", drx_short_cycle_token.c_str(), std::to_string(get_drx_short_cycle()).c_str());
+    fprintf(cnfg_file, "%s %s\n", drx_on_duration_token.c_str(), std::to_string(get_drx_on_duration()).c_str());
+    fprintf(cnfg_file, "%s %s\n", drx_inactivity_timer_token.c_str(), std::to_string(get_drx_inactivity_timer()).c_str());
     fprintf(cnfg_file, "%s %s\n", enable_pcap_token.c_str(), get_enable_pcap_string().c_str());
+    fprintf(cnfg_file, "%s %s\n", pcap_dir_token.c_str(), pcap_dir.c_str());
+    fprintf(cnfg_file, "%s %s\n", pcap_max_size_token.c_str(), std::to_string(pcap_max_size).c_str());
+    fprintf(cnfg_file, "%s %s\n", pcap_period_token.c_str(), std::to_string(pcap_period).c_str());
+    fprintf(cnfg_file, "%s %s\n", pcap_rnti_token.c_str(), std::to_string(pcap_rnti).c_str());
+    fprintf(cnfg_file, "%s %s\n", metrics_file_token.c_str(), metrics_file.c_str());
+    fprintf(cnfg_file, "%s %s\n", metrics_period_token.c_str(), std::to_string(metrics_period).c_str());
+    fprintf(cnfg_file, "%s %s\n", metrics_format_token.c_str(), LTE_fdd_enb_metrics_format_text[metrics_format]);
     fprintf(cnfg_file, "%s %s\n", ip_addr_start_token.c_str(), get_ip_addr_start_string().c_str());
     fprintf(cnfg_file, "%s %s\n", dns_addr_token.c_str(), get_dns_addr_string().c_str());
     fprintf(cnfg_file, "%s %s\n", use_user_file_token.c_str(), get_use_user_file_string().c_str());
+    fprintf(cnfg_file, "%s %s\n", stack_event_loops_token.c_str(), std::to_string(N_stack_event_loops).c_str());
+    thread_mutex.lock();
+    for(uint32 i=0; i<LTE_FDD_ENB_THREAD_N_ITEMS; i++)
+    {
+        fprintf(cnfg_file, "%s %s\n", thread_cores_token[i].c_str(), thread_cnfg[i].cores.c_str());
+        fprintf(cnfg_file, "%s %s\n", thread_sched_policy_token[i].c_str(), LTE_fdd_enb_sched_policy_text[thread_cnfg[i].sched_policy]);
+        fprintf(cnfg_file, "%s %s\n", thread_sched_prio_token[i].c_str(), std::to_string(thread_cnfg[i].sched_prio).c_str());
+        fprintf(cnfg_file, "%s %s\n", thread_busy_poll_token[i].c_str(), bool_to_enable_string(thread_cnfg[i].busy_poll).c_str());
+    }
+    thread_mutex.unlock();
     fclose(cnfg_file);
 }
 void LTE_fdd_enb_interface::delete_cnfg_file()
@@ -2220,12 +2795,36 @@ void LTE_fdd_enb_interface::construct_sys_info()
     }
     sys_info.sib1.schedulingInfoList_Set()->SetValue(sched_info_list);
 
+    // Each cell gets its own copy with its own band, cell identity and SIB allocations
+    for(uint32 i=0; i<N_cells; i++)
+    {
+        cells[i].sys_info = sys_info;
+        cells[i].sys_info.sib1.freqBandIndicator_SetValue(cells[i].band);
+        cells[i].sys_info.sib1.cellAccessRelatedInfo_value.cellIdentity_Set()->SetValue(cells[i].cell_id);
+        cells[i].sys_info.sib_alloc.clear();
+        pack_sys_info(cells[i].sys_info, sched_info_list);
+    }
+
+    // Update all layers
+    for(uint32 i=0; i<N_cells; i++)
+    {
+        cells[i].phy->update_sys_info();
+        cells[i].mac->update_sys_info();
+        cells[i].rrc->update_sys_info();
+    }
+    rlc->update_sys_info();
+    pdcp->update_sys_info();
+    mme->update_sys_info();
+}
+void LTE_fdd_enb_interface::pack_sys_info(LTE_FDD_ENB_SYS_INFO_STRUCT &cell_sys_info,
+                                          std::vector<SchedulingInfo> &sched_info_list)
+{
     // Pack SIB1
     {
         BCCH_DL_SCH_Message bcch_dl_sch;
         bcch_dl_sch.message_Set()->SetChoice(BCCH_DL_SCH_MessageType::k_c1);
         bcch_dl_sch.message_Set()->c1_SetChoice(BCCH_DL_SCH_MessageType::k_c1_systemInformationBlockType1);
-        bcch_dl_sch.message_Set()->c1_systemInformationBlockType1_Set(sys_info.sib1);
+        bcch_dl_sch.message_Set()->c1_systemInformationBlockType1_Set(cell_sys_info.sib1);
         std::vector<uint8_t> bits;
         bcch_dl_sch.Pack(bits);
         LIBLTE_PHY_ALLOCATION_STRUCT alloc;
@@ -2238,7 +2837,7 @@ void LTE_fdd_enb_interface::construct_sys_info()
         alloc.N_codewords    = 1;
         alloc.rnti           = LIBLTE_MAC_SI_RNTI;
         alloc.tx_mode        = 1;
-        sys_info.sib_alloc.push_back(alloc);
+        cell_sys_info.sib_alloc.push_back(alloc);
     }
 
     // Pack additional SIBs
@@ -2252,33 +2851,33 @@ void LTE_fdd_enb_interface::construct_sys_info()
         if(si.sib_MappingInfo_Get().Value().size() == 0)
         {
             sib.sib_TypeAndInfo_SetChoice(SystemInformation_r8_IEs::sib_TypeAndInfo_::k_sib_TypeAndInfo_sib2);
-            sib.sib_TypeAndInfo_sib2_Set(sys_info.sib2);
+            sib.sib_TypeAndInfo_sib2_Set(cell_sys_info.sib2);
         }else{
             switch(si.sib_MappingInfo_Get().Value()[0].Value())
             {
             case SIB_Type::k_sibType3:
                 sib.sib_TypeAndInfo_SetChoice(SystemInformation_r8_IEs::sib_TypeAndInfo_::k_sib_TypeAndInfo_sib3);
-                sib.sib_TypeAndInfo_sib3_Set(sys_info.sib3);
+                sib.sib_TypeAndInfo_sib3_Set(cell_sys_info.sib3);
                 break;
             case SIB_Type::k_sibType4:
                 sib.sib_TypeAndInfo_SetChoice(SystemInformation_r8_IEs::sib_TypeAndInfo_::k_sib_TypeAndInfo_sib4);
-                sib.sib_TypeAndInfo_sib4_Set(sys_info.sib4);
+                sib.sib_TypeAndInfo_sib4_Set(cell_sys_info.sib4);
                 break;
             case SIB_Type::k_sibType5:
                 sib.sib_TypeAndInfo_SetChoice(SystemInformation_r8_IEs::sib_TypeAndInfo_::k_sib_TypeAndInfo_sib5);
-                sib.sib_TypeAndInfo_sib5_Set(sys_info.sib5);
+                sib.sib_TypeAndInfo_sib5_Set(cell_sys_info.sib5);
                 break;
             case SIB_Type::k_sibType6:
                 sib.sib_TypeAndInfo_SetChoice(SystemInformation_r8_IEs::sib_TypeAndInfo_::k_sib_TypeAndInfo_sib6);
-                sib.sib_TypeAndInfo_sib6_Set(sys_info.sib6);
+                sib.sib_TypeAndInfo_sib6_Set(cell_sys_info.sib6);
                 break;
             case SIB_Type::k_sibType7:
                 sib.sib_TypeAndInfo_SetChoice(SystemInformation_r8_IEs::sib_TypeAndInfo_::k_sib_TypeAndInfo_sib7);
-                sib.sib_TypeAndInfo_sib7_Set(sys_info.sib7);
+                sib.sib_TypeAndInfo_sib7_Set(cell_sys_info.sib7);
                 break;
             case SIB_Type::k_sibType8:
                 sib.sib_TypeAndInfo_SetChoice(SystemInformation_r8_IEs::sib_TypeAndInfo_::k_sib_TypeAndInfo_sib8);
-                sib.sib_TypeAndInfo_sib8_Set(sys_info.sib8);
+                sib.sib_TypeAndInfo_sib8_Set(cell_sys_info.sib8);
                 break;
             default:
                 break;
@@ -2297,20 +2896,138 @@ void LTE_fdd_enb_interface::construct_sys_info()
         alloc.N_codewords    = 1;
         alloc.rnti           = LIBLTE_MAC_SI_RNTI;
         alloc.tx_mode        = 1;
-        sys_info.sib_alloc.push_back(alloc);
+        cell_sys_info.sib_alloc.push_back(alloc);
     }
-
-    // Update all layers
-    phy->update_sys_info();
-    mac->update_sys_info();
-    rlc->update_sys_info();
-    pdcp->update_sys_info();
-    rrc->update_sys_info();
-    mme->update_sys_info();
 }
 void LTE_fdd_enb_interface::get_sys_info(LTE_FDD_ENB_SYS_INFO_STRUCT &_sys_info)
 {
-    memcpy((void*)&_sys_info, &sys_info, sizeof(sys_info));
+    get_sys_info(0, _sys_info);
+}
+void LTE_fdd_enb_interface::get_sys_info(uint8                        cell,
+                                         LTE_FDD_ENB_SYS_INFO_STRUCT &_sys_info)
+{
+    memcpy((void*)&_sys_info, &cells[cell].sys_info, sizeof(cells[cell].sys_info));
+}
+uint32 LTE_fdd_enb_interface::get_radio_core(uint8 cell)
+{
+    return get_core_from_end(cell);
+}
+uint32 LTE_fdd_enb_interface::get_mac_core()
+{
+    return get_core_from_end(N_cells);
+}
+uint32 LTE_fdd_enb_interface::get_stack_core()
+{
+    return get_core_from_end(N_cells + 1);
+}
+void LTE_fdd_enb_interface::setup_thread(LTE_FDD_ENB_THREAD_ENUM thread_class,
+                                         uint32                  idx,
+                                         std::string             name)
+{
+    LTE_FDD_ENB_THREAD_CNFG_STRUCT   cnfg;
+    LTE_FDD_ENB_THREAD_LAYOUT_STRUCT layout;
+    struct sched_param               priority;
+    cpu_set_t                        af_mask;
+    pthread_t                        thread = pthread_self();
+    int                              policy = SCHED_OTHER;
+
+    thread_mutex.lock();
+    cnfg = thread_cnfg[thread_class];
+    thread_mutex.unlock();
+
+    // Thread names are limited to 15 characters
+    pthread_setname_np(thread, name.substr(0, 15).c_str());
+
+    // Set affinity, automatic placement uses the last cores for the radios
+    // (one per cell), then MAC, then the rest of the stack.  PHY workers
+    // are left where they were created.
+    CPU_ZERO(&af_mask);
+    if("auto" == cnfg.cores)
+    {
+        if(LTE_FDD_ENB_THREAD_RADIO == thread_class)
+            CPU_SET(get_radio_core(idx), &af_mask);
+        else if(LTE_FDD_ENB_THREAD_MAC == thread_class)
+            CPU_SET(get_mac_core(), &af_mask);
+        else if(LTE_FDD_ENB_THREAD_PHY != thread_class)
+            CPU_SET(get_stack_core(), &af_mask);
+    }else{
+        cpu_list_to_set(cnfg.cores, &af_mask);
+    }
+    layout.affinity_err = 0;
+    if(0 != CPU_COUNT(&af_mask))
+        layout.affinity_err = pthread_setaffinity_np(thread, sizeof(af_mask), &af_mask);
+
+    // Set priority
+    if(LTE_FDD_ENB_SCHED_POLICY_FIFO == cnfg.sched_policy)
+        policy = SCHED_FIFO;
+    else if(LTE_FDD_ENB_SCHED_POLICY_RR == cnfg.sched_policy)
+        policy = SCHED_RR;
+    priority.sched_priority = cnfg.sched_prio;
+    if(priority.sched_priority > sched_get_priority_max(policy))
+        priority.sched_priority = sched_get_priority_max(policy);
+    if(priority.sched_priority < sched_get_priority_min(policy))
+        priority.sched_priority = sched_get_priority_min(policy);
+    layout.sched_err = pthread_setschedparam(thread, policy, &priority);
+
+    // Read back what was actually applied
+    layout.thread_class = thread_class;
+    layout.tid          = syscall(SYS_gettid);
+    layout.busy_poll    = cnfg.busy_poll;
+    CPU_ZERO(&af_mask);
+    pthread_getaffinity_np(thread, sizeof(af_mask), &af_mask);
+    layout.cores = cpu_set_to_list(&af_mask);
+    pthread_getschedparam(thread, &policy, &priority);
+    layout.sched_policy = LTE_FDD_ENB_SCHED_POLICY_OTHER;
+    if(SCHED_FIFO == policy)
+        layout.sched_policy = LTE_FDD_ENB_SCHED_POLICY_FIFO;
+    else if(SCHED_RR == policy)
+        layout.sched_policy = LTE_FDD_ENB_SCHED_POLICY_RR;
+    layout.sched_prio = priority.sched_priority;
+
+    thread_mutex.lock();
+    thread_layout[name] = layout;
+    thread_mutex.unlock();
+
+    send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                   LTE_FDD_ENB_DEBUG_LEVEL_IFACE,
+                   __FILE__,
+                   __LINE__,
+                   "Thread %s (%s) on cores %s with %s priority %d%s",
+                   name.c_str(),
+                   LTE_fdd_enb_thread_text[thread_class],
+                   layout.cores.c_str(),
+                   LTE_fdd_enb_sched_policy_text[layout.sched_policy],
+                   layout.sched_prio,
+                   layout.busy_poll ? ", busy polling" : "");
+    if(0 != layout.affinity_err ||
+       0 != layout.sched_err)
+    {
+        send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_WARNING,
+                       LTE_FDD_ENB_DEBUG_LEVEL_IFACE,
+                       __FILE__,
+                       __LINE__,
+                       "Thread %s layout not fully applied (affinity: %s, scheduling: %s)",
+                       name.c_str(),
+                       strerror(layout.affinity_err),
+                       strerror(layout.sched_err));
+    }
+}
+bool LTE_fdd_enb_interface::get_thread_busy_poll(LTE_FDD_ENB_THREAD_ENUM thread_class)
+{
+    std::lock_guard<std::mutex> lock(thread_mutex);
+    return thread_cnfg[thread_class].busy_poll;
+}
+void LTE_fdd_enb_interface::get_thread_layout(std::map<std::string, LTE_FDD_ENB_THREAD_LAYOUT_STRUCT> &layout)
+{
+    std::lock_guard<std::mutex> lock(thread_mutex);
+    layout = thread_layout;
+}
+uint32 LTE_fdd_enb_interface::get_core_from_end(uint32 offset)
+{
+    uint32 num_cpus = std::thread::hardware_concurrency();
+
+    // Wrap around on machines with fewer cores than threads to pin
+    return num_cpus - 1 - (offset % num_cpus);
 }
 void LTE_fdd_enb_interface::get_rrc_phy_cnfg_ded(PhysicalConfigDedicated *pcd,
                                                  uint32                   i_cqi_pmi,
@@ -80,12 +80,28 @@
 #include "LTE_fdd_enb_timer_mgr.h"
 #include "LTE_fdd_enb_mac.h"
 #include "LTE_fdd_enb_phy.h"
+#include "LTE_fdd_enb_rlc.h"
+#include "LTE_fdd_enb_dl_sched_policy.h"
+#include <algorithm>
 
 /*******************************************************************************
                               DEFINES
 *******************************************************************************/
 
-#define BSR_GRANT_SIZE_BYTES 10
+#define BSR_GRANT_SIZE_BYTES      10
+#define DL_SCHED_MAX_DELAY_N_TTIS 100
+
+// MAC subheader plus a long BSR on top of the reported buffer
+#define UL_GRANT_MAC_HDR_BYTES 7
+
+// Keeps the padded transport block inside a message buffer
+#define DL_MUX_MAX_PDU_BYTES (LIBLTE_MAX_MSG_SIZE - 128)
+
+// MAC subheader plus RLC header on top of an SPS SDU
+#define SPS_DL_HDR_BYTES 5
+
+// MCS MSB must be 0 to validate an SPS activation, 36.213 table 9.2-1
+#define SPS_MAX_MCS 15
 
 /*******************************************************************************
                               TYPEDEFS
@@ -96,6 +112,15 @@
                               GLOBAL VARIABLES
 *******************************************************************************/
 
+// Wideband CQI to the highest MCS with a comparable spectral efficiency
+static const uint8 CQI_TO_MCS[16] = {0, 0, 0, 2, 4, 6, 8, 11, 13, 15, 18, 20, 22, 24, 26, 28};
+
+// Wideband CQI to PDCCH aggregation level, poorer channels spread the DCI
+// over more CCEs
+static const uint32 CQI_TO_N_CCE_AGG[16] = {8, 8, 8, 8, 4, 4, 4, 2, 2, 2, 1, 1, 1, 1, 1, 1};
+
+// Redundancy version per PUSCH transmission, 36.321 section 5.4.2.2
+static const uint8 UL_HARQ_RV_IDX[4] = {0, 2, 3, 1};
 
 /*******************************************************************************
                               CLASS IMPLEMENTATIONS
@@ -104,14 +129,40 @@
 /********************************/
 /*    Constructor/Destructor    */
 /********************************/
-LTE_fdd_enb_mac::LTE_fdd_enb_mac(LTE_fdd_enb_interface *iface, LTE_fdd_enb_timer_mgr *tm,
-                                 LTE_fdd_enb_user_mgr *um, LTE_fdd_enb_rlc *_rlc) :
-    interface{iface}, started{false}, timer_mgr{tm}, user_mgr{um}, rlc{_rlc}
+LTE_fdd_enb_mac::LTE_fdd_enb_mac(LTE_fdd_enb_interface *iface, uint8 _cell,
+                                 LTE_fdd_enb_timer_mgr *tm, LTE_fdd_enb_user_mgr *um,
+                                 LTE_fdd_enb_rlc *_rlc) :
+    interface{iface}, started{false}, cell{_cell}, dl_sched_policy{NULL}, ul_sched_policy{NULL},
+    timer_mgr{tm}, user_mgr{um}, rlc{_rlc}
 {
+    LTE_fdd_enb_rar_sched_pool::init_list(&rar_intake, LTE_FDD_ENB_SCHED_LINK_QUEUE);
+    LTE_fdd_enb_rar_sched_pool::init_list(&rar_sched_queue, LTE_FDD_ENB_SCHED_LINK_QUEUE);
+    LTE_fdd_enb_dl_sched_pool::init_list(&dl_intake, LTE_FDD_ENB_SCHED_LINK_QUEUE);
+    LTE_fdd_enb_dl_sched_pool::init_list(&dl_sched_queue, LTE_FDD_ENB_SCHED_LINK_QUEUE);
+    for(uint32 i=0; i<=LIBLTE_PHY_TTI_MAX; i++)
+        LTE_fdd_enb_dl_sched_pool::init_list(&dl_tti_ring[i], LTE_FDD_ENB_SCHED_LINK_QUEUE);
+    LTE_fdd_enb_ul_sched_pool::init_list(&ul_intake, LTE_FDD_ENB_SCHED_LINK_QUEUE);
+    LTE_fdd_enb_ul_sched_pool::init_list(&ul_sched_queue, LTE_FDD_ENB_SCHED_LINK_QUEUE);
+    LTE_fdd_enb_ul_harq_pool::init_list(&ul_harq_queue, LTE_FDD_ENB_SCHED_LINK_QUEUE);
+    LTE_fdd_enb_ul_sr_sched_pool::init_list(&ul_sr_sched_queue, LTE_FDD_ENB_SCHED_LINK_QUEUE);
+    for(uint32 i=0; i<LTE_FDD_ENB_N_RNTIS; i++)
+    {
+        dl_mux_pending[i]   = false;
+        ul_sched_pending[i] = false;
+        dl_cand_idx[i]      = 0;
+        LTE_fdd_enb_ul_harq_pool::init_list(&ul_harq_ue_queue[i], LTE_FDD_ENB_SCHED_LINK_UE);
+    }
+    dl_ring_tti = 0;
+
+    // Sized for a full pool so ranking never allocates
+    dl_candidates.reserve(LTE_FDD_ENB_N_DL_SCHED_ENTRIES);
+    ul_candidates.reserve(LTE_FDD_ENB_N_UL_SCHED_ENTRIES);
 }
 LTE_fdd_enb_mac::~LTE_fdd_enb_mac()
 {
     stop();
+    delete dl_sched_policy;
+    delete ul_sched_policy;
 }
 void LTE_fdd_enb_mac::set_phy_and_rrc(LTE_fdd_enb_phy *_phy, LTE_fdd_enb_rrc *_rrc)
 {
@@ -157,28 +208,33 @@ void LTE_fdd_enb_mac::start(LTE_fdd_enb_msgq      *from_phy,
     }
 
     // Initialize scheduler
-    interface->get_sys_info(sys_info);
+    interface->get_sys_info(cell, sys_info);
     for(uint32 i=0; i<10; i++)
     {
         sched_dl_subfr[i].allocations.N_dl_alloc = 0;
         sched_dl_subfr[i].allocations.N_ul_alloc = 0;
         sched_dl_subfr[i].N_avail_prbs           = interface->get_n_rb_dl() - get_n_reserved_prbs(i);
         sched_dl_subfr[i].N_sched_prbs           = 0;
+        sched_dl_subfr[i].N_sps_dl_alloc         = 0;
         sched_dl_subfr[i].current_tti            = i;
-        sched_dl_subfr[i].next_prb               = 0;
+        for(uint32 j=0; j<LIBLTE_PHY_N_RB_DL_MAX; j++)
+            sched_dl_subfr[i].prb_used[j] = false;
+        clear_pdcch_map(&sched_dl_subfr[i].pdcch_map);
 
         sched_ul_subfr[i].decodes.N_ul_alloc = 0;
         sched_ul_subfr[i].N_avail_prbs       = interface->get_n_rb_ul();
         sched_ul_subfr[i].N_sched_prbs       = 0;
         sched_ul_subfr[i].current_tti        = i;
         sched_ul_subfr[i].N_pucch            = 0;
-        sched_ul_subfr[i].next_prb           = 0;
+        for(uint32 j=0; j<LIBLTE_PHY_N_RB_UL_MAX; j++)
+            sched_ul_subfr[i].prb_used[j] = false;
     }
     sched_dl_subfr[0].current_tti = 10;
     sched_dl_subfr[1].current_tti = 11;
     sched_dl_subfr[2].current_tti = 12;
     sched_cur_dl_subfn            = 3;
     sched_cur_ul_subfn            = 0;
+    dl_ring_tti                   = sched_dl_subfr[sched_cur_dl_subfn].current_tti;
 
     // Schedule SIB1
     uint32 sib1_ttis[] = {85, 105, 125, 145};
@@ -356,7 +412,9 @@ void LTE_fdd_enb_mac::send_rlc_pdu_ready(LTE_fdd_enb_user       *user,
 /****************************/
 void LTE_fdd_enb_mac::align_ttis_with_phy(uint32 ul_current_tti)
 {
-    uint32 expected_mac_tti = liblte_phy_add_to_tti(ul_current_tti, 2);
+    // The MAC UL subframe trails its DL subframe by 3, which keeps the DL
+    // schedule 3 subframes ahead of the PHY DL
+    uint32 expected_mac_tti = liblte_phy_add_to_tti(ul_current_tti, LTE_FDD_ENB_PHY_DL_LEAD_N_SUBFRS);
     if(expected_mac_tti == sched_ul_subfr[sched_cur_ul_subfn].current_tti)
         return;
 
@@ -366,7 +424,8 @@ void LTE_fdd_enb_mac::align_ttis_with_phy(uint32 ul_current_tti)
                               LTE_FDD_ENB_DEBUG_LEVEL_MAC,
                               __FILE__,
                               __LINE__,
-                              "TTI misalignment PHY(+2)=%u MAC=%u, skipping %u subframes",
+                              "TTI misalignment PHY(+%u)=%u MAC=%u, skipping %u subframes",
+                              LTE_FDD_ENB_PHY_DL_LEAD_N_SUBFRS,
                               expected_mac_tti,
                               sched_ul_subfr[sched_cur_ul_subfn].current_tti,
                               N_subfrs_to_skip);
@@ -376,14 +435,14 @@ void LTE_fdd_enb_mac::align_ttis_with_phy(uint32 ul_current_tti)
 void LTE_fdd_enb_mac::update_sys_info()
 {
     std::lock_guard<std::mutex>  lock(sys_info_mutex);
-    interface->get_sys_info(sys_info);
+    interface->get_sys_info(cell, sys_info);
 }
 void LTE_fdd_enb_mac::add_periodic_sr_pucch(uint16 rnti,
                                             uint32 i_sr,
                                             uint32 n_1_p_pucch)
 {
     LTE_FDD_ENB_UL_SR_SCHED_QUEUE_STRUCT *sr = NULL;
-    sr = new LTE_FDD_ENB_UL_SR_SCHED_QUEUE_STRUCT;
+    sr = ul_sr_sched_pool.alloc();
     if(NULL == sr)
         return;
 
@@ -392,20 +451,88 @@ void LTE_fdd_enb_mac::add_periodic_sr_pucch(uint16 rnti,
     sr->rnti        = rnti;
 
     ul_sr_sched_queue_mutex.lock();
-    ul_sr_sched_queue.push_back(sr);
+    ul_sr_sched_pool.push_back(&ul_sr_sched_queue, sr);
     ul_sr_sched_queue_mutex.unlock();
 }
 void LTE_fdd_enb_mac::remove_periodic_sr_pucch(uint16 rnti)
 {
     std::lock_guard<std::mutex> lock(ul_sr_sched_queue_mutex);
 
-    for(auto ul_sr=ul_sr_sched_queue.begin(); ul_sr!=ul_sr_sched_queue.end(); ul_sr++)
+    LTE_FDD_ENB_UL_SR_SCHED_QUEUE_STRUCT *sr = ul_sr_sched_pool.front(&ul_sr_sched_queue);
+    for(; NULL != sr; sr=ul_sr_sched_pool.next(&ul_sr_sched_queue, sr))
+    {
+        if(rnti == sr->rnti)
+        {
+            ul_sr_sched_pool.remove(&ul_sr_sched_queue, sr);
+            ul_sr_sched_pool.free(sr);
+            return;
+        }
+    }
+}
+void LTE_fdd_enb_mac::add_sps(uint16              c_rnti,
+                              uint16              sps_c_rnti,
+                              LTE_FDD_ENB_RB_ENUM rb_id,
+                              uint32              interval,
+                              uint32              n_1_p_pucch_an)
+{
+    LTE_FDD_ENB_SPS_STRUCT *sps = NULL;
+    sps = new LTE_FDD_ENB_SPS_STRUCT;
+    if(NULL == sps)
+        return;
+
+    // PRBs and MCS are filled in on activation
+    sps->dl_alloc.pre_coder_type  = LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY;
+    sps->dl_alloc.chan_type       = LIBLTE_PHY_CHAN_TYPE_DLSCH;
+    sps->dl_alloc.rv_idx          = 0;
+    sps->dl_alloc.N_codewords     = 1;
+    sps->dl_alloc.tx_mode         = (1 == interface->get_n_ant()) ? 1 : 2;
+    sps->dl_alloc.rnti            = sps_c_rnti;
+    sps->dl_alloc.tpc             = LIBLTE_PHY_TPC_COMMAND_DCI_1_1A_1B_1D_2_3_DB_ZERO;
+    sps->dl_alloc.ndi             = 0;
+    sps->dl_alloc.harq_process    = 0;
+    sps->dl_alloc.harq_retx_count = 0;
+    sps->dl_alloc.N_prb           = 0;
+    sps->dl_alloc.tbs             = 0;
+    sps->ul_alloc.pre_coder_type  = LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY;
+    sps->ul_alloc.chan_type       = LIBLTE_PHY_CHAN_TYPE_ULSCH;
+    sps->ul_alloc.rv_idx          = 0;
+    sps->ul_alloc.N_codewords     = 1;
+    sps->ul_alloc.N_layers        = 1;
+    sps->ul_alloc.tx_mode         = 1;
+    sps->ul_alloc.rnti            = sps_c_rnti;
+    sps->ul_alloc.tpc             = LIBLTE_PHY_TPC_COMMAND_DCI_0_3_4_DB_NEG_1; // TPC '00' validates the activation
+    sps->ul_alloc.ndi             = 0;
+    sps->ul_alloc.N_prb           = 0;
+    sps->ul_alloc.tbs             = 0;
+    sps->rb_id                    = rb_id;
+    sps->dl_state                 = LTE_FDD_ENB_SPS_STATE_IDLE;
+    sps->ul_state                 = LTE_FDD_ENB_SPS_STATE_IDLE;
+    sps->interval                 = interval;
+    sps->n_1_p_pucch_an           = n_1_p_pucch_an;
+    sps->dl_tti                   = 0;
+    sps->ul_tti                   = 0;
+    sps->N_dl_empty               = 0;
+    sps->N_ul_empty               = 0;
+    sps->c_rnti                   = c_rnti;
+    sps->sps_c_rnti               = sps_c_rnti;
+    sps->dl_reserved              = false;
+
+    // A reconfiguration replaces the previous SPS configuration
+    remove_sps(c_rnti);
+    std::lock_guard<std::mutex> lock(sps_mutex);
+    sps_list.push_back(sps);
+}
+void LTE_fdd_enb_mac::remove_sps(uint16 c_rnti)
+{
+    std::lock_guard<std::mutex> lock(sps_mutex);
+
+    for(auto iter=sps_list.begin(); iter!=sps_list.end(); iter++)
     {
-        if(rnti == (*ul_sr)->rnti)
+        if(c_rnti == (*iter)->c_rnti)
         {
-            LTE_FDD_ENB_UL_SR_SCHED_QUEUE_STRUCT *sr = (*ul_sr);
-            ul_sr_sched_queue.erase(ul_sr);
-            delete sr;
+            LTE_FDD_ENB_SPS_STRUCT *sps = (*iter);
+            sps_list.erase(iter);
+            delete sps;
             return;
         }
     }
@@ -416,12 +543,16 @@ void LTE_fdd_enb_mac::remove_periodic_sr_pucch(uint16 rnti)
 /**********************/
 void LTE_fdd_enb_mac::handle_ready_to_send(LTE_FDD_ENB_READY_TO_SEND_MSG_STRUCT *rts)
 {
-    // Send tick to timer manager
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Send tick to timer manager (only one cell drives the timers)
     LTE_FDD_ENB_TIMER_TICK_MSG_STRUCT timer_tick;
-    msgq_to_timer->send(LTE_FDD_ENB_MESSAGE_TYPE_TIMER_TICK,
-                        LTE_FDD_ENB_DEST_LAYER_TIMER_MGR,
-                        (LTE_FDD_ENB_MESSAGE_UNION *)&timer_tick,
-                        sizeof(LTE_FDD_ENB_TIMER_TICK_MSG_STRUCT));
+    if(NULL != msgq_to_timer)
+        msgq_to_timer->send(LTE_FDD_ENB_MESSAGE_TYPE_TIMER_TICK,
+                            LTE_FDD_ENB_DEST_LAYER_TIMER_MGR,
+                            (LTE_FDD_ENB_MESSAGE_UNION *)&timer_tick,
+                            sizeof(LTE_FDD_ENB_TIMER_TICK_MSG_STRUCT));
 
     msgq_to_phy->send(LTE_FDD_ENB_MESSAGE_TYPE_PHY_SCHEDULE,
                       &sched_dl_subfr[sched_cur_dl_subfn],
@@ -430,10 +561,16 @@ void LTE_fdd_enb_mac::handle_ready_to_send(LTE_FDD_ENB_READY_TO_SEND_MSG_STRUCT
     advance_tti_and_clear_subframe();
 
     // Call the schedulers
+    drain_sched_intake();
+    sps_scheduler();
+    ul_harq_scheduler();
     rar_scheduler();
     dl_scheduler();
+    sps_dl_scheduler();
     ul_scheduler();
     ul_sr_scheduler();
+
+    interface->sample_metric(cell, LTE_FDD_ENB_METRIC_HIST_MAC_TTI_US, &start);
 }
 void LTE_fdd_enb_mac::handle_prach_decode(LTE_FDD_ENB_PRACH_DECODE_MSG_STRUCT *prach_decode)
 {
@@ -467,6 +604,12 @@ void LTE_fdd_enb_mac::handle_pucch_decode(LTE_FDD_ENB_PUCCH_DECODE_MSG_STRUCT *p
                                          pucch_decode->rnti,
                                          pucch_decode->current_tti);
 
+    // Only a detected SR or ACK carries a usable DMRS
+    if(pucch_decode->msg.msg[0])
+        handle_timing_offset(user,
+                             pucch_decode->current_tti,
+                             pucch_decode->timing_offset);
+
     if(LTE_FDD_ENB_PUCCH_TYPE_ACK_NACK == pucch_decode->type)
     {
         handle_pucch_ack_nack(user,
@@ -494,6 +637,7 @@ void LTE_fdd_enb_mac::handle_pucch_ack_nack(LTE_fdd_enb_user      *user,
     if(msg->msg[0])
     {
         // Received ACK
+        interface->count_metric(cell, LTE_FDD_ENB_METRIC_DL_HARQ_ACKS, 1);
         user->clear_harq_info(current_tti);
         interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
                                   LTE_FDD_ENB_DEBUG_LEVEL_MAC,
@@ -506,6 +650,7 @@ void LTE_fdd_enb_mac::handle_pucch_ack_nack(LTE_fdd_enb_user      *user,
     }
 
     // Received NACK, resend HARQ information if possible
+    interface->count_metric(cell, LTE_FDD_ENB_METRIC_DL_HARQ_NACKS, 1);
     LIBLTE_MAC_PDU_STRUCT        mac_pdu;
     LIBLTE_PHY_ALLOCATION_STRUCT alloc;
     if(LTE_FDD_ENB_ERROR_NONE != user->get_harq_info(current_tti,
@@ -528,6 +673,11 @@ void LTE_fdd_enb_mac::handle_pucch_ack_nack(LTE_fdd_enb_user      *user,
                                          current_tti);
     alloc.harq_retx_count++;
     alloc.ndi ^= 0x01;
+
+    // The UE watches for the retransmission once its HARQ RTT has passed
+    user->start_drx_retx_timer(liblte_phy_add_to_tti(current_tti, 4));
+    if(user->is_sps_c_rnti_set() && user->get_sps_c_rnti() == alloc.rnti)
+        alloc.ndi = 1; // NDI=0 on the SPS C-RNTI would activate, 36.321 section 5.3.1
     if(LTE_FDD_ENB_ERROR_NONE == add_to_dl_sched_queue(liblte_phy_add_to_tti(sched_dl_subfr[sched_cur_dl_subfn].current_tti,
                                                                              4),
                                                        &mac_pdu,
@@ -563,8 +713,9 @@ void LTE_fdd_enb_mac::handle_pucch_sr(LTE_fdd_enb_user      *user,
                               current_tti,
                               user->get_c_rnti());
 
-    // Schedule a grant big enough to at least hold long BSR
-    sched_ul(user, BSR_GRANT_SIZE_BYTES*8);
+    // The UL scheduler answers with a grant big enough to at least hold a long BSR
+    user->set_ul_sr_pending(true);
+    sched_ul(user);
 }
 void LTE_fdd_enb_mac::handle_pusch_decode(LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT *pusch_decode)
 {
@@ -580,7 +731,7 @@ void LTE_fdd_enb_mac::handle_pusch_decode(LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT *p
                                          pusch_decode->rnti);
 
     // Reset the C-RNTI release timer
-    user_mgr->reset_c_rnti_timer(pusch_decode->rnti);
+    user_mgr->reset_c_rnti_timer(user->get_c_rnti());
 
     // Reset the inactivity timer
     user->reset_inactivity_timer(LTE_FDD_ENB_USER_INACTIVITY_TIMER_VALUE_MS);
@@ -590,15 +741,26 @@ void LTE_fdd_enb_mac::handle_pusch_decode(LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT *p
                               __FILE__,
                               __LINE__,
                               &pusch_decode->msg,
-                              "PUSCH decode for RNTI=%u CURRENT_TTI=%u",
+                              "PUSCH decode for RNTI=%u CURRENT_TTI=%u TIMING_OFFSET=%f",
                               pusch_decode->rnti,
-                              pusch_decode->current_tti);
+                              pusch_decode->current_tti,
+                              pusch_decode->timing_offset);
+
+    // Track timing advance
+    handle_timing_offset(user,
+                         pusch_decode->current_tti,
+                         pusch_decode->timing_offset);
     interface->send_lte_pcap_msg(LTE_FDD_ENB_PCAP_DIRECTION_UL,
                                  pusch_decode->rnti,
                                  pusch_decode->current_tti,
                                  pusch_decode->msg.msg,
                                  pusch_decode->msg.N_bits);
 
+    // The transport block made it, nothing is left to retransmit
+    clear_ul_harq(pusch_decode->rnti, pusch_decode->current_tti);
+    user->count_ul_bytes(pusch_decode->msg.N_bits/8);
+    interface->count_metric(cell, LTE_FDD_ENB_METRIC_MAC_UL_BYTES, pusch_decode->msg.N_bits/8);
+
     // Set the correct channel type
     LIBLTE_MAC_PDU_STRUCT mac_pdu;
     mac_pdu.chan_type = LIBLTE_MAC_CHAN_TYPE_ULSCH;
@@ -621,7 +783,24 @@ void LTE_fdd_enb_mac::handle_pusch_decode(LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT *p
             handle_ulsch_power_headroom_report(user, &mac_pdu.subheader[i].payload.power_headroom);
         }else if(LIBLTE_MAC_ULSCH_C_RNTI_LCID == mac_pdu.subheader[i].lcid){
             handle_ulsch_c_rnti(&user, &mac_pdu.subheader[i].payload.c_rnti);
-        }else if(LIBLTE_MAC_ULSCH_TRUNCATED_BSR_LCID == mac_pdu.subheader[i].lcid){
+        }
+    }
+
+    // The UE releases a configured grant after sending only padding on it
+    if(user->is_sps_c_rnti_set() && user->get_sps_c_rnti() == pusch_decode->rnti)
+    {
+        bool has_sdu = false;
+        for(uint32 i=0; i<mac_pdu.N_subheaders; i++)
+            if(LIBLTE_MAC_ULSCH_DCCH_LCID_END >= mac_pdu.subheader[i].lcid)
+                has_sdu = true;
+        sps_ul_decoded(user->get_c_rnti(), has_sdu);
+    }
+
+    // A BSR reports the buffer left after this PDU was built, so it
+    // overrides what the SDUs above were subtracted from
+    for(uint32 i=0; i<mac_pdu.N_subheaders; i++)
+    {
+        if(LIBLTE_MAC_ULSCH_TRUNCATED_BSR_LCID == mac_pdu.subheader[i].lcid){
             handle_ulsch_truncated_bsr(user, &mac_pdu.subheader[i].payload.truncated_bsr);
         }else if(LIBLTE_MAC_ULSCH_SHORT_BSR_LCID == mac_pdu.subheader[i].lcid){
             handle_ulsch_short_bsr(user, &mac_pdu.subheader[i].payload.short_bsr);
@@ -631,13 +810,43 @@ void LTE_fdd_enb_mac::handle_pusch_decode(LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT *p
     }
 }
 
+void LTE_fdd_enb_mac::handle_timing_offset(LTE_fdd_enb_user *user,
+                                           uint32            current_tti,
+                                           float             timing_offset)
+{
+    user->update_timing_offset(timing_offset, current_tti);
+
+    // Only correct connected users, Msg4 carries the contention resolution
+    LTE_fdd_enb_rb *rb = NULL;
+    if(LTE_FDD_ENB_ERROR_NONE != user->get_srb1(&rb))
+        return;
+
+    float ta_offset = user->get_timing_offset();
+    if(fabs(ta_offset) < LTE_FDD_ENB_TA_THRESHOLD_TS)
+        return;
+
+    // Positive offsets are late arrivals and need more advance
+    int32 ta = 31 + (int32)lroundf(ta_offset / LTE_FDD_ENB_TA_STEP_TS);
+    if(ta < 0)
+        ta = 0;
+    if(ta > 63)
+        ta = 63;
+    construct_ta_command(user, ta);
+
+    // The UE applies the command 6 subframes after reception
+    user->reset_timing_offset(liblte_phy_add_to_tti(sched_dl_subfr[sched_cur_dl_subfn].current_tti,
+                                                    4 + 6 + LTE_FDD_ENB_TA_HOLDOFF_N_TTIS));
+}
+
 /******************************/
 /*    RLC Message Handlers    */
 /******************************/
 void LTE_fdd_enb_mac::handle_sdu_ready(LTE_FDD_ENB_MAC_SDU_READY_MSG_STRUCT *sdu_ready)
 {
-    LIBLTE_BYTE_MSG_STRUCT *sdu;
-    if(LTE_FDD_ENB_ERROR_NONE != sdu_ready->rb->get_next_mac_sdu(&sdu))
+    // MAC SDUs are either queued ready-made or built by RLC on request
+    uint32 N_mac_sdu_bytes = sdu_ready->rb->get_mac_sdu_queue_bytes();
+    uint32 N_rlc_sdu_bytes = sdu_ready->rb->rlc_get_tx_sdu_queue_bytes();
+    if(0 == N_mac_sdu_bytes && 0 == N_rlc_sdu_bytes)
         return interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
                                          LTE_FDD_ENB_DEBUG_LEVEL_MAC,
                                          __FILE__,
@@ -650,12 +859,13 @@ void LTE_fdd_enb_mac::handle_sdu_ready(LTE_FDD_ENB_MAC_SDU_READY_MSG_STRUCT *sdu
                               LTE_FDD_ENB_DEBUG_LEVEL_MAC,
                               __FILE__,
                               __LINE__,
-                              sdu,
-                              "Received SDU for RNTI=%u and RB=%s",
+                              "Received SDU for RNTI=%u and RB=%s, N_bytes_queued=%u/%u",
                               user->get_c_rnti(),
-                              LTE_fdd_enb_rb_text[sdu_ready->rb->get_rb_id()]);
+                              LTE_fdd_enb_rb_text[sdu_ready->rb->get_rb_id()],
+                              N_mac_sdu_bytes,
+                              N_rlc_sdu_bytes);
 
-    // Fill in the allocation
+    // Fill in the allocation, the HARQ process and MAC PDU are filled in when scheduled
     LIBLTE_PHY_ALLOCATION_STRUCT alloc = {0};
     alloc.pre_coder_type = LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY;
     alloc.mod_type       = get_modulation_type(user->get_mcs());
@@ -670,61 +880,22 @@ void LTE_fdd_enb_mac::handle_sdu_ready(LTE_FDD_ENB_MAC_SDU_READY_MSG_STRUCT *sdu
         alloc.tx_mode = 2;
     }
     sys_info_mutex.unlock();
-    alloc.rnti         = user->get_c_rnti();
-    alloc.tpc          = LIBLTE_PHY_TPC_COMMAND_DCI_1_1A_1B_1D_2_3_DB_ZERO;
-    alloc.harq_process = user->get_harq_process();
-    user->increment_harq_process();
+    alloc.rnti            = user->get_c_rnti();
+    alloc.tpc             = LIBLTE_PHY_TPC_COMMAND_DCI_1_1A_1B_1D_2_3_DB_ZERO;
     alloc.ndi             = 0;
     alloc.harq_retx_count = 0;
 
-    // Pack the PDU
-    LIBLTE_MAC_PDU_STRUCT mac_pdu;
-    mac_pdu.chan_type = LIBLTE_MAC_CHAN_TYPE_DLSCH;
-    if(sdu_ready->rb->get_send_con_res_id())
-    {
-        mac_pdu.N_subheaders                          = 2;
-        mac_pdu.subheader[0].lcid                     = LIBLTE_MAC_DLSCH_UE_CONTENTION_RESOLUTION_ID_LCID;
-        mac_pdu.subheader[0].payload.ue_con_res_id.id = sdu_ready->rb->get_con_res_id();
-        mac_pdu.subheader[1].lcid                     = sdu_ready->rb->get_rb_id();
-        memcpy(&mac_pdu.subheader[1].payload.sdu, sdu, sizeof(LIBLTE_BYTE_MSG_STRUCT));
-        sdu_ready->rb->set_send_con_res_id(false);
-    }else{
-        mac_pdu.N_subheaders      = 1;
-        mac_pdu.subheader[0].lcid = sdu_ready->rb->get_rb_id();
-        memcpy(&mac_pdu.subheader[0].payload.sdu, sdu, sizeof(LIBLTE_BYTE_MSG_STRUCT));
-    }
-
-    // Add the PDU to the scheduling queue
-    interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
-                              LTE_FDD_ENB_DEBUG_LEVEL_MAC,
-                              __FILE__,
-                              __LINE__,
-                              "Attempting to schedule PDU for RNTI=%u, requested TTI=%u",
-                              alloc.rnti,
-                              liblte_phy_add_to_tti(sched_dl_subfr[sched_cur_dl_subfn].current_tti, 4));
-    if(LTE_FDD_ENB_ERROR_NONE != add_to_dl_sched_queue(liblte_phy_add_to_tti(sched_dl_subfr[sched_cur_dl_subfn].current_tti,
-                                                                             4),
-                                                       &mac_pdu,
-                                                       &alloc))
+    // All logical channels of a UE share one entry in the scheduling queue
+    if(LTE_FDD_ENB_ERROR_NONE != add_to_dl_mux_queue(liblte_phy_add_to_tti(sched_dl_subfr[sched_cur_dl_subfn].current_tti,
+                                                                           4),
+                                                     &alloc))
     {
         interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
                                   LTE_FDD_ENB_DEBUG_LEVEL_MAC,
                                   __FILE__,
                                   __LINE__,
                                   "Can't schedule PDU");
-    }else{
-        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
-                                  LTE_FDD_ENB_DEBUG_LEVEL_MAC,
-                                  __FILE__,
-                                  __LINE__,
-                                  &alloc.msg[0],
-                                  "PDU scheduled for RNTI=%u, DL_QUEUE_SIZE=%u",
-                                  alloc.rnti,
-                                  dl_sched_queue.size());
     }
-
-    // Delete the SDU
-    sdu_ready->rb->delete_next_mac_sdu();
 }
 
 /**************************/
@@ -777,11 +948,11 @@ void LTE_fdd_enb_mac::handle_ulsch_ccch_sdu(LTE_fdd_enb_user       *user,
     // Send the SDU to RLC
     send_rlc_pdu_ready(user, rb, sdu);
 
-    // Update the uplink buffer size
-    user->update_ul_buffer_size(sdu->N_bytes);
+    // Update the uplink buffer size, SRB0 is always in LCG 0
+    user->update_ul_buffer_size(rb->get_log_chan_group(), sdu->N_bytes);
 
     // Schedule uplink
-    sched_ul(user, user->get_ul_buffer_size()*8);
+    sched_ul(user);
 }
 void LTE_fdd_enb_mac::handle_ulsch_dcch_sdu(LTE_fdd_enb_user       *user,
                                             uint32                  lcid,
@@ -835,10 +1006,10 @@ void LTE_fdd_enb_mac::handle_ulsch_dcch_sdu(LTE_fdd_enb_user       *user,
     send_rlc_pdu_ready(user, rb, sdu);
 
     // Update the uplink buffer size
-    user->update_ul_buffer_size(sdu->N_bytes);
+    user->update_ul_buffer_size(rb->get_log_chan_group(), sdu->N_bytes);
 
     // Schedule uplink
-    sched_ul(user, user->get_ul_buffer_size()*8);
+    sched_ul(user);
 }
 void LTE_fdd_enb_mac::handle_ulsch_ext_power_headroom_report(LTE_fdd_enb_user                        *user,
                                                              LIBLTE_MAC_EXT_POWER_HEADROOM_CE_STRUCT *ext_power_headroom)
@@ -886,9 +1057,9 @@ void LTE_fdd_enb_mac::handle_ulsch_truncated_bsr(LTE_fdd_enb_user
                               truncated_bsr->max_buffer_size,
                               user->get_c_rnti());
 
-    user->set_ul_buffer_size(truncated_bsr->max_buffer_size);
+    user->set_ul_buffer_size(truncated_bsr->lcg_id, truncated_bsr->max_buffer_size);
 
-    sched_ul(user, truncated_bsr->max_buffer_size*8);
+    sched_ul(user);
 }
 void LTE_fdd_enb_mac::handle_ulsch_short_bsr(LTE_fdd_enb_user               *user,
                                              LIBLTE_MAC_SHORT_BSR_CE_STRUCT *short_bsr)
@@ -903,9 +1074,9 @@ void LTE_fdd_enb_mac::handle_ulsch_short_bsr(LTE_fdd_enb_user               *use
                               short_bsr->max_buffer_size,
                               user->get_c_rnti());
 
-    user->set_ul_buffer_size(short_bsr->max_buffer_size);
+    user->set_ul_buffer_size(short_bsr->lcg_id, short_bsr->max_buffer_size);
 
-    sched_ul(user, short_bsr->max_buffer_size*8);
+    sched_ul(user);
 }
 void LTE_fdd_enb_mac::handle_ulsch_long_bsr(LTE_fdd_enb_user              *user,
                                             LIBLTE_MAC_LONG_BSR_CE_STRUCT *long_bsr)
@@ -925,15 +1096,12 @@ void LTE_fdd_enb_mac::handle_ulsch_long_bsr(LTE_fdd_enb_user              *user,
                               long_bsr->max_buffer_size_3,
                               user->get_c_rnti());
 
-    user->set_ul_buffer_size(long_bsr->max_buffer_size_0 +
-                             long_bsr->max_buffer_size_1 +
-                             long_bsr->max_buffer_size_2 +
-                             long_bsr->max_buffer_size_3);
+    user->set_ul_buffer_size(0, long_bsr->max_buffer_size_0);
+    user->set_ul_buffer_size(1, long_bsr->max_buffer_size_1);
+    user->set_ul_buffer_size(2, long_bsr->max_buffer_size_2);
+    user->set_ul_buffer_size(3, long_bsr->max_buffer_size_3);
 
-    sched_ul(user, (long_bsr->max_buffer_size_0 +
-                    long_bsr->max_buffer_size_1 +
-                    long_bsr->max_buffer_size_2 +
-                    long_bsr->max_buffer_size_3)*8);
+    sched_ul(user);
 }
 
 /***************************/
@@ -945,7 +1113,7 @@ void LTE_fdd_enb_mac::construct_random_access_response(uint8  preamble,
 {
     // Allocate a user
     LTE_fdd_enb_user *user = NULL;
-    if(LTE_FDD_ENB_ERROR_NONE != user_mgr->add_user(&user, rrc, rlc))
+    if(LTE_FDD_ENB_ERROR_NONE != user_mgr->add_user(&user, cell, rrc, rlc))
         return interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
                                          LTE_FDD_ENB_DEBUG_LEVEL_MAC,
                                          __FILE__,
@@ -1013,16 +1181,66 @@ void LTE_fdd_enb_mac::construct_random_access_response(uint8  preamble,
                               __FILE__,
                               __LINE__,
                               "RAR scheduled %u",
-                              rar_sched_queue.size());
+                              rar_sched_pool.get_n_used());
+}
+
+void LTE_fdd_enb_mac::construct_ta_command(LTE_fdd_enb_user *user,
+                                           uint8             ta)
+{
+    // Fill in the allocation
+    LIBLTE_PHY_ALLOCATION_STRUCT alloc = {0};
+    alloc.pre_coder_type = LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY;
+    alloc.mod_type       = get_modulation_type(user->get_mcs());
+    alloc.chan_type      = LIBLTE_PHY_CHAN_TYPE_DLSCH;
+    alloc.rv_idx         = 0;
+    alloc.N_codewords    = 1;
+    sys_info_mutex.lock();
+    if(1 == interface->get_n_ant())
+    {
+        alloc.tx_mode = 1;
+    }else{
+        alloc.tx_mode = 2;
+    }
+    sys_info_mutex.unlock();
+    alloc.rnti         = user->get_c_rnti();
+    alloc.tpc          = LIBLTE_PHY_TPC_COMMAND_DCI_1_1A_1B_1D_2_3_DB_ZERO;
+    alloc.harq_process = user->get_harq_process();
+    user->increment_harq_process();
+    alloc.ndi             = 0;
+    alloc.harq_retx_count = 0;
+
+    // Pack the PDU
+    LIBLTE_MAC_PDU_STRUCT mac_pdu;
+    mac_pdu.chan_type                          = LIBLTE_MAC_CHAN_TYPE_DLSCH;
+    mac_pdu.N_subheaders                       = 1;
+    mac_pdu.subheader[0].lcid                  = LIBLTE_MAC_DLSCH_TA_COMMAND_LCID;
+    mac_pdu.subheader[0].payload.ta_command.ta = ta;
+
+    if(LTE_FDD_ENB_ERROR_NONE != add_to_dl_sched_queue(liblte_phy_add_to_tti(sched_dl_subfr[sched_cur_dl_subfn].current_tti,
+                                                                             4),
+                                                       &mac_pdu,
+                                                       &alloc))
+        return interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
+                                         LTE_FDD_ENB_DEBUG_LEVEL_MAC,
+                                         __FILE__,
+                                         __LINE__,
+                                         "Can't schedule TA command for RNTI=%u",
+                                         alloc.rnti);
+    interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                              LTE_FDD_ENB_DEBUG_LEVEL_MAC,
+                              __FILE__,
+                              __LINE__,
+                              "TA command (TA=%u) scheduled for RNTI=%u",
+                              ta,
+                              alloc.rnti);
 }
 
 /*******************/
 /*    Scheduler    */
 /*******************/
-void LTE_fdd_enb_mac::sched_ul(LTE_fdd_enb_user *user,
-                               uint32            requested_tbs)
+void LTE_fdd_enb_mac::sched_ul(LTE_fdd_enb_user *user)
 {
-    if(requested_tbs == 0)
+    if(0 == user->get_ul_buffer_size() && !user->get_ul_sr_pending())
         return;
 
     LIBLTE_PHY_ALLOCATION_STRUCT alloc;
@@ -1034,20 +1252,13 @@ void LTE_fdd_enb_mac::sched_ul(LTE_fdd_enb_user *user,
     alloc.N_layers       = 1;
     alloc.tx_mode        = 1;
     alloc.rnti           = user->get_c_rnti();
+    alloc.mcs            = user->get_mcs();
     alloc.tpc            = LIBLTE_PHY_TPC_COMMAND_DCI_0_3_4_DB_NEG_1;
     alloc.ndi            = 0;
-    uint32 bits_req      = requested_tbs;
-    if(bits_req > (user->get_max_ul_bytes_per_subfn()*8))
-        bits_req = user->get_max_ul_bytes_per_subfn()*8;
-    sys_info_mutex.lock();
-    liblte_phy_get_tbs_and_n_prb_for_ul(bits_req,
-                                        interface->get_n_rb_ul(),
-                                        user->get_mcs(),
-                                        &alloc.tbs,
-                                        &alloc.N_prb);
-    sys_info_mutex.unlock();
+    alloc.tbs            = 0;
+    alloc.N_prb          = 0;
 
-    // Add the allocation to the scheduling queue
+    // The UL scheduler sizes the grants, this only marks the UE as having data
     uint32 tti = liblte_phy_add_to_tti(sched_ul_subfr[sched_cur_ul_subfn].current_tti, 10);
     if(LTE_FDD_ENB_ERROR_NONE != add_to_ul_sched_queue(tti, &alloc))
         return interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
@@ -1059,12 +1270,11 @@ void LTE_fdd_enb_mac::sched_ul(LTE_fdd_enb_user *user,
                               LTE_FDD_ENB_DEBUG_LEVEL_MAC,
                               __FILE__,
                               __LINE__,
-                              "UL scheduled (mcs=%u, tbs=%u, N_prb=%u) for RNTI=%u, UL_QUEUE_SIZE=%u TTI=%u",
-                              alloc.mcs,
-                              alloc.tbs,
-                              alloc.N_prb,
+                              "UL pending (buffer=%u, sr=%u) for RNTI=%u, UL_QUEUE_SIZE=%u TTI=%u",
+                              user->get_ul_buffer_size(),
+                              user->get_ul_sr_pending(),
                               alloc.rnti,
-                              ul_sched_queue.size(),
+                              ul_sched_pool.get_n_used(),
                               tti);
 }
 void LTE_fdd_enb_mac::persistent_dl(LTE_FDD_ENB_PERSISTENT_DL_STRUCT *sched)
@@ -1093,14 +1303,12 @@ void LTE_fdd_enb_mac::handle_persistent_dl_timer_expiry(uint32 timer_id)
 }
 void LTE_fdd_enb_mac::rar_scheduler()
 {
-    std::lock_guard<std::mutex> rar_lock(rar_sched_queue_mutex);
-    std::lock_guard<std::mutex> si_lock(sys_info_mutex);
+    std::lock_guard<std::mutex>         si_lock(sys_info_mutex);
+    LTE_FDD_ENB_RAR_SCHED_QUEUE_STRUCT *rar_sched = NULL;
 
     // Schedule RAR for the next subframe
-    while(0 != rar_sched_queue.size())
+    while(NULL != (rar_sched = rar_sched_pool.front(&rar_sched_queue)))
     {
-        LTE_FDD_ENB_RAR_SCHED_QUEUE_STRUCT *rar_sched = rar_sched_queue.front();
-
         // Determine when the response window starts
         uint32 resp_win_start = liblte_phy_add_to_tti(rar_sched->current_tti, 3);
 
@@ -1119,8 +1327,8 @@ void LTE_fdd_enb_mac::rar_scheduler()
                                       "RAR outside of resp win %u %u",
                                       resp_win_stop,
                                       sched_dl_subfr[sched_cur_dl_subfn].current_tti);
-            rar_sched_queue.pop_front();
-            delete rar_sched;
+            rar_sched_pool.remove(&rar_sched_queue, rar_sched);
+            rar_sched_pool.free(rar_sched);
             continue;
         }
 
@@ -1142,9 +1350,15 @@ void LTE_fdd_enb_mac::rar_scheduler()
                                                 &rar_sched->dl_alloc.mcs,
                                                 &rar_sched->dl_alloc.N_prb);
 
-        // Check for scheduling headroom
-        if(!scheduling_headroom(dl_subfr, ul_subfr,
-                                rar_sched->dl_alloc.N_prb, rar_sched->ul_alloc.N_prb))
+        // Check for scheduling headroom and fill in the PRBs for the DL allocation,
+        // the RAR waits for a later subframe when the allocation lists are full
+        if(LIBLTE_PHY_PDCCH_MAX_ALLOC <= dl_subfr->allocations.N_dl_alloc ||
+           LIBLTE_PHY_PDCCH_MAX_ALLOC <= ul_subfr->decodes.N_ul_alloc     ||
+           !scheduling_headroom(dl_subfr, ul_subfr,
+                                rar_sched->dl_alloc.N_prb, rar_sched->ul_alloc.N_prb,
+                                &rar_sched->dl_alloc)                                 ||
+           !alloc_dl_prbs(dl_subfr, &rar_sched->dl_alloc, false)                     ||
+           !alloc_ul_prbs(ul_subfr, &rar_sched->ul_alloc))
             break;
 
         interface->send_lte_pcap_msg(LTE_FDD_ENB_PCAP_DIRECTION_DL,
@@ -1153,18 +1367,8 @@ void LTE_fdd_enb_mac::rar_scheduler()
                                      rar_sched->dl_alloc.msg[0].msg,
                                      rar_sched->dl_alloc.msg[0].N_bits);
 
-        // Determine the RB start for the UL allocation
-        uint32 rb_start     = ul_subfr->next_prb;
-        ul_subfr->next_prb += rar_sched->ul_alloc.N_prb;
-
-        // Fill in the PRBs for the UL allocation
-        for(uint32 i=0; i<rar_sched->ul_alloc.N_prb; i++)
-        {
-            rar_sched->ul_alloc.prb[0][i] = rb_start+i;
-            rar_sched->ul_alloc.prb[1][i] = rb_start+i;
-        }
-
         // Determine the RIV for the UL and re-pack the RAR
+        uint32 rb_start = rar_sched->ul_alloc.prb[0][0];
         uint32 riv = interface->get_n_rb_ul()*(interface->get_n_rb_ul() - rar_sched->ul_alloc.N_prb + 1) + (interface->get_n_rb_ul() - 1 - rb_start);
         if((rar_sched->ul_alloc.N_prb-1) <= (interface->get_n_rb_ul()/2))
             riv = interface->get_n_rb_ul()*(rar_sched->ul_alloc.N_prb - 1) + rb_start;
@@ -1179,16 +1383,6 @@ void LTE_fdd_enb_mac::rar_scheduler()
         liblte_mac_pack_random_access_response_pdu(&rar_sched->rar,
                                                    &rar_sched->dl_alloc.msg[0]);
 
-        // Determine the RB start for the DL allocation
-        rb_start            = dl_subfr->next_prb;
-        dl_subfr->next_prb += rar_sched->dl_alloc.N_prb;
-
-        // Fill in the PRBs for the DL allocation
-        for(uint32 i=0; i<rar_sched->dl_alloc.N_prb; i++)
-        {
-            rar_sched->dl_alloc.prb[0][i] = rb_start+i;
-            rar_sched->dl_alloc.prb[1][i] = rb_start+i;
-        }
 
         interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
                                   LTE_FDD_ENB_DEBUG_LEVEL_MAC,
@@ -1207,6 +1401,7 @@ void LTE_fdd_enb_mac::rar_scheduler()
             memcpy(&dl_subfr->allocations.dl_alloc[dl_subfr->allocations.N_dl_alloc],
                    &rar_sched->dl_alloc,
                    sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+            alloc_pdcch(dl_subfr, &dl_subfr->allocations.dl_alloc[dl_subfr->allocations.N_dl_alloc], true);
             dl_subfr->allocations.N_dl_alloc++;
             // Schedule UL decode 6 subframes from now
             memcpy(&ul_subfr->decodes.ul_alloc[ul_subfr->decodes.N_ul_alloc],
@@ -1223,228 +1418,382 @@ void LTE_fdd_enb_mac::rar_scheduler()
         }
 
         // Remove RAR from queue
-        rar_sched_queue.pop_front();
-        delete rar_sched;
+        rar_sched_pool.remove(&rar_sched_queue, rar_sched);
+        rar_sched_pool.free(rar_sched);
     }
 }
 void LTE_fdd_enb_mac::dl_scheduler()
 {
-    std::lock_guard<std::mutex> lock(dl_sched_queue_mutex);
+    LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr = &sched_dl_subfr[sched_cur_dl_subfn];
 
-    // Schedule DL for the next subframe
-    while(0 != dl_sched_queue.size())
+    // Pick up policy changes from the control port
+    if(NULL == dl_sched_policy ||
+       interface->get_dl_sched_policy() != dl_sched_policy->get_type())
     {
-        LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched = dl_sched_queue.front();
+        delete dl_sched_policy;
+        dl_sched_policy = LTE_fdd_enb_dl_sched_policy::create(interface->get_dl_sched_policy());
+    }
 
-        // Check if the scheduled TTI is in the past
-        if(liblte_phy_is_tti_in_past(dl_sched->current_tti,
-                                     sched_dl_subfr[sched_cur_dl_subfn].current_tti))
+    // Remove stale DL schedules from the queue and serve SI first
+    LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched = dl_sched_pool.front(&dl_sched_queue);
+    while(NULL != dl_sched)
+    {
+        LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *next = dl_sched_pool.next(&dl_sched_queue, dl_sched);
+
+        // Only SI must go out in its scheduled TTI, everything else may
+        // wait for a later subframe and keeps its place in the queue.
+        // Multiplexed entries only point at the RB queues, so they stay
+        // until the UE is drained or released.  A UE in DRX sleep keeps
+        // its PDUs until its next on duration.
+        LTE_fdd_enb_user *user  = NULL;
+        bool              stale = false;
+        if(dl_sched->mux)
+        {
+            if(LTE_FDD_ENB_ERROR_NONE != user_mgr->find_user(dl_sched->alloc.rnti, &user) ||
+               0                      == get_dl_mux_backlog(user))
+                stale = true;
+        }else if(liblte_phy_is_tti_in_past(dl_sched->current_tti, dl_subfr->current_tti)){
+            uint32 max_delay = DL_SCHED_MAX_DELAY_N_TTIS;
+            if(LIBLTE_MAC_SI_RNTI     != dl_sched->alloc.rnti &&
+               LTE_FDD_ENB_ERROR_NONE == user_mgr->find_user(dl_sched->alloc.rnti, &user))
+                max_delay += user->get_drx_cycle();
+            if(LIBLTE_MAC_SI_RNTI == dl_sched->alloc.rnti ||
+               max_delay < liblte_phy_sub_from_tti(dl_subfr->current_tti, dl_sched->current_tti))
+                stale = true;
+        }
+        if(stale)
         {
-            // Remove DL schedule from queue
             interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
                                       LTE_FDD_ENB_DEBUG_LEVEL_MAC,
                                       __FILE__,
                                       __LINE__,
                                       "DL in the past %u %u",
                                       dl_sched->current_tti,
-                                      sched_dl_subfr[sched_cur_dl_subfn].current_tti);
-            dl_sched_queue.pop_front();
-            delete dl_sched;
-            continue;
+                                      dl_subfr->current_tti);
+            dl_sched_pool.remove(&dl_sched_queue, dl_sched);
+            free_dl_sched(dl_sched);
+        }else if(LIBLTE_MAC_SI_RNTI == dl_sched->alloc.rnti &&
+                 schedule_dl_alloc(dl_subfr, dl_sched)){
+            dl_sched_pool.remove(&dl_sched_queue, dl_sched);
+            free_dl_sched(dl_sched);
         }
+        dl_sched = next;
+    }
 
-        // Check to see if the scheduled TTI matches the current TTI
-        if(dl_sched->current_tti != sched_dl_subfr[sched_cur_dl_subfn].current_tti)
-            break;
+    // Build one candidate per UE from its oldest DL schedule
+    uint32 arrival_idx = 0;
+    dl_candidates.clear();
+    for(dl_sched=dl_sched_pool.front(&dl_sched_queue); NULL!=dl_sched; dl_sched=dl_sched_pool.next(&dl_sched_queue, dl_sched))
+    {
+        arrival_idx++;
+        if(LIBLTE_MAC_SI_RNTI == dl_sched->alloc.rnti)
+            continue;
 
-        LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr = &sched_dl_subfr[sched_cur_dl_subfn];
-        if(dl_sched->alloc.rnti != LIBLTE_MAC_SI_RNTI)
-        {
-            // Pack the message and determine TBS
-            liblte_mac_pack_mac_pdu(&dl_sched->mac_pdu,
-                                    &dl_sched->alloc.msg[0]);
-            liblte_phy_get_tbs_and_n_prb_for_dl(dl_sched->alloc.msg[0].N_bits,
-                                                dl_subfr->N_avail_prbs - dl_subfr->N_sched_prbs,
-                                                dl_sched->alloc.mcs,
-                                                &dl_sched->alloc.tbs,
-                                                &dl_sched->alloc.N_prb);
-
-            // Pad and repack if needed
-            if(dl_sched->alloc.tbs > dl_sched->alloc.msg[0].N_bits)
-            {
-                uint32 N_pad = (dl_sched->alloc.tbs - dl_sched->alloc.msg[0].N_bits)/8;
+        // The configured SPS assignment is the UE's PDSCH in this subframe
+        if(sps_dl_occasion(dl_sched->alloc.rnti))
+            continue;
 
-                if(1 == N_pad)
-                {
-                    for(uint32 i=0; i<dl_sched->mac_pdu.N_subheaders; i++)
-                        memcpy(&dl_sched->mac_pdu.subheader[dl_sched->mac_pdu.N_subheaders-i],
-                               &dl_sched->mac_pdu.subheader[dl_sched->mac_pdu.N_subheaders-i-1],
-                               sizeof(LIBLTE_MAC_PDU_SUBHEADER_STRUCT));
-                    dl_sched->mac_pdu.subheader[0].lcid = LIBLTE_MAC_DLSCH_PADDING_LCID;
-                    dl_sched->mac_pdu.N_subheaders++;
-                }else if(2 == N_pad){
-                    for(uint32 i=0; i<dl_sched->mac_pdu.N_subheaders; i++)
-                        memcpy(&dl_sched->mac_pdu.subheader[dl_sched->mac_pdu.N_subheaders-i+1],
-                               &dl_sched->mac_pdu.subheader[dl_sched->mac_pdu.N_subheaders-i-1],
-                               sizeof(LIBLTE_MAC_PDU_SUBHEADER_STRUCT));
-                    dl_sched->mac_pdu.subheader[0].lcid  = LIBLTE_MAC_DLSCH_PADDING_LCID;
-                    dl_sched->mac_pdu.subheader[1].lcid  = LIBLTE_MAC_DLSCH_PADDING_LCID;
-                    dl_sched->mac_pdu.N_subheaders      += 2;
-                }else{
-                    dl_sched->mac_pdu.subheader[dl_sched->mac_pdu.N_subheaders].lcid = LIBLTE_MAC_DLSCH_PADDING_LCID;
-                    dl_sched->mac_pdu.N_subheaders++;
-                }
+        // A UE in DRX sleep is not monitoring the PDCCH
+        LTE_fdd_enb_user *user    = NULL;
+        uint32            N_bytes = 0;
+        user_mgr->find_user(dl_sched->alloc.rnti, &user);
+        if(NULL != user && !user->is_drx_active(dl_subfr->current_tti))
+            continue;
+        if(dl_sched->mux)
+        {
+            if(NULL != user)
+                N_bytes = get_dl_mux_backlog(user);
+        }else{
+            for(uint32 i=0; i<dl_sched->mac_pdu.N_subheaders; i++)
+                if(dl_sched->mac_pdu.subheader[i].lcid <= LIBLTE_MAC_DLSCH_DCCH_LCID_END)
+                    N_bytes += dl_sched->mac_pdu.subheader[i].payload.sdu.N_bytes;
+        }
 
-                liblte_mac_pack_mac_pdu(&dl_sched->mac_pdu,
-                                        &dl_sched->alloc.msg[0]);
+        if(0 != dl_cand_idx[dl_sched->alloc.rnti])
+        {
+            // The multiplexed entry stays queued for as long as the UE has
+            // data, so a PDU that is already built (a HARQ retransmission or
+            // a MAC control element) takes the UE's PDSCH ahead of it
+            LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT *cand  = &dl_candidates[dl_cand_idx[dl_sched->alloc.rnti] - 1];
+            LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT     *entry = (LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *)cand->entry;
+            cand->backlog_bytes += N_bytes;
+            if(entry->mux && !dl_sched->mux)
+            {
+                cand->entry     = dl_sched;
+                cand->inst_rate = get_dl_inst_rate(user, dl_sched->alloc.mcs);
             }
+            continue;
         }
 
-        // Check for scheduling headroom
-        if(!scheduling_headroom(dl_subfr, NULL, dl_sched->alloc.N_prb, 0))
-            break;
-
-        // Determine the RB start for the allocation
-        uint32 rb_start     = dl_subfr->next_prb;
-        dl_subfr->next_prb += dl_sched->alloc.N_prb;
-
-        // Fill in the PRBs for the allocation
-        for(uint32 i=0; i<dl_sched->alloc.N_prb; i++)
+        LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT cand;
+        cand.rnti           = dl_sched->alloc.rnti;
+        cand.backlog_bytes  = N_bytes;
+        cand.arrival_idx    = arrival_idx;
+        cand.N_ttis_waiting = LIBLTE_PHY_TTI_MAX;
+        cand.avg_thru       = 0;
+        cand.inst_rate      = get_dl_inst_rate(NULL, dl_sched->alloc.mcs);
+        cand.entry          = dl_sched;
+        if(NULL != user)
         {
-            dl_sched->alloc.prb[0][i] = rb_start+i;
-            dl_sched->alloc.prb[1][i] = rb_start+i;
+            cand.N_ttis_waiting = user->get_dl_n_ttis_waiting(dl_subfr->current_tti);
+            cand.avg_thru       = user->get_dl_avg_thru(dl_subfr->current_tti);
+            cand.inst_rate      = get_dl_inst_rate(user, dl_sched->alloc.mcs);
         }
+        dl_candidates.push_back(cand);
+        dl_cand_idx[cand.rnti] = dl_candidates.size();
+    }
+    for(auto &cand : dl_candidates)
+        dl_cand_idx[cand.rnti] = 0;
 
-        // Send a PCAP message
-        interface->send_lte_pcap_msg(LTE_FDD_ENB_PCAP_DIRECTION_DL,
-                                     dl_sched->alloc.rnti,
-                                     dl_subfr->current_tti,
-                                     dl_sched->alloc.msg[0].msg,
-                                     dl_sched->alloc.tbs);
-
-        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
-                                  LTE_FDD_ENB_DEBUG_LEVEL_MAC,
-                                  __FILE__,
-                                  __LINE__,
-                                  &dl_sched->alloc.msg[0],
-                                  "DL allocation (mcs=%u, tbs=%u, N_prb=%u) sent for RNTI=%u CURRENT_TTI=%u",
-                                  dl_sched->alloc.mcs,
-                                  dl_sched->alloc.tbs,
-                                  dl_sched->alloc.N_prb,
-                                  dl_sched->alloc.rnti,
-                                  dl_subfr->current_tti);
+    // Schedule DL for the next subframe in policy order
+    dl_sched_policy->rank(dl_candidates);
+    for(auto &cand : dl_candidates)
+    {
+        LTE_fdd_enb_user *user = NULL;
+        dl_sched               = (LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *)cand.entry;
 
-        // Schedule DL
-        if(NULL == msgq_to_ue)
+        bool scheduled;
+        if(dl_sched->mux)
         {
-            memcpy(&dl_subfr->allocations.dl_alloc[dl_subfr->allocations.N_dl_alloc],
-                   &dl_sched->alloc,
-                   sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
-            dl_subfr->allocations.N_dl_alloc++;
-
-            if(dl_sched->alloc.rnti != LIBLTE_MAC_SI_RNTI)
-            {
-                // Schedule ACK/NACK PUCCH 4 subframes from now and store the DL allocation for potential H-ARQ retransmission
-                std::lock_guard<std::mutex>         si_lock(sys_info_mutex);
-                LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr   = &sched_ul_subfr[(sched_cur_dl_subfn+4)%10];
-                ul_subfr->pucch[ul_subfr->N_pucch].type        = LTE_FDD_ENB_PUCCH_TYPE_ACK_NACK;
-                ul_subfr->pucch[ul_subfr->N_pucch].rnti        = dl_sched->alloc.rnti;
-                ul_subfr->pucch[ul_subfr->N_pucch].n_1_p_pucch = sys_info.sib2.radioResourceConfigCommon_Get().pucch_ConfigCommon_Get().n1PUCCH_AN_Value();
-                ul_subfr->pucch[ul_subfr->N_pucch].decode      = true;
-                ul_subfr->N_pucch++;
-                LTE_fdd_enb_user *user;
-                if(LTE_FDD_ENB_ERROR_NONE == user_mgr->find_user(dl_sched->alloc.rnti, &user))
-                    user->store_harq_info(ul_subfr->current_tti, &dl_sched->mac_pdu, &dl_sched->alloc);
-            }
+            scheduled = (LTE_FDD_ENB_ERROR_NONE == user_mgr->find_user(cand.rnti, &user) &&
+                         schedule_dl_mux(dl_subfr, dl_sched, user));
         }else{
-            LIBTOOLS_IPC_MSGQ_MAC_PDU_MSG_STRUCT mac_pdu_msg;
-            memcpy(&mac_pdu_msg.msg, &dl_sched->alloc.msg[0], sizeof(mac_pdu_msg.msg));
-            mac_pdu_msg.rnti = dl_sched->alloc.rnti;
-            msgq_to_ue->send(LIBTOOLS_IPC_MSGQ_MESSAGE_TYPE_MAC_PDU,
-                             (LIBTOOLS_IPC_MSGQ_MESSAGE_UNION *)&mac_pdu_msg,
-                             sizeof(mac_pdu_msg));
+            scheduled = schedule_dl_alloc(dl_subfr, dl_sched);
+        }
+        if(!scheduled)
+        {
+            if(dl_sched_policy->skip_on_no_headroom())
+                continue;
+            break;
         }
 
+        // Whatever did not fit in this TTI keeps its place in the queue
+        if(dl_sched->mux && 0 != get_dl_mux_backlog(user))
+            continue;
+
         // Remove DL schedule from queue
-        dl_sched_queue.pop_front();
-        delete dl_sched;
+        dl_sched_pool.remove(&dl_sched_queue, dl_sched);
+        free_dl_sched(dl_sched);
     }
 }
-void LTE_fdd_enb_mac::ul_scheduler()
+void LTE_fdd_enb_mac::ul_harq_scheduler()
 {
-    std::lock_guard<std::mutex> lock(ul_sched_queue_mutex);
-
-    // Schedule UL for the next subframe
-    while(0 != ul_sched_queue.size())
+    std::lock_guard<std::mutex>         lock(ul_harq_mutex);
+    LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr = &sched_ul_subfr[(sched_cur_dl_subfn+6)%10];
+
+    // The MAC runs ahead of the PUSCH decode, so a retransmission is
+    // reserved before the first attempt is known to have failed and
+    // dropped again by clear_ul_harq() if it turns out to be an ACK.
+    // Reserving here, before the RAR and UL schedulers touch this
+    // subframe, keeps the PRBs of the non-adaptive retransmission free.
+    LTE_FDD_ENB_UL_HARQ_STRUCT *harq = NULL;
+    LTE_FDD_ENB_UL_HARQ_STRUCT *next = NULL;
+    for(harq=ul_harq_pool.front(&ul_harq_queue); NULL!=harq; harq=next)
     {
-        LTE_FDD_ENB_UL_SCHED_QUEUE_STRUCT  *ul_sched = ul_sched_queue.front();
-        LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr = &sched_dl_subfr[sched_cur_dl_subfn];
-        LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr = &sched_ul_subfr[(sched_cur_dl_subfn+4)%10];
+        next = ul_harq_pool.next(&ul_harq_queue, harq);
+
+        // The previous retransmission is now the one being decoded
+        if(harq->retx_reserved &&
+           liblte_phy_add_to_tti(harq->current_tti, 16) == ul_subfr->current_tti)
+        {
+            harq->current_tti   = liblte_phy_add_to_tti(harq->current_tti, 8);
+            harq->retx_reserved = false;
+        }
+        if(harq->retx_reserved ||
+           liblte_phy_is_tti_in_future(liblte_phy_add_to_tti(harq->current_tti, 8), ul_subfr->current_tti))
+            continue;
 
-        // Check if the scheduled TTI is in the past
-        if(liblte_phy_is_tti_in_past(ul_sched->current_tti, ul_subfr->current_tti))
+        // The UE gives up after maxHARQ-Tx, RLC recovers the data from there
+        bool drop = (NULL                       != msgq_to_ue                        ||
+                     LTE_FDD_ENB_MAX_UL_HARQ_TX <= harq->N_tx                        ||
+                     LIBLTE_PHY_PDCCH_MAX_ALLOC <= ul_subfr->decodes.N_ul_alloc      ||
+                     liblte_phy_add_to_tti(harq->current_tti, 8) != ul_subfr->current_tti);
+        for(uint32 i=0; i<harq->alloc.N_prb && !drop; i++)
+            if(ul_subfr->prb_used[harq->alloc.prb[0][i]])
+                drop = true;
+        if(drop)
         {
-            // Remove UL schedule from queue
             interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
                                       LTE_FDD_ENB_DEBUG_LEVEL_MAC,
                                       __FILE__,
                                       __LINE__,
-                                      "UL in the past %u %u",
-                                      ul_sched->current_tti,
-                                      ul_subfr->current_tti);
-            ul_sched_queue.pop_front();
-            delete ul_sched;
+                                      "Not reserving UL HARQ retx for RNTI=%u TTI=%u N_tx=%u",
+                                      harq->alloc.rnti,
+                                      harq->current_tti,
+                                      harq->N_tx);
+            free_ul_harq(harq);
+            continue;
+        }
+
+        // Non-adaptive retransmission, the UE reuses the PRBs on a PHICH NACK
+        for(uint32 i=0; i<harq->alloc.N_prb; i++)
+            ul_subfr->prb_used[harq->alloc.prb[0][i]] = true;
+        ul_subfr->N_sched_prbs += harq->alloc.N_prb;
+        harq->alloc.rv_idx      = UL_HARQ_RV_IDX[harq->N_tx % 4];
+        harq->N_tx++;
+        harq->retx_reserved     = true;
+        memcpy(&ul_subfr->decodes.ul_alloc[ul_subfr->decodes.N_ul_alloc],
+               &harq->alloc,
+               sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+        ul_subfr->decodes.N_ul_alloc++;
+
+        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                                  LTE_FDD_ENB_DEBUG_LEVEL_MAC,
+                                  __FILE__,
+                                  __LINE__,
+                                  "UL HARQ retx reserved for RNTI=%u CURRENT_TTI=%u rv_idx=%u",
+                                  harq->alloc.rnti,
+                                  ul_subfr->current_tti,
+                                  harq->alloc.rv_idx);
+    }
+}
+void LTE_fdd_enb_mac::ul_scheduler()
+{
+    LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr = &sched_dl_subfr[sched_cur_dl_subfn];
+    LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr = &sched_ul_subfr[(sched_cur_dl_subfn+4)%10];
+
+    // Pick up policy changes from the control port
+    if(NULL == ul_sched_policy ||
+       interface->get_ul_sched_policy() != ul_sched_policy->get_type())
+    {
+        delete ul_sched_policy;
+        ul_sched_policy = LTE_fdd_enb_dl_sched_policy::create(interface->get_ul_sched_policy());
+    }
+
+    // Build one candidate per UE from what it reported and has not been granted yet
+    LTE_FDD_ENB_UL_SCHED_QUEUE_STRUCT *ul_sched    = NULL;
+    LTE_FDD_ENB_UL_SCHED_QUEUE_STRUCT *next        = NULL;
+    uint32                             arrival_idx = 0;
+    ul_candidates.clear();
+    for(ul_sched=ul_sched_pool.front(&ul_sched_queue); NULL!=ul_sched; ul_sched=next)
+    {
+        LTE_fdd_enb_user *user = NULL;
+        next                   = ul_sched_pool.next(&ul_sched_queue, ul_sched);
+
+        // Entries stay until the UE has nothing left to send
+        if(LTE_FDD_ENB_ERROR_NONE != user_mgr->find_user(ul_sched->alloc.rnti, &user) ||
+           (0 == user->get_ul_buffer_size() && !user->get_ul_sr_pending()))
+        {
+            ul_sched_pool.remove(&ul_sched_queue, ul_sched);
+            free_ul_sched(ul_sched);
             continue;
         }
+        arrival_idx++;
+
+        // The grant goes out on the PDCCH of the current DL subframe
+        if(liblte_phy_is_tti_in_future(ul_sched->current_tti, ul_subfr->current_tti) ||
+           !user->is_drx_active(dl_subfr->current_tti))
+            continue;
+
+        // A UE can only send one transport block per subframe, which may
+        // already be a Msg3 or a HARQ retransmission
+        bool busy = false;
+        for(uint32 i=0; i<ul_subfr->decodes.N_ul_alloc; i++)
+            if(ul_subfr->decodes.ul_alloc[i].rnti == ul_sched->alloc.rnti ||
+               (user->is_sps_c_rnti_set() && ul_subfr->decodes.ul_alloc[i].rnti == user->get_sps_c_rnti()))
+                busy = true;
+        if(busy)
+            continue;
+
+        // Grants already on their way will carry part of the reported buffer
+        uint32 N_buffer    = user->get_ul_buffer_size();
+        uint32 N_in_flight = get_ul_bytes_in_flight(ul_sched->alloc.rnti);
+        uint32 N_bytes     = (N_buffer > N_in_flight) ? (N_buffer - N_in_flight) : 0;
+        if((0 == N_bytes && !user->get_ul_sr_pending()) ||
+           sps_covers_ul(user, N_bytes))
+            continue;
+
+        uint32 tbs_1_prb = 0;
+        liblte_phy_get_tbs_for_ul(user->get_mcs(), 1, &tbs_1_prb);
+
+        LTE_FDD_ENB_DL_SCHED_CANDIDATE_STRUCT cand;
+        cand.rnti           = ul_sched->alloc.rnti;
+        cand.backlog_bytes  = N_bytes;
+        cand.arrival_idx    = arrival_idx;
+        cand.N_ttis_waiting = user->get_ul_n_ttis_waiting(ul_subfr->current_tti);
+        cand.avg_thru       = user->get_ul_avg_thru(ul_subfr->current_tti);
+        cand.inst_rate      = tbs_1_prb;
+        cand.entry          = ul_sched;
+        ul_candidates.push_back(cand);
+    }
 
-        // Check for scheduling headroom
-        if(!scheduling_headroom(dl_subfr, ul_subfr, 0, ul_sched->alloc.N_prb))
+    // Schedule UL 4 subframes from now in policy order, sharing the free
+    // PRBs between the UEs that are still waiting for a grant
+    ul_sched_policy->rank(ul_candidates);
+    uint32 N_cands_left = ul_candidates.size();
+    for(auto &cand : ul_candidates)
+    {
+        // No room left for another decode or DCI 0 in this subframe
+        if(LIBLTE_PHY_PDCCH_MAX_ALLOC <= ul_subfr->decodes.N_ul_alloc ||
+           LIBLTE_PHY_PDCCH_MAX_ALLOC <= dl_subfr->allocations.N_ul_alloc)
             break;
 
-        // Determine the RB start
-        uint32 rb_start     = ul_subfr->next_prb;
-        ul_subfr->next_prb += ul_sched->alloc.N_prb;
+        LTE_fdd_enb_user *user = NULL;
+        ul_sched               = (LTE_FDD_ENB_UL_SCHED_QUEUE_STRUCT *)cand.entry;
+        if(LTE_FDD_ENB_ERROR_NONE != user_mgr->find_user(cand.rnti, &user))
+            continue;
 
-        // Fill in the PRBs
-        for(uint32 i=0; i<ul_sched->alloc.N_prb; i++)
+        uint32 N_free_prbs = ul_subfr->N_avail_prbs - ul_subfr->N_sched_prbs;
+        uint32 N_prb_max   = N_free_prbs / N_cands_left;
+        N_cands_left--;
+
+        // An SR with nothing reported yet only needs room for a BSR
+        uint32 N_bytes = BSR_GRANT_SIZE_BYTES;
+        if(0 != cand.backlog_bytes)
+            N_bytes = cand.backlog_bytes + UL_GRANT_MAC_HDR_BYTES;
+
+        LIBLTE_PHY_ALLOCATION_STRUCT alloc;
+        memcpy(&alloc, &ul_sched->alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+        alloc.mod_type = get_modulation_type(user->get_mcs());
+        alloc.mcs      = user->get_mcs();
+        if(!size_ul_grant(user, N_bytes, N_prb_max, &alloc)                     ||
+           !scheduling_headroom(dl_subfr, ul_subfr, 0, alloc.N_prb, &alloc)     ||
+           !alloc_ul_prbs(ul_subfr, &alloc))
         {
-            ul_sched->alloc.prb[0][i] = rb_start+i;
-            ul_sched->alloc.prb[1][i] = rb_start+i;
+            if(ul_sched_policy->skip_on_no_headroom())
+                continue;
+            break;
         }
+        alloc.ndi = user->toggle_ul_ndi(ul_subfr->current_tti);
+        user->set_ul_sr_pending(false);
+        user->restart_drx_inactivity_timer(dl_subfr->current_tti);
+        user->update_ul_thru(ul_subfr->current_tti, alloc.tbs);
+        add_to_ul_harq_queue(&alloc, ul_subfr->current_tti);
 
         interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
                                   LTE_FDD_ENB_DEBUG_LEVEL_MAC,
                                   __FILE__,
                                   __LINE__,
-                                  "UL allocation sent for RNTI=%u CURRENT_TTI=%u",
-                                  ul_sched->alloc.rnti,
-                                  ul_subfr->current_tti);
+                                  "UL allocation sent for RNTI=%u CURRENT_TTI=%u (mcs=%u, tbs=%u, N_prb=%u, backlog=%u)",
+                                  alloc.rnti,
+                                  ul_subfr->current_tti,
+                                  alloc.mcs,
+                                  alloc.tbs,
+                                  alloc.N_prb,
+                                  cand.backlog_bytes);
 
         // Schedule UL decode 4 subframes from now
         if(NULL == msgq_to_ue)
         {
             memcpy(&ul_subfr->decodes.ul_alloc[ul_subfr->decodes.N_ul_alloc],
-                   &ul_sched->alloc,
+                   &alloc,
                    sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
             ul_subfr->decodes.N_ul_alloc++;
             // Schedule UL allocation
             memcpy(&dl_subfr->allocations.ul_alloc[dl_subfr->allocations.N_ul_alloc],
-                   &ul_sched->alloc,
+                   &alloc,
                    sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+            alloc_pdcch(dl_subfr, &dl_subfr->allocations.ul_alloc[dl_subfr->allocations.N_ul_alloc], true);
             dl_subfr->allocations.N_ul_alloc++;
         }else{
             LIBTOOLS_IPC_MSGQ_UL_ALLOC_MSG_STRUCT ul_alloc_msg;
-            ul_alloc_msg.size = ul_sched->alloc.tbs;
+            ul_alloc_msg.size = alloc.tbs;
             ul_alloc_msg.tti  = ul_subfr->current_tti;
-            ul_alloc_msg.rnti = ul_sched->alloc.rnti;
+            ul_alloc_msg.rnti = alloc.rnti;
             msgq_to_ue->send(LIBTOOLS_IPC_MSGQ_MESSAGE_TYPE_UL_ALLOC,
                              (LIBTOOLS_IPC_MSGQ_MESSAGE_UNION *)&ul_alloc_msg,
                              sizeof(ul_alloc_msg));
         }
-
-        // Remove UL schedule from queue
-        ul_sched_queue.pop_front();
-        delete ul_sched;
     }
 }
 void LTE_fdd_enb_mac::ul_sr_scheduler()
@@ -1452,8 +1801,9 @@ void LTE_fdd_enb_mac::ul_sr_scheduler()
     std::lock_guard<std::mutex> lock(ul_sr_sched_queue_mutex);
 
     // Schedule UL SR for the next subframe
-    LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr = &sched_ul_subfr[sched_cur_ul_subfn];
-    for(auto ul_sr : ul_sr_sched_queue)
+    LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT   *ul_subfr = &sched_ul_subfr[sched_cur_ul_subfn];
+    LTE_FDD_ENB_UL_SR_SCHED_QUEUE_STRUCT *ul_sr    = ul_sr_sched_pool.front(&ul_sr_sched_queue);
+    for(; NULL != ul_sr; ul_sr=ul_sr_sched_pool.next(&ul_sr_sched_queue, ul_sr))
     {
         uint32 sr_periodicity;
         uint32 N_offset_sr;
@@ -1468,83 +1818,530 @@ void LTE_fdd_enb_mac::ul_sr_scheduler()
         }
     }
 }
-LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_mac::add_to_rar_sched_queue(uint32                        current_tti,
-                                                               LIBLTE_PHY_ALLOCATION_STRUCT *dl_alloc,
-                                                               LIBLTE_PHY_ALLOCATION_STRUCT *ul_alloc,
-                                                               LIBLTE_MAC_RAR_STRUCT        *rar)
+void LTE_fdd_enb_mac::sps_scheduler()
 {
-    LTE_FDD_ENB_RAR_SCHED_QUEUE_STRUCT *rar_sched = NULL;
-    rar_sched = new LTE_FDD_ENB_RAR_SCHED_QUEUE_STRUCT;
-    if(NULL == rar_sched)
-        return LTE_FDD_ENB_ERROR_CANT_SCHEDULE;
+    std::lock_guard<std::mutex>         lock(sps_mutex);
+    LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr  = &sched_dl_subfr[sched_cur_dl_subfn];
+    LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr  = &sched_ul_subfr[(sched_cur_dl_subfn+4)%10];
+    LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *occ_subfr = &sched_ul_subfr[(sched_cur_dl_subfn+6)%10];
 
-    rar_sched->current_tti = current_tti;
-    memcpy(&rar_sched->dl_alloc, dl_alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
-    memcpy(&rar_sched->ul_alloc, ul_alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
-    memcpy(&rar_sched->rar, rar, sizeof(LIBLTE_MAC_RAR_STRUCT));
+    // The direct UE interface has no PHY to carry configured grants
+    if(NULL != msgq_to_ue)
+        return;
 
-    std::lock_guard<std::mutex> lock(rar_sched_queue_mutex);
-    rar_sched_queue.push_back(rar_sched);
+    // Occasions are reserved before any other scheduler touches these
+    // subframes, dynamic allocations and HARQ retransmissions go around them
+    auto iter = sps_list.begin();
+    while(iter != sps_list.end())
+    {
+        LTE_FDD_ENB_SPS_STRUCT *sps  = *iter;
+        LTE_fdd_enb_user       *user = NULL;
 
-    return LTE_FDD_ENB_ERROR_NONE;
-}
-LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_mac::add_to_dl_sched_queue(uint32                        current_tti,
-                                                              LIBLTE_MAC_PDU_STRUCT        *mac_pdu,
-                                                              LIBLTE_PHY_ALLOCATION_STRUCT *alloc)
-{
-    LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched = NULL;
-    dl_sched = new LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT;
-    if(NULL == dl_sched)
-        return LTE_FDD_ENB_ERROR_CANT_SCHEDULE;
+        if(LTE_FDD_ENB_ERROR_NONE != user_mgr->find_user(sps->c_rnti, &user) ||
+           !user->is_sps_c_rnti_set()                                        ||
+           user->get_sps_c_rnti() != sps->sps_c_rnti)
+        {
+            iter = sps_list.erase(iter);
+            delete sps;
+            continue;
+        }
+        iter++;
 
-    dl_sched->current_tti = current_tti;
-    if(mac_pdu != NULL)
-        memcpy(&dl_sched->mac_pdu, mac_pdu, sizeof(LIBLTE_MAC_PDU_STRUCT));
-    memcpy(&dl_sched->alloc, alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+        // DL occasion in this subframe
+        sps->dl_reserved = false;
+        if(LTE_FDD_ENB_SPS_STATE_ACTIVE == sps->dl_state &&
+           0 == (liblte_phy_sub_from_tti(dl_subfr->current_tti, sps->dl_tti) % sps->interval))
+        {
+            if(sps->dl_alloc.N_prb <= (dl_subfr->N_avail_prbs - dl_subfr->N_sched_prbs) &&
+               reserve_sps_prbs(dl_subfr->prb_used, &sps->dl_alloc))
+            {
+                dl_subfr->N_sched_prbs += sps->dl_alloc.N_prb;
+                sps->dl_reserved        = true;
+            }else{
+                interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                                          LTE_FDD_ENB_DEBUG_LEVEL_MAC,
+                                          __FILE__,
+                                          __LINE__,
+                                          "DL SPS occasion blocked for RNTI=%u CURRENT_TTI=%u",
+                                          sps->c_rnti,
+                                          dl_subfr->current_tti);
+            }
+        }
 
-    std::lock_guard<std::mutex> lock(dl_sched_queue_mutex);
-    for(auto scheduled_item : dl_sched_queue)
-        if(scheduled_item->alloc.rnti  == dl_sched->alloc.rnti &&
-           scheduled_item->current_tti == dl_sched->current_tti)
-            dl_sched->current_tti = liblte_phy_add_to_tti(dl_sched->current_tti, 1);
-    for(auto iter=dl_sched_queue.begin(); iter!=dl_sched_queue.end(); iter++)
-    {
-        if(liblte_phy_is_tti_in_future((*iter)->current_tti, dl_sched->current_tti))
+        // UL occasion 6 subframes from now
+        if(LTE_FDD_ENB_SPS_STATE_ACTIVE == sps->ul_state &&
+           0 == (liblte_phy_sub_from_tti(occ_subfr->current_tti, sps->ul_tti) % sps->interval))
         {
-            dl_sched_queue.insert(iter, dl_sched);
-            return LTE_FDD_ENB_ERROR_NONE;
+            if(LIBLTE_PHY_PDCCH_MAX_ALLOC > occ_subfr->decodes.N_ul_alloc                 &&
+               sps->ul_alloc.N_prb <= (occ_subfr->N_avail_prbs - occ_subfr->N_sched_prbs) &&
+               reserve_sps_prbs(occ_subfr->prb_used, &sps->ul_alloc))
+            {
+                occ_subfr->N_sched_prbs += sps->ul_alloc.N_prb;
+                memcpy(&occ_subfr->decodes.ul_alloc[occ_subfr->decodes.N_ul_alloc],
+                       &sps->ul_alloc,
+                       sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+                occ_subfr->decodes.N_ul_alloc++;
+                add_to_ul_harq_queue(&sps->ul_alloc, occ_subfr->current_tti);
+                user->update_ul_thru(occ_subfr->current_tti, sps->ul_alloc.tbs);
+            }else{
+                interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                                          LTE_FDD_ENB_DEBUG_LEVEL_MAC,
+                                          __FILE__,
+                                          __LINE__,
+                                          "UL SPS occasion blocked for RNTI=%u CURRENT_TTI=%u",
+                                          sps->c_rnti,
+                                          occ_subfr->current_tti);
+            }
         }
-    }
-    dl_sched_queue.push_back(dl_sched);
 
-    return LTE_FDD_ENB_ERROR_NONE;
-}
+        // Activate the UL grant 4 subframes from now once the UE reports a
+        // backlog small enough for it, deferring while the allocation lists
+        // are full
+        uint32 N_buffer = user->get_ul_buffer_size();
+        if(LTE_FDD_ENB_SPS_STATE_IDLE != sps->ul_state                    ||
+           0                          == N_buffer                        ||
+           LTE_FDD_ENB_SPS_MAX_SDU_BYTES < N_buffer                       ||
+           LIBLTE_PHY_PDCCH_MAX_ALLOC <= ul_subfr->decodes.N_ul_alloc     ||
+           LIBLTE_PHY_PDCCH_MAX_ALLOC <= dl_subfr->allocations.N_ul_alloc ||
+           !user->is_drx_active(dl_subfr->current_tti))
+            continue;
+        bool busy = false;
+        for(uint32 i=0; i<ul_subfr->decodes.N_ul_alloc; i++)
+            if(ul_subfr->decodes.ul_alloc[i].rnti == sps->c_rnti ||
+               ul_subfr->decodes.ul_alloc[i].rnti == sps->sps_c_rnti)
+                busy = true;
+        if(busy)
+            continue;
+
+        LIBLTE_PHY_ALLOCATION_STRUCT *alloc = &sps->ul_alloc;
+        alloc->mcs      = std::min(user->get_mcs(), (uint8)SPS_MAX_MCS);
+        alloc->mod_type = get_modulation_type(alloc->mcs);
+        if(LIBLTE_SUCCESS != liblte_phy_get_tbs_and_n_prb_for_ul((N_buffer + UL_GRANT_MAC_HDR_BYTES)*8,
+                                                                 std::min(ul_subfr->N_avail_prbs - ul_subfr->N_sched_prbs,
+                                                                          interface->get_n_rb_ul() - 1),
+                                                                 alloc->mcs,
+                                                                 &alloc->tbs,
+                                                                 &alloc->N_prb) ||
+           !scheduling_headroom(dl_subfr, ul_subfr, 0, alloc->N_prb, alloc)      ||
+           !alloc_sps_prbs(ul_subfr->prb_used, interface->get_n_rb_ul(), alloc))
+            continue;
+        ul_subfr->N_sched_prbs += alloc->N_prb;
+        memcpy(&ul_subfr->decodes.ul_alloc[ul_subfr->decodes.N_ul_alloc],
+               alloc,
+               sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+        ul_subfr->decodes.N_ul_alloc++;
+        memcpy(&dl_subfr->allocations.ul_alloc[dl_subfr->allocations.N_ul_alloc],
+               alloc,
+               sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+        alloc_pdcch(dl_subfr, &dl_subfr->allocations.ul_alloc[dl_subfr->allocations.N_ul_alloc], true);
+        dl_subfr->allocations.N_ul_alloc++;
+        add_to_ul_harq_queue(alloc, ul_subfr->current_tti);
+        user->update_ul_thru(ul_subfr->current_tti, alloc->tbs);
+        sps->ul_state   = LTE_FDD_ENB_SPS_STATE_ACTIVE;
+        sps->ul_tti     = ul_subfr->current_tti;
+        sps->N_ul_empty = 0;
+
+        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                                  LTE_FDD_ENB_DEBUG_LEVEL_MAC,
+                                  __FILE__,
+                                  __LINE__,
+                                  "UL SPS activated for RNTI=%u SPS-RNTI=%u CURRENT_TTI=%u (mcs=%u, tbs=%u, N_prb=%u, interval=%u)",
+                                  sps->c_rnti,
+                                  sps->sps_c_rnti,
+                                  ul_subfr->current_tti,
+                                  alloc->mcs,
+                                  alloc->tbs,
+                                  alloc->N_prb,
+                                  sps->interval);
+    }
+}
+void LTE_fdd_enb_mac::sps_dl_scheduler()
+{
+    std::lock_guard<std::mutex>         lock(sps_mutex);
+    LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr = &sched_dl_subfr[sched_cur_dl_subfn];
+
+    if(NULL != msgq_to_ue)
+        return;
+
+    uint32 n_1_p_pucch;
+    sys_info_mutex.lock();
+    n_1_p_pucch = sys_info.sib2.radioResourceConfigCommon_Get().pucch_ConfigCommon_Get().n1PUCCH_AN_Value();
+    sys_info_mutex.unlock();
+
+    // Activations and releases carry a DCI, so they go ahead of the
+    // configured assignments which the PHY sends without one
+    for(auto sps : sps_list)
+    {
+        LTE_fdd_enb_user *user = NULL;
+        LTE_fdd_enb_rb   *rb   = NULL;
+        if(LTE_FDD_ENB_ERROR_NONE != user_mgr->find_user(sps->c_rnti, &user) ||
+           !user->is_drx_active(dl_subfr->current_tti)                       ||
+           !scheduling_headroom(dl_subfr, NULL, 0, 0, &sps->dl_alloc))
+            continue;
+
+        if(LTE_FDD_ENB_SPS_STATE_RELEASE == sps->dl_state)
+        {
+            // 36.213 table 9.2-1A, the assignment fields are all ones
+            LIBLTE_PHY_ALLOCATION_STRUCT *alloc = &dl_subfr->allocations.dl_alloc[dl_subfr->allocations.N_dl_alloc];
+            memcpy(alloc, &sps->dl_alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+            alloc->N_prb        = 0;
+            alloc->tbs          = 0;
+            alloc->mcs          = 31;
+            alloc->harq_process = 0;
+            alloc->rv_idx       = 0;
+            alloc->ndi          = 0;
+            alloc_pdcch(dl_subfr, alloc, true);
+            dl_subfr->allocations.N_dl_alloc++;
+            sps->dl_state       = LTE_FDD_ENB_SPS_STATE_IDLE;
+
+            interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                                      LTE_FDD_ENB_DEBUG_LEVEL_MAC,
+                                      __FILE__,
+                                      __LINE__,
+                                      "DL SPS released for RNTI=%u SPS-RNTI=%u CURRENT_TTI=%u",
+                                      sps->c_rnti,
+                                      sps->sps_c_rnti,
+                                      dl_subfr->current_tti);
+            continue;
+        }
+
+        if(LTE_FDD_ENB_SPS_STATE_IDLE != sps->dl_state ||
+           LTE_FDD_ENB_ERROR_NONE     != user->get_drb(sps->rb_id, &rb))
+            continue;
+        uint32 N_bytes = rb->get_mac_sdu_queue_bytes() + rb->rlc_get_tx_sdu_queue_bytes();
+        if(0 == N_bytes || LTE_FDD_ENB_SPS_MAX_SDU_BYTES < N_bytes)
+            continue;
+
+        // A UE only takes one PDSCH per subframe
+        bool busy = false;
+        for(uint32 i=0; i<dl_subfr->allocations.N_dl_alloc; i++)
+            if(dl_subfr->allocations.dl_alloc[i].rnti == sps->c_rnti ||
+               dl_subfr->allocations.dl_alloc[i].rnti == sps->sps_c_rnti)
+                busy = true;
+        if(busy)
+            continue;
+
+        // Size the assignment to the current backlog, every occasion reuses it
+        LIBLTE_PHY_ALLOCATION_STRUCT *alloc = &sps->dl_alloc;
+        alloc->mcs      = std::min(user->get_mcs(), (uint8)SPS_MAX_MCS);
+        alloc->mod_type = get_modulation_type(alloc->mcs);
+        alloc->tbs      = 0;
+        alloc->N_prb    = 0;
+        liblte_phy_get_tbs_and_n_prb_for_dl((N_bytes + SPS_DL_HDR_BYTES)*8,
+                                            dl_subfr->N_avail_prbs - dl_subfr->N_sched_prbs,
+                                            alloc->mcs,
+                                            &alloc->tbs,
+                                            &alloc->N_prb);
+        if(0 == alloc->N_prb ||
+           !alloc_sps_prbs(dl_subfr->prb_used, interface->get_n_rb_dl(), alloc))
+            continue;
+        dl_subfr->N_sched_prbs += alloc->N_prb;
+
+        LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched = dl_sched_pool.alloc();
+        if(NULL != dl_sched)
+        {
+            memcpy(&dl_sched->alloc, alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+            dl_sched->current_tti = dl_subfr->current_tti;
+            dl_sched->mux         = false;
+        }
+        if(NULL == dl_sched || !build_sps_dl_pdu(user, rb, dl_sched))
+        {
+            for(uint32 i=0; i<alloc->N_prb; i++)
+                dl_subfr->prb_used[alloc->prb[0][i]] = false;
+            dl_subfr->N_sched_prbs -= alloc->N_prb;
+            if(NULL != dl_sched)
+                dl_sched_pool.free(dl_sched);
+            continue;
+        }
+        send_dl_alloc(dl_subfr, dl_sched, n_1_p_pucch);
+        alloc_pdcch(dl_subfr, &dl_subfr->allocations.dl_alloc[dl_subfr->allocations.N_dl_alloc-1], true);
+        dl_sched_pool.free(dl_sched);
+        sps->dl_state   = LTE_FDD_ENB_SPS_STATE_ACTIVE;
+        sps->dl_tti     = dl_subfr->current_tti;
+        sps->N_dl_empty = 0;
+
+        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                                  LTE_FDD_ENB_DEBUG_LEVEL_MAC,
+                                  __FILE__,
+                                  __LINE__,
+                                  "DL SPS activated for RNTI=%u SPS-RNTI=%u CURRENT_TTI=%u (mcs=%u, tbs=%u, N_prb=%u, interval=%u)",
+                                  sps->c_rnti,
+                                  sps->sps_c_rnti,
+                                  dl_subfr->current_tti,
+                                  alloc->mcs,
+                                  alloc->tbs,
+                                  alloc->N_prb,
+                                  sps->interval);
+    }
+
+    // Configured assignments, counted so the PHY leaves them off the PDCCH
+    for(auto sps : sps_list)
+    {
+        LTE_fdd_enb_user *user = NULL;
+        LTE_fdd_enb_rb   *rb   = NULL;
+        if(!sps->dl_reserved                                                  ||
+           LTE_FDD_ENB_ERROR_NONE != user_mgr->find_user(sps->c_rnti, &user) ||
+           LTE_FDD_ENB_ERROR_NONE != user->get_drb(sps->rb_id, &rb))
+            continue;
+
+        LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched = dl_sched_pool.alloc();
+        if(NULL == dl_sched)
+            continue;
+        memcpy(&dl_sched->alloc, &sps->dl_alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+        dl_sched->current_tti = dl_subfr->current_tti;
+        dl_sched->mux         = false;
+        if(!build_sps_dl_pdu(user, rb, dl_sched))
+        {
+            // Stop holding PRBs for a flow that went quiet
+            dl_sched_pool.free(dl_sched);
+            sps->N_dl_empty++;
+            if(LTE_FDD_ENB_SPS_DL_RELEASE_N_EMPTY <= sps->N_dl_empty)
+                sps->dl_state = LTE_FDD_ENB_SPS_STATE_RELEASE;
+            continue;
+        }
+        send_dl_alloc(dl_subfr, dl_sched, sps->n_1_p_pucch_an);
+        dl_subfr->N_sps_dl_alloc++;
+        sps->N_dl_empty = 0;
+        dl_sched_pool.free(dl_sched);
+    }
+}
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_mac::add_to_rar_sched_queue(uint32                        current_tti,
+                                                               LIBLTE_PHY_ALLOCATION_STRUCT *dl_alloc,
+                                                               LIBLTE_PHY_ALLOCATION_STRUCT *ul_alloc,
+                                                               LIBLTE_MAC_RAR_STRUCT        *rar)
+{
+    LTE_FDD_ENB_RAR_SCHED_QUEUE_STRUCT *rar_sched = NULL;
+    rar_sched = rar_sched_pool.alloc();
+    if(NULL == rar_sched)
+        return LTE_FDD_ENB_ERROR_CANT_SCHEDULE;
+
+    rar_sched->current_tti = current_tti;
+    memcpy(&rar_sched->dl_alloc, dl_alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+    memcpy(&rar_sched->ul_alloc, ul_alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+    memcpy(&rar_sched->rar, rar, sizeof(LIBLTE_MAC_RAR_STRUCT));
+
+    std::lock_guard<std::mutex> lock(sched_intake_mutex);
+    rar_sched_pool.push_back(&rar_intake, rar_sched);
+
+    return LTE_FDD_ENB_ERROR_NONE;
+}
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_mac::add_to_dl_sched_queue(uint32                        current_tti,
+                                                              LIBLTE_MAC_PDU_STRUCT        *mac_pdu,
+                                                              LIBLTE_PHY_ALLOCATION_STRUCT *alloc)
+{
+    LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched = NULL;
+    dl_sched = dl_sched_pool.alloc();
+    if(NULL == dl_sched)
+        return LTE_FDD_ENB_ERROR_CANT_SCHEDULE;
+
+    dl_sched->current_tti = current_tti;
+    dl_sched->mux         = false;
+    if(mac_pdu != NULL)
+        memcpy(&dl_sched->mac_pdu, mac_pdu, sizeof(LIBLTE_MAC_PDU_STRUCT));
+    memcpy(&dl_sched->alloc, alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+
+    std::lock_guard<std::mutex> lock(sched_intake_mutex);
+    dl_sched_pool.push_back(&dl_intake, dl_sched);
+
+    return LTE_FDD_ENB_ERROR_NONE;
+}
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_mac::add_to_dl_mux_queue(uint32                        current_tti,
+                                                            LIBLTE_PHY_ALLOCATION_STRUCT *alloc)
+{
+    std::lock_guard<std::mutex> lock(sched_intake_mutex);
+
+    // The pending entry picks up the new SDU when it is scheduled
+    if(dl_mux_pending[alloc->rnti])
+        return LTE_FDD_ENB_ERROR_NONE;
+
+    LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched = NULL;
+    dl_sched = dl_sched_pool.alloc();
+    if(NULL == dl_sched)
+        return LTE_FDD_ENB_ERROR_CANT_SCHEDULE;
+
+    dl_sched->current_tti          = current_tti;
+    dl_sched->mux                  = true;
+    dl_sched->mac_pdu.N_subheaders = 0;
+    memcpy(&dl_sched->alloc, alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+    dl_mux_pending[alloc->rnti] = true;
+    dl_sched_pool.push_back(&dl_intake, dl_sched);
+
+    return LTE_FDD_ENB_ERROR_NONE;
+}
 LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_mac::add_to_ul_sched_queue(uint32                        current_tti,
                                                               LIBLTE_PHY_ALLOCATION_STRUCT *alloc)
 {
+    std::lock_guard<std::mutex> lock(sched_intake_mutex);
+
+    // The pending entry picks up the new buffer state when it is scheduled
+    if(ul_sched_pending[alloc->rnti])
+        return LTE_FDD_ENB_ERROR_NONE;
+
     LTE_FDD_ENB_UL_SCHED_QUEUE_STRUCT *ul_sched = NULL;
-    ul_sched = new LTE_FDD_ENB_UL_SCHED_QUEUE_STRUCT;
+    ul_sched = ul_sched_pool.alloc();
     if(NULL == ul_sched)
         return LTE_FDD_ENB_ERROR_CANT_SCHEDULE;
 
     ul_sched->current_tti = current_tti;
     memcpy(&ul_sched->alloc, alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+    ul_sched_pending[alloc->rnti] = true;
+    ul_sched_pool.push_back(&ul_intake, ul_sched);
 
-    std::lock_guard<std::mutex> lock(ul_sched_queue_mutex);
-    bool sched = true;
-    for(auto ul_sq : ul_sched_queue)
-        if(ul_sq->alloc.rnti == alloc->rnti && ul_sq->current_tti == ul_sched->current_tti)
-            sched = false;
-    if(!sched)
-        return LTE_FDD_ENB_ERROR_CANT_SCHEDULE;
-
-    ul_sched_queue.push_back(ul_sched);
     return LTE_FDD_ENB_ERROR_NONE;
 }
+void LTE_fdd_enb_mac::add_to_ul_harq_queue(LIBLTE_PHY_ALLOCATION_STRUCT *alloc,
+                                           uint32                        current_tti)
+{
+    LTE_FDD_ENB_UL_HARQ_STRUCT *harq = NULL;
+    harq = ul_harq_pool.alloc();
+    if(NULL == harq)
+        return;
+
+    memcpy(&harq->alloc, alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+    harq->current_tti   = current_tti;
+    harq->N_tx          = 1;
+    harq->retx_reserved = false;
+
+    std::lock_guard<std::mutex> lock(ul_harq_mutex);
+    ul_harq_pool.push_back(&ul_harq_queue, harq);
+    ul_harq_pool.push_back(&ul_harq_ue_queue[harq->alloc.rnti], harq);
+}
+void LTE_fdd_enb_mac::clear_ul_harq(uint16 rnti,
+                                    uint32 current_tti)
+{
+    std::lock_guard<std::mutex>    lock(ul_harq_mutex);
+    LTE_FDD_ENB_SCHED_LIST_STRUCT *ue_queue = &ul_harq_ue_queue[rnti];
+
+    // PDUs from the direct UE interface carry no PUSCH TTI, so they
+    // acknowledge the oldest grant
+    LTE_FDD_ENB_UL_HARQ_STRUCT *harq = ul_harq_pool.front(ue_queue);
+    while(NULL != harq && harq->current_tti != current_tti)
+        harq = ul_harq_pool.next(ue_queue, harq);
+    if(NULL == harq && NULL != msgq_to_ue)
+        harq = ul_harq_pool.front(ue_queue);
+    if(NULL == harq)
+        return;
+
+    // Drop the decode of the retransmission that will not come, its
+    // PRBs were already passed over by the UL scheduler
+    if(harq->retx_reserved)
+    {
+        uint32                              retx_tti = liblte_phy_add_to_tti(harq->current_tti, 8);
+        LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr = &sched_ul_subfr[retx_tti%10];
+        if(ul_subfr->current_tti == retx_tti)
+        {
+            for(uint32 i=0; i<ul_subfr->decodes.N_ul_alloc; i++)
+            {
+                if(ul_subfr->decodes.ul_alloc[i].rnti == rnti)
+                {
+                    for(uint32 j=i+1; j<ul_subfr->decodes.N_ul_alloc; j++)
+                        memcpy(&ul_subfr->decodes.ul_alloc[j-1],
+                               &ul_subfr->decodes.ul_alloc[j],
+                               sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+                    ul_subfr->decodes.N_ul_alloc--;
+                    break;
+                }
+            }
+        }
+    }
+
+    free_ul_harq(harq);
+}
+uint32 LTE_fdd_enb_mac::get_ul_bytes_in_flight(uint16 rnti)
+{
+    std::lock_guard<std::mutex>    lock(ul_harq_mutex);
+    LTE_FDD_ENB_SCHED_LIST_STRUCT *ue_queue = &ul_harq_ue_queue[rnti];
+    LTE_FDD_ENB_UL_HARQ_STRUCT    *harq     = ul_harq_pool.front(ue_queue);
+    uint32                         N_bytes  = 0;
+    for(; NULL != harq; harq=ul_harq_pool.next(ue_queue, harq))
+        N_bytes += harq->alloc.tbs/8;
+    return N_bytes;
+}
+void LTE_fdd_enb_mac::drain_sched_intake()
+{
+    LTE_FDD_ENB_SCHED_LIST_STRUCT      dl_new;
+    LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched = NULL;
+
+    // One short critical section per TTI, the schedulers own everything
+    // past the intake lists
+    LTE_fdd_enb_dl_sched_pool::init_list(&dl_new, LTE_FDD_ENB_SCHED_LINK_QUEUE);
+    sched_intake_mutex.lock();
+    rar_sched_pool.splice_back(&rar_sched_queue, &rar_intake);
+    dl_sched_pool.splice_back(&dl_new, &dl_intake);
+    ul_sched_pool.splice_back(&ul_sched_queue, &ul_intake);
+    sched_intake_mutex.unlock();
+
+    while(NULL != (dl_sched = dl_sched_pool.front(&dl_new)))
+    {
+        dl_sched_pool.remove(&dl_new, dl_sched);
+        insert_into_dl_sched_queue(dl_sched);
+    }
+
+    // Everything filed up to the current TTI is now due
+    uint32 current_tti = sched_dl_subfr[sched_cur_dl_subfn].current_tti;
+    while(!liblte_phy_is_tti_in_future(dl_ring_tti, current_tti))
+    {
+        dl_sched_pool.splice_back(&dl_sched_queue, &dl_tti_ring[dl_ring_tti]);
+        dl_ring_tti = liblte_phy_add_to_tti(dl_ring_tti, 1);
+    }
+}
+void LTE_fdd_enb_mac::free_dl_sched(LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched)
+{
+    // The next SDU for this UE needs a new multiplexed entry
+    if(dl_sched->mux)
+    {
+        std::lock_guard<std::mutex> lock(sched_intake_mutex);
+        dl_mux_pending[dl_sched->alloc.rnti] = false;
+    }
+    dl_sched_pool.free(dl_sched);
+}
+void LTE_fdd_enb_mac::free_ul_sched(LTE_FDD_ENB_UL_SCHED_QUEUE_STRUCT *ul_sched)
+{
+    sched_intake_mutex.lock();
+    ul_sched_pending[ul_sched->alloc.rnti] = false;
+    sched_intake_mutex.unlock();
+    ul_sched_pool.free(ul_sched);
+}
+void LTE_fdd_enb_mac::free_ul_harq(LTE_FDD_ENB_UL_HARQ_STRUCT *harq)
+{
+    ul_harq_pool.remove(&ul_harq_queue, harq);
+    ul_harq_pool.remove(&ul_harq_ue_queue[harq->alloc.rnti], harq);
+    ul_harq_pool.free(harq);
+}
 
 /*****************/
 /*    Helpers    */
 /*****************/
+void LTE_fdd_enb_mac::insert_into_dl_sched_queue(LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched)
+{
+    // Late schedules are due right away, keep the queue in TTI order
+    if(liblte_phy_is_tti_in_past(dl_sched->current_tti, dl_ring_tti))
+    {
+        LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *pos = dl_sched_pool.back(&dl_sched_queue);
+        while(NULL != pos && liblte_phy_is_tti_in_future(pos->current_tti, dl_sched->current_tti))
+            pos = dl_sched_pool.prev(&dl_sched_queue, pos);
+        if(NULL == pos)
+            dl_sched_pool.insert_before(&dl_sched_queue, dl_sched_pool.front(&dl_sched_queue), dl_sched);
+        else
+            dl_sched_pool.insert_before(&dl_sched_queue, dl_sched_pool.next(&dl_sched_queue, pos), dl_sched);
+        return;
+    }
+
+    // One PDSCH per UE per subframe, so later PDUs move to the next TTI
+    bool taken = true;
+    while(taken)
+    {
+        LTE_FDD_ENB_SCHED_LIST_STRUCT     *slot = &dl_tti_ring[dl_sched->current_tti];
+        LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *item = dl_sched_pool.front(slot);
+        taken = false;
+        for(; NULL != item && !taken; item=dl_sched_pool.next(slot, item))
+            if(item->alloc.rnti == dl_sched->alloc.rnti)
+                taken = true;
+        if(taken)
+            dl_sched->current_tti = liblte_phy_add_to_tti(dl_sched->current_tti, 1);
+    }
+    dl_sched_pool.push_back(&dl_tti_ring[dl_sched->current_tti], dl_sched);
+}
 void LTE_fdd_enb_mac::advance_tti_and_clear_subframe()
 {
     // Advance the TTI
@@ -1556,11 +2353,15 @@ void LTE_fdd_enb_mac::advance_tti_and_clear_subframe()
     sched_dl_subfr[sched_cur_dl_subfn].allocations.N_ul_alloc = 0;
     sched_dl_subfr[sched_cur_dl_subfn].N_avail_prbs           = interface->get_n_rb_dl() - get_n_reserved_prbs(sched_dl_subfr[sched_cur_dl_subfn].current_tti);
     sched_dl_subfr[sched_cur_dl_subfn].N_sched_prbs           = 0;
-    sched_dl_subfr[sched_cur_dl_subfn].next_prb               = 0;
+    sched_dl_subfr[sched_cur_dl_subfn].N_sps_dl_alloc         = 0;
+    for(uint32 i=0; i<LIBLTE_PHY_N_RB_DL_MAX; i++)
+        sched_dl_subfr[sched_cur_dl_subfn].prb_used[i] = false;
+    clear_pdcch_map(&sched_dl_subfr[sched_cur_dl_subfn].pdcch_map);
     sched_ul_subfr[sched_cur_ul_subfn].decodes.N_ul_alloc     = 0;
     sched_ul_subfr[sched_cur_ul_subfn].N_sched_prbs           = 0;
     sched_ul_subfr[sched_cur_ul_subfn].N_pucch                = 0;
-    sched_ul_subfr[sched_cur_ul_subfn].next_prb               = 0;
+    for(uint32 i=0; i<LIBLTE_PHY_N_RB_UL_MAX; i++)
+        sched_ul_subfr[sched_cur_ul_subfn].prb_used[i] = false;
 
     // Advance the subframe numbers
     sched_cur_dl_subfn = (sched_cur_dl_subfn + 1) % 10;
@@ -1590,13 +2391,20 @@ uint32 LTE_fdd_enb_mac::get_n_reserved_prbs(uint32 current_tti)
 bool LTE_fdd_enb_mac::scheduling_headroom(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr,
                                           LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr,
                                           uint32                              N_dl_prbs,
-                                          uint32                              N_ul_prbs)
+                                          uint32                              N_ul_prbs,
+                                          LIBLTE_PHY_ALLOCATION_STRUCT       *dci_alloc)
 {
-    uint32 N_cce = phy->get_n_cce();
-    int32  N_avail_dcis = N_cce - (dl_subfr->allocations.N_dl_alloc +
-                                   dl_subfr->allocations.N_ul_alloc);
+    // DL and UL allocations each have their own list in the PHY schedule
+    uint32 N_alloc = dl_subfr->allocations.N_dl_alloc;
+    if(LIBLTE_PHY_CHAN_TYPE_ULSCH == dci_alloc->chan_type)
+        N_alloc = dl_subfr->allocations.N_ul_alloc;
+    if(LIBLTE_PHY_PDCCH_MAX_ALLOC <= N_alloc)
+        return false;
+    if(NULL != ul_subfr && 0 != N_ul_prbs &&
+       LIBLTE_PHY_PDCCH_MAX_ALLOC <= ul_subfr->decodes.N_ul_alloc)
+        return false;
 
-    if(N_avail_dcis == 0)
+    if(!alloc_pdcch(dl_subfr, dci_alloc, false))
         return false;
 
     int32 N_avail_dl_prbs = dl_subfr->N_avail_prbs - dl_subfr->N_sched_prbs;
@@ -1612,6 +2420,808 @@ bool LTE_fdd_enb_mac::scheduling_headroom(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl
 
     return true;
 }
+void LTE_fdd_enb_mac::clear_pdcch_map(LTE_FDD_ENB_PDCCH_MAP_STRUCT *map)
+{
+    map->N_dci = 0;
+    map->N_cce = 0;
+    for(uint32 i=0; i<LIBLTE_PHY_PDCCH_N_CCE_MAX; i++)
+        map->cce_used[i] = false;
+}
+bool LTE_fdd_enb_mac::alloc_pdcch(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr,
+                                  LIBLTE_PHY_ALLOCATION_STRUCT       *alloc,
+                                  bool                                commit)
+{
+    LTE_FDD_ENB_PDCCH_MAP_STRUCT     *map = &dl_subfr->pdcch_map;
+    LTE_FDD_ENB_DCI_PLACEMENT_STRUCT  dci;
+    LTE_fdd_enb_user                 *user = NULL;
+
+    // Read the control region size once per subframe
+    if(0 == map->N_dci)
+        map->N_cce = std::min(phy->get_n_cce(), (uint32)LIBLTE_PHY_PDCCH_N_CCE_MAX);
+
+    // Broadcast and random access DCIs only live in the common search
+    // space, DCI 0 may fall back to it while DL assignments stay in the
+    // UE specific one so DCI 1 and 1A are interchangeable once PRBs are
+    // picked
+    dci.ul        = (LIBLTE_PHY_CHAN_TYPE_ULSCH == alloc->chan_type);
+    dci.alloc_idx = 0;
+    if(LIBLTE_MAC_SI_RNTI        == alloc->rnti ||
+       LIBLTE_MAC_P_RNTI         == alloc->rnti ||
+       (LIBLTE_MAC_RA_RNTI_START <= alloc->rnti &&
+        LIBLTE_MAC_RA_RNTI_END   >= alloc->rnti))
+    {
+        dci.c_rnti    = 0;
+        dci.common    = true;
+        dci.N_cce_agg = 4;
+    }else{
+        // SPS C-RNTI DCIs are hashed with the UE's C-RNTI
+        dci.c_rnti    = alloc->rnti;
+        dci.common    = dci.ul;
+        dci.N_cce_agg = 4;
+        if(LTE_FDD_ENB_ERROR_NONE == user_mgr->find_user(alloc->rnti, &user))
+        {
+            dci.c_rnti = user->get_c_rnti();
+            if(user->is_dl_cqi_set())
+                dci.N_cce_agg = CQI_TO_N_CCE_AGG[user->get_dl_cqi() & 0x0F];
+        }
+    }
+
+    if(!commit)
+    {
+        LTE_FDD_ENB_PDCCH_MAP_STRUCT trial = *map;
+        return place_dci(&trial, dl_subfr->current_tti % 10, &dci);
+    }
+
+    // The allocation has already been added to the schedule
+    if(dci.ul)
+        dci.alloc_idx = alloc - dl_subfr->allocations.ul_alloc;
+    else
+        dci.alloc_idx = alloc - dl_subfr->allocations.dl_alloc;
+    if(!place_dci(map, dl_subfr->current_tti % 10, &dci))
+    {
+        alloc->N_cce_agg = 0;
+        return false;
+    }
+
+    // Placing the DCI may have moved others
+    for(uint32 i=0; i<map->N_dci; i++)
+    {
+        LIBLTE_PHY_ALLOCATION_STRUCT *placed = &dl_subfr->allocations.dl_alloc[map->dci[i].alloc_idx];
+        if(map->dci[i].ul)
+            placed = &dl_subfr->allocations.ul_alloc[map->dci[i].alloc_idx];
+        placed->N_cce_agg = map->dci[i].N_cce_agg;
+        placed->cce_idx   = map->dci[i].cce_idx;
+    }
+    return true;
+}
+bool LTE_fdd_enb_mac::place_dci(LTE_FDD_ENB_PDCCH_MAP_STRUCT     *map,
+                                uint32                            subfr_num,
+                                LTE_FDD_ENB_DCI_PLACEMENT_STRUCT *dci)
+{
+    uint32 cce_idx[2*LIBLTE_PHY_PDCCH_N_CANDIDATES_MAX];
+    uint32 N_same = 0;
+
+    // The map holds both directions, each limited by its allocation list
+    for(uint32 i=0; i<map->N_dci; i++)
+        if(map->dci[i].ul == dci->ul)
+            N_same++;
+    if(LIBLTE_PHY_PDCCH_MAX_ALLOC <= N_same)
+        return false;
+
+    // Fall back to more robust aggregation levels when the preferred one
+    // is blocked
+    for(uint32 N_cce_agg=dci->N_cce_agg; N_cce_agg<=8; N_cce_agg*=2)
+    {
+        uint32 N_cand = get_dci_candidates(map, subfr_num, dci, N_cce_agg, cce_idx);
+        int32  found  = -1;
+        for(uint32 i=0; i<N_cand && -1 == found; i++)
+            if(cces_free(map, cce_idx[i], N_cce_agg))
+                found = i;
+        for(uint32 i=0; i<N_cand && -1 == found; i++)
+            if(move_dcis_off_cces(map, subfr_num, cce_idx[i], N_cce_agg))
+                found = i;
+        if(-1 == found)
+            continue;
+
+        dci->N_cce_agg = N_cce_agg;
+        dci->cce_idx   = cce_idx[found];
+        mark_cces(map, dci->cce_idx, dci->N_cce_agg, true);
+        map->dci[map->N_dci++] = *dci;
+        return true;
+    }
+    return false;
+}
+bool LTE_fdd_enb_mac::move_dcis_off_cces(LTE_FDD_ENB_PDCCH_MAP_STRUCT *map,
+                                         uint32                        subfr_num,
+                                         uint32                        cce_idx,
+                                         uint32                        N_cce_agg)
+{
+    LTE_FDD_ENB_PDCCH_MAP_STRUCT trial = *map;
+    bool                         moved[2*LIBLTE_PHY_PDCCH_MAX_ALLOC];
+    uint32                       cand[2*LIBLTE_PHY_PDCCH_N_CANDIDATES_MAX];
+
+    // Lift every DCI overlapping the target off the PDCCH and hold the
+    // target, then give each of them another of its own candidates
+    for(uint32 i=0; i<trial.N_dci; i++)
+    {
+        LTE_FDD_ENB_DCI_PLACEMENT_STRUCT *dci = &trial.dci[i];
+        moved[i] = (dci->cce_idx < (cce_idx + N_cce_agg) &&
+                    cce_idx      < (dci->cce_idx + dci->N_cce_agg));
+        if(moved[i])
+            mark_cces(&trial, dci->cce_idx, dci->N_cce_agg, false);
+    }
+    mark_cces(&trial, cce_idx, N_cce_agg, true);
+    for(uint32 i=0; i<trial.N_dci; i++)
+    {
+        if(!moved[i])
+            continue;
+        LTE_FDD_ENB_DCI_PLACEMENT_STRUCT *dci    = &trial.dci[i];
+        uint32                            N_cand = get_dci_candidates(&trial, subfr_num, dci, dci->N_cce_agg, cand);
+        bool                              placed = false;
+        for(uint32 j=0; j<N_cand && !placed; j++)
+        {
+            if(cces_free(&trial, cand[j], dci->N_cce_agg))
+            {
+                dci->cce_idx = cand[j];
+                mark_cces(&trial, dci->cce_idx, dci->N_cce_agg, true);
+                placed = true;
+            }
+        }
+        if(!placed)
+            return false;
+    }
+
+    // The caller takes the target
+    mark_cces(&trial, cce_idx, N_cce_agg, false);
+    *map = trial;
+    return true;
+}
+uint32 LTE_fdd_enb_mac::get_dci_candidates(LTE_FDD_ENB_PDCCH_MAP_STRUCT     *map,
+                                           uint32                            subfr_num,
+                                           LTE_FDD_ENB_DCI_PLACEMENT_STRUCT *dci,
+                                           uint32                            N_cce_agg,
+                                           uint32                           *cce_idx)
+{
+    uint32 N_uss = 0;
+    uint32 N_css = 0;
+
+    if(0 != dci->c_rnti)
+        liblte_phy_get_pdcch_candidates(dci->c_rnti,
+                                        subfr_num,
+                                        map->N_cce,
+                                        N_cce_agg,
+                                        false,
+                                        cce_idx,
+                                        &N_uss);
+    if(dci->common && 4 <= N_cce_agg)
+        liblte_phy_get_pdcch_candidates(0,
+                                        subfr_num,
+                                        map->N_cce,
+                                        N_cce_agg,
+                                        true,
+                                        &cce_idx[N_uss],
+                                        &N_css);
+
+    return N_uss + N_css;
+}
+bool LTE_fdd_enb_mac::cces_free(LTE_FDD_ENB_PDCCH_MAP_STRUCT *map,
+                                uint32                        cce_idx,
+                                uint32                        N_cce_agg)
+{
+    for(uint32 i=0; i<N_cce_agg; i++)
+        if(map->cce_used[cce_idx+i])
+            return false;
+    return true;
+}
+void LTE_fdd_enb_mac::mark_cces(LTE_FDD_ENB_PDCCH_MAP_STRUCT *map,
+                                uint32                        cce_idx,
+                                uint32                        N_cce_agg,
+                                bool                          used)
+{
+    for(uint32 i=0; i<N_cce_agg; i++)
+        map->cce_used[cce_idx+i] = used;
+}
+bool LTE_fdd_enb_mac::schedule_dl_alloc(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr,
+                                        LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT  *dl_sched)
+{
+    if(dl_sched->alloc.rnti != LIBLTE_MAC_SI_RNTI)
+    {
+        // Pack the message and determine TBS
+        liblte_mac_pack_mac_pdu(&dl_sched->mac_pdu,
+                                &dl_sched->alloc.msg[0]);
+        dl_sched->alloc.tbs   = 0;
+        dl_sched->alloc.N_prb = 0;
+        liblte_phy_get_tbs_and_n_prb_for_dl(dl_sched->alloc.msg[0].N_bits,
+                                            dl_subfr->N_avail_prbs - dl_subfr->N_sched_prbs,
+                                            dl_sched->alloc.mcs,
+                                            &dl_sched->alloc.tbs,
+                                            &dl_sched->alloc.N_prb);
+
+        // Leave the PDU untouched if it does not fit, it may be retried later
+        uint32 N_prb = dl_sched->alloc.N_prb;
+        if(0 == N_prb ||
+           !scheduling_headroom(dl_subfr, NULL, N_prb, 0, &dl_sched->alloc) ||
+           !alloc_dl_prbs(dl_subfr, &dl_sched->alloc, true))
+            return false;
+
+        // Whole RBGs may carry a larger transport block
+        if(N_prb != dl_sched->alloc.N_prb)
+            liblte_phy_get_tbs_for_dl(dl_sched->alloc.mcs,
+                                      dl_sched->alloc.N_prb,
+                                      &dl_sched->alloc.tbs);
+
+        pad_dl_mac_pdu(dl_sched);
+    }else if(!scheduling_headroom(dl_subfr, NULL, dl_sched->alloc.N_prb, 0, &dl_sched->alloc) ||
+             !alloc_dl_prbs(dl_subfr, &dl_sched->alloc, false)){
+        return false;
+    }
+
+    // ACK/NACK for a PDCCH assignment uses the common PUCCH resource
+    uint32 n_1_p_pucch;
+    sys_info_mutex.lock();
+    n_1_p_pucch = sys_info.sib2.radioResourceConfigCommon_Get().pucch_ConfigCommon_Get().n1PUCCH_AN_Value();
+    sys_info_mutex.unlock();
+    send_dl_alloc(dl_subfr, dl_sched, n_1_p_pucch);
+    if(NULL == msgq_to_ue)
+        alloc_pdcch(dl_subfr, &dl_subfr->allocations.dl_alloc[dl_subfr->allocations.N_dl_alloc-1], true);
+
+    return true;
+}
+bool LTE_fdd_enb_mac::schedule_dl_mux(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr,
+                                      LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT  *dl_sched,
+                                      LTE_fdd_enb_user                   *user)
+{
+    LTE_fdd_enb_rb *rb[LTE_FDD_ENB_RB_N_ITEMS];
+    bool            pulled[LIBLTE_MAC_MAX_MAC_PDU_N_SUBHEADERS] = {false};
+    uint32          N_taken[LTE_FDD_ENB_RB_N_ITEMS] = {0};
+    uint32          N_step1[LTE_FDD_ENB_RB_N_ITEMS] = {0};
+    uint32          N_rbs                           = get_dl_mux_rbs(user, rb);
+    uint32          N_pulled                        = 0;
+    int32           N_avail_prbs                    = dl_subfr->N_avail_prbs - dl_subfr->N_sched_prbs;
+    uint32          tbs                             = 0;
+
+    // Size the grant to everything left in this subframe, the PDU is
+    // shrunk to the smallest fitting TBS when it is packed.  RLC PDUs are
+    // built destructively, so don't ask for any without a free DCI.
+    if(0 >= N_avail_prbs                                            ||
+       !scheduling_headroom(dl_subfr, NULL, 1, 0, &dl_sched->alloc) ||
+       LIBLTE_SUCCESS != liblte_phy_get_tbs_for_dl(dl_sched->alloc.mcs, N_avail_prbs, &tbs))
+        return false;
+
+    LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *mux_sched = dl_sched_pool.alloc();
+    if(NULL == mux_sched)
+        return false;
+    LIBLTE_MAC_PDU_STRUCT *mac_pdu = &mux_sched->mac_pdu;
+    int32                  N_bytes = tbs/8;
+    if(N_bytes > DL_MUX_MAX_PDU_BYTES)
+        N_bytes = DL_MUX_MAX_PDU_BYTES;
+    memcpy(&mux_sched->alloc, &dl_sched->alloc, sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+    mux_sched->current_tti = dl_sched->current_tti;
+    mux_sched->mux         = false;
+    mac_pdu->chan_type     = LIBLTE_MAC_CHAN_TYPE_DLSCH;
+    mac_pdu->N_subheaders  = 0;
+
+    // Contention resolution goes out with the first PDU after Msg3
+    LTE_fdd_enb_rb *srb0 = NULL;
+    user->get_srb0(&srb0);
+    if(NULL != srb0 && srb0->get_send_con_res_id())
+    {
+        mac_pdu->subheader[0].lcid                     = LIBLTE_MAC_DLSCH_UE_CONTENTION_RESOLUTION_ID_LCID;
+        mac_pdu->subheader[0].payload.ue_con_res_id.id = srb0->get_con_res_id();
+        mac_pdu->N_subheaders                          = 1;
+        N_bytes                                       -= 7;
+    }
+
+    // Logical channel prioritization, 36.321 section 5.4.3.1.  Step 1 serves
+    // every channel with a positive bucket in priority order, step 3 hands
+    // out what is left in strict priority order.  Ready-made MAC SDUs
+    // (STATUS PDUs, retransmissions and TM) go first and are never split,
+    // then RLC builds new PDUs sized to what is left.  Two subheaders are
+    // kept free for padding.
+    for(uint32 step=1; step<=3; step+=2)
+    {
+        for(uint32 i=0; i<N_rbs; i++)
+        {
+            int64 bucket = rb[i]->get_mac_lcp_bucket(dl_subfr->current_tti);
+            if(1 == step && 0 >= bucket)
+                continue;
+
+            LIBLTE_BYTE_MSG_STRUCT *sdu;
+            while(mac_pdu->N_subheaders < (LIBLTE_MAC_MAX_MAC_PDU_N_SUBHEADERS - 2) &&
+                  (3 == step || 0 < bucket))
+            {
+                LIBLTE_MAC_PDU_SUBHEADER_STRUCT *subhdr = &mac_pdu->subheader[mac_pdu->N_subheaders];
+                if(LTE_FDD_ENB_ERROR_NONE == rb[i]->peek_mac_sdu(N_taken[i], &sdu))
+                {
+                    int32 N_sdu_bytes = sdu->N_bytes + ((sdu->N_bytes < 128) ? 2 : 3);
+                    if(N_sdu_bytes > N_bytes)
+                        break;
+                    memcpy(&subhdr->payload.sdu, sdu, offsetof(LIBLTE_BYTE_MSG_STRUCT, msg) + sdu->N_bytes);
+                    N_taken[i]++;
+                }else{
+                    // Leave room for a 3 byte subheader, and limit step 1
+                    // to the bucket
+                    int64 N_pull = N_bytes - 3;
+                    if(1 == step && bucket < N_pull)
+                        N_pull = bucket;
+                    if(0 >= N_pull ||
+                       0 == rb[i]->rlc_get_tx_sdu_queue_bytes() ||
+                       !rlc->build_mac_sdu(user, rb[i], N_pull, &subhdr->payload.sdu))
+                        break;
+                    pulled[mac_pdu->N_subheaders] = true;
+                    N_pulled++;
+                }
+                subhdr->lcid  = rb[i]->get_rb_id();
+                N_bytes      -= subhdr->payload.sdu.N_bytes + ((subhdr->payload.sdu.N_bytes < 128) ? 2 : 3);
+                mac_pdu->N_subheaders++;
+                if(1 == step)
+                {
+                    N_step1[i] += subhdr->payload.sdu.N_bytes;
+                    bucket     -= subhdr->payload.sdu.N_bytes;
+                }
+            }
+        }
+    }
+    if(0 == mac_pdu->N_subheaders)
+    {
+        dl_sched_pool.free(mux_sched);
+        return false;
+    }
+
+    mux_sched->alloc.harq_process = user->get_harq_process();
+    if(!schedule_dl_alloc(dl_subfr, mux_sched))
+    {
+        // RLC PDUs that were built but not sent are kept as ready-made MAC SDUs
+        for(uint32 i=0; i<mac_pdu->N_subheaders; i++)
+            for(uint32 j=0; j<N_rbs; j++)
+                if(pulled[i] && rb[j]->get_rb_id() == mac_pdu->subheader[i].lcid)
+                    rb[j]->queue_mac_sdu(&mac_pdu->subheader[i].payload.sdu);
+        dl_sched_pool.free(mux_sched);
+        return false;
+    }
+    user->increment_harq_process();
+
+    // Step 2, and release the multiplexed SDUs
+    if(NULL != srb0 && srb0->get_send_con_res_id() &&
+       LIBLTE_MAC_DLSCH_UE_CONTENTION_RESOLUTION_ID_LCID == mac_pdu->subheader[0].lcid)
+        srb0->set_send_con_res_id(false);
+    for(uint32 i=0; i<N_rbs; i++)
+    {
+        rb[i]->consume_mac_lcp_bucket(N_step1[i]);
+        for(uint32 j=0; j<N_taken[i]; j++)
+            rb[i]->delete_next_mac_sdu();
+    }
+
+    interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                              LTE_FDD_ENB_DEBUG_LEVEL_MAC,
+                              __FILE__,
+                              __LINE__,
+                              "Multiplexed %u subheaders (%u built by RLC) for RNTI=%u, tbs=%u",
+                              mac_pdu->N_subheaders,
+                              N_pulled,
+                              user->get_c_rnti(),
+                              mux_sched->alloc.tbs);
+    dl_sched_pool.free(mux_sched);
+
+    return true;
+}
+uint32 LTE_fdd_enb_mac::get_dl_mux_rbs(LTE_fdd_enb_user  *user,
+                                       LTE_fdd_enb_rb   **rb)
+{
+    uint32 N_rbs = 0;
+
+    user->get_srb0(&rb[N_rbs]);
+    if(NULL != rb[N_rbs])
+        N_rbs++;
+    if(LTE_FDD_ENB_ERROR_NONE == user->get_srb1(&rb[N_rbs]))
+        N_rbs++;
+    if(LTE_FDD_ENB_ERROR_NONE == user->get_srb2(&rb[N_rbs]))
+        N_rbs++;
+    for(uint32 i=LTE_FDD_ENB_RB_DRB1; i<LTE_FDD_ENB_RB_N_ITEMS; i++)
+        if(LTE_FDD_ENB_ERROR_NONE == user->get_drb((LTE_FDD_ENB_RB_ENUM)i, &rb[N_rbs]) &&
+           !sps_holds_rb(user, rb[N_rbs]))
+            N_rbs++;
+
+    // Lower values are served first, ties keep the logical channel order
+    std::stable_sort(rb, rb + N_rbs,
+                     [](LTE_fdd_enb_rb *a, LTE_fdd_enb_rb *b)
+                     {
+                         return a->get_mac_lcp_priority() < b->get_mac_lcp_priority();
+                     });
+
+    return N_rbs;
+}
+uint32 LTE_fdd_enb_mac::get_dl_mux_backlog(LTE_fdd_enb_user *user)
+{
+    LTE_fdd_enb_rb *rb[LTE_FDD_ENB_RB_N_ITEMS];
+    uint32          N_rbs   = get_dl_mux_rbs(user, rb);
+    uint32          N_bytes = 0;
+
+    for(uint32 i=0; i<N_rbs; i++)
+        N_bytes += rb[i]->get_mac_sdu_queue_bytes() + rb[i]->rlc_get_tx_sdu_queue_bytes();
+
+    return N_bytes;
+}
+bool LTE_fdd_enb_mac::alloc_dl_prbs(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr,
+                                    LIBLTE_PHY_ALLOCATION_STRUCT       *alloc,
+                                    bool                                non_contiguous)
+{
+    uint32 N_rb_dl = interface->get_n_rb_dl();
+    uint32 N_prb   = 0;
+    uint32 prb[LIBLTE_PHY_N_RB_DL_MAX];
+
+    // SI PRBs are already accounted for in N_avail_prbs
+    uint32 N_avail = N_rb_dl;
+    if(LIBLTE_MAC_SI_RNTI != alloc->rnti)
+        N_avail = dl_subfr->N_avail_prbs - dl_subfr->N_sched_prbs;
+    if(0 == alloc->N_prb || alloc->N_prb > N_avail)
+        return false;
+
+    // First fit contiguous run, signalled as a localized allocation
+    uint32 run_start = 0;
+    for(uint32 i=0; i<N_rb_dl && N_prb<alloc->N_prb; i++)
+    {
+        if(dl_subfr->prb_used[i])
+        {
+            run_start = i + 1;
+            continue;
+        }
+        if((i - run_start + 1) == alloc->N_prb)
+            for(N_prb=0; N_prb<alloc->N_prb; N_prb++)
+                prb[N_prb] = run_start + N_prb;
+    }
+
+    // Otherwise collect free RBGs, signalled as resource allocation type 0
+    if(N_prb < alloc->N_prb && non_contiguous)
+    {
+        uint32 P = liblte_phy_get_dl_rbg_size(N_rb_dl);
+        N_prb    = 0;
+        for(uint32 rbg_start=0; rbg_start<N_rb_dl && N_prb<alloc->N_prb; rbg_start+=P)
+        {
+            uint32 rbg_end = (rbg_start + P < N_rb_dl) ? rbg_start + P : N_rb_dl;
+            bool   free    = true;
+            for(uint32 i=rbg_start; i<rbg_end; i++)
+                if(dl_subfr->prb_used[i])
+                    free = false;
+            if(!free)
+                continue;
+            for(uint32 i=rbg_start; i<rbg_end; i++)
+                prb[N_prb++] = i;
+        }
+    }
+    if(N_prb < alloc->N_prb || N_prb > N_avail)
+        return false;
+
+    alloc->N_prb = N_prb;
+    for(uint32 i=0; i<N_prb; i++)
+    {
+        alloc->prb[0][i]           = prb[i];
+        alloc->prb[1][i]           = prb[i];
+        dl_subfr->prb_used[prb[i]] = true;
+    }
+    if(LIBLTE_MAC_SI_RNTI != alloc->rnti)
+        dl_subfr->N_sched_prbs += N_prb;
+
+    return true;
+}
+bool LTE_fdd_enb_mac::size_ul_grant(LTE_fdd_enb_user             *user,
+                                    uint32                        N_bytes,
+                                    uint32                        N_prb_max,
+                                    LIBLTE_PHY_ALLOCATION_STRUCT *alloc)
+{
+    uint32 N_rb_ul = interface->get_n_rb_ul();
+
+    // The PHY can only decode PUSCH sizes it has a transform precoding
+    // plan for
+    if(N_prb_max >= N_rb_ul)
+        N_prb_max = N_rb_ul - 1;
+    if(0 == N_prb_max)
+        return false;
+
+    if(LIBLTE_SUCCESS == liblte_phy_get_tbs_and_n_prb_for_ul(N_bytes*8,
+                                                             N_prb_max,
+                                                             user->get_mcs(),
+                                                             &alloc->tbs,
+                                                             &alloc->N_prb))
+        return true;
+
+    // Too much to send in one TTI, take the largest grant that fits and
+    // let the rest follow in later TTIs
+    for(uint32 N_prb=N_prb_max; N_prb>0; N_prb--)
+    {
+        if(liblte_phy_is_valid_n_prb_for_ul(N_prb, N_rb_ul) &&
+           LIBLTE_SUCCESS == liblte_phy_get_tbs_for_ul(user->get_mcs(), N_prb, &alloc->tbs))
+        {
+            alloc->N_prb = N_prb;
+            return true;
+        }
+    }
+    return false;
+}
+bool LTE_fdd_enb_mac::alloc_ul_prbs(LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr,
+                                    LIBLTE_PHY_ALLOCATION_STRUCT       *alloc)
+{
+    uint32 N_rb_ul = interface->get_n_rb_ul();
+
+    if(0 == alloc->N_prb || alloc->N_prb > (ul_subfr->N_avail_prbs - ul_subfr->N_sched_prbs))
+        return false;
+
+    // PUSCH is single carrier, so only a contiguous run will do (first fit)
+    uint32 run_start = 0;
+    for(uint32 i=0; i<N_rb_ul; i++)
+    {
+        if(ul_subfr->prb_used[i])
+        {
+            run_start = i + 1;
+            continue;
+        }
+        if((i - run_start + 1) == alloc->N_prb)
+        {
+            for(uint32 j=0; j<alloc->N_prb; j++)
+            {
+                alloc->prb[0][j]                  = run_start + j;
+                alloc->prb[1][j]                  = run_start + j;
+                ul_subfr->prb_used[run_start + j] = true;
+            }
+            ul_subfr->N_sched_prbs += alloc->N_prb;
+            return true;
+        }
+    }
+    return false;
+}
+float LTE_fdd_enb_mac::get_dl_inst_rate(LTE_fdd_enb_user *user,
+                                        uint8             mcs)
+{
+    uint32 tbs   = 0;
+    uint32 N_prb = 0;
+
+    // Prefer the UE's reported channel quality over the configured MCS
+    if(NULL != user && user->is_dl_cqi_set())
+        mcs = CQI_TO_MCS[user->get_dl_cqi() & 0x0F];
+    liblte_phy_get_tbs_and_n_prb_for_dl(1, 1, mcs, &tbs, &N_prb);
+
+    return tbs;
+}
+void LTE_fdd_enb_mac::pad_dl_mac_pdu(LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched)
+{
+    // Pad and repack if needed
+    if(dl_sched->alloc.tbs > dl_sched->alloc.msg[0].N_bits)
+    {
+        uint32 N_pad = (dl_sched->alloc.tbs - dl_sched->alloc.msg[0].N_bits)/8;
+
+        if(1 == N_pad)
+        {
+            for(uint32 i=0; i<dl_sched->mac_pdu.N_subheaders; i++)
+                memcpy(&dl_sched->mac_pdu.subheader[dl_sched->mac_pdu.N_subheaders-i],
+                       &dl_sched->mac_pdu.subheader[dl_sched->mac_pdu.N_subheaders-i-1],
+                       sizeof(LIBLTE_MAC_PDU_SUBHEADER_STRUCT));
+            dl_sched->mac_pdu.subheader[0].lcid = LIBLTE_MAC_DLSCH_PADDING_LCID;
+            dl_sched->mac_pdu.N_subheaders++;
+        }else if(2 == N_pad){
+            for(uint32 i=0; i<dl_sched->mac_pdu.N_subheaders; i++)
+                memcpy(&dl_sched->mac_pdu.subheader[dl_sched->mac_pdu.N_subheaders-i+1],
+                       &dl_sched->mac_pdu.subheader[dl_sched->mac_pdu.N_subheaders-i-1],
+                       sizeof(LIBLTE_MAC_PDU_SUBHEADER_STRUCT));
+            dl_sched->mac_pdu.subheader[0].lcid  = LIBLTE_MAC_DLSCH_PADDING_LCID;
+            dl_sched->mac_pdu.subheader[1].lcid  = LIBLTE_MAC_DLSCH_PADDING_LCID;
+            dl_sched->mac_pdu.N_subheaders      += 2;
+        }else{
+            dl_sched->mac_pdu.subheader[dl_sched->mac_pdu.N_subheaders].lcid = LIBLTE_MAC_DLSCH_PADDING_LCID;
+            dl_sched->mac_pdu.N_subheaders++;
+        }
+
+        liblte_mac_pack_mac_pdu(&dl_sched->mac_pdu,
+                                &dl_sched->alloc.msg[0]);
+    }
+}
+void LTE_fdd_enb_mac::send_dl_alloc(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_subfr,
+                                    LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT  *dl_sched,
+                                    uint32                              n_1_p_pucch)
+{
+    // Send a PCAP message
+    interface->send_lte_pcap_msg(LTE_FDD_ENB_PCAP_DIRECTION_DL,
+                                 dl_sched->alloc.rnti,
+                                 dl_subfr->current_tti,
+                                 dl_sched->alloc.msg[0].msg,
+                                 dl_sched->alloc.tbs);
+
+    interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                              LTE_FDD_ENB_DEBUG_LEVEL_MAC,
+                              __FILE__,
+                              __LINE__,
+                              &dl_sched->alloc.msg[0],
+                              "DL allocation (mcs=%u, tbs=%u, N_prb=%u) sent for RNTI=%u CURRENT_TTI=%u",
+                              dl_sched->alloc.mcs,
+                              dl_sched->alloc.tbs,
+                              dl_sched->alloc.N_prb,
+                              dl_sched->alloc.rnti,
+                              dl_subfr->current_tti);
+
+    LTE_fdd_enb_user *user = NULL;
+    if(dl_sched->alloc.rnti != LIBLTE_MAC_SI_RNTI &&
+       LTE_FDD_ENB_ERROR_NONE == user_mgr->find_user(dl_sched->alloc.rnti, &user))
+    {
+        user->update_dl_thru(dl_subfr->current_tti, dl_sched->alloc.tbs);
+
+        // Retransmissions carry no new bytes
+        if(0 == dl_sched->alloc.harq_retx_count)
+        {
+            user->count_dl_bytes(dl_sched->alloc.tbs/8);
+            interface->count_metric(cell, LTE_FDD_ENB_METRIC_MAC_DL_BYTES, dl_sched->alloc.tbs/8);
+        }
+
+        // Only new transmissions on the C-RNTI restart drx-InactivityTimer
+        if(0                  == dl_sched->alloc.harq_retx_count &&
+           user->get_c_rnti() == dl_sched->alloc.rnti)
+            user->restart_drx_inactivity_timer(dl_subfr->current_tti);
+    }
+
+    // Schedule DL
+    if(NULL == msgq_to_ue)
+    {
+        memcpy(&dl_subfr->allocations.dl_alloc[dl_subfr->allocations.N_dl_alloc],
+               &dl_sched->alloc,
+               sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+        dl_subfr->allocations.N_dl_alloc++;
+
+        if(dl_sched->alloc.rnti != LIBLTE_MAC_SI_RNTI)
+        {
+            // Schedule ACK/NACK PUCCH 4 subframes from now and store the DL allocation for potential H-ARQ retransmission
+            LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_subfr   = &sched_ul_subfr[(sched_cur_dl_subfn+4)%10];
+            ul_subfr->pucch[ul_subfr->N_pucch].type        = LTE_FDD_ENB_PUCCH_TYPE_ACK_NACK;
+            ul_subfr->pucch[ul_subfr->N_pucch].rnti        = dl_sched->alloc.rnti;
+            ul_subfr->pucch[ul_subfr->N_pucch].n_1_p_pucch = n_1_p_pucch;
+            ul_subfr->pucch[ul_subfr->N_pucch].decode      = true;
+            ul_subfr->N_pucch++;
+            if(NULL != user)
+                user->store_harq_info(ul_subfr->current_tti, &dl_sched->mac_pdu, &dl_sched->alloc);
+        }
+    }else{
+        LIBTOOLS_IPC_MSGQ_MAC_PDU_MSG_STRUCT mac_pdu_msg;
+        memcpy(&mac_pdu_msg.msg, &dl_sched->alloc.msg[0], sizeof(mac_pdu_msg.msg));
+        mac_pdu_msg.rnti = dl_sched->alloc.rnti;
+        msgq_to_ue->send(LIBTOOLS_IPC_MSGQ_MESSAGE_TYPE_MAC_PDU,
+                         (LIBTOOLS_IPC_MSGQ_MESSAGE_UNION *)&mac_pdu_msg,
+                         sizeof(mac_pdu_msg));
+    }
+}
+bool LTE_fdd_enb_mac::build_sps_dl_pdu(LTE_fdd_enb_user                  *user,
+                                       LTE_fdd_enb_rb                    *rb,
+                                       LTE_FDD_ENB_DL_SCHED_QUEUE_STRUCT *dl_sched)
+{
+    LIBLTE_MAC_PDU_STRUCT  *mac_pdu = &dl_sched->mac_pdu;
+    LIBLTE_BYTE_MSG_STRUCT *sdu;
+    int32                   N_bytes = dl_sched->alloc.tbs/8 - 3;
+
+    // One SDU per occasion, ready-made MAC SDUs are never split
+    mac_pdu->chan_type    = LIBLTE_MAC_CHAN_TYPE_DLSCH;
+    mac_pdu->N_subheaders = 0;
+    if(LTE_FDD_ENB_ERROR_NONE == rb->peek_mac_sdu(0, &sdu))
+    {
+        if((int32)sdu->N_bytes > N_bytes)
+            return false;
+        memcpy(&mac_pdu->subheader[0].payload.sdu, sdu, offsetof(LIBLTE_BYTE_MSG_STRUCT, msg) + sdu->N_bytes);
+        rb->delete_next_mac_sdu();
+    }else if(0 >= N_bytes                              ||
+             0 == rb->rlc_get_tx_sdu_queue_bytes()     ||
+             !rlc->build_mac_sdu(user, rb, N_bytes, &mac_pdu->subheader[0].payload.sdu)){
+        return false;
+    }
+    mac_pdu->subheader[0].lcid = rb->get_rb_id();
+    mac_pdu->N_subheaders      = 1;
+
+    liblte_mac_pack_mac_pdu(mac_pdu, &dl_sched->alloc.msg[0]);
+    pad_dl_mac_pdu(dl_sched);
+
+    return true;
+}
+bool LTE_fdd_enb_mac::alloc_sps_prbs(bool                         *prb_used,
+                                     uint32                        N_rb,
+                                     LIBLTE_PHY_ALLOCATION_STRUCT *alloc)
+{
+    // Configured PRBs are taken from the top of the band, away from the
+    // first fit dynamic and SI allocations, and must be contiguous
+    uint32 run_end = N_rb;
+    for(int32 i=N_rb-1; i>=0; i--)
+    {
+        if(prb_used[i])
+        {
+            run_end = i;
+            continue;
+        }
+        if((run_end - i) == alloc->N_prb)
+        {
+            for(uint32 j=0; j<alloc->N_prb; j++)
+            {
+                alloc->prb[0][j] = i + j;
+                alloc->prb[1][j] = i + j;
+                prb_used[i + j]  = true;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+bool LTE_fdd_enb_mac::reserve_sps_prbs(bool                         *prb_used,
+                                       LIBLTE_PHY_ALLOCATION_STRUCT *alloc)
+{
+    for(uint32 i=0; i<alloc->N_prb; i++)
+        if(prb_used[alloc->prb[0][i]])
+            return false;
+    for(uint32 i=0; i<alloc->N_prb; i++)
+        prb_used[alloc->prb[0][i]] = true;
+    return true;
+}
+bool LTE_fdd_enb_mac::sps_holds_rb(LTE_fdd_enb_user *user,
+                                   LTE_fdd_enb_rb   *rb)
+{
+    std::lock_guard<std::mutex> lock(sps_mutex);
+
+    if(NULL != msgq_to_ue)
+        return false;
+
+    // The SPS RB is left to the configured assignment while its backlog
+    // fits, anything larger goes through the PDCCH scheduler
+    uint32 N_bytes = rb->get_mac_sdu_queue_bytes() + rb->rlc_get_tx_sdu_queue_bytes();
+    for(auto sps : sps_list)
+    {
+        if(sps->c_rnti != user->get_c_rnti() || sps->rb_id != rb->get_rb_id())
+            continue;
+        if(LTE_FDD_ENB_SPS_STATE_ACTIVE == sps->dl_state)
+            return (N_bytes + SPS_DL_HDR_BYTES) <= sps->dl_alloc.tbs/8;
+        return (LTE_FDD_ENB_SPS_STATE_IDLE == sps->dl_state &&
+                LTE_FDD_ENB_SPS_MAX_SDU_BYTES >= N_bytes);
+    }
+    return false;
+}
+bool LTE_fdd_enb_mac::sps_dl_occasion(uint16 rnti)
+{
+    std::lock_guard<std::mutex> lock(sps_mutex);
+
+    for(auto sps : sps_list)
+        if(sps->dl_reserved && (rnti == sps->c_rnti || rnti == sps->sps_c_rnti))
+            return true;
+    return false;
+}
+bool LTE_fdd_enb_mac::sps_covers_ul(LTE_fdd_enb_user *user,
+                                    uint32            N_bytes)
+{
+    std::lock_guard<std::mutex> lock(sps_mutex);
+
+    // An SR still gets a dynamic grant, the UE asks for more than the
+    // configured grant carries
+    for(auto sps : sps_list)
+        if(sps->c_rnti == user->get_c_rnti())
+            return (LTE_FDD_ENB_SPS_STATE_ACTIVE == sps->ul_state &&
+                    !user->get_ul_sr_pending()                   &&
+                    (N_bytes + UL_GRANT_MAC_HDR_BYTES) <= sps->ul_alloc.tbs/8);
+    return false;
+}
+void LTE_fdd_enb_mac::sps_ul_decoded(uint16 c_rnti,
+                                     bool   has_sdu)
+{
+    std::lock_guard<std::mutex> lock(sps_mutex);
+
+    for(auto sps : sps_list)
+    {
+        if(sps->c_rnti != c_rnti || LTE_FDD_ENB_SPS_STATE_ACTIVE != sps->ul_state)
+            continue;
+
+        // Mirrors the UE side implicit release, 36.321 section 5.10.2
+        sps->N_ul_empty = has_sdu ? 0 : sps->N_ul_empty + 1;
+        if(LTE_FDD_ENB_SPS_UL_RELEASE_N_EMPTY <= sps->N_ul_empty)
+        {
+            sps->ul_state = LTE_FDD_ENB_SPS_STATE_IDLE;
+            interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                                      LTE_FDD_ENB_DEBUG_LEVEL_MAC,
+                                      __FILE__,
+                                      __LINE__,
+                                      "UL SPS implicitly released for RNTI=%u",
+                                      c_rnti);
+        }
+        return;
+    }
+}
 LIBLTE_PHY_MODULATION_TYPE_ENUM LTE_fdd_enb_mac::get_modulation_type(uint8 mcs)
 {
     if(mcs < 10 || mcs == 29)
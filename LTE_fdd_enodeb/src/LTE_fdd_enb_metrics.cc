@@ -0,0 +1,672 @@
+#line 2 "LTE_fdd_enb_metrics.cc" // Make __FILE__ omit the path
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_metrics.cc
+
+    Description: Contains all the implementations for the LTE FDD eNodeB
+                 runtime metrics.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "LTE_fdd_enb_metrics.h"
+#include "LTE_fdd_enb_msg_pool.h"
+#include "LTE_fdd_enb_user_mgr.h"
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+#define LTE_FDD_ENB_METRICS_PREFIX "lte_fdd_enb_"
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+// Marks the block of a thread for cleanup when the thread exits
+struct LTE_fdd_enb_metrics_thread_block
+{
+    ~LTE_fdd_enb_metrics_thread_block()
+    {
+        if(NULL != block)
+            block->closed.store(true);
+    }
+    LTE_FDD_ENB_METRICS_BLOCK_STRUCT *block;
+};
+
+/*******************************************************************************
+                              GLOBAL VARIABLES
+*******************************************************************************/
+
+static thread_local LTE_fdd_enb_metrics_thread_block thread_block;
+
+static const char counter_help[LTE_FDD_ENB_METRIC_COUNTER_N_ITEMS][100] = {"DL subframes not sent because they were late",
+                                                                           "UL subframes not decoded or finished late",
+                                                                           "PUSCH transport blocks decoded",
+                                                                           "PUSCH transport blocks that failed the CRC",
+                                                                           "Turbo decoder iterations run on the PUSCH",
+                                                                           "DL HARQ ACKs received",
+                                                                           "DL HARQ NACKs received",
+                                                                           "Bytes scheduled on the DL-SCH",
+                                                                           "Bytes received on the UL-SCH"};
+static const char hist_help[LTE_FDD_ENB_METRIC_HIST_N_ITEMS][100] = {"PHY DL subframe processing time in microseconds",
+                                                                     "PHY UL subframe processing time in microseconds",
+                                                                     "MAC scheduling time per TTI in microseconds"};
+
+/*******************************************************************************
+                              LOCAL FUNCTIONS
+*******************************************************************************/
+
+// Smallest bucket whose bound 2^i holds the value
+static uint32 bucket_idx(uint64 value)
+{
+    uint32 idx;
+
+    if(1 >= value)
+        return 0;
+    idx = 64 - __builtin_clzll(value - 1);
+    if(LTE_FDD_ENB_METRICS_N_BUCKETS <= idx)
+        idx = LTE_FDD_ENB_METRICS_N_BUCKETS - 1;
+    return idx;
+}
+
+// Labels are given as Prometheus pairs (a="b",c="d") and become tags
+// for line protocol, the values used here never need escaping
+static std::string to_tags(const std::string &labels)
+{
+    std::string tags;
+
+    for(char c : labels)
+        if('"' != c)
+            tags += c;
+    return tags;
+}
+static void add_family(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep,
+                       const std::string                 &name,
+                       const char                        *type,
+                       const char                        *help)
+{
+    if(LTE_FDD_ENB_METRICS_FORMAT_PROMETHEUS != rep->format)
+        return;
+    rep->out += "# HELP " LTE_FDD_ENB_METRICS_PREFIX + name + " " + help + "\n";
+    rep->out += "# TYPE " LTE_FDD_ENB_METRICS_PREFIX + name + " " + type + "\n";
+}
+static void add_sample(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep,
+                       const std::string                 &name,
+                       const std::string                 &labels,
+                       const std::string                 &value)
+{
+    if(LTE_FDD_ENB_METRICS_FORMAT_PROMETHEUS == rep->format)
+    {
+        rep->out += LTE_FDD_ENB_METRICS_PREFIX + name;
+        if(!labels.empty())
+            rep->out += "{" + labels + "}";
+        rep->out += " " + value + "\n";
+    }else{
+        rep->out += LTE_FDD_ENB_METRICS_PREFIX + name;
+        if(!labels.empty())
+            rep->out += "," + to_tags(labels);
+        rep->out += " value=" + value + " " + rep->timestamp + "\n";
+    }
+}
+static void add_sample(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep,
+                       const std::string                 &name,
+                       const std::string                 &labels,
+                       uint64                             value)
+{
+    // Line protocol marks integers
+    if(LTE_FDD_ENB_METRICS_FORMAT_PROMETHEUS == rep->format)
+        add_sample(rep, name, labels, std::to_string(value));
+    else
+        add_sample(rep, name, labels, std::to_string(value) + "i");
+}
+static void add_sample(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep,
+                       const std::string                 &name,
+                       const std::string                 &labels,
+                       double                             value)
+{
+    char str[32];
+
+    snprintf(str, sizeof(str), "%.6g", value);
+    add_sample(rep, name, labels, std::string(str));
+}
+
+// Upper bound of the bucket holding the given fraction of the samples
+static uint64 hist_percentile(uint64 *bucket,
+                              uint64  count,
+                              double  fraction)
+{
+    uint64 target = (uint64)(fraction*count + 0.5);
+    uint64 total  = 0;
+    uint32 i;
+
+    if(0 == count)
+        return 0;
+    for(i=0; i<LTE_FDD_ENB_METRICS_N_BUCKETS-1; i++)
+    {
+        total += bucket[i];
+        if(total >= target)
+            return (uint64)1 << i;
+    }
+    return (uint64)1 << (LTE_FDD_ENB_METRICS_N_BUCKETS-1);
+}
+static void add_hist(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep,
+                     const std::string                 &name,
+                     const std::string                 &labels,
+                     uint64                            *bucket,
+                     uint64                             sum,
+                     uint64                             max)
+{
+    std::string sep = labels.empty() ? "" : ",";
+    uint64      count = 0;
+    uint32      i;
+
+    for(i=0; i<LTE_FDD_ENB_METRICS_N_BUCKETS; i++)
+        count += bucket[i];
+
+    if(LTE_FDD_ENB_METRICS_FORMAT_PROMETHEUS == rep->format)
+    {
+        // Prometheus buckets are cumulative
+        uint64 total = 0;
+        for(i=0; i<LTE_FDD_ENB_METRICS_N_BUCKETS-1; i++)
+        {
+            total += bucket[i];
+            add_sample(rep, name + "_bucket", labels + sep + "le=\"" + std::to_string((uint64)1 << i) + "\"", total);
+        }
+        add_sample(rep, name + "_bucket", labels + sep + "le=\"+Inf\"", count);
+        add_sample(rep, name + "_sum", labels, sum);
+        add_sample(rep, name + "_count", labels, count);
+    }else{
+        // A single line, with the percentiles worked out from the buckets
+        rep->out += LTE_FDD_ENB_METRICS_PREFIX + name;
+        if(!labels.empty())
+            rep->out += "," + to_tags(labels);
+        rep->out += " count=" + std::to_string(count) + "i";
+        rep->out += ",sum=" + std::to_string(sum) + "i";
+        rep->out += ",max=" + std::to_string(max) + "i";
+        rep->out += ",p50=" + std::to_string(hist_percentile(bucket, count, 0.50)) + "i";
+        rep->out += ",p99=" + std::to_string(hist_percentile(bucket, count, 0.99)) + "i";
+        rep->out += " " + rep->timestamp + "\n";
+    }
+}
+static void add_to_totals(LTE_FDD_ENB_METRICS_TOTALS_STRUCT *totals,
+                          LTE_FDD_ENB_METRICS_BLOCK_STRUCT  *block)
+{
+    uint64 max;
+    uint32 i;
+    uint32 j;
+    uint32 k;
+
+    for(i=0; i<LTE_FDD_ENB_MAX_N_CELLS; i++)
+    {
+        for(j=0; j<LTE_FDD_ENB_METRIC_COUNTER_N_ITEMS; j++)
+            totals->counter[i][j] += block->counter[i][j].load(std::memory_order_relaxed);
+        for(j=0; j<LTE_FDD_ENB_METRIC_HIST_N_ITEMS; j++)
+        {
+            for(k=0; k<LTE_FDD_ENB_METRICS_N_BUCKETS; k++)
+                totals->bucket[i][j][k] += block->bucket[i][j][k].load(std::memory_order_relaxed);
+            totals->sum[i][j] += block->sum[i][j].load(std::memory_order_relaxed);
+            max                = block->max[i][j].load(std::memory_order_relaxed);
+            if(max > totals->max[i][j])
+                totals->max[i][j] = max;
+        }
+    }
+}
+
+// Returns false if the thread has gone
+static bool read_thread_cpu(pid_t   tid,
+                            uint64 *utime,
+                            uint64 *stime)
+{
+    FILE *stat_file;
+    char  str[LTE_FDD_ENB_MAX_LINE_SIZE];
+    char *c;
+    bool  found = false;
+
+    snprintf(str, sizeof(str), "/proc/self/task/%d/stat", tid);
+    stat_file = fopen(str, "r");
+    if(NULL == stat_file)
+        return false;
+    if(NULL != fgets(str, sizeof(str), stat_file))
+    {
+        // The name can hold spaces, so start after it
+        c = strrchr(str, ')');
+        if(NULL != c &&
+           2 == sscanf(c + 1, " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+                       (unsigned long long *)utime,
+                       (unsigned long long *)stime))
+            found = true;
+    }
+    fclose(stat_file);
+    return found;
+}
+
+/*******************************************************************************
+                              CLASS IMPLEMENTATIONS
+*******************************************************************************/
+
+/********************************/
+/*    Constructor/Destructor    */
+/********************************/
+LTE_fdd_enb_metrics::LTE_fdd_enb_metrics(LTE_fdd_enb_interface *iface,
+                                         LTE_fdd_enb_user_mgr  *um) :
+    interface{iface}, user_mgr{um}, closed_totals{}, dump_file{LTE_FDD_ENB_METRICS_DEFAULT_FILE},
+    dump_period{0}, dump_format{LTE_FDD_ENB_METRICS_FORMAT_PROMETHEUS}, dump_failed{false},
+    started{false}
+{
+    running.store(false);
+}
+LTE_fdd_enb_metrics::~LTE_fdd_enb_metrics()
+{
+    stop();
+
+    // Threads still running keep writing to their blocks
+    std::lock_guard<std::mutex> lock(blocks_mutex);
+    for(auto it=blocks.begin(); it!=blocks.end(); )
+    {
+        if((*it)->closed.load())
+        {
+            delete *it;
+            it = blocks.erase(it);
+        }else{
+            it++;
+        }
+    }
+}
+
+/********************/
+/*    Start/Stop    */
+/********************/
+void LTE_fdd_enb_metrics::start()
+{
+    if(started)
+        return;
+    running.store(true);
+    pthread_create(&thread, NULL, &dump_thread, this);
+    started = true;
+}
+void LTE_fdd_enb_metrics::stop()
+{
+    if(!started)
+        return;
+    running.store(false);
+    pthread_join(thread, NULL);
+    started = false;
+}
+
+/*******************/
+/*    Recording    */
+/*******************/
+void LTE_fdd_enb_metrics::count(uint8                           cell,
+                                LTE_FDD_ENB_METRIC_COUNTER_ENUM counter,
+                                uint64                          N)
+{
+    LTE_FDD_ENB_METRICS_BLOCK_STRUCT *block = get_thread_block();
+    std::atomic<uint64>              *c     = &block->counter[cell][counter];
+
+    // Only this thread writes, so there is no need for a locked add
+    c->store(c->load(std::memory_order_relaxed) + N, std::memory_order_relaxed);
+}
+void LTE_fdd_enb_metrics::sample(uint8                        cell,
+                                 LTE_FDD_ENB_METRIC_HIST_ENUM hist,
+                                 uint64                       value)
+{
+    LTE_FDD_ENB_METRICS_BLOCK_STRUCT *block = get_thread_block();
+    std::atomic<uint64>              *b     = &block->bucket[cell][hist][bucket_idx(value)];
+    std::atomic<uint64>              *s     = &block->sum[cell][hist];
+    std::atomic<uint64>              *m     = &block->max[cell][hist];
+
+    b->store(b->load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    s->store(s->load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    if(value > m->load(std::memory_order_relaxed))
+        m->store(value, std::memory_order_relaxed);
+}
+LTE_FDD_ENB_METRICS_BLOCK_STRUCT* LTE_fdd_enb_metrics::get_thread_block()
+{
+    if(NULL == thread_block.block)
+    {
+        // Value initialization zeroes the counters
+        LTE_FDD_ENB_METRICS_BLOCK_STRUCT *block = new LTE_FDD_ENB_METRICS_BLOCK_STRUCT();
+        block->closed.store(false);
+
+        std::lock_guard<std::mutex> lock(blocks_mutex);
+        blocks.push_back(block);
+        thread_block.block = block;
+    }
+    return thread_block.block;
+}
+void LTE_fdd_enb_metrics::collect(LTE_FDD_ENB_METRICS_TOTALS_STRUCT *totals)
+{
+    std::lock_guard<std::mutex> lock(blocks_mutex);
+
+    // Blocks of threads that have exited are folded in once and freed
+    for(auto it=blocks.begin(); it!=blocks.end(); )
+    {
+        if((*it)->closed.load())
+        {
+            add_to_totals(&closed_totals, *it);
+            delete *it;
+            it = blocks.erase(it);
+        }else{
+            it++;
+        }
+    }
+
+    memcpy(totals, &closed_totals, sizeof(LTE_FDD_ENB_METRICS_TOTALS_STRUCT));
+    for(auto block : blocks)
+        add_to_totals(totals, block);
+}
+
+/************************/
+/*    Message Queues    */
+/************************/
+void LTE_fdd_enb_metrics::add_msgq(LTE_fdd_enb_msgq *msgq)
+{
+    std::lock_guard<std::mutex> lock(msgqs_mutex);
+
+    msgqs.push_back(msgq);
+}
+void LTE_fdd_enb_metrics::remove_msgq(LTE_fdd_enb_msgq *msgq)
+{
+    std::lock_guard<std::mutex> lock(msgqs_mutex);
+
+    for(auto it=msgqs.begin(); it!=msgqs.end(); it++)
+    {
+        if(*it == msgq)
+        {
+            msgqs.erase(it);
+            break;
+        }
+    }
+}
+
+/*******************/
+/*    Reporting    */
+/*******************/
+std::string LTE_fdd_enb_metrics::report(LTE_FDD_ENB_METRICS_FORMAT_ENUM format)
+{
+    LTE_FDD_ENB_METRICS_REPORT_STRUCT rep;
+    struct timeval                    now;
+
+    gettimeofday(&now, NULL);
+    rep.format    = format;
+    rep.timestamp = std::to_string((uint64)now.tv_sec*1000000000 + (uint64)now.tv_usec*1000);
+
+    report_layers(&rep);
+    report_msgqs(&rep);
+    report_msg_pool(&rep);
+    report_users(&rep);
+    report_threads(&rep);
+
+    return rep.out;
+}
+void LTE_fdd_enb_metrics::report_layers(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep)
+{
+    LTE_FDD_ENB_METRICS_TOTALS_STRUCT totals;
+    uint64                            N_harq;
+    uint32                            N_cells = interface->get_n_cells();
+    uint32                            i;
+    uint32                            j;
+
+    collect(&totals);
+
+    for(i=0; i<LTE_FDD_ENB_METRIC_COUNTER_N_ITEMS; i++)
+    {
+        std::string name = std::string(LTE_fdd_enb_metric_counter_text[i]) + "_total";
+        add_family(rep, name, "counter", counter_help[i]);
+        for(j=0; j<N_cells; j++)
+            add_sample(rep, name, "cell=\"" + std::to_string(j) + "\"", totals.counter[j][i]);
+    }
+    for(i=0; i<LTE_FDD_ENB_METRIC_HIST_N_ITEMS; i++)
+    {
+        add_family(rep, LTE_fdd_enb_metric_hist_text[i], "histogram", hist_help[i]);
+        for(j=0; j<N_cells; j++)
+            add_hist(rep,
+                     LTE_fdd_enb_metric_hist_text[i],
+                     "cell=\"" + std::to_string(j) + "\"",
+                     totals.bucket[j][i],
+                     totals.sum[j][i],
+                     totals.max[j][i]);
+    }
+    for(i=0; i<LTE_FDD_ENB_METRIC_HIST_N_ITEMS; i++)
+    {
+        std::string name = std::string(LTE_fdd_enb_metric_hist_text[i]) + "_max";
+        add_family(rep, name, "gauge", hist_help[i]);
+        for(j=0; j<N_cells; j++)
+            add_sample(rep, name, "cell=\"" + std::to_string(j) + "\"", totals.max[j][i]);
+    }
+
+    // Block error rates since start, the counters give the rate over any window
+    add_family(rep, "dl_bler", "gauge", "DL HARQ NACKs over all DL HARQ feedback");
+    for(j=0; j<N_cells; j++)
+    {
+        N_harq = totals.counter[j][LTE_FDD_ENB_METRIC_DL_HARQ_ACKS] + totals.counter[j][LTE_FDD_ENB_METRIC_DL_HARQ_NACKS];
+        add_sample(rep,
+                   "dl_bler",
+                   "cell=\"" + std::to_string(j) + "\"",
+                   (0 == N_harq) ? 0.0 : (double)totals.counter[j][LTE_FDD_ENB_METRIC_DL_HARQ_NACKS]/N_harq);
+    }
+    add_family(rep, "ul_bler", "gauge", "PUSCH CRC failures over all PUSCH decodes");
+    for(j=0; j<N_cells; j++)
+    {
+        N_harq = totals.counter[j][LTE_FDD_ENB_METRIC_PUSCH_DECODES];
+        add_sample(rep,
+                   "ul_bler",
+                   "cell=\"" + std::to_string(j) + "\"",
+                   (0 == N_harq) ? 0.0 : (double)totals.counter[j][LTE_FDD_ENB_METRIC_PUSCH_CRC_FAILS]/N_harq);
+    }
+}
+void LTE_fdd_enb_metrics::report_msgqs(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep)
+{
+    std::lock_guard<std::mutex>                lock(msgqs_mutex);
+    std::vector<std::string>                   labels;
+    std::vector<LTE_FDD_ENB_MSGQ_STATS_STRUCT> stats(msgqs.size());
+    uint32                                     i;
+
+    for(i=0; i<msgqs.size(); i++)
+    {
+        msgqs[i]->get_stats(&stats[i]);
+        labels.push_back("queue=\"" + msgqs[i]->get_name() + "\"");
+    }
+
+    add_family(rep, "msgq_depth", "gauge", "Messages waiting in the queue");
+    for(i=0; i<stats.size(); i++)
+        add_sample(rep, "msgq_depth", labels[i], (stats[i].N_sent > stats[i].N_received) ? stats[i].N_sent - stats[i].N_received : 0);
+    add_family(rep, "msgq_max_depth", "gauge", "Most messages ever waiting in the queue");
+    for(i=0; i<stats.size(); i++)
+        add_sample(rep, "msgq_max_depth", labels[i], (uint64)stats[i].max_depth);
+    add_family(rep, "msgq_capacity", "gauge", "Messages the queue can hold");
+    for(i=0; i<stats.size(); i++)
+        add_sample(rep, "msgq_capacity", labels[i], (uint64)stats[i].capacity);
+    add_family(rep, "msgq_sent_total", "counter", "Messages sent on the queue");
+    for(i=0; i<stats.size(); i++)
+        add_sample(rep, "msgq_sent_total", labels[i], stats[i].N_sent);
+    add_family(rep, "msgq_dropped_total", "counter", "Messages dropped because the queue was full");
+    for(i=0; i<stats.size(); i++)
+        add_sample(rep, "msgq_dropped_total", labels[i], stats[i].N_dropped);
+    add_family(rep, "msgq_full_waits_total", "counter", "Sends that waited for room in the queue");
+    for(i=0; i<stats.size(); i++)
+        add_sample(rep, "msgq_full_waits_total", labels[i], stats[i].N_full_waits);
+}
+void LTE_fdd_enb_metrics::report_msg_pool(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep)
+{
+    LTE_FDD_ENB_MSG_POOL_STATS_STRUCT stats;
+    uint32                            i;
+
+    LTE_fdd_enb_msg_pool::get_stats(&stats);
+
+    add_family(rep, "msg_pool_in_use", "gauge", "Pooled message buffers in use");
+    for(i=0; i<LTE_FDD_ENB_MSG_POOL_N_ITEMS; i++)
+        add_sample(rep, "msg_pool_in_use", "class=\"" + std::string(LTE_fdd_enb_msg_pool_text[i]) + "\"", (uint64)stats.N_in_use[i]);
+    add_family(rep, "msg_pool_exhausted_total", "counter", "Message buffers served from the heap because the pool was empty");
+    for(i=0; i<LTE_FDD_ENB_MSG_POOL_N_ITEMS; i++)
+        add_sample(rep, "msg_pool_exhausted_total", "class=\"" + std::string(LTE_fdd_enb_msg_pool_text[i]) + "\"", stats.N_exhausted[i]);
+}
+void LTE_fdd_enb_metrics::report_users(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep)
+{
+    std::vector<LTE_FDD_ENB_USER_TRAFFIC_STRUCT> traffic;
+    std::vector<std::string>                     labels;
+    uint32                                       i;
+
+    user_mgr->get_user_traffic(traffic);
+    for(i=0; i<traffic.size(); i++)
+    {
+        labels.push_back("rnti=\"" + std::to_string(traffic[i].c_rnti) + "\"");
+        if(!traffic[i].imsi.empty())
+            labels[i] += ",imsi=\"" + traffic[i].imsi + "\"";
+    }
+
+    add_family(rep, "user_dl_bytes_total", "counter", "Bytes scheduled to the user on the DL-SCH");
+    for(i=0; i<traffic.size(); i++)
+        add_sample(rep, "user_dl_bytes_total", labels[i], traffic[i].N_dl_bytes);
+    add_family(rep, "user_ul_bytes_total", "counter", "Bytes received from the user on the UL-SCH");
+    for(i=0; i<traffic.size(); i++)
+        add_sample(rep, "user_ul_bytes_total", labels[i], traffic[i].N_ul_bytes);
+}
+void LTE_fdd_enb_metrics::report_threads(LTE_FDD_ENB_METRICS_REPORT_STRUCT *rep)
+{
+    std::map<std::string, LTE_FDD_ENB_THREAD_LAYOUT_STRUCT> layout;
+    std::vector<std::string>                                labels;
+    std::vector<uint64>                                     utime;
+    std::vector<uint64>                                     stime;
+    double                                                  ticks = sysconf(_SC_CLK_TCK);
+    uint64                                                  u;
+    uint64                                                  s;
+    uint32                                                  i;
+
+    interface->get_thread_layout(layout);
+    for(auto &thread : layout)
+    {
+        if(!read_thread_cpu(thread.second.tid, &u, &s))
+            continue;
+        labels.push_back("thread=\"" + thread.first + "\",class=\"" + LTE_fdd_enb_thread_text[thread.second.thread_class] + "\"");
+        utime.push_back(u);
+        stime.push_back(s);
+    }
+
+    add_family(rep, "thread_cpu_seconds_total", "counter", "CPU time used by the thread");
+    for(i=0; i<labels.size(); i++)
+    {
+        add_sample(rep, "thread_cpu_seconds_total", labels[i] + ",mode=\"user\"", utime[i]/ticks);
+        add_sample(rep, "thread_cpu_seconds_total", labels[i] + ",mode=\"system\"", stime[i]/ticks);
+    }
+}
+
+/***********************/
+/*    Configuration    */
+/***********************/
+void LTE_fdd_enb_metrics::set_dump(std::string                     file,
+                                   uint32                          period_s,
+                                   LTE_FDD_ENB_METRICS_FORMAT_ENUM format)
+{
+    std::lock_guard<std::mutex> lock(cnfg_mutex);
+
+    if(file != dump_file)
+        dump_failed = false;
+    dump_file   = file;
+    dump_period = period_s;
+    dump_format = format;
+}
+
+/**************/
+/*    Dump    */
+/**************/
+void* LTE_fdd_enb_metrics::dump_thread(void *inputs)
+{
+    LTE_fdd_enb_metrics             *metrics   = (LTE_fdd_enb_metrics *)inputs;
+    std::string                      file;
+    LTE_FDD_ENB_METRICS_FORMAT_ENUM  format;
+    struct timeval                   now;
+    uint32                           period;
+    time_t                           next_dump = 0;
+
+    metrics->interface->setup_thread(LTE_FDD_ENB_THREAD_STACK, 0, "metrics");
+
+    while(metrics->running.load())
+    {
+        usleep(LTE_FDD_ENB_METRICS_POLL_US);
+
+        metrics->cnfg_mutex.lock();
+        file   = metrics->dump_file;
+        period = metrics->dump_period;
+        format = metrics->dump_format;
+        metrics->cnfg_mutex.unlock();
+        if(0 == period)
+        {
+            next_dump = 0;
+            continue;
+        }
+
+        // Dumps line up with multiples of the period
+        gettimeofday(&now, NULL);
+        if(now.tv_sec < next_dump)
+            continue;
+        if(0 != next_dump)
+            metrics->dump(file, format);
+        next_dump = (now.tv_sec/period + 1)*period;
+    }
+
+    return NULL;
+}
+void LTE_fdd_enb_metrics::dump(std::string                     file,
+                               LTE_FDD_ENB_METRICS_FORMAT_ENUM format)
+{
+    std::string  out      = report(format);
+    std::string  tmp_file = file + ".tmp";
+    FILE        *dump_fp;
+    int32        err      = 0;
+
+    // Readers only ever see a complete report
+    dump_fp = fopen(tmp_file.c_str(), "w");
+    if(NULL == dump_fp)
+    {
+        err = errno;
+    }else{
+        if(out.size() != fwrite(out.c_str(), 1, out.size(), dump_fp))
+            err = errno;
+        if(0 != fclose(dump_fp) && 0 == err)
+            err = errno;
+        if(0 == err && 0 != rename(tmp_file.c_str(), file.c_str()))
+            err = errno;
+    }
+
+    // Only the first failure for a file is logged
+    std::lock_guard<std::mutex> lock(cnfg_mutex);
+    if(0 != err && !dump_failed)
+        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
+                                  LTE_FDD_ENB_DEBUG_LEVEL_IFACE,
+                                  __FILE__,
+                                  __LINE__,
+                                  "Couldn't write metrics file %s: %s",
+                                  file.c_str(),
+                                  strerror(err));
+    dump_failed = (0 != err);
+}
@@ -107,7 +107,7 @@ LTE_fdd_enb_mme::~LTE_fdd_enb_mme()
 /*    Start/Stop    */
 /********************/
 void LTE_fdd_enb_mme::start(LTE_fdd_enb_msgq *from_rrc,
-                            LTE_fdd_enb_msgq *to_rrc)
+                            LTE_fdd_enb_msgq **to_rrc)
 {
     std::lock_guard<std::mutex> lock(start_mutex);
     LTE_fdd_enb_msgq_cb         rrc_cb(&LTE_fdd_enb_msgq_cb_wrapper<LTE_fdd_enb_mme, &LTE_fdd_enb_mme::handle_rrc_msg>, this);
@@ -117,7 +117,8 @@ void LTE_fdd_enb_mme::start(LTE_fdd_enb_msgq *from_rrc,
 
     started       = true;
     msgq_from_rrc = from_rrc;
-    msgq_to_rrc   = to_rrc;
+    for(uint32 i=0; i<LTE_FDD_ENB_MAX_N_CELLS; i++)
+        msgq_to_rrc[i] = to_rrc[i];
     msgq_from_rrc->attach_rx(rrc_cb);
 
     next_ip_addr = interface->get_ip_addr_start();
@@ -192,10 +193,10 @@ void LTE_fdd_enb_mme::send_rrc_nas_msg_ready(LTE_fdd_enb_user       *user,
 
     nas_msg_ready.user = user;
     nas_msg_ready.rb   = rb;
-    msgq_to_rrc->send(LTE_FDD_ENB_MESSAGE_TYPE_RRC_NAS_MSG_READY,
-                      LTE_FDD_ENB_DEST_LAYER_RRC,
-                      (LTE_FDD_ENB_MESSAGE_UNION *)&nas_msg_ready,
-                      sizeof(nas_msg_ready));
+    msgq_to_rrc[user->get_cell()]->send(LTE_FDD_ENB_MESSAGE_TYPE_RRC_NAS_MSG_READY,
+                                        LTE_FDD_ENB_DEST_LAYER_RRC,
+                                        (LTE_FDD_ENB_MESSAGE_UNION *)&nas_msg_ready,
+                                        sizeof(nas_msg_ready));
 }
 
 /****************************/
@@ -1445,10 +1446,10 @@ void LTE_fdd_enb_mme::send_tracking_area_update_reject(LTE_fdd_enb_user *user,
      // Signal RRC for NAS message
      nas_msg_ready.user = user;
      nas_msg_ready.rb   = rb;
-     msgq_to_rrc->send(LTE_FDD_ENB_MESSAGE_TYPE_RRC_NAS_MSG_READY,
-                       LTE_FDD_ENB_DEST_LAYER_RRC,
-                       (LTE_FDD_ENB_MESSAGE_UNION *)&nas_msg_ready,
-                       sizeof(LTE_FDD_ENB_RRC_NAS_MSG_READY_MSG_STRUCT));
+     msgq_to_rrc[user->get_cell()]->send(LTE_FDD_ENB_MESSAGE_TYPE_RRC_NAS_MSG_READY,
+                                         LTE_FDD_ENB_DEST_LAYER_RRC,
+                                         (LTE_FDD_ENB_MESSAGE_UNION *)&nas_msg_ready,
+                                         sizeof(LTE_FDD_ENB_RRC_NAS_MSG_READY_MSG_STRUCT));
      send_rrc_command(user, rb, LTE_FDD_ENB_RRC_CMD_RELEASE);
 // Unpack the message
    liblte_mme_unpack_tracking_area_update_reject_msg(&msg, &ta_update_rej);
@@ -1832,10 +1833,10 @@ void LTE_fdd_enb_mme::send_rrc_command(LTE_fdd_enb_user         *user,
     cmd_ready.user = user;
     cmd_ready.rb   = rb;
     cmd_ready.cmd  = cmd;
-    msgq_to_rrc->send(LTE_FDD_ENB_MESSAGE_TYPE_RRC_CMD_READY,
-                      LTE_FDD_ENB_DEST_LAYER_RRC,
-                      (LTE_FDD_ENB_MESSAGE_UNION *)&cmd_ready,
-                      sizeof(cmd_ready));
+    msgq_to_rrc[user->get_cell()]->send(LTE_FDD_ENB_MESSAGE_TYPE_RRC_CMD_READY,
+                                        LTE_FDD_ENB_DEST_LAYER_RRC,
+                                        (LTE_FDD_ENB_MESSAGE_UNION *)&cmd_ready,
+                                        sizeof(cmd_ready));
 }
 
 /*****************/
@@ -0,0 +1,345 @@
+#line 2 "LTE_fdd_enb_msg_pool.cc" // Make __FILE__ omit the path
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_msg_pool.cc
+
+    Description: Contains all the implementations for the LTE FDD eNodeB
+                 message buffer pools.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "LTE_fdd_enb_msg_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <new>
+#include <cstddef>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+#define LTE_FDD_ENB_MSG_POOL_NULL_IDX 0xFFFFFFFF
+
+// Marks a buffer that came from the heap
+#define LTE_FDD_ENB_MSG_POOL_HEAP LTE_FDD_ENB_MSG_POOL_N_ITEMS
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+// Sits in front of every object, keeps the object 16 byte aligned
+typedef struct{
+    std::atomic<uint32> next; // Shared free list link
+    uint32              pool;
+    uint32              idx;
+    uint32              pad;
+}LTE_FDD_ENB_MSG_POOL_BUF_HDR_STRUCT;
+
+// free_head holds an ABA tag in the upper 32 bits and the index of the
+// top buffer in the lower 32 bits
+typedef struct{
+    uint8               *arena;
+    uint32               buf_size;
+    uint32               N_bufs;
+    std::atomic<uint64>  free_head;
+    std::atomic<uint64>  N_allocs;
+    std::atomic<uint64>  N_exhausted;
+    std::atomic<uint32>  N_in_use;
+    std::atomic<uint32>  max_in_use;
+}LTE_FDD_ENB_MSG_POOL_CLASS_STRUCT;
+
+// Per thread stash of free buffer indices, handed back to the shared
+// pools when the thread exits
+class LTE_fdd_enb_msg_pool_cache
+{
+public:
+    LTE_fdd_enb_msg_pool_cache();
+    ~LTE_fdd_enb_msg_pool_cache();
+
+    uint32 N_idx[LTE_FDD_ENB_MSG_POOL_N_ITEMS];
+    uint32 idx[LTE_FDD_ENB_MSG_POOL_N_ITEMS][LTE_FDD_ENB_MSG_POOL_CACHE_SIZE];
+};
+
+/*******************************************************************************
+                              GLOBAL VARIABLES
+*******************************************************************************/
+
+static const uint32 class_bytes[LTE_FDD_ENB_MSG_POOL_N_ITEMS] = {LTE_FDD_ENB_MSG_POOL_SMALL_BYTES,
+                                                                 LTE_FDD_ENB_MSG_POOL_MEDIUM_BYTES,
+                                                                 LTE_FDD_ENB_MSG_POOL_LARGE_BYTES};
+static const uint32 class_N_bufs[LTE_FDD_ENB_MSG_POOL_N_ITEMS] = {LTE_FDD_ENB_MSG_POOL_N_SMALL,
+                                                                  LTE_FDD_ENB_MSG_POOL_N_MEDIUM,
+                                                                  LTE_FDD_ENB_MSG_POOL_N_LARGE};
+
+static LTE_FDD_ENB_MSG_POOL_CLASS_STRUCT       pools[LTE_FDD_ENB_MSG_POOL_N_ITEMS];
+static std::once_flag                          pools_once;
+static std::atomic<uint64>                     N_oversize{0};
+static std::atomic<uint32>                     N_heap_in_use{0};
+static thread_local LTE_fdd_enb_msg_pool_cache cache;
+
+/*******************************************************************************
+                              LOCAL FUNCTIONS
+*******************************************************************************/
+
+static void init_pools()
+{
+    uint32 i;
+    uint32 j;
+
+    for(i=0; i<LTE_FDD_ENB_MSG_POOL_N_ITEMS; i++)
+    {
+        LTE_FDD_ENB_MSG_POOL_CLASS_STRUCT *pool = &pools[i];
+
+        pool->buf_size = sizeof(LTE_FDD_ENB_MSG_POOL_BUF_HDR_STRUCT) + LTE_FDD_ENB_MSG_POOL_HDR_BYTES + class_bytes[i];
+        pool->buf_size = (pool->buf_size + 15) & ~15;
+        pool->N_bufs   = class_N_bufs[i];
+        pool->arena    = new uint8[pool->buf_size * pool->N_bufs];
+        for(j=0; j<pool->N_bufs; j++)
+        {
+            LTE_FDD_ENB_MSG_POOL_BUF_HDR_STRUCT *hdr = new(&pool->arena[j*pool->buf_size]) LTE_FDD_ENB_MSG_POOL_BUF_HDR_STRUCT;
+            hdr->next.store((j+1 < pool->N_bufs) ? j+1 : LTE_FDD_ENB_MSG_POOL_NULL_IDX, std::memory_order_relaxed);
+            hdr->pool = i;
+            hdr->idx  = j;
+        }
+        pool->free_head.store(0);
+        pool->N_allocs.store(0);
+        pool->N_exhausted.store(0);
+        pool->N_in_use.store(0);
+        pool->max_in_use.store(0);
+    }
+}
+static inline LTE_FDD_ENB_MSG_POOL_BUF_HDR_STRUCT* get_hdr(LTE_FDD_ENB_MSG_POOL_CLASS_STRUCT *pool,
+                                                           uint32                             idx)
+{
+    return (LTE_FDD_ENB_MSG_POOL_BUF_HDR_STRUCT *)&pool->arena[idx*pool->buf_size];
+}
+// Buffers are never returned to the heap, so reading next from a buffer
+// another thread just popped is harmless and the tag makes the CAS fail
+static uint32 pop_shared(LTE_FDD_ENB_MSG_POOL_CLASS_STRUCT *pool)
+{
+    uint64 cur = pool->free_head.load();
+    uint32 idx;
+
+    while(LTE_FDD_ENB_MSG_POOL_NULL_IDX != (idx = (uint32)cur))
+    {
+        uint64 next = ((cur >> 32) + 1) << 32 | get_hdr(pool, idx)->next.load(std::memory_order_relaxed);
+        if(pool->free_head.compare_exchange_weak(cur, next))
+            break;
+    }
+    return idx;
+}
+static void push_shared(LTE_FDD_ENB_MSG_POOL_CLASS_STRUCT *pool,
+                        uint32                             idx)
+{
+    LTE_FDD_ENB_MSG_POOL_BUF_HDR_STRUCT *hdr = get_hdr(pool, idx);
+    uint64                               cur = pool->free_head.load();
+    uint64                               next;
+
+    do
+    {
+        hdr->next.store((uint32)cur, std::memory_order_relaxed);
+        next = ((cur >> 32) + 1) << 32 | idx;
+    }while(!pool->free_head.compare_exchange_weak(cur, next));
+}
+static void* alloc_heap(uint32 size)
+{
+    LTE_FDD_ENB_MSG_POOL_BUF_HDR_STRUCT *hdr = new(new uint8[sizeof(LTE_FDD_ENB_MSG_POOL_BUF_HDR_STRUCT) + size]) LTE_FDD_ENB_MSG_POOL_BUF_HDR_STRUCT;
+
+    hdr->pool = LTE_FDD_ENB_MSG_POOL_HEAP;
+    hdr->idx  = LTE_FDD_ENB_MSG_POOL_NULL_IDX;
+    N_heap_in_use.fetch_add(1, std::memory_order_relaxed);
+    return hdr + 1;
+}
+
+/*******************************************************************************
+                              CLASS IMPLEMENTATIONS
+*******************************************************************************/
+
+/***************/
+/*    Cache    */
+/***************/
+LTE_fdd_enb_msg_pool_cache::LTE_fdd_enb_msg_pool_cache()
+{
+    for(uint32 i=0; i<LTE_FDD_ENB_MSG_POOL_N_ITEMS; i++)
+        N_idx[i] = 0;
+}
+LTE_fdd_enb_msg_pool_cache::~LTE_fdd_enb_msg_pool_cache()
+{
+    for(uint32 i=0; i<LTE_FDD_ENB_MSG_POOL_N_ITEMS; i++)
+        while(0 != N_idx[i])
+            push_shared(&pools[i], idx[i][--N_idx[i]]);
+}
+
+/*****************/
+/*    Buffers    */
+/*****************/
+void* LTE_fdd_enb_msg_pool::alloc(uint32 size)
+{
+    LTE_FDD_ENB_MSG_POOL_CLASS_STRUCT *pool;
+    uint32                             c;
+    uint32                             idx;
+
+    std::call_once(pools_once, init_pools);
+
+    for(c=0; c<LTE_FDD_ENB_MSG_POOL_N_ITEMS; c++)
+        if(size <= LTE_FDD_ENB_MSG_POOL_HDR_BYTES + class_bytes[c])
+            break;
+    if(LTE_FDD_ENB_MSG_POOL_N_ITEMS == c)
+    {
+        N_oversize.fetch_add(1, std::memory_order_relaxed);
+        return alloc_heap(size);
+    }
+    pool = &pools[c];
+
+    // Refill half the cache at a time so a thread that only frees and a
+    // thread that only allocates do not bounce on the shared pool
+    if(0 == cache.N_idx[c])
+    {
+        while(cache.N_idx[c] < LTE_FDD_ENB_MSG_POOL_CACHE_SIZE/2 &&
+              LTE_FDD_ENB_MSG_POOL_NULL_IDX != (idx = pop_shared(pool)))
+            cache.idx[c][cache.N_idx[c]++] = idx;
+    }
+    if(0 == cache.N_idx[c])
+    {
+        pool->N_exhausted.fetch_add(1, std::memory_order_relaxed);
+        return alloc_heap(size);
+    }
+    idx = cache.idx[c][--cache.N_idx[c]];
+
+    pool->N_allocs.fetch_add(1, std::memory_order_relaxed);
+    uint32 N_in_use = pool->N_in_use.fetch_add(1, std::memory_order_relaxed) + 1;
+    if(N_in_use > pool->max_in_use.load(std::memory_order_relaxed))
+        pool->max_in_use.store(N_in_use, std::memory_order_relaxed);
+    return get_hdr(pool, idx) + 1;
+}
+void LTE_fdd_enb_msg_pool::free(void *obj)
+{
+    LTE_FDD_ENB_MSG_POOL_BUF_HDR_STRUCT *hdr;
+    LTE_FDD_ENB_MSG_POOL_CLASS_STRUCT   *pool;
+    uint32                               c;
+
+    if(NULL == obj)
+        return;
+
+    hdr = (LTE_FDD_ENB_MSG_POOL_BUF_HDR_STRUCT *)obj - 1;
+    if(LTE_FDD_ENB_MSG_POOL_HEAP == hdr->pool)
+    {
+        N_heap_in_use.fetch_sub(1, std::memory_order_relaxed);
+        delete [] (uint8 *)hdr;
+        return;
+    }
+
+    c    = hdr->pool;
+    pool = &pools[c];
+    pool->N_in_use.fetch_sub(1, std::memory_order_relaxed);
+    if(LTE_FDD_ENB_MSG_POOL_CACHE_SIZE == cache.N_idx[c])
+    {
+        while(LTE_FDD_ENB_MSG_POOL_CACHE_SIZE/2 < cache.N_idx[c])
+            push_shared(pool, cache.idx[c][--cache.N_idx[c]]);
+    }
+    cache.idx[c][cache.N_idx[c]++] = hdr->idx;
+}
+
+/******************/
+/*    Messages    */
+/******************/
+LIBLTE_BYTE_MSG_STRUCT* LTE_fdd_enb_msg_pool::copy_byte_msg(LIBLTE_BYTE_MSG_STRUCT *msg)
+{
+    uint32                  size    = offsetof(LIBLTE_BYTE_MSG_STRUCT, msg) + msg->N_bytes;
+    LIBLTE_BYTE_MSG_STRUCT *new_msg = (LIBLTE_BYTE_MSG_STRUCT *)alloc(size);
+
+    memcpy(new_msg, msg, size);
+    return new_msg;
+}
+LIBLTE_BIT_MSG_STRUCT* LTE_fdd_enb_msg_pool::copy_bit_msg(LIBLTE_BIT_MSG_STRUCT *msg)
+{
+    uint32                 size    = offsetof(LIBLTE_BIT_MSG_STRUCT, msg) + msg->N_bits;
+    LIBLTE_BIT_MSG_STRUCT *new_msg = (LIBLTE_BIT_MSG_STRUCT *)alloc(size);
+
+    memcpy(new_msg, msg, size);
+    return new_msg;
+}
+LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT* LTE_fdd_enb_msg_pool::copy_amd_pdu(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *amd_pdu)
+{
+    uint32                            size    = offsetof(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT, data.msg) + amd_pdu->data.N_bytes;
+    LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *new_pdu = (LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *)alloc(size);
+
+    memcpy(new_pdu, amd_pdu, size);
+    return new_pdu;
+}
+// Only hdr and data[0] are backed, data[0] holds data[idx] of umd_pdu
+LIBLTE_RLC_UMD_PDU_STRUCT* LTE_fdd_enb_msg_pool::copy_umd_pdu(LIBLTE_RLC_UMD_PDU_STRUCT *umd_pdu,
+                                                              uint32                     idx)
+{
+    uint32                     size    = offsetof(LIBLTE_RLC_UMD_PDU_STRUCT, data[0].msg) + umd_pdu->data[idx].N_bytes;
+    LIBLTE_RLC_UMD_PDU_STRUCT *new_pdu = (LIBLTE_RLC_UMD_PDU_STRUCT *)alloc(size);
+
+    memcpy(&new_pdu->hdr, &umd_pdu->hdr, sizeof(LIBLTE_RLC_UMD_PDU_HEADER_STRUCT));
+    memcpy(&new_pdu->data[0], &umd_pdu->data[idx], offsetof(LIBLTE_BYTE_MSG_STRUCT, msg) + umd_pdu->data[idx].N_bytes);
+    return new_pdu;
+}
+
+/**********************/
+/*    Byte Buffers    */
+/**********************/
+LIBLTE_BYTE_BUF_STRUCT* LTE_fdd_enb_msg_pool::alloc_byte_buf(uint32 N_bytes)
+{
+    uint32                  buf_size = std::min(LIBLTE_BYTE_BUF_HEADROOM + N_bytes + LIBLTE_BYTE_BUF_TAILROOM,
+                                                (uint32)(LIBLTE_BYTE_BUF_HEADROOM + LIBLTE_MAX_MSG_SIZE + LIBLTE_BYTE_BUF_TAILROOM));
+    LIBLTE_BYTE_BUF_STRUCT *buf      = (LIBLTE_BYTE_BUF_STRUCT *)alloc(offsetof(LIBLTE_BYTE_BUF_STRUCT, buf) + buf_size);
+
+    liblte_byte_buf_init_sized(buf, buf_size);
+    return buf;
+}
+LIBLTE_BYTE_BUF_STRUCT* LTE_fdd_enb_msg_pool::copy_byte_buf(uint8  *data,
+                                                            uint32  N_bytes)
+{
+    LIBLTE_BYTE_BUF_STRUCT *buf = alloc_byte_buf(N_bytes);
+
+    liblte_byte_buf_append(buf, data, N_bytes);
+    return buf;
+}
+
+/********************/
+/*    Statistics    */
+/********************/
+void LTE_fdd_enb_msg_pool::get_stats(LTE_FDD_ENB_MSG_POOL_STATS_STRUCT *stats)
+{
+    std::call_once(pools_once, init_pools);
+
+    for(uint32 i=0; i<LTE_FDD_ENB_MSG_POOL_N_ITEMS; i++)
+    {
+        stats->N_allocs[i]    = pools[i].N_allocs.load(std::memory_order_relaxed);
+        stats->N_exhausted[i] = pools[i].N_exhausted.load(std::memory_order_relaxed);
+        stats->N_bufs[i]      = pools[i].N_bufs;
+        stats->N_in_use[i]    = pools[i].N_in_use.load(std::memory_order_relaxed);
+        stats->max_in_use[i]  = pools[i].max_in_use.load(std::memory_order_relaxed);
+    }
+    stats->N_oversize    = N_oversize.load(std::memory_order_relaxed);
+    stats->N_heap_in_use = N_heap_in_use.load(std::memory_order_relaxed);
+}
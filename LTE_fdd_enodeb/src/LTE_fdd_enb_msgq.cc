@@ -50,12 +50,24 @@
 
 #include "LTE_fdd_enb_interface.h"
 #include "LTE_fdd_enb_msgq.h"
+#include "LTE_fdd_enb_event_loop.h"
 #include <thread>
+#include <climits>
+#include <new>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 /*******************************************************************************
                               DEFINES
 *******************************************************************************/
 
+// A blocked sender gives up after this long, two full queues feeding each
+// other would otherwise deadlock
+#define LTE_FDD_ENB_MSGQ_MAX_BLOCK_US 100000
+
+// Free list terminator
+#define LTE_FDD_ENB_MSGQ_NULL_BUF 0xFFFFFFFF
 
 /*******************************************************************************
                               TYPEDEFS
@@ -67,6 +79,99 @@
 *******************************************************************************/
 
 
+/*******************************************************************************
+                              LOCAL FUNCTIONS
+*******************************************************************************/
+
+static void futex_wait(std::atomic<uint32> *word,
+                       uint32               val,
+                       struct timespec     *timeout)
+{
+    syscall(SYS_futex, (uint32 *)word, FUTEX_WAIT_PRIVATE, val, timeout, NULL, 0);
+}
+static uint64 now_us()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return((uint64)now.tv_sec*1000000 + now.tv_nsec/1000);
+}
+static void futex_wake(std::atomic<uint32> *word,
+                       int32                N_waiters)
+{
+    syscall(SYS_futex, (uint32 *)word, FUTEX_WAKE_PRIVATE, N_waiters, NULL, NULL, 0);
+}
+static LTE_FDD_ENB_MSGQ_POOL_ENUM get_pool(LTE_FDD_ENB_MESSAGE_TYPE_ENUM type)
+{
+    switch(type)
+    {
+    case LTE_FDD_ENB_MESSAGE_TYPE_PHY_SCHEDULE:
+        return LTE_FDD_ENB_MSGQ_POOL_SCHEDULE;
+    case LTE_FDD_ENB_MESSAGE_TYPE_PUCCH_DECODE:
+    case LTE_FDD_ENB_MESSAGE_TYPE_PUSCH_DECODE:
+        return LTE_FDD_ENB_MSGQ_POOL_DECODE;
+    default:
+        return LTE_FDD_ENB_MSGQ_POOL_SMALL;
+    }
+}
+static uint32 get_content_size(LTE_FDD_ENB_MESSAGE_TYPE_ENUM type)
+{
+    switch(type)
+    {
+    case LTE_FDD_ENB_MESSAGE_TYPE_PHY_SCHEDULE:
+        return sizeof(LTE_FDD_ENB_PHY_SCHEDULE_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_READY_TO_SEND:
+        return sizeof(LTE_FDD_ENB_READY_TO_SEND_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_PRACH_DECODE:
+        return sizeof(LTE_FDD_ENB_PRACH_DECODE_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_PUCCH_DECODE:
+        return sizeof(LTE_FDD_ENB_PUCCH_DECODE_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_PUSCH_DECODE:
+        return sizeof(LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_MAC_SDU_READY:
+        return sizeof(LTE_FDD_ENB_MAC_SDU_READY_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_RLC_PDU_READY:
+        return sizeof(LTE_FDD_ENB_RLC_PDU_READY_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_TIMER_TICK:
+        return sizeof(LTE_FDD_ENB_TIMER_TICK_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_RLC_SDU_READY:
+        return sizeof(LTE_FDD_ENB_RLC_SDU_READY_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_PDCP_PDU_READY:
+        return sizeof(LTE_FDD_ENB_PDCP_PDU_READY_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_PDCP_SDU_READY:
+        return sizeof(LTE_FDD_ENB_PDCP_SDU_READY_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_RRC_PDU_READY:
+        return sizeof(LTE_FDD_ENB_RRC_PDU_READY_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_RRC_NAS_MSG_READY:
+        return sizeof(LTE_FDD_ENB_RRC_NAS_MSG_READY_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_RRC_CMD_READY:
+        return sizeof(LTE_FDD_ENB_RRC_CMD_READY_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_MME_NAS_MSG_READY:
+        return sizeof(LTE_FDD_ENB_MME_NAS_MSG_READY_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_MME_RRC_CMD_RESP:
+        return sizeof(LTE_FDD_ENB_MME_RRC_CMD_RESP_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_PDCP_DATA_SDU_READY:
+        return sizeof(LTE_FDD_ENB_PDCP_DATA_SDU_READY_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_GW_DATA_READY:
+        return sizeof(LTE_FDD_ENB_GW_DATA_READY_MSG_STRUCT);
+    case LTE_FDD_ENB_MESSAGE_TYPE_KILL:
+    default:
+        return 0;
+    }
+}
+static inline LTE_FDD_ENB_MSGQ_BUF_STRUCT* get_buf(LTE_FDD_ENB_MESSAGE_STRUCT *msg)
+{
+    return (LTE_FDD_ENB_MSGQ_BUF_STRUCT *)((uint8 *)msg - offsetof(LTE_FDD_ENB_MSGQ_BUF_STRUCT, msg));
+}
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
 /*******************************************************************************
                               CLASS IMPLEMENTATIONS
 *******************************************************************************/
@@ -91,14 +196,73 @@ void LTE_fdd_enb_msgq_cb::operator()(LTE_FDD_ENB_MESSAGE_STRUCT &msg)
 /*    Constructor/Destructor    */
 /********************************/
 LTE_fdd_enb_msgq::LTE_fdd_enb_msgq(LTE_fdd_enb_interface *iface, std::string _msgq_name) :
-    interface{iface}, msgq_name{_msgq_name}, rx_setup{false}
+    LTE_fdd_enb_msgq(iface, _msgq_name, LTE_FDD_ENB_MSGQ_DEFAULT_CAPACITY, LTE_FDD_ENB_MSGQ_FULL_BLOCK, false)
 {
-    sem_init(&sync_sem, 0, 1);
-    sem_init(&msg_sem, 0, 1);
-    circ_buf  = new boost::circular_buffer<LTE_FDD_ENB_MESSAGE_STRUCT>(100);
+}
+LTE_fdd_enb_msgq::LTE_fdd_enb_msgq(LTE_fdd_enb_interface      *iface,
+                                   std::string                 _msgq_name,
+                                   uint32                      _capacity,
+                                   LTE_FDD_ENB_MSGQ_FULL_ENUM  _full_policy,
+                                   bool                        _single_producer) :
+    interface{iface}, event_loop{NULL}, msgq_name{_msgq_name}, prio{0}, full_policy{_full_policy},
+    wake_mode{LTE_FDD_ENB_MSGQ_WAKE_FUTEX}, single_producer{_single_producer}, rx_setup{false}
+{
+    uint32 i;
+
+    capacity = 1;
+    while(capacity < _capacity)
+        capacity <<= 1;
+    mask = capacity - 1;
+
+    ring = new LTE_FDD_ENB_MSGQ_SLOT_STRUCT[capacity];
+    for(i=0; i<capacity; i++)
+    {
+        ring[i].seq.store(i, std::memory_order_relaxed);
+        ring[i].msg = NULL;
+    }
+
+    // Every message in the ring holds one buffer, so a pool never needs
+    // more buffers than the ring has slots.  Buffers are only sized for
+    // the largest message type of their pool.
+    for(i=0; i<LTE_FDD_ENB_MSGQ_POOL_N_ITEMS; i++)
+    {
+        pools[i].bufs     = new LTE_FDD_ENB_MSGQ_BUF_STRUCT*[capacity];
+        pools[i].buf_size = offsetof(LTE_FDD_ENB_MSGQ_BUF_STRUCT, msg) + offsetof(LTE_FDD_ENB_MESSAGE_STRUCT, msg);
+        pools[i].free_head.store(LTE_FDD_ENB_MSGQ_NULL_BUF);
+        pools[i].N_empty.store(0);
+        pools[i].N_bufs.store(0);
+    }
+    for(i=0; i<LTE_FDD_ENB_MESSAGE_TYPE_N_ITEMS; i++)
+    {
+        LTE_FDD_ENB_MSGQ_POOL_STRUCT *pool = &pools[get_pool((LTE_FDD_ENB_MESSAGE_TYPE_ENUM)i)];
+        uint32                        size = offsetof(LTE_FDD_ENB_MSGQ_BUF_STRUCT, msg) +
+                                             offsetof(LTE_FDD_ENB_MESSAGE_STRUCT, msg) +
+                                             get_content_size((LTE_FDD_ENB_MESSAGE_TYPE_ENUM)i);
+        if(size > pool->buf_size)
+            pool->buf_size = size;
+    }
+
+    tail.store(0);
+    head.store(0);
+    rx_sleeping.store(0);
+    space_seq.store(0);
+    N_space_waiters.store(0);
+    N_sent.store(0);
+    N_received.store(0);
+    N_dropped.store(0);
+    N_full_waits.store(0);
+    max_depth.store(0);
+
+    interface->add_metrics_msgq(this);
 }
 LTE_fdd_enb_msgq::~LTE_fdd_enb_msgq()
 {
+    uint32 i;
+    uint32 j;
+
+    // The metrics may be reading the stats until this returns
+    interface->remove_metrics_msgq(this);
+
     if(rx_setup)
     {
         send(LTE_FDD_ENB_MESSAGE_TYPE_KILL,
@@ -111,9 +275,13 @@ LTE_fdd_enb_msgq::~LTE_fdd_enb_msgq()
         pthread_join(rx_thread, NULL);
         rx_setup = false;
     }
-    sem_destroy(&msg_sem);
-    sem_destroy(&sync_sem);
-    delete circ_buf;
+    delete [] ring;
+    for(i=0; i<LTE_FDD_ENB_MSGQ_POOL_N_ITEMS; i++)
+    {
+        for(j=0; j<pools[i].N_bufs.load(); j++)
+            delete [] (uint8 *)pools[i].bufs[j];
+        delete [] pools[i].bufs;
+    }
 }
 
 /***************/
@@ -121,16 +289,25 @@ LTE_fdd_enb_msgq::~LTE_fdd_enb_msgq()
 /***************/
 void LTE_fdd_enb_msgq::attach_rx(LTE_fdd_enb_msgq_cb cb)
 {
-    callback = cb;
-    prio     = 0;
-    pthread_create(&rx_thread, NULL, &receive_thread, this);
-    rx_setup = true;
+    attach_rx(cb, 0, LTE_FDD_ENB_MSGQ_WAKE_FUTEX);
 }
 void LTE_fdd_enb_msgq::attach_rx(LTE_fdd_enb_msgq_cb cb,
                                  uint32              _prio)
 {
-    callback = cb;
-    prio     = _prio;
+    attach_rx(cb, _prio, LTE_FDD_ENB_MSGQ_WAKE_FUTEX);
+}
+void LTE_fdd_enb_msgq::attach_rx(LTE_fdd_enb_msgq_cb        cb,
+                                 uint32                     _prio,
+                                 LTE_FDD_ENB_MSGQ_WAKE_ENUM _wake_mode)
+{
+    callback  = cb;
+    prio      = _prio;
+    wake_mode = _wake_mode;
+    if(NULL != event_loop)
+    {
+        event_loop->add_msgq(this);
+        return;
+    }
     pthread_create(&rx_thread, NULL, &receive_thread, this);
     rx_setup = true;
 }
@@ -143,107 +320,409 @@ void LTE_fdd_enb_msgq::send(LTE_FDD_ENB_MESSAGE_TYPE_ENUM  type,
                             LTE_FDD_ENB_MESSAGE_UNION     *msg_content,
                             uint32                         msg_content_size)
 {
-    LTE_FDD_ENB_MESSAGE_STRUCT msg;
+    LTE_FDD_ENB_MESSAGE_STRUCT *msg = alloc_msg(type, dest_layer);
+
+    if(NULL == msg)
+        return;
 
-    msg.type       = type;
-    msg.dest_layer = dest_layer;
     if(msg_content != NULL)
     {
-        memcpy(&msg.msg, msg_content, msg_content_size);
+        memcpy(&msg->msg, msg_content, msg_content_size);
     }
-
-    sem_wait(&sync_sem);
-    circ_buf->push_back(msg);
-    sem_post(&sync_sem);
-    sem_post(&msg_sem);
+    send_msg(msg);
 }
 void LTE_fdd_enb_msgq::send(LTE_FDD_ENB_MESSAGE_TYPE_ENUM       type,
                             LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_sched,
                             LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_sched)
 {
-    LTE_FDD_ENB_MESSAGE_STRUCT msg;
+    LTE_FDD_ENB_MESSAGE_STRUCT *msg = alloc_msg(type, LTE_FDD_ENB_DEST_LAYER_PHY);
 
-    msg.type       = type;
-    msg.dest_layer = LTE_FDD_ENB_DEST_LAYER_PHY;
-    memcpy(&msg.msg.phy_schedule.dl_sched, dl_sched, sizeof(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT));
-    memcpy(&msg.msg.phy_schedule.ul_sched, ul_sched, sizeof(LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT));
+    if(NULL == msg)
+        return;
 
-    sem_wait(&sync_sem);
-    circ_buf->push_back(msg);
-    sem_post(&sync_sem);
-    sem_post(&msg_sem);
+    memcpy(&msg->msg.phy_schedule.dl_sched, dl_sched, sizeof(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT));
+    memcpy(&msg->msg.phy_schedule.ul_sched, ul_sched, sizeof(LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT));
+    send_msg(msg);
 }
 void LTE_fdd_enb_msgq::send(LTE_FDD_ENB_MESSAGE_STRUCT &msg)
 {
-    sem_wait(&sync_sem);
-    circ_buf->push_back(msg);
-    sem_post(&sync_sem);
-    sem_post(&msg_sem);
+    LTE_FDD_ENB_MESSAGE_STRUCT *new_msg = alloc_msg(msg.type, msg.dest_layer);
+
+    if(NULL == new_msg)
+        return;
+
+    // Only the member that matches the type is valid, and only it fits
+    memcpy(&new_msg->msg, &msg.msg, get_content_size(msg.type));
+    send_msg(new_msg);
 }
-void* LTE_fdd_enb_msgq::receive_thread(void *inputs)
+LTE_FDD_ENB_MESSAGE_STRUCT* LTE_fdd_enb_msgq::alloc_msg(LTE_FDD_ENB_MESSAGE_TYPE_ENUM type,
+                                                        LTE_FDD_ENB_DEST_LAYER_ENUM   dest_layer)
 {
-    LTE_fdd_enb_msgq           *msgq      = (LTE_fdd_enb_msgq *)inputs;
-    LTE_FDD_ENB_MESSAGE_STRUCT  msg;
-    struct sched_param          priority;
-    cpu_set_t                   af_mask;
-    int                         sched_policy;
-    uint32                      num_cpus = std::thread::hardware_concurrency();
-    bool                        not_done = true;
+    LTE_FDD_ENB_MSGQ_POOL_ENUM    pool_idx = get_pool(type);
+    LTE_FDD_ENB_MSGQ_POOL_STRUCT *pool     = &pools[pool_idx];
+    LTE_FDD_ENB_MSGQ_BUF_STRUCT  *buf      = pop_buf(pool, pool_idx);
+    uint64                        deadline = 0;
 
-    // Set priority
-    if(msgq->prio != 0)
+    if(NULL == buf)
+    {
+        // Every buffer is queued or being built, wait for the receiver
+        // the same way as for a full ring
+        pool->N_empty.fetch_add(1, std::memory_order_relaxed);
+        while(NULL == buf)
+        {
+            N_space_waiters.fetch_add(1);
+            uint32 space = space_seq.load();
+            buf          = pop_buf(pool, pool_idx);
+            if(NULL == buf &&
+               !wait_for_space(type, space, &deadline))
+            {
+                N_space_waiters.fetch_sub(1);
+                return NULL;
+            }
+            N_space_waiters.fetch_sub(1);
+        }
+    }
+
+    buf->msg.type       = type;
+    buf->msg.dest_layer = dest_layer;
+    return &buf->msg;
+}
+void LTE_fdd_enb_msgq::send_msg(LTE_FDD_ENB_MESSAGE_STRUCT *msg)
+{
+    uint32                        pos;
+    LTE_FDD_ENB_MSGQ_SLOT_STRUCT *slot;
+
+    // Handled on this thread once the current handler returns
+    if(NULL != event_loop &&
+       event_loop->is_current())
     {
-        pthread_getschedparam(msgq->rx_thread, &sched_policy, &priority);
-        priority.sched_priority = sched_get_priority_max(SCHED_FIFO);
-        pthread_setschedparam(msgq->rx_thread, SCHED_FIFO, &priority);
+        N_sent.fetch_add(1, std::memory_order_relaxed);
+        event_loop->run_later(this, msg);
+        return;
+    }
 
-        // Set affinity to the second to the last core for MAC (last core is for PHY/Radio)
-        CPU_ZERO(&af_mask);
-        CPU_SET(num_cpus-2, &af_mask);
-        pthread_setaffinity_np(msgq->rx_thread, sizeof(af_mask), &af_mask);
-    }else{
-        // Set affinity to the third to the last core (last is for PHY/Radio, second to last is for MAC)
-        CPU_ZERO(&af_mask);
-        CPU_SET(num_cpus-3, &af_mask);
-        pthread_setaffinity_np(msgq->rx_thread, sizeof(af_mask), &af_mask);
+    slot = claim_slot(msg->type, &pos);
+
+    if(NULL == slot)
+    {
+        free_msg(msg);
+        return;
+    }
+    publish_slot(slot, pos, msg);
+}
+void LTE_fdd_enb_msgq::free_msg(LTE_FDD_ENB_MESSAGE_STRUCT *msg)
+{
+    push_buf(get_buf(msg));
+}
+LTE_FDD_ENB_MSGQ_BUF_STRUCT* LTE_fdd_enb_msgq::pop_buf(LTE_FDD_ENB_MSGQ_POOL_STRUCT *pool,
+                                                       LTE_FDD_ENB_MSGQ_POOL_ENUM    pool_idx)
+{
+    LTE_FDD_ENB_MSGQ_BUF_STRUCT *buf;
+    uint64                       cur = pool->free_head.load();
+    uint32                       idx;
+
+    // Buffers are never freed while the queue exists, so reading next
+    // from a buffer another sender just popped is harmless and the tag
+    // makes the CAS fail
+    while(LTE_FDD_ENB_MSGQ_NULL_BUF != (idx = (uint32)cur))
+    {
+        uint64 next = ((cur >> 32) + 1) << 32 | pool->bufs[idx]->next.load(std::memory_order_relaxed);
+        if(pool->free_head.compare_exchange_weak(cur, next))
+            return pool->bufs[idx];
     }
 
-    while(not_done)
+    // Grow the pool
+    idx = pool->N_bufs.load();
+    while(idx < capacity)
     {
-        // Wait for a message
-        sem_wait(&msgq->msg_sem);
-        sem_wait(&msgq->sync_sem);
-        if(msgq->circ_buf->size() != 0)
+        if(pool->N_bufs.compare_exchange_weak(idx, idx + 1))
         {
-            while(msgq->circ_buf->size() != 0)
+            // Only the header and the largest message of the pool are
+            // allocated, so the atomic is constructed on its own
+            buf = (LTE_FDD_ENB_MSGQ_BUF_STRUCT *)new uint8[pool->buf_size];
+            new(&buf->next) std::atomic<uint32>(LTE_FDD_ENB_MSGQ_NULL_BUF);
+            buf->idx        = idx;
+            buf->pool       = pool_idx;
+            pool->bufs[idx] = buf;
+            return buf;
+        }
+    }
+    return NULL;
+}
+void LTE_fdd_enb_msgq::push_buf(LTE_FDD_ENB_MSGQ_BUF_STRUCT *buf)
+{
+    LTE_FDD_ENB_MSGQ_POOL_STRUCT *pool = &pools[buf->pool];
+    uint64                        cur  = pool->free_head.load();
+    uint64                        next;
+
+    do
+    {
+        buf->next.store((uint32)cur, std::memory_order_relaxed);
+        next = ((cur >> 32) + 1) << 32 | buf->idx;
+    }while(!pool->free_head.compare_exchange_weak(cur, next));
+}
+bool LTE_fdd_enb_msgq::wait_for_space(LTE_FDD_ENB_MESSAGE_TYPE_ENUM  type,
+                                      uint32                         space,
+                                      uint64                        *deadline)
+{
+    struct timespec timeout = {0, 1000000};
+
+    // The receive thread must always see KILL
+    if(LTE_FDD_ENB_MESSAGE_TYPE_KILL == type)
+    {
+        futex_wait(&space_seq, space, &timeout);
+        return true;
+    }
+
+    // On its own event loop the only receiver is the waiting thread
+    if(LTE_FDD_ENB_MSGQ_FULL_DROP == full_policy ||
+       (NULL != event_loop && event_loop->is_current()))
+    {
+        uint64 N_drops = N_dropped.fetch_add(1, std::memory_order_relaxed) + 1;
+        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_WARNING,
+                                  LTE_FDD_ENB_DEBUG_LEVEL_MSGQ,
+                                  __FILE__,
+                                  __LINE__,
+                                  "%s full, dropped %s (%llu dropped)",
+                                  msgq_name.c_str(),
+                                  LTE_fdd_enb_message_type_text[type],
+                                  N_drops);
+        return false;
+    }
+
+    // Futex waits return early on every wakeup, so the limit is wall time
+    if(0 == *deadline)
+    {
+        N_full_waits.fetch_add(1, std::memory_order_relaxed);
+        *deadline = now_us() + LTE_FDD_ENB_MSGQ_MAX_BLOCK_US;
+    }else if(now_us() >= *deadline){
+        uint64 N_drops = N_dropped.fetch_add(1, std::memory_order_relaxed) + 1;
+        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_WARNING,
+                                  LTE_FDD_ENB_DEBUG_LEVEL_MSGQ,
+                                  __FILE__,
+                                  __LINE__,
+                                  "%s full for %u us, dropped %s (%llu dropped)",
+                                  msgq_name.c_str(),
+                                  LTE_FDD_ENB_MSGQ_MAX_BLOCK_US,
+                                  LTE_fdd_enb_message_type_text[type],
+                                  N_drops);
+        return false;
+    }
+
+    futex_wait(&space_seq, space, &timeout);
+    return true;
+}
+LTE_FDD_ENB_MSGQ_SLOT_STRUCT* LTE_fdd_enb_msgq::claim_slot(LTE_FDD_ENB_MESSAGE_TYPE_ENUM  type,
+                                                           uint32                        *pos)
+{
+    LTE_FDD_ENB_MSGQ_SLOT_STRUCT *slot    = try_claim_slot(pos);
+    uint64                        deadline = 0;
+
+    // Wait for the receive thread to free a slot.  Registering before
+    // sampling space_seq means the receive thread either sees the waiter
+    // or bumps space_seq after the sample.
+    while(NULL == slot)
+    {
+        N_space_waiters.fetch_add(1);
+        uint32 space = space_seq.load();
+        slot         = try_claim_slot(pos);
+        if(NULL == slot &&
+           !wait_for_space(type, space, &deadline))
+        {
+            N_space_waiters.fetch_sub(1);
+            return NULL;
+        }
+        N_space_waiters.fetch_sub(1);
+    }
+    return slot;
+}
+LTE_FDD_ENB_MSGQ_SLOT_STRUCT* LTE_fdd_enb_msgq::try_claim_slot(uint32 *pos)
+{
+    LTE_FDD_ENB_MSGQ_SLOT_STRUCT *slot;
+    uint32                        cur = tail.load(std::memory_order_relaxed);
+
+    while(1)
+    {
+        slot = &ring[cur & mask];
+        int32 dif = (int32)(slot->seq.load(std::memory_order_acquire) - cur);
+        if(0 == dif)
+        {
+            // A lone sender owns the tail, others race for it
+            if(single_producer)
             {
-                msg = msgq->circ_buf->front();
-                msgq->circ_buf->pop_front();
-                sem_post(&msgq->sync_sem);
-
-                // Process message
-                switch(msg.type)
-                {
-                case LTE_FDD_ENB_MESSAGE_TYPE_KILL:
-                    not_done = false;
-                    break;
-                default:
-                    msgq->callback(msg);
-                    break;
-                }
-
-                sem_wait(&msgq->sync_sem);
+                tail.store(cur + 1, std::memory_order_relaxed);
+                break;
             }
+            if(tail.compare_exchange_weak(cur, cur + 1, std::memory_order_relaxed))
+                break;
+        }else if(dif < 0){
+            // The receiver has not freed this slot yet
+            return NULL;
         }else{
-            msgq->interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_WARNING,
-                                            LTE_FDD_ENB_DEBUG_LEVEL_MSGQ,
-                                            __FILE__,
-                                            __LINE__,
-                                            "%s circular buffer empty on receive",
-                                            msgq->msgq_name.c_str());
+            cur = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    uint32 depth = cur + 1 - head.load(std::memory_order_relaxed);
+    if(depth > max_depth.load(std::memory_order_relaxed))
+        max_depth.store(depth, std::memory_order_relaxed);
+    *pos = cur;
+    return slot;
+}
+void LTE_fdd_enb_msgq::publish_slot(LTE_FDD_ENB_MSGQ_SLOT_STRUCT *slot,
+                                    uint32                        pos,
+                                    LTE_FDD_ENB_MESSAGE_STRUCT   *msg)
+{
+    // Sequentially consistent so the store is ordered before the
+    // rx_sleeping check, pairing with wait_for_msg()
+    slot->msg = msg;
+    slot->seq.store(pos + 1);
+    N_sent.fetch_add(1, std::memory_order_relaxed);
+    if(NULL != event_loop)
+        event_loop->wake();
+    else if(0 != rx_sleeping.load() &&
+            0 != rx_sleeping.exchange(0))
+        futex_wake(&rx_sleeping, 1);
+}
+bool LTE_fdd_enb_msgq::is_msg_ready(uint32 pos)
+{
+    return (ring[pos & mask].seq.load() == pos + 1);
+}
+void LTE_fdd_enb_msgq::wait_for_msg()
+{
+    uint32 pos = head.load(std::memory_order_relaxed);
+
+    while(!is_msg_ready(pos))
+    {
+        if(LTE_FDD_ENB_MSGQ_WAKE_BUSY_POLL == wake_mode)
+        {
+            cpu_relax();
+            continue;
         }
-        sem_post(&msgq->sync_sem);
+
+        // Announce the sleep before the final check so a sender either
+        // sees the flag or its message is seen here
+        rx_sleeping.store(1);
+        if(is_msg_ready(pos))
+        {
+            rx_sleeping.store(0);
+            break;
+        }
+        futex_wait(&rx_sleeping, 1, NULL);
+    }
+}
+void* LTE_fdd_enb_msgq::receive_thread(void *inputs)
+{
+    LTE_fdd_enb_msgq        *msgq         = (LTE_fdd_enb_msgq *)inputs;
+    LTE_FDD_ENB_THREAD_ENUM  thread_class = LTE_FDD_ENB_THREAD_STACK;
+    bool                     not_done     = true;
+
+    // Prioritized queues feed the MAC, everything else is the stack
+    if(msgq->prio != 0)
+        thread_class = LTE_FDD_ENB_THREAD_MAC;
+    msgq->interface->setup_thread(thread_class, 0, msgq->msgq_name);
+    if(msgq->interface->get_thread_busy_poll(thread_class))
+        msgq->wake_mode = LTE_FDD_ENB_MSGQ_WAKE_BUSY_POLL;
+
+    while(not_done)
+    {
+        bool kill = false;
+        msgq->wait_for_msg();
+        msgq->receive_msgs(&kill);
+        not_done = !kill;
     }
 
     return NULL;
 }
+
+uint32 LTE_fdd_enb_msgq::receive_msgs(bool *kill)
+{
+    uint32 pos     = head.load(std::memory_order_relaxed);
+    uint32 N_ready = 0;
+
+    // Take everything ready up to a batch
+    while(N_ready < LTE_FDD_ENB_MSGQ_RX_BATCH && is_msg_ready(pos + N_ready))
+        N_ready++;
+    if(0 == N_ready)
+        return 0;
+
+    // The slot goes back to the senders right away, the buffer once its
+    // callback returns.  KILL only stops a receive thread, an event loop
+    // is stopped on its own.
+    for(uint32 i=0; i<N_ready; i++)
+    {
+        LTE_FDD_ENB_MSGQ_SLOT_STRUCT *slot = &ring[(pos + i) & mask];
+        LTE_FDD_ENB_MESSAGE_STRUCT   *msg  = slot->msg;
+        slot->seq.store(pos + i + capacity, std::memory_order_release);
+        switch(msg->type)
+        {
+        case LTE_FDD_ENB_MESSAGE_TYPE_KILL:
+            *kill = true;
+            break;
+        default:
+            callback(*msg);
+            break;
+        }
+        free_msg(msg);
+    }
+    head.store(pos + N_ready, std::memory_order_relaxed);
+    N_received.fetch_add(N_ready, std::memory_order_relaxed);
+    release_space();
+    return N_ready;
+}
+void LTE_fdd_enb_msgq::release_space()
+{
+    // One wake per batch for senders blocked on a full ring or pool
+    space_seq.fetch_add(1);
+    if(0 != N_space_waiters.load())
+        futex_wake(&space_seq, INT_MAX);
+}
+
+/********************/
+/*    Event Loop    */
+/********************/
+void LTE_fdd_enb_msgq::set_event_loop(LTE_fdd_enb_event_loop *loop)
+{
+    event_loop = loop;
+}
+void LTE_fdd_enb_msgq::dispatch_msg(LTE_FDD_ENB_MESSAGE_STRUCT *msg)
+{
+    if(LTE_FDD_ENB_MESSAGE_TYPE_KILL != msg->type)
+        callback(*msg);
+    free_msg(msg);
+    N_received.fetch_add(1, std::memory_order_relaxed);
+    release_space();
+}
+bool LTE_fdd_enb_msgq::is_msg_pending()
+{
+    return is_msg_ready(head.load(std::memory_order_relaxed));
+}
+uint32 LTE_fdd_enb_msgq::get_max_msgs()
+{
+    // Every message in flight holds one pool buffer
+    return capacity * LTE_FDD_ENB_MSGQ_POOL_N_ITEMS;
+}
+
+/********************/
+/*    Statistics    */
+/********************/
+void LTE_fdd_enb_msgq::get_stats(LTE_FDD_ENB_MSGQ_STATS_STRUCT *stats)
+{
+    uint32 i;
+
+    stats->N_sent       = N_sent.load(std::memory_order_relaxed);
+    stats->N_received   = N_received.load(std::memory_order_relaxed);
+    stats->N_dropped    = N_dropped.load(std::memory_order_relaxed);
+    stats->N_full_waits = N_full_waits.load(std::memory_order_relaxed);
+    for(i=0; i<LTE_FDD_ENB_MSGQ_POOL_N_ITEMS; i++)
+    {
+        stats->N_pool_empty[i] = pools[i].N_empty.load(std::memory_order_relaxed);
+        stats->N_bufs[i]       = pools[i].N_bufs.load(std::memory_order_relaxed);
+    }
+    stats->max_depth    = max_depth.load(std::memory_order_relaxed);
+    stats->capacity     = capacity;
+}
+std::string LTE_fdd_enb_msgq::get_name()
+{
+    return msgq_name;
+}
@@ -0,0 +1,551 @@
+#line 2 "LTE_fdd_enb_pcap.cc" // Make __FILE__ omit the path
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_pcap.cc
+
+    Description: Contains all the implementations for the LTE FDD eNodeB pcap
+                 writer.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "LTE_fdd_enb_pcap.h"
+#include "liblte_mac.h"
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+#define LTE_FDD_ENB_PCAP_GLOBAL_HDR_SIZE  24
+#define LTE_FDD_ENB_PCAP_RECORD_HDR_SIZE  16
+#define LTE_FDD_ENB_PCAP_MAC_LTE_HDR_SIZE 15
+#define LTE_FDD_ENB_PCAP_BUF_SIZE         (1 << 20) // Bytes per file, grows if needed
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              GLOBAL VARIABLES
+*******************************************************************************/
+
+static const uint32 dlt[LTE_FDD_ENB_PCAP_LINK_N_ITEMS] = {147,  // MAC-LTE
+                                                          228}; // Raw IPv4
+
+/*******************************************************************************
+                              LOCAL FUNCTIONS
+*******************************************************************************/
+
+static void append_u16(std::vector<uint8> &buf,
+                       uint16              value)
+{
+    uint16 tmp = htons(value);
+    uint8 *c   = (uint8 *)&tmp;
+
+    buf.insert(buf.end(), c, c + sizeof(tmp));
+}
+static void append_u32(std::vector<uint8> &buf,
+                       uint32              value)
+{
+    uint32 tmp = htonl(value);
+    uint8 *c   = (uint8 *)&tmp;
+
+    buf.insert(buf.end(), c, c + sizeof(tmp));
+}
+
+// A whole byte per pass, trailing bits that don't make a byte are dropped
+static void pack_bits(const uint8 *bits,
+                      uint32       N_bytes,
+                      uint8       *bytes)
+{
+    uint32 i;
+
+    for(i=0; i<N_bytes; i++)
+    {
+        bytes[i] = (uint8)((bits[0] << 7) | (bits[1] << 6) | (bits[2] << 5) | (bits[3] << 4) |
+                           (bits[4] << 3) | (bits[5] << 2) | (bits[6] << 1) | bits[7]);
+        bits    += 8;
+    }
+}
+
+/*******************************************************************************
+                              CLASS IMPLEMENTATIONS
+*******************************************************************************/
+
+/********************************/
+/*    Constructor/Destructor    */
+/********************************/
+LTE_fdd_enb_pcap::LTE_fdd_enb_pcap(LTE_fdd_enb_interface *iface) :
+    interface{iface}, ring{new LTE_FDD_ENB_PCAP_SLOT_STRUCT[LTE_FDD_ENB_PCAP_N_SLOTS]},
+    head{0}, file_dir{LTE_FDD_ENB_PCAP_DEFAULT_DIR}, max_size{0}, period{0},
+    N_reported_dropped{0}, started{false}
+{
+    uint32 i;
+
+    for(i=0; i<LTE_FDD_ENB_PCAP_N_SLOTS; i++)
+        ring[i].seq.store(i, std::memory_order_relaxed);
+    for(i=0; i<LTE_FDD_ENB_PCAP_LINK_N_ITEMS; i++)
+    {
+        files[i].buf.reserve(LTE_FDD_ENB_PCAP_BUF_SIZE);
+        files[i].N_bytes   = 0;
+        files[i].open_time = 0;
+        files[i].cnfg_gen  = 0;
+        files[i].idx       = 0;
+        files[i].fd        = -1;
+        files[i].failed    = false;
+    }
+    filter_rnti.store(LTE_FDD_ENB_PCAP_ALL_RNTIS);
+    tail.store(0);
+    N_msgs.store(0);
+    N_dropped.store(0);
+    cnfg_gen.store(0);
+    N_bytes.store(0);
+    N_files.store(0);
+    running.store(false);
+}
+LTE_fdd_enb_pcap::~LTE_fdd_enb_pcap()
+{
+    uint32 i;
+
+    stop();
+    for(i=0; i<LTE_FDD_ENB_PCAP_LINK_N_ITEMS; i++)
+        close_file((LTE_FDD_ENB_PCAP_LINK_ENUM)i);
+    delete [] ring;
+}
+
+/********************/
+/*    Start/Stop    */
+/********************/
+void LTE_fdd_enb_pcap::start()
+{
+    if(started)
+        return;
+    running.store(true);
+    pthread_create(&thread, NULL, &writer_thread, this);
+    started = true;
+}
+void LTE_fdd_enb_pcap::stop()
+{
+    if(!started)
+        return;
+    running.store(false);
+    pthread_join(thread, NULL);
+    started = false;
+}
+
+/*****************/
+/*    Capture    */
+/*****************/
+void LTE_fdd_enb_pcap::send_lte(LTE_FDD_ENB_PCAP_DIRECTION_ENUM  dir,
+                                uint32                           rnti,
+                                uint32                           current_tti,
+                                uint8                           *msg,
+                                uint32                           N_bits)
+{
+    LTE_FDD_ENB_PCAP_SLOT_STRUCT *slot;
+    uint32                        pos;
+
+    slot = claim_slot(rnti, &pos);
+    if(NULL == slot)
+        return;
+
+    gettimeofday(&slot->time, NULL);
+    slot->link        = LTE_FDD_ENB_PCAP_LINK_LTE;
+    slot->dir         = dir;
+    slot->rnti        = rnti;
+    slot->current_tti = current_tti;
+    slot->N_bytes     = N_bits / 8;
+    if(LIBLTE_MAX_MSG_SIZE < slot->N_bytes)
+        slot->N_bytes = LIBLTE_MAX_MSG_SIZE;
+    pack_bits(msg, slot->N_bytes, slot->data);
+    publish_slot(slot, pos);
+}
+void LTE_fdd_enb_pcap::send_ip(uint32  rnti,
+                               uint8  *msg,
+                               uint32  N_bytes)
+{
+    LTE_FDD_ENB_PCAP_SLOT_STRUCT *slot;
+    uint32                        pos;
+
+    slot = claim_slot(rnti, &pos);
+    if(NULL == slot)
+        return;
+
+    gettimeofday(&slot->time, NULL);
+    slot->link        = LTE_FDD_ENB_PCAP_LINK_IP;
+    slot->dir         = LTE_FDD_ENB_PCAP_DIRECTION_UL;
+    slot->rnti        = rnti;
+    slot->current_tti = 0;
+    slot->N_bytes     = N_bytes;
+    if(LIBLTE_MAX_MSG_SIZE < slot->N_bytes)
+        slot->N_bytes = LIBLTE_MAX_MSG_SIZE;
+    memcpy(slot->data, msg, slot->N_bytes);
+    publish_slot(slot, pos);
+}
+LTE_FDD_ENB_PCAP_SLOT_STRUCT* LTE_fdd_enb_pcap::claim_slot(uint32  rnti,
+                                                           uint32 *pos)
+{
+    LTE_FDD_ENB_PCAP_SLOT_STRUCT *slot;
+    uint32                        filter = filter_rnti.load(std::memory_order_relaxed);
+    uint32                        cur    = tail.load(std::memory_order_relaxed);
+
+    // Filtering on a UE leaves out the broadcast RNTIs as well
+    if(LTE_FDD_ENB_PCAP_ALL_RNTIS != filter &&
+       filter                     != rnti)
+        return NULL;
+
+    while(1)
+    {
+        slot = &ring[cur % LTE_FDD_ENB_PCAP_N_SLOTS];
+        int32 dif = (int32)(slot->seq.load(std::memory_order_acquire) - cur);
+        if(0 == dif)
+        {
+            if(tail.compare_exchange_weak(cur, cur + 1, std::memory_order_relaxed))
+                break;
+        }else if(dif < 0){
+            // The writer is behind, capture must never hold up the caller
+            N_dropped.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }else{
+            cur = tail.load(std::memory_order_relaxed);
+        }
+    }
+
+    *pos = cur;
+    return slot;
+}
+void LTE_fdd_enb_pcap::publish_slot(LTE_FDD_ENB_PCAP_SLOT_STRUCT *slot,
+                                    uint32                        pos)
+{
+    slot->seq.store(pos + 1, std::memory_order_release);
+    N_msgs.fetch_add(1, std::memory_order_relaxed);
+}
+
+/***********************/
+/*    Configuration    */
+/***********************/
+void LTE_fdd_enb_pcap::set_dir(std::string _dir)
+{
+    std::lock_guard<std::mutex> lock(cnfg_mutex);
+
+    if(file_dir == _dir)
+        return;
+    file_dir = _dir;
+    cnfg_gen++;
+}
+void LTE_fdd_enb_pcap::set_rotation(uint32 max_size_mb,
+                                    uint32 period_s)
+{
+    std::lock_guard<std::mutex> lock(cnfg_mutex);
+
+    max_size = (uint64)max_size_mb * 1024 * 1024;
+    period   = period_s;
+}
+void LTE_fdd_enb_pcap::set_rnti(uint32 _rnti)
+{
+    filter_rnti.store(_rnti);
+}
+
+/********************/
+/*    Statistics    */
+/********************/
+void LTE_fdd_enb_pcap::get_stats(LTE_FDD_ENB_PCAP_STATS_STRUCT *stats)
+{
+    stats->N_msgs    = N_msgs.load(std::memory_order_relaxed);
+    stats->N_dropped = N_dropped.load(std::memory_order_relaxed);
+    stats->N_bytes   = N_bytes.load(std::memory_order_relaxed);
+    stats->N_files   = N_files.load(std::memory_order_relaxed);
+}
+
+/****************/
+/*    Writer    */
+/****************/
+void* LTE_fdd_enb_pcap::writer_thread(void *inputs)
+{
+    LTE_fdd_enb_pcap *pcap = (LTE_fdd_enb_pcap *)inputs;
+
+    pcap->interface->setup_thread(LTE_FDD_ENB_THREAD_STACK, 0, "pcap");
+
+    // Sleeping between passes is what makes the writes large
+    while(pcap->running.load())
+    {
+        if(LTE_FDD_ENB_PCAP_N_SLOTS > pcap->flush())
+            usleep(LTE_FDD_ENB_PCAP_FLUSH_US);
+    }
+
+    // Whatever was captured before the stop still goes out
+    while(0 != pcap->flush());
+
+    return NULL;
+}
+uint32 LTE_fdd_enb_pcap::flush()
+{
+    LTE_FDD_ENB_PCAP_SLOT_STRUCT *slot;
+    uint64                        dropped;
+    uint32                        N_slots = 0;
+    uint32                        i;
+
+    while(LTE_FDD_ENB_PCAP_N_SLOTS > N_slots)
+    {
+        slot = &ring[head % LTE_FDD_ENB_PCAP_N_SLOTS];
+        if(slot->seq.load(std::memory_order_acquire) != head + 1)
+            break;
+        if(LTE_FDD_ENB_PCAP_LINK_LTE == slot->link)
+            append_lte(slot);
+        else
+            append_ip(slot);
+        slot->seq.store(head + LTE_FDD_ENB_PCAP_N_SLOTS, std::memory_order_release);
+        head++;
+        N_slots++;
+    }
+
+    for(i=0; i<LTE_FDD_ENB_PCAP_LINK_N_ITEMS; i++)
+        write_file((LTE_FDD_ENB_PCAP_LINK_ENUM)i);
+
+    dropped = N_dropped.load(std::memory_order_relaxed);
+    if(dropped != N_reported_dropped)
+    {
+        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_WARNING,
+                                  LTE_FDD_ENB_DEBUG_LEVEL_IFACE,
+                                  __FILE__,
+                                  __LINE__,
+                                  "Dropped %llu pcap messages",
+                                  (unsigned long long)(dropped - N_reported_dropped));
+        N_reported_dropped = dropped;
+    }
+
+    return N_slots;
+}
+void LTE_fdd_enb_pcap::append_lte(LTE_FDD_ENB_PCAP_SLOT_STRUCT *slot)
+{
+    uint8  c_hdr[LTE_FDD_ENB_PCAP_MAC_LTE_HDR_SIZE];
+    uint16 tmp_u16;
+
+    // Radio Type
+    c_hdr[0] = 1;
+
+    // Direction
+    c_hdr[1] = slot->dir;
+
+    // RNTI Type
+    if(0xFFFFFFFF == slot->rnti)
+    {
+        c_hdr[2] = 0;
+    }else if(LIBLTE_MAC_P_RNTI == slot->rnti){
+        c_hdr[2] = 1;
+    }else if(LIBLTE_MAC_RA_RNTI_START <= slot->rnti &&
+             LIBLTE_MAC_RA_RNTI_END   >= slot->rnti){
+        c_hdr[2] = 2;
+    }else if(LIBLTE_MAC_SI_RNTI == slot->rnti){
+        c_hdr[2] = 4;
+    }else if(LIBLTE_MAC_M_RNTI == slot->rnti){
+        c_hdr[2] = 6;
+    }else{
+        c_hdr[2] = 3;
+    }
+
+    // RNTI Tag and RNTI
+    c_hdr[3] = 2;
+    tmp_u16  = htons((uint16)slot->rnti);
+    memcpy(&c_hdr[4], &tmp_u16, sizeof(uint16));
+
+    // UEID Tag and UEID
+    c_hdr[6] = 3;
+    tmp_u16  = htons((uint16)slot->rnti);
+    memcpy(&c_hdr[7], &tmp_u16, sizeof(uint16));
+
+    // SUBFN Tag and SUBFN
+    c_hdr[9] = 4;
+    tmp_u16  = htons((uint16)(((slot->current_tti/10) << 4) | slot->current_tti%10));
+    memcpy(&c_hdr[10], &tmp_u16, sizeof(uint16));
+
+    // CRC Status Tag and CRC Status
+    c_hdr[12] = 7;
+    c_hdr[13] = 1;
+
+    // Payload Tag
+    c_hdr[14] = 1;
+
+    append_record(LTE_FDD_ENB_PCAP_LINK_LTE,
+                  &slot->time,
+                  c_hdr,
+                  LTE_FDD_ENB_PCAP_MAC_LTE_HDR_SIZE,
+                  slot->data,
+                  slot->N_bytes);
+}
+void LTE_fdd_enb_pcap::append_ip(LTE_FDD_ENB_PCAP_SLOT_STRUCT *slot)
+{
+    append_record(LTE_FDD_ENB_PCAP_LINK_IP,
+                  &slot->time,
+                  NULL,
+                  0,
+                  slot->data,
+                  slot->N_bytes);
+}
+void LTE_fdd_enb_pcap::append_record(LTE_FDD_ENB_PCAP_LINK_ENUM  link,
+                                     struct timeval             *time,
+                                     uint8                      *hdr,
+                                     uint32                      N_hdr_bytes,
+                                     uint8                      *data,
+                                     uint32                      N_data_bytes)
+{
+    LTE_FDD_ENB_PCAP_FILE_STRUCT *file   = &files[link];
+    uint32                        length = N_hdr_bytes + N_data_bytes;
+    uint64                        size   = LTE_FDD_ENB_PCAP_RECORD_HDR_SIZE + length;
+    bool                          rotate;
+
+    if(-1 != file->fd)
+    {
+        std::lock_guard<std::mutex> lock(cnfg_mutex);
+
+        // A file always takes at least one record
+        rotate = (file->cnfg_gen != cnfg_gen.load());
+        if(0 != max_size &&
+           LTE_FDD_ENB_PCAP_GLOBAL_HDR_SIZE < file->N_bytes &&
+           max_size < file->N_bytes + size)
+            rotate = true;
+        if(0              != period &&
+           (time_t)period <= time->tv_sec - file->open_time)
+            rotate = true;
+        if(rotate)
+            close_file(link);
+    }
+    if(-1 == file->fd)
+    {
+        // A directory that failed is not retried until it changes
+        if(file->failed &&
+           file->cnfg_gen == cnfg_gen.load())
+            return;
+        open_file(link, time->tv_sec);
+        if(-1 == file->fd)
+            return;
+    }
+
+    append_u32(file->buf, time->tv_sec);
+    append_u32(file->buf, time->tv_usec);
+    append_u32(file->buf, length);
+    append_u32(file->buf, length);
+    if(0 != N_hdr_bytes)
+        file->buf.insert(file->buf.end(), hdr, hdr + N_hdr_bytes);
+    file->buf.insert(file->buf.end(), data, data + N_data_bytes);
+    file->N_bytes += size;
+}
+void LTE_fdd_enb_pcap::open_file(LTE_FDD_ENB_PCAP_LINK_ENUM link,
+                                 time_t                     now)
+{
+    LTE_FDD_ENB_PCAP_FILE_STRUCT *file = &files[link];
+    std::string                   name;
+
+    {
+        std::lock_guard<std::mutex> lock(cnfg_mutex);
+
+        // Rotated files are numbered, a single file keeps the old name
+        name = file_dir + "/" + LTE_fdd_enb_pcap_link_text[link];
+        if(0 != max_size ||
+           0 != period)
+            name += "_" + std::to_string(file->idx);
+        name           += ".pcap";
+        file->cnfg_gen  = cnfg_gen.load();
+    }
+
+    file->fd = open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if(-1 == file->fd)
+    {
+        file->failed = true;
+        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
+                                  LTE_FDD_ENB_DEBUG_LEVEL_IFACE,
+                                  __FILE__,
+                                  __LINE__,
+                                  "Couldn't open pcap file %s: %s",
+                                  name.c_str(),
+                                  strerror(errno));
+        return;
+    }
+    file->failed    = false;
+    file->open_time = now;
+    file->idx++;
+    N_files++;
+
+    // Global Header
+    file->buf.clear();
+    append_u32(file->buf, 0xa1b2c3d4); // Magic Number
+    append_u16(file->buf, 2);          // Major Version
+    append_u16(file->buf, 4);          // Minor Version
+    append_u32(file->buf, 0);          // Time Zone
+    append_u32(file->buf, 0);          // Significant Figures
+    append_u32(file->buf, 0xFFFF);     // Snap Length
+    append_u32(file->buf, dlt[link]);
+    file->N_bytes = LTE_FDD_ENB_PCAP_GLOBAL_HDR_SIZE;
+}
+void LTE_fdd_enb_pcap::close_file(LTE_FDD_ENB_PCAP_LINK_ENUM link)
+{
+    LTE_FDD_ENB_PCAP_FILE_STRUCT *file = &files[link];
+
+    if(-1 == file->fd)
+        return;
+    write_file(link);
+    close(file->fd);
+    file->fd = -1;
+}
+void LTE_fdd_enb_pcap::write_file(LTE_FDD_ENB_PCAP_LINK_ENUM link)
+{
+    LTE_FDD_ENB_PCAP_FILE_STRUCT *file = &files[link];
+    size_t                        idx  = 0;
+    ssize_t                       N_written;
+
+    while(-1 != file->fd &&
+          idx < file->buf.size())
+    {
+        N_written = write(file->fd, &file->buf[idx], file->buf.size() - idx);
+        if(0 > N_written)
+        {
+            if(EINTR == errno)
+                continue;
+            interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
+                                      LTE_FDD_ENB_DEBUG_LEVEL_IFACE,
+                                      __FILE__,
+                                      __LINE__,
+                                      "Couldn't write %s pcap file: %s",
+                                      LTE_fdd_enb_pcap_link_text[link],
+                                      strerror(errno));
+
+            // Like a failed open, nothing more until the directory changes
+            close(file->fd);
+            file->fd     = -1;
+            file->failed = true;
+            break;
+        }
+        idx += N_written;
+    }
+    N_bytes.fetch_add(idx, std::memory_order_relaxed);
+    file->buf.clear();
+}
@@ -47,6 +47,7 @@
 
 #include "LTE_fdd_enb_pdcp.h"
 #include "LTE_fdd_enb_rlc.h"
+#include "LTE_fdd_enb_msg_pool.h"
 #include "liblte_pdcp.h"
 #include "liblte_security.h"
 
@@ -88,7 +89,7 @@ void LTE_fdd_enb_pdcp::start(LTE_fdd_enb_msgq *from_rlc,
                              LTE_fdd_enb_msgq *from_rrc,
                              LTE_fdd_enb_msgq *from_gw,
                              LTE_fdd_enb_msgq *to_rlc,
-                             LTE_fdd_enb_msgq *to_rrc,
+                             LTE_fdd_enb_msgq **to_rrc,
                              LTE_fdd_enb_msgq *to_gw)
 {
     std::lock_guard<std::mutex> lock(start_mutex);
@@ -104,8 +105,9 @@ void LTE_fdd_enb_pdcp::start(LTE_fdd_enb_msgq *from_rlc,
     msgq_from_rrc = from_rrc;
     msgq_from_gw  = from_gw;
     msgq_to_rlc   = to_rlc;
-    msgq_to_rrc   = to_rrc;
     msgq_to_gw    = to_gw;
+    for(uint32 i=0; i<LTE_FDD_ENB_MAX_N_CELLS; i++)
+        msgq_to_rrc[i] = to_rrc[i];
     msgq_from_rlc->attach_rx(rlc_cb);
     msgq_from_rrc->attach_rx(rrc_cb);
     msgq_from_gw->attach_rx(gw_cb);
@@ -125,7 +127,18 @@ void LTE_fdd_enb_pdcp::handle_rlc_msg(LTE_FDD_ENB_MESSAGE_STRUCT &msg)
 {
     if(LTE_FDD_ENB_DEST_LAYER_PDCP != msg.dest_layer &&
        LTE_FDD_ENB_DEST_LAYER_ANY  != msg.dest_layer)
-        return msgq_to_rrc->send(msg); // Forward message to RRC
+    {
+        // Forward message to the user's RRC
+        LTE_fdd_enb_user *user = get_msg_user(msg);
+        if(NULL != user)
+            return msgq_to_rrc[user->get_cell()]->send(msg);
+        return interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
+                                         LTE_FDD_ENB_DEBUG_LEVEL_PDCP,
+                                         __FILE__,
+                                         __LINE__,
+                                         "Can not forward RLC message %s without a user",
+                                         LTE_fdd_enb_message_type_text[msg.type]);
+    }
 
     if(msg.type == LTE_FDD_ENB_MESSAGE_TYPE_PDCP_PDU_READY)
         return handle_pdu_ready(&msg.msg.pdcp_pdu_ready);
@@ -177,11 +190,16 @@ void LTE_fdd_enb_pdcp::handle_gw_msg(LTE_FDD_ENB_MESSAGE_STRUCT &msg)
 void LTE_fdd_enb_pdcp::send_rlc_sdu_ready(LTE_fdd_enb_user       *user,
                                           LTE_fdd_enb_rb         *rb,
                                           LIBLTE_BYTE_MSG_STRUCT *sdu)
+{
+    send_rlc_sdu_ready(user, rb, LTE_fdd_enb_msg_pool::copy_byte_buf(sdu->msg, sdu->N_bytes));
+}
+// Ownership of sdu passes to the RB, RLC may free it as soon as it is queued
+void LTE_fdd_enb_pdcp::send_rlc_sdu_ready(LTE_fdd_enb_user       *user,
+                                          LTE_fdd_enb_rb         *rb,
+                                          LIBLTE_BYTE_BUF_STRUCT *sdu)
 {
     LTE_FDD_ENB_RLC_SDU_READY_MSG_STRUCT sdu_ready;
 
-    rb->queue_rlc_sdu(sdu);
-
     interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
                               LTE_FDD_ENB_DEBUG_LEVEL_PDCP,
                               __FILE__,
@@ -191,6 +209,8 @@ void LTE_fdd_enb_pdcp::send_rlc_sdu_ready(LTE_fdd_enb_user       *user,
                               user->get_c_rnti(),
                               LTE_fdd_enb_rb_text[rb->get_rb_id()]);
 
+    rb->queue_rlc_sdu(sdu);
+
     sdu_ready.user = user;
     sdu_ready.rb   = rb;
     msgq_to_rlc->send(LTE_FDD_ENB_MESSAGE_TYPE_RLC_SDU_READY,
@@ -217,10 +237,10 @@ void LTE_fdd_enb_pdcp::send_rrc_pdu_ready(LTE_fdd_enb_user      *user,
 
     pdu_ready.user = user;
     pdu_ready.rb   = rb;
-    msgq_to_rrc->send(LTE_FDD_ENB_MESSAGE_TYPE_RRC_PDU_READY,
-                      LTE_FDD_ENB_DEST_LAYER_RRC,
-                      (LTE_FDD_ENB_MESSAGE_UNION *)&pdu_ready,
-                      sizeof(pdu_ready));
+    msgq_to_rrc[user->get_cell()]->send(LTE_FDD_ENB_MESSAGE_TYPE_RRC_PDU_READY,
+                                        LTE_FDD_ENB_DEST_LAYER_RRC,
+                                        (LTE_FDD_ENB_MESSAGE_UNION *)&pdu_ready,
+                                        sizeof(pdu_ready));
 }
 
 /****************************/
@@ -239,10 +259,11 @@ void LTE_fdd_enb_pdcp::handle_pdu_ready(LTE_FDD_ENB_PDCP_PDU_READY_MSG_STRUCT *p
 {
     LTE_FDD_ENB_GW_DATA_READY_MSG_STRUCT      gw_data_ready;
     LIBLTE_PDCP_CONTROL_PDU_STRUCT            contents;
-    LIBLTE_PDCP_DATA_PDU_WITH_LONG_SN_STRUCT  data_contents;
     LIBLTE_BYTE_MSG_STRUCT                   *pdu;
+    LIBLTE_BYTE_BUF_STRUCT                   *gw_data;
     LIBLTE_BIT_MSG_STRUCT                     rrc_pdu;
     uint8                                    *pdu_ptr;
+    uint32                                    count;
     uint32                                    i;
 
     if(LTE_FDD_ENB_ERROR_NONE != pdu_ready->rb->get_next_pdcp_pdu(&pdu))
@@ -276,10 +297,17 @@ void LTE_fdd_enb_pdcp::handle_pdu_ready(LTE_FDD_ENB_PDCP_PDU_READY_MSG_STRUCT *p
         // Send the SDU to RRC
         send_rrc_pdu_ready(pdu_ready->user, pdu_ready->rb, &contents.data);
     }else if(LTE_FDD_ENB_RB_DRB1 == pdu_ready->rb->get_rb_id()){
-        liblte_pdcp_unpack_data_pdu_with_long_sn(pdu, &data_contents);
+        // Strip the header in place, the payload is not copied again
+        gw_data = LTE_fdd_enb_msg_pool::copy_byte_buf(pdu->msg, pdu->N_bytes);
+        if(LIBLTE_SUCCESS != liblte_pdcp_unpack_data_pdu_with_long_sn(gw_data, &count))
+        {
+            LTE_fdd_enb_msg_pool::free(gw_data);
+            pdu_ready->rb->delete_next_pdcp_pdu();
+            return;
+        }
 
         // Queue the SDU for GW
-        pdu_ready->rb->queue_gw_data_msg(&data_contents.data);
+        pdu_ready->rb->queue_gw_data_msg(gw_data);
 
         // Signal GW
         gw_data_ready.user = pdu_ready->user;
@@ -391,11 +419,10 @@ void LTE_fdd_enb_pdcp::handle_sdu_ready(LTE_FDD_ENB_PDCP_SDU_READY_MSG_STRUCT *s
 /*****************************/
 void LTE_fdd_enb_pdcp::handle_data_sdu_ready(LTE_FDD_ENB_PDCP_DATA_SDU_READY_MSG_STRUCT *data_sdu_ready)
 {
-    LIBLTE_PDCP_DATA_PDU_WITH_LONG_SN_STRUCT  contents;
-    LIBLTE_BYTE_MSG_STRUCT                    pdu;
-    LIBLTE_BYTE_MSG_STRUCT                   *sdu;
+    LIBLTE_BYTE_BUF_STRUCT *sdu;
+    uint32                  count;
 
-    if(LTE_FDD_ENB_ERROR_NONE != data_sdu_ready->rb->get_next_pdcp_data_sdu(&sdu))
+    if(LTE_FDD_ENB_ERROR_NONE != data_sdu_ready->rb->take_next_pdcp_data_sdu(&sdu))
     {
         interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
                                   LTE_FDD_ENB_DEBUG_LEVEL_PDCP,
@@ -419,14 +446,26 @@ void LTE_fdd_enb_pdcp::handle_data_sdu_ready(LTE_FDD_ENB_PDCP_DATA_SDU_READY_MSG
     if(data_sdu_ready->rb->get_rb_id()       >= LTE_FDD_ENB_RB_DRB1 &&
        data_sdu_ready->rb->get_pdcp_config() == LTE_FDD_ENB_PDCP_CONFIG_LONG_SN)
     {
-        // Pack the data PDU
-        contents.count = data_sdu_ready->rb->get_pdcp_tx_count();
-        liblte_pdcp_pack_data_pdu_with_long_sn(&contents, sdu, &pdu);
+        // Pack the data PDU, the header goes into the SDU headroom
+        count = data_sdu_ready->rb->get_pdcp_tx_count();
+        if(LIBLTE_SUCCESS != liblte_pdcp_pack_data_pdu_with_long_sn(count, sdu))
+        {
+            interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
+                                      LTE_FDD_ENB_DEBUG_LEVEL_PDCP,
+                                      __FILE__,
+                                      __LINE__,
+                                      "Failed to pack data PDU, RNTI=%u, RB=%s",
+                                      data_sdu_ready->user->get_c_rnti(),
+                                      LTE_fdd_enb_rb_text[data_sdu_ready->rb->get_rb_id()]);
+            LTE_fdd_enb_msg_pool::free(sdu);
+            return;
+        }
 
         // Increment the SN
-        data_sdu_ready->rb->set_pdcp_tx_count(contents.count + 1);
+        data_sdu_ready->rb->set_pdcp_tx_count(count + 1);
 
-        send_rlc_sdu_ready(data_sdu_ready->user, data_sdu_ready->rb, &pdu);
+        // RLC owns the SDU from here
+        send_rlc_sdu_ready(data_sdu_ready->user, data_sdu_ready->rb, sdu);
     }else{
         interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
                                   LTE_FDD_ENB_DEBUG_LEVEL_PDCP,
@@ -435,8 +474,8 @@ void LTE_fdd_enb_pdcp::handle_data_sdu_ready(LTE_FDD_ENB_PDCP_DATA_SDU_READY_MSG
                                   "Received data SDU from GW for invalid RB=%s, RNTI=%u",
                                   LTE_fdd_enb_rb_text[data_sdu_ready->rb->get_rb_id()],
                                   data_sdu_ready->user->get_c_rnti());
-    }
 
-    // Delete the SDU
-    data_sdu_ready->rb->delete_next_pdcp_data_sdu();
+        // Delete the SDU
+        LTE_fdd_enb_msg_pool::free(sdu);
+    }
 }
@@ -82,6 +82,19 @@
 *******************************************************************************/
 
 
+/*******************************************************************************
+                              LOCAL FUNCTIONS
+*******************************************************************************/
+
+static inline void cpu_relax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
 /*******************************************************************************
                               CLASS IMPLEMENTATIONS
 *******************************************************************************/
@@ -89,8 +102,9 @@
 /********************************/
 /*    Constructor/Destructor    */
 /********************************/
-LTE_fdd_enb_phy::LTE_fdd_enb_phy(LTE_fdd_enb_interface *iface, LTE_fdd_enb_mac *_mac) :
-    interface{iface}, started{false}, mac{_mac}
+LTE_fdd_enb_phy::LTE_fdd_enb_phy(LTE_fdd_enb_interface *iface, uint8 _cell, LTE_fdd_enb_mac *_mac) :
+    interface{iface}, started{false}, cell{_cell}, subfr_ctx{NULL}, N_late_ul_ttis{0},
+    N_late_dl_ttis{0}, pipe_running{false}, mac{_mac}, dl_tx_buf{NULL}
 {
 }
 LTE_fdd_enb_phy::~LTE_fdd_enb_phy()
@@ -112,18 +126,39 @@ void LTE_fdd_enb_phy::start(LTE_fdd_enb_msgq      *from_mac,
     // Get the latest sys info
     update_sys_info();
 
-    // Initialize phy
+    // Initialize phy, each pipeline stage gets its own scratch
     radio = _radio;
-    liblte_phy_init(&phy_struct,
+    liblte_phy_init(&dl_phy_struct,
                     radio->get_phy_sample_rate(),
-                    interface->get_n_id_cell(),
+                    interface->get_n_id_cell(cell),
                     interface->get_n_ant(),
                     interface->get_n_rb_dl(),
                     interface->get_n_sc_rb_dl(),
                     sys_info.mib.phich_Config_Get().phich_Resource_Value());
-    liblte_phy_ul_init(phy_struct,
-                       interface->get_n_id_cell(),
+    liblte_phy_init(&ul_phy_struct,
+                    radio->get_phy_sample_rate(),
+                    interface->get_n_id_cell(cell),
+                    interface->get_n_ant(),
+                    interface->get_n_rb_dl(),
+                    interface->get_n_sc_rb_dl(),
+                    sys_info.mib.phich_Config_Get().phich_Resource_Value());
+    liblte_phy_ul_init(ul_phy_struct,
+                       interface->get_n_id_cell(cell),
                        sys_info.sib2.radioResourceConfigCommon_Get());
+    for(uint32 i=0; i<LTE_FDD_ENB_PHY_N_PUSCH_WORKERS; i++)
+    {
+        pusch_worker[i].phy = this;
+        liblte_phy_init(&pusch_worker[i].phy_struct,
+                        radio->get_phy_sample_rate(),
+                        interface->get_n_id_cell(cell),
+                        interface->get_n_ant(),
+                        interface->get_n_rb_dl(),
+                        interface->get_n_sc_rb_dl(),
+                        sys_info.mib.phich_Config_Get().phich_Resource_Value());
+        liblte_phy_ul_init(pusch_worker[i].phy_struct,
+                           interface->get_n_id_cell(cell),
+                           sys_info.sib2.radioResourceConfigCommon_Get());
+    }
 
     // Downlink
     for(uint32 i=0; i<10; i++)
@@ -132,6 +167,7 @@ void LTE_fdd_enb_phy::start(LTE_fdd_enb_msgq      *from_mac,
         dl_schedule[i].allocations.N_dl_alloc = 0;
         dl_schedule[i].allocations.N_ul_alloc = 0;
         dl_schedule[i].allocations.N_symbs    = 2; // FIXME: Make this dynamic every subfr
+        dl_schedule[i].N_sps_dl_alloc         = 0;
         ul_schedule[i].current_tti            = i;
         ul_schedule[i].decodes.N_ul_alloc     = 0;
         ul_schedule[i].N_pucch                = 0;
@@ -142,11 +178,14 @@ void LTE_fdd_enb_phy::start(LTE_fdd_enb_msgq      *from_mac,
             for(uint32 k=0; k<8; k++)
                 phich[i].present[j][k] = false;
 
+    // The radio starts RX at UL subframe -DL_LEAD, so DL subframes -2 and -1
+    // are sent up front and the first pipelined DL subframe is 0.  The MAC
+    // starts with UL subframe 0 and DL subframe 3, 3 subframes ahead of it.
     dl_subframe.num = 0;
-    dl_current_tti  = 0;
+    dl_current_tti  = liblte_phy_sub_from_tti(0, 2);
 
     // Uplink
-    ul_current_tti       = liblte_phy_sub_from_tti(0, 2);
+    ul_current_tti       = liblte_phy_sub_from_tti(0, LTE_FDD_ENB_PHY_DL_LEAD_N_SUBFRS);
     uint8 prach_cnfg_idx = sys_info.sib2.radioResourceConfigCommon_Get().prach_Config_Get().prach_ConfigInfo_Get().prach_ConfigIndex_Value();
     prach_sfn_mod        = 1;
     if(prach_cnfg_idx ==  0 || prach_cnfg_idx ==  1 || prach_cnfg_idx ==  2 ||
@@ -226,14 +265,35 @@ void LTE_fdd_enb_phy::start(LTE_fdd_enb_msgq      *from_mac,
     LTE_fdd_enb_msgq_cb mac_cb(&LTE_fdd_enb_msgq_cb_wrapper<LTE_fdd_enb_phy, &LTE_fdd_enb_phy::handle_mac_msg>, this);
     msgq_from_mac->attach_rx(mac_cb);
 
-    // UE communication
-    msgq_to_ue = NULL;
+    // UE communication, samples go through shared memory and
+    // everything else through the message queue
+    msgq_to_ue    = NULL;
+    iq_ring_to_ue = NULL;
     if(direct_to_ue)
     {
         libtools_ipc_msgq_cb ue_cb(&libtools_ipc_msgq_cb_wrapper<LTE_fdd_enb_phy, &LTE_fdd_enb_phy::handle_ue_msg>, this);
         msgq_to_ue = new libtools_ipc_msgq("enb_ue", ue_cb);
+
+        LIBTOOLS_IPC_IQ_RING_ERROR_ENUM ring_err;
+        iq_ring_to_ue = new libtools_ipc_iq_ring("enb_ue_iq",
+                                                 LIBTOOLS_IPC_IQ_RING_ROLE_PRODUCER,
+                                                 LTE_FDD_ENB_PHY_N_UE_IQ_SLOTS,
+                                                 ring_err);
+        if(LIBTOOLS_IPC_IQ_RING_ERROR_NONE != ring_err)
+        {
+            interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
+                                      LTE_FDD_ENB_DEBUG_LEVEL_PHY,
+                                      __FILE__,
+                                      __LINE__,
+                                      "Can't open UE IQ ring (%s)",
+                                      libtools_ipc_iq_ring_error_text[ring_err]);
+            delete iq_ring_to_ue;
+            iq_ring_to_ue = NULL;
+        }
     }
 
+    start_pipeline();
+
     started = true;
 }
 void LTE_fdd_enb_phy::stop()
@@ -243,11 +303,21 @@ void LTE_fdd_enb_phy::stop()
 
     started = false;
 
+    stop_pipeline();
+
     if(NULL != msgq_to_ue)
         delete msgq_to_ue;
+    if(NULL != iq_ring_to_ue)
+        delete iq_ring_to_ue;
 
-    liblte_phy_ul_cleanup(phy_struct);
-    liblte_phy_cleanup(phy_struct);
+    for(uint32 i=0; i<LTE_FDD_ENB_PHY_N_PUSCH_WORKERS; i++)
+    {
+        liblte_phy_ul_cleanup(pusch_worker[i].phy_struct);
+        liblte_phy_cleanup(pusch_worker[i].phy_struct);
+    }
+    liblte_phy_ul_cleanup(ul_phy_struct);
+    liblte_phy_cleanup(ul_phy_struct);
+    liblte_phy_cleanup(dl_phy_struct);
 }
 
 /****************************/
@@ -256,7 +326,7 @@ void LTE_fdd_enb_phy::stop()
 void LTE_fdd_enb_phy::update_sys_info()
 {
     std::lock_guard<std::mutex> lock(sys_info_mutex);
-    interface->get_sys_info(sys_info);
+    interface->get_sys_info(cell, sys_info);
 }
 uint32 LTE_fdd_enb_phy::get_n_cce()
 {
@@ -280,7 +350,7 @@ uint32 LTE_fdd_enb_phy::get_n_cce()
         phich_res = 2.0;
         break;
     }
-    liblte_phy_get_n_cce(phy_struct,
+    liblte_phy_get_n_cce(dl_phy_struct,
                          phich_res,
                          dl_schedule[0].allocations.N_symbs,
                          interface->get_n_ant(),
@@ -288,6 +358,12 @@ uint32 LTE_fdd_enb_phy::get_n_cce()
 
     return N_cce;
 }
+void LTE_fdd_enb_phy::get_late_ttis(uint32 *N_late_ul,
+                                    uint32 *N_late_dl)
+{
+    *N_late_ul = N_late_ul_ttis;
+    *N_late_dl = N_late_dl_ttis;
+}
 
 /***********************/
 /*    Communication    */
@@ -348,15 +424,69 @@ void LTE_fdd_enb_phy::radio_interface(LTE_FDD_ENB_RADIO_TX_BUF_STRUCT *tx_buf,
     // Once started, this routine gets called every millisecond (except the first) to:
     //     1) align TTIs
     align_ttis_with_radio(rx_buf->current_tti);
-    //     2) process the new uplink subframe
-    process_ul(rx_buf);
-    //     3) generate the next downlink subframe
-    process_dl(tx_buf);
+    //     2) hand the new uplink subframe, and the downlink subframe that carries
+    //        its PHICH, to the pipeline workers.  The DL worker sends to the radio.
+    LTE_FDD_ENB_PHY_SUBFR_CTX_STRUCT *ctx = &subfr_ctx[ctx_wr_idx];
+    pipe_mutex.lock();
+    bool overrun = (LTE_FDD_ENB_PHY_SUBFR_STATE_IDLE != ctx->ul_state ||
+                    LTE_FDD_ENB_PHY_SUBFR_STATE_IDLE != ctx->dl_state);
+    pipe_mutex.unlock();
+    if(overrun)
+    {
+        // Workers are a full ring behind, drop this TTI but keep the MAC ticking
+        N_late_ul_ttis++;
+        N_late_dl_ttis++;
+        interface->count_metric(cell, LTE_FDD_ENB_METRIC_PHY_LATE_UL_TTIS, 1);
+        interface->count_metric(cell, LTE_FDD_ENB_METRIC_PHY_LATE_DL_TTIS, 1);
+        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
+                                  LTE_FDD_ENB_DEBUG_LEVEL_PHY,
+                                  __FILE__,
+                                  __LINE__,
+                                  "PHY pipeline overrun, dropping UL TTI=%u DL TTI=%u",
+                                  ul_current_tti,
+                                  dl_current_tti);
+        // The dropped DL subframe can't carry the PHICH set for it, don't
+        // let it leak into the same subframe of the next frame
+        phich_mutex.lock();
+        for(uint32 i=0; i<25; i++)
+            for(uint32 j=0; j<8; j++)
+                phich[dl_current_tti%10].present[i][j] = false;
+        phich_mutex.unlock();
+        LTE_FDD_ENB_READY_TO_SEND_MSG_STRUCT rts;
+        msgq_to_mac->send(LTE_FDD_ENB_MESSAGE_TYPE_READY_TO_SEND,
+                          LTE_FDD_ENB_DEST_LAYER_MAC,
+                          (LTE_FDD_ENB_MESSAGE_UNION *)&rts,
+                          sizeof(rts));
+    }else{
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        memcpy(ctx->rx_buf.samps[0], rx_buf->samps[0], sizeof(complex)*ul_phy_struct->N_samps_per_subfr);
+        ctx->rx_buf.current_tti = rx_buf->current_tti;
+        ctx->ul_tti             = ul_current_tti;
+        ctx->dl_tti             = dl_current_tti;
+        set_deadline(&now, LTE_FDD_ENB_PHY_UL_BUDGET_US, &ctx->ul_deadline);
+        set_deadline(&now, LTE_FDD_ENB_PHY_DL_BUDGET_US, &ctx->dl_deadline);
+        pipe_mutex.lock();
+        ctx->ul_state = LTE_FDD_ENB_PHY_SUBFR_STATE_QUEUED;
+        ctx->dl_state = LTE_FDD_ENB_PHY_SUBFR_STATE_QUEUED;
+        pipe_mutex.unlock();
+        ul_cond.notify_one();
+        dl_cond.notify_one();
+        ctx_wr_idx = (ctx_wr_idx + 1) % LTE_FDD_ENB_PHY_N_SUBFR_CTX;
+    }
+    //     3) update counters
+    ul_current_tti = liblte_phy_add_to_tti(ul_current_tti, 1);
+    dl_current_tti = liblte_phy_add_to_tti(dl_current_tti, 1);
 }
 void LTE_fdd_enb_phy::radio_interface(LTE_FDD_ENB_RADIO_TX_BUF_STRUCT *tx_buf)
 {
-    // This routine gets called once to generate the first downlink subframe
-    process_dl(tx_buf);
+    // This routine gets called once to generate the downlink subframes that
+    // precede the first pipelined one, the workers are idle at this point
+    while(dl_current_tti != liblte_phy_add_to_tti(ul_current_tti, LTE_FDD_ENB_PHY_DL_LEAD_N_SUBFRS))
+    {
+        process_dl(dl_current_tti, NULL);
+        dl_current_tti = liblte_phy_add_to_tti(dl_current_tti, 1);
+    }
 }
 
 /*****************/
@@ -375,11 +505,175 @@ void LTE_fdd_enb_phy::align_ttis_with_radio(uint32 radio_ul_tti)
                               radio_ul_tti,
                               ul_current_tti);
     ul_current_tti = radio_ul_tti;
-    dl_current_tti = liblte_phy_add_to_tti(ul_current_tti, 2);
+    dl_current_tti = liblte_phy_add_to_tti(ul_current_tti, LTE_FDD_ENB_PHY_DL_LEAD_N_SUBFRS);
 
     mac->align_ttis_with_phy(ul_current_tti);
 }
 
+/******************/
+/*    Pipeline    */
+/******************/
+void* LTE_fdd_enb_phy::ul_thread_func(void *inputs)
+{
+    LTE_fdd_enb_phy *phy    = (LTE_fdd_enb_phy *)inputs;
+    uint32           rd_idx = 0;
+
+    phy->interface->setup_thread(LTE_FDD_ENB_THREAD_PHY, phy->cell, "phy_ul_" + std::to_string(phy->cell));
+    bool busy_poll = phy->interface->get_thread_busy_poll(LTE_FDD_ENB_THREAD_PHY);
+
+    while(1)
+    {
+        LTE_FDD_ENB_PHY_SUBFR_CTX_STRUCT *ctx = &phy->subfr_ctx[rd_idx];
+        std::unique_lock<std::mutex>      lock(phy->pipe_mutex);
+        auto ready = [phy, ctx]{return (!phy->pipe_running ||
+                                        LTE_FDD_ENB_PHY_SUBFR_STATE_QUEUED == ctx->ul_state);};
+        if(busy_poll)
+        {
+            while(!ready())
+            {
+                lock.unlock();
+                cpu_relax();
+                lock.lock();
+            }
+        }else{
+            phy->ul_cond.wait(lock, ready);
+        }
+        if(!phy->pipe_running)
+            break;
+        lock.unlock();
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        phy->process_ul(ctx);
+        phy->interface->sample_metric(phy->cell, LTE_FDD_ENB_METRIC_HIST_PHY_UL_US, &start);
+
+        lock.lock();
+        ctx->ul_state    = LTE_FDD_ENB_PHY_SUBFR_STATE_IDLE;
+        phy->ul_next_tti = liblte_phy_add_to_tti(ctx->ul_tti, 1);
+        lock.unlock();
+        phy->ul_done_cond.notify_all();
+        rd_idx = (rd_idx + 1) % LTE_FDD_ENB_PHY_N_SUBFR_CTX;
+    }
+
+    return NULL;
+}
+void* LTE_fdd_enb_phy::dl_thread_func(void *inputs)
+{
+    LTE_fdd_enb_phy *phy    = (LTE_fdd_enb_phy *)inputs;
+    uint32           rd_idx = 0;
+
+    phy->interface->setup_thread(LTE_FDD_ENB_THREAD_PHY, phy->cell, "phy_dl_" + std::to_string(phy->cell));
+    bool busy_poll = phy->interface->get_thread_busy_poll(LTE_FDD_ENB_THREAD_PHY);
+
+    while(1)
+    {
+        LTE_FDD_ENB_PHY_SUBFR_CTX_STRUCT *ctx = &phy->subfr_ctx[rd_idx];
+        std::unique_lock<std::mutex>      lock(phy->pipe_mutex);
+        auto ready = [phy, ctx]{return (!phy->pipe_running ||
+                                        LTE_FDD_ENB_PHY_SUBFR_STATE_QUEUED == ctx->dl_state);};
+        if(busy_poll)
+        {
+            while(!ready())
+            {
+                lock.unlock();
+                cpu_relax();
+                lock.lock();
+            }
+        }else{
+            phy->dl_cond.wait(lock, ready);
+        }
+        if(!phy->pipe_running)
+            break;
+        lock.unlock();
+
+        struct timespec start;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        phy->process_dl(ctx->dl_tti, ctx);
+        phy->interface->sample_metric(phy->cell, LTE_FDD_ENB_METRIC_HIST_PHY_DL_US, &start);
+
+        lock.lock();
+        ctx->dl_state = LTE_FDD_ENB_PHY_SUBFR_STATE_IDLE;
+        lock.unlock();
+        rd_idx = (rd_idx + 1) % LTE_FDD_ENB_PHY_N_SUBFR_CTX;
+    }
+
+    return NULL;
+}
+void LTE_fdd_enb_phy::start_pipeline()
+{
+    subfr_ctx = new LTE_FDD_ENB_PHY_SUBFR_CTX_STRUCT[LTE_FDD_ENB_PHY_N_SUBFR_CTX];
+    for(uint32 i=0; i<LTE_FDD_ENB_PHY_N_SUBFR_CTX; i++)
+    {
+        subfr_ctx[i].ul_state = LTE_FDD_ENB_PHY_SUBFR_STATE_IDLE;
+        subfr_ctx[i].dl_state = LTE_FDD_ENB_PHY_SUBFR_STATE_IDLE;
+    }
+    dl_tx_buf      = new LTE_FDD_ENB_RADIO_TX_BUF_STRUCT;
+    ctx_wr_idx     = 0;
+    ul_next_tti    = ul_current_tti;
+    N_late_ul_ttis = 0;
+    N_late_dl_ttis = 0;
+    pipe_running   = true;
+    pthread_create(&ul_thread, NULL, &ul_thread_func, this);
+    pthread_create(&dl_thread, NULL, &dl_thread_func, this);
+
+    pusch_job_N_alloc = 0;
+    pusch_job_next    = 0;
+    pusch_job_N_done  = 0;
+    pusch_running     = true;
+    for(uint32 i=0; i<LTE_FDD_ENB_PHY_N_PUSCH_WORKERS; i++)
+        pthread_create(&pusch_worker[i].thread, NULL, &pusch_thread_func, &pusch_worker[i]);
+}
+void LTE_fdd_enb_phy::stop_pipeline()
+{
+    pipe_mutex.lock();
+    pipe_running = false;
+    pipe_mutex.unlock();
+    ul_cond.notify_all();
+    dl_cond.notify_all();
+    ul_done_cond.notify_all();
+    pthread_join(ul_thread, NULL);
+    pthread_join(dl_thread, NULL);
+
+    pusch_mutex.lock();
+    pusch_running = false;
+    pusch_mutex.unlock();
+    pusch_cond.notify_all();
+    for(uint32 i=0; i<LTE_FDD_ENB_PHY_N_PUSCH_WORKERS; i++)
+        pthread_join(pusch_worker[i].thread, NULL);
+
+    delete [] subfr_ctx;
+    subfr_ctx = NULL;
+    delete dl_tx_buf;
+    dl_tx_buf = NULL;
+}
+bool LTE_fdd_enb_phy::wait_for_ul(uint32 ul_tti)
+{
+    std::unique_lock<std::mutex> lock(pipe_mutex);
+    ul_done_cond.wait(lock, [this, ul_tti]{return (!pipe_running ||
+                                                   liblte_phy_is_tti_in_past(ul_tti, ul_next_tti));});
+    return pipe_running;
+}
+void LTE_fdd_enb_phy::set_deadline(struct timespec *now,
+                                   uint32           budget_us,
+                                   struct timespec *deadline)
+{
+    deadline->tv_sec  = now->tv_sec;
+    deadline->tv_nsec = now->tv_nsec + budget_us*1000;
+    while(deadline->tv_nsec >= 1000000000)
+    {
+        deadline->tv_sec++;
+        deadline->tv_nsec -= 1000000000;
+    }
+}
+bool LTE_fdd_enb_phy::is_deadline_missed(struct timespec *deadline)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    if(now.tv_sec != deadline->tv_sec)
+        return now.tv_sec > deadline->tv_sec;
+    return now.tv_nsec > deadline->tv_nsec;
+}
+
 /******************/
 /*    Downlink    */
 /******************/
@@ -449,20 +743,21 @@ void LTE_fdd_enb_phy::process_pss_sss()
     if(dl_subframe.num != 0 && dl_subframe.num != 5)
         return;
 
-    liblte_phy_map_pss(phy_struct,
+    liblte_phy_map_pss(dl_phy_struct,
                        &dl_subframe,
-                       interface->get_n_id_2(),
+                       interface->get_n_id_2(cell),
                        interface->get_n_ant());
-    liblte_phy_map_sss(phy_struct,
+    liblte_phy_map_sss(dl_phy_struct,
                        &dl_subframe,
-                       interface->get_n_id_1(),
-                       interface->get_n_id_2(),
+                       interface->get_n_id_1(cell),
+                       interface->get_n_id_2(cell),
                        interface->get_n_ant());
 }
 void LTE_fdd_enb_phy::process_pbch(uint32 sfn)
 {
     if(dl_subframe.num != 0)
         return;
+    std::lock_guard<std::mutex> lock(sys_info_mutex);
     sys_info.mib.systemFrameNumber_SetValue(sfn/4);
     BCCH_BCH_Message bcch_bch;
     bcch_bch.message_Set()->MasterInformationBlock_value_Set(sys_info.mib);
@@ -473,23 +768,37 @@ void LTE_fdd_enb_phy::process_pbch(uint32 sfn)
         dl_rrc_msg.msg[i] = bits[i];
     interface->send_lte_pcap_msg(LTE_FDD_ENB_PCAP_DIRECTION_DL,
                                  0xFFFFFFFF,
-                                 dl_current_tti,
+                                 sfn*10,
                                  dl_rrc_msg.msg,
                                  dl_rrc_msg.N_bits);
-    liblte_phy_bch_channel_encode(phy_struct,
+    liblte_phy_bch_channel_encode(dl_phy_struct,
                                   dl_rrc_msg.msg,
                                   dl_rrc_msg.N_bits,
-                                  interface->get_n_id_cell(),
+                                  interface->get_n_id_cell(cell),
                                   interface->get_n_ant(),
                                   &dl_subframe,
                                   sfn);
 }
-void LTE_fdd_enb_phy::process_pdcch_and_pdsch()
+void LTE_fdd_enb_phy::process_pdcch_and_pdsch(uint32 current_tti)
 {
+    // Take the PHICH the uplink worker filled in for this subframe
+    phich_mutex.lock();
+    memcpy(&dl_phich, &phich[dl_subframe.num], sizeof(LIBLTE_PHY_PHICH_STRUCT));
+    for(uint32 i=0; i<25; i++)
+        for(uint32 j=0; j<8; j++)
+            phich[dl_subframe.num].present[i][j] = false;
+    phich_mutex.unlock();
+
+    // Copy the PHICH config, the MIB can be updated from the control thread
+    sys_info_mutex.lock();
+    PHICH_Config::phich_Resource_Enum phich_resource = sys_info.mib.phich_Config_Get().phich_Resource_Value();
+    PHICH_Config::phich_Duration_Enum phich_duration = sys_info.mib.phich_Config_Get().phich_Duration_Value();
+    sys_info_mutex.unlock();
+
     std::lock_guard<std::mutex> lock(dl_sched_mutex);
 
     double phich_res = 0.0;
-    switch(sys_info.mib.phich_Config_Get().phich_Resource_Value())
+    switch(phich_resource)
     {
     case PHICH_Config::k_phich_Resource_oneSixth:
         phich_res = 1/6;
@@ -504,32 +813,44 @@ void LTE_fdd_enb_phy::process_pdcch_and_pdsch()
         phich_res = 2.0;
         break;
     }
-    liblte_phy_pdcch_channel_encode(phy_struct,
+    // Configured SPS assignments are at the end of the list and have no DCI
+    dl_schedule[dl_subframe.num].allocations.N_dl_alloc -= dl_schedule[dl_subframe.num].N_sps_dl_alloc;
+    liblte_phy_pdcch_channel_encode(dl_phy_struct,
                                     &pcfich,
-                                    &phich[dl_subframe.num],
+                                    &dl_phich,
                                     &dl_schedule[dl_subframe.num].allocations,
-                                    interface->get_n_id_cell(),
+                                    interface->get_n_id_cell(cell),
                                     interface->get_n_ant(),
                                     phich_res,
-                                    sys_info.mib.phich_Config_Get().phich_Duration_Value(),
+                                    phich_duration,
                                     &dl_subframe);
+    dl_schedule[dl_subframe.num].allocations.N_dl_alloc += dl_schedule[dl_subframe.num].N_sps_dl_alloc;
 
     if(dl_schedule[dl_subframe.num].allocations.N_dl_alloc != 0)
-        liblte_phy_pdsch_channel_encode(phy_struct,
+        liblte_phy_pdsch_channel_encode(dl_phy_struct,
                                         &dl_schedule[dl_subframe.num].allocations,
-                                        interface->get_n_id_cell(),
+                                        interface->get_n_id_cell(cell),
                                         interface->get_n_ant(),
                                         &dl_subframe);
-
-    // Clear PHICH
-    for(uint32 i=0; i<25; i++)
-        for(uint32 j=0; j<8; j++)
-            phich[dl_subframe.num].present[i][j] = false;
 }
-void LTE_fdd_enb_phy::process_dl(LTE_FDD_ENB_RADIO_TX_BUF_STRUCT *tx_buf)
+void LTE_fdd_enb_phy::process_dl(uint32                            current_tti,
+                                  LTE_FDD_ENB_PHY_SUBFR_CTX_STRUCT *ctx)
 {
+    dl_subframe.num = current_tti%10;
+
+    // Don't spend time on a subframe that can no longer make it to the radio
+    if(NULL != ctx && is_deadline_missed(&ctx->dl_deadline))
+    {
+        wait_for_ul(ctx->ul_tti);
+        phich_mutex.lock();
+        for(uint32 i=0; i<25; i++)
+            for(uint32 j=0; j<8; j++)
+                phich[dl_subframe.num].present[i][j] = false;
+        phich_mutex.unlock();
+        return send_dl(current_tti, true);
+    }
+
     // Initialize the DL subframe
-    dl_subframe.num = dl_current_tti%10;
     for(uint32 p=0; p<interface->get_n_ant(); p++)
         for(uint32 i=0; i<14; i++)
             for(uint32 j=0; j<LIBLTE_PHY_N_RB_DL_20MHZ*LIBLTE_PHY_N_SC_RB_DL_NORMAL_CP; j++)
@@ -539,29 +860,30 @@ void LTE_fdd_enb_phy::process_dl(LTE_FDD_ENB_RADIO_TX_BUF_STRUCT *tx_buf)
     process_pss_sss();
 
     // Handle CRS
-    liblte_phy_map_crs(phy_struct,
+    liblte_phy_map_crs(dl_phy_struct,
                        &dl_subframe,
-                       interface->get_n_id_cell(),
+                       interface->get_n_id_cell(cell),
                        interface->get_n_ant());
 
     // Handle PBCH
-    process_pbch(dl_current_tti/10);
+    process_pbch(current_tti/10);
 
-    // Handle PDCCH & PDSCH
-    process_pdcch_and_pdsch();
+    // Handle PDCCH & PDSCH, the PHICH needs the UL decode from 4 subframes ago
+    if(NULL != ctx && !wait_for_ul(ctx->ul_tti))
+        return;
+    process_pdcch_and_pdsch(current_tti);
 
     for(uint32 p=0; p<interface->get_n_ant(); p++)
-        liblte_phy_create_dl_subframe(phy_struct,
+        liblte_phy_create_dl_subframe(dl_phy_struct,
                                       &dl_subframe,
                                       p,
-                                      &tx_buf->samps[p][0]);
-    tx_buf->N_samps_per_ant = phy_struct->N_samps_per_subfr;
-    tx_buf->current_tti     = dl_current_tti;
-    tx_buf->N_ant           = interface->get_n_ant();
-
-    // Update current TTI
-    dl_current_tti = liblte_phy_add_to_tti(dl_current_tti, 1);
+                                      &dl_tx_buf->samps[p][0]);
 
+    send_dl(current_tti, (NULL != ctx && is_deadline_missed(&ctx->dl_deadline)));
+}
+void LTE_fdd_enb_phy::send_dl(uint32 current_tti,
+                              bool   late)
+{
     // Send READY TO SEND message to MAC
     LTE_FDD_ENB_READY_TO_SEND_MSG_STRUCT rts;
     msgq_to_mac->send(LTE_FDD_ENB_MESSAGE_TYPE_READY_TO_SEND,
@@ -569,23 +891,38 @@ void LTE_fdd_enb_phy::process_dl(LTE_FDD_ENB_RADIO_TX_BUF_STRUCT *tx_buf)
                       (LTE_FDD_ENB_MESSAGE_UNION *)&rts,
                       sizeof(rts));
 
+    if(late)
+    {
+        N_late_dl_ttis++;
+        interface->count_metric(cell, LTE_FDD_ENB_METRIC_PHY_LATE_DL_TTIS, 1);
+        return interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_WARNING,
+                                         LTE_FDD_ENB_DEBUG_LEVEL_PHY,
+                                         __FILE__,
+                                         __LINE__,
+                                         "Late DL TTI=%u, not sending (late DL TTIs=%u)",
+                                         current_tti,
+                                         (uint32)N_late_dl_ttis);
+    }
+
+    dl_tx_buf->N_samps_per_ant = dl_phy_struct->N_samps_per_subfr;
+    dl_tx_buf->current_tti     = current_tti;
+    dl_tx_buf->N_ant           = interface->get_n_ant();
+
     // Send samples to radio
-    radio->send(tx_buf);
+    radio->send(dl_tx_buf);
 
-    // Send samples to UE
-    if(NULL != msgq_to_ue)
-        msgq_to_ue->send(LIBTOOLS_IPC_MSGQ_MESSAGE_TYPE_PHY_SAMPS,
-                         (LIBTOOLS_IPC_MSGQ_MESSAGE_UNION *)tx_buf,
-                         sizeof(LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT));
+    // Send samples to UE, a full ring drops the subframe
+    if(NULL != iq_ring_to_ue)
+        iq_ring_to_ue->send(dl_tx_buf);
 }
 
 /****************/
 /*    Uplink    */
 /****************/
 void LTE_fdd_enb_phy::process_prach(LTE_FDD_ENB_RADIO_RX_BUF_STRUCT *rx_buf,
-                                    uint32                           sfn)
+                                    uint32                           current_tti)
 {
-    if((sfn % prach_sfn_mod) != 0)
+    if(((current_tti/10) % prach_sfn_mod) != 0)
         return;
 
     if((ul_subframe.num % prach_subfn_mod) != prach_subfn_check)
@@ -594,8 +931,8 @@ void LTE_fdd_enb_phy::process_prach(LTE_FDD_ENB_RADIO_RX_BUF_STRUCT *rx_buf,
     if(ul_subframe.num == 0 && !prach_subfn_zero_allowed)
         return;
 
-    prach_decode.current_tti = ul_current_tti;
-    liblte_phy_detect_prach(phy_struct,
+    prach_decode.current_tti = current_tti;
+    liblte_phy_detect_prach(ul_phy_struct,
                             rx_buf->samps[0],
                             sys_info.sib2.radioResourceConfigCommon_Get().prach_Config_Get().prach_ConfigInfo_Get().prach_FreqOffset_Value(),
                             &prach_decode.num_preambles,
@@ -610,90 +947,99 @@ void LTE_fdd_enb_phy::process_prach(LTE_FDD_ENB_RADIO_RX_BUF_STRUCT *rx_buf,
                       (LTE_FDD_ENB_MESSAGE_UNION *)&prach_decode,
                       sizeof(LTE_FDD_ENB_PRACH_DECODE_MSG_STRUCT));
 }
-void LTE_fdd_enb_phy::process_pucch()
+void LTE_fdd_enb_phy::process_pucch(uint32 current_tti)
 {
     std::lock_guard<std::mutex> lock(ul_sched_mutex);
 
-    pucch_decode.current_tti = ul_current_tti;
     for(uint32 i=0; i<ul_schedule[ul_subframe.num].N_pucch; i++)
     {
-        pucch_decode.rnti           = ul_schedule[ul_subframe.num].pucch[i].rnti;
-        pucch_decode.type           = ul_schedule[ul_subframe.num].pucch[i].type;
+        // Decode straight into the message that goes to MAC
+        LTE_FDD_ENB_MESSAGE_STRUCT *msg = msgq_to_mac->alloc_msg(LTE_FDD_ENB_MESSAGE_TYPE_PUCCH_DECODE,
+                                                                 LTE_FDD_ENB_DEST_LAYER_MAC);
+        if(NULL == msg)
+            continue;
+        LTE_FDD_ENB_PUCCH_DECODE_MSG_STRUCT *pucch_decode = &msg->msg.pucch_decode;
+
+        pucch_decode->current_tti   = current_tti;
+        pucch_decode->rnti          = ul_schedule[ul_subframe.num].pucch[i].rnti;
+        pucch_decode->type          = ul_schedule[ul_subframe.num].pucch[i].type;
         LIBLTE_ERROR_ENUM pucch_err =
-            liblte_phy_pucch_format_1_1a_1b_channel_decode(phy_struct,
+            liblte_phy_pucch_format_1_1a_1b_channel_decode(ul_phy_struct,
                                                            &ul_subframe,
                                                            LIBLTE_PHY_PUCCH_FORMAT_1B,
                                                            interface->get_n_ant(),
                                                            ul_schedule[ul_subframe.num].pucch[i].n_1_p_pucch,
-                                                           pucch_decode.msg.msg,
-                                                           &pucch_decode.msg.N_bits);
-        if(pucch_decode.type == LTE_FDD_ENB_PUCCH_TYPE_SR)
+                                                           pucch_decode->msg.msg,
+                                                           &pucch_decode->msg.N_bits);
+        pucch_decode->timing_offset = ul_phy_struct->pucch_timing_offset;
+        if(pucch_decode->type == LTE_FDD_ENB_PUCCH_TYPE_SR)
         {
             if(pucch_err == LIBLTE_SUCCESS)
-                msgq_to_mac->send(LTE_FDD_ENB_MESSAGE_TYPE_PUCCH_DECODE,
-                                  LTE_FDD_ENB_DEST_LAYER_MAC,
-                                  (LTE_FDD_ENB_MESSAGE_UNION *)&pucch_decode,
-                                  sizeof(LTE_FDD_ENB_PUCCH_DECODE_MSG_STRUCT));
+                msgq_to_mac->send_msg(msg);
+            else
+                msgq_to_mac->free_msg(msg);
             continue;
         }
 
         // LTE_FDD_ENB_PUCCH_TYPE_ACK_NACK
-        pucch_decode.msg.msg[0] = 0;
-        pucch_decode.msg.N_bits = 1;
+        pucch_decode->msg.msg[0] = 0;
+        pucch_decode->msg.N_bits = 1;
         if(LIBLTE_SUCCESS == pucch_err)
-            pucch_decode.msg.msg[0] = 1;
-        msgq_to_mac->send(LTE_FDD_ENB_MESSAGE_TYPE_PUCCH_DECODE,
-                          LTE_FDD_ENB_DEST_LAYER_MAC,
-                          (LTE_FDD_ENB_MESSAGE_UNION *)&pucch_decode,
-                          sizeof(LTE_FDD_ENB_PUCCH_DECODE_MSG_STRUCT));
+            pucch_decode->msg.msg[0] = 1;
+        msgq_to_mac->send_msg(msg);
     }
     ul_schedule[ul_subframe.num].N_pucch = 0;
 }
-void LTE_fdd_enb_phy::process_pusch()
+void LTE_fdd_enb_phy::process_pusch(uint32 current_tti)
 {
     std::lock_guard<std::mutex> lock(ul_sched_mutex);
 
-    for(uint32 i=0; i<ul_schedule[ul_subframe.num].decodes.N_ul_alloc; i++)
-    {
-        // Determine PHICH indecies
-        uint32 I_prb_ra      = ul_schedule[ul_subframe.num].decodes.ul_alloc[i].prb[0][0];
-        uint32 n_group_phich = I_prb_ra % phy_struct->N_group_phich;
-        uint32 n_seq_phich   = (I_prb_ra/phy_struct->N_group_phich) % (2*phy_struct->N_sf_phich);
-
-        // Add NACK to PHICH
-        phich[(ul_subframe.num + 4) % 10].present[n_group_phich][n_seq_phich] = true;
-        phich[(ul_subframe.num + 4) % 10].b[n_group_phich][n_seq_phich]       = 0;
-
-        // Attempt decode
-        if(LIBLTE_SUCCESS == liblte_phy_pusch_channel_decode(phy_struct,
-                                                             &ul_subframe,
-                                                             &ul_schedule[ul_subframe.num].decodes.ul_alloc[i],
-                                                             interface->get_n_id_cell(),
-                                                             1,
-                                                             N_TURBO_ITERATIONS,
-                                                             pusch_decode.msg.msg,
-                                                             &pusch_decode.msg.N_bits))
-        {
-            pusch_decode.current_tti = ul_current_tti;
-            pusch_decode.rnti        = ul_schedule[ul_subframe.num].decodes.ul_alloc[i].rnti;
-
-            msgq_to_mac->send(LTE_FDD_ENB_MESSAGE_TYPE_PUSCH_DECODE,
-                              LTE_FDD_ENB_DEST_LAYER_MAC,
-                              (LTE_FDD_ENB_MESSAGE_UNION *)&pusch_decode,
-                              sizeof(LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT));
+    // Hand the allocations to the decode pool and help out until all are done,
+    // the PHICH for this subframe must be complete before returning
+    pusch_mutex.lock();
+    pusch_job_tti     = current_tti;
+    pusch_job_N_alloc = ul_schedule[ul_subframe.num].decodes.N_ul_alloc;
+    pusch_job_next    = 0;
+    pusch_job_N_done  = 0;
+    pusch_mutex.unlock();
+    if(pusch_job_N_alloc > 1)
+        pusch_cond.notify_all();
+
+    decode_pusch_allocs(ul_phy_struct);
+
+    std::unique_lock<std::mutex> pusch_lock(pusch_mutex);
+    pusch_done_cond.wait(pusch_lock, [this]{return pusch_job_N_done == pusch_job_N_alloc;});
+    pusch_job_N_alloc = 0;
+    pusch_job_next    = 0;
+    pusch_job_N_done  = 0;
 
-            // Add ACK to PHICH
-            phich[(ul_subframe.num + 4) % 10].b[n_group_phich][n_seq_phich]       = 1;
-        }
-    }
     ul_schedule[ul_subframe.num].decodes.N_ul_alloc = 0;
 }
-void LTE_fdd_enb_phy::process_ul(LTE_FDD_ENB_RADIO_RX_BUF_STRUCT *rx_buf)
+void LTE_fdd_enb_phy::process_ul(LTE_FDD_ENB_PHY_SUBFR_CTX_STRUCT *ctx)
 {
-    ul_subframe.num = ul_current_tti%10;
+    uint32 current_tti = ctx->ul_tti;
+    ul_subframe.num    = current_tti%10;
+
+    // Results are useless once the PHICH has gone out, so drop a late subframe
+    if(is_deadline_missed(&ctx->ul_deadline))
+    {
+        ul_sched_mutex.lock();
+        ul_schedule[ul_subframe.num].N_pucch            = 0;
+        ul_schedule[ul_subframe.num].decodes.N_ul_alloc = 0;
+        ul_sched_mutex.unlock();
+        N_late_ul_ttis++;
+        interface->count_metric(cell, LTE_FDD_ENB_METRIC_PHY_LATE_UL_TTIS, 1);
+        return interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_WARNING,
+                                         LTE_FDD_ENB_DEBUG_LEVEL_PHY,
+                                         __FILE__,
+                                         __LINE__,
+                                         "Late UL TTI=%u, not decoding (late UL TTIs=%u)",
+                                         current_tti,
+                                         (uint32)N_late_ul_ttis);
+    }
 
     // Handle PRACH
-    process_prach(rx_buf, ul_current_tti/10);
+    process_prach(&ctx->rx_buf, current_tti);
 
     // Construct the UL subframe
     ul_sched_mutex.lock();
@@ -702,16 +1048,140 @@ void LTE_fdd_enb_phy::process_ul(LTE_FDD_ENB_RADIO_RX_BUF_STRUCT *rx_buf)
     ul_sched_mutex.unlock();
     LIBLTE_ERROR_ENUM subfr_err = LIBLTE_SUCCESS;
     if(N_pucch != 0 || N_alloc != 0)
-        subfr_err = liblte_phy_get_ul_subframe(phy_struct, rx_buf->samps[0], &ul_subframe);
+        subfr_err = liblte_phy_get_ul_subframe(ul_phy_struct, ctx->rx_buf.samps[0], &ul_subframe);
 
     // Handle PUCCH
     if(subfr_err == LIBLTE_SUCCESS && N_pucch != 0)
-        process_pucch();
+        process_pucch(current_tti);
 
     // Handle PUSCH
     if(subfr_err == LIBLTE_SUCCESS && N_alloc != 0)
-        process_pusch();
+        process_pusch(current_tti);
 
-    // Update counters
-    ul_current_tti = liblte_phy_add_to_tti(ul_current_tti, 1);
+    if(is_deadline_missed(&ctx->ul_deadline))
+    {
+        N_late_ul_ttis++;
+        interface->count_metric(cell, LTE_FDD_ENB_METRIC_PHY_LATE_UL_TTIS, 1);
+        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_WARNING,
+                                  LTE_FDD_ENB_DEBUG_LEVEL_PHY,
+                                  __FILE__,
+                                  __LINE__,
+                                  "UL TTI=%u finished late (late UL TTIs=%u)",
+                                  current_tti,
+                                  (uint32)N_late_ul_ttis);
+    }
+}
+
+/***************************/
+/*    PUSCH Decode Pool    */
+/***************************/
+void* LTE_fdd_enb_phy::pusch_thread_func(void *inputs)
+{
+    LTE_FDD_ENB_PHY_PUSCH_WORKER_STRUCT *worker = (LTE_FDD_ENB_PHY_PUSCH_WORKER_STRUCT *)inputs;
+    LTE_fdd_enb_phy                     *phy    = worker->phy;
+
+    phy->interface->setup_thread(LTE_FDD_ENB_THREAD_PHY,
+                                 phy->cell,
+                                 "phy_pusch_" + std::to_string(phy->cell) + "_" + std::to_string(worker - phy->pusch_worker));
+    bool busy_poll = phy->interface->get_thread_busy_poll(LTE_FDD_ENB_THREAD_PHY);
+
+    while(1)
+    {
+        std::unique_lock<std::mutex> lock(phy->pusch_mutex);
+        auto ready = [phy]{return (!phy->pusch_running ||
+                                   phy->pusch_job_next < phy->pusch_job_N_alloc);};
+        if(busy_poll)
+        {
+            while(!ready())
+            {
+                lock.unlock();
+                cpu_relax();
+                lock.lock();
+            }
+        }else{
+            phy->pusch_cond.wait(lock, ready);
+        }
+        if(!phy->pusch_running)
+            break;
+        lock.unlock();
+
+        phy->decode_pusch_allocs(worker->phy_struct);
+    }
+
+    return NULL;
+}
+void LTE_fdd_enb_phy::decode_pusch_allocs(LIBLTE_PHY_STRUCT *phy_struct)
+{
+    while(1)
+    {
+        pusch_mutex.lock();
+        if(pusch_job_next >= pusch_job_N_alloc)
+        {
+            pusch_mutex.unlock();
+            return;
+        }
+        uint32 alloc_idx   = pusch_job_next++;
+        uint32 current_tti = pusch_job_tti;
+        pusch_mutex.unlock();
+
+        decode_pusch_alloc(phy_struct, current_tti, alloc_idx);
+
+        pusch_mutex.lock();
+        pusch_job_N_done++;
+        bool done = (pusch_job_N_done == pusch_job_N_alloc);
+        pusch_mutex.unlock();
+        if(done)
+            pusch_done_cond.notify_all();
+    }
+}
+void LTE_fdd_enb_phy::decode_pusch_alloc(LIBLTE_PHY_STRUCT *phy_struct,
+                                         uint32             current_tti,
+                                         uint32             alloc_idx)
+{
+    LIBLTE_PHY_ALLOCATION_STRUCT *alloc = &ul_schedule[ul_subframe.num].decodes.ul_alloc[alloc_idx];
+
+    // Determine PHICH indecies
+    uint32 I_prb_ra      = alloc->prb[0][0];
+    uint32 n_group_phich = I_prb_ra % phy_struct->N_group_phich;
+    uint32 n_seq_phich   = (I_prb_ra/phy_struct->N_group_phich) % (2*phy_struct->N_sf_phich);
+
+    // Add NACK to PHICH
+    phich_mutex.lock();
+    phich[(ul_subframe.num + 4) % 10].present[n_group_phich][n_seq_phich] = true;
+    phich[(ul_subframe.num + 4) % 10].b[n_group_phich][n_seq_phich]       = 0;
+    phich_mutex.unlock();
+
+    // Attempt decode straight into the message that goes to MAC, without
+    // a buffer the NACK stays and the UE retransmits
+    LTE_FDD_ENB_MESSAGE_STRUCT *msg = msgq_to_mac->alloc_msg(LTE_FDD_ENB_MESSAGE_TYPE_PUSCH_DECODE,
+                                                             LTE_FDD_ENB_DEST_LAYER_MAC);
+    if(NULL == msg)
+        return;
+    LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT *decode = &msg->msg.pusch_decode;
+    // The turbo decoder has no early termination, every decode runs all of them
+    interface->count_metric(cell, LTE_FDD_ENB_METRIC_PUSCH_DECODES, 1);
+    interface->count_metric(cell, LTE_FDD_ENB_METRIC_TURBO_ITERATIONS, N_TURBO_ITERATIONS);
+    if(LIBLTE_SUCCESS == liblte_phy_pusch_channel_decode(phy_struct,
+                                                         &ul_subframe,
+                                                         alloc,
+                                                         interface->get_n_id_cell(cell),
+                                                         1,
+                                                         N_TURBO_ITERATIONS,
+                                                         decode->msg.msg,
+                                                         &decode->msg.N_bits))
+    {
+        decode->current_tti   = current_tti;
+        decode->timing_offset = phy_struct->pusch_timing_offset;
+        decode->rnti          = alloc->rnti;
+
+        msgq_to_mac->send_msg(msg);
+
+        // Add ACK to PHICH
+        phich_mutex.lock();
+        phich[(ul_subframe.num + 4) % 10].b[n_group_phich][n_seq_phich] = 1;
+        phich_mutex.unlock();
+    }else{
+        msgq_to_mac->free_msg(msg);
+        interface->count_metric(cell, LTE_FDD_ENB_METRIC_PUSCH_CRC_FAILS, 1);
+    }
 }
@@ -351,6 +351,9 @@ void LTE_fdd_enb_radio_usrp_b2x0::init(LTE_FDD_ENB_RADIO_PARAMS_STRUCT *radio_pa
                                                      radio_params->samp_rate); // Retard RX by 2 subframes
     next_rx_subfr_ts  = next_rx_ts;
 
+    // The first DL subframe the PHY sends is the one 2 subframes after RX starts
+    next_tx_current_tti = liblte_phy_add_to_tti(radio_params->rx_current_tti, 2);
+
     // Reset USRP time
     usrp->set_time_now(uhd::time_spec_t::from_ticks(0, radio_params->samp_rate));
 
@@ -915,6 +918,9 @@ void LTE_fdd_enb_radio_bladerf::init(LTE_FDD_ENB_RADIO_PARAMS_STRUCT *radio_para
     metadata_rx.flags     = 0;
     metadata_rx.timestamp = next_tx_ts - (radio_params->N_samps_per_subfr*2); // Retard RX by 2 subframes
 
+    // The first DL subframe the PHY sends is the one 2 subframes after RX starts
+    next_tx_current_tti = liblte_phy_add_to_tti(radio_params->rx_current_tti, 2);
+
     // Signal PHY to generate first subframe
     radio_params->phy->radio_interface(&radio_params->tx_radio_buf[1]);
 
@@ -965,9 +971,9 @@ void LTE_fdd_enb_radio_bladerf::receive(LTE_FDD_ENB_RADIO_PARAMS_STRUCT *radio_p
 /********************************/
 /*    Constructor/Destructor    */
 /********************************/
-LTE_fdd_enb_radio::LTE_fdd_enb_radio(LTE_fdd_enb_interface *iface, LTE_fdd_enb_phy *_phy) :
+LTE_fdd_enb_radio::LTE_fdd_enb_radio(LTE_fdd_enb_interface *iface, uint8 _cell, LTE_fdd_enb_phy *_phy) :
     started{false}, interface{iface}, phy{_phy}, clock_source{"internal"}, tx_gain{0},
-    rx_gain{0}
+    rx_gain{0}, cell{_cell}
 {
     bladerf.set_interface(interface);
 
@@ -1000,8 +1006,8 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_radio::start()
     if(false == started)
     {
         // Get the DL and UL EARFCNs
-        uint16 dl_earfcn = interface->get_dl_earfcn();
-        uint16 ul_earfcn = interface->get_ul_earfcn();
+        uint16 dl_earfcn = interface->get_dl_earfcn(cell);
+        uint16 ul_earfcn = interface->get_ul_earfcn(cell);
 
         // Get the number of TX antennas
         uint8 N_ant = interface->get_n_ant();
@@ -1149,11 +1155,11 @@ LTE_FDD_ENB_AVAILABLE_RADIOS_STRUCT LTE_fdd_enb_radio::get_available_radios()
     // bladerf devices
     find_bladerfs(&available_radios);
 
-    // Reset to sane default
+    // Reset to sane default, giving each cell its own radio when possible
     if(orig_num_radios != available_radios.num_radios)
     {
-        selected_radio_idx = 1;
-        if(1 == available_radios.num_radios)
+        selected_radio_idx = 1 + cell;
+        if(selected_radio_idx >= available_radios.num_radios)
             selected_radio_idx = 0;
         selected_radio_type = available_radios.radio[selected_radio_idx].type;
     }
@@ -1357,23 +1363,11 @@ void* LTE_fdd_enb_radio::radio_thread_func(void *inputs)
     radio->radio_params.samp_rate      = radio->radio_params.fs;
     radio->radio_params.buf_idx        = 0;
     radio->radio_params.samp_idx       = 0;
-    radio->radio_params.rx_current_tti = liblte_phy_sub_from_tti(0, 2);
+    radio->radio_params.rx_current_tti = liblte_phy_sub_from_tti(0, LTE_FDD_ENB_PHY_DL_LEAD_N_SUBFRS);
     radio->radio_params.init_needed    = true;
     radio->radio_params.rx_synced      = false;
 
-    // Set highest priority
-    struct sched_param priority;
-    int                sched_policy;
-    pthread_getschedparam(radio->radio_thread, &sched_policy, &priority);
-    priority.sched_priority = sched_get_priority_max(SCHED_FIFO);
-    pthread_setschedparam(radio->radio_thread, SCHED_FIFO, &priority);
-
-    // Set affinity to the last core for PHY/Radio
-    cpu_set_t af_mask;
-    CPU_ZERO(&af_mask);
-    uint32 num_cpus = std::thread::hardware_concurrency();
-    CPU_SET(num_cpus-1, &af_mask);
-    pthread_setaffinity_np(radio->get_radio_thread(), sizeof(af_mask), &af_mask);
+    radio->interface->setup_thread(LTE_FDD_ENB_THREAD_RADIO, radio->cell, "radio_" + std::to_string(radio->cell));
 
     switch(radio->get_selected_radio_type())
     {
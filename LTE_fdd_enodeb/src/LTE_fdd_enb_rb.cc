@@ -67,7 +67,9 @@
 #include "LTE_fdd_enb_user.h"
 #include "LTE_fdd_enb_rlc.h"
 #include "LTE_fdd_enb_mac.h"
+#include "LTE_fdd_enb_msg_pool.h"
 #include "libtools_helpers.h"
+#include <climits>
 
 /*******************************************************************************
                               DEFINES
@@ -97,12 +99,14 @@ LTE_fdd_enb_rb::LTE_fdd_enb_rb(LTE_FDD_ENB_RB_ENUM    _rb,
                                LTE_fdd_enb_user      *_user,
                                LTE_fdd_enb_rlc       *_rlc) :
     rb{_rb}, interface{iface}, timer_mgr{tm}, user{_user}, rlc{_rlc}, rrc_transaction_id{0},
-    pdcp_rx_count{0}, pdcp_tx_count{0},
+    pdcp_rx_count{0}, pdcp_tx_count{0}, rlc_tx_sdu_offset{0}, rlc_tx_sdu_queue_bytes{0},
     t_poll_retransmit_timer_id{LTE_FDD_ENB_INVALID_TIMER_ID}, rlc_vrr{0},
     rlc_vrmr{LIBLTE_RLC_AM_WINDOW_SIZE}, rlc_vrh{0}, rlc_vta{0},
     rlc_vtms{LIBLTE_RLC_AM_WINDOW_SIZE}, rlc_vts{0}, rlc_vruh{0}, rlc_vrur{0},
     rlc_um_window_size{512}, rlc_first_um_segment_sn{0xFFFF}, rlc_last_um_segment_sn{0xFFFF},
-    rlc_vtus{0}, mac_con_res_id{0}
+    rlc_vtus{0}, mac_con_res_id{0}, mac_send_con_res_id{false},
+    mac_lcp_pbr{LTE_FDD_ENB_RB_PBR_INFINITY}, mac_lcp_bsd{100}, mac_lcp_bucket{0},
+    mac_lcp_bucket_tti{0}, log_chan_group{0}
 {
     if(LTE_FDD_ENB_RB_SRB0 == rb)
     {
@@ -113,6 +117,7 @@ LTE_fdd_enb_rb::LTE_fdd_enb_rb(LTE_FDD_ENB_RB_ENUM    _rb,
         pdcp_config   = LTE_FDD_ENB_PDCP_CONFIG_N_A;
         rlc_config    = LTE_FDD_ENB_RLC_CONFIG_TM;
         mac_config    = LTE_FDD_ENB_MAC_CONFIG_TM;
+        mac_lcp_priority = 0;
     }else if(LTE_FDD_ENB_RB_SRB1 == rb){
         mme_procedure = LTE_FDD_ENB_MME_PROC_IDLE;
         mme_state     = LTE_FDD_ENB_MME_STATE_IDLE;
@@ -121,6 +126,7 @@ LTE_fdd_enb_rb::LTE_fdd_enb_rb(LTE_FDD_ENB_RB_ENUM    _rb,
         pdcp_config   = LTE_FDD_ENB_PDCP_CONFIG_N_A;
         rlc_config    = LTE_FDD_ENB_RLC_CONFIG_AM;
         mac_config    = LTE_FDD_ENB_MAC_CONFIG_TM;
+        mac_lcp_priority = 1;
     }else if(LTE_FDD_ENB_RB_SRB2 == rb){
         mme_procedure = LTE_FDD_ENB_MME_PROC_IDLE;
         mme_state     = LTE_FDD_ENB_MME_STATE_IDLE;
@@ -129,14 +135,17 @@ LTE_fdd_enb_rb::LTE_fdd_enb_rb(LTE_FDD_ENB_RB_ENUM    _rb,
         pdcp_config   = LTE_FDD_ENB_PDCP_CONFIG_N_A;
         rlc_config    = LTE_FDD_ENB_RLC_CONFIG_AM;
         mac_config    = LTE_FDD_ENB_MAC_CONFIG_TM;
+        mac_lcp_priority = 3;
     }else if(LTE_FDD_ENB_RB_DRB1 == rb){
-        pdcp_config = LTE_FDD_ENB_PDCP_CONFIG_LONG_SN;
-        rlc_config  = LTE_FDD_ENB_RLC_CONFIG_AM;
-        mac_config  = LTE_FDD_ENB_MAC_CONFIG_TM;
+        pdcp_config      = LTE_FDD_ENB_PDCP_CONFIG_LONG_SN;
+        rlc_config       = LTE_FDD_ENB_RLC_CONFIG_AM;
+        mac_config       = LTE_FDD_ENB_MAC_CONFIG_TM;
+        mac_lcp_priority = 13;
     }else if(LTE_FDD_ENB_RB_DRB2 == rb){
-        pdcp_config = LTE_FDD_ENB_PDCP_CONFIG_LONG_SN;
-        rlc_config  = LTE_FDD_ENB_RLC_CONFIG_AM;
-        mac_config  = LTE_FDD_ENB_MAC_CONFIG_TM;
+        pdcp_config      = LTE_FDD_ENB_PDCP_CONFIG_LONG_SN;
+        rlc_config       = LTE_FDD_ENB_RLC_CONFIG_AM;
+        mac_config       = LTE_FDD_ENB_MAC_CONFIG_TM;
+        mac_lcp_priority = 13;
     }
 
     // RLC
@@ -149,52 +158,55 @@ LTE_fdd_enb_rb::~LTE_fdd_enb_rb()
     // MAC
     mac_sdu_queue_mutex.lock();
     for(auto it=mac_sdu_queue.begin(); it!=mac_sdu_queue.end(); it++)
-        delete (*it);
+        LTE_fdd_enb_msg_pool::free(*it);
 
     // RLC
     rlc_pdu_queue_mutex.lock();
     for(auto it=rlc_pdu_queue.begin(); it!=rlc_pdu_queue.end(); it++)
-        delete (*it);
+        LTE_fdd_enb_msg_pool::free(*it);
     rlc_sdu_queue_mutex.lock();
     for(auto it=rlc_sdu_queue.begin(); it!=rlc_sdu_queue.end(); it++)
-        delete (*it);
+        LTE_fdd_enb_msg_pool::free(*it);
+    rlc_tx_sdu_queue_mutex.lock();
+    for(auto it=rlc_tx_sdu_queue.begin(); it!=rlc_tx_sdu_queue.end(); it++)
+        LTE_fdd_enb_msg_pool::free(*it);
     for(auto rlc_am_rx : rlc_am_rx_buffer)
-        delete rlc_am_rx.second;
+        LTE_fdd_enb_msg_pool::free(rlc_am_rx.second);
     for(auto rlc_am_tx : rlc_am_tx_buffer)
-        delete rlc_am_tx.second;
+        LTE_fdd_enb_msg_pool::free(rlc_am_tx.second);
     for(auto rlc_um_rx : rlc_um_rx_buffer)
-        delete rlc_um_rx.second;
+        LTE_fdd_enb_msg_pool::free(rlc_um_rx.second);
     if(LTE_FDD_ENB_INVALID_TIMER_ID != t_poll_retransmit_timer_id)
         timer_mgr->stop_timer(t_poll_retransmit_timer_id);
 
     // PDCP
     pdcp_pdu_queue_mutex.lock();
     for(auto it=pdcp_pdu_queue.begin(); it!=pdcp_pdu_queue.end(); it++)
-        delete (*it);
+        LTE_fdd_enb_msg_pool::free(*it);
     pdcp_sdu_queue_mutex.lock();
     for(auto it=pdcp_sdu_queue.begin(); it!=pdcp_sdu_queue.end(); it++)
-        delete (*it);
+        LTE_fdd_enb_msg_pool::free(*it);
     pdcp_data_sdu_queue_mutex.lock();
     for(auto it=pdcp_data_sdu_queue.begin(); it!=pdcp_data_sdu_queue.end(); it++)
-        delete (*it);
+        LTE_fdd_enb_msg_pool::free(*it);
 
     // RRC
     rrc_pdu_queue_mutex.lock();
     for(auto it=rrc_pdu_queue.begin(); it!=rrc_pdu_queue.end(); it++)
-        delete (*it);
+        LTE_fdd_enb_msg_pool::free(*it);
     rrc_nas_msg_queue_mutex.lock();
     for(auto it=rrc_nas_msg_queue.begin(); it!=rrc_nas_msg_queue.end(); it++)
-        delete (*it);
+        LTE_fdd_enb_msg_pool::free(*it);
 
     // MME
     mme_nas_msg_queue_mutex.lock();
     for(auto it=mme_nas_msg_queue.begin(); it!=mme_nas_msg_queue.end(); it++)
-        delete (*it);
+        LTE_fdd_enb_msg_pool::free(*it);
 
     // GW
     gw_data_msg_queue_mutex.lock();
     for(auto it=gw_data_msg_queue.begin(); it!=gw_data_msg_queue.end(); it++)
-        delete (*it);
+        LTE_fdd_enb_msg_pool::free(*it);
 }
 
 /******************/
@@ -212,11 +224,11 @@ void LTE_fdd_enb_rb::reset_user(LTE_fdd_enb_user *_user)
 /************/
 /*    GW    */
 /************/
-void LTE_fdd_enb_rb::queue_gw_data_msg(LIBLTE_BYTE_MSG_STRUCT *gw_data)
+void LTE_fdd_enb_rb::queue_gw_data_msg(LIBLTE_BYTE_BUF_STRUCT *gw_data)
 {
     queue_msg(gw_data, gw_data_msg_queue_mutex, &gw_data_msg_queue);
 }
-LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::get_next_gw_data_msg(LIBLTE_BYTE_MSG_STRUCT **gw_data)
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::get_next_gw_data_msg(LIBLTE_BYTE_BUF_STRUCT **gw_data)
 {
     return get_next_msg(gw_data_msg_queue_mutex, &gw_data_msg_queue, gw_data);
 }
@@ -382,14 +394,18 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::delete_next_pdcp_sdu()
 {
     return delete_next_msg(pdcp_sdu_queue_mutex, &pdcp_sdu_queue);
 }
-void LTE_fdd_enb_rb::queue_pdcp_data_sdu(LIBLTE_BYTE_MSG_STRUCT *sdu)
+void LTE_fdd_enb_rb::queue_pdcp_data_sdu(LIBLTE_BYTE_BUF_STRUCT *sdu)
 {
     queue_msg(sdu, pdcp_data_sdu_queue_mutex, &pdcp_data_sdu_queue);
 }
-LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::get_next_pdcp_data_sdu(LIBLTE_BYTE_MSG_STRUCT **sdu)
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::get_next_pdcp_data_sdu(LIBLTE_BYTE_BUF_STRUCT **sdu)
 {
     return get_next_msg(pdcp_data_sdu_queue_mutex, &pdcp_data_sdu_queue, sdu);
 }
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::take_next_pdcp_data_sdu(LIBLTE_BYTE_BUF_STRUCT **sdu)
+{
+    return take_next_msg(pdcp_data_sdu_queue_mutex, &pdcp_data_sdu_queue, sdu);
+}
 LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::delete_next_pdcp_data_sdu()
 {
     return delete_next_msg(pdcp_data_sdu_queue_mutex, &pdcp_data_sdu_queue);
@@ -434,18 +450,75 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::delete_next_rlc_pdu()
 {
     return delete_next_msg(rlc_pdu_queue_mutex, &rlc_pdu_queue);
 }
-void LTE_fdd_enb_rb::queue_rlc_sdu(LIBLTE_BYTE_MSG_STRUCT *sdu)
+void LTE_fdd_enb_rb::queue_rlc_sdu(LIBLTE_BYTE_BUF_STRUCT *sdu)
 {
     queue_msg(sdu, rlc_sdu_queue_mutex, &rlc_sdu_queue);
 }
-LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::get_next_rlc_sdu(LIBLTE_BYTE_MSG_STRUCT **sdu)
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::get_next_rlc_sdu(LIBLTE_BYTE_BUF_STRUCT **sdu)
 {
     return get_next_msg(rlc_sdu_queue_mutex, &rlc_sdu_queue, sdu);
 }
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::take_next_rlc_sdu(LIBLTE_BYTE_BUF_STRUCT **sdu)
+{
+    return take_next_msg(rlc_sdu_queue_mutex, &rlc_sdu_queue, sdu);
+}
 LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::delete_next_rlc_sdu()
 {
     return delete_next_msg(rlc_sdu_queue_mutex, &rlc_sdu_queue);
 }
+void LTE_fdd_enb_rb::rlc_queue_tx_sdu(LIBLTE_BYTE_BUF_STRUCT *sdu)
+{
+    std::lock_guard<std::mutex> lock(rlc_tx_sdu_queue_mutex);
+
+    rlc_tx_sdu_queue.push_back(sdu);
+    rlc_tx_sdu_queue_bytes += sdu->N_bytes;
+}
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::rlc_peek_tx_sdu(uint32                   idx,
+                                                       LIBLTE_BYTE_BUF_STRUCT **sdu)
+{
+    std::lock_guard<std::mutex> lock(rlc_tx_sdu_queue_mutex);
+
+    for(auto queued_sdu : rlc_tx_sdu_queue)
+    {
+        if(0 == idx--)
+        {
+            *sdu = queued_sdu;
+            return LTE_FDD_ENB_ERROR_NONE;
+        }
+    }
+
+    return LTE_FDD_ENB_ERROR_NO_MSG_IN_QUEUE;
+}
+uint32 LTE_fdd_enb_rb::rlc_get_tx_sdu_offset()
+{
+    std::lock_guard<std::mutex> lock(rlc_tx_sdu_queue_mutex);
+    return rlc_tx_sdu_offset;
+}
+void LTE_fdd_enb_rb::rlc_consume_tx_sdu_bytes(uint32 N_bytes)
+{
+    std::lock_guard<std::mutex> lock(rlc_tx_sdu_queue_mutex);
+
+    rlc_tx_sdu_queue_bytes -= N_bytes;
+    while(0 != N_bytes && 0 != rlc_tx_sdu_queue.size())
+    {
+        LIBLTE_BYTE_BUF_STRUCT *sdu    = rlc_tx_sdu_queue.front();
+        uint32                  N_left = sdu->N_bytes - rlc_tx_sdu_offset;
+        if(N_bytes < N_left)
+        {
+            rlc_tx_sdu_offset += N_bytes;
+            break;
+        }
+        N_bytes           -= N_left;
+        rlc_tx_sdu_offset  = 0;
+        rlc_tx_sdu_queue.pop_front();
+        LTE_fdd_enb_msg_pool::free(sdu);
+    }
+}
+uint32 LTE_fdd_enb_rb::rlc_get_tx_sdu_queue_bytes()
+{
+    std::lock_guard<std::mutex> lock(rlc_tx_sdu_queue_mutex);
+    return rlc_tx_sdu_queue_bytes;
+}
 LTE_FDD_ENB_RLC_CONFIG_ENUM LTE_fdd_enb_rb::get_rlc_config()
 {
     return rlc_config;
@@ -488,18 +561,8 @@ void LTE_fdd_enb_rb::set_rlc_vrh(uint16 vrh)
 }
 void LTE_fdd_enb_rb::rlc_add_to_am_reception_buffer(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *amd_pdu)
 {
-    LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *new_pdu = new LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT;
-
-    if(NULL == new_pdu)
-        return;
-
     if(rlc_am_rx_buffer.end() == rlc_am_rx_buffer.find(amd_pdu->hdr.sn))
-    {
-        memcpy(new_pdu, amd_pdu, sizeof(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT));
-        rlc_am_rx_buffer[amd_pdu->hdr.sn] = new_pdu;
-    }else{
-        delete new_pdu;
-    }
+        rlc_am_rx_buffer[amd_pdu->hdr.sn] = LTE_fdd_enb_msg_pool::copy_amd_pdu(amd_pdu);
 }
 void LTE_fdd_enb_rb::rlc_get_am_reception_buffer_status(LIBLTE_RLC_STATUS_PDU_STRUCT *status)
 {
@@ -573,7 +636,7 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::rlc_am_reassemble(LIBLTE_BYTE_MSG_STRUCT
                 auto rlc_am_rx_it = rlc_am_rx_buffer.find(i);
                 memcpy(&sdu->msg[sdu->N_bytes], (*rlc_am_rx_it).second->data.msg, (*rlc_am_rx_it).second->data.N_bytes);
                 sdu->N_bytes += (*rlc_am_rx_it).second->data.N_bytes;
-                delete (*rlc_am_rx_it).second;
+                LTE_fdd_enb_msg_pool::free((*rlc_am_rx_it).second);
                 rlc_am_rx_buffer.erase(rlc_am_rx_it);
             }
             err = LTE_FDD_ENB_ERROR_NONE;
@@ -604,15 +667,14 @@ void LTE_fdd_enb_rb::set_rlc_vts(uint16 vts)
 {
     rlc_vts = vts;
 }
-void LTE_fdd_enb_rb::rlc_add_to_transmission_buffer(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *amd_pdu)
+void LTE_fdd_enb_rb::rlc_add_to_transmission_buffer(uint16                  sn,
+                                                    LIBLTE_BYTE_MSG_STRUCT *pdu)
 {
-    LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *new_pdu = new LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT;
+    auto rlc_am_tx_it = rlc_am_tx_buffer.find(sn);
 
-    if(NULL == new_pdu)
-        return;
-
-    memcpy(new_pdu, amd_pdu, sizeof(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT));
-    rlc_am_tx_buffer[amd_pdu->hdr.sn] = new_pdu;
+    if(rlc_am_tx_buffer.end() != rlc_am_tx_it)
+        LTE_fdd_enb_msg_pool::free((*rlc_am_tx_it).second);
+    rlc_am_tx_buffer[sn] = LTE_fdd_enb_msg_pool::copy_byte_msg(pdu);
 }
 void LTE_fdd_enb_rb::rlc_update_transmission_buffer(LIBLTE_RLC_STATUS_PDU_STRUCT *status)
 {
@@ -638,7 +700,7 @@ void LTE_fdd_enb_rb::rlc_update_transmission_buffer(LIBLTE_RLC_STATUS_PDU_STRUCT
             auto rlc_am_tx_it = rlc_am_tx_buffer.find(i);
             if(rlc_am_tx_buffer.end() != rlc_am_tx_it)
             {
-                delete (*rlc_am_tx_it).second;
+                LTE_fdd_enb_msg_pool::free((*rlc_am_tx_it).second);
                 rlc_am_tx_buffer.erase(rlc_am_tx_it);
             }
             if(update_vta)
@@ -663,13 +725,20 @@ void LTE_fdd_enb_rb::rlc_stop_t_poll_retransmit()
     t_poll_retransmit_timer_id = LTE_FDD_ENB_INVALID_TIMER_ID;
 }
 void LTE_fdd_enb_rb::handle_t_poll_retransmit_timer_expiry(uint32 timer_id)
+{
+    rlc->handle_retransmit(user, this);
+}
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::rlc_t_poll_retransmit_expired(LIBLTE_BYTE_MSG_STRUCT **pdu)
 {
     auto rlc_am_tx_it = rlc_am_tx_buffer.find(rlc_vta);
 
     t_poll_retransmit_timer_id = LTE_FDD_ENB_INVALID_TIMER_ID;
 
-    if(rlc_am_tx_buffer.end() != rlc_am_tx_it)
-        rlc->handle_retransmit((*rlc_am_tx_it).second, user, this);
+    if(rlc_am_tx_buffer.end() == rlc_am_tx_it)
+        return LTE_FDD_ENB_ERROR_NO_MSG_IN_QUEUE;
+
+    *pdu = (*rlc_am_tx_it).second;
+    return LTE_FDD_ENB_ERROR_NONE;
 }
 void LTE_fdd_enb_rb::set_rlc_vruh(uint16 vruh)
 {
@@ -694,19 +763,10 @@ uint16 LTE_fdd_enb_rb::get_rlc_um_window_size()
 void LTE_fdd_enb_rb::rlc_add_to_um_reception_buffer(LIBLTE_RLC_UMD_PDU_STRUCT *umd_pdu,
                                                     uint32                     idx)
 {
-    LIBLTE_RLC_UMD_PDU_STRUCT *new_pdu = new LIBLTE_RLC_UMD_PDU_STRUCT;
-
-    if(NULL == new_pdu)
-        return;
-
     if(rlc_um_rx_buffer.end() != rlc_um_rx_buffer.find(umd_pdu->hdr.sn))
-    {
-        delete new_pdu;
         return;
-    }
 
-    memcpy(new_pdu, &umd_pdu->data[idx], sizeof(LIBLTE_BYTE_MSG_STRUCT));
-    rlc_um_rx_buffer[umd_pdu->hdr.sn] = new_pdu;
+    rlc_um_rx_buffer[umd_pdu->hdr.sn] = LTE_fdd_enb_msg_pool::copy_umd_pdu(umd_pdu, idx);
 }
 LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::rlc_um_reassemble(LIBLTE_BYTE_MSG_STRUCT *sdu)
 {
@@ -758,7 +818,7 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::rlc_um_reassemble(LIBLTE_BYTE_MSG_STRUCT
                 auto rlc_um_rx_it = rlc_um_rx_buffer.find(i);
                 memcpy(&sdu->msg[sdu->N_bytes], (*rlc_um_rx_it).second->data[0].msg, (*rlc_um_rx_it).second->data[0].N_bytes);
                 sdu->N_bytes += (*rlc_um_rx_it).second->data[0].N_bytes;
-                delete (*rlc_um_rx_it).second;
+                LTE_fdd_enb_msg_pool::free((*rlc_um_rx_it).second);
                 rlc_um_rx_buffer.erase(rlc_um_rx_it);
             }
             err = LTE_FDD_ENB_ERROR_NONE;
@@ -812,6 +872,65 @@ bool LTE_fdd_enb_rb::get_send_con_res_id()
 {
     return mac_send_con_res_id;
 }
+uint32 LTE_fdd_enb_rb::get_mac_sdu_queue_bytes()
+{
+    std::lock_guard<std::mutex> lock(mac_sdu_queue_mutex);
+    uint32                      N_bytes = 0;
+
+    for(auto sdu : mac_sdu_queue)
+        N_bytes += sdu->N_bytes;
+
+    return N_bytes;
+}
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::peek_mac_sdu(uint32                   idx,
+                                                    LIBLTE_BYTE_MSG_STRUCT **sdu)
+{
+    std::lock_guard<std::mutex> lock(mac_sdu_queue_mutex);
+
+    for(auto queued_sdu : mac_sdu_queue)
+    {
+        if(0 == idx--)
+        {
+            *sdu = queued_sdu;
+            return LTE_FDD_ENB_ERROR_NONE;
+        }
+    }
+
+    return LTE_FDD_ENB_ERROR_NO_MSG_IN_QUEUE;
+}
+void LTE_fdd_enb_rb::set_mac_lcp_config(uint8  priority,
+                                        uint32 pbr,
+                                        uint32 bucket_size_duration)
+{
+    mac_lcp_priority = priority;
+    mac_lcp_pbr      = pbr;
+    mac_lcp_bsd      = bucket_size_duration;
+    mac_lcp_bucket   = 0;
+}
+uint8 LTE_fdd_enb_rb::get_mac_lcp_priority()
+{
+    return mac_lcp_priority;
+}
+int64 LTE_fdd_enb_rb::get_mac_lcp_bucket(uint32 current_tti)
+{
+    if(LTE_FDD_ENB_RB_PBR_INFINITY == mac_lcp_pbr)
+        return LLONG_MAX;
+
+    // Bj grows by PBR every TTI up to PBR * bucketSizeDuration, kbps is bits per ms
+    int64 N_bytes_per_tti = mac_lcp_pbr/8;
+    int64 max_bucket      = N_bytes_per_tti * mac_lcp_bsd;
+    mac_lcp_bucket       += N_bytes_per_tti * liblte_phy_sub_from_tti(current_tti, mac_lcp_bucket_tti);
+    mac_lcp_bucket_tti    = current_tti;
+    if(mac_lcp_bucket > max_bucket)
+        mac_lcp_bucket = max_bucket;
+
+    return mac_lcp_bucket;
+}
+void LTE_fdd_enb_rb::consume_mac_lcp_bucket(uint32 N_bytes)
+{
+    if(LTE_FDD_ENB_RB_PBR_INFINITY != mac_lcp_pbr)
+        mac_lcp_bucket -= N_bytes;
+}
 
 /*************/
 /*    DRB    */
@@ -856,22 +975,29 @@ void LTE_fdd_enb_rb::queue_msg(LIBLTE_BIT_MSG_STRUCT              *msg,
                                std::mutex                         &mutex,
                                std::list<LIBLTE_BIT_MSG_STRUCT *> *queue)
 {
+    LIBLTE_BIT_MSG_STRUCT       *loc_msg = LTE_fdd_enb_msg_pool::copy_bit_msg(msg);
     std::lock_guard<std::mutex>  lock(mutex);
-    LIBLTE_BIT_MSG_STRUCT       *loc_msg = new LIBLTE_BIT_MSG_STRUCT;
 
-    memcpy(loc_msg, msg, sizeof(LIBLTE_BIT_MSG_STRUCT));
     queue->push_back(loc_msg);
 }
 void LTE_fdd_enb_rb::queue_msg(LIBLTE_BYTE_MSG_STRUCT              *msg,
                                std::mutex                          &mutex,
                                std::list<LIBLTE_BYTE_MSG_STRUCT *> *queue)
 {
+    LIBLTE_BYTE_MSG_STRUCT      *loc_msg = LTE_fdd_enb_msg_pool::copy_byte_msg(msg);
     std::lock_guard<std::mutex>  lock(mutex);
-    LIBLTE_BYTE_MSG_STRUCT      *loc_msg = new LIBLTE_BYTE_MSG_STRUCT;
 
-    memcpy(loc_msg, msg, sizeof(LIBLTE_BYTE_MSG_STRUCT));
     queue->push_back(loc_msg);
 }
+// Buffers are queued as is, ownership passes to the queue
+void LTE_fdd_enb_rb::queue_msg(LIBLTE_BYTE_BUF_STRUCT              *msg,
+                               std::mutex                          &mutex,
+                               std::list<LIBLTE_BYTE_BUF_STRUCT *> *queue)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    queue->push_back(msg);
+}
 LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::get_next_msg(std::mutex                          &mutex,
                                                     std::list<LIBLTE_BIT_MSG_STRUCT *>  *queue,
                                                     LIBLTE_BIT_MSG_STRUCT              **msg)
@@ -896,6 +1022,32 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::get_next_msg(std::mutex
     *msg = queue->front();
     return LTE_FDD_ENB_ERROR_NONE;
 }
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::get_next_msg(std::mutex                           &mutex,
+                                                    std::list<LIBLTE_BYTE_BUF_STRUCT *>  *queue,
+                                                    LIBLTE_BYTE_BUF_STRUCT              **msg)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if(0 == queue->size())
+        return LTE_FDD_ENB_ERROR_NO_MSG_IN_QUEUE;
+
+    *msg = queue->front();
+    return LTE_FDD_ENB_ERROR_NONE;
+}
+// Removes the next buffer without freeing it, ownership passes to the caller
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::take_next_msg(std::mutex                           &mutex,
+                                                     std::list<LIBLTE_BYTE_BUF_STRUCT *>  *queue,
+                                                     LIBLTE_BYTE_BUF_STRUCT              **msg)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+
+    if(0 == queue->size())
+        return LTE_FDD_ENB_ERROR_NO_MSG_IN_QUEUE;
+
+    *msg = queue->front();
+    queue->pop_front();
+    return LTE_FDD_ENB_ERROR_NONE;
+}
 LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::delete_next_msg(std::mutex                         &mutex,
                                                        std::list<LIBLTE_BIT_MSG_STRUCT *> *queue)
 {
@@ -907,7 +1059,7 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::delete_next_msg(std::mutex
 
     msg = queue->front();
     queue->pop_front();
-    delete msg;
+    LTE_fdd_enb_msg_pool::free(msg);
     return LTE_FDD_ENB_ERROR_NONE;
 }
 LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::delete_next_msg(std::mutex                          &mutex,
@@ -921,6 +1073,20 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::delete_next_msg(std::mutex
 
     msg = queue->front();
     queue->pop_front();
-    delete msg;
+    LTE_fdd_enb_msg_pool::free(msg);
+    return LTE_FDD_ENB_ERROR_NONE;
+}
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_rb::delete_next_msg(std::mutex                          &mutex,
+                                                       std::list<LIBLTE_BYTE_BUF_STRUCT *> *queue)
+{
+    std::lock_guard<std::mutex>  lock(mutex);
+    LIBLTE_BYTE_BUF_STRUCT      *msg;
+
+    if(0 == queue->size())
+        return LTE_FDD_ENB_ERROR_NO_MSG_IN_QUEUE;
+
+    msg = queue->front();
+    queue->pop_front();
+    LTE_fdd_enb_msg_pool::free(msg);
     return LTE_FDD_ENB_ERROR_NONE;
 }
@@ -56,6 +56,7 @@
 *******************************************************************************/
 
 #include "LTE_fdd_enb_rlc.h"
+#include "LTE_fdd_enb_msg_pool.h"
 #include "liblte_rlc.h"
 
 /*******************************************************************************
@@ -94,7 +95,7 @@ LTE_fdd_enb_rlc::~LTE_fdd_enb_rlc()
 /********************/
 void LTE_fdd_enb_rlc::start(LTE_fdd_enb_msgq *from_mac,
                             LTE_fdd_enb_msgq *from_pdcp,
-                            LTE_fdd_enb_msgq *to_mac,
+                            LTE_fdd_enb_msgq **to_mac,
                             LTE_fdd_enb_msgq *to_pdcp)
 {
     std::lock_guard<std::mutex> lock(start_mutex);
@@ -105,8 +106,9 @@ void LTE_fdd_enb_rlc::start(LTE_fdd_enb_msgq *from_mac,
     started        = true;
     msgq_from_mac  = from_mac;
     msgq_from_pdcp = from_pdcp;
-    msgq_to_mac    = to_mac;
     msgq_to_pdcp   = to_pdcp;
+    for(uint32 i=0; i<LTE_FDD_ENB_MAX_N_CELLS; i++)
+        msgq_to_mac[i] = to_mac[i];
     LTE_fdd_enb_msgq_cb mac_cb(&LTE_fdd_enb_msgq_cb_wrapper<LTE_fdd_enb_rlc, &LTE_fdd_enb_rlc::handle_mac_msg>, this);
     msgq_from_mac->attach_rx(mac_cb);
     LTE_fdd_enb_msgq_cb pdcp_cb(&LTE_fdd_enb_msgq_cb_wrapper<LTE_fdd_enb_rlc, &LTE_fdd_enb_rlc::handle_pdcp_msg>, this);
@@ -143,7 +145,18 @@ void LTE_fdd_enb_rlc::handle_pdcp_msg(LTE_FDD_ENB_MESSAGE_STRUCT &msg)
 {
     if(LTE_FDD_ENB_DEST_LAYER_RLC != msg.dest_layer &&
        LTE_FDD_ENB_DEST_LAYER_ANY != msg.dest_layer)
-        return msgq_to_mac->send(msg); // Forward message to MAC
+    {
+        // Forward message to the user's MAC
+        LTE_fdd_enb_user *user = get_msg_user(msg);
+        if(NULL != user)
+            return msgq_to_mac[user->get_cell()]->send(msg);
+        return interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
+                                         LTE_FDD_ENB_DEBUG_LEVEL_RLC,
+                                         __FILE__,
+                                         __LINE__,
+                                         "Can not forward PDCP message %s without a user",
+                                         LTE_fdd_enb_message_type_text[msg.type]);
+    }
 
     if(msg.type == LTE_FDD_ENB_MESSAGE_TYPE_RLC_SDU_READY)
         return handle_sdu_ready(&msg.msg.rlc_sdu_ready);
@@ -159,8 +172,6 @@ void LTE_fdd_enb_rlc::send_mac_sdu_ready(LTE_fdd_enb_user       *user,
                                          LTE_fdd_enb_rb         *rb,
                                          LIBLTE_BYTE_MSG_STRUCT *sdu)
 {
-    LTE_FDD_ENB_MAC_SDU_READY_MSG_STRUCT sdu_ready;
-
     rb->queue_mac_sdu(sdu);
 
     interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
@@ -174,12 +185,19 @@ void LTE_fdd_enb_rlc::send_mac_sdu_ready(LTE_fdd_enb_user       *user,
                               rb->get_rlc_vta(),
                               rb->get_rlc_vtms());
 
+    send_mac_data_ready(user, rb);
+}
+void LTE_fdd_enb_rlc::send_mac_data_ready(LTE_fdd_enb_user *user,
+                                          LTE_fdd_enb_rb   *rb)
+{
+    LTE_FDD_ENB_MAC_SDU_READY_MSG_STRUCT sdu_ready;
+
     sdu_ready.user = user;
     sdu_ready.rb   = rb;
-    msgq_to_mac->send(LTE_FDD_ENB_MESSAGE_TYPE_MAC_SDU_READY,
-                      LTE_FDD_ENB_DEST_LAYER_MAC,
-                      (LTE_FDD_ENB_MESSAGE_UNION *)&sdu_ready,
-                      sizeof(sdu_ready));
+    msgq_to_mac[user->get_cell()]->send(LTE_FDD_ENB_MESSAGE_TYPE_MAC_SDU_READY,
+                                        LTE_FDD_ENB_DEST_LAYER_MAC,
+                                        (LTE_FDD_ENB_MESSAGE_UNION *)&sdu_ready,
+                                        sizeof(sdu_ready));
 }
 void LTE_fdd_enb_rlc::send_pdcp_pdu_ready(LTE_fdd_enb_user       *user,
                                           LTE_fdd_enb_rb         *rb,
@@ -214,15 +232,20 @@ void LTE_fdd_enb_rlc::update_sys_info()
     std::lock_guard<std::mutex>  lock(sys_info_mutex);
     interface->get_sys_info(sys_info);
 }
-void LTE_fdd_enb_rlc::handle_retransmit(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *amd,
-                                        LTE_fdd_enb_user                 *user,
-                                        LTE_fdd_enb_rb                   *rb)
+void LTE_fdd_enb_rlc::handle_retransmit(LTE_fdd_enb_user *user,
+                                        LTE_fdd_enb_rb   *rb)
 {
-    LIBLTE_BYTE_MSG_STRUCT pdu;
+    std::lock_guard<std::mutex>  lock(tx_mutex);
+    LIBLTE_BYTE_MSG_STRUCT      *stored_pdu;
+    LIBLTE_BYTE_MSG_STRUCT       pdu;
 
-    // Pack the PDU
-    amd->hdr.p = LIBLTE_RLC_P_FIELD_STATUS_REPORT_REQUESTED;
-    liblte_rlc_pack_amd_pdu(amd, &amd->data, &pdu);
+    if(LTE_FDD_ENB_ERROR_NONE != rb->rlc_t_poll_retransmit_expired(&stored_pdu))
+        return;
+
+    // Resend the stored PDU as is, with the poll bit set.  It is pooled,
+    // so only its bytes are backed.
+    memcpy(&pdu, stored_pdu, offsetof(LIBLTE_BYTE_MSG_STRUCT, msg) + stored_pdu->N_bytes);
+    pdu.msg[0] |= (LIBLTE_RLC_P_FIELD_STATUS_REPORT_REQUESTED & 0x01) << 5;
 
     // Start t-pollretransmit
     rb->rlc_start_t_poll_retransmit();
@@ -231,19 +254,33 @@ void LTE_fdd_enb_rlc::handle_retransmit(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *amd,
                               LTE_FDD_ENB_DEBUG_LEVEL_RLC,
                               __FILE__,
                               __LINE__,
-                              "Re-sending AMD PDU for RNTI=%u, RB=%s, VT(A)=%u, SN=%u, VT(MS)=%u, RF=%s, P=%s, FI=%s",
+                              "Re-sending AMD PDU for RNTI=%u, RB=%s, VT(A)=%u, SN=%u, VT(MS)=%u",
                               user->get_c_rnti(),
                               LTE_fdd_enb_rb_text[rb->get_rb_id()],
                               rb->get_rlc_vta(),
-                              amd->hdr.sn,
-                              rb->get_rlc_vtms(),
-                              liblte_rlc_rf_field_text[amd->hdr.rf],
-                              liblte_rlc_p_field_text[amd->hdr.p],
-                              liblte_rlc_fi_field_text[amd->hdr.fi]);
+                              ((pdu.msg[0] & 0x03) << 8) | pdu.msg[1],
+                              rb->get_rlc_vtms());
 
     // Send the SDU to MAC
     send_mac_sdu_ready(user, rb, &pdu);
 }
+bool LTE_fdd_enb_rlc::build_mac_sdu(LTE_fdd_enb_user       *user,
+                                    LTE_fdd_enb_rb         *rb,
+                                    uint32                  N_bytes,
+                                    LIBLTE_BYTE_MSG_STRUCT *sdu)
+{
+    std::lock_guard<std::mutex> lock(tx_mutex);
+
+    switch(rb->get_rlc_config())
+    {
+    case LTE_FDD_ENB_RLC_CONFIG_UM:
+        return build_umd_pdu(user, rb, N_bytes, sdu);
+    case LTE_FDD_ENB_RLC_CONFIG_AM:
+        return build_amd_pdu(user, rb, N_bytes, sdu);
+    default:
+        return false;
+    }
+}
 
 /******************************/
 /*    MAC Message Handlers    */
@@ -492,7 +529,9 @@ void LTE_fdd_enb_rlc::handle_status_pdu(LIBLTE_BYTE_MSG_STRUCT *pdu,
 
     liblte_rlc_unpack_status_pdu(pdu, &status);
 
+    tx_mutex.lock();
     rb->rlc_update_transmission_buffer(&status);
+    tx_mutex.unlock();
 
     interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
                               LTE_FDD_ENB_DEBUG_LEVEL_RLC,
@@ -507,9 +546,9 @@ void LTE_fdd_enb_rlc::handle_status_pdu(LIBLTE_BYTE_MSG_STRUCT *pdu,
 /*******************************/
 void LTE_fdd_enb_rlc::handle_sdu_ready(LTE_FDD_ENB_RLC_SDU_READY_MSG_STRUCT *sdu_ready)
 {
-    LIBLTE_BYTE_MSG_STRUCT *sdu;
+    LIBLTE_BYTE_BUF_STRUCT *sdu;
 
-    if(LTE_FDD_ENB_ERROR_NONE != sdu_ready->rb->get_next_rlc_sdu(&sdu))
+    if(LTE_FDD_ENB_ERROR_NONE != sdu_ready->rb->take_next_rlc_sdu(&sdu))
         return interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ERROR,
                                          LTE_FDD_ENB_DEBUG_LEVEL_RLC,
                                          __FILE__,
@@ -545,16 +584,16 @@ void LTE_fdd_enb_rlc::handle_sdu_ready(LTE_FDD_ENB_RLC_SDU_READY_MSG_STRUCT *sdu
                                   sdu_ready->user->get_c_rnti(),
                                   LTE_fdd_enb_rb_text[sdu_ready->rb->get_rb_id()],
                                   LTE_fdd_enb_rlc_config_text[sdu_ready->rb->get_rlc_config()]);
+        LTE_fdd_enb_msg_pool::free(sdu);
         break;
     }
-
-    // Delete the SDU
-    sdu_ready->rb->delete_next_rlc_sdu();
 }
-void LTE_fdd_enb_rlc::handle_tm_sdu(LIBLTE_BYTE_MSG_STRUCT *sdu,
+void LTE_fdd_enb_rlc::handle_tm_sdu(LIBLTE_BYTE_BUF_STRUCT *sdu,
                                     LTE_fdd_enb_user       *user,
                                     LTE_fdd_enb_rb         *rb)
 {
+    LIBLTE_BYTE_MSG_STRUCT tmd_pdu;
+
     interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
                               LTE_FDD_ENB_DEBUG_LEVEL_RLC,
                               __FILE__,
@@ -564,116 +603,28 @@ void LTE_fdd_enb_rlc::handle_tm_sdu(LIBLTE_BYTE_MSG_STRUCT *sdu,
                               LTE_fdd_enb_rb_text[rb->get_rb_id()]);
 
     // Send the PDU to MAC
-    send_mac_sdu_ready(user, rb, sdu);
+    memcpy(tmd_pdu.msg, liblte_byte_buf_data(sdu), sdu->N_bytes);
+    tmd_pdu.N_bytes = sdu->N_bytes;
+    LTE_fdd_enb_msg_pool::free(sdu);
+    send_mac_sdu_ready(user, rb, &tmd_pdu);
 }
-void LTE_fdd_enb_rlc::handle_um_sdu(LIBLTE_BYTE_MSG_STRUCT *sdu,
+void LTE_fdd_enb_rlc::handle_um_sdu(LIBLTE_BYTE_BUF_STRUCT *sdu,
                                     LTE_fdd_enb_user       *user,
                                     LTE_fdd_enb_rb         *rb)
 {
-    LIBLTE_RLC_UMD_PDU_STRUCT umd;
-    LIBLTE_BYTE_MSG_STRUCT    pdu;
-    uint32                    byte_idx        = 0;
-    uint32                    bytes_per_subfn = user->get_max_dl_bytes_per_subfn();
-    uint16                    vtus            = rb->get_rlc_vtus();
-
-    if(sdu->N_bytes <= bytes_per_subfn)
-    {
-        // Pack the PDU
-        umd.hdr.fi      = LIBLTE_RLC_FI_FIELD_FULL_SDU;
-        umd.hdr.sn      = vtus;
-        umd.hdr.sn_size = LIBLTE_RLC_UMD_SN_SIZE_10_BITS;
-        umd.N_data      = 1;
-        memcpy(&umd.data, sdu, sizeof(LIBLTE_BYTE_MSG_STRUCT));
-        rb->set_rlc_vtus(vtus+1);
-        liblte_rlc_pack_umd_pdu(&umd, &pdu);
-
-        // Send the PDU to MAC
-        send_mac_sdu_ready(user, rb, &pdu);
-
-        return;
-    }
-
-    // Segment the message
-    while(byte_idx < sdu->N_bytes)
-    {
-        umd.hdr.fi = LIBLTE_RLC_FI_FIELD_MIDDLE_SDU_SEGMENT;
-        umd.hdr.sn = vtus;
-        if(byte_idx == 0)
-            umd.hdr.fi = LIBLTE_RLC_FI_FIELD_FIRST_SDU_SEGMENT;
-        if((sdu->N_bytes - byte_idx) >= bytes_per_subfn)
-        {
-            memcpy(&umd.data[0].msg[0], &sdu->msg[byte_idx], bytes_per_subfn);
-            umd.data[0].N_bytes  = bytes_per_subfn;
-            byte_idx            += bytes_per_subfn;
-        }else{
-            memcpy(&umd.data[0].msg[0], &sdu->msg[byte_idx], sdu->N_bytes - byte_idx);
-            umd.data[0].N_bytes = sdu->N_bytes - byte_idx;
-            byte_idx            = sdu->N_bytes;
-        }
-        umd.N_data = 1;
-        if(byte_idx == sdu->N_bytes)
-            umd.hdr.fi = LIBLTE_RLC_FI_FIELD_LAST_SDU_SEGMENT;
-        rb->set_rlc_vtus(vtus+1);
-        vtus = rb->get_rlc_vtus();
-        liblte_rlc_pack_umd_pdu(&umd, &pdu);
-
-        // Send the PDU to MAC
-        send_mac_sdu_ready(user, rb, &pdu);
-    }
+    // UMD PDUs are built to size when MAC has a grant for this RB, the
+    // RB owns the SDU from here
+    rb->rlc_queue_tx_sdu(sdu);
+    send_mac_data_ready(user, rb);
 }
-void LTE_fdd_enb_rlc::handle_am_sdu(LIBLTE_BYTE_MSG_STRUCT *sdu,
+void LTE_fdd_enb_rlc::handle_am_sdu(LIBLTE_BYTE_BUF_STRUCT *sdu,
                                     LTE_fdd_enb_user       *user,
                                     LTE_fdd_enb_rb         *rb)
 {
-    LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT amd;
-    uint32                           byte_idx        = 0;
-    uint32                           bytes_per_subfn = user->get_max_dl_bytes_per_subfn();
-    uint16                           vts             = rb->get_rlc_vts();
-
-    if(sdu->N_bytes <= bytes_per_subfn)
-    {
-        amd.hdr.dc = LIBLTE_RLC_DC_FIELD_DATA_PDU;
-        amd.hdr.rf = LIBLTE_RLC_RF_FIELD_AMD_PDU;
-        amd.hdr.sn = vts;
-        amd.hdr.p  = LIBLTE_RLC_P_FIELD_STATUS_REPORT_REQUESTED;
-        amd.hdr.fi = LIBLTE_RLC_FI_FIELD_FULL_SDU;
-        memcpy(&amd.data, sdu, sizeof(LIBLTE_BYTE_MSG_STRUCT));
-        rb->set_rlc_vts(vts+1);
-
-        send_amd_pdu(&amd, user, rb);
-        return;
-    }
-
-    // Segment the message
-    while(byte_idx < sdu->N_bytes)
-    {
-        amd.hdr.dc = LIBLTE_RLC_DC_FIELD_DATA_PDU;
-        amd.hdr.rf = LIBLTE_RLC_RF_FIELD_AMD_PDU;
-        amd.hdr.sn = vts;
-        amd.hdr.p  = LIBLTE_RLC_P_FIELD_STATUS_REPORT_NOT_REQUESTED;
-        amd.hdr.fi = LIBLTE_RLC_FI_FIELD_MIDDLE_SDU_SEGMENT;
-        if(byte_idx == 0)
-            amd.hdr.fi = LIBLTE_RLC_FI_FIELD_FIRST_SDU_SEGMENT;
-        if((sdu->N_bytes - byte_idx) >= bytes_per_subfn)
-        {
-            memcpy(&amd.data.msg[0], &sdu->msg[byte_idx], bytes_per_subfn);
-            amd.data.N_bytes  = bytes_per_subfn;
-            byte_idx         += bytes_per_subfn;
-        }else{
-            memcpy(&amd.data.msg[0], &sdu->msg[byte_idx], sdu->N_bytes - byte_idx);
-            amd.data.N_bytes = sdu->N_bytes - byte_idx;
-            byte_idx         = sdu->N_bytes;
-        }
-        if(byte_idx == sdu->N_bytes)
-        {
-            amd.hdr.fi = LIBLTE_RLC_FI_FIELD_LAST_SDU_SEGMENT;
-            amd.hdr.p  = LIBLTE_RLC_P_FIELD_STATUS_REPORT_REQUESTED;
-        }
-        rb->set_rlc_vts(vts+1);
-        vts = rb->get_rlc_vts();
-
-        send_amd_pdu(&amd, user, rb);
-    }
+    // AMD PDUs are built to size when MAC has a grant for this RB, the
+    // RB owns the SDU from here
+    rb->rlc_queue_tx_sdu(sdu);
+    send_mac_data_ready(user, rb);
 }
 
 /******************************/
@@ -699,54 +650,173 @@ void LTE_fdd_enb_rlc::send_status_pdu(LIBLTE_RLC_STATUS_PDU_STRUCT *status_pdu,
     // Send the PDU to MAC
     send_mac_sdu_ready(user, rb, &mac_sdu);
 }
-void LTE_fdd_enb_rlc::send_amd_pdu(LIBLTE_RLC_SINGLE_AMD_PDU_STRUCT *amd,
-                                   LTE_fdd_enb_user                 *user,
-                                   LTE_fdd_enb_rb                   *rb)
+bool LTE_fdd_enb_rlc::build_umd_pdu(LTE_fdd_enb_user       *user,
+                                    LTE_fdd_enb_rb         *rb,
+                                    uint32                  N_bytes,
+                                    LIBLTE_BYTE_MSG_STRUCT *pdu)
 {
-    LIBLTE_BYTE_MSG_STRUCT pdu;
-    uint16                 vta  = rb->get_rlc_vta();
-    uint16                 vtms = rb->get_rlc_vtms();
+    LIBLTE_RLC_UMD_PDU_STRUCT  umd;
+    LIBLTE_BYTE_MSG_STRUCT    *data[LIBLTE_RLC_UMD_MAX_N_DATA];
+    uint16                     vtus = rb->get_rlc_vtus();
+
+    for(uint32 i=0; i<LIBLTE_RLC_UMD_MAX_N_DATA; i++)
+        data[i] = &umd.data[i];
+    umd.N_data = read_tx_sdus(rb,
+                              LTE_FDD_ENB_RLC_UMD_FIXED_HDR_BYTES,
+                              N_bytes,
+                              LIBLTE_RLC_UMD_MAX_N_DATA,
+                              data,
+                              &umd.hdr.fi);
+    if(0 == umd.N_data)
+        return false;
 
     // Pack the PDU
-    liblte_rlc_pack_amd_pdu(amd, &amd->data, &pdu);
-
-    // Store
-    rb->rlc_add_to_transmission_buffer(amd);
+    umd.hdr.sn      = vtus;
+    umd.hdr.sn_size = LIBLTE_RLC_UMD_SN_SIZE_10_BITS;
+    rb->set_rlc_vtus((vtus+1) % 1024);
+    liblte_rlc_pack_umd_pdu(&umd, pdu);
 
-    // Start t-pollretransmit
-    rb->rlc_start_t_poll_retransmit();
+    interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                              LTE_FDD_ENB_DEBUG_LEVEL_RLC,
+                              __FILE__,
+                              __LINE__,
+                              pdu,
+                              "Sending UMD PDU for RNTI=%u, RB=%s, SN=%u, FI=%s, N_data=%u, N_bytes=%u/%u",
+                              user->get_c_rnti(),
+                              LTE_fdd_enb_rb_text[rb->get_rb_id()],
+                              umd.hdr.sn,
+                              liblte_rlc_fi_field_text[umd.hdr.fi],
+                              umd.N_data,
+                              pdu->N_bytes,
+                              N_bytes);
 
-    if(vta         <= amd->hdr.sn &&
-       amd->hdr.sn <  vtms)
+    return true;
+}
+bool LTE_fdd_enb_rlc::build_amd_pdu(LTE_fdd_enb_user       *user,
+                                    LTE_fdd_enb_rb         *rb,
+                                    uint32                  N_bytes,
+                                    LIBLTE_BYTE_MSG_STRUCT *pdu)
+{
+    LIBLTE_RLC_AMD_PDUS_STRUCT  amd;
+    LIBLTE_BYTE_MSG_STRUCT     *data[LIBLTE_RLC_AMD_MAX_N_PDU];
+    LIBLTE_RLC_FI_FIELD_ENUM    fi;
+    uint16                      vta = rb->get_rlc_vta();
+    uint16                      vts = rb->get_rlc_vts();
+
+    // Nothing new goes out once VT(S) reaches VT(MS)
+    if(((vts - vta) & 0x3FF) >= LIBLTE_RLC_AM_WINDOW_SIZE)
     {
         interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
                                   LTE_FDD_ENB_DEBUG_LEVEL_RLC,
                                   __FILE__,
                                   __LINE__,
-                                  "Sending AMD PDU for RNTI=%u, RB=%s, VT(A)=%u, SN=%u, VT(MS)=%u, RF=%s, P=%s, FI=%s",
+                                  "Can't send AMD PDU for RNTI=%u, RB=%s, outside of transmit window (%u <= %u < %u)",
                                   user->get_c_rnti(),
                                   LTE_fdd_enb_rb_text[rb->get_rb_id()],
                                   vta,
-                                  amd->hdr.sn,
-                                  vtms,
-                                  liblte_rlc_rf_field_text[amd->hdr.rf],
-                                  liblte_rlc_p_field_text[amd->hdr.p],
-                                  liblte_rlc_fi_field_text[amd->hdr.fi]);
-
-        // Send the PDU to MAC
-        send_mac_sdu_ready(user, rb, &pdu);
-        return;
+                                  vts,
+                                  rb->get_rlc_vtms());
+        return false;
     }
 
+    for(uint32 i=0; i<LIBLTE_RLC_AMD_MAX_N_PDU; i++)
+        data[i] = &amd.pdu[i].data;
+    amd.N_pdu = read_tx_sdus(rb,
+                             LTE_FDD_ENB_RLC_AMD_FIXED_HDR_BYTES,
+                             N_bytes,
+                             LIBLTE_RLC_AMD_MAX_N_PDU,
+                             data,
+                             &fi);
+    if(0 == amd.N_pdu)
+        return false;
+
+    // Pack the PDU, always polling
+    amd.pdu[0].hdr.dc = LIBLTE_RLC_DC_FIELD_DATA_PDU;
+    amd.pdu[0].hdr.rf = LIBLTE_RLC_RF_FIELD_AMD_PDU;
+    amd.pdu[0].hdr.p  = LIBLTE_RLC_P_FIELD_STATUS_REPORT_REQUESTED;
+    amd.pdu[0].hdr.fi = fi;
+    amd.pdu[0].hdr.sn = vts;
+    rb->set_rlc_vts((vts+1) % 1024);
+    liblte_rlc_pack_amd_pdu(&amd, pdu);
+
+    // Store
+    rb->rlc_add_to_transmission_buffer(vts, pdu);
+
+    // Start t-pollretransmit
+    rb->rlc_start_t_poll_retransmit();
+
     interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
                               LTE_FDD_ENB_DEBUG_LEVEL_RLC,
                               __FILE__,
                               __LINE__,
-                              &pdu,
-                              "Can't send AMD PDU for RNTI=%u, RB=%s, outside of transmit window (%u <= %u < %u)",
+                              pdu,
+                              "Sending AMD PDU for RNTI=%u, RB=%s, VT(A)=%u, SN=%u, VT(MS)=%u, FI=%s, N_data=%u, N_bytes=%u/%u",
                               user->get_c_rnti(),
                               LTE_fdd_enb_rb_text[rb->get_rb_id()],
                               vta,
-                              amd->hdr.sn,
-                              vtms);
+                              vts,
+                              rb->get_rlc_vtms(),
+                              liblte_rlc_fi_field_text[fi],
+                              amd.N_pdu,
+                              pdu->N_bytes,
+                              N_bytes);
+
+    return true;
+}
+uint32 LTE_fdd_enb_rlc::read_tx_sdus(LTE_fdd_enb_rb            *rb,
+                                     uint32                     N_fixed_hdr_bytes,
+                                     uint32                     N_bytes,
+                                     uint32                     N_max_data,
+                                     LIBLTE_BYTE_MSG_STRUCT   **data,
+                                     LIBLTE_RLC_FI_FIELD_ENUM  *fi)
+{
+    LIBLTE_BYTE_BUF_STRUCT *sdu;
+    uint32                  N_data       = 0;
+    uint32                  N_data_bytes = 0;
+    uint32                  sdu_idx      = 0;
+    uint32                  offset       = rb->rlc_get_tx_sdu_offset();
+    bool                    first_seg    = (0 != offset);
+    bool                    last_seg     = false;
+
+    // Concatenate SDUs until the grant is used up, segmenting the last one
+    while(N_data < N_max_data &&
+          LTE_FDD_ENB_ERROR_NONE == rb->rlc_peek_tx_sdu(sdu_idx, &sdu))
+    {
+        // Each extra data field costs a 12 bit length indicator, which
+        // cannot describe more than 2047 bytes
+        uint32 N_hdr_bytes = N_fixed_hdr_bytes + (3*N_data + 1)/2;
+        if(N_hdr_bytes + N_data_bytes >= N_bytes ||
+           (0 != N_data && data[N_data-1]->N_bytes > 2047))
+            break;
+
+        uint32 N_avail = N_bytes - N_hdr_bytes - N_data_bytes;
+        uint32 N_left  = sdu->N_bytes - offset;
+        uint32 N_copy  = (N_left < N_avail) ? N_left : N_avail;
+        memcpy(data[N_data]->msg, liblte_byte_buf_data(sdu) + offset, N_copy);
+        data[N_data]->N_bytes  = N_copy;
+        N_data_bytes          += N_copy;
+        N_data++;
+        if(N_copy < N_left)
+        {
+            last_seg = true;
+            break;
+        }
+        offset = 0;
+        sdu_idx++;
+    }
+    rb->rlc_consume_tx_sdu_bytes(N_data_bytes);
+
+    // 36.322 section 6.2.2.6
+    if(first_seg && last_seg)
+    {
+        *fi = LIBLTE_RLC_FI_FIELD_MIDDLE_SDU_SEGMENT;
+    }else if(first_seg){
+        *fi = LIBLTE_RLC_FI_FIELD_LAST_SDU_SEGMENT;
+    }else if(last_seg){
+        *fi = LIBLTE_RLC_FI_FIELD_FIRST_SDU_SEGMENT;
+    }else{
+        *fi = LIBLTE_RLC_FI_FIELD_FULL_SDU;
+    }
+
+    return N_data;
 }
@@ -79,6 +79,14 @@
 #define I_SR_MAX       34
 #define N_1_P_PUCCH_SR 1
 
+// SPS configuration
+#define N_1_P_PUCCH_SPS_AN_MIN 2
+#define N_1_P_PUCCH_SPS_AN_MAX 9
+
+// DRX configuration
+#define DRX_SHORT_CYCLE_TIMER 4  // Short cycles before the UE falls back to the long cycle
+#define DRX_RETX_TIMER        16 // Matches drx-RetransmissionTimer sent in DRX-Config
+
 /*******************************************************************************
                               TYPEDEFS
 *******************************************************************************/
@@ -96,9 +104,9 @@
 /********************************/
 /*    Constructor/Destructor    */
 /********************************/
-LTE_fdd_enb_rrc::LTE_fdd_enb_rrc(LTE_fdd_enb_interface *iface, LTE_fdd_enb_user_mgr *um,
-                                 LTE_fdd_enb_mac *_mac) :
-    interface{iface}, started{false}, user_mgr{um}, mac{_mac}
+LTE_fdd_enb_rrc::LTE_fdd_enb_rrc(LTE_fdd_enb_interface *iface, uint8 _cell,
+                                 LTE_fdd_enb_user_mgr *um, LTE_fdd_enb_mac *_mac) :
+    interface{iface}, started{false}, cell{_cell}, user_mgr{um}, mac{_mac}
 {
 }
 LTE_fdd_enb_rrc::~LTE_fdd_enb_rrc()
@@ -123,6 +131,7 @@ void LTE_fdd_enb_rrc::start(LTE_fdd_enb_msgq *from_pdcp,
 
     started        = true;
     i_sr           = I_SR_MIN;
+    n_1_p_pucch_an = N_1_P_PUCCH_SPS_AN_MIN;
     msgq_from_pdcp = from_pdcp;
     msgq_from_mme  = from_mme;
     msgq_to_pdcp   = to_pdcp;
@@ -236,7 +245,7 @@ void LTE_fdd_enb_rrc::send_mme_nas_msg_ready(LTE_fdd_enb_user           *user,
 void LTE_fdd_enb_rrc::update_sys_info()
 {
     std::lock_guard<std::mutex>  lock(sys_info_mutex);
-    interface->get_sys_info(sys_info);
+    interface->get_sys_info(cell, sys_info);
 }
 
 /*******************************/
@@ -685,6 +694,7 @@ void LTE_fdd_enb_rrc::parse_ul_dcch_message(std::vector<uint8_t> &msg,
     {
     case UL_DCCH_MessageType::k_c1_rrcConnectionReestablishmentComplete:
         rb->set_rrc_state(LTE_FDD_ENB_RRC_STATE_RRC_CONNECTED);
+        user->start_drx();
         break;
     case UL_DCCH_MessageType::k_c1_rrcConnectionSetupComplete:
         if(ul_dcch.message_Get().c1_rrcConnectionSetupComplete_Get().criticalExtensions_Choice() != RRCConnectionSetupComplete::k_criticalExtensions_c1 ||
@@ -698,6 +708,7 @@ void LTE_fdd_enb_rrc::parse_ul_dcch_message(std::vector<uint8_t> &msg,
                                              user->get_c_rnti(),
                                              LTE_fdd_enb_rb_text[rb->get_rb_id()]);
         rb->set_rrc_state(LTE_FDD_ENB_RRC_STATE_RRC_CONNECTED);
+        user->start_drx();
 
         // Send the NAS message to MME
         send_mme_nas_msg_ready(user, rb, ul_dcch.message_Get().c1_rrcConnectionSetupComplete_Get().criticalExtensions_c1_rrcConnectionSetupComplete_r8_Get().dedicatedInfoNAS_Get().Value());
@@ -875,7 +886,37 @@ void LTE_fdd_enb_rrc::send_rrc_con_reconfig(LTE_fdd_enb_user       *user,
     }
     dl_dcch.message_Set()->c1_rrcConnectionReconfiguration_Set()->criticalExtensions_c1_rrcConnectionReconfiguration_r8_Set()->radioResourceConfigDedicated_Set()->drb_ToReleaseList_Clear();
     dl_dcch.message_Set()->c1_rrcConnectionReconfiguration_Set()->criticalExtensions_c1_rrcConnectionReconfiguration_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_Clear();
-    dl_dcch.message_Set()->c1_rrcConnectionReconfiguration_Set()->criticalExtensions_c1_rrcConnectionReconfiguration_r8_Set()->radioResourceConfigDedicated_Set()->sps_Config_Clear();
+    uint32 sps_interval = interface->get_sps_interval();
+    uint16 sps_c_rnti   = 0;
+    if(0                      != sps_interval &&
+       NULL                   != drb1         &&
+       LTE_FDD_ENB_ERROR_NONE == user_mgr->assign_sps_c_rnti(user, &sps_c_rnti))
+    {
+        // SPS intervals map onto the RRC enumerations in table order
+        uint32 interval_idx = 0;
+        for(uint32 i=1; i<LTE_FDD_ENB_N_SPS_INTERVALS; i++)
+            if(LTE_fdd_enb_sps_interval[i] == sps_interval)
+                interval_idx = i - 1;
+        SPS_Config *sps = dl_dcch.message_Set()->c1_rrcConnectionReconfiguration_Set()->criticalExtensions_c1_rrcConnectionReconfiguration_r8_Set()->radioResourceConfigDedicated_Set()->sps_Config_Set();
+        sps->semiPersistSchedC_RNTI_Set()->SetValue(sps_c_rnti);
+        sps->sps_ConfigDL_Set()->SetChoice(SPS_ConfigDL::k_setup);
+        sps->sps_ConfigDL_Set()->setup_value.semiPersistSchedIntervalDL_SetValue((SPS_ConfigDL::setup::semiPersistSchedIntervalDL_Enum)interval_idx);
+        sps->sps_ConfigDL_Set()->setup_value.numberOfConfSPS_Processes_SetValue(1);
+        std::vector<N1_PUCCH_AN_PersistentList::N1_PUCCH_AN_PersistentList_items> n1_list(1);
+        n1_list[0].N1_PUCCH_AN_PersistentList_itemsSetValue(n_1_p_pucch_an);
+        sps->sps_ConfigDL_Set()->setup_value.n1_PUCCH_AN_PersistentList_Set()->SetValue(n1_list);
+        sps->sps_ConfigDL_Set()->setup_value.twoAntennaPortActivated_r10_Clear();
+        sps->sps_ConfigDL_Set()->setup_value.n1_PUCCH_AN_PersistentListP1_r10_Clear();
+        sps->sps_ConfigUL_Set()->SetChoice(SPS_ConfigUL::k_setup);
+        sps->sps_ConfigUL_Set()->setup_value.semiPersistSchedIntervalUL_SetValue((SPS_ConfigUL::setup::semiPersistSchedIntervalUL_Enum)interval_idx);
+        sps->sps_ConfigUL_Set()->setup_value.implicitReleaseAfter_SetValue(SPS_ConfigUL::setup::k_implicitReleaseAfter_e2);
+        sps->sps_ConfigUL_Set()->setup_value.p0_Persistent_value.SetPresence(false);
+        sps->sps_ConfigUL_Set()->setup_value.twoIntervalsConfig_Clear();
+        mac->add_sps(user->get_c_rnti(), sps_c_rnti, drb1->get_rb_id(), sps_interval, n_1_p_pucch_an);
+        increment_n_1_p_pucch_an();
+    }else{
+        dl_dcch.message_Set()->c1_rrcConnectionReconfiguration_Set()->criticalExtensions_c1_rrcConnectionReconfiguration_r8_Set()->radioResourceConfigDedicated_Set()->sps_Config_Clear();
+    }
     interface->get_rrc_phy_cnfg_ded(dl_dcch.message_Set()->c1_rrcConnectionReconfiguration_Set()->criticalExtensions_c1_rrcConnectionReconfiguration_r8_Set()->radioResourceConfigDedicated_Set()->physicalConfigDedicated_Set(),
                                     0, 0, i_sr, N_1_P_PUCCH_SR);
     mac->add_periodic_sr_pucch(user->get_c_rnti(), i_sr, N_1_P_PUCCH_SR);
@@ -916,11 +957,11 @@ void LTE_fdd_enb_rrc::send_rrc_con_reest(LTE_fdd_enb_user *user,
     rrc_con_reest.radioResourceConfigDedicated_Set()->drb_ToReleaseList_Clear();
     rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_SetChoice(RadioResourceConfigDedicated::k_mac_MainConfig_explicitValue);
     rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->ul_SCH_Config_value.SetPresence(true);
-    rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->ul_SCH_Config_value.maxHARQ_Tx_SetValue(MAC_MainConfig::ul_SCH_Config::k_maxHARQ_Tx_n1);
+    rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->ul_SCH_Config_value.maxHARQ_Tx_SetValue(MAC_MainConfig::ul_SCH_Config::k_maxHARQ_Tx_n4);
     rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->ul_SCH_Config_value.periodicBSR_Timer_Clear();
     rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->ul_SCH_Config_value.retxBSR_Timer_SetValue(MAC_MainConfig::ul_SCH_Config::k_retxBSR_Timer_sf1280);
     rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->ul_SCH_Config_value.ttiBundling_SetValue(false);
-    rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->drx_Config_Clear();
+    fill_drx_config(user, rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set());
     rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->timeAlignmentTimerDedicated_Set()->SetValue(TimeAlignmentTimer::k_sf10240);
     rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->phr_Config_Clear();
     rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->sr_ProhibitTimer_r9_Clear();
@@ -928,6 +969,7 @@ void LTE_fdd_enb_rrc::send_rrc_con_reest(LTE_fdd_enb_user *user,
     rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->extendedBSR_Sizes_r10_Clear();
     rrc_con_reest.radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->extendedPHR_r10_Clear();
     rrc_con_reest.radioResourceConfigDedicated_Set()->sps_Config_Clear();
+    mac->remove_sps(user->get_c_rnti());
     interface->get_rrc_phy_cnfg_ded(rrc_con_reest.radioResourceConfigDedicated_Set()->physicalConfigDedicated_Set(), 0, 0, i_sr, N_1_P_PUCCH_SR);
     rrc_con_reest.radioResourceConfigDedicated_Set()->rlf_TimersAndConstants_r9_Clear();
     rrc_con_reest.nextHopChainingCount_Set()->SetValue(0);
@@ -993,6 +1035,8 @@ void LTE_fdd_enb_rrc::send_rrc_con_release(LTE_fdd_enb_user *user,
                               LTE_fdd_enb_rb_text[rb->get_rb_id()]);
 
     mac->remove_periodic_sr_pucch(user->get_c_rnti());
+    mac->remove_sps(user->get_c_rnti());
+    user_mgr->release_sps_c_rnti(user);
 
     // Send the PDU to PDCP
     send_pdcp_sdu_ready(user, rb, fsm.rrc);
@@ -1015,11 +1059,11 @@ void LTE_fdd_enb_rrc::send_rrc_con_setup(LTE_fdd_enb_user *user,
     dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->drb_ToReleaseList_Clear();
     dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_SetChoice(RadioResourceConfigDedicated::k_mac_MainConfig_explicitValue);
     dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->ul_SCH_Config_value.SetPresence(true);
-    dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->ul_SCH_Config_value.maxHARQ_Tx_SetValue(MAC_MainConfig::ul_SCH_Config::k_maxHARQ_Tx_n1);
+    dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->ul_SCH_Config_value.maxHARQ_Tx_SetValue(MAC_MainConfig::ul_SCH_Config::k_maxHARQ_Tx_n4);
     dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->ul_SCH_Config_value.periodicBSR_Timer_Clear();
     dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->ul_SCH_Config_value.retxBSR_Timer_SetValue(MAC_MainConfig::ul_SCH_Config::k_retxBSR_Timer_sf1280);
     dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->ul_SCH_Config_value.ttiBundling_SetValue(false);
-    dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->drx_Config_Clear();
+    fill_drx_config(user, dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set());
     dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->timeAlignmentTimerDedicated_Set()->SetValue(TimeAlignmentTimer::k_sf10240);
     dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->phr_Config_Clear();
     dl_ccch.message_Set()->c1_rrcConnectionSetup_Set()->criticalExtensions_c1_rrcConnectionSetup_r8_Set()->radioResourceConfigDedicated_Set()->mac_MainConfig_explicitValue_Set()->sr_ProhibitTimer_r9_Clear();
@@ -1114,3 +1158,122 @@ void LTE_fdd_enb_rrc::increment_i_sr()
     if(i_sr > I_SR_MAX)
         i_sr = I_SR_MIN;
 }
+void LTE_fdd_enb_rrc::increment_n_1_p_pucch_an()
+{
+    n_1_p_pucch_an++;
+    if(n_1_p_pucch_an > N_1_P_PUCCH_SPS_AN_MAX)
+        n_1_p_pucch_an = N_1_P_PUCCH_SPS_AN_MIN;
+}
+void LTE_fdd_enb_rrc::fill_drx_config(LTE_fdd_enb_user *user,
+                                      MAC_MainConfig   *mac_cnfg)
+{
+    LTE_FDD_ENB_DRX_CNFG_STRUCT cnfg;
+    cnfg.long_cycle        = interface->get_drx_long_cycle();
+    cnfg.short_cycle       = interface->get_drx_short_cycle();
+    cnfg.short_cycle_timer = DRX_SHORT_CYCLE_TIMER;
+    cnfg.on_duration       = interface->get_drx_on_duration();
+    cnfg.inactivity_timer  = interface->get_drx_inactivity_timer();
+    cnfg.retx_timer        = DRX_RETX_TIMER;
+
+    if(0 == cnfg.long_cycle || cnfg.on_duration >= cnfg.long_cycle)
+    {
+        mac_cnfg->drx_Config_Clear();
+        user->clear_drx_cnfg();
+        return;
+    }
+
+    // The long cycle has to be a multiple of the short cycle, 36.331 section 6.3.2
+    if(0 != cnfg.short_cycle &&
+       (cnfg.long_cycle  <= cnfg.short_cycle ||
+        cnfg.on_duration >= cnfg.short_cycle ||
+        0                != (cnfg.long_cycle % cnfg.short_cycle)))
+        cnfg.short_cycle = 0;
+
+    // Spread the on durations of different UEs over the cycle
+    cnfg.start_offset = user->get_c_rnti() % cnfg.long_cycle;
+
+    // Cycles and timers map onto the RRC enumerations in table order
+    uint32 long_idx        = 0;
+    uint32 short_idx       = 0;
+    uint32 on_duration_idx = 0;
+    uint32 inactivity_idx  = 0;
+    for(uint32 i=1; i<LTE_FDD_ENB_N_DRX_LONG_CYCLES; i++)
+        if(LTE_fdd_enb_drx_long_cycle[i] == cnfg.long_cycle)
+            long_idx = i - 1;
+    for(uint32 i=1; i<LTE_FDD_ENB_N_DRX_SHORT_CYCLES; i++)
+        if(LTE_fdd_enb_drx_short_cycle[i] == cnfg.short_cycle)
+            short_idx = i - 1;
+    for(uint32 i=0; i<LTE_FDD_ENB_N_DRX_ON_DURATIONS; i++)
+        if(LTE_fdd_enb_drx_on_duration[i] == cnfg.on_duration)
+            on_duration_idx = i;
+    for(uint32 i=0; i<LTE_FDD_ENB_N_DRX_INACTIVITY_TIMERS; i++)
+        if(LTE_fdd_enb_drx_inactivity_timer[i] == cnfg.inactivity_timer)
+            inactivity_idx = i;
+
+    DRX_Config *drx = mac_cnfg->drx_Config_Set();
+    drx->SetChoice(DRX_Config::k_setup);
+    drx->setup_value.onDurationTimer_SetValue((DRX_Config::setup::onDurationTimer_Enum)on_duration_idx);
+    drx->setup_value.drx_InactivityTimer_SetValue((DRX_Config::setup::drx_InactivityTimer_Enum)inactivity_idx);
+    drx->setup_value.drx_RetransmissionTimer_SetValue(DRX_Config::setup::k_drx_RetransmissionTimer_psf16);
+    drx->setup_value.longDRX_CycleStartOffset_SetChoice((DRX_Config::setup::longDRX_CycleStartOffset_Enum)long_idx);
+    switch(drx->setup_value.longDRX_CycleStartOffset_Choice())
+    {
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf10:
+        drx->setup_value.longDRX_CycleStartOffset_sf10_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf20:
+        drx->setup_value.longDRX_CycleStartOffset_sf20_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf32:
+        drx->setup_value.longDRX_CycleStartOffset_sf32_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf40:
+        drx->setup_value.longDRX_CycleStartOffset_sf40_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf64:
+        drx->setup_value.longDRX_CycleStartOffset_sf64_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf80:
+        drx->setup_value.longDRX_CycleStartOffset_sf80_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf128:
+        drx->setup_value.longDRX_CycleStartOffset_sf128_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf160:
+        drx->setup_value.longDRX_CycleStartOffset_sf160_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf256:
+        drx->setup_value.longDRX_CycleStartOffset_sf256_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf320:
+        drx->setup_value.longDRX_CycleStartOffset_sf320_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf512:
+        drx->setup_value.longDRX_CycleStartOffset_sf512_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf640:
+        drx->setup_value.longDRX_CycleStartOffset_sf640_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf1024:
+        drx->setup_value.longDRX_CycleStartOffset_sf1024_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf1280:
+        drx->setup_value.longDRX_CycleStartOffset_sf1280_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf2048:
+        drx->setup_value.longDRX_CycleStartOffset_sf2048_SetValue(cnfg.start_offset);
+        break;
+    case DRX_Config::setup::k_longDRX_CycleStartOffset_sf2560:
+        drx->setup_value.longDRX_CycleStartOffset_sf2560_SetValue(cnfg.start_offset);
+        break;
+    }
+    if(0 != cnfg.short_cycle)
+    {
+        drx->setup_value.shortDRX_value.SetPresence(true);
+        drx->setup_value.shortDRX_value.shortDRX_Cycle_SetValue((DRX_Config::setup::shortDRX::shortDRX_Cycle_Enum)short_idx);
+        drx->setup_value.shortDRX_value.drxShortCycleTimer_SetValue(cnfg.short_cycle_timer);
+    }else{
+        drx->setup_value.shortDRX_value.SetPresence(false);
+    }
+    user->set_drx_cnfg(&cnfg);
+}
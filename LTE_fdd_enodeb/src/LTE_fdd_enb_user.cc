@@ -65,6 +65,7 @@
 #include "LTE_fdd_enb_rrc.h"
 #include "liblte_mme.h"
 #include "libtools_helpers.h"
+#include <math.h>
 
 /*******************************************************************************
                               DEFINES
@@ -89,14 +90,19 @@
 /*    Constructor/Destructor    */
 /********************************/
 LTE_fdd_enb_user::LTE_fdd_enb_user(LTE_fdd_enb_interface *iface,
-                                   LTE_fdd_enb_timer_mgr *tm, LTE_fdd_enb_rrc *_rrc,
-                                   LTE_fdd_enb_rlc *_rlc) :
-    temp_id{0}, id_set{false}, guti_set{false}, c_rnti_set{false}, ip_addr_set{false},
+                                   LTE_fdd_enb_timer_mgr *tm, uint8 _cell,
+                                   LTE_fdd_enb_rrc *_rrc, LTE_fdd_enb_rlc *_rlc) :
+    temp_id{0}, sps_c_rnti{0}, id_set{false}, guti_set{false}, c_rnti_set{false},
+    sps_c_rnti_set{false}, ip_addr_set{false},
     auth_vec_set{false}, uea_set{false}, uia_set{false}, gea_set{false}, srb1{NULL},
     srb2{NULL}, emm_cause{LIBLTE_MME_EMM_CAUSE_ROAMING_NOT_ALLOWED_IN_THIS_TRACKING_AREA},
     attach_type{0}, pdn_type{0}, eps_bearer_id{0}, proc_transaction_id{0}, eit_flag{false},
-    ul_buffer_size{0}, harq_process{0}, mcs{0}, interface{iface}, timer_mgr{tm}, rrc{_rrc},
-    rlc{_rlc}, N_del_ticks{0}, inactivity_timer_id{LTE_FDD_ENB_INVALID_TIMER_ID}
+    ul_buffer_size{}, ta_offset{0}, ta_holdoff_tti{0}, dl_avg_thru{0}, dl_thru_tti{0},
+    ul_avg_thru{0}, ul_thru_tti{0}, N_dl_bytes{0}, N_ul_bytes{0}, harq_process{0}, mcs{0},
+    dl_cqi{0}, ta_holdoff{false}, dl_cqi_set{false}, dl_served{false}, ul_served{false}, ul_sr_pending{false}, ul_ndi{},
+    drx_cnfg{}, drx_inactivity_tti{0}, drx_retx_tti{0}, drx_cnfg_set{false}, drx_on{false},
+    drx_inactivity_running{false}, drx_retx_running{false},
+    interface{iface}, timer_mgr{tm}, rrc{_rrc}, rlc{_rlc}, cell{_cell}, N_del_ticks{0}, inactivity_timer_id{LTE_FDD_ENB_INVALID_TIMER_ID}
 {
     uint32 i;
 
@@ -180,10 +186,26 @@ void LTE_fdd_enb_user::init()
     // MAC
     harq_process = 0;
     mcs          = 0;
+    ta_offset    = 0;
+    ta_holdoff   = false;
+    dl_avg_thru  = 0;
+    dl_cqi_set   = false;
+    dl_served    = false;
+    for(i=0; i<LTE_FDD_ENB_USER_N_LCG; i++)
+        ul_buffer_size[i] = 0;
+    for(i=0; i<LTE_FDD_ENB_USER_N_UL_HARQ_PROC; i++)
+        ul_ndi[i] = 0;
+    ul_avg_thru   = 0;
+    ul_served     = false;
+    N_dl_bytes.store(0);
+    N_ul_bytes.store(0);
+    ul_sr_pending = false;
+    clear_drx_cnfg();
 
     // Identity
-    c_rnti     = 0xFFFF;
-    c_rnti_set = false;
+    c_rnti         = 0xFFFF;
+    c_rnti_set     = false;
+    sps_c_rnti_set = false;
 }
 
 /******************/
@@ -252,6 +274,40 @@ bool LTE_fdd_enb_user::is_c_rnti_set()
 {
     return c_rnti_set;
 }
+void LTE_fdd_enb_user::set_sps_c_rnti(uint16 _sps_c_rnti)
+{
+    sps_c_rnti     = _sps_c_rnti;
+    sps_c_rnti_set = true;
+
+    // HARQ process 0 belongs to the configured assignment
+    if(0 == harq_process)
+        harq_process = 1;
+}
+uint16 LTE_fdd_enb_user::get_sps_c_rnti()
+{
+    return sps_c_rnti;
+}
+bool LTE_fdd_enb_user::is_sps_c_rnti_set()
+{
+    return sps_c_rnti_set;
+}
+void LTE_fdd_enb_user::clear_sps_c_rnti()
+{
+    sps_c_rnti_set = false;
+}
+void LTE_fdd_enb_user::set_cell(uint8 _cell, LTE_fdd_enb_rrc *_rrc)
+{
+    cell = _cell;
+    rrc  = _rrc;
+}
+uint8 LTE_fdd_enb_user::get_cell()
+{
+    return cell;
+}
+LTE_fdd_enb_rrc* LTE_fdd_enb_user::get_rrc()
+{
+    return rrc;
+}
 void LTE_fdd_enb_user::set_ip_addr(uint32 addr)
 {
     ip_addr     = addr;
@@ -587,6 +643,8 @@ uint8 LTE_fdd_enb_user::get_harq_process()
 void LTE_fdd_enb_user::increment_harq_process()
 {
     harq_process = (harq_process + 1) % 8;
+    if(sps_c_rnti_set && 0 == harq_process)
+        harq_process = 1;
 }
 void LTE_fdd_enb_user::store_harq_info(uint32                        pucch_tti,
                                        LIBLTE_MAC_PDU_STRUCT        *mac_pdu,
@@ -632,27 +690,217 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_user::get_harq_info(uint32
     harq_buffer.erase(harq_it);
     return LTE_FDD_ENB_ERROR_NONE;
 }
-void LTE_fdd_enb_user::set_ul_buffer_size(uint32 N_bytes_in_buffer)
+void LTE_fdd_enb_user::set_ul_buffer_size(uint8  lcg,
+                                          uint32 N_bytes_in_buffer)
 {
-    ul_buffer_size = N_bytes_in_buffer;
+    if(lcg < LTE_FDD_ENB_USER_N_LCG)
+        ul_buffer_size[lcg] = N_bytes_in_buffer;
 }
-void LTE_fdd_enb_user::update_ul_buffer_size(uint32 N_bytes_received)
+void LTE_fdd_enb_user::update_ul_buffer_size(uint8  lcg,
+                                             uint32 N_bytes_received)
 {
-    if(N_bytes_received > ul_buffer_size)
+    if(lcg >= LTE_FDD_ENB_USER_N_LCG)
+        return;
+
+    if(N_bytes_received > ul_buffer_size[lcg])
     {
-        ul_buffer_size = 0;
+        ul_buffer_size[lcg] = 0;
     }else{
-        ul_buffer_size -= N_bytes_received;
+        ul_buffer_size[lcg] -= N_bytes_received;
     }
 }
 uint32 LTE_fdd_enb_user::get_ul_buffer_size()
 {
-    return ul_buffer_size;
+    uint32 N_bytes = 0;
+    for(uint32 i=0; i<LTE_FDD_ENB_USER_N_LCG; i++)
+        N_bytes += ul_buffer_size[i];
+    return N_bytes;
+}
+void LTE_fdd_enb_user::set_ul_sr_pending(bool pending)
+{
+    ul_sr_pending = pending;
+}
+bool LTE_fdd_enb_user::get_ul_sr_pending()
+{
+    return ul_sr_pending;
+}
+uint8 LTE_fdd_enb_user::toggle_ul_ndi(uint32 current_tti)
+{
+    // UL HARQ is synchronous, the process follows from the PUSCH TTI
+    uint32 proc = current_tti % LTE_FDD_ENB_USER_N_UL_HARQ_PROC;
+    ul_ndi[proc] ^= 1;
+    return ul_ndi[proc];
 }
 uint8 LTE_fdd_enb_user::get_mcs()
 {
     return mcs;
 }
+void LTE_fdd_enb_user::update_timing_offset(float  offset_ts,
+                                            uint32 current_tti)
+{
+    // Measurements taken before the last TA command was applied are stale
+    if(ta_holdoff)
+    {
+        if(liblte_phy_is_tti_in_past(current_tti, ta_holdoff_tti))
+            return;
+        ta_holdoff = false;
+    }
+
+    ta_offset += LTE_FDD_ENB_USER_TA_FILTER_COEFF * (offset_ts - ta_offset);
+}
+float LTE_fdd_enb_user::get_timing_offset()
+{
+    return ta_offset;
+}
+void LTE_fdd_enb_user::reset_timing_offset(uint32 holdoff_tti)
+{
+    ta_offset      = 0;
+    ta_holdoff_tti = holdoff_tti;
+    ta_holdoff     = true;
+}
+void LTE_fdd_enb_user::set_dl_cqi(uint8 cqi)
+{
+    dl_cqi     = cqi;
+    dl_cqi_set = true;
+}
+uint8 LTE_fdd_enb_user::get_dl_cqi()
+{
+    return dl_cqi;
+}
+bool LTE_fdd_enb_user::is_dl_cqi_set()
+{
+    return dl_cqi_set;
+}
+void LTE_fdd_enb_user::update_dl_thru(uint32 current_tti,
+                                      uint32 N_bits)
+{
+    dl_avg_thru = get_dl_avg_thru(current_tti) + (float)N_bits/LTE_FDD_ENB_USER_DL_THRU_WINDOW_N_TTIS;
+    dl_thru_tti = current_tti;
+    dl_served   = true;
+}
+float LTE_fdd_enb_user::get_dl_avg_thru(uint32 current_tti)
+{
+    // Exponential average over the window, decayed for every TTI without an allocation
+    if(!dl_served)
+        return 0;
+    uint32 N_ttis = liblte_phy_sub_from_tti(current_tti, dl_thru_tti);
+    return dl_avg_thru*powf(1 - 1.0/LTE_FDD_ENB_USER_DL_THRU_WINDOW_N_TTIS, N_ttis);
+}
+uint32 LTE_fdd_enb_user::get_dl_n_ttis_waiting(uint32 current_tti)
+{
+    if(!dl_served)
+        return LIBLTE_PHY_TTI_MAX;
+    return liblte_phy_sub_from_tti(current_tti, dl_thru_tti);
+}
+void LTE_fdd_enb_user::update_ul_thru(uint32 current_tti,
+                                      uint32 N_bits)
+{
+    ul_avg_thru = get_ul_avg_thru(current_tti) + (float)N_bits/LTE_FDD_ENB_USER_UL_THRU_WINDOW_N_TTIS;
+    ul_thru_tti = current_tti;
+    ul_served   = true;
+}
+float LTE_fdd_enb_user::get_ul_avg_thru(uint32 current_tti)
+{
+    if(!ul_served)
+        return 0;
+    uint32 N_ttis = liblte_phy_sub_from_tti(current_tti, ul_thru_tti);
+    return ul_avg_thru*powf(1 - 1.0/LTE_FDD_ENB_USER_UL_THRU_WINDOW_N_TTIS, N_ttis);
+}
+uint32 LTE_fdd_enb_user::get_ul_n_ttis_waiting(uint32 current_tti)
+{
+    if(!ul_served)
+        return LIBLTE_PHY_TTI_MAX;
+    return liblte_phy_sub_from_tti(current_tti, ul_thru_tti);
+}
+void LTE_fdd_enb_user::count_dl_bytes(uint32 N_bytes)
+{
+    N_dl_bytes.store(N_dl_bytes.load(std::memory_order_relaxed) + N_bytes, std::memory_order_relaxed);
+}
+void LTE_fdd_enb_user::count_ul_bytes(uint32 N_bytes)
+{
+    N_ul_bytes.store(N_ul_bytes.load(std::memory_order_relaxed) + N_bytes, std::memory_order_relaxed);
+}
+uint64 LTE_fdd_enb_user::get_dl_bytes()
+{
+    return N_dl_bytes.load(std::memory_order_relaxed);
+}
+uint64 LTE_fdd_enb_user::get_ul_bytes()
+{
+    return N_ul_bytes.load(std::memory_order_relaxed);
+}
+void LTE_fdd_enb_user::set_drx_cnfg(LTE_FDD_ENB_DRX_CNFG_STRUCT *cnfg)
+{
+    // Only applied by start_drx() once the UE has confirmed it
+    memcpy(&drx_cnfg, cnfg, sizeof(LTE_FDD_ENB_DRX_CNFG_STRUCT));
+    drx_cnfg_set = true;
+    stop_drx();
+}
+void LTE_fdd_enb_user::clear_drx_cnfg()
+{
+    drx_cnfg_set = false;
+    stop_drx();
+}
+void LTE_fdd_enb_user::start_drx()
+{
+    drx_on                 = drx_cnfg_set;
+    drx_inactivity_running = false;
+    drx_retx_running       = false;
+}
+void LTE_fdd_enb_user::stop_drx()
+{
+    drx_on                 = false;
+    drx_inactivity_running = false;
+    drx_retx_running       = false;
+}
+bool LTE_fdd_enb_user::is_drx_active(uint32 current_tti)
+{
+    // 36.321 section 5.7, a pending SR keeps the UE awake for the grant
+    if(!drx_on || ul_sr_pending)
+        return true;
+
+    // Timers are only ever started a few TTIs ahead, anything further
+    // away than half the TTI range has expired
+    uint32 N_ttis;
+    if(drx_retx_running)
+    {
+        N_ttis = liblte_phy_sub_from_tti(current_tti, drx_retx_tti);
+        if(N_ttis < drx_cnfg.retx_timer)
+            return true;
+        if(N_ttis < LIBLTE_PHY_TTI_MAX/2)
+            drx_retx_running = false;
+    }
+    uint32 cycle = drx_cnfg.long_cycle;
+    if(drx_inactivity_running)
+    {
+        N_ttis = liblte_phy_sub_from_tti(current_tti, drx_inactivity_tti);
+        if(N_ttis <= drx_cnfg.inactivity_timer)
+            return true;
+        if(N_ttis <= drx_cnfg.inactivity_timer + drx_cnfg.short_cycle*drx_cnfg.short_cycle_timer)
+            cycle = drx_cnfg.short_cycle;
+        else if(N_ttis < LIBLTE_PHY_TTI_MAX/2)
+            drx_inactivity_running = false;
+    }
+
+    // Every cycle divides the TTI range, so the on duration lines up
+    // across the wrap
+    return (liblte_phy_sub_from_tti(current_tti, drx_cnfg.start_offset % cycle) % cycle) < drx_cnfg.on_duration;
+}
+uint32 LTE_fdd_enb_user::get_drx_cycle()
+{
+    if(!drx_on)
+        return 0;
+    return drx_cnfg.long_cycle;
+}
+void LTE_fdd_enb_user::restart_drx_inactivity_timer(uint32 current_tti)
+{
+    drx_inactivity_tti     = current_tti;
+    drx_inactivity_running = drx_on;
+}
+void LTE_fdd_enb_user::start_drx_retx_timer(uint32 current_tti)
+{
+    drx_retx_tti     = current_tti;
+    drx_retx_running = drx_on;
+}
 
 /*****************/
 /*    Generic    */
@@ -680,16 +928,6 @@ void LTE_fdd_enb_user::handle_timer_expiry(uint32 timer_id)
         }
     }
 }
-uint32 LTE_fdd_enb_user::get_max_ul_bytes_per_subfn()
-{
-    // FIXME: Make this dynamic based on channel conditions
-    return 50;
-}
-uint32 LTE_fdd_enb_user::get_max_dl_bytes_per_subfn()
-{
-    // FIXME: Make this dynamic based on channel conditions
-    return 325;
-}
 void LTE_fdd_enb_user::start_inactivity_timer(uint32 m_seconds)
 {
     LTE_fdd_enb_timer_cb timer_expiry_cb(&LTE_fdd_enb_timer_cb_wrapper<LTE_fdd_enb_user, &LTE_fdd_enb_user::handle_timer_expiry>, this);
@@ -161,6 +161,7 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_user_mgr::release_c_rnti(uint16 c_rnti)
                                   c_rnti);
 
         // Initialize or delete the user
+        erase_sps_c_rnti((*c_rnti_it).second);
         if((*c_rnti_it).second->is_id_set())
         {
             (*c_rnti_it).second->init();
@@ -202,6 +203,7 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_user_mgr::transfer_c_rnti(LTE_fdd_enb_user *o
         c_rnti = old_user->get_c_rnti();
 
         // Cleanup the old user
+        erase_sps_c_rnti(old_user);
         if(old_user->is_id_set())
         {
             old_user->init();
@@ -218,6 +220,7 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_user_mgr::transfer_c_rnti(LTE_fdd_enb_user *o
             c_rnti_map.erase(c_rnti_it);
         }
         new_user->set_c_rnti(c_rnti);
+        new_user->set_cell(old_user->get_cell(), old_user->get_rrc());
 
         err = LTE_FDD_ENB_ERROR_NONE;
     }
@@ -235,11 +238,35 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_user_mgr::reset_c_rnti_timer(uint16 c_rnti)
     timer_mgr->reset_timer((*timer_it).second);
     return LTE_FDD_ENB_ERROR_NONE;
 }
+LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_user_mgr::assign_sps_c_rnti(LTE_fdd_enb_user *user,
+                                                               uint16           *sps_c_rnti)
+{
+    // A reconfiguration keeps the SPS C-RNTI the UE already has
+    if(user->is_sps_c_rnti_set())
+    {
+        *sps_c_rnti = user->get_sps_c_rnti();
+        return LTE_FDD_ENB_ERROR_NONE;
+    }
+
+    // Taken from the C-RNTI pool without a reservation timer, it lives
+    // as long as the UE's C-RNTI does
+    LTE_FDD_ENB_ERROR_ENUM err = assign_c_rnti(user, sps_c_rnti);
+    if(LTE_FDD_ENB_ERROR_NONE == err)
+        user->set_sps_c_rnti(*sps_c_rnti);
+
+    return err;
+}
+void LTE_fdd_enb_user_mgr::release_sps_c_rnti(LTE_fdd_enb_user *user)
+{
+    std::lock_guard<std::mutex> lock(c_rnti_mutex);
+    erase_sps_c_rnti(user);
+}
 uint32 LTE_fdd_enb_user_mgr::get_next_m_tmsi()
 {
     return next_m_tmsi++;
 }
 LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_user_mgr::add_user(LTE_fdd_enb_user **user,
+                                                      uint8              cell,
                                                       LTE_fdd_enb_rrc   *rrc,
                                                       LTE_fdd_enb_rlc   *rlc)
 {
@@ -249,7 +276,7 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_user_mgr::add_user(LTE_fdd_enb_user **user,
     uint32                  timer_id;
     uint16                  c_rnti;
 
-    new_user = new LTE_fdd_enb_user(interface, timer_mgr, rrc, rlc);
+    new_user = new LTE_fdd_enb_user(interface, timer_mgr, cell, rrc, rlc);
 
     if(NULL != new_user)
     {
@@ -314,8 +341,8 @@ LTE_FDD_ENB_ERROR_ENUM LTE_fdd_enb_user_mgr::find_user(uint16             c_rnti
 
     for(auto u : user_list)
     {
-        if(u->is_c_rnti_set() &&
-           u->get_c_rnti() == c_rnti)
+        if((u->is_c_rnti_set()     && u->get_c_rnti()     == c_rnti) ||
+           (u->is_sps_c_rnti_set() && u->get_sps_c_rnti() == c_rnti))
         {
             *user = u;
             return LTE_FDD_ENB_ERROR_NONE;
@@ -553,6 +580,21 @@ std::string LTE_fdd_enb_user_mgr::print_all_users()
 
     return output;
 }
+void LTE_fdd_enb_user_mgr::get_user_traffic(std::vector<LTE_FDD_ENB_USER_TRAFFIC_STRUCT> &traffic)
+{
+    std::lock_guard<std::mutex>     lock(user_mutex);
+    LTE_FDD_ENB_USER_TRAFFIC_STRUCT user_traffic;
+
+    traffic.clear();
+    for(auto user : user_list)
+    {
+        user_traffic.imsi       = user->is_id_set() ? user->get_imsi_str() : "";
+        user_traffic.N_dl_bytes = user->get_dl_bytes();
+        user_traffic.N_ul_bytes = user->get_ul_bytes();
+        user_traffic.c_rnti     = user->get_c_rnti();
+        traffic.push_back(user_traffic);
+    }
+}
 
 /**********************/
 /*    C-RNTI Timer    */
@@ -585,3 +627,25 @@ void LTE_fdd_enb_user_mgr::handle_c_rnti_timer_expiry(uint32 timer_id)
         timer_id_mutex.unlock();
     }
 }
+
+/********************/
+/*    SPS C-RNTI    */
+/********************/
+void LTE_fdd_enb_user_mgr::erase_sps_c_rnti(LTE_fdd_enb_user *user)
+{
+    if(!user->is_sps_c_rnti_set())
+        return;
+
+    auto sps_it = c_rnti_map.find(user->get_sps_c_rnti());
+    if(c_rnti_map.end() != sps_it && user == (*sps_it).second)
+    {
+        interface->send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_INFO,
+                                  LTE_FDD_ENB_DEBUG_LEVEL_USER,
+                                  __FILE__,
+                                  __LINE__,
+                                  "SPS C-RNTI=%u released",
+                                  user->get_sps_c_rnti());
+        c_rnti_map.erase(sps_it);
+    }
+    user->clear_sps_c_rnti();
+}
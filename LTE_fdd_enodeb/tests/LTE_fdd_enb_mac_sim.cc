@@ -0,0 +1,1104 @@
+#line 2 "LTE_fdd_enb_mac_sim.cc" // Make __FILE__ omit the path
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: LTE_fdd_enb_mac_sim.cc
+
+    Description: Offline MAC scheduler simulator.  Runs the real MAC, the
+                 scheduling policies and the user, radio bearer and timer
+                 management against a stubbed PHY, RLC and RRC.  Message
+                 queues deliver synchronously on the calling thread, so a
+                 given seed always produces the same schedule.  Synthetic UEs
+                 generate DL and UL traffic, report CQI from a trace or a
+                 random walk, ACK or NACK DL transport blocks and answer UL
+                 grants with BSRs and data.  Prints per-UE throughput,
+                 latency and PRB usage plus the scheduler CPU time per TTI as
+                 JSON.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "LTE_fdd_enb_interface.h"
+#include "LTE_fdd_enb_mac.h"
+#include "LTE_fdd_enb_phy.h"
+#include "LTE_fdd_enb_rlc.h"
+#include "LTE_fdd_enb_rrc.h"
+#include "LTE_fdd_enb_timer_mgr.h"
+#include "LTE_fdd_enb_user_mgr.h"
+#include "LTE_fdd_enb_msgq.h"
+#include "LTE_fdd_enb_msg_pool.h"
+#include "liblte_mac.h"
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <random>
+#include <vector>
+#include <math.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+#define DEFAULT_N_UES       4
+#define DEFAULT_N_TTIS      10000
+#define DEFAULT_SEED        1
+#define DEFAULT_DL_KBPS     100
+#define DEFAULT_UL_KBPS     50
+#define DEFAULT_PKT_BYTES   1000
+#define DEFAULT_BLER        0.1
+#define CQI_REPORT_PERIOD   5    // TTIs between CQI reports, one trace row each
+#define CQI_WALK_SPREAD     3    // Random walk stays this close to the UE's mean CQI
+#define DRB_LCID            3
+#define DRB_LCG             2
+#define UL_SDU_HDR_BYTES    3
+#define UL_BSR_BYTES        2
+#define C_RNTI_KEEPALIVE    1000 // TTIs between C-RNTI timer resets
+#define SIB1_N_BYTES        18
+#define SI_N_BYTES          32
+#define RETX_GRACE_N_TTIS   20   // NACKs this close to the end may still be retransmitted
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+typedef struct{
+    uint32 arrival_tti;
+    uint32 N_bytes;
+}SIM_SDU_STRUCT;
+
+typedef struct{
+    uint32 tbs;
+    uint32 mcs;
+    uint32 harq_retx_count;
+    uint8  harq_process;
+    bool   valid;
+}SIM_DL_TB_STRUCT;
+
+typedef struct{
+    LTE_fdd_enb_user           *user;
+    LTE_fdd_enb_rb             *drb;
+    std::deque<SIM_SDU_STRUCT>  dl_sdus; // Queued in the DRB, oldest first
+    std::deque<SIM_SDU_STRUCT>  ul_sdus; // Queued in the UE, oldest first
+    std::vector<double>         dl_latency_ms;
+    std::vector<double>         ul_latency_ms;
+    SIM_DL_TB_STRUCT            dl_tb[10]; // Indexed by the DL TTI modulo 10
+    std::map<uint32, uint32>    dl_retx_due; // HARQ process and retx count to NACK TTI
+    double                      next_dl_arrival;
+    double                      next_ul_arrival;
+    uint64                      dl_offered_bytes;
+    uint64                      dl_served_bytes;
+    uint64                      dl_acked_bits;
+    uint64                      ul_offered_bytes;
+    uint64                      ul_sent_bytes;
+    uint64                      ul_received_bytes;
+    uint64                      dl_prbs;
+    uint64                      ul_prbs;
+    uint32                      N_dl_tbs;
+    uint32                      N_dl_retx;
+    uint32                      N_dl_nacks;
+    uint32                      N_srs;
+    uint32                      ul_buffer_bytes;
+    uint16                      c_rnti;
+    uint8                       mean_cqi;
+    uint8                       cqi;
+    bool                        sr_pending;
+}SIM_UE_STRUCT;
+
+typedef struct{
+    std::vector<std::vector<uint32>> cqi_trace;
+    LTE_FDD_ENB_DL_SCHED_POLICY_ENUM dl_policy;
+    LTE_FDD_ENB_DL_SCHED_POLICY_ENUM ul_policy;
+    double                           bler;
+    uint32                           N_ues;
+    uint32                           N_ttis;
+    uint32                           seed;
+    uint32                           N_rb;
+    uint32                           dl_kbps;
+    uint32                           ul_kbps;
+    uint32                           pkt_bytes;
+    bool                             poisson;
+    bool                             check_retx;
+}SIM_CNFG_STRUCT;
+
+typedef struct{
+    std::vector<double> sched_us;  // READY_TO_SEND handling
+    std::vector<double> mac_us;    // Everything the MAC ran for the TTI
+    uint64              dl_prbs;
+    uint64              ul_prbs;
+    uint64              common_prbs;
+    uint64              bad_ul_grants; // PUSCH sizes the PHY can't decode
+    uint64              lost_dl_retx;  // NACKed DL TBs that were never retransmitted
+}SIM_CELL_STATS_STRUCT;
+
+/*******************************************************************************
+                              GLOBAL VARIABLES
+*******************************************************************************/
+
+static SIM_CNFG_STRUCT                     cnfg;
+static SIM_CELL_STATS_STRUCT               cell_stats;
+static std::vector<SIM_UE_STRUCT>          ues;
+static std::map<uint16, uint32>            rnti_to_ue;
+static std::map<LTE_fdd_enb_rb*, uint32>   rb_to_ue;
+static std::mt19937                        rng;
+static uint32                              sim_tti;
+static LTE_FDD_ENB_PHY_SCHEDULE_MSG_STRUCT phy_sched;
+static bool                                phy_sched_valid;
+static LTE_fdd_enb_msgq                   *msgq_phy_to_mac;
+static LTE_fdd_enb_msgq                   *msgq_rlc_to_mac;
+static LIBLTE_MAC_PDU_STRUCT               ul_mac_pdu;
+static LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT pusch_decode;
+static LTE_FDD_ENB_PUCCH_DECODE_MSG_STRUCT pucch_decode;
+
+/*******************************************************************************
+                              STUB IMPLEMENTATIONS
+*******************************************************************************/
+
+/**************************/
+/*    Message Queue       */
+/**************************/
+// Delivers on the sender's thread so a run is repeatable
+LTE_fdd_enb_msgq_cb::LTE_fdd_enb_msgq_cb()
+{
+}
+LTE_fdd_enb_msgq_cb::LTE_fdd_enb_msgq_cb(FuncType f, void* o)
+{
+    func = f;
+    obj  = o;
+}
+void LTE_fdd_enb_msgq_cb::operator()(LTE_FDD_ENB_MESSAGE_STRUCT &msg)
+{
+    return (*func)(obj, msg);
+}
+LTE_fdd_enb_msgq::LTE_fdd_enb_msgq(LTE_fdd_enb_interface *iface, std::string _msgq_name) :
+    interface{iface}, ring{NULL}, msgq_name{_msgq_name}, prio{0}, rx_setup{false}
+{
+}
+LTE_fdd_enb_msgq::~LTE_fdd_enb_msgq()
+{
+}
+void LTE_fdd_enb_msgq::attach_rx(LTE_fdd_enb_msgq_cb cb)
+{
+    callback = cb;
+    rx_setup = true;
+}
+void LTE_fdd_enb_msgq::attach_rx(LTE_fdd_enb_msgq_cb cb,
+                                 uint32              _prio)
+{
+    callback = cb;
+    prio     = _prio;
+    rx_setup = true;
+}
+void LTE_fdd_enb_msgq::send(LTE_FDD_ENB_MESSAGE_TYPE_ENUM  type,
+                            LTE_FDD_ENB_DEST_LAYER_ENUM    dest_layer,
+                            LTE_FDD_ENB_MESSAGE_UNION     *msg_content,
+                            uint32                         msg_content_size)
+{
+    static LTE_FDD_ENB_MESSAGE_STRUCT msg;
+
+    msg.type       = type;
+    msg.dest_layer = dest_layer;
+    if(msg_content != NULL)
+        memcpy(&msg.msg, msg_content, msg_content_size);
+    send(msg);
+}
+void LTE_fdd_enb_msgq::send(LTE_FDD_ENB_MESSAGE_TYPE_ENUM       type,
+                            LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_sched,
+                            LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_sched)
+{
+    static LTE_FDD_ENB_MESSAGE_STRUCT msg;
+
+    msg.type       = type;
+    msg.dest_layer = LTE_FDD_ENB_DEST_LAYER_PHY;
+    memcpy(&msg.msg.phy_schedule.dl_sched, dl_sched, sizeof(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT));
+    memcpy(&msg.msg.phy_schedule.ul_sched, ul_sched, sizeof(LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT));
+    send(msg);
+}
+void LTE_fdd_enb_msgq::send(LTE_FDD_ENB_MESSAGE_STRUCT &msg)
+{
+    if(rx_setup)
+        callback(msg);
+}
+
+/*******************/
+/*    Interface    */
+/*******************/
+LTE_fdd_enb_interface::LTE_fdd_enb_interface() :
+    N_sc_rb_dl{LIBLTE_PHY_N_SC_RB_DL_NORMAL_CP}, N_sc_rb_ul{LIBLTE_PHY_N_SC_RB_UL}
+{
+}
+LTE_fdd_enb_interface::~LTE_fdd_enb_interface()
+{
+}
+void LTE_fdd_enb_interface::send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM  type,
+                                           LTE_FDD_ENB_DEBUG_LEVEL_ENUM level,
+                                           const char                  *file_name,
+                                           int32                        line,
+                                           const char                  *msg,
+                                           ...)
+{
+}
+void LTE_fdd_enb_interface::send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM  type,
+                                           LTE_FDD_ENB_DEBUG_LEVEL_ENUM level,
+                                           const char                  *file_name,
+                                           int32                        line,
+                                           LIBLTE_BIT_MSG_STRUCT       *lte_msg,
+                                           const char                  *msg,
+                                           ...)
+{
+}
+void LTE_fdd_enb_interface::send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM  type,
+                                           LTE_FDD_ENB_DEBUG_LEVEL_ENUM level,
+                                           const char                  *file_name,
+                                           int32                        line,
+                                           std::vector<bool>           &lte_msg,
+                                           const char                  *msg,
+                                           ...)
+{
+}
+void LTE_fdd_enb_interface::send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM  type,
+                                           LTE_FDD_ENB_DEBUG_LEVEL_ENUM level,
+                                           const char                  *file_name,
+                                           int32                        line,
+                                           LIBLTE_BYTE_MSG_STRUCT      *lte_msg,
+                                           const char                  *msg,
+                                           ...)
+{
+}
+void LTE_fdd_enb_interface::send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM  type,
+                                           LTE_FDD_ENB_DEBUG_LEVEL_ENUM level,
+                                           const char                  *file_name,
+                                           int32                        line,
+                                           LIBLTE_BYTE_BUF_STRUCT      *lte_msg,
+                                           const char                  *msg,
+                                           ...)
+{
+}
+void LTE_fdd_enb_interface::send_debug_msg(LTE_FDD_ENB_DEBUG_TYPE_ENUM  type,
+                                           LTE_FDD_ENB_DEBUG_LEVEL_ENUM level,
+                                           const char                  *file_name,
+                                           int32                        line,
+                                           const std::vector<uint8_t>  &lte_msg,
+                                           const char                  *msg,
+                                           ...)
+{
+}
+void LTE_fdd_enb_interface::send_lte_pcap_msg(LTE_FDD_ENB_PCAP_DIRECTION_ENUM  dir,
+                                              uint32                           rnti,
+                                              uint32                           current_tti,
+                                              uint8                           *msg,
+                                              uint32                           N_bits)
+{
+}
+void LTE_fdd_enb_interface::count_metric(uint8                           cell,
+                                         LTE_FDD_ENB_METRIC_COUNTER_ENUM counter,
+                                         uint64                          N)
+{
+}
+void LTE_fdd_enb_interface::sample_metric(uint8                         cell,
+                                          LTE_FDD_ENB_METRIC_HIST_ENUM  hist,
+                                          struct timespec              *start)
+{
+}
+uint32 LTE_fdd_enb_interface::get_n_rb_dl()
+{
+    return cnfg.N_rb;
+}
+uint32 LTE_fdd_enb_interface::get_n_rb_ul()
+{
+    return cnfg.N_rb;
+}
+uint8 LTE_fdd_enb_interface::get_n_ant()
+{
+    return 1;
+}
+uint16 LTE_fdd_enb_interface::get_si_periodicity()
+{
+    return 8;
+}
+uint8 LTE_fdd_enb_interface::get_si_window_length()
+{
+    return 1;
+}
+uint8 LTE_fdd_enb_interface::get_ra_response_window_size()
+{
+    return 10;
+}
+LTE_FDD_ENB_DL_SCHED_POLICY_ENUM LTE_fdd_enb_interface::get_dl_sched_policy()
+{
+    return cnfg.dl_policy;
+}
+LTE_FDD_ENB_DL_SCHED_POLICY_ENUM LTE_fdd_enb_interface::get_ul_sched_policy()
+{
+    return cnfg.ul_policy;
+}
+void LTE_fdd_enb_interface::get_sys_info(LTE_FDD_ENB_SYS_INFO_STRUCT &_sys_info)
+{
+    get_sys_info(0, _sys_info);
+}
+void LTE_fdd_enb_interface::get_sys_info(uint8                        cell,
+                                         LTE_FDD_ENB_SYS_INFO_STRUCT &_sys_info)
+{
+    // Only the size of SIB1 and the SI message matter to the scheduler
+    uint32 N_bytes[2] = {SIB1_N_BYTES, SI_N_BYTES};
+
+    _sys_info.sib_alloc.clear();
+    for(uint32 i=0; i<2; i++)
+    {
+        LIBLTE_PHY_ALLOCATION_STRUCT alloc;
+        memset(&alloc, 0, sizeof(alloc));
+        alloc.msg[0].N_bits  = N_bytes[i]*8;
+        alloc.pre_coder_type = LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY;
+        alloc.mod_type       = LIBLTE_PHY_MODULATION_TYPE_QPSK;
+        alloc.rv_idx         = 0;
+        alloc.N_codewords    = 1;
+        alloc.rnti           = LIBLTE_MAC_SI_RNTI;
+        alloc.tx_mode        = 1;
+        _sys_info.sib_alloc.push_back(alloc);
+    }
+}
+
+/*************/
+/*    PHY    */
+/*************/
+LTE_fdd_enb_phy::LTE_fdd_enb_phy(LTE_fdd_enb_interface *iface, uint8 _cell, LTE_fdd_enb_mac *_mac)
+{
+}
+LTE_fdd_enb_phy::~LTE_fdd_enb_phy()
+{
+}
+uint32 LTE_fdd_enb_phy::get_n_cce()
+{
+    // Two control symbols and Ng=1/6: 5 REGs per PRB less PCFICH and PHICH
+    uint32 N_phich_groups = (cnfg.N_rb + 47) / 48;
+    return (5*cnfg.N_rb - 4 - 3*N_phich_groups) / 9;
+}
+
+/*************/
+/*    RLC    */
+/*************/
+LTE_fdd_enb_rlc::LTE_fdd_enb_rlc(LTE_fdd_enb_interface *iface)
+{
+}
+LTE_fdd_enb_rlc::~LTE_fdd_enb_rlc()
+{
+}
+void LTE_fdd_enb_rlc::handle_retransmit(LTE_fdd_enb_user *user,
+                                        LTE_fdd_enb_rb   *rb)
+{
+}
+static void consume_sdus(std::deque<SIM_SDU_STRUCT> *sdus,
+                         std::vector<double>        *latency_ms,
+                         uint32                      N_bytes)
+{
+    while(0 != N_bytes && 0 != sdus->size())
+    {
+        SIM_SDU_STRUCT &sdu = sdus->front();
+        if(N_bytes < sdu.N_bytes)
+        {
+            sdu.N_bytes -= N_bytes;
+            return;
+        }
+        N_bytes -= sdu.N_bytes;
+        latency_ms->push_back(sim_tti - sdu.arrival_tti);
+        sdus->pop_front();
+    }
+}
+// No RLC header, the payload is taken straight from the SDU queue
+bool LTE_fdd_enb_rlc::build_mac_sdu(LTE_fdd_enb_user       *user,
+                                    LTE_fdd_enb_rb         *rb,
+                                    uint32                  N_bytes,
+                                    LIBLTE_BYTE_MSG_STRUCT *sdu)
+{
+    auto ue_it = rb_to_ue.find(rb);
+    if(rb_to_ue.end() == ue_it)
+        return false;
+
+    SIM_UE_STRUCT *ue     = &ues[(*ue_it).second];
+    uint32         N_pull = std::min(std::min(N_bytes, rb->rlc_get_tx_sdu_queue_bytes()),
+                                     (uint32)LIBLTE_MAX_MSG_SIZE);
+    if(0 == N_pull)
+        return false;
+
+    memset(sdu->msg, 0, N_pull);
+    sdu->N_bytes = N_pull;
+    rb->rlc_consume_tx_sdu_bytes(N_pull);
+    consume_sdus(&ue->dl_sdus, &ue->dl_latency_ms, N_pull);
+    ue->dl_served_bytes += N_pull;
+    return true;
+}
+
+/*************/
+/*    RRC    */
+/*************/
+LTE_fdd_enb_rrc::LTE_fdd_enb_rrc(LTE_fdd_enb_interface *iface, uint8 _cell, LTE_fdd_enb_user_mgr *um, LTE_fdd_enb_mac *_mac)
+{
+}
+LTE_fdd_enb_rrc::~LTE_fdd_enb_rrc()
+{
+}
+void LTE_fdd_enb_rrc::handle_cmd(LTE_FDD_ENB_RRC_CMD_READY_MSG_STRUCT *cmd)
+{
+}
+
+/*******************************************************************************
+                              FUNCTIONS
+*******************************************************************************/
+
+static uint64 cpu_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static uint64 now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+// std:: distributions differ between standard libraries, the engine does not
+static double uniform(void)
+{
+    return (rng() + 0.5) / 4294967296.0;
+}
+
+static double next_interarrival_ms(uint32 kbps)
+{
+    double period_ms = cnfg.pkt_bytes*8.0 / kbps;
+    if(cnfg.poisson)
+        return -log(uniform()) * period_ms;
+    return period_ms;
+}
+
+static SIM_UE_STRUCT* find_ue(uint16 rnti)
+{
+    auto ue_it = rnti_to_ue.find(rnti);
+    if(rnti_to_ue.end() == ue_it)
+        return NULL;
+    return &ues[(*ue_it).second];
+}
+
+static double percentile(std::vector<double> &sorted, double pct)
+{
+    if(0 == sorted.size())
+        return 0;
+    uint32 idx = (uint32)ceil(pct/100.0*sorted.size());
+    if(idx > 0)
+        idx--;
+    return sorted[std::min(idx, (uint32)sorted.size()-1)];
+}
+
+static double mean(std::vector<double> &values)
+{
+    double sum = 0;
+    for(auto value : values)
+        sum += value;
+    return (0 == values.size()) ? 0 : sum / values.size();
+}
+
+static double to_mbps(uint64 N_bits)
+{
+    return (double)N_bits / cnfg.N_ttis / 1000.0;
+}
+
+// Transport blocks above what the reported CQI supports fail more often
+static bool draw_ack(uint8 cqi, uint32 mcs)
+{
+    if(0 == cqi)
+        return false;
+
+    uint32 min_cqi = 1 + (mcs * 14) / 28;
+    double bler    = cnfg.bler;
+    if(cqi < min_cqi)
+        bler += 0.3 * (min_cqi - cqi);
+    return uniform() >= bler;
+}
+
+/*************************/
+/*    Message Handlers   */
+/*************************/
+static void handle_phy_schedule(void *obj, LTE_FDD_ENB_MESSAGE_STRUCT &msg)
+{
+    if(LTE_FDD_ENB_MESSAGE_TYPE_PHY_SCHEDULE != msg.type)
+        return;
+
+    memcpy(&phy_sched, &msg.msg.phy_schedule, sizeof(LTE_FDD_ENB_PHY_SCHEDULE_MSG_STRUCT));
+    phy_sched_valid = true;
+}
+
+static void handle_rlc_pdu_ready(void *obj, LTE_FDD_ENB_MESSAGE_STRUCT &msg)
+{
+    if(LTE_FDD_ENB_MESSAGE_TYPE_RLC_PDU_READY != msg.type)
+        return;
+
+    LTE_fdd_enb_rb         *rb  = msg.msg.rlc_pdu_ready.rb;
+    LIBLTE_BYTE_MSG_STRUCT *pdu = NULL;
+    if(LTE_FDD_ENB_ERROR_NONE != rb->get_next_rlc_pdu(&pdu))
+        return;
+
+    auto ue_it = rb_to_ue.find(rb);
+    if(rb_to_ue.end() != ue_it)
+        ues[(*ue_it).second].ul_received_bytes += pdu->N_bytes;
+    rb->delete_next_rlc_pdu();
+}
+
+/*****************/
+/*    Traffic    */
+/*****************/
+static void generate_traffic(SIM_UE_STRUCT *ue)
+{
+    while(ue->next_dl_arrival <= sim_tti)
+    {
+        SIM_SDU_STRUCT sdu = {sim_tti, cnfg.pkt_bytes};
+        ue->dl_sdus.push_back(sdu);
+        ue->dl_offered_bytes += cnfg.pkt_bytes;
+        ue->next_dl_arrival  += next_interarrival_ms(cnfg.dl_kbps);
+
+        // Only the length matters, build_mac_sdu zeroes the payload
+        LIBLTE_BYTE_BUF_STRUCT *dl_sdu = LTE_fdd_enb_msg_pool::alloc_byte_buf(cnfg.pkt_bytes);
+        dl_sdu->N_bytes                = cnfg.pkt_bytes;
+        ue->drb->rlc_queue_tx_sdu(dl_sdu);
+        LTE_FDD_ENB_MAC_SDU_READY_MSG_STRUCT sdu_ready;
+        sdu_ready.user = ue->user;
+        sdu_ready.rb   = ue->drb;
+        msgq_rlc_to_mac->send(LTE_FDD_ENB_MESSAGE_TYPE_MAC_SDU_READY,
+                              LTE_FDD_ENB_DEST_LAYER_MAC,
+                              (LTE_FDD_ENB_MESSAGE_UNION *)&sdu_ready,
+                              sizeof(LTE_FDD_ENB_MAC_SDU_READY_MSG_STRUCT));
+    }
+
+    while(ue->next_ul_arrival <= sim_tti)
+    {
+        SIM_SDU_STRUCT sdu = {sim_tti, cnfg.pkt_bytes};
+        ue->ul_sdus.push_back(sdu);
+        ue->ul_offered_bytes += cnfg.pkt_bytes;
+        ue->next_ul_arrival  += next_interarrival_ms(cnfg.ul_kbps);
+
+        // New data in an empty buffer triggers a BSR, which needs an SR first
+        if(0 == ue->ul_buffer_bytes)
+            ue->sr_pending = true;
+        ue->ul_buffer_bytes += cnfg.pkt_bytes;
+    }
+}
+
+static void update_channel(SIM_UE_STRUCT *ue,
+                           uint32         ue_idx)
+{
+    if(0 != cnfg.cqi_trace.size())
+    {
+        std::vector<uint32> &row = cnfg.cqi_trace[(sim_tti / CQI_REPORT_PERIOD) % cnfg.cqi_trace.size()];
+        ue->cqi                  = std::min(row[ue_idx % row.size()], (uint32)15);
+    }else{
+        double draw = uniform();
+        if(draw < 1.0/3.0)
+            ue->cqi--;
+        else if(draw < 2.0/3.0)
+            ue->cqi++;
+        ue->cqi = std::max(ue->cqi, (uint8)std::max(1, ue->mean_cqi - CQI_WALK_SPREAD));
+        ue->cqi = std::min(ue->cqi, (uint8)std::min(15, ue->mean_cqi + CQI_WALK_SPREAD));
+    }
+    ue->user->set_dl_cqi(ue->cqi);
+}
+
+/*************/
+/*    PHY    */
+/*************/
+static void process_dl_schedule(LTE_FDD_ENB_DL_SCHEDULE_MSG_STRUCT *dl_sched)
+{
+    for(uint32 i=0; i<dl_sched->allocations.N_dl_alloc; i++)
+    {
+        LIBLTE_PHY_ALLOCATION_STRUCT *alloc = &dl_sched->allocations.dl_alloc[i];
+        SIM_UE_STRUCT                *ue    = find_ue(alloc->rnti);
+
+        cell_stats.dl_prbs += alloc->N_prb;
+        if(NULL == ue)
+        {
+            cell_stats.common_prbs += alloc->N_prb;
+            continue;
+        }
+        ue->dl_prbs += alloc->N_prb;
+        ue->N_dl_tbs++;
+        if(0 != alloc->harq_retx_count)
+        {
+            ue->N_dl_retx++;
+            ue->dl_retx_due.erase((alloc->harq_process << 8) | alloc->harq_retx_count);
+        }
+        SIM_DL_TB_STRUCT *tb = &ue->dl_tb[dl_sched->current_tti % 10];
+        tb->tbs              = alloc->tbs;
+        tb->mcs              = alloc->mcs;
+        tb->harq_retx_count  = alloc->harq_retx_count;
+        tb->harq_process     = alloc->harq_process;
+        tb->valid            = true;
+    }
+}
+
+static void send_pusch(SIM_UE_STRUCT                *ue,
+                       LIBLTE_PHY_ALLOCATION_STRUCT *alloc,
+                       uint32                        current_tti)
+{
+    uint32 N_avail = alloc->tbs / 8;
+    uint32 N_sdu   = 0;
+
+    if(N_avail > UL_BSR_BYTES + UL_SDU_HDR_BYTES)
+        N_sdu = std::min(std::min(ue->ul_buffer_bytes, N_avail - UL_BSR_BYTES - UL_SDU_HDR_BYTES),
+                         (uint32)LIBLTE_MAX_MSG_SIZE);
+
+    // The BSR reports what is left once this PDU is built, 36.321 section 5.4.5
+    ul_mac_pdu.chan_type    = LIBLTE_MAC_CHAN_TYPE_ULSCH;
+    ul_mac_pdu.N_subheaders = 0;
+    if(N_avail >= UL_BSR_BYTES)
+    {
+        LIBLTE_MAC_PDU_SUBHEADER_STRUCT *subhdr = &ul_mac_pdu.subheader[ul_mac_pdu.N_subheaders++];
+        subhdr->lcid                             = LIBLTE_MAC_ULSCH_SHORT_BSR_LCID;
+        subhdr->payload.short_bsr.lcg_id         = DRB_LCG;
+        subhdr->payload.short_bsr.min_buffer_size = ue->ul_buffer_bytes - N_sdu;
+        subhdr->payload.short_bsr.max_buffer_size = ue->ul_buffer_bytes - N_sdu;
+    }
+    if(0 != N_sdu)
+    {
+        LIBLTE_MAC_PDU_SUBHEADER_STRUCT *subhdr = &ul_mac_pdu.subheader[ul_mac_pdu.N_subheaders++];
+        subhdr->lcid                             = DRB_LCID;
+        subhdr->payload.sdu.N_bytes              = N_sdu;
+        memset(subhdr->payload.sdu.msg, 0, N_sdu);
+    }
+    ue->ul_buffer_bytes -= N_sdu;
+    ue->ul_sent_bytes   += N_sdu;
+    ue->sr_pending       = false;
+    consume_sdus(&ue->ul_sdus, &ue->ul_latency_ms, N_sdu);
+
+    liblte_mac_pack_mac_pdu(&ul_mac_pdu, &pusch_decode.msg);
+    pusch_decode.current_tti   = current_tti;
+    pusch_decode.timing_offset = 0;
+    pusch_decode.rnti          = alloc->rnti;
+    msgq_phy_to_mac->send(LTE_FDD_ENB_MESSAGE_TYPE_PUSCH_DECODE,
+                          LTE_FDD_ENB_DEST_LAYER_MAC,
+                          (LTE_FDD_ENB_MESSAGE_UNION *)&pusch_decode,
+                          sizeof(LTE_FDD_ENB_PUSCH_DECODE_MSG_STRUCT));
+}
+
+// UL transport blocks are always decoded, only the DL channel is modelled
+static void process_ul_schedule(LTE_FDD_ENB_UL_SCHEDULE_MSG_STRUCT *ul_sched)
+{
+    for(uint32 i=0; i<ul_sched->N_pucch; i++)
+    {
+        SIM_UE_STRUCT *ue = find_ue(ul_sched->pucch[i].rnti);
+        if(NULL == ue)
+            continue;
+
+        pucch_decode.type          = ul_sched->pucch[i].type;
+        pucch_decode.current_tti   = ul_sched->current_tti;
+        pucch_decode.timing_offset = 0;
+        pucch_decode.rnti          = ul_sched->pucch[i].rnti;
+        pucch_decode.msg.N_bits    = 1;
+        if(LTE_FDD_ENB_PUCCH_TYPE_ACK_NACK == ul_sched->pucch[i].type)
+        {
+            SIM_DL_TB_STRUCT *tb  = &ue->dl_tb[liblte_phy_sub_from_tti(ul_sched->current_tti, 4) % 10];
+            bool              ack = tb->valid && draw_ack(ue->cqi, tb->mcs);
+            if(ack)
+                ue->dl_acked_bits += tb->tbs;
+            else
+                ue->N_dl_nacks++;
+            if(!ack && tb->valid && LTE_FDD_ENB_MAX_HARQ_RETX > tb->harq_retx_count)
+                ue->dl_retx_due[(tb->harq_process << 8) | (tb->harq_retx_count + 1)] = sim_tti;
+            tb->valid               = false;
+            pucch_decode.msg.msg[0] = ack;
+        }else{
+            // The PHY only reports a detected SR
+            if(!ue->sr_pending)
+                continue;
+            ue->N_srs++;
+            pucch_decode.msg.msg[0] = 1;
+        }
+        msgq_phy_to_mac->send(LTE_FDD_ENB_MESSAGE_TYPE_PUCCH_DECODE,
+                              LTE_FDD_ENB_DEST_LAYER_MAC,
+                              (LTE_FDD_ENB_MESSAGE_UNION *)&pucch_decode,
+                              sizeof(LTE_FDD_ENB_PUCCH_DECODE_MSG_STRUCT));
+    }
+
+    for(uint32 i=0; i<ul_sched->decodes.N_ul_alloc; i++)
+    {
+        LIBLTE_PHY_ALLOCATION_STRUCT *alloc = &ul_sched->decodes.ul_alloc[i];
+        SIM_UE_STRUCT                *ue    = find_ue(alloc->rnti);
+
+        cell_stats.ul_prbs += alloc->N_prb;
+        if(!liblte_phy_is_valid_n_prb_for_ul(alloc->N_prb, cnfg.N_rb))
+            cell_stats.bad_ul_grants++;
+        if(NULL == ue)
+            continue;
+        ue->ul_prbs += alloc->N_prb;
+        send_pusch(ue, alloc, ul_sched->current_tti);
+    }
+}
+
+/****************/
+/*    Report    */
+/****************/
+static void report_latency(FILE                *out,
+                           const char          *name,
+                           std::vector<double> &latency_ms)
+{
+    std::sort(latency_ms.begin(), latency_ms.end());
+    fprintf(out, "\"%s\": {\"n\": %u, \"mean\": %.2f, \"p50\": %.2f, \"p95\": %.2f, \"max\": %.2f}",
+            name, (uint32)latency_ms.size(), mean(latency_ms), percentile(latency_ms, 50),
+            percentile(latency_ms, 95), percentile(latency_ms, 100));
+}
+
+static void report(FILE   *out,
+                   double  wall_s)
+{
+    std::sort(cell_stats.sched_us.begin(), cell_stats.sched_us.end());
+    std::sort(cell_stats.mac_us.begin(), cell_stats.mac_us.end());
+
+    fprintf(out, "{\"sim\": \"LTE_fdd_enb_mac\", \"seed\": %u, \"ttis\": %u, \"n_rb\": %u, \"n_ues\": %u, ",
+            cnfg.seed, cnfg.N_ttis, cnfg.N_rb, cnfg.N_ues);
+    fprintf(out, "\"dl_policy\": \"%s\", \"ul_policy\": \"%s\", \"traffic\": \"%s\", \"pkt_bytes\": %u, ",
+            LTE_fdd_enb_dl_sched_policy_text[cnfg.dl_policy], LTE_fdd_enb_dl_sched_policy_text[cnfg.ul_policy],
+            cnfg.poisson ? "poisson" : "periodic", cnfg.pkt_bytes);
+    fprintf(out, "\"cqi\": \"%s\",\n", (0 != cnfg.cqi_trace.size()) ? "trace" : "random_walk");
+    fprintf(out, " \"cell\": {\"dl_prb_util\": %.4f, \"ul_prb_util\": %.4f, \"common_prbs\": %llu, \"bad_ul_grants\": %llu, ",
+            (double)cell_stats.dl_prbs / ((uint64)cnfg.N_ttis*cnfg.N_rb),
+            (double)cell_stats.ul_prbs / ((uint64)cnfg.N_ttis*cnfg.N_rb),
+            (unsigned long long)cell_stats.common_prbs,
+            (unsigned long long)cell_stats.bad_ul_grants);
+    fprintf(out, "\"lost_dl_retx\": %llu, ", (unsigned long long)cell_stats.lost_dl_retx);
+    fprintf(out, "\"sched_us\": {\"mean\": %.2f, \"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f}, ",
+            mean(cell_stats.sched_us), percentile(cell_stats.sched_us, 50),
+            percentile(cell_stats.sched_us, 99), percentile(cell_stats.sched_us, 100));
+    fprintf(out, "\"mac_us\": {\"mean\": %.2f, \"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f}, ",
+            mean(cell_stats.mac_us), percentile(cell_stats.mac_us, 50),
+            percentile(cell_stats.mac_us, 99), percentile(cell_stats.mac_us, 100));
+    fprintf(out, "\"wall_s\": %.3f, \"speedup\": %.1f},\n \"ues\": [",
+            wall_s, (wall_s > 0) ? (cnfg.N_ttis / 1000.0) / wall_s : 0);
+    for(uint32 i=0; i<ues.size(); i++)
+    {
+        SIM_UE_STRUCT *ue = &ues[i];
+        fprintf(out, "%s\n  {\"rnti\": %u, \"mean_cqi\": %u, ", (0 == i) ? "" : ",", ue->c_rnti, ue->mean_cqi);
+        fprintf(out, "\"dl_offered_mbps\": %.3f, \"dl_mbps\": %.3f, \"dl_mac_mbps\": %.3f, ",
+                to_mbps(ue->dl_offered_bytes*8), to_mbps(ue->dl_served_bytes*8), to_mbps(ue->dl_acked_bits));
+        fprintf(out, "\"dl_tbs\": %u, \"dl_retx\": %u, \"dl_nacks\": %u, \"dl_prbs_per_tti\": %.3f, ",
+                ue->N_dl_tbs, ue->N_dl_retx, ue->N_dl_nacks, (double)ue->dl_prbs / cnfg.N_ttis);
+        report_latency(out, "dl_latency_ms", ue->dl_latency_ms);
+        fprintf(out, ",\n   \"ul_offered_mbps\": %.3f, \"ul_mbps\": %.3f, \"ul_srs\": %u, \"ul_prbs_per_tti\": %.3f, ",
+                to_mbps(ue->ul_offered_bytes*8), to_mbps(ue->ul_received_bytes*8), ue->N_srs,
+                (double)ue->ul_prbs / cnfg.N_ttis);
+        report_latency(out, "ul_latency_ms", ue->ul_latency_ms);
+        fprintf(out, "}");
+    }
+    fprintf(out, "\n]}\n");
+}
+
+/***************/
+/*    Setup    */
+/***************/
+static bool parse_policy(const char                       *name,
+                         LTE_FDD_ENB_DL_SCHED_POLICY_ENUM *policy)
+{
+    for(uint32 i=0; i<LTE_FDD_ENB_DL_SCHED_POLICY_N_ITEMS; i++)
+    {
+        if(0 == strcmp(name, LTE_fdd_enb_dl_sched_policy_text[i]))
+        {
+            *policy = (LTE_FDD_ENB_DL_SCHED_POLICY_ENUM)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_bandwidth(const char *name)
+{
+    static const char   *bw_names[] = {"1.4", "3", "5", "10", "15", "20"};
+    static const uint32  bw_N_rb[]  = {LIBLTE_PHY_N_RB_DL_1_4MHZ, LIBLTE_PHY_N_RB_DL_3MHZ,
+                                       LIBLTE_PHY_N_RB_DL_5MHZ,   LIBLTE_PHY_N_RB_DL_10MHZ,
+                                       LIBLTE_PHY_N_RB_DL_15MHZ,  LIBLTE_PHY_N_RB_DL_20MHZ};
+    for(uint32 i=0; i<sizeof(bw_N_rb)/sizeof(bw_N_rb[0]); i++)
+    {
+        if(0 == strcmp(name, bw_names[i]))
+        {
+            cnfg.N_rb = bw_N_rb[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// One row per CQI report, one column per UE (reused when there are more UEs)
+static bool read_cqi_trace(const char *file_name)
+{
+    FILE *trace = fopen(file_name, "r");
+    char  line[4096];
+
+    if(NULL == trace)
+        return false;
+    while(NULL != fgets(line, sizeof(line), trace))
+    {
+        std::vector<uint32>  row;
+        char                *tok = strtok(line, " \t,\r\n");
+        if(NULL == tok || '#' == tok[0])
+            continue;
+        for(; NULL != tok; tok=strtok(NULL, " \t,\r\n"))
+            row.push_back(atoi(tok));
+        cnfg.cqi_trace.push_back(row);
+    }
+    fclose(trace);
+    return 0 != cnfg.cqi_trace.size();
+}
+
+static void add_ues(LTE_fdd_enb_user_mgr *user_mgr,
+                    LTE_fdd_enb_mac      *mac,
+                    LTE_fdd_enb_rrc      *rrc,
+                    LTE_fdd_enb_rlc      *rlc)
+{
+    ues.resize(cnfg.N_ues);
+    for(uint32 i=0; i<cnfg.N_ues; i++)
+    {
+        SIM_UE_STRUCT *ue = &ues[i];
+        if(LTE_FDD_ENB_ERROR_NONE != user_mgr->add_user(&ue->user, 0, rrc, rlc) ||
+           LTE_FDD_ENB_ERROR_NONE != ue->user->setup_drb(LTE_FDD_ENB_RB_DRB1, &ue->drb))
+        {
+            fprintf(stderr, "Unable to add UE %u\n", i);
+            exit(-1);
+        }
+        ue->drb->set_lc_id(DRB_LCID);
+        ue->drb->set_log_chan_group(DRB_LCG);
+        ue->c_rnti = ue->user->get_c_rnti();
+        rnti_to_ue[ue->c_rnti] = i;
+        rb_to_ue[ue->drb]      = i;
+
+        // SR every 10 subframes, spread over the offsets
+        mac->add_periodic_sr_pucch(ue->c_rnti, 5 + (i % 10), i + 1);
+
+        // Mean channel quality is spread evenly over the UEs
+        ue->mean_cqi = 3;
+        if(1 < cnfg.N_ues)
+            ue->mean_cqi += (12 * i) / (cnfg.N_ues - 1);
+        ue->cqi = ue->mean_cqi;
+        ue->user->set_dl_cqi(ue->cqi);
+
+        // Periodic sources start at a random phase
+        ue->next_dl_arrival = INFINITY;
+        ue->next_ul_arrival = INFINITY;
+        if(0 != cnfg.dl_kbps)
+            ue->next_dl_arrival = uniform() * next_interarrival_ms(cnfg.dl_kbps);
+        if(0 != cnfg.ul_kbps)
+            ue->next_ul_arrival = uniform() * next_interarrival_ms(cnfg.ul_kbps);
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-u ues] [-t ttis] [-s seed] [-b bandwidth_mhz] [-d dl_policy] [-p ul_policy]\n"
+                    "          [-l dl_kbps] [-k ul_kbps] [-z pkt_bytes] [-m periodic|poisson] [-e bler]\n"
+                    "          [-c cqi_trace] [-o output.json] [-r]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *out_name = NULL;
+    FILE       *out      = stdout;
+    int         opt;
+
+    cnfg.dl_policy  = LTE_FDD_ENB_DL_SCHED_POLICY_PROPORTIONAL_FAIR;
+    cnfg.ul_policy  = LTE_FDD_ENB_DL_SCHED_POLICY_ROUND_ROBIN;
+    cnfg.bler       = DEFAULT_BLER;
+    cnfg.N_ues      = DEFAULT_N_UES;
+    cnfg.N_ttis     = DEFAULT_N_TTIS;
+    cnfg.seed       = DEFAULT_SEED;
+    cnfg.N_rb       = LIBLTE_PHY_N_RB_DL_5MHZ;
+    cnfg.dl_kbps    = DEFAULT_DL_KBPS;
+    cnfg.ul_kbps    = DEFAULT_UL_KBPS;
+    cnfg.pkt_bytes  = DEFAULT_PKT_BYTES;
+    cnfg.poisson    = true;
+    cnfg.check_retx = false;
+    while(-1 != (opt = getopt(argc, argv, "u:t:s:b:d:p:l:k:z:m:e:c:o:rh")))
+    {
+        bool valid = true;
+        switch(opt)
+        {
+        case 'u':
+            cnfg.N_ues = atoi(optarg);
+            break;
+        case 't':
+            cnfg.N_ttis = atoi(optarg);
+            break;
+        case 's':
+            cnfg.seed = atoi(optarg);
+            break;
+        case 'b':
+            valid = parse_bandwidth(optarg);
+            break;
+        case 'd':
+            valid = parse_policy(optarg, &cnfg.dl_policy);
+            break;
+        case 'p':
+            valid = parse_policy(optarg, &cnfg.ul_policy);
+            break;
+        case 'l':
+            cnfg.dl_kbps = atoi(optarg);
+            break;
+        case 'k':
+            cnfg.ul_kbps = atoi(optarg);
+            break;
+        case 'z':
+            cnfg.pkt_bytes = atoi(optarg);
+            break;
+        case 'm':
+            cnfg.poisson = (0 == strcmp(optarg, "poisson"));
+            valid        = cnfg.poisson || 0 == strcmp(optarg, "periodic");
+            break;
+        case 'e':
+            cnfg.bler = atof(optarg);
+            break;
+        case 'c':
+            valid = read_cqi_trace(optarg);
+            break;
+        case 'o':
+            out_name = optarg;
+            break;
+        case 'r':
+            cnfg.check_retx = true;
+            break;
+        default:
+            valid = false;
+            break;
+        }
+        if(!valid)
+        {
+            usage(argv[0]);
+            exit(-1);
+        }
+    }
+    if(0 == cnfg.N_ues || 0 == cnfg.N_ttis || 0 == cnfg.pkt_bytes ||
+       LIBLTE_MAX_MSG_SIZE < cnfg.pkt_bytes || LIBLTE_MAC_C_RNTI_END < cnfg.N_ues)
+    {
+        usage(argv[0]);
+        exit(-1);
+    }
+    if(NULL != out_name)
+    {
+        out = fopen(out_name, "w");
+        if(NULL == out)
+        {
+            fprintf(stderr, "Unable to open %s\n", out_name);
+            exit(-1);
+        }
+    }
+    rng.seed(cnfg.seed);
+
+    // Wire the real MAC to the stubs the same way the stack does
+    LTE_fdd_enb_interface *interface = new LTE_fdd_enb_interface();
+    LTE_fdd_enb_timer_mgr *timer_mgr = new LTE_fdd_enb_timer_mgr(interface);
+    LTE_fdd_enb_user_mgr  *user_mgr  = new LTE_fdd_enb_user_mgr(interface, timer_mgr);
+    LTE_fdd_enb_rlc       *rlc       = new LTE_fdd_enb_rlc(interface);
+    LTE_fdd_enb_mac       *mac       = new LTE_fdd_enb_mac(interface, 0, timer_mgr, user_mgr, rlc);
+    LTE_fdd_enb_phy       *phy       = new LTE_fdd_enb_phy(interface, 0, mac);
+    LTE_fdd_enb_rrc       *rrc       = new LTE_fdd_enb_rrc(interface, 0, user_mgr, mac);
+    LTE_fdd_enb_msgq      *mac_to_phy   = new LTE_fdd_enb_msgq(interface, "mac_to_phy");
+    LTE_fdd_enb_msgq      *mac_to_rlc   = new LTE_fdd_enb_msgq(interface, "mac_to_rlc");
+    LTE_fdd_enb_msgq      *mac_to_timer = new LTE_fdd_enb_msgq(interface, "mac_to_timer");
+    msgq_phy_to_mac = new LTE_fdd_enb_msgq(interface, "phy_to_mac");
+    msgq_rlc_to_mac = new LTE_fdd_enb_msgq(interface, "rlc_to_mac");
+    mac_to_phy->attach_rx(LTE_fdd_enb_msgq_cb(&handle_phy_schedule, NULL));
+    mac_to_rlc->attach_rx(LTE_fdd_enb_msgq_cb(&handle_rlc_pdu_ready, NULL));
+    mac->set_phy_and_rrc(phy, rrc);
+    timer_mgr->start(mac_to_timer);
+    mac->start(msgq_phy_to_mac, msgq_rlc_to_mac, mac_to_phy, mac_to_rlc, mac_to_timer, false);
+    add_ues(user_mgr, mac, rrc, rlc);
+
+    cell_stats.sched_us.reserve(cnfg.N_ttis);
+    cell_stats.mac_us.reserve(cnfg.N_ttis);
+    uint64 wall_start = now_ns();
+    for(sim_tti=0; sim_tti<cnfg.N_ttis; sim_tti++)
+    {
+        for(uint32 i=0; i<ues.size(); i++)
+        {
+            if(0 == sim_tti % C_RNTI_KEEPALIVE)
+                user_mgr->reset_c_rnti_timer(ues[i].c_rnti);
+            if((i % CQI_REPORT_PERIOD) == (sim_tti % CQI_REPORT_PERIOD))
+                update_channel(&ues[i], i);
+        }
+
+        uint64 mac_ns = 0;
+        uint64 t0     = cpu_ns();
+        for(auto &ue : ues)
+            generate_traffic(&ue);
+        uint64 t1 = cpu_ns();
+        mac_ns   += t1 - t0;
+
+        LTE_FDD_ENB_READY_TO_SEND_MSG_STRUCT rts;
+        rts.dl_current_tti = liblte_phy_add_to_tti(sim_tti % (LIBLTE_PHY_TTI_MAX + 1), 4);
+        rts.ul_current_tti = sim_tti % (LIBLTE_PHY_TTI_MAX + 1);
+        rts.late           = false;
+        phy_sched_valid    = false;
+        t0                 = cpu_ns();
+        msgq_phy_to_mac->send(LTE_FDD_ENB_MESSAGE_TYPE_READY_TO_SEND,
+                              LTE_FDD_ENB_DEST_LAYER_MAC,
+                              (LTE_FDD_ENB_MESSAGE_UNION *)&rts,
+                              sizeof(LTE_FDD_ENB_READY_TO_SEND_MSG_STRUCT));
+        t1      = cpu_ns();
+        mac_ns += t1 - t0;
+        cell_stats.sched_us.push_back((t1 - t0)/1000.0);
+
+        if(phy_sched_valid)
+        {
+            process_dl_schedule(&phy_sched.dl_sched);
+            t0 = cpu_ns();
+            process_ul_schedule(&phy_sched.ul_sched);
+            mac_ns += cpu_ns() - t0;
+        }
+        cell_stats.mac_us.push_back(mac_ns/1000.0);
+    }
+    double wall_s = (now_ns() - wall_start) / 1e9;
+    for(auto &ue : ues)
+        for(auto &due : ue.dl_retx_due)
+            if(due.second + RETX_GRACE_N_TTIS <= cnfg.N_ttis)
+                cell_stats.lost_dl_retx++;
+
+    report(out, wall_s);
+    if(stdout != out)
+        fclose(out);
+
+    mac->stop();
+    timer_mgr->stop();
+
+    // Fails the run for ctest
+    if(0 != cell_stats.bad_ul_grants)
+    {
+        fprintf(stderr, "%llu UL grants with an invalid PUSCH size\n",
+                (unsigned long long)cell_stats.bad_ul_grants);
+        return 1;
+    }
+    if(cnfg.check_retx && 0 != cell_stats.lost_dl_retx)
+    {
+        fprintf(stderr, "%llu NACKed DL TBs were never retransmitted\n",
+                (unsigned long long)cell_stats.lost_dl_retx);
+        return 1;
+    }
+    return 0;
+}
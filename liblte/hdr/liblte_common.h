@@ -55,6 +55,11 @@
 // FIXME: This was chosen arbitrarily
 #define LIBLTE_MAX_MSG_SIZE 5512
 
+// Space kept in front of and behind the payload of a byte buffer so that
+// protocol headers can be prepended and stripped without moving the data
+#define LIBLTE_BYTE_BUF_HEADROOM 64
+#define LIBLTE_BYTE_BUF_TAILROOM 16
+
 /*******************************************************************************
                               TYPEDEFS
 *******************************************************************************/
@@ -77,6 +82,15 @@ typedef struct{
     uint8  msg[LIBLTE_MAX_MSG_SIZE];
 }LIBLTE_BYTE_MSG_STRUCT;
 
+// The payload starts at buf[offset] and is N_bytes long, only the first
+// buf_size bytes of buf are backed by memory
+typedef struct{
+    uint32 N_bytes;
+    uint32 offset;
+    uint32 buf_size;
+    uint8  buf[LIBLTE_BYTE_BUF_HEADROOM + LIBLTE_MAX_MSG_SIZE + LIBLTE_BYTE_BUF_TAILROOM];
+}LIBLTE_BYTE_BUF_STRUCT;
+
 /*******************************************************************************
                               CLASS DECLARATIONS
 *******************************************************************************/
@@ -116,4 +130,62 @@ void liblte_value_2_bits(uint32   value,
 uint32 liblte_bits_2_value(uint8  **bits,
                            uint32   N_bits);
 
+/*********************************************************************
+    Name: liblte_byte_buf_init
+
+    Description: Empties a byte buffer and resets its headroom
+*********************************************************************/
+void liblte_byte_buf_init(LIBLTE_BYTE_BUF_STRUCT *buf);
+
+/*********************************************************************
+    Name: liblte_byte_buf_init_sized
+
+    Description: Empties a byte buffer whose buf array is only backed
+                 for buf_size bytes and resets its headroom
+*********************************************************************/
+void liblte_byte_buf_init_sized(LIBLTE_BYTE_BUF_STRUCT *buf,
+                                uint32                  buf_size);
+
+/*********************************************************************
+    Name: liblte_byte_buf_data
+
+    Description: Returns a pointer to the first payload byte
+*********************************************************************/
+uint8* liblte_byte_buf_data(LIBLTE_BYTE_BUF_STRUCT *buf);
+
+/*********************************************************************
+    Name: liblte_byte_buf_tailroom
+
+    Description: Returns the number of bytes that can still be added
+                 behind the payload
+*********************************************************************/
+uint32 liblte_byte_buf_tailroom(LIBLTE_BYTE_BUF_STRUCT *buf);
+
+/*********************************************************************
+    Name: liblte_byte_buf_prepend
+
+    Description: Grows the payload into the headroom and returns a
+                 pointer to the new first byte
+*********************************************************************/
+LIBLTE_ERROR_ENUM liblte_byte_buf_prepend(LIBLTE_BYTE_BUF_STRUCT  *buf,
+                                          uint32                   N_bytes,
+                                          uint8                  **hdr);
+
+/*********************************************************************
+    Name: liblte_byte_buf_strip
+
+    Description: Removes bytes from the front of the payload
+*********************************************************************/
+LIBLTE_ERROR_ENUM liblte_byte_buf_strip(LIBLTE_BYTE_BUF_STRUCT *buf,
+                                        uint32                  N_bytes);
+
+/*********************************************************************
+    Name: liblte_byte_buf_append
+
+    Description: Copies bytes to the end of the payload
+*********************************************************************/
+LIBLTE_ERROR_ENUM liblte_byte_buf_append(LIBLTE_BYTE_BUF_STRUCT *buf,
+                                         uint8                  *data,
+                                         uint32                  N_bytes);
+
 #endif /* __LIBLTE_COMMON_H__ */
@@ -174,6 +174,11 @@ LIBLTE_ERROR_ENUM liblte_pdcp_pack_data_pdu_with_long_sn(LIBLTE_PDCP_DATA_PDU_WI
                                                          LIBLTE_BYTE_MSG_STRUCT                   *pdu);
 LIBLTE_ERROR_ENUM liblte_pdcp_unpack_data_pdu_with_long_sn(LIBLTE_BYTE_MSG_STRUCT                   *pdu,
                                                            LIBLTE_PDCP_DATA_PDU_WITH_LONG_SN_STRUCT *contents);
+// In place, the header is prepended to or stripped from the buffer payload
+LIBLTE_ERROR_ENUM liblte_pdcp_pack_data_pdu_with_long_sn(uint32                  count,
+                                                         LIBLTE_BYTE_BUF_STRUCT *buf);
+LIBLTE_ERROR_ENUM liblte_pdcp_unpack_data_pdu_with_long_sn(LIBLTE_BYTE_BUF_STRUCT *buf,
+                                                           uint32                 *count);
 
 /*********************************************************************
     PDU Type: User Plane PDCP Data PDU with short PDCP SN
@@ -192,6 +197,11 @@ LIBLTE_ERROR_ENUM liblte_pdcp_pack_data_pdu_with_short_sn(LIBLTE_PDCP_DATA_PDU_W
                                                           LIBLTE_BYTE_MSG_STRUCT                    *pdu);
 LIBLTE_ERROR_ENUM liblte_pdcp_unpack_data_pdu_with_short_sn(LIBLTE_BYTE_MSG_STRUCT                    *pdu,
                                                             LIBLTE_PDCP_DATA_PDU_WITH_SHORT_SN_STRUCT *contents);
+// In place, the header is prepended to or stripped from the buffer payload
+LIBLTE_ERROR_ENUM liblte_pdcp_pack_data_pdu_with_short_sn(uint32                  count,
+                                                          LIBLTE_BYTE_BUF_STRUCT *buf);
+LIBLTE_ERROR_ENUM liblte_pdcp_unpack_data_pdu_with_short_sn(LIBLTE_BYTE_BUF_STRUCT *buf,
+                                                            uint32                 *count);
 
 /*********************************************************************
     PDU Type: PDCP Control PDU for interspersed ROHC feedback packet
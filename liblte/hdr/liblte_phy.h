@@ -286,6 +286,7 @@ typedef struct{
     uint8          pusch_encode_bits[28800];
     uint8          pusch_scramb_bits[28800];
     int8           pusch_soft_bits[28800];
+    float          pusch_timing_offset; // In Ts, from the DMRS of the last decode
 
     // PUCCH
     complex pucch_z_est[LIBLTE_PHY_N_SC_RB_UL*14];
@@ -293,6 +294,7 @@ typedef struct{
     complex pucch_c_est_1[LIBLTE_PHY_M_PUCCH_RS*LIBLTE_PHY_N_SC_RB_UL];
     complex pucch_c_est[LIBLTE_PHY_N_SC_RB_UL*14];
     complex pucch_z[LIBLTE_PHY_N_ANT_MAX][LIBLTE_PHY_N_SC_RB_UL*14];
+    float   pucch_timing_offset; // In Ts, from the DMRS of the last decode
 
     // UL Reference Signals
     complex ulrs_x_q[2048];
@@ -382,7 +384,7 @@ typedef struct{
     complex pdcch_x[LIBLTE_PHY_PDCCH_N_BITS_MAX / 2];
     complex pdcch_d[LIBLTE_PHY_PDCCH_N_BITS_MAX / 2];
     float   pdcch_descramb_bits[LIBLTE_PHY_PDCCH_N_BITS_MAX];
-    uint32  pdcch_c[LIBLTE_PHY_PDCCH_N_BITS_MAX * 2];
+    uint32  pdcch_c[LIBLTE_PHY_PDCCH_N_CCE_MAX * LIBLTE_PHY_PDCCH_N_RE_CCE * 2];
     uint32  pdcch_permute_map[LIBLTE_PHY_PDCCH_N_REGS_MAX][LIBLTE_PHY_PDCCH_N_REGS_MAX];
     uint16  pdcch_reg_vec[LIBLTE_PHY_PDCCH_N_REGS_MAX];
     uint16  pdcch_reg_perm_vec[LIBLTE_PHY_PDCCH_N_REGS_MAX];
@@ -641,6 +643,8 @@ typedef struct{
     uint32                          N_layers;
     uint32                          tx_mode;
     uint32                          harq_retx_count;
+    uint32                          N_cce_agg;
+    uint32                          cce_idx;
     uint16                          rnti;
     uint8                           mcs;
     uint8                           tpc;
@@ -923,6 +927,10 @@ LIBLTE_ERROR_ENUM liblte_phy_bch_channel_decode(LIBLTE_PHY_STRUCT          *phy_
     Document Reference: 3GPP TS 36.211 v10.1.0 sections 6.7, 6.8, and
                         6.9
                         3GPP TS 36.212 v10.1.0 section 5.1.4.2.1
+
+    NOTES: Allocations with an N_cce_agg of 0 use aggregation level 4
+           in the first free common search space candidate, all others
+           are mapped to N_cce_agg CCEs starting at cce_idx
 *********************************************************************/
 // Defines
 // Enums
@@ -1209,6 +1217,54 @@ LIBLTE_ERROR_ENUM liblte_phy_get_tbs_and_n_prb_for_dl(uint32  N_bits,
                                                       uint32 *tbs,
                                                       uint32 *N_prb);
 
+/*********************************************************************
+    Name: liblte_phy_get_tbs_for_dl
+
+    Description: Determines the transport block size for a specific
+                 number of PRBs and modulation and coding scheme
+
+    Document Reference: 3GPP TS 36.213 v10.3.0 section 7.1.7
+*********************************************************************/
+// Defines
+// Enums
+// Structs
+// Functions
+LIBLTE_ERROR_ENUM liblte_phy_get_tbs_for_dl(uint8   mcs,
+                                            uint32  N_prb,
+                                            uint32 *tbs);
+
+/*********************************************************************
+    Name: liblte_phy_get_dl_rbg_size
+
+    Description: Determines the resource block group size used by DL
+                 resource allocation types 0 and 1
+
+    Document Reference: 3GPP TS 36.213 v10.3.0 section 7.1.6.1
+*********************************************************************/
+// Defines
+// Enums
+// Structs
+// Functions
+uint32 liblte_phy_get_dl_rbg_size(uint32 N_rb_dl);
+
+/*********************************************************************
+    Name: liblte_phy_map_dl_rbg_bitmap
+
+    Description: Converts a DL resource allocation type 0 RBG bitmap
+                 into the PRBs of an allocation
+
+    Document Reference: 3GPP TS 36.213 v10.3.0 section 7.1.6.1
+
+    NOTES: Bit N of the bitmap is RBG N
+*********************************************************************/
+// Defines
+// Enums
+// Structs
+// Functions
+LIBLTE_ERROR_ENUM liblte_phy_map_dl_rbg_bitmap(uint32                        rbg_bitmap,
+                                               uint32                        N_rb_dl,
+                                               LIBLTE_PHY_ALLOCATION_STRUCT *alloc);
+
 /*********************************************************************
     Name: liblte_phy_get_tbs_mcs_and_n_prb_for_ul
 
@@ -1248,6 +1304,42 @@ LIBLTE_ERROR_ENUM liblte_phy_get_tbs_and_n_prb_for_ul(uint32  N_bits,
                                                       uint32 *tbs,
                                                       uint32 *N_prb);
 
+/*********************************************************************
+    Name: liblte_phy_get_tbs_for_ul
+
+    Description: Determines the transport block size for a specific
+                 number of PRBs and modulation and coding scheme
+
+    Document Reference: 3GPP TS 36.213 v10.3.0 section 8.6.1
+                        3GPP TS 36.211 v10.1.0 section 5.3.3
+
+    NOTES: N_prb must be a valid transform precoding size
+*********************************************************************/
+// Defines
+// Enums
+// Structs
+// Functions
+LIBLTE_ERROR_ENUM liblte_phy_get_tbs_for_ul(uint8   mcs,
+                                            uint32  N_prb,
+                                            uint32 *tbs);
+
+/*********************************************************************
+    Name: liblte_phy_is_valid_n_prb_for_ul
+
+    Description: Checks that a number of PRBs can be used for a PUSCH
+                 allocation, M_sc_pusch must be 2^a * 3^b * 5^c and
+                 a PHY set up for N_rb_ul only has transform precoding
+                 plans for fewer than N_rb_ul PRBs.
+
+    Document Reference: 3GPP TS 36.211 v10.1.0 section 5.3.3
+*********************************************************************/
+// Defines
+// Enums
+// Structs
+// Functions
+bool liblte_phy_is_valid_n_prb_for_ul(uint32 N_prb,
+                                      uint32 N_rb_ul);
+
 /*********************************************************************
     Name: liblte_phy_get_n_cce
 
@@ -1266,6 +1358,31 @@ LIBLTE_ERROR_ENUM liblte_phy_get_n_cce(LIBLTE_PHY_STRUCT *phy_struct,
                                        uint8              N_ant,
                                        uint32            *N_cce);
 
+/*********************************************************************
+    Name: liblte_phy_get_pdcch_candidates
+
+    Description: Determines the first control channel element of each
+                 PDCCH candidate in either the common or the UE
+                 specific search space
+
+    Document Reference: 3GPP TS 36.213 v10.3.0 section 9.1.1
+
+    NOTES: The common search space only supports aggregation levels
+           4 and 8, rnti is ignored for it
+*********************************************************************/
+// Defines
+#define LIBLTE_PHY_PDCCH_N_CANDIDATES_MAX 6
+// Enums
+// Structs
+// Functions
+LIBLTE_ERROR_ENUM liblte_phy_get_pdcch_candidates(uint16  rnti,
+                                                  uint32  subfr_num,
+                                                  uint32  N_cce,
+                                                  uint32  N_cce_agg,
+                                                  bool    common,
+                                                  uint32 *cce_idx,
+                                                  uint32 *N_cand);
+
 /*********************************************************************
     Name: liblte_phy_add_to_tti
 
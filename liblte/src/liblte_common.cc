@@ -102,3 +102,103 @@ uint32 liblte_bits_2_value(uint8  **bits,
 
     return value;
 }
+
+/*********************************************************************
+    Name: liblte_byte_buf_init
+
+    Description: Empties a byte buffer and resets its headroom
+*********************************************************************/
+void liblte_byte_buf_init(LIBLTE_BYTE_BUF_STRUCT *buf)
+{
+    liblte_byte_buf_init_sized(buf, sizeof(buf->buf));
+}
+
+/*********************************************************************
+    Name: liblte_byte_buf_init_sized
+
+    Description: Empties a byte buffer whose buf array is only backed
+                 for buf_size bytes and resets its headroom
+*********************************************************************/
+void liblte_byte_buf_init_sized(LIBLTE_BYTE_BUF_STRUCT *buf,
+                                uint32                  buf_size)
+{
+    buf->N_bytes  = 0;
+    buf->offset   = LIBLTE_BYTE_BUF_HEADROOM;
+    buf->buf_size = buf_size;
+}
+
+/*********************************************************************
+    Name: liblte_byte_buf_data
+
+    Description: Returns a pointer to the first payload byte
+*********************************************************************/
+uint8* liblte_byte_buf_data(LIBLTE_BYTE_BUF_STRUCT *buf)
+{
+    return &buf->buf[buf->offset];
+}
+
+/*********************************************************************
+    Name: liblte_byte_buf_tailroom
+
+    Description: Returns the number of bytes that can still be added
+                 behind the payload
+*********************************************************************/
+uint32 liblte_byte_buf_tailroom(LIBLTE_BYTE_BUF_STRUCT *buf)
+{
+    return buf->buf_size - buf->offset - buf->N_bytes;
+}
+
+/*********************************************************************
+    Name: liblte_byte_buf_prepend
+
+    Description: Grows the payload into the headroom and returns a
+                 pointer to the new first byte
+*********************************************************************/
+LIBLTE_ERROR_ENUM liblte_byte_buf_prepend(LIBLTE_BYTE_BUF_STRUCT  *buf,
+                                          uint32                   N_bytes,
+                                          uint8                  **hdr)
+{
+    if(buf == NULL || hdr == NULL || N_bytes > buf->offset)
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    buf->offset  -= N_bytes;
+    buf->N_bytes += N_bytes;
+    *hdr          = &buf->buf[buf->offset];
+
+    return LIBLTE_SUCCESS;
+}
+
+/*********************************************************************
+    Name: liblte_byte_buf_strip
+
+    Description: Removes bytes from the front of the payload
+*********************************************************************/
+LIBLTE_ERROR_ENUM liblte_byte_buf_strip(LIBLTE_BYTE_BUF_STRUCT *buf,
+                                        uint32                  N_bytes)
+{
+    if(buf == NULL || N_bytes > buf->N_bytes)
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    buf->offset  += N_bytes;
+    buf->N_bytes -= N_bytes;
+
+    return LIBLTE_SUCCESS;
+}
+
+/*********************************************************************
+    Name: liblte_byte_buf_append
+
+    Description: Copies bytes to the end of the payload
+*********************************************************************/
+LIBLTE_ERROR_ENUM liblte_byte_buf_append(LIBLTE_BYTE_BUF_STRUCT *buf,
+                                         uint8                  *data,
+                                         uint32                  N_bytes)
+{
+    if(buf == NULL || data == NULL || N_bytes > liblte_byte_buf_tailroom(buf))
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    memcpy(&buf->buf[buf->offset + buf->N_bytes], data, N_bytes);
+    buf->N_bytes += N_bytes;
+
+    return LIBLTE_SUCCESS;
+}
@@ -101,7 +101,8 @@ LIBLTE_ERROR_ENUM liblte_mac_pack_truncated_bsr_ce(LIBLTE_MAC_TRUNCATED_BSR_CE_S
         if(truncated_bsr->min_buffer_size  > bsr_min_buffer_size[i] &&
            truncated_bsr->max_buffer_size <= bsr_max_buffer_size[i])
             buf_size = i;
-    if(buf_size == 0)
+    // An empty buffer is index 0, anything past the table is index 63
+    if(buf_size == 0 && truncated_bsr->max_buffer_size != 0)
     {
         liblte_value_2_bits(63, ce_ptr, 6);
     }else{
@@ -174,9 +175,13 @@ LIBLTE_ERROR_ENUM liblte_mac_pack_long_bsr_ce(LIBLTE_MAC_LONG_BSR_CE_STRUCT  *lo
            long_bsr->max_buffer_size_3 <= bsr_max_buffer_size[i])
             buf_size[3] = i;
     }
+    uint32 max_buffer_size[4] = {long_bsr->max_buffer_size_0,
+                                 long_bsr->max_buffer_size_1,
+                                 long_bsr->max_buffer_size_2,
+                                 long_bsr->max_buffer_size_3};
     for(uint32 i=0; i<4; i++)
     {
-        if(buf_size[i] == 0)
+        if(buf_size[i] == 0 && max_buffer_size[i] != 0)
         {
             liblte_value_2_bits(63, ce_ptr, 6);
         }else{
@@ -227,6 +227,38 @@ LIBLTE_ERROR_ENUM liblte_pdcp_unpack_data_pdu_with_long_sn(LIBLTE_BYTE_MSG_STRUC
 
     return LIBLTE_SUCCESS;
 }
+LIBLTE_ERROR_ENUM liblte_pdcp_pack_data_pdu_with_long_sn(uint32                  count,
+                                                         LIBLTE_BYTE_BUF_STRUCT *buf)
+{
+    uint8 *pdu_ptr;
+
+    if(buf == NULL)
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    if(LIBLTE_SUCCESS != liblte_byte_buf_prepend(buf, 2, &pdu_ptr))
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    // Header
+    pdu_ptr[0] = (LIBLTE_PDCP_D_C_DATA_PDU << 7) | ((count >> 8) & 0x0F);
+    pdu_ptr[1] = count & 0xFF;
+
+    return LIBLTE_SUCCESS;
+}
+LIBLTE_ERROR_ENUM liblte_pdcp_unpack_data_pdu_with_long_sn(LIBLTE_BYTE_BUF_STRUCT *buf,
+                                                           uint32                 *count)
+{
+    if(buf == NULL || count == NULL || buf->N_bytes < 2)
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    uint8 *pdu_ptr = liblte_byte_buf_data(buf);
+
+    // Header
+    if(LIBLTE_PDCP_D_C_DATA_PDU != (LIBLTE_PDCP_D_C_ENUM)((pdu_ptr[0] >> 7) & 0x01))
+        return LIBLTE_ERROR_INVALID_INPUTS;
+    *count = ((pdu_ptr[0] & 0x0F) << 8) | pdu_ptr[1];
+
+    return liblte_byte_buf_strip(buf, 2);
+}
 
 /*********************************************************************
     PDU Type: User Plane PDCP Data PDU with short PDCP SN
@@ -280,6 +312,37 @@ LIBLTE_ERROR_ENUM liblte_pdcp_unpack_data_pdu_with_short_sn(LIBLTE_BYTE_MSG_STRU
 
     return LIBLTE_SUCCESS;
 }
+LIBLTE_ERROR_ENUM liblte_pdcp_pack_data_pdu_with_short_sn(uint32                  count,
+                                                          LIBLTE_BYTE_BUF_STRUCT *buf)
+{
+    uint8 *pdu_ptr;
+
+    if(buf == NULL)
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    if(LIBLTE_SUCCESS != liblte_byte_buf_prepend(buf, 1, &pdu_ptr))
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    // Header
+    pdu_ptr[0] = (LIBLTE_PDCP_D_C_DATA_PDU << 7) | (count & 0x7F);
+
+    return LIBLTE_SUCCESS;
+}
+LIBLTE_ERROR_ENUM liblte_pdcp_unpack_data_pdu_with_short_sn(LIBLTE_BYTE_BUF_STRUCT *buf,
+                                                            uint32                 *count)
+{
+    if(buf == NULL || count == NULL || buf->N_bytes < 1)
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    uint8 *pdu_ptr = liblte_byte_buf_data(buf);
+
+    // Header
+    if(LIBLTE_PDCP_D_C_DATA_PDU != (LIBLTE_PDCP_D_C_ENUM)((pdu_ptr[0] >> 7) & 0x01))
+        return LIBLTE_ERROR_INVALID_INPUTS;
+    *count = pdu_ptr[0] & 0x7F;
+
+    return liblte_byte_buf_strip(buf, 1);
+}
 
 /*********************************************************************
     PDU Type: PDCP Control PDU for interspersed ROHC feedback packet
@@ -4907,6 +4907,8 @@ void dci_0_pack(LIBLTE_PHY_ALLOCATION_STRUCT    *alloc,
     uint32 RIV        = N_rb_ul*(alloc->N_prb-1) + alloc->prb[0][0];
     if((alloc->N_prb-1) > (N_rb_ul/2))
         RIV = N_rb_ul*(N_rb_ul - alloc->N_prb + 1) + (N_rb_ul - 1 - alloc->prb[0][0]);
+    if(alloc->N_prb == 0)
+        RIV = (1 << RIV_length) - 1; // SPS release, 3GPP TS 36.213 v10.3.0 table 9.2-1A
     liblte_value_2_bits(RIV, &dci, RIV_length);
 
     // Modulation and coding scheme and redundancy version
@@ -5013,6 +5015,8 @@ void dci_1a_pack(LIBLTE_PHY_ALLOCATION_STRUCT    *alloc,
         uint32 RIV        = N_rb_dl*(alloc->N_prb-1) + alloc->prb[0][0];
         if((alloc->N_prb-1) > (N_rb_dl/2))
             RIV = N_rb_dl*(N_rb_dl - alloc->N_prb + 1) + (N_rb_dl - 1 - alloc->prb[0][0]);
+        if(alloc->N_prb == 0)
+            RIV = (1 << RIV_length) - 1; // SPS release, 3GPP TS 36.213 v10.3.0 table 9.2-1A
         liblte_value_2_bits(RIV, &dci, RIV_length);
 
         // Modulation and coding scheme
@@ -5031,7 +5035,8 @@ void dci_1a_pack(LIBLTE_PHY_ALLOCATION_STRUCT    *alloc,
         liblte_value_2_bits(alloc->tpc, &dci, 2);
 
         // Calculate the TBS
-        alloc->tbs = TBS_71721[alloc->mcs][alloc->N_prb-1];
+        if(alloc->N_prb != 0)
+            alloc->tbs = TBS_71721[alloc->mcs][alloc->N_prb-1];
     }
 
     // Pad if needed
@@ -5160,6 +5165,299 @@ LIBLTE_ERROR_ENUM dci_1a_unpack(uint8                           *in_bits,
     return LIBLTE_SUCCESS;
 }
 
+/*********************************************************************
+    Name: dci_1_pack / dci_1_unpack
+
+    Description: Packs / Unpacks all of the fields into / from the
+                 Downlink Control Information format 1
+
+    Document Reference: 3GPP TS 36.212 v10.1.0 section 5.3.3.1.2
+                        3GPP TS 36.213 v10.3.0 section 7.1.6.1
+                        3GPP TS 36.213 v10.3.0 section 7.1.6.2
+                        3GPP TS 36.213 v10.3.0 section 7.1.7
+
+    Notes: Resource allocation type 0 is used when the allocation is
+           made of whole RBGs, otherwise type 1 is used if the PRBs
+           fit in a single RBG subset
+*********************************************************************/
+// Defines
+#define DCI_RA_TYPE_0 0
+#define DCI_RA_TYPE_1 1
+// Enums
+// Structs
+// Functions
+uint32 get_I_tbs_from_mcs(uint8 mcs);
+bool is_dci_size_ambiguous(uint32 size)
+{
+    // 3GPP TS 36.212 v10.1.0 table 5.3.3.1.2-1
+    return(size == 12 || size == 14 || size == 16 || size == 20 || size == 24 ||
+           size == 26 || size == 32 || size == 40 || size == 44 || size == 56);
+}
+uint32 get_dci_1a_size(uint32 N_rb_dl)
+{
+    uint32 size = (uint32)ceilf(logf(N_rb_dl*(N_rb_dl+1)/2)/logf(2)) + 15;
+    if(is_dci_size_ambiguous(size))
+        size++;
+    return size;
+}
+uint32 get_dci_1_size(uint32 N_rb_dl)
+{
+    uint32 P    = liblte_phy_get_dl_rbg_size(N_rb_dl);
+    uint32 size = (uint32)ceilf((float)N_rb_dl/P) + 13;
+    if(N_rb_dl > 10)
+        size++;
+    while(size == get_dci_1a_size(N_rb_dl) || is_dci_size_ambiguous(size))
+        size++;
+    return size;
+}
+void get_dl_ra_type_1_prbs(uint32  N_rb_dl,
+                           uint32  subset,
+                           uint32  shift,
+                           uint32 *prb,
+                           uint32 *N_prb)
+{
+    uint32 P         = liblte_phy_get_dl_rbg_size(N_rb_dl);
+    uint32 N_rbg     = (uint32)ceilf((float)N_rb_dl/P);
+    uint32 N_type1   = N_rbg - (uint32)ceilf(logf(P)/logf(2)) - 1;
+    uint32 last_rbg  = ((N_rb_dl-1)/P) % P;
+    uint32 N_subset  = ((N_rb_dl-1)/(P*P))*P;
+    if(subset < last_rbg)
+    {
+        N_subset += P;
+    }else if(subset == last_rbg){
+        N_subset += ((N_rb_dl-1) % P) + 1;
+    }
+    uint32 delta = 0;
+    if(shift && N_subset > N_type1)
+        delta = N_subset - N_type1;
+
+    // Bit i of the type 1 bitmap addresses prb[i]
+    *N_prb = 0;
+    for(uint32 i=0; i<N_type1 && (i+delta)<N_subset; i++)
+    {
+        prb[i] = ((i+delta)/P)*P*P + subset*P + ((i+delta) % P);
+        (*N_prb)++;
+    }
+}
+LIBLTE_ERROR_ENUM dci_1_pack(LIBLTE_PHY_ALLOCATION_STRUCT    *alloc,
+                             LIBLTE_PHY_DCI_CA_PRESENCE_ENUM  ca_presence,
+                             uint32                           N_rb_dl,
+                             uint8                            N_ant,
+                             uint8                           *out_bits,
+                             uint32                          *N_out_bits)
+{
+    uint8  *dci   = out_bits;
+    uint32  P     = liblte_phy_get_dl_rbg_size(N_rb_dl);
+    uint32  N_rbg = (uint32)ceilf((float)N_rb_dl/P);
+    bool    used[LIBLTE_PHY_N_RB_DL_MAX];
+
+    if(0 == alloc->N_prb || 27 < alloc->mcs)
+        return LIBLTE_ERROR_INVALID_INPUTS;
+    for(uint32 i=0; i<N_rb_dl; i++)
+        used[i] = false;
+    for(uint32 i=0; i<alloc->N_prb; i++)
+    {
+        if(alloc->prb[0][i] >= N_rb_dl || alloc->prb[0][i] != alloc->prb[1][i])
+            return LIBLTE_ERROR_INVALID_INPUTS;
+        used[alloc->prb[0][i]] = true;
+    }
+
+    // Type 0 needs every RBG to be either fully used or fully free
+    uint32 rbg_bitmap = 0;
+    bool   type_0     = true;
+    for(uint32 rbg=0; rbg<N_rbg; rbg++)
+    {
+        uint32 N_used    = 0;
+        uint32 N_rbg_prb = 0;
+        for(uint32 i=rbg*P; i<(rbg+1)*P && i<N_rb_dl; i++)
+        {
+            N_rbg_prb++;
+            if(used[i])
+                N_used++;
+        }
+        if(N_used == N_rbg_prb)
+            rbg_bitmap |= 1 << rbg;
+        else if(0 != N_used)
+            type_0 = false;
+    }
+
+    // Otherwise look for an RBG subset containing every PRB
+    uint32 subset      = 0;
+    uint32 shift       = 0;
+    uint32 type_1_bits = 0;
+    uint32 N_type1     = N_rbg - (uint32)ceilf(logf(P)/logf(2)) - 1;
+    if(!type_0)
+    {
+        bool found = false;
+        for(uint32 p=0; p<P && N_rb_dl>10 && !found; p++)
+        {
+            for(uint32 s=0; s<2 && !found; s++)
+            {
+                uint32 prb[LIBLTE_PHY_N_RB_DL_MAX];
+                uint32 N_prb;
+                uint32 bits  = 0;
+                uint32 N_hit = 0;
+                get_dl_ra_type_1_prbs(N_rb_dl, p, s, prb, &N_prb);
+                for(uint32 i=0; i<N_prb; i++)
+                {
+                    if(prb[i] < N_rb_dl && used[prb[i]])
+                    {
+                        bits |= 1 << i;
+                        N_hit++;
+                    }
+                }
+                if(N_hit == alloc->N_prb)
+                {
+                    subset      = p;
+                    shift       = s;
+                    type_1_bits = bits;
+                    found       = true;
+                }
+            }
+        }
+        if(!found)
+            return LIBLTE_ERROR_INVALID_INPUTS;
+    }
+
+    // Carrier indicator
+    if(LIBLTE_PHY_DCI_CA_PRESENT == ca_presence)
+    {
+        printf("WARNING: Not handling carrier indicator\n");
+        liblte_value_2_bits(0, &dci, 3);
+    }
+
+    // Resource allocation header
+    if(N_rb_dl > 10)
+        liblte_value_2_bits(type_0 ? DCI_RA_TYPE_0 : DCI_RA_TYPE_1, &dci, 1);
+
+    // Resource block assignment, RBG 0 or subset bit 0 is the MSB
+    if(type_0)
+    {
+        for(uint32 rbg=0; rbg<N_rbg; rbg++)
+            liblte_value_2_bits((rbg_bitmap >> rbg) & 1, &dci, 1);
+    }else{
+        liblte_value_2_bits(subset, &dci, (uint32)ceilf(logf(P)/logf(2)));
+        liblte_value_2_bits(shift, &dci, 1);
+        for(uint32 i=0; i<N_type1; i++)
+            liblte_value_2_bits((type_1_bits >> i) & 1, &dci, 1);
+    }
+
+    // Modulation and coding scheme
+    liblte_value_2_bits(alloc->mcs, &dci, 5);
+
+    // HARQ process number, FIXME: FDD only
+    liblte_value_2_bits(alloc->harq_process, &dci, 3);
+
+    // New data indicator
+    liblte_value_2_bits(alloc->ndi, &dci, 1);
+
+    // Redundancy version
+    liblte_value_2_bits(alloc->rv_idx, &dci, 2);
+
+    // TPC
+    liblte_value_2_bits(alloc->tpc, &dci, 2);
+
+    // Pad until distinct from format 1A and unambiguous
+    uint32 size = dci - out_bits;
+    while(size == get_dci_1a_size(N_rb_dl) || is_dci_size_ambiguous(size))
+    {
+        size++;
+        liblte_value_2_bits(0, &dci, 1);
+    }
+    *N_out_bits = size;
+
+    // Calculate the TBS
+    alloc->tbs = TBS_71721[get_I_tbs_from_mcs(alloc->mcs)][alloc->N_prb-1];
+
+    return LIBLTE_SUCCESS;
+}
+LIBLTE_ERROR_ENUM dci_1_unpack(uint8                           *in_bits,
+                               uint32                           N_in_bits,
+                               LIBLTE_PHY_DCI_CA_PRESENCE_ENUM  ca_presence,
+                               uint16                           rnti,
+                               uint32                           N_rb_dl,
+                               uint8                            N_ant,
+                               LIBLTE_PHY_ALLOCATION_STRUCT    *alloc)
+{
+    uint8  *dci   = in_bits;
+    uint32  P     = liblte_phy_get_dl_rbg_size(N_rb_dl);
+    uint32  N_rbg = (uint32)ceilf((float)N_rb_dl/P);
+
+    // Carrier indicator
+    if(LIBLTE_PHY_DCI_CA_PRESENT == ca_presence)
+    {
+        liblte_bits_2_value(&dci, 3);
+        printf("WARNING: Not handling carrier indicator\n");
+    }
+
+    // Resource allocation header
+    uint32 ra_type = DCI_RA_TYPE_0;
+    if(N_rb_dl > 10)
+        ra_type = liblte_bits_2_value(&dci, 1);
+
+    // Resource block assignment
+    if(DCI_RA_TYPE_0 == ra_type)
+    {
+        uint32 rbg_bitmap = 0;
+        for(uint32 rbg=0; rbg<N_rbg; rbg++)
+            rbg_bitmap |= liblte_bits_2_value(&dci, 1) << rbg;
+        if(LIBLTE_SUCCESS != liblte_phy_map_dl_rbg_bitmap(rbg_bitmap, N_rb_dl, alloc))
+            return LIBLTE_ERROR_INVALID_CONTENTS;
+    }else{
+        uint32 N_type1 = N_rbg - (uint32)ceilf(logf(P)/logf(2)) - 1;
+        uint32 subset  = liblte_bits_2_value(&dci, (uint32)ceilf(logf(P)/logf(2)));
+        uint32 shift   = liblte_bits_2_value(&dci, 1);
+        uint32 prb[LIBLTE_PHY_N_RB_DL_MAX];
+        uint32 N_prb;
+        if(subset >= P)
+            return LIBLTE_ERROR_INVALID_CONTENTS;
+        get_dl_ra_type_1_prbs(N_rb_dl, subset, shift, prb, &N_prb);
+        alloc->N_prb = 0;
+        for(uint32 i=0; i<N_type1; i++)
+        {
+            if(1 == liblte_bits_2_value(&dci, 1) && i < N_prb && prb[i] < N_rb_dl)
+            {
+                alloc->prb[0][alloc->N_prb] = prb[i];
+                alloc->prb[1][alloc->N_prb] = prb[i];
+                alloc->N_prb++;
+            }
+        }
+    }
+    if(0 == alloc->N_prb)
+        return LIBLTE_ERROR_INVALID_CONTENTS;
+
+    // Extract the rest of the fields
+    alloc->mcs          = liblte_bits_2_value(&dci, 5);
+    alloc->harq_process = liblte_bits_2_value(&dci, 3);
+    alloc->ndi          = liblte_bits_2_value(&dci, 1);
+    alloc->rv_idx       = liblte_bits_2_value(&dci, 2);
+    alloc->tpc          = liblte_bits_2_value(&dci, 2);
+
+    // Fill in the allocation structure 3GPP TS 36.213 v10.3.0 section 7.1.7
+    if(27 < alloc->mcs)
+        return LIBLTE_ERROR_INVALID_CONTENTS;
+    if(alloc->mcs < 10)
+    {
+        alloc->mod_type = LIBLTE_PHY_MODULATION_TYPE_QPSK;
+    }else if(alloc->mcs < 17){
+        alloc->mod_type = LIBLTE_PHY_MODULATION_TYPE_16QAM;
+    }else{
+        alloc->mod_type = LIBLTE_PHY_MODULATION_TYPE_64QAM;
+    }
+    alloc->pre_coder_type = LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY;
+    if(N_ant == 1)
+    {
+        alloc->tx_mode = 1;
+    }else{
+        alloc->tx_mode = 2;
+    }
+    alloc->N_codewords = 1;
+    alloc->tbs         = TBS_71721[get_I_tbs_from_mcs(alloc->mcs)][alloc->N_prb-1];
+    alloc->rnti        = rnti;
+
+    return LIBLTE_SUCCESS;
+}
+
 /*********************************************************************
     Name: dci_1c_pack / dci_1c_unpack
 
@@ -5346,7 +5644,8 @@ LIBLTE_ERROR_ENUM dci_1c_unpack(uint8                        *in_bits,
     Name: get_ulsch_ce
 
     Description: Resolves channel estimates for the uplink shared
-                 channel
+                 channel and estimates the residual timing offset
+                 from the phase slope of the DMRS across subcarriers
 
     Document Reference: N/A
 *********************************************************************/
@@ -5364,11 +5663,20 @@ void get_ulsch_ce(LIBLTE_PHY_STRUCT *phy_struct,
     complex *dmrs_0 = phy_struct->pusch_dmrs_0[N_subfr][N_prb];
     complex *dmrs_1 = phy_struct->pusch_dmrs_1[N_subfr][N_prb];
 
-    float  ce_mag[12];
-    float  ce_ang[12];
-    uint32 M_pusch_sc = N_prb * phy_struct->N_sc_rb_ul;
+    float   ce_mag[12];
+    float   ce_ang[12];
+    complex slope_corr = 0;
+    uint32  M_pusch_sc = N_prb * phy_struct->N_sc_rb_ul;
     for(uint32 i=0; i<M_pusch_sc; i++)
     {
+        // Only correlate subcarriers within the same PRB, as the
+        // allocation need not be contiguous
+        if((i % phy_struct->N_sc_rb_ul) != (phy_struct->N_sc_rb_ul - 1))
+        {
+            slope_corr += (c_est_0[i+1] / dmrs_0[i+1]) * std::conj(c_est_0[i] / dmrs_0[i]);
+            slope_corr += (c_est_1[i+1] / dmrs_1[i+1]) * std::conj(c_est_1[i] / dmrs_1[i]);
+        }
+
         complex tmp = c_est_0[i] / dmrs_0[i];
         float mag_0 = std::abs(tmp);
         float ang_0 = std::arg(tmp);
@@ -5400,13 +5708,17 @@ void get_ulsch_ce(LIBLTE_PHY_STRUCT *phy_struct,
         for(uint32 L=0; L<12; L++)
             c_est[L*M_pusch_sc + i] = complex_polar(ce_mag[L], ce_ang[L]);
     }
+
+    // A delay of d Ts rotates each subcarrier by -2*pi*d/2048
+    phy_struct->pusch_timing_offset = -std::arg(slope_corr) * 2048 / (2 * M_PI);
 }
 
 /*********************************************************************
     Name: get_ulcch_ce
 
     Description: Resolves channel estimates for the uplink control
-                 channel
+                 channel and estimates the residual timing offset
+                 from the phase slope of the DMRS across subcarriers
 
     Document Reference: N/A
 *********************************************************************/
@@ -5432,13 +5744,19 @@ void get_ulcch_ce(LIBLTE_PHY_STRUCT *phy_struct,
         ave_mag_1[i] = 0;
     }
 
-    float tmp_ang_0[LIBLTE_PHY_M_PUCCH_RS][LIBLTE_PHY_N_SC_RB_UL];
-    float tmp_ang_1[LIBLTE_PHY_M_PUCCH_RS][LIBLTE_PHY_N_SC_RB_UL];
+    float   tmp_ang_0[LIBLTE_PHY_M_PUCCH_RS][LIBLTE_PHY_N_SC_RB_UL];
+    float   tmp_ang_1[LIBLTE_PHY_M_PUCCH_RS][LIBLTE_PHY_N_SC_RB_UL];
+    complex slope_corr = 0;
     for(uint32 i=0; i<LIBLTE_PHY_M_PUCCH_RS; i++)
     {
         for(uint32 j=0; j<LIBLTE_PHY_N_SC_RB_UL; j++)
         {
             uint32 idx       = i*LIBLTE_PHY_N_SC_RB_UL + j;
+            if(j != (LIBLTE_PHY_N_SC_RB_UL - 1))
+            {
+                slope_corr += (c_est_0[idx+1] / dmrs_0[idx+1]) * std::conj(c_est_0[idx] / dmrs_0[idx]);
+                slope_corr += (c_est_1[idx+1] / dmrs_1[idx+1]) * std::conj(c_est_1[idx] / dmrs_1[idx]);
+            }
             complex tmp      = c_est_0[idx] / dmrs_0[idx];
             ave_mag_0[j]    += std::abs(tmp) / LIBLTE_PHY_M_PUCCH_RS;
             tmp_ang_0[i][j]  = std::arg(tmp);
@@ -5464,6 +5782,9 @@ void get_ulcch_ce(LIBLTE_PHY_STRUCT *phy_struct,
             c_est[(4+i)*LIBLTE_PHY_N_SC_RB_UL + j] = complex_polar(ave_mag_1[j], ave_ang_1[j]);
         }
     }
+
+    // A delay of d Ts rotates each subcarrier by -2*pi*d/2048
+    phy_struct->pucch_timing_offset = -std::arg(slope_corr) * 2048 / (2 * M_PI);
 }
 
 /*********************************************************************
@@ -5885,7 +6206,7 @@ LIBLTE_ERROR_ENUM liblte_phy_ul_init(LIBLTE_PHY_STRUCT *phy_struct,
     phy_struct->transform_precoding_out = (fftwf_complex *)fftwf_malloc(sizeof(fftwf_complex)*LIBLTE_PHY_N_RB_UL_MAX*LIBLTE_PHY_N_SC_RB_UL);
     for(uint32 i=0; i<phy_struct->N_rb_ul; i++)
     {
-        if((i % 2) == 0 || (i % 3) == 0 || (i % 5) == 0)
+        if(liblte_phy_is_valid_n_prb_for_ul(i, phy_struct->N_rb_ul))
         {
             phy_struct->transform_precoding_plan[i]    = fftwf_plan_dft_1d(i*LIBLTE_PHY_N_SC_RB_UL,
                                                                            phy_struct->transform_precoding_in,
@@ -6062,7 +6383,7 @@ LIBLTE_ERROR_ENUM liblte_phy_ul_cleanup(LIBLTE_PHY_STRUCT *phy_struct)
     // PUSCH
     for(uint32 i=0; i<phy_struct->N_rb_ul; i++)
     {
-        if((i % 2) == 0 || (i % 3) == 0 || (i % 5) == 0)
+        if(liblte_phy_is_valid_n_prb_for_ul(i, phy_struct->N_rb_ul))
         {
             fftwf_destroy_plan(phy_struct->transform_precoding_plan[i]);
             fftwf_destroy_plan(phy_struct->transform_pre_decoding_plan[i]);
@@ -6921,7 +7242,9 @@ LIBLTE_ERROR_ENUM liblte_phy_pdsch_channel_encode(LIBLTE_PHY_STRUCT          *ph
 
     for(uint32 alloc_idx=0; alloc_idx<pdcch->N_dl_alloc; alloc_idx++)
     {
-        if(pdcch->dl_alloc[alloc_idx].chan_type != LIBLTE_PHY_CHAN_TYPE_DLSCH)
+        // Allocations without PRBs only carry a DCI (SPS release)
+        if(pdcch->dl_alloc[alloc_idx].chan_type != LIBLTE_PHY_CHAN_TYPE_DLSCH ||
+           pdcch->dl_alloc[alloc_idx].N_prb     == 0)
             continue;
 
         // Determine the number of bits available for transmission
@@ -7296,13 +7619,51 @@ LIBLTE_ERROR_ENUM liblte_phy_bch_channel_decode(LIBLTE_PHY_STRUCT          *phy_
 *********************************************************************/
 void dci_encode_and_map(LIBLTE_PHY_STRUCT            *phy_struct,
                         uint8                         N_ant,
+                        uint32                        N_cce,
                         LIBLTE_PHY_CHAN_TYPE_ENUM     chan_type,
                         LIBLTE_PHY_ALLOCATION_STRUCT *alloc)
 {
+    // Determine the CCEs, defaulting to aggregation level 4 in the
+    // first free common search space candidate
+    uint32 cce_idx   = alloc->cce_idx;
+    uint32 N_cce_agg = alloc->N_cce_agg;
+    if(0 == N_cce_agg)
+    {
+        N_cce_agg = 4;
+        cce_idx   = N_cce;
+        for(uint32 css_idx=0; css_idx<4 && cce_idx == N_cce; css_idx++)
+        {
+            bool avail = (4*css_idx + 4) <= N_cce;
+            for(uint32 i=0; i<4 && avail; i++)
+                if(phy_struct->pdcch_cce_used[4*css_idx+i])
+                    avail = false;
+            if(avail)
+                cce_idx = 4*css_idx;
+        }
+    }
+    if(8 < N_cce_agg || (cce_idx + N_cce_agg) > N_cce)
+        return;
+    for(uint32 i=0; i<N_cce_agg; i++)
+        if(phy_struct->pdcch_cce_used[cce_idx+i])
+            return;
+
     // Encode the DCI
     uint32 dci_size;
-    if(LIBLTE_PHY_CHAN_TYPE_DLSCH == chan_type)
-    {
+    bool   contiguous = true;
+    for(uint32 i=1; i<alloc->N_prb; i++)
+        if(alloc->prb[0][i] != alloc->prb[0][i-1] + 1)
+            contiguous = false;
+    if(LIBLTE_PHY_CHAN_TYPE_DLSCH == chan_type && !contiguous)
+    {
+        // Non-contiguous allocations need resource allocation type 0 or 1
+        if(LIBLTE_SUCCESS != dci_1_pack(alloc,
+                                        LIBLTE_PHY_DCI_CA_NOT_PRESENT,
+                                        phy_struct->N_rb_dl,
+                                        N_ant,
+                                        phy_struct->pdcch_dci,
+                                        &dci_size))
+            return;
+    }else if(LIBLTE_PHY_CHAN_TYPE_DLSCH == chan_type){
         dci_1a_pack(alloc,
                     LIBLTE_PHY_DCI_CA_NOT_PRESENT,
                     phy_struct->N_rb_dl,
@@ -7317,7 +7678,7 @@ void dci_encode_and_map(LIBLTE_PHY_STRUCT            *phy_struct,
                    phy_struct->pdcch_dci,
                    &dci_size);
     }
-    uint32 N_bits = 288; // Using aggregation level 4 (4*9*4*2 = 288)
+    uint32 N_bits = N_cce_agg*LIBLTE_PHY_PDCCH_N_RE_CCE*2; // QPSK
     dci_channel_encode(phy_struct,
                        phy_struct->pdcch_dci,
                        dci_size,
@@ -7326,119 +7687,41 @@ void dci_encode_and_map(LIBLTE_PHY_STRUCT            *phy_struct,
                        N_bits,
                        phy_struct->pdcch_encode_bits);
 
-// FIXME: User Specific search space does not work
-//    // Add the DCIs to the search space
-//    if(LIBLTE_MAC_SI_RNTI        == alloc->rnti ||
-//       LIBLTE_MAC_P_RNTI         == alloc->rnti ||
-//       (LIBLTE_MAC_RA_RNTI_START <= alloc->rnti &&
-//        LIBLTE_MAC_RA_RNTI_END   >= alloc->rnti))
-//    {
-        // Add to the common search space, using aggregation level of 4
-        for(uint32 css_idx=0; css_idx<4; css_idx++)
-        {
-            if(!phy_struct->pdcch_cce_used[4*css_idx+0] &&
-               !phy_struct->pdcch_cce_used[4*css_idx+1] &&
-               !phy_struct->pdcch_cce_used[4*css_idx+2] &&
-               !phy_struct->pdcch_cce_used[4*css_idx+3])
-            {
-                for(uint32 i=0; i<N_bits; i++)
-                    phy_struct->pdcch_scramb_bits[i] = phy_struct->pdcch_encode_bits[i] ^ phy_struct->pdcch_c[4*css_idx*LIBLTE_PHY_PDCCH_N_REG_CCE*4*2 + i];
-                uint32 M_symb;
-                modulation_mapper(phy_struct->pdcch_scramb_bits,
-                                  N_bits,
-                                  LIBLTE_PHY_MODULATION_TYPE_QPSK,
-                                  phy_struct->pdcch_d,
-                                  &M_symb);
-                uint32 M_layer_symb;
-                layer_mapper_dl(phy_struct->pdcch_d,
-                                M_symb,
-                                N_ant,
-                                1,
-                                LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY,
-                                phy_struct->pdcch_x,
-                                &M_layer_symb);
-                uint32 M_ap_symb;
-                pre_coder_dl(phy_struct->pdcch_x,
-                             M_layer_symb,
-                             N_ant,
-                             LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY,
-                             phy_struct->pdcch_y[0],
-                             576,
-                             &M_ap_symb);
-                for(uint32 p=0; p<N_ant; p++)
-                {
-                    uint32 idx = 0;
-                    for(uint32 i=0; i<4; i++)
-                    {
-                        for(uint32 j=0; j<(4*LIBLTE_PHY_PDCCH_N_REG_CCE); j++)
-                            phy_struct->pdcch_cce[p][4*css_idx+i][j] = phy_struct->pdcch_y[p][idx++];
-                        phy_struct->pdcch_cce_used[4*css_idx+i] = true;
-                    }
-                }
-                break;
-            }
+    // Scramble with the part of the sequence belonging to the first CCE
+    for(uint32 i=0; i<N_bits; i++)
+        phy_struct->pdcch_scramb_bits[i] = phy_struct->pdcch_encode_bits[i] ^ phy_struct->pdcch_c[cce_idx*LIBLTE_PHY_PDCCH_N_RE_CCE*2 + i];
+    uint32 M_symb;
+    modulation_mapper(phy_struct->pdcch_scramb_bits,
+                      N_bits,
+                      LIBLTE_PHY_MODULATION_TYPE_QPSK,
+                      phy_struct->pdcch_d,
+                      &M_symb);
+    uint32 M_layer_symb;
+    layer_mapper_dl(phy_struct->pdcch_d,
+                    M_symb,
+                    N_ant,
+                    1,
+                    LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY,
+                    phy_struct->pdcch_x,
+                    &M_layer_symb);
+    uint32 M_ap_symb;
+    pre_coder_dl(phy_struct->pdcch_x,
+                 M_layer_symb,
+                 N_ant,
+                 LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY,
+                 phy_struct->pdcch_y[0],
+                 576,
+                 &M_ap_symb);
+    for(uint32 p=0; p<N_ant; p++)
+    {
+        uint32 idx = 0;
+        for(uint32 i=0; i<N_cce_agg; i++)
+        {
+            for(uint32 j=0; j<LIBLTE_PHY_PDCCH_N_RE_CCE; j++)
+                phy_struct->pdcch_cce[p][cce_idx+i][j] = phy_struct->pdcch_y[p][idx++];
+            phy_struct->pdcch_cce_used[cce_idx+i] = true;
         }
-// FIXME: User Specific search space does not work
-//    }else{
-//        // Add to the user search space, using aggregation level of 4
-//        uint32 Y_k = pdcch->alloc[a_idx].rnti;
-//        for(uint32 i=0; i<=subframe->num; i++)
-//            Y_k = (39827 * Y_k) % 65537;
-//        for(uint32 uss_idx=0; uss_idx<2; uss_idx++)
-//        {
-//            uint32 actual_idx = 4*((Y_k+uss_idx) % (N_cce_pdcch/4));
-//            if(!phy_struct->pdcch_cce_used[actual_idx+0] &&
-//               !phy_struct->pdcch_cce_used[actual_idx+1] &&
-//               !phy_struct->pdcch_cce_used[actual_idx+2] &&
-//               !phy_struct->pdcch_cce_used[actual_idx+3])
-//            {
-//                for(uint32 i=0; i<N_bits; i++)
-//                    phy_struct->pdcch_scramb_bits[i] = phy_struct->pdcch_encode_bits[i] ^ phy_struct->pdcch_c[4*actual_idx*LIBLTE_PHY_PDCCH_N_REG_CCE*4*2 + i];
-//                uint32 M_symb;
-//                modulation_mapper(phy_struct->pdcch_scramb_bits,
-//                                  N_bits,
-//                                  LIBLTE_PHY_MODULATION_TYPE_QPSK,
-//                                  phy_struct->pdcch_d_re,
-//                                  phy_struct->pdcch_d_im,
-//                                  &M_symb);
-//                uint32 M_layer_symb;
-//                layer_mapper_dl(phy_struct->pdcch_d_re,
-//                                phy_struct->pdcch_d_im,
-//                                M_symb,
-//                                N_ant,
-//                                1,
-//                                LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY,
-//                                phy_struct->pdcch_x_re,
-//                                phy_struct->pdcch_x_im,
-//                                &M_layer_symb);
-//                uint32 M_ap_symb;
-//                pre_coder_dl(phy_struct->pdcch_x_re,
-//                             phy_struct->pdcch_x_im,
-//                             M_layer_symb,
-//                             N_ant,
-//                             LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY,
-//                             phy_struct->pdcch_y_re[0],
-//                             phy_struct->pdcch_y_im[0],
-//                             576,
-//                             &M_ap_symb);
-//                for(uint32 p=0; p<N_ant; p++)
-//                {
-//                    uint32 idx = 0;
-//                    for(uint32 i=0; i<4; i++)
-//                    {
-//                        for(uint32 j=0; j<(4*LIBLTE_PHY_PDCCH_N_REG_CCE); j++)
-//                        {
-//                            phy_struct->pdcch_cce_re[p][actual_idx+i][j] = phy_struct->pdcch_y_re[p][idx];
-//                            phy_struct->pdcch_cce_im[p][actual_idx+i][j] = phy_struct->pdcch_y_im[p][idx];
-//                            idx++;
-//                        }
-//                        phy_struct->pdcch_cce_used[actual_idx+i] = true;
-//                    }
-//                }
-//                break;
-//            }
-//        }
-//    }
+    }
 }
 LIBLTE_ERROR_ENUM liblte_phy_pdcch_channel_encode(LIBLTE_PHY_STRUCT                 *phy_struct,
                                                   LIBLTE_PHY_PCFICH_STRUCT          *pcfich,
@@ -7460,14 +7743,15 @@ LIBLTE_ERROR_ENUM liblte_phy_pdcch_channel_encode(LIBLTE_PHY_STRUCT
     // PHICH
     phich_channel_map(phy_struct, phich, pcfich, N_id_cell, N_ant, phich_res, phich_dur, subframe);
 
-    // PDCCH
-    if(pdcch->N_dl_alloc == 0 && pdcch->N_ul_alloc == 0)
-        return LIBLTE_ERROR_INVALID_INPUTS;
-
     // Calculate number of symbols, 3GPP TS 36.211 v10.1.0 section 6.7
+    // PDSCH needs this even when every allocation is semi-persistent
     pdcch->N_symbs = pcfich->cfi;
     if(phy_struct->N_rb_dl <= 10)
         pdcch->N_symbs++;
+
+    // PDCCH
+    if(pdcch->N_dl_alloc == 0 && pdcch->N_ul_alloc == 0)
+        return LIBLTE_ERROR_INVALID_INPUTS;
     // Calculate resources, 3GPP TS 36.211 v10.1.0 section 6.8.1
     uint32 N_reg_rb    = 3;
     uint32 N_reg_pdcch = pdcch->N_symbs*(phy_struct->N_rb_dl*N_reg_rb) - phy_struct->N_rb_dl - pcfich->N_reg - phich->N_reg;
@@ -7486,19 +7770,21 @@ LIBLTE_ERROR_ENUM liblte_phy_pdcch_channel_encode(LIBLTE_PHY_STRUCT
         }
     }
 
-    // Generate the scrambling sequence
+    // Generate the scrambling sequence, covering every CCE
     uint32 c_init = (subframe->num << 9) + N_id_cell;
-    generate_prs_c(c_init, LIBLTE_PHY_PDCCH_N_BITS_MAX * 2, phy_struct->pdcch_c);
+    generate_prs_c(c_init, N_cce_pdcch*LIBLTE_PHY_PDCCH_N_RE_CCE*2, phy_struct->pdcch_c);
 
     // Add the DCIs
     for(uint32 alloc_idx=0; alloc_idx<pdcch->N_dl_alloc; alloc_idx++)
         dci_encode_and_map(phy_struct,
                            N_ant,
+                           N_cce_pdcch,
                            pdcch->dl_alloc[alloc_idx].chan_type,
                            &pdcch->dl_alloc[alloc_idx]);
     for(uint32 alloc_idx=0; alloc_idx<pdcch->N_ul_alloc; alloc_idx++)
         dci_encode_and_map(phy_struct,
                            N_ant,
+                           N_cce_pdcch,
                            pdcch->ul_alloc[alloc_idx].chan_type,
                            &pdcch->ul_alloc[alloc_idx]);
 
@@ -7844,6 +8130,7 @@ LIBLTE_ERROR_ENUM liblte_phy_pdcch_channel_decode(LIBLTE_PHY_STRUCT
     generate_prs_c(c_init, LIBLTE_PHY_PDCCH_N_BITS_MAX * 2, phy_struct->pdcch_c);
 
     // Determine the size of DCI 1A and 1C FIXME: Clean this up
+    uint32 dci_1_size = get_dci_1_size(phy_struct->N_rb_dl);
     uint32 dci_1a_size;
     uint32 dci_1c_size;
     if(phy_struct->N_rb_dl == 6)
@@ -7954,6 +8241,26 @@ LIBLTE_ERROR_ENUM liblte_phy_pdcch_channel_decode(LIBLTE_PHY_STRUCT
                                                &pdcch->dl_alloc[pdcch->N_dl_alloc]))
                 pdcch->N_dl_alloc++;
         }
+        if(pdcch->N_dl_alloc  <  LIBLTE_PHY_PDCCH_MAX_ALLOC &&
+           LIBLTE_SUCCESS    == dci_channel_decode(phy_struct,
+                                                   phy_struct->pdcch_descramb_bits,
+                                                   N_bits,
+                                                   61,
+                                                   10,
+                                                   0,
+                                                   phy_struct->pdcch_dci,
+                                                   dci_1_size,
+                                                   &rnti))
+        {
+            if(LIBLTE_SUCCESS == dci_1_unpack(phy_struct->pdcch_dci,
+                                              dci_1_size,
+                                              LIBLTE_PHY_DCI_CA_NOT_PRESENT,
+                                              rnti,
+                                              phy_struct->N_rb_dl,
+                                              N_ant,
+                                              &pdcch->dl_alloc[pdcch->N_dl_alloc]))
+                pdcch->N_dl_alloc++;
+        }
         if(pdcch->N_dl_alloc  <  LIBLTE_PHY_PDCCH_MAX_ALLOC &&
            (LIBLTE_SUCCESS   == dci_channel_decode(phy_struct,
                                                    phy_struct->pdcch_descramb_bits,
@@ -9074,6 +9381,82 @@ LIBLTE_ERROR_ENUM liblte_phy_get_tbs_and_n_prb_for_dl(uint32  N_bits,
     return LIBLTE_SUCCESS;
 }
 
+/*********************************************************************
+    Name: liblte_phy_get_tbs_for_dl
+
+    Description: Determines the transport block size for a specific
+                 number of PRBs and modulation and coding scheme
+
+    Document Reference: 3GPP TS 36.213 v10.3.0 section 7.1.7
+*********************************************************************/
+LIBLTE_ERROR_ENUM liblte_phy_get_tbs_for_dl(uint8   mcs,
+                                            uint32  N_prb,
+                                            uint32 *tbs)
+{
+    if(tbs == NULL || mcs > 28 || N_prb == 0 || N_prb > LIBLTE_PHY_N_RB_DL_MAX)
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    *tbs = TBS_71721[get_I_tbs_from_mcs(mcs)][N_prb-1];
+
+    return LIBLTE_SUCCESS;
+}
+
+/*********************************************************************
+    Name: liblte_phy_get_dl_rbg_size
+
+    Description: Determines the resource block group size used by DL
+                 resource allocation types 0 and 1
+
+    Document Reference: 3GPP TS 36.213 v10.3.0 section 7.1.6.1
+*********************************************************************/
+uint32 liblte_phy_get_dl_rbg_size(uint32 N_rb_dl)
+{
+    if(N_rb_dl <= 10)
+        return 1;
+    if(N_rb_dl <= 26)
+        return 2;
+    if(N_rb_dl <= 63)
+        return 3;
+    return 4;
+}
+
+/*********************************************************************
+    Name: liblte_phy_map_dl_rbg_bitmap
+
+    Description: Converts a DL resource allocation type 0 RBG bitmap
+                 into the PRBs of an allocation
+
+    Document Reference: 3GPP TS 36.213 v10.3.0 section 7.1.6.1
+*********************************************************************/
+LIBLTE_ERROR_ENUM liblte_phy_map_dl_rbg_bitmap(uint32                        rbg_bitmap,
+                                               uint32                        N_rb_dl,
+                                               LIBLTE_PHY_ALLOCATION_STRUCT *alloc)
+{
+    if(alloc == NULL || N_rb_dl > LIBLTE_PHY_N_RB_DL_MAX)
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    uint32 P     = liblte_phy_get_dl_rbg_size(N_rb_dl);
+    uint32 N_rbg = (N_rb_dl + P - 1)/P;
+    if(0 != (rbg_bitmap >> N_rbg))
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    // PRBs are listed in increasing order, as the RE mapper expects
+    alloc->N_prb = 0;
+    for(uint32 rbg=0; rbg<N_rbg; rbg++)
+    {
+        if(0 == ((rbg_bitmap >> rbg) & 1))
+            continue;
+        for(uint32 i=rbg*P; i<(rbg+1)*P && i<N_rb_dl; i++)
+        {
+            alloc->prb[0][alloc->N_prb] = i;
+            alloc->prb[1][alloc->N_prb] = i;
+            alloc->N_prb++;
+        }
+    }
+
+    return LIBLTE_SUCCESS;
+}
+
 /*********************************************************************
     Name: liblte_phy_get_tbs_mcs_and_n_prb_for_ul
 
@@ -9102,9 +9485,7 @@ LIBLTE_ERROR_ENUM liblte_phy_get_tbs_mcs_and_n_prb_for_ul(uint32  N_bits,
         {
             if(N_bits <= TBS_71721[i][j])
             {
-                if(((j + 1) % 2) == 0 ||
-                   ((j + 1) % 3) == 0 ||
-                   ((j + 1) % 5) == 0)
+                if(liblte_phy_is_valid_n_prb_for_ul(j + 1, LIBLTE_PHY_N_RB_UL_MAX))
                 {
                     I_tbs  = i;
                     *tbs   = TBS_71721[i][j];
@@ -9152,9 +9533,7 @@ LIBLTE_ERROR_ENUM liblte_phy_get_tbs_and_n_prb_for_ul(uint32  N_bits,
     // Determine N_prb
     for(uint32 i=0; i<N_rb_ul; i++)
         if(N_bits <= TBS_71721[I_tbs][i])
-            if(((i + 1) % 2) == 0 ||
-               ((i + 1) % 3) == 0 ||
-               ((i + 1) % 5) == 0)
+            if(liblte_phy_is_valid_n_prb_for_ul(i + 1, LIBLTE_PHY_N_RB_UL_MAX))
             {
                 *tbs   = TBS_71721[I_tbs][i];
                 *N_prb = i + 1;
@@ -9163,6 +9542,56 @@ LIBLTE_ERROR_ENUM liblte_phy_get_tbs_and_n_prb_for_ul(uint32  N_bits,
     return LIBLTE_ERROR_INVALID_INPUTS;
 }
 
+/*********************************************************************
+    Name: liblte_phy_get_tbs_for_ul
+
+    Description: Determines the transport block size for a specific
+                 number of PRBs and modulation and coding scheme
+
+    Document Reference: 3GPP TS 36.213 v10.3.0 section 8.6.1
+                        3GPP TS 36.211 v10.1.0 section 5.3.3
+*********************************************************************/
+LIBLTE_ERROR_ENUM liblte_phy_get_tbs_for_ul(uint8   mcs,
+                                            uint32  N_prb,
+                                            uint32 *tbs)
+{
+    if(tbs == NULL || mcs > 28 || N_prb == 0 || N_prb > LIBLTE_PHY_N_RB_UL_MAX)
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    if(!liblte_phy_is_valid_n_prb_for_ul(N_prb, LIBLTE_PHY_N_RB_UL_MAX))
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    *tbs = TBS_71721[get_I_tbs_from_mcs(mcs)][N_prb-1];
+
+    return LIBLTE_SUCCESS;
+}
+
+/*********************************************************************
+    Name: liblte_phy_is_valid_n_prb_for_ul
+
+    Description: Checks that a number of PRBs can be used for a PUSCH
+                 allocation, M_sc_pusch must be 2^a * 3^b * 5^c and
+                 a PHY set up for N_rb_ul only has transform precoding
+                 plans for fewer than N_rb_ul PRBs.
+
+    Document Reference: 3GPP TS 36.211 v10.1.0 section 5.3.3
+*********************************************************************/
+bool liblte_phy_is_valid_n_prb_for_ul(uint32 N_prb,
+                                      uint32 N_rb_ul)
+{
+    if(N_prb == 0 || N_prb >= N_rb_ul)
+        return false;
+
+    uint32 N = N_prb;
+    while((N % 2) == 0)
+        N /= 2;
+    while((N % 3) == 0)
+        N /= 3;
+    while((N % 5) == 0)
+        N /= 5;
+    return (N == 1);
+}
+
 /*********************************************************************
     Name: liblte_phy_get_n_cce
 
@@ -9192,6 +9621,68 @@ LIBLTE_ERROR_ENUM liblte_phy_get_n_cce(LIBLTE_PHY_STRUCT *phy_struct,
     return LIBLTE_SUCCESS;
 }
 
+/*********************************************************************
+    Name: liblte_phy_get_pdcch_candidates
+
+    Description: Determines the first control channel element of each
+                 PDCCH candidate in either the common or the UE
+                 specific search space
+
+    Document Reference: 3GPP TS 36.213 v10.3.0 section 9.1.1
+*********************************************************************/
+LIBLTE_ERROR_ENUM liblte_phy_get_pdcch_candidates(uint16  rnti,
+                                                  uint32  subfr_num,
+                                                  uint32  N_cce,
+                                                  uint32  N_cce_agg,
+                                                  bool    common,
+                                                  uint32 *cce_idx,
+                                                  uint32 *N_cand)
+{
+    if(cce_idx   == NULL ||
+       N_cand    == NULL ||
+       subfr_num >  9)
+        return LIBLTE_ERROR_INVALID_INPUTS;
+
+    // Number of candidates, 36.213 table 9.1.1-1
+    uint32 M;
+    uint32 Y_k = 0;
+    switch(N_cce_agg)
+    {
+    case 1:
+    case 2:
+        M = 6;
+        break;
+    case 4:
+    case 8:
+        M = common ? 16/N_cce_agg : 2;
+        break;
+    default:
+        return LIBLTE_ERROR_INVALID_INPUTS;
+    }
+    if(common)
+    {
+        if(N_cce_agg < 4)
+            return LIBLTE_ERROR_INVALID_INPUTS;
+        if(N_cce > 16)
+            N_cce = 16;
+    }else{
+        Y_k = rnti;
+        for(uint32 i=0; i<=subfr_num; i++)
+            Y_k = (39827 * Y_k) % 65537;
+    }
+
+    // Candidates wrap around in small control regions, only keep
+    // distinct ones
+    uint32 N_pos = N_cce/N_cce_agg;
+    if(M > N_pos)
+        M = N_pos;
+    for(uint32 m=0; m<M; m++)
+        cce_idx[m] = N_cce_agg*((Y_k + m) % N_pos);
+    *N_cand = M;
+
+    return LIBLTE_SUCCESS;
+}
+
 /*********************************************************************
     Name: liblte_phy_add_to_tti
 
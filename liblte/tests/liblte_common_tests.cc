@@ -86,6 +86,66 @@ int v2b_b2v_random_test()
     return 0;
 }
 
+int byte_buf_prepend_strip_test()
+{
+    LIBLTE_BYTE_BUF_STRUCT  buf;
+    uint8                   data[4] = {0xA5, 0x5A, 0xC3, 0x3C};
+    uint8                  *hdr;
+    uint8                  *payload;
+
+    liblte_byte_buf_init(&buf);
+    if(LIBLTE_SUCCESS != liblte_byte_buf_append(&buf, data, 4))
+        return -1;
+    payload = liblte_byte_buf_data(&buf);
+    if(LIBLTE_SUCCESS != liblte_byte_buf_prepend(&buf, 2, &hdr))
+        return -1;
+    if(hdr != payload-2 || hdr != liblte_byte_buf_data(&buf) || 6 != buf.N_bytes)
+        return -1;
+    if(0 != memcmp(&hdr[2], data, 4))
+        return -1;
+    if(LIBLTE_SUCCESS != liblte_byte_buf_strip(&buf, 2))
+        return -1;
+    if(payload != liblte_byte_buf_data(&buf) || 4 != buf.N_bytes)
+        return -1;
+    if(LIBLTE_SUCCESS == liblte_byte_buf_strip(&buf, 5))
+        return -1;
+    if(LIBLTE_SUCCESS == liblte_byte_buf_prepend(&buf, LIBLTE_BYTE_BUF_HEADROOM+1, &hdr))
+        return -1;
+    if(LIBLTE_SUCCESS != liblte_byte_buf_prepend(&buf, LIBLTE_BYTE_BUF_HEADROOM, &hdr))
+        return -1;
+    if(hdr != &buf.buf[0])
+        return -1;
+
+    return 0;
+}
+
+int byte_buf_tailroom_test()
+{
+    LIBLTE_BYTE_BUF_STRUCT buf;
+    uint8                  data[LIBLTE_BYTE_BUF_TAILROOM+1];
+
+    memset(data, 0, sizeof(data));
+    liblte_byte_buf_init(&buf);
+    if(LIBLTE_MAX_MSG_SIZE+LIBLTE_BYTE_BUF_TAILROOM != liblte_byte_buf_tailroom(&buf))
+        return -1;
+    buf.N_bytes = LIBLTE_MAX_MSG_SIZE;
+    if(LIBLTE_SUCCESS == liblte_byte_buf_append(&buf, data, LIBLTE_BYTE_BUF_TAILROOM+1))
+        return -1;
+    if(LIBLTE_SUCCESS != liblte_byte_buf_append(&buf, data, LIBLTE_BYTE_BUF_TAILROOM))
+        return -1;
+    if(0 != liblte_byte_buf_tailroom(&buf))
+        return -1;
+
+    // A buffer backed for a 4 byte payload only has its own tailroom
+    liblte_byte_buf_init_sized(&buf, LIBLTE_BYTE_BUF_HEADROOM+4+LIBLTE_BYTE_BUF_TAILROOM);
+    if(4+LIBLTE_BYTE_BUF_TAILROOM != liblte_byte_buf_tailroom(&buf))
+        return -1;
+    if(LIBLTE_SUCCESS == liblte_byte_buf_append(&buf, data, 5+LIBLTE_BYTE_BUF_TAILROOM))
+        return -1;
+
+    return 0;
+}
+
 int main(int argc, char *argv[])
 {
     printf("v2b_single_bit_test: ");
@@ -96,5 +156,13 @@ int main(int argc, char *argv[])
     if(0 != v2b_b2v_random_test())
         exit(-1);
     printf("pass\n");
+    printf("byte_buf_prepend_strip_test: ");
+    if(0 != byte_buf_prepend_strip_test())
+        exit(-1);
+    printf("pass\n");
+    printf("byte_buf_tailroom_test: ");
+    if(0 != byte_buf_tailroom_test())
+        exit(-1);
+    printf("pass\n");
     exit(0);
 }
@@ -72,6 +72,14 @@ int truncated_bsr_test(void)
         return -1;
     if(t_bsr.lcg_id != 1 || t_bsr.max_buffer_size != 4677 || t_bsr.min_buffer_size != 3995)
         return -1;
+    t_bsr.max_buffer_size = 0;
+    t_bsr.min_buffer_size = 0;
+    ce_ptr                = msg.msg;
+    if(LIBLTE_SUCCESS != liblte_mac_pack_truncated_bsr_ce(&t_bsr, &ce_ptr))
+        return -1;
+    ce_ptr = msg.msg;
+    if(1 != liblte_bits_2_value(&ce_ptr, 2) || 0 != liblte_bits_2_value(&ce_ptr, 6))
+        return -1;
     return 0;
 }
 
@@ -95,6 +103,14 @@ int short_bsr_test(void)
         return -1;
     if(s_bsr.lcg_id != 1 || s_bsr.max_buffer_size != 4677 || s_bsr.min_buffer_size != 3995)
         return -1;
+    s_bsr.max_buffer_size = 0;
+    s_bsr.min_buffer_size = 0;
+    ce_ptr                = msg.msg;
+    if(LIBLTE_SUCCESS != liblte_mac_pack_short_bsr_ce(&s_bsr, &ce_ptr))
+        return -1;
+    ce_ptr = msg.msg;
+    if(1 != liblte_bits_2_value(&ce_ptr, 2) || 0 != liblte_bits_2_value(&ce_ptr, 6))
+        return -1;
     return 0;
 }
 
@@ -127,6 +143,21 @@ int long_bsr_test(void)
        l_bsr.max_buffer_size_2 != 58255 || l_bsr.min_buffer_size_2 != 49759 ||
        l_bsr.max_buffer_size_3 != 17 || l_bsr.min_buffer_size_3 != 14)
         return -1;
+    l_bsr.max_buffer_size_0 = 4676;
+    l_bsr.min_buffer_size_0 = 3996;
+    l_bsr.max_buffer_size_1 = 0;
+    l_bsr.min_buffer_size_1 = 0;
+    l_bsr.max_buffer_size_2 = 58250;
+    l_bsr.min_buffer_size_2 = 49760;
+    l_bsr.max_buffer_size_3 = 16;
+    l_bsr.min_buffer_size_3 = 15;
+    ce_ptr                  = msg.msg;
+    if(LIBLTE_SUCCESS != liblte_mac_pack_long_bsr_ce(&l_bsr, &ce_ptr))
+        return -1;
+    ce_ptr = msg.msg;
+    if(40 != liblte_bits_2_value(&ce_ptr, 6) || 0 != liblte_bits_2_value(&ce_ptr, 6) ||
+       56 != liblte_bits_2_value(&ce_ptr, 6) || 4 != liblte_bits_2_value(&ce_ptr, 6))
+        return -1;
     return 0;
 }
 
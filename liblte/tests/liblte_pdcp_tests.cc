@@ -223,12 +223,39 @@ int dpls_format_2_test(void)
     return 0;
 }
 
+int dpls_format_3_test(void)
+{
+    LIBLTE_BYTE_BUF_STRUCT  buf;
+    uint8                  *payload;
+    uint8                  *pdu;
+    uint8                   data[2] = {0xA5, 0x5A};
+    uint32                  count;
+    liblte_byte_buf_init(&buf);
+    liblte_byte_buf_append(&buf, data, 2);
+    payload = liblte_byte_buf_data(&buf);
+    if(LIBLTE_SUCCESS != liblte_pdcp_pack_data_pdu_with_long_sn(0xABC, &buf))
+        return -1;
+    pdu = liblte_byte_buf_data(&buf);
+    if(4 != buf.N_bytes || pdu != payload-2)
+        return -1;
+    if(0x8A != pdu[0] || 0xBC != pdu[1] || 0xA5 != pdu[2] || 0x5A != pdu[3])
+        return -1;
+    if(LIBLTE_SUCCESS != liblte_pdcp_unpack_data_pdu_with_long_sn(&buf, &count))
+        return -1;
+    if(count != 0xABC || buf.N_bytes != 2 || liblte_byte_buf_data(&buf) != payload ||
+       payload[0] != 0xA5 || payload[1] != 0x5A)
+        return -1;
+    return 0;
+}
+
 int data_pdu_with_long_sn_test(void)
 {
     if(0 != dpls_format_1_test())
         return -1;
     if(0 != dpls_format_2_test())
         return -1;
+    if(0 != dpls_format_3_test())
+        return -1;
     return 0;
 }
 
@@ -277,12 +304,39 @@ int dpss_format_2_test(void)
     return 0;
 }
 
+int dpss_format_3_test(void)
+{
+    LIBLTE_BYTE_BUF_STRUCT  buf;
+    uint8                  *payload;
+    uint8                  *pdu;
+    uint8                   data[2] = {0xA5, 0x5A};
+    uint32                  count;
+    liblte_byte_buf_init(&buf);
+    liblte_byte_buf_append(&buf, data, 2);
+    payload = liblte_byte_buf_data(&buf);
+    if(LIBLTE_SUCCESS != liblte_pdcp_pack_data_pdu_with_short_sn(0x5A, &buf))
+        return -1;
+    pdu = liblte_byte_buf_data(&buf);
+    if(3 != buf.N_bytes || pdu != payload-1)
+        return -1;
+    if(0xDA != pdu[0] || 0xA5 != pdu[1] || 0x5A != pdu[2])
+        return -1;
+    if(LIBLTE_SUCCESS != liblte_pdcp_unpack_data_pdu_with_short_sn(&buf, &count))
+        return -1;
+    if(count != 0x5A || buf.N_bytes != 2 || liblte_byte_buf_data(&buf) != payload ||
+       payload[0] != 0xA5 || payload[1] != 0x5A)
+        return -1;
+    return 0;
+}
+
 int data_pdu_with_short_sn_test(void)
 {
     if(0 != dpss_format_1_test())
         return -1;
     if(0 != dpss_format_2_test())
         return -1;
+    if(0 != dpss_format_3_test())
+        return -1;
     return 0;
 }
 
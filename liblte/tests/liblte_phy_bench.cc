@@ -0,0 +1,692 @@
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: liblte_phy_bench.cc
+
+    Description: Micro-benchmarks for the LTE PHY library kernels.  Every
+                 kernel is run on synthetic data for each bandwidth (and
+                 MCS where applicable) and the throughput and latency
+                 percentiles are reported as JSON.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "liblte_phy.h"
+#include "liblte_mac.h"
+#include "EUTRA_RRC_Definitions.h"
+#include <algorithm>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+#define N_ID_CELL 7
+#define N_UL_ANT 1
+#define N_DL_ANT 1
+#define N_TURBO_ITERATIONS 1
+#define DEFAULT_N_ITERATIONS 100
+#define N_PDCCH_SYMBS 2
+#define N_SOFT 250368 // Category 1 UE (3GPP TS 36.306)
+#define M_DL_HARQ 8
+#define CRC24A 0x01864CFB
+#define N_SYMB_PER_SLOT 7 // Normal CP
+// Largest TBS that fits in the 5 code blocks of LIBLTE_PHY_C_BITS_STRUCT
+#define MAX_TBS (5*(LIBLTE_PHY_MAX_CODE_BLOCK_SIZE-24) - 24)
+// Coded bit capacity of the PDSCH and PUSCH scratch buffers
+#define MAX_PDSCH_CODED_BITS 10000
+#define MAX_PUSCH_CODED_BITS 28800
+// Conservative REs per PRB with N_PDCCH_SYMBS control symbols
+#define N_PDSCH_RE_PER_PRB ((N_SYMB_PER_SLOT*2 - N_PDCCH_SYMBS)*LIBLTE_PHY_N_SC_RB_DL_NORMAL_CP)
+#define N_PUSCH_RE_PER_PRB ((N_SYMB_PER_SLOT-1)*2*LIBLTE_PHY_N_SC_RB_UL)
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+typedef struct{
+    const char         *name;
+    LIBLTE_PHY_FS_ENUM  fs;
+    uint32              N_rb;
+}BENCH_BW_STRUCT;
+
+typedef struct{
+    FILE   *out;
+    uint32  N_iterations;
+    uint32  N_results;
+}BENCH_CTX_STRUCT;
+
+/*******************************************************************************
+                              GLOBAL VARIABLES
+*******************************************************************************/
+
+// Kernels and tables internal to liblte_phy.cc
+extern uint32 TBS_71721[27][110];
+uint32 get_I_tbs_from_mcs(uint8 mcs);
+void calc_crc(uint8 *a_bits, uint32 N_a_bits, uint32 crc, uint8 *p_bits, uint32 N_p_bits);
+void conv_encode(LIBLTE_PHY_STRUCT *phy_struct, uint8 *c_bits, uint32 N_c_bits, uint32 constraint_len,
+                 uint32 rate, uint32 *g, bool tail_bit, uint8 *d_bits, uint32 *N_d_bits);
+void viterbi_decode(LIBLTE_PHY_STRUCT *phy_struct, float *d_bits, uint32 N_d_bits, uint32 constraint_len,
+                    uint32 rate, uint32 *g, uint8 *c_bits, uint32 *N_c_bits);
+void turbo_encode(LIBLTE_PHY_STRUCT *phy_struct, uint8 *c_bits, uint32 N_c_bits, uint32 N_fill_bits,
+                  uint8 *d_bits, uint32 *N_d_bits);
+void turbo_decode(LIBLTE_PHY_STRUCT *phy_struct, float *d_bits, uint32 N_d_bits, uint32 N_fill_bits,
+                  uint32 N_iterations, uint8 *c_bits, uint32 *N_c_bits);
+
+static const BENCH_BW_STRUCT bw_list[] = {{"1.4", LIBLTE_PHY_FS_1_92MHZ,  LIBLTE_PHY_N_RB_DL_1_4MHZ},
+                                          {"3",   LIBLTE_PHY_FS_3_84MHZ,  LIBLTE_PHY_N_RB_DL_3MHZ},
+                                          {"5",   LIBLTE_PHY_FS_7_68MHZ,  LIBLTE_PHY_N_RB_DL_5MHZ},
+                                          {"10",  LIBLTE_PHY_FS_15_36MHZ, LIBLTE_PHY_N_RB_DL_10MHZ},
+                                          {"15",  LIBLTE_PHY_FS_30_72MHZ, LIBLTE_PHY_N_RB_DL_15MHZ},
+                                          {"20",  LIBLTE_PHY_FS_30_72MHZ, LIBLTE_PHY_N_RB_DL_20MHZ}};
+static const uint32 N_bw = sizeof(bw_list)/sizeof(bw_list[0]);
+// Valid turbo interleaver sizes (3GPP TS 36.212 v10.1.0 table 5.1.3-3)
+static const uint32 turbo_k_list[] = {40, 512, 1024, 3072, 6144};
+static const uint32 N_turbo_k      = sizeof(turbo_k_list)/sizeof(turbo_k_list[0]);
+// DCI and BCH payload sizes plus their CRC
+static const uint32 conv_k_list[] = {40, 57, 64};
+static const uint32 N_conv_k      = sizeof(conv_k_list)/sizeof(conv_k_list[0]);
+static const uint32 crc_k_list[]  = {40, 1024, 6144, 30720};
+static const uint32 N_crc_k       = sizeof(crc_k_list)/sizeof(crc_k_list[0]);
+
+static complex samp_buf[LIBLTE_PHY_N_SAMPS_PER_FRAME_30_72MHZ];
+static uint8   tx_bits[LIBLTE_PHY_BASE_CODING_RATE*LIBLTE_PHY_MAX_CODE_BLOCK_SIZE*5];
+static uint8   tx_bits2[LIBLTE_PHY_BASE_CODING_RATE*LIBLTE_PHY_MAX_CODE_BLOCK_SIZE*5];
+static float   rx_bits[LIBLTE_PHY_BASE_CODING_RATE*LIBLTE_PHY_MAX_CODE_BLOCK_SIZE*5];
+static float   rx_bits2[LIBLTE_PHY_BASE_CODING_RATE*LIBLTE_PHY_MAX_CODE_BLOCK_SIZE*5];
+
+/*******************************************************************************
+                              FUNCTIONS
+*******************************************************************************/
+
+static uint64 now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64)ts.tv_sec*1000000000ULL + ts.tv_nsec;
+}
+
+static double percentile(std::vector<double> &sorted, double pct)
+{
+    uint32 idx = (uint32)ceil(pct/100.0*sorted.size());
+    if(idx > 0)
+        idx--;
+    return sorted[std::min(idx, (uint32)sorted.size()-1)];
+}
+
+static LIBLTE_PHY_MODULATION_TYPE_ENUM dl_mod_type(uint8 mcs)
+{
+    // 3GPP TS 36.213 v10.3.0 table 7.1.7.1-1
+    if(mcs <= 9)
+        return LIBLTE_PHY_MODULATION_TYPE_QPSK;
+    if(mcs <= 16)
+        return LIBLTE_PHY_MODULATION_TYPE_16QAM;
+    return LIBLTE_PHY_MODULATION_TYPE_64QAM;
+}
+
+static LIBLTE_PHY_MODULATION_TYPE_ENUM ul_mod_type(uint8 mcs)
+{
+    // 3GPP TS 36.213 v10.3.0 table 8.6.1-1
+    if(mcs <= 10)
+        return LIBLTE_PHY_MODULATION_TYPE_QPSK;
+    if(mcs <= 20)
+        return LIBLTE_PHY_MODULATION_TYPE_16QAM;
+    return LIBLTE_PHY_MODULATION_TYPE_64QAM;
+}
+
+static uint32 ul_I_tbs(uint8 mcs)
+{
+    // 3GPP TS 36.213 v10.3.0 table 8.6.1-1
+    if(mcs <= 10)
+        return mcs;
+    if(mcs <= 20)
+        return mcs - 1;
+    return mcs - 2;
+}
+
+// Largest allocation that fits the bandwidth, the code block limit and
+// the coded bit scratch buffers of the library, UL allocations also need
+// a transform precoding plan
+static uint32 get_n_prb(uint32 N_rb, uint32 I_tbs, uint32 Q_m, uint32 N_re_per_prb, uint32 max_coded_bits, bool ul)
+{
+    for(uint32 N_prb=N_rb; N_prb>0; N_prb--)
+    {
+        if(ul && !liblte_phy_is_valid_n_prb_for_ul(N_prb, N_rb))
+            continue;
+        if(TBS_71721[I_tbs][N_prb-1] <= MAX_TBS &&
+           N_prb*N_re_per_prb*Q_m    <= max_coded_bits)
+            return N_prb;
+    }
+    return 0;
+}
+
+static void fill_random_bits(uint8 *bits, uint32 N_bits)
+{
+    for(uint32 i=0; i<N_bits; i++)
+        bits[i] = rand() & 1;
+}
+
+static void bits_to_soft(uint8 *bits, uint32 N_bits, float *soft)
+{
+    for(uint32 i=0; i<N_bits; i++)
+        soft[i] = 127*(1 - 2*(float)bits[i]);
+}
+
+static void fill_alloc(LIBLTE_PHY_ALLOCATION_STRUCT    *alloc,
+                       LIBLTE_PHY_CHAN_TYPE_ENUM        chan_type,
+                       LIBLTE_PHY_MODULATION_TYPE_ENUM  mod_type,
+                       uint8                            mcs,
+                       uint32                           tbs,
+                       uint32                           N_prb)
+{
+    alloc->msg[0].N_bits = tbs;
+    fill_random_bits(alloc->msg[0].msg, tbs);
+    alloc->pre_coder_type  = LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY;
+    alloc->mod_type        = mod_type;
+    alloc->chan_type       = chan_type;
+    alloc->tbs             = tbs;
+    alloc->rv_idx          = 0;
+    alloc->N_prb           = N_prb;
+    for(uint32 i=0; i<N_prb; i++)
+    {
+        alloc->prb[0][i] = i;
+        alloc->prb[1][i] = i;
+    }
+    alloc->N_codewords     = 1;
+    alloc->N_layers        = 1;
+    alloc->tx_mode         = 1;
+    alloc->harq_retx_count = 0;
+    alloc->N_cce_agg       = 0;
+    alloc->rnti            = 61;
+    alloc->mcs             = mcs;
+    alloc->tpc             = 0;
+    alloc->harq_process    = 0;
+    alloc->ndi             = true;
+    alloc->dl_alloc        = (LIBLTE_PHY_CHAN_TYPE_DLSCH == chan_type);
+}
+
+static void report(BENCH_CTX_STRUCT    *ctx,
+                   const char          *kernel,
+                   const char          *bw,
+                   uint32               N_rb,
+                   int32                mcs,
+                   uint32               N_prb,
+                   uint32               N_bits,
+                   uint32               N_errors,
+                   std::vector<double> &lat_us)
+{
+    std::sort(lat_us.begin(), lat_us.end());
+    double total_us = 0;
+    for(uint32 i=0; i<lat_us.size(); i++)
+        total_us += lat_us[i];
+    double mean_us = total_us/lat_us.size();
+
+    fprintf(ctx->out, "%s\n    {\"kernel\": \"%s\", ", (0 == ctx->N_results) ? "" : ",", kernel);
+    if(NULL != bw)
+        fprintf(ctx->out, "\"bw_mhz\": %s, \"n_rb\": %u, ", bw, N_rb);
+    if(mcs >= 0)
+        fprintf(ctx->out, "\"mcs\": %d, \"n_prb\": %u, ", mcs, N_prb);
+    fprintf(ctx->out, "\"bits\": %u, \"iterations\": %u, \"errors\": %u, ", N_bits, (uint32)lat_us.size(), N_errors);
+    fprintf(ctx->out, "\"ops_per_sec\": %.1f, \"mbps\": %.3f, ", 1e6/mean_us, N_bits/mean_us);
+    fprintf(ctx->out, "\"latency_us\": {\"min\": %.2f, \"mean\": %.2f, \"p50\": %.2f, \"p90\": %.2f, \"p99\": %.2f, \"max\": %.2f}}",
+            lat_us.front(), mean_us, percentile(lat_us, 50), percentile(lat_us, 90),
+            percentile(lat_us, 99), lat_us.back());
+    fflush(ctx->out);
+    ctx->N_results++;
+}
+
+/*********************************************************************
+    Name: bench_pdsch
+
+    Description: PDSCH encode, OFDM modulate, OFDM demodulate with
+                 channel estimation and PDSCH decode for every DL MCS
+*********************************************************************/
+static void bench_pdsch(BENCH_CTX_STRUCT      *ctx,
+                        LIBLTE_PHY_STRUCT     *phy_struct,
+                        const BENCH_BW_STRUCT *bw)
+{
+    LIBLTE_PHY_SUBFRAME_STRUCT *subframe = (LIBLTE_PHY_SUBFRAME_STRUCT *)malloc(sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
+    LIBLTE_PHY_PDCCH_STRUCT    *pdcch    = (LIBLTE_PHY_PDCCH_STRUCT *)malloc(sizeof(LIBLTE_PHY_PDCCH_STRUCT));
+    LIBLTE_BIT_MSG_STRUCT      *msg      = (LIBLTE_BIT_MSG_STRUCT *)malloc(sizeof(LIBLTE_BIT_MSG_STRUCT));
+
+    for(uint8 mcs=0; mcs<=28; mcs++)
+    {
+        LIBLTE_PHY_MODULATION_TYPE_ENUM mod_type = dl_mod_type(mcs);
+        uint32                          I_tbs    = get_I_tbs_from_mcs(mcs);
+        uint32                          N_prb    = get_n_prb(bw->N_rb, I_tbs, liblte_phy_modulation_type_to_q_m[mod_type],
+                                                             N_PDSCH_RE_PER_PRB, MAX_PDSCH_CODED_BITS, false);
+        if(0 == N_prb)
+            continue;
+        uint32 tbs = TBS_71721[I_tbs][N_prb-1];
+
+        pdcch->N_symbs    = N_PDCCH_SYMBS;
+        pdcch->N_dl_alloc = 1;
+        pdcch->N_ul_alloc = 0;
+        fill_alloc(&pdcch->dl_alloc[0], LIBLTE_PHY_CHAN_TYPE_DLSCH, mod_type, mcs, tbs, N_prb);
+
+        std::vector<double> enc_us, mod_us, demod_us, dec_us;
+        uint32              N_errors = 0;
+        for(uint32 i=0; i<ctx->N_iterations; i++)
+        {
+            memset((void*)subframe, 0, sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
+            subframe->num = 1;
+            liblte_phy_map_crs(phy_struct, subframe, N_ID_CELL, N_DL_ANT);
+
+            uint64 t0 = now_ns();
+            liblte_phy_pdsch_channel_encode(phy_struct, pdcch, N_ID_CELL, N_DL_ANT, subframe);
+            uint64 t1 = now_ns();
+            liblte_phy_create_dl_subframe(phy_struct, subframe, 0, samp_buf);
+            uint64 t2 = now_ns();
+            liblte_phy_get_dl_subframe_and_ce(phy_struct, samp_buf, 0, subframe->num, N_ID_CELL, N_DL_ANT, subframe);
+            uint64 t3 = now_ns();
+            if(LIBLTE_SUCCESS != liblte_phy_pdsch_channel_decode(phy_struct, subframe, &pdcch->dl_alloc[0],
+                                                                 pdcch->N_symbs, N_ID_CELL, N_DL_ANT,
+                                                                 N_TURBO_ITERATIONS, msg->msg, &msg->N_bits))
+                N_errors++;
+            uint64 t4 = now_ns();
+
+            enc_us.push_back((t1 - t0)/1000.0);
+            mod_us.push_back((t2 - t1)/1000.0);
+            demod_us.push_back((t3 - t2)/1000.0);
+            dec_us.push_back((t4 - t3)/1000.0);
+        }
+        report(ctx, "pdsch_encode", bw->name, bw->N_rb, mcs, N_prb, tbs, 0, enc_us);
+        report(ctx, "pdsch_decode", bw->name, bw->N_rb, mcs, N_prb, tbs, N_errors, dec_us);
+        if(0 == mcs)
+        {
+            // OFDM does not depend on MCS
+            report(ctx, "dl_ofdm_mod", bw->name, bw->N_rb, -1, 0, 0, 0, mod_us);
+            report(ctx, "dl_ofdm_demod_and_ce", bw->name, bw->N_rb, -1, 0, 0, 0, demod_us);
+        }
+    }
+
+    free(msg);
+    free(pdcch);
+    free(subframe);
+}
+
+/*********************************************************************
+    Name: bench_pusch
+
+    Description: PUSCH encode, SC-FDMA modulate, SC-FDMA demodulate
+                 and PUSCH decode (including channel estimation) for
+                 every UL MCS
+*********************************************************************/
+static void bench_pusch(BENCH_CTX_STRUCT      *ctx,
+                        LIBLTE_PHY_STRUCT     *phy_struct,
+                        const BENCH_BW_STRUCT *bw)
+{
+    LIBLTE_PHY_SUBFRAME_STRUCT   *subframe = (LIBLTE_PHY_SUBFRAME_STRUCT *)malloc(sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
+    LIBLTE_PHY_ALLOCATION_STRUCT *alloc    = (LIBLTE_PHY_ALLOCATION_STRUCT *)malloc(sizeof(LIBLTE_PHY_ALLOCATION_STRUCT));
+    LIBLTE_BIT_MSG_STRUCT        *msg      = (LIBLTE_BIT_MSG_STRUCT *)malloc(sizeof(LIBLTE_BIT_MSG_STRUCT));
+
+    for(uint8 mcs=0; mcs<=28; mcs++)
+    {
+        LIBLTE_PHY_MODULATION_TYPE_ENUM mod_type = ul_mod_type(mcs);
+        uint32                          I_tbs    = ul_I_tbs(mcs);
+        uint32                          N_prb    = get_n_prb(bw->N_rb, I_tbs, liblte_phy_modulation_type_to_q_m[mod_type],
+                                                             N_PUSCH_RE_PER_PRB, MAX_PUSCH_CODED_BITS, true);
+        if(0 == N_prb)
+            continue;
+        uint32 tbs = TBS_71721[I_tbs][N_prb-1];
+
+        fill_alloc(alloc, LIBLTE_PHY_CHAN_TYPE_ULSCH, mod_type, mcs, tbs, N_prb);
+
+        std::vector<double> enc_us, mod_us, demod_us, dec_us;
+        uint32              N_errors = 0;
+        for(uint32 i=0; i<ctx->N_iterations; i++)
+        {
+            memset((void*)subframe, 0, sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
+            subframe->num = 1;
+
+            uint64 t0 = now_ns();
+            liblte_phy_pusch_channel_encode(phy_struct, alloc, N_ID_CELL, N_UL_ANT, subframe);
+            uint64 t1 = now_ns();
+            liblte_phy_create_ul_subframe(phy_struct, subframe, 0, samp_buf);
+            uint64 t2 = now_ns();
+            liblte_phy_get_ul_subframe(phy_struct, samp_buf, subframe);
+            uint64 t3 = now_ns();
+            if(LIBLTE_SUCCESS != liblte_phy_pusch_channel_decode(phy_struct, subframe, alloc, N_ID_CELL, N_UL_ANT,
+                                                                 N_TURBO_ITERATIONS, msg->msg, &msg->N_bits))
+                N_errors++;
+            uint64 t4 = now_ns();
+
+            enc_us.push_back((t1 - t0)/1000.0);
+            mod_us.push_back((t2 - t1)/1000.0);
+            demod_us.push_back((t3 - t2)/1000.0);
+            dec_us.push_back((t4 - t3)/1000.0);
+        }
+        report(ctx, "pusch_encode", bw->name, bw->N_rb, mcs, N_prb, tbs, 0, enc_us);
+        report(ctx, "pusch_decode", bw->name, bw->N_rb, mcs, N_prb, tbs, N_errors, dec_us);
+        if(0 == mcs)
+        {
+            report(ctx, "ul_ofdm_mod", bw->name, bw->N_rb, -1, 0, 0, 0, mod_us);
+            report(ctx, "ul_ofdm_demod", bw->name, bw->N_rb, -1, 0, 0, 0, demod_us);
+        }
+    }
+
+    free(msg);
+    free(alloc);
+    free(subframe);
+}
+
+/*********************************************************************
+    Name: bench_pdcch
+
+    Description: PCFICH/PHICH/PDCCH encode and blind decode of a
+                 single SI-RNTI DCI 1A
+*********************************************************************/
+static void bench_pdcch(BENCH_CTX_STRUCT      *ctx,
+                        LIBLTE_PHY_STRUCT     *phy_struct,
+                        const BENCH_BW_STRUCT *bw)
+{
+    LIBLTE_PHY_SUBFRAME_STRUCT *subframe = (LIBLTE_PHY_SUBFRAME_STRUCT *)malloc(sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
+    LIBLTE_PHY_PDCCH_STRUCT    *pdcch    = (LIBLTE_PHY_PDCCH_STRUCT *)malloc(sizeof(LIBLTE_PHY_PDCCH_STRUCT));
+    LIBLTE_PHY_PDCCH_STRUCT    *rx_pdcch = (LIBLTE_PHY_PDCCH_STRUCT *)malloc(sizeof(LIBLTE_PHY_PDCCH_STRUCT));
+    LIBLTE_PHY_PCFICH_STRUCT    pcfich;
+    LIBLTE_PHY_PHICH_STRUCT     phich;
+    std::vector<double>         enc_us, dec_us;
+    uint32                      N_errors = 0;
+
+    for(uint32 i=0; i<25; i++)
+        for(uint32 j=0; j<8; j++)
+            phich.present[i][j] = false;
+    pcfich.cfi        = N_PDCCH_SYMBS;
+    pdcch->N_symbs    = N_PDCCH_SYMBS;
+    pdcch->N_dl_alloc = 1;
+    pdcch->N_ul_alloc = 0;
+    fill_alloc(&pdcch->dl_alloc[0], LIBLTE_PHY_CHAN_TYPE_DLSCH, LIBLTE_PHY_MODULATION_TYPE_QPSK, 0, 208,
+               std::min(bw->N_rb, (uint32)8));
+    pdcch->dl_alloc[0].rnti     = LIBLTE_MAC_SI_RNTI;
+    pdcch->dl_alloc[0].dl_alloc = false;
+
+    for(uint32 i=0; i<ctx->N_iterations; i++)
+    {
+        memset((void*)subframe, 0, sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
+        subframe->num = 0;
+        liblte_phy_map_crs(phy_struct, subframe, N_ID_CELL, N_DL_ANT);
+
+        uint64 t0 = now_ns();
+        liblte_phy_pdcch_channel_encode(phy_struct, &pcfich, &phich, pdcch, N_ID_CELL, N_DL_ANT, 1.0,
+                                        PHICH_Config::k_phich_Duration_normal, subframe);
+        uint64 t1 = now_ns();
+        liblte_phy_create_dl_subframe(phy_struct, subframe, 0, samp_buf);
+        liblte_phy_get_dl_subframe_and_ce(phy_struct, samp_buf, 0, subframe->num, N_ID_CELL, N_DL_ANT, subframe);
+        uint64 t2 = now_ns();
+        if(LIBLTE_SUCCESS != liblte_phy_pdcch_channel_decode(phy_struct, subframe, N_ID_CELL, N_DL_ANT, 1.0,
+                                                             PHICH_Config::k_phich_Duration_normal,
+                                                             &pcfich, &phich, rx_pdcch) ||
+           0 == rx_pdcch->N_dl_alloc)
+            N_errors++;
+        uint64 t3 = now_ns();
+
+        enc_us.push_back((t1 - t0)/1000.0);
+        dec_us.push_back((t3 - t2)/1000.0);
+    }
+    report(ctx, "pdcch_encode", bw->name, bw->N_rb, -1, 0, 0, 0, enc_us);
+    report(ctx, "pdcch_blind_decode", bw->name, bw->N_rb, -1, 0, 0, N_errors, dec_us);
+
+    free(rx_pdcch);
+    free(pdcch);
+    free(subframe);
+}
+
+/*********************************************************************
+    Name: bench_pss_sss
+
+    Description: PSS search with fine timing and SSS search over a
+                 synthetic subframe 0
+*********************************************************************/
+static void bench_pss_sss(BENCH_CTX_STRUCT      *ctx,
+                          LIBLTE_PHY_STRUCT     *phy_struct,
+                          const BENCH_BW_STRUCT *bw)
+{
+    LIBLTE_PHY_SUBFRAME_STRUCT *subframe = (LIBLTE_PHY_SUBFRAME_STRUCT *)malloc(sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
+    std::vector<double>         pss_us, sss_us;
+    uint32                      N_errors = 0;
+
+    // The PSS search looks through 12 slots, so build a full frame
+    for(uint32 i=0; i<LIBLTE_PHY_N_SUBFR_PER_FRAME; i++)
+    {
+        memset((void*)subframe, 0, sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
+        subframe->num = i;
+        if(0 == i || 5 == i)
+        {
+            liblte_phy_map_pss(phy_struct, subframe, N_ID_CELL%3, N_DL_ANT);
+            liblte_phy_map_sss(phy_struct, subframe, (N_ID_CELL - (N_ID_CELL%3))/3, N_ID_CELL%3, N_DL_ANT);
+        }
+        liblte_phy_create_dl_subframe(phy_struct, subframe, 0, &samp_buf[i*phy_struct->N_samps_per_subfr]);
+    }
+
+    for(uint32 i=0; i<ctx->N_iterations; i++)
+    {
+        uint32 symb_starts[N_SYMB_PER_SLOT];
+        uint32 N_id_2;
+        uint32 pss_symb;
+        float  pss_thresh;
+        float  freq_offset;
+        uint32 N_id_1;
+        uint32 fr_start_idx;
+        for(uint32 j=0; j<N_SYMB_PER_SLOT; j++)
+            symb_starts[j] = (0 == j) ? 0 : (j*phy_struct->N_samps_per_symb + phy_struct->N_samps_cp_l_0 +
+                                             (j-1)*phy_struct->N_samps_cp_l_else);
+
+        uint64 t0 = now_ns();
+        liblte_phy_find_pss_and_fine_timing(phy_struct, samp_buf, symb_starts, &N_id_2, &pss_symb,
+                                            &pss_thresh, &freq_offset);
+        uint64 t1 = now_ns();
+        for(uint32 j=0; j<N_SYMB_PER_SLOT; j++)
+            symb_starts[j] = (0 == j) ? 0 : (j*phy_struct->N_samps_per_symb + phy_struct->N_samps_cp_l_0 +
+                                             (j-1)*phy_struct->N_samps_cp_l_else);
+        uint64 t2 = now_ns();
+        if(LIBLTE_SUCCESS != liblte_phy_find_sss(phy_struct, samp_buf, N_id_2, symb_starts, pss_thresh/2,
+                                                 &N_id_1, &fr_start_idx) ||
+           N_id_2 != N_ID_CELL%3                                           ||
+           N_id_1 != (N_ID_CELL - (N_ID_CELL%3))/3)
+            N_errors++;
+        uint64 t3 = now_ns();
+
+        pss_us.push_back((t1 - t0)/1000.0);
+        sss_us.push_back((t3 - t2)/1000.0);
+    }
+    report(ctx, "pss_search", bw->name, bw->N_rb, -1, 0, 0, 0, pss_us);
+    report(ctx, "sss_search", bw->name, bw->N_rb, -1, 0, 0, N_errors, sss_us);
+
+    free(subframe);
+}
+
+/*********************************************************************
+    Name: bench_coding
+
+    Description: Bandwidth independent channel coding kernels: CRC,
+                 turbo encode/decode, turbo rate match/unmatch and
+                 tail biting convolutional encode/Viterbi decode
+*********************************************************************/
+static void bench_coding(BENCH_CTX_STRUCT  *ctx,
+                         LIBLTE_PHY_STRUCT *phy_struct)
+{
+    uint8 p_bits[24];
+
+    for(uint32 k=0; k<N_crc_k; k++)
+    {
+        std::vector<double> crc_us;
+        fill_random_bits(tx_bits, crc_k_list[k]);
+        for(uint32 i=0; i<ctx->N_iterations; i++)
+        {
+            uint64 t0 = now_ns();
+            calc_crc(tx_bits, crc_k_list[k], CRC24A, p_bits, 24);
+            crc_us.push_back((now_ns() - t0)/1000.0);
+        }
+        report(ctx, "crc24a", NULL, 0, -1, 0, crc_k_list[k], 0, crc_us);
+    }
+
+    for(uint32 k=0; k<N_turbo_k; k++)
+    {
+        std::vector<double> enc_us, dec_us, rm_us, rum_us;
+        uint32              K        = turbo_k_list[k];
+        uint32              N_e_bits = 2*K; // Rate 1/2 after rate matching
+        uint32              N_errors = 0;
+        uint32              N_d_bits;
+        uint32              N_c_bits;
+        fill_random_bits(tx_bits, K);
+        for(uint32 i=0; i<ctx->N_iterations; i++)
+        {
+            uint64 t0 = now_ns();
+            turbo_encode(phy_struct, tx_bits, K, 0, tx_bits2, &N_d_bits);
+            uint64 t1 = now_ns();
+            liblte_phy_rate_match_turbo(phy_struct, tx_bits2, N_d_bits, 1, 1, N_SOFT, M_DL_HARQ,
+                                        LIBLTE_PHY_CHAN_TYPE_DLSCH, 0, N_e_bits, phy_struct->dlsch_e.tx_bits[0]);
+            uint64 t2 = now_ns();
+            bits_to_soft(phy_struct->dlsch_e.tx_bits[0], N_e_bits, rx_bits);
+            uint64 t3 = now_ns();
+            liblte_phy_rate_unmatch_turbo(phy_struct, rx_bits, N_e_bits, tx_bits2, N_d_bits/3, 1, 1, N_SOFT,
+                                          M_DL_HARQ, LIBLTE_PHY_CHAN_TYPE_DLSCH, 0, rx_bits2, &N_d_bits);
+            uint64 t4 = now_ns();
+            turbo_decode(phy_struct, rx_bits2, N_d_bits, 0, N_TURBO_ITERATIONS, tx_bits2, &N_c_bits);
+            uint64 t5 = now_ns();
+            if(0 != memcmp(tx_bits, tx_bits2, K))
+                N_errors++;
+
+            enc_us.push_back((t1 - t0)/1000.0);
+            rm_us.push_back((t2 - t1)/1000.0);
+            rum_us.push_back((t4 - t3)/1000.0);
+            dec_us.push_back((t5 - t4)/1000.0);
+        }
+        report(ctx, "turbo_encode", NULL, 0, -1, 0, K, 0, enc_us);
+        report(ctx, "turbo_rate_match", NULL, 0, -1, 0, K, 0, rm_us);
+        report(ctx, "turbo_rate_unmatch", NULL, 0, -1, 0, K, 0, rum_us);
+        report(ctx, "turbo_decode", NULL, 0, -1, 0, K, N_errors, dec_us);
+    }
+
+    for(uint32 k=0; k<N_conv_k; k++)
+    {
+        std::vector<double> enc_us, dec_us;
+        uint32              K        = conv_k_list[k];
+        uint32              g[3]     = {0133, 0171, 0165};
+        uint32              N_errors = 0;
+        uint32              N_d_bits;
+        uint32              N_c_bits;
+        fill_random_bits(tx_bits, K);
+        for(uint32 i=0; i<ctx->N_iterations; i++)
+        {
+            uint64 t0 = now_ns();
+            conv_encode(phy_struct, tx_bits, K, 7, 3, g, true, tx_bits2, &N_d_bits);
+            uint64 t1 = now_ns();
+            bits_to_soft(tx_bits2, N_d_bits, rx_bits);
+            uint64 t2 = now_ns();
+            viterbi_decode(phy_struct, rx_bits, N_d_bits, 7, 3, g, tx_bits2, &N_c_bits);
+            uint64 t3 = now_ns();
+            if(N_c_bits != K || 0 != memcmp(tx_bits, tx_bits2, K))
+                N_errors++;
+
+            enc_us.push_back((t1 - t0)/1000.0);
+            dec_us.push_back((t3 - t2)/1000.0);
+        }
+        report(ctx, "conv_encode", NULL, 0, -1, 0, K, 0, enc_us);
+        report(ctx, "viterbi_decode", NULL, 0, -1, 0, K, N_errors, dec_us);
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [-n iterations] [-b bandwidth_mhz] [-o output.json]\n", name);
+}
+
+int main(int argc, char *argv[])
+{
+    BENCH_CTX_STRUCT  ctx;
+    const char       *bw_filter = NULL;
+    const char       *out_name  = NULL;
+    int               opt;
+
+    ctx.out          = stdout;
+    ctx.N_iterations = DEFAULT_N_ITERATIONS;
+    ctx.N_results    = 0;
+    while(-1 != (opt = getopt(argc, argv, "n:b:o:h")))
+    {
+        switch(opt)
+        {
+        case 'n':
+            ctx.N_iterations = atoi(optarg);
+            break;
+        case 'b':
+            bw_filter = optarg;
+            break;
+        case 'o':
+            out_name = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            exit(-1);
+        }
+    }
+    if(0 == ctx.N_iterations)
+    {
+        usage(argv[0]);
+        exit(-1);
+    }
+    if(NULL != out_name)
+    {
+        ctx.out = fopen(out_name, "w");
+        if(NULL == ctx.out)
+        {
+            fprintf(stderr, "Unable to open %s\n", out_name);
+            exit(-1);
+        }
+    }
+    srand(1);
+
+    fprintf(ctx.out, "{\"bench\": \"liblte_phy\", \"iterations\": %u, \"turbo_iterations\": %u, \"results\": [",
+            ctx.N_iterations, N_TURBO_ITERATIONS);
+    for(uint32 b=0; b<N_bw; b++)
+    {
+        LIBLTE_PHY_STRUCT *phy_struct = NULL;
+        if(NULL != bw_filter && 0 != strcmp(bw_filter, bw_list[b].name))
+            continue;
+        if(LIBLTE_SUCCESS != liblte_phy_init(&phy_struct, bw_list[b].fs, N_ID_CELL, N_DL_ANT, bw_list[b].N_rb,
+                                             LIBLTE_PHY_N_SC_RB_DL_NORMAL_CP, 1) ||
+           LIBLTE_SUCCESS != liblte_phy_ul_init(phy_struct, N_ID_CELL, 0, 0, 1, false, 0, false, false,
+                                                0, 0, 0, 0))
+        {
+            fprintf(stderr, "Unable to initialize PHY for %s MHz\n", bw_list[b].name);
+            exit(-1);
+        }
+        if(0 == ctx.N_results)
+            bench_coding(&ctx, phy_struct);
+        bench_pss_sss(&ctx, phy_struct, &bw_list[b]);
+        bench_pdcch(&ctx, phy_struct, &bw_list[b]);
+        bench_pdsch(&ctx, phy_struct, &bw_list[b]);
+        bench_pusch(&ctx, phy_struct, &bw_list[b]);
+        liblte_phy_ul_cleanup(phy_struct);
+        liblte_phy_cleanup(phy_struct);
+    }
+    fprintf(ctx.out, "\n]}\n");
+
+    if(stdout != ctx.out)
+        fclose(ctx.out);
+    return 0;
+}
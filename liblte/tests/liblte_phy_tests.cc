@@ -1138,6 +1138,19 @@ int pusch_channel_encode_decode_test(LIBLTE_PHY_STRUCT *phy_struct)
     for(uint32 i=0; i<alloc.msg[0].N_bits; i++)
         if(msg.msg[i] != alloc.msg[0].msg[i])
             return -1;
+    if(fabs(phy_struct->pusch_timing_offset) > 1)
+        return -1;
+    // Delay by 2 samples (8 Ts at 7.68MHz) and check the estimate
+    for(uint32 i=0; i<phy_struct->N_samps_per_subfr; i++)
+        samp_buf2[i] = (i < 2) ? complex(0,0) : samp_buf[i-2];
+    if(LIBLTE_SUCCESS != liblte_phy_get_ul_subframe(phy_struct, samp_buf2, subframe))
+        return -1;
+    if(LIBLTE_SUCCESS != liblte_phy_pusch_channel_decode(phy_struct, subframe, &alloc,
+                                                         N_ID_CELL, N_UL_ANT, 1,
+                                                         msg.msg, &msg.N_bits))
+        return -1;
+    if(fabs(phy_struct->pusch_timing_offset - 8) > 1)
+        return -1;
     free(subframe);
     return 0;
 }
@@ -1735,6 +1748,7 @@ int pdcch_channel_encode_decode_test(LIBLTE_PHY_STRUCT *phy_struct)
     pdcch.dl_alloc[0].N_layers = 1;
     pdcch.dl_alloc[0].tx_mode = 1;
     pdcch.dl_alloc[0].harq_retx_count = 0;
+    pdcch.dl_alloc[0].N_cce_agg = 0;
     pdcch.dl_alloc[0].rnti = LIBLTE_MAC_SI_RNTI;
     pdcch.dl_alloc[0].mcs = 0;
     pdcch.dl_alloc[0].tpc = 0;
@@ -1797,6 +1811,202 @@ int pdcch_channel_encode_decode_test(LIBLTE_PHY_STRUCT *phy_struct)
     return 0;
 }
 
+int dl_ra_type_0_1_test(LIBLTE_PHY_STRUCT *phy_struct)
+{
+    if(1 != liblte_phy_get_dl_rbg_size(LIBLTE_PHY_N_RB_DL_1_4MHZ) ||
+       2 != liblte_phy_get_dl_rbg_size(LIBLTE_PHY_N_RB_DL_5MHZ) ||
+       3 != liblte_phy_get_dl_rbg_size(LIBLTE_PHY_N_RB_DL_10MHZ) ||
+       4 != liblte_phy_get_dl_rbg_size(LIBLTE_PHY_N_RB_DL_20MHZ))
+        return -1;
+    LIBLTE_PHY_ALLOCATION_STRUCT alloc;
+    if(LIBLTE_SUCCESS != liblte_phy_map_dl_rbg_bitmap(0x1005, LIBLTE_PHY_N_RB_DL_5MHZ, &alloc))
+        return -1;
+    uint32 type_0_prbs[5] = {0, 1, 4, 5, 24};
+    if(alloc.N_prb != 5)
+        return -1;
+    for(uint32 i=0; i<5; i++)
+        if(alloc.prb[0][i] != type_0_prbs[i] || alloc.prb[1][i] != type_0_prbs[i])
+            return -1;
+    if(LIBLTE_ERROR_INVALID_INPUTS != liblte_phy_map_dl_rbg_bitmap(0x2000, LIBLTE_PHY_N_RB_DL_5MHZ, &alloc))
+        return -1;
+    uint32 tbs;
+    if(LIBLTE_SUCCESS != liblte_phy_get_tbs_for_dl(14, 6, &tbs) || tbs != 1544)
+        return -1;
+
+    // Type 0 (whole RBGs) and type 1 (PRBs from RBG subset 0) through the PDCCH
+    uint32 type_1_prbs[3] = {0, 4, 9};
+    for(uint32 type=0; type<2; type++)
+    {
+        uint32 *prbs  = (0 == type) ? type_0_prbs : type_1_prbs;
+        uint32  N_prb = (0 == type) ? 5 : 3;
+        LIBLTE_PHY_PCFICH_STRUCT pcfich;
+        pcfich.cfi = 2;
+        LIBLTE_PHY_PHICH_STRUCT phich;
+        for(uint32 i=0; i<25; i++)
+            for(uint32 j=0; j<8; j++)
+                phich.present[i][j] = false;
+        LIBLTE_PHY_PDCCH_STRUCT pdcch;
+        pdcch.N_symbs = 2;
+        pdcch.N_dl_alloc = 1;
+        pdcch.N_ul_alloc = 0;
+        pdcch.dl_alloc[0].pre_coder_type = LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY;
+        pdcch.dl_alloc[0].mod_type = LIBLTE_PHY_MODULATION_TYPE_QPSK;
+        pdcch.dl_alloc[0].chan_type = LIBLTE_PHY_CHAN_TYPE_DLSCH;
+        pdcch.dl_alloc[0].rv_idx = 1;
+        pdcch.dl_alloc[0].N_prb = N_prb;
+        for(uint32 i=0; i<N_prb; i++)
+        {
+            pdcch.dl_alloc[0].prb[0][i] = prbs[i];
+            pdcch.dl_alloc[0].prb[1][i] = prbs[i];
+        }
+        pdcch.dl_alloc[0].N_codewords = 1;
+        pdcch.dl_alloc[0].N_layers = 1;
+        pdcch.dl_alloc[0].tx_mode = 1;
+        pdcch.dl_alloc[0].harq_retx_count = 0;
+        pdcch.dl_alloc[0].N_cce_agg = 0;
+        pdcch.dl_alloc[0].rnti = 61;
+        pdcch.dl_alloc[0].mcs = 11;
+        pdcch.dl_alloc[0].tpc = 1;
+        pdcch.dl_alloc[0].harq_process = 5;
+        pdcch.dl_alloc[0].ndi = true;
+        pdcch.dl_alloc[0].dl_alloc = true;
+        LIBLTE_PHY_SUBFRAME_STRUCT *subframe = (LIBLTE_PHY_SUBFRAME_STRUCT *)malloc(sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
+        memset((void*)subframe, 0, sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
+        subframe->num = 0;
+        if(LIBLTE_SUCCESS != liblte_phy_map_crs(phy_struct, subframe, N_ID_CELL, N_DL_ANT))
+            return -1;
+        if(LIBLTE_SUCCESS != liblte_phy_pdcch_channel_encode(phy_struct, &pcfich, &phich,
+                                                             &pdcch, N_ID_CELL, N_DL_ANT, 1.0,
+                                                             PHICH_Config::k_phich_Duration_normal,
+                                                             subframe))
+            return -1;
+        if(LIBLTE_SUCCESS != liblte_phy_create_dl_subframe(phy_struct, subframe, 0, samp_buf))
+            return -1;
+        if(LIBLTE_SUCCESS != liblte_phy_get_dl_subframe_and_ce(phy_struct, samp_buf, 0,
+                                                               subframe->num, N_ID_CELL,
+                                                               N_DL_ANT, subframe))
+            return -1;
+        if(LIBLTE_SUCCESS != liblte_phy_pdcch_channel_decode(phy_struct, subframe, N_ID_CELL,
+                                                             N_DL_ANT, 1.0,
+                                                             PHICH_Config::k_phich_Duration_normal,
+                                                             &pcfich, &phich, &pdcch))
+            return -1;
+        free(subframe);
+        if(LIBLTE_SUCCESS != liblte_phy_get_tbs_for_dl(11, N_prb, &tbs))
+            return -1;
+        if(pdcch.N_dl_alloc != 1 || pdcch.dl_alloc[0].rnti != 61 ||
+           pdcch.dl_alloc[0].mcs != 11 || pdcch.dl_alloc[0].harq_process != 5 ||
+           !pdcch.dl_alloc[0].ndi || pdcch.dl_alloc[0].rv_idx != 1 ||
+           pdcch.dl_alloc[0].mod_type != LIBLTE_PHY_MODULATION_TYPE_16QAM ||
+           pdcch.dl_alloc[0].N_prb != N_prb ||
+           pdcch.dl_alloc[0].tbs != tbs)
+            return -1;
+        for(uint32 i=0; i<N_prb; i++)
+            if(pdcch.dl_alloc[0].prb[0][i] != prbs[i] || pdcch.dl_alloc[0].prb[1][i] != prbs[i])
+                return -1;
+    }
+    return 0;
+}
+
+int pdcch_candidates_test(LIBLTE_PHY_STRUCT *phy_struct)
+{
+    // UE specific search space hashing
+    uint32 cce_idx[LIBLTE_PHY_PDCCH_N_CANDIDATES_MAX];
+    uint32 N_cand;
+    uint32 uss_l1[6] = {6, 7, 8, 9, 10, 11};
+    if(LIBLTE_SUCCESS != liblte_phy_get_pdcch_candidates(61, 0, 12, 1, false, cce_idx, &N_cand) ||
+       N_cand != 6)
+        return -1;
+    for(uint32 i=0; i<N_cand; i++)
+        if(cce_idx[i] != uss_l1[i])
+            return -1;
+    uint32 uss_l2[6] = {12, 14, 16, 18, 0, 2};
+    if(LIBLTE_SUCCESS != liblte_phy_get_pdcch_candidates(61, 3, 20, 2, false, cce_idx, &N_cand) ||
+       N_cand != 6)
+        return -1;
+    for(uint32 i=0; i<N_cand; i++)
+        if(cce_idx[i] != uss_l2[i])
+            return -1;
+    if(LIBLTE_SUCCESS != liblte_phy_get_pdcch_candidates(61, 3, 20, 4, false, cce_idx, &N_cand) ||
+       N_cand != 2 || cce_idx[0] != 4 || cce_idx[1] != 8)
+        return -1;
+    if(LIBLTE_SUCCESS != liblte_phy_get_pdcch_candidates(61, 0, 12, 8, false, cce_idx, &N_cand) ||
+       N_cand != 1 || cce_idx[0] != 0)
+        return -1;
+
+    // Common search space
+    if(LIBLTE_SUCCESS != liblte_phy_get_pdcch_candidates(0, 0, 20, 4, true, cce_idx, &N_cand) ||
+       N_cand != 4 || cce_idx[0] != 0 || cce_idx[1] != 4 || cce_idx[2] != 8 || cce_idx[3] != 12)
+        return -1;
+    if(LIBLTE_ERROR_INVALID_INPUTS != liblte_phy_get_pdcch_candidates(0, 0, 20, 2, true, cce_idx, &N_cand) ||
+       LIBLTE_ERROR_INVALID_INPUTS != liblte_phy_get_pdcch_candidates(61, 0, 20, 3, false, cce_idx, &N_cand))
+        return -1;
+
+    // A DCI placed on the second common search space candidate
+    LIBLTE_PHY_PCFICH_STRUCT pcfich;
+    pcfich.cfi = 2;
+    LIBLTE_PHY_PHICH_STRUCT phich;
+    for(uint32 i=0; i<25; i++)
+        for(uint32 j=0; j<8; j++)
+            phich.present[i][j] = false;
+    LIBLTE_PHY_PDCCH_STRUCT pdcch;
+    pdcch.N_symbs = 2;
+    pdcch.N_dl_alloc = 1;
+    pdcch.N_ul_alloc = 0;
+    pdcch.dl_alloc[0].pre_coder_type = LIBLTE_PHY_PRE_CODER_TYPE_TX_DIVERSITY;
+    pdcch.dl_alloc[0].mod_type = LIBLTE_PHY_MODULATION_TYPE_QPSK;
+    pdcch.dl_alloc[0].chan_type = LIBLTE_PHY_CHAN_TYPE_DLSCH;
+    pdcch.dl_alloc[0].tbs = 208;
+    pdcch.dl_alloc[0].rv_idx = 0;
+    pdcch.dl_alloc[0].N_prb = 8;
+    for(uint32 i=0; i<8; i++)
+    {
+        pdcch.dl_alloc[0].prb[0][i] = i;
+        pdcch.dl_alloc[0].prb[1][i] = i;
+    }
+    pdcch.dl_alloc[0].N_codewords = 1;
+    pdcch.dl_alloc[0].N_layers = 1;
+    pdcch.dl_alloc[0].tx_mode = 1;
+    pdcch.dl_alloc[0].harq_retx_count = 0;
+    pdcch.dl_alloc[0].N_cce_agg = 4;
+    pdcch.dl_alloc[0].cce_idx = 4;
+    pdcch.dl_alloc[0].rnti = LIBLTE_MAC_SI_RNTI;
+    pdcch.dl_alloc[0].mcs = 0;
+    pdcch.dl_alloc[0].tpc = 0;
+    pdcch.dl_alloc[0].harq_process = 0;
+    pdcch.dl_alloc[0].ndi = true;
+    pdcch.dl_alloc[0].dl_alloc = false;
+    LIBLTE_PHY_SUBFRAME_STRUCT *subframe = (LIBLTE_PHY_SUBFRAME_STRUCT *)malloc(sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
+    memset((void*)subframe, 0, sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
+    subframe->num = 0;
+    if(LIBLTE_SUCCESS != liblte_phy_map_crs(phy_struct, subframe, N_ID_CELL, N_DL_ANT))
+        return -1;
+    if(LIBLTE_SUCCESS != liblte_phy_pdcch_channel_encode(phy_struct, &pcfich, &phich,
+                                                         &pdcch, N_ID_CELL, N_DL_ANT, 1.0,
+                                                         PHICH_Config::k_phich_Duration_normal,
+                                                         subframe))
+        return -1;
+    if(phy_struct->pdcch_cce_used[0] || !phy_struct->pdcch_cce_used[4] ||
+       !phy_struct->pdcch_cce_used[7] || phy_struct->pdcch_cce_used[8])
+        return -1;
+    if(LIBLTE_SUCCESS != liblte_phy_create_dl_subframe(phy_struct, subframe, 0, samp_buf))
+        return -1;
+    if(LIBLTE_SUCCESS != liblte_phy_get_dl_subframe_and_ce(phy_struct, samp_buf, 0,
+                                                           subframe->num, N_ID_CELL,
+                                                           N_DL_ANT, subframe))
+        return -1;
+    if(LIBLTE_SUCCESS != liblte_phy_pdcch_channel_decode(phy_struct, subframe, N_ID_CELL,
+                                                         N_DL_ANT, 1.0,
+                                                         PHICH_Config::k_phich_Duration_normal,
+                                                         &pcfich, &phich, &pdcch))
+        return -1;
+    free(subframe);
+    if(pdcch.N_dl_alloc != 1 || pdcch.dl_alloc[0].rnti != LIBLTE_MAC_SI_RNTI ||
+       pdcch.dl_alloc[0].N_prb != 8)
+        return -1;
+    return 0;
+}
+
 int pss_sss_test(LIBLTE_PHY_STRUCT *phy_struct)
 {
     LIBLTE_PHY_SUBFRAME_STRUCT *subframe = (LIBLTE_PHY_SUBFRAME_STRUCT *)malloc(sizeof(LIBLTE_PHY_SUBFRAME_STRUCT));
@@ -1953,6 +2163,14 @@ int gets_test(LIBLTE_PHY_STRUCT *phy_struct)
         return -1;
     if(tbs != 1544 || N_prb != 6)
         return -1;
+    if(!liblte_phy_is_valid_n_prb_for_ul(1, LIBLTE_PHY_N_RB_UL_5MHZ)                                    ||
+       !liblte_phy_is_valid_n_prb_for_ul(24, LIBLTE_PHY_N_RB_UL_5MHZ)                                   ||
+       liblte_phy_is_valid_n_prb_for_ul(0, LIBLTE_PHY_N_RB_UL_5MHZ)                                     ||
+       liblte_phy_is_valid_n_prb_for_ul(7, LIBLTE_PHY_N_RB_UL_5MHZ)                                     ||
+       liblte_phy_is_valid_n_prb_for_ul(14, LIBLTE_PHY_N_RB_UL_5MHZ)                                    ||
+       liblte_phy_is_valid_n_prb_for_ul(LIBLTE_PHY_N_RB_UL_5MHZ, LIBLTE_PHY_N_RB_UL_5MHZ)               ||
+       LIBLTE_SUCCESS == liblte_phy_get_tbs_for_ul(14, 7, &tbs))
+        return -1;
     uint32 N_cce;
     if(LIBLTE_SUCCESS != liblte_phy_get_n_cce(phy_struct, 1.0, 2, N_DL_ANT, &N_cce))
         return -1;
@@ -2036,6 +2254,14 @@ int main(int argc, char *argv[])
     if(0 != pdcch_channel_encode_decode_test(phy_struct))
         exit(-1);
     printf("pass\n");
+    printf("dl_ra_type_0_1_test: ");
+    if(0 != dl_ra_type_0_1_test(phy_struct))
+        exit(-1);
+    printf("pass\n");
+    printf("pdcch_candidates_test: ");
+    if(0 != pdcch_candidates_test(phy_struct))
+        exit(-1);
+    printf("pass\n");
     printf("pss_sss_test: ");
     if(0 != pss_sss_test(phy_struct))
         exit(-1);
@@ -38,6 +38,7 @@
 
 #include "typedefs.h"
 #include <string>
+#include <sys/time.h>
 
 /*******************************************************************************
                               DEFINES
@@ -82,9 +83,11 @@ bool to_number(std::string str, uint32 num_bytes, uint8 *number);
 /*********************************************************************
     Name: get_formatted_time
 
-    Description: Populates a string with a formatted time.
+    Description: Populates a string with a formatted time, either
+                 now or a time taken earlier.
 *********************************************************************/
 void get_formatted_time(std::string &time_string);
+void get_formatted_time(struct timeval *tv, std::string &time_string);
 
 /*********************************************************************
     Name: is_string_valid_as_number
@@ -0,0 +1,148 @@
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: libtools_ipc_iq_ring.h
+
+    Description: Contains all the definitions for the shared memory IQ sample
+                 ring used between processes.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+#ifndef __LIBTOOLS_IPC_IQ_RING_H__
+#define __LIBTOOLS_IPC_IQ_RING_H__
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "typedefs.h"
+#include "libtools_ipc_msgq.h"
+#include <atomic>
+#include <string>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+#define LIBTOOLS_IPC_IQ_RING_MAGIC   0x49515247 // "IQRG"
+#define LIBTOOLS_IPC_IQ_RING_VERSION 1
+
+/*******************************************************************************
+                              FORWARD DECLARATIONS
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+typedef enum{
+    LIBTOOLS_IPC_IQ_RING_ERROR_NONE = 0,
+    LIBTOOLS_IPC_IQ_RING_ERROR_INVALID_INPUTS,
+    LIBTOOLS_IPC_IQ_RING_ERROR_SHM,
+    LIBTOOLS_IPC_IQ_RING_ERROR_MISMATCH,
+    LIBTOOLS_IPC_IQ_RING_ERROR_N_ITEMS,
+}LIBTOOLS_IPC_IQ_RING_ERROR_ENUM;
+static const char libtools_ipc_iq_ring_error_text[LIBTOOLS_IPC_IQ_RING_ERROR_N_ITEMS][20] = {"None",
+                                                                                             "Invalid Inputs",
+                                                                                             "Shared Memory",
+                                                                                             "Mismatch"};
+
+typedef enum{
+    LIBTOOLS_IPC_IQ_RING_ROLE_PRODUCER = 0,
+    LIBTOOLS_IPC_IQ_RING_ROLE_CONSUMER,
+    LIBTOOLS_IPC_IQ_RING_ROLE_N_ITEMS,
+}LIBTOOLS_IPC_IQ_RING_ROLE_ENUM;
+static const char libtools_ipc_iq_ring_role_text[LIBTOOLS_IPC_IQ_RING_ROLE_N_ITEMS][20] = {"Producer",
+                                                                                           "Consumer"};
+
+// Lives in shared memory, so only address free atomics
+typedef struct{
+    std::atomic<uint32>             state;
+    uint32                          magic;
+    uint32                          version;
+    uint32                          N_slots;
+    uint32                          slot_size;
+    alignas(64) std::atomic<uint64> tail; // Written by the producer
+    uint64                          next_seq;
+    std::atomic<uint64>             N_dropped;
+    alignas(64) std::atomic<uint64> head; // Written by the consumer
+    std::atomic<uint32>             consumer_waiting;
+}LIBTOOLS_IPC_IQ_RING_HEADER_STRUCT;
+
+typedef struct{
+    alignas(64) uint64                     seq;
+    LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT samps;
+}LIBTOOLS_IPC_IQ_RING_SLOT_STRUCT;
+
+typedef struct{
+    uint64 N_msgs;    // Sent or received
+    uint64 N_dropped; // Ring full when sending
+    uint64 N_lost;    // Sequence gaps seen when receiving
+    uint64 N_wakeups;
+}LIBTOOLS_IPC_IQ_RING_STATS_STRUCT;
+
+/*******************************************************************************
+                              CLASS DECLARATIONS
+*******************************************************************************/
+
+// Single producer, single consumer ring of subframes of IQ samples in POSIX
+// shared memory.  Either side can be started first and either side can be
+// restarted, the ring is left in /dev/shm for the next user.  The producer
+// never blocks, when the ring is full the subframe is dropped and its
+// sequence number is skipped so the consumer can see the gap.  A waiting
+// consumer is woken through a futex in the ring header.
+class libtools_ipc_iq_ring
+{
+public:
+    libtools_ipc_iq_ring(std::string                      _ring_name,
+                         LIBTOOLS_IPC_IQ_RING_ROLE_ENUM   _role,
+                         uint32                           _N_slots,
+                         LIBTOOLS_IPC_IQ_RING_ERROR_ENUM &error);
+    ~libtools_ipc_iq_ring();
+
+    // Producer
+    bool send(LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT *samps);
+
+    // Consumer, the returned samples stay valid until release()
+    LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT* receive(uint32 timeout_us, uint64 *seq);
+    void release();
+
+    // Statistics
+    void get_stats(LIBTOOLS_IPC_IQ_RING_STATS_STRUCT *stats);
+
+private:
+    // Variables
+    LIBTOOLS_IPC_IQ_RING_HEADER_STRUCT *hdr;
+    LIBTOOLS_IPC_IQ_RING_SLOT_STRUCT   *slots;
+    std::string                         ring_name;
+    LIBTOOLS_IPC_IQ_RING_ROLE_ENUM      role;
+    size_t                              shm_size;
+    uint32                              N_slots;
+    uint64                              expected_seq;
+    bool                                first_msg;
+    uint64                              N_msgs;
+    uint64                              N_lost;
+    uint64                              N_wakeups;
+};
+
+#endif /* __LIBTOOLS_IPC_IQ_RING_H__ */
@@ -40,6 +40,8 @@
 #include "liblte_phy.h"
 #include <string>
 #include <thread>
+#include <mutex>
+#include <atomic>
 
 /*******************************************************************************
                               DEFINES
@@ -50,6 +52,7 @@
                               FORWARD DECLARATIONS
 *******************************************************************************/
 
+class libtools_ipc_msgq_handle;
 
 /*******************************************************************************
                               TYPEDEFS
@@ -145,12 +148,15 @@ public:
     void send(LIBTOOLS_IPC_MSGQ_MESSAGE_TYPE_ENUM type, LIBTOOLS_IPC_MSGQ_MESSAGE_UNION *msg_content, uint32 msg_content_size);
 private:
     // Send/Receive
+    libtools_ipc_msgq_handle* open_tx();
     static void receive_thread(libtools_ipc_msgq *msgq);
 
     // Variables
-    libtools_ipc_msgq_cb *callback;
-    std::string           msgq_name;
-    std::thread          *rx_thread;
+    libtools_ipc_msgq_cb                    *callback;
+    std::string                              msgq_name;
+    std::thread                             *rx_thread;
+    std::mutex                               tx_mutex;
+    std::atomic<libtools_ipc_msgq_handle *>  tx_mq;
 };
 
 #endif /* __LIBTOOLS_IPC_MSGQ_H__ */
@@ -179,24 +179,30 @@ bool to_number(std::string  str,
 /*********************************************************************
     Name: get_formatted_time
 
-    Description: Populates a string with a formatted time.
+    Description: Populates a string with a formatted time, either
+                 now or a time taken earlier.
 *********************************************************************/
 void get_formatted_time(std::string &time_string)
 {
-    struct timeval  tv;
-    struct tm      *local_time;
-    time_t          tmp_time;
+    struct timeval tv;
 
-    tmp_time   = time(NULL);
-    local_time = localtime(&tmp_time);
     gettimeofday(&tv, NULL);
-    time_string += to_string(local_time->tm_mon + 1, 2) + "/";
-    time_string += to_string(local_time->tm_mday, 2) + "/";
-    time_string += to_string(local_time->tm_year + 1900, 4) + " ";
-    time_string += to_string(local_time->tm_hour, 2) + ":";
-    time_string += to_string((tv.tv_sec / 60) % 60, 2) + ":";
-    time_string += to_string(tv.tv_sec % 60, 2) + ".";
-    time_string += to_string(tv.tv_usec, 6);
+    get_formatted_time(&tv, time_string);
+}
+void get_formatted_time(struct timeval *tv,
+                        std::string    &time_string)
+{
+    struct tm local_time;
+    time_t    tmp_time = tv->tv_sec;
+
+    localtime_r(&tmp_time, &local_time);
+    time_string += to_string(local_time.tm_mon + 1, 2) + "/";
+    time_string += to_string(local_time.tm_mday, 2) + "/";
+    time_string += to_string(local_time.tm_year + 1900, 4) + " ";
+    time_string += to_string(local_time.tm_hour, 2) + ":";
+    time_string += to_string((tv->tv_sec / 60) % 60, 2) + ":";
+    time_string += to_string(tv->tv_sec % 60, 2) + ".";
+    time_string += to_string(tv->tv_usec, 6);
 }
 
 /*********************************************************************
@@ -0,0 +1,313 @@
+#line 2 "libtools_ipc_iq_ring.cc" // Make __FILE__ omit the path
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: libtools_ipc_iq_ring.cc
+
+    Description: Contains all the implementations for the shared memory IQ
+                 sample ring used between processes.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "libtools_ipc_iq_ring.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <time.h>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+// Header state
+#define LIBTOOLS_IPC_IQ_RING_STATE_EMPTY        0
+#define LIBTOOLS_IPC_IQ_RING_STATE_INITIALIZING 1
+#define LIBTOOLS_IPC_IQ_RING_STATE_READY        2
+
+// How long to wait for the other side to finish setting up the header
+#define LIBTOOLS_IPC_IQ_RING_INIT_WAIT_US 1000000
+#define LIBTOOLS_IPC_IQ_RING_INIT_POLL_US 1000
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              GLOBAL VARIABLES
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              LOCAL FUNCTIONS
+*******************************************************************************/
+
+// The ring is mapped by more than one process, so no private futexes
+static void futex_wait(std::atomic<uint32> *word,
+                       uint32               val,
+                       struct timespec     *timeout)
+{
+    syscall(SYS_futex, (uint32 *)word, FUTEX_WAIT, val, timeout, NULL, 0);
+}
+static void futex_wake(std::atomic<uint32> *word)
+{
+    syscall(SYS_futex, (uint32 *)word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+static uint64 now_us()
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return((uint64)now.tv_sec*1000000 + now.tv_nsec/1000);
+}
+
+/*******************************************************************************
+                              CLASS IMPLEMENTATIONS
+*******************************************************************************/
+
+/********************************/
+/*    Constructor/Destructor    */
+/********************************/
+libtools_ipc_iq_ring::libtools_ipc_iq_ring(std::string                      _ring_name,
+                                           LIBTOOLS_IPC_IQ_RING_ROLE_ENUM   _role,
+                                           uint32                           _N_slots,
+                                           LIBTOOLS_IPC_IQ_RING_ERROR_ENUM &error) :
+    hdr{NULL}, slots{NULL}, ring_name{"/" + _ring_name}, role{_role}, N_slots{_N_slots},
+    expected_seq{0}, first_msg{true}, N_msgs{0}, N_lost{0}, N_wakeups{0}
+{
+    struct stat st;
+    uint32      state = LIBTOOLS_IPC_IQ_RING_STATE_EMPTY;
+    uint32      i;
+    int32       fd;
+    void       *mem;
+
+    error    = LIBTOOLS_IPC_IQ_RING_ERROR_INVALID_INPUTS;
+    shm_size = sizeof(LIBTOOLS_IPC_IQ_RING_HEADER_STRUCT) + N_slots*sizeof(LIBTOOLS_IPC_IQ_RING_SLOT_STRUCT);
+    if(0 == N_slots ||
+       LIBTOOLS_IPC_IQ_RING_ROLE_N_ITEMS <= role)
+        return;
+
+    // Whichever side comes first creates the ring
+    error = LIBTOOLS_IPC_IQ_RING_ERROR_SHM;
+    fd    = shm_open(ring_name.c_str(), O_CREAT | O_RDWR, 0666);
+    if(0 > fd)
+        return;
+    if(0 != fstat(fd, &st))
+    {
+        close(fd);
+        return;
+    }
+    if(0 != st.st_size &&
+       shm_size != (size_t)st.st_size)
+    {
+        // Shrinking it under the other side would fault its mapping
+        close(fd);
+        error = LIBTOOLS_IPC_IQ_RING_ERROR_MISMATCH;
+        return;
+    }
+    if(0 == st.st_size &&
+       0 != ftruncate(fd, shm_size))
+    {
+        close(fd);
+        return;
+    }
+    mem = mmap(NULL, shm_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(MAP_FAILED == mem)
+        return;
+    hdr   = (LIBTOOLS_IPC_IQ_RING_HEADER_STRUCT *)mem;
+    slots = (LIBTOOLS_IPC_IQ_RING_SLOT_STRUCT *)((uint8 *)mem + sizeof(LIBTOOLS_IPC_IQ_RING_HEADER_STRUCT));
+
+    // A fresh ring is all zeros, the first side to see that sets it up
+    if(hdr->state.compare_exchange_strong(state, LIBTOOLS_IPC_IQ_RING_STATE_INITIALIZING))
+    {
+        hdr->magic     = LIBTOOLS_IPC_IQ_RING_MAGIC;
+        hdr->version   = LIBTOOLS_IPC_IQ_RING_VERSION;
+        hdr->N_slots   = N_slots;
+        hdr->slot_size = sizeof(LIBTOOLS_IPC_IQ_RING_SLOT_STRUCT);
+        hdr->next_seq  = 0;
+        hdr->tail.store(0);
+        hdr->head.store(0);
+        hdr->N_dropped.store(0);
+        hdr->consumer_waiting.store(0);
+        hdr->state.store(LIBTOOLS_IPC_IQ_RING_STATE_READY);
+    }
+    for(i=0; i<LIBTOOLS_IPC_IQ_RING_INIT_WAIT_US/LIBTOOLS_IPC_IQ_RING_INIT_POLL_US; i++)
+    {
+        if(LIBTOOLS_IPC_IQ_RING_STATE_READY == hdr->state.load())
+            break;
+        usleep(LIBTOOLS_IPC_IQ_RING_INIT_POLL_US);
+    }
+    if(LIBTOOLS_IPC_IQ_RING_STATE_READY != hdr->state.load())
+    {
+        munmap(hdr, shm_size);
+        hdr = NULL;
+        return;
+    }
+    if(LIBTOOLS_IPC_IQ_RING_MAGIC              != hdr->magic   ||
+       LIBTOOLS_IPC_IQ_RING_VERSION            != hdr->version ||
+       N_slots                                 != hdr->N_slots ||
+       sizeof(LIBTOOLS_IPC_IQ_RING_SLOT_STRUCT) != hdr->slot_size)
+    {
+        munmap(hdr, shm_size);
+        hdr   = NULL;
+        error = LIBTOOLS_IPC_IQ_RING_ERROR_MISMATCH;
+        return;
+    }
+
+    // Samples left over from an earlier consumer are stale
+    if(LIBTOOLS_IPC_IQ_RING_ROLE_CONSUMER == role)
+        hdr->head.store(hdr->tail.load());
+
+    error = LIBTOOLS_IPC_IQ_RING_ERROR_NONE;
+}
+libtools_ipc_iq_ring::~libtools_ipc_iq_ring()
+{
+    if(NULL != hdr)
+        munmap(hdr, shm_size);
+}
+
+/******************/
+/*    Producer    */
+/******************/
+bool libtools_ipc_iq_ring::send(LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT *samps)
+{
+    LIBTOOLS_IPC_IQ_RING_SLOT_STRUCT *slot;
+    uint64                            tail;
+    uint64                            seq;
+    uint32                            i;
+
+    if(NULL == hdr                                             ||
+       LIBTOOLS_IPC_IQ_RING_ROLE_PRODUCER != role              ||
+       4 < samps->N_ant                                        ||
+       LIBLTE_PHY_N_SAMPS_PER_SUBFR_30_72MHZ < samps->N_samps_per_ant)
+        return false;
+
+    // Every subframe uses up a sequence number, sent or not
+    tail = hdr->tail.load(std::memory_order_relaxed);
+    seq  = hdr->next_seq++;
+    if(N_slots <= tail - hdr->head.load(std::memory_order_acquire))
+    {
+        hdr->N_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Only the samples in use are copied, a subframe at a low bandwidth
+    // is a small part of the slot
+    slot                        = &slots[tail % N_slots];
+    slot->seq                   = seq;
+    slot->samps.N_samps_per_ant = samps->N_samps_per_ant;
+    slot->samps.current_tti     = samps->current_tti;
+    slot->samps.N_ant           = samps->N_ant;
+    for(i=0; i<samps->N_ant; i++)
+        memcpy(slot->samps.samps[i], samps->samps[i], samps->N_samps_per_ant*sizeof(complex));
+    N_msgs++;
+
+    // Pairs with the sequentially consistent waiting flag, see receive()
+    hdr->tail.store(tail + 1);
+    if(0 != hdr->consumer_waiting.load() &&
+       0 != hdr->consumer_waiting.exchange(0))
+        futex_wake(&hdr->consumer_waiting);
+
+    return true;
+}
+
+/******************/
+/*    Consumer    */
+/******************/
+LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT* libtools_ipc_iq_ring::receive(uint32  timeout_us,
+                                                                      uint64 *seq)
+{
+    LIBTOOLS_IPC_IQ_RING_SLOT_STRUCT *slot;
+    struct timespec                   timeout;
+    uint64                            head;
+    uint64                            deadline;
+    uint64                            now;
+
+    if(NULL == hdr ||
+       LIBTOOLS_IPC_IQ_RING_ROLE_CONSUMER != role)
+        return NULL;
+
+    head     = hdr->head.load(std::memory_order_relaxed);
+    deadline = now_us() + timeout_us;
+    while(head == hdr->tail.load(std::memory_order_acquire))
+    {
+        now = now_us();
+        if(now >= deadline)
+            return NULL;
+
+        // Announce the wait before the final check so the producer either
+        // sees the flag or its subframe is seen here
+        hdr->consumer_waiting.store(1);
+        if(head == hdr->tail.load())
+        {
+            timeout.tv_sec  = (deadline - now) / 1000000;
+            timeout.tv_nsec = ((deadline - now) % 1000000) * 1000;
+            futex_wait(&hdr->consumer_waiting, 1, &timeout);
+            N_wakeups++;
+        }
+        hdr->consumer_waiting.store(0);
+    }
+
+    slot = &slots[head % N_slots];
+    if(!first_msg &&
+       slot->seq != expected_seq)
+        N_lost += slot->seq - expected_seq;
+    first_msg    = false;
+    expected_seq = slot->seq + 1;
+    N_msgs++;
+
+    if(NULL != seq)
+        *seq = slot->seq;
+    return &slot->samps;
+}
+void libtools_ipc_iq_ring::release()
+{
+    uint64 head;
+
+    if(NULL == hdr ||
+       LIBTOOLS_IPC_IQ_RING_ROLE_CONSUMER != role)
+        return;
+
+    head = hdr->head.load(std::memory_order_relaxed);
+    if(head != hdr->tail.load(std::memory_order_acquire))
+        hdr->head.store(head + 1, std::memory_order_release);
+}
+
+/********************/
+/*    Statistics    */
+/********************/
+void libtools_ipc_iq_ring::get_stats(LIBTOOLS_IPC_IQ_RING_STATS_STRUCT *stats)
+{
+    stats->N_msgs    = N_msgs;
+    stats->N_dropped = (NULL != hdr) ? hdr->N_dropped.load(std::memory_order_relaxed) : 0;
+    stats->N_lost    = N_lost;
+    stats->N_wakeups = N_wakeups;
+}
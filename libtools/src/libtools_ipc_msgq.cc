@@ -45,6 +45,12 @@
                               TYPEDEFS
 *******************************************************************************/
 
+// Send side of the queue, opened once and kept for the life of the object
+class libtools_ipc_msgq_handle : public boost::interprocess::message_queue
+{
+public:
+    using boost::interprocess::message_queue::message_queue;
+};
 
 /*******************************************************************************
                               GLOBAL VARIABLES
@@ -78,11 +84,13 @@ libtools_ipc_msgq::libtools_ipc_msgq(std::string          _msgq_name,
                                      libtools_ipc_msgq_cb cb) :
     callback{new libtools_ipc_msgq_cb(cb)}, msgq_name{_msgq_name}
 {
+    tx_mq.store(NULL);
     rx_thread = new std::thread(receive_thread, this);
 }
 libtools_ipc_msgq::libtools_ipc_msgq(std::string _msgq_name) :
     callback{NULL}, msgq_name{_msgq_name}
 {
+    tx_mq.store(NULL);
     rx_thread = new std::thread(receive_thread, this);
 }
 libtools_ipc_msgq::~libtools_ipc_msgq()
@@ -92,6 +100,9 @@ libtools_ipc_msgq::~libtools_ipc_msgq()
     // Cleanup thread
     rx_thread->join();
     delete rx_thread;
+
+    delete tx_mq.load();
+    delete callback;
 }
 
 /**********************/
@@ -101,15 +112,44 @@ void libtools_ipc_msgq::send(LIBTOOLS_IPC_MSGQ_MESSAGE_TYPE_ENUM  type,
                              LIBTOOLS_IPC_MSGQ_MESSAGE_UNION     *msg_content,
                              uint32                               msg_content_size)
 {
-    LIBTOOLS_IPC_MSGQ_MESSAGE_STRUCT   msg;
-    boost::interprocess::message_queue mq(boost::interprocess::open_only,
-                                          msgq_name.c_str());
+    LIBTOOLS_IPC_MSGQ_MESSAGE_STRUCT  msg;
+    libtools_ipc_msgq_handle         *mq = tx_mq.load(std::memory_order_acquire);
+
+    if(NULL == mq &&
+       NULL == (mq = open_tx()))
+        return;
+    if(msg_content_size > sizeof(msg.msg))
+    {
+        printf("ERROR %s Message too large: %u\n",
+               msgq_name.c_str(),
+               msg_content_size);
+        return;
+    }
 
     msg.type = type;
     if(msg_content != NULL)
         memcpy(&msg.msg, msg_content, msg_content_size);
 
-    mq.try_send(&msg, sizeof(LIBTOOLS_IPC_MSGQ_MESSAGE_STRUCT), 0);
+    mq->try_send(&msg, sizeof(LIBTOOLS_IPC_MSGQ_MESSAGE_STRUCT), 0);
+}
+libtools_ipc_msgq_handle* libtools_ipc_msgq::open_tx()
+{
+    std::lock_guard<std::mutex> lock(tx_mutex);
+
+    if(NULL == tx_mq.load())
+    {
+        // The queue is created by the receiver, until it exists
+        // messages are dropped just as they are when it is full
+        try
+        {
+            tx_mq.store(new libtools_ipc_msgq_handle(boost::interprocess::open_only,
+                                                     msgq_name.c_str()),
+                        std::memory_order_release);
+        }catch(boost::interprocess::interprocess_exception &e){
+            return NULL;
+        }
+    }
+    return tx_mq.load();
 }
 void libtools_ipc_msgq::receive_thread(libtools_ipc_msgq *msgq)
 {
@@ -0,0 +1,283 @@
+/*******************************************************************************
+
+    Copyright 2021 Ben Wojtowicz
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU Affero General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Affero General Public License for more details.
+
+    You should have received a copy of the GNU Affero General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*******************************************************************************
+
+    File: libtools_ipc_iq_ring_tests.cc
+
+    Description: Contains all the tests for the shared memory IQ sample ring.
+
+    Revision History
+    ----------    -------------    --------------------------------------------
+
+*******************************************************************************/
+
+/*******************************************************************************
+                              INCLUDES
+*******************************************************************************/
+
+#include "libtools_ipc_iq_ring.h"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <thread>
+
+/*******************************************************************************
+                              DEFINES
+*******************************************************************************/
+
+#define TEST_N_SLOTS          4
+#define TEST_N_SAMPS          1920 // 1.4MHz subframe
+#define TEST_THREAD_N_SUBFRS  2000
+#define TEST_RX_TIMEOUT_US    100000
+
+/*******************************************************************************
+                              TYPEDEFS
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              GLOBAL VARIABLES
+*******************************************************************************/
+
+
+/*******************************************************************************
+                              FUNCTIONS
+*******************************************************************************/
+
+// Each test gets its own ring.  Its name is removed as soon as both sides
+// have it mapped, so a failed test leaves nothing in /dev/shm.
+std::string ring_name(const char *test)
+{
+    return "libtools_iq_ring_test_" + std::string(test) + "_" + std::to_string(getpid());
+}
+
+void fill_subfr(LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT *samps,
+                uint32                                  idx)
+{
+    samps->N_samps_per_ant = TEST_N_SAMPS;
+    samps->current_tti     = idx % (LIBLTE_PHY_TTI_MAX + 1);
+    samps->N_ant           = 2;
+    for(uint32 i=0; i<samps->N_ant; i++)
+        for(uint32 j=0; j<samps->N_samps_per_ant; j++)
+            samps->samps[i][j] = complex((float)idx, (float)(i*TEST_N_SAMPS + j));
+}
+
+bool check_subfr(LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT *samps,
+                 uint32                                  idx)
+{
+    if(NULL                           == samps                  ||
+       TEST_N_SAMPS                   != samps->N_samps_per_ant ||
+       idx % (LIBLTE_PHY_TTI_MAX + 1) != samps->current_tti     ||
+       2                              != samps->N_ant)
+        return false;
+    for(uint32 i=0; i<samps->N_ant; i++)
+        for(uint32 j=0; j<samps->N_samps_per_ant; j++)
+            if(complex((float)idx, (float)(i*TEST_N_SAMPS + j)) != samps->samps[i][j])
+                return false;
+    return true;
+}
+
+int round_trip_wrap_test(LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT *samps)
+{
+    LIBTOOLS_IPC_IQ_RING_ERROR_ENUM   prod_err;
+    LIBTOOLS_IPC_IQ_RING_ERROR_ENUM   cons_err;
+    LIBTOOLS_IPC_IQ_RING_STATS_STRUCT stats;
+    std::string                       name = ring_name("wrap");
+    libtools_ipc_iq_ring              prod(name, LIBTOOLS_IPC_IQ_RING_ROLE_PRODUCER, TEST_N_SLOTS, prod_err);
+    libtools_ipc_iq_ring              cons(name, LIBTOOLS_IPC_IQ_RING_ROLE_CONSUMER, TEST_N_SLOTS, cons_err);
+    uint64                            seq;
+
+    shm_unlink(("/" + name).c_str());
+    if(LIBTOOLS_IPC_IQ_RING_ERROR_NONE != prod_err ||
+       LIBTOOLS_IPC_IQ_RING_ERROR_NONE != cons_err)
+        return -1;
+
+    // Nothing sent yet
+    if(NULL != cons.receive(0, &seq))
+        return -1;
+
+    // Two subframes in flight at a time, going around the ring three times
+    for(uint32 i=0; i<3*TEST_N_SLOTS; i++)
+    {
+        fill_subfr(samps, 2*i);
+        if(!prod.send(samps))
+            return -1;
+        fill_subfr(samps, 2*i+1);
+        if(!prod.send(samps))
+            return -1;
+        for(uint32 j=2*i; j<2*i+2; j++)
+        {
+            if(!check_subfr(cons.receive(0, &seq), j) || j != seq)
+                return -1;
+            cons.release();
+        }
+    }
+    cons.get_stats(&stats);
+    if(6*TEST_N_SLOTS != stats.N_msgs || 0 != stats.N_lost)
+        return -1;
+
+    return 0;
+}
+
+int full_drop_test(LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT *samps)
+{
+    LIBTOOLS_IPC_IQ_RING_ERROR_ENUM         prod_err;
+    LIBTOOLS_IPC_IQ_RING_ERROR_ENUM         cons_err;
+    LIBTOOLS_IPC_IQ_RING_STATS_STRUCT       stats;
+    LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT *rx;
+    std::string                             name = ring_name("drop");
+    libtools_ipc_iq_ring                    cons(name, LIBTOOLS_IPC_IQ_RING_ROLE_CONSUMER, TEST_N_SLOTS, cons_err);
+    libtools_ipc_iq_ring                    prod(name, LIBTOOLS_IPC_IQ_RING_ROLE_PRODUCER, TEST_N_SLOTS, prod_err);
+    uint64                                  seq;
+    uint32                                  i;
+
+    shm_unlink(("/" + name).c_str());
+    if(LIBTOOLS_IPC_IQ_RING_ERROR_NONE != prod_err ||
+       LIBTOOLS_IPC_IQ_RING_ERROR_NONE != cons_err)
+        return -1;
+
+    // The last two subframes find the ring full
+    for(i=0; i<TEST_N_SLOTS+2; i++)
+    {
+        fill_subfr(samps, i);
+        if((i < TEST_N_SLOTS) != prod.send(samps))
+            return -1;
+    }
+    prod.get_stats(&stats);
+    if(TEST_N_SLOTS != stats.N_msgs || 2 != stats.N_dropped)
+        return -1;
+
+    // A subframe keeps its slot until it is released
+    rx = cons.receive(0, &seq);
+    if(!check_subfr(rx, 0) || 0 != seq)
+        return -1;
+    fill_subfr(samps, TEST_N_SLOTS+2);
+    if(prod.send(samps))
+        return -1;
+    cons.release();
+    for(i=1; i<TEST_N_SLOTS; i++)
+    {
+        if(!check_subfr(cons.receive(0, &seq), i) || i != seq)
+            return -1;
+        cons.release();
+    }
+
+    // The three dropped sequence numbers show up as a gap
+    fill_subfr(samps, TEST_N_SLOTS+3);
+    if(!prod.send(samps))
+        return -1;
+    if(!check_subfr(cons.receive(0, &seq), TEST_N_SLOTS+3) || TEST_N_SLOTS+3 != seq)
+        return -1;
+    cons.release();
+    cons.get_stats(&stats);
+    if(3 != stats.N_lost)
+        return -1;
+
+    return 0;
+}
+
+int thread_test()
+{
+    LIBTOOLS_IPC_IQ_RING_ERROR_ENUM   prod_err;
+    LIBTOOLS_IPC_IQ_RING_ERROR_ENUM   cons_err;
+    LIBTOOLS_IPC_IQ_RING_STATS_STRUCT prod_stats;
+    LIBTOOLS_IPC_IQ_RING_STATS_STRUCT cons_stats;
+    std::string                       name = ring_name("thread");
+    libtools_ipc_iq_ring              prod(name, LIBTOOLS_IPC_IQ_RING_ROLE_PRODUCER, TEST_N_SLOTS, prod_err);
+    libtools_ipc_iq_ring              cons(name, LIBTOOLS_IPC_IQ_RING_ROLE_CONSUMER, TEST_N_SLOTS, cons_err);
+    std::atomic<bool>                 done;
+    uint64                            seq;
+    uint64                            last_seq = 0;
+    bool                              first    = true;
+
+    shm_unlink(("/" + name).c_str());
+    if(LIBTOOLS_IPC_IQ_RING_ERROR_NONE != prod_err ||
+       LIBTOOLS_IPC_IQ_RING_ERROR_NONE != cons_err)
+        return -1;
+
+    // The producer runs free and pauses now and then, so the consumer
+    // both waits on an empty ring and falls behind on a full one
+    done.store(false);
+    std::thread producer([&prod, &done]() {
+        LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT *samps = new LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT;
+        for(uint32 i=0; i<TEST_THREAD_N_SUBFRS; i++)
+        {
+            fill_subfr(samps, i);
+            prod.send(samps);
+            if(0 == (i % 64))
+                usleep(1000);
+        }
+        delete samps;
+        done.store(true);
+    });
+    while(1)
+    {
+        LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT *rx = cons.receive(TEST_RX_TIMEOUT_US, &seq);
+        if(NULL == rx)
+        {
+            if(done.load())
+                break;
+            continue;
+        }
+        if((!first && seq <= last_seq) ||
+           !check_subfr(rx, seq))
+        {
+            done.store(true);
+            producer.join();
+            return -1;
+        }
+        first    = false;
+        last_seq = seq;
+        cons.release();
+    }
+    producer.join();
+
+    // Every subframe arrived intact or was dropped, and all but trailing
+    // drops were seen as a gap
+    prod.get_stats(&prod_stats);
+    cons.get_stats(&cons_stats);
+    if(TEST_THREAD_N_SUBFRS != prod_stats.N_msgs + prod_stats.N_dropped ||
+       prod_stats.N_msgs    != cons_stats.N_msgs                        ||
+       prod_stats.N_dropped != cons_stats.N_lost + (TEST_THREAD_N_SUBFRS - 1 - last_seq))
+        return -1;
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    // A subframe is too big for the stack
+    LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT *samps = new LIBTOOLS_IPC_MSGQ_PHY_SAMPS_MSG_STRUCT;
+
+    printf("round_trip_wrap_test: ");
+    if(0 != round_trip_wrap_test(samps))
+        exit(-1);
+    printf("pass\n");
+    printf("full_drop_test: ");
+    if(0 != full_drop_test(samps))
+        exit(-1);
+    printf("pass\n");
+    printf("thread_test: ");
+    if(0 != thread_test())
+        exit(-1);
+    printf("pass\n");
+    delete samps;
+    exit(0);
+}